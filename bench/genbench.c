@@ -0,0 +1,129 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Generator benchmark: writes a grammar with thousands of symbols and states, then times
+ * carburetta generating a parser for it. Every symbol is typed, spread over a number of types
+ * that each have a constructor, destructor and move, so the emitter's per-state, per-type passes
+ * all have work to do.
+ *
+ * Usage: genbench <carburetta> <work-dir> [<num-chains> [<num-types> [<num-runs>]]]
+ *
+ * Each chain i contributes the terminals Ti and Ui, and non-terminals Ai and Bi, for a nested
+ * list of Ti ... Ui pairs:
+ *   Ai: Ti Bi Ui;   Ai: Ti Ui;   Bi: Ai;   Bi: Bi Ai;
+ * the start symbol chooses among all Ai, so there are 4 * <num-chains> symbols and about
+ * 6 * <num-chains> states. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static int write_grammar(const char *filename, int num_chains, int num_types) {
+  int n;
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) {
+    fprintf(stderr, "Failed to open \"%s\" for writing\n", filename);
+    return -1;
+  }
+
+  fprintf(fp, "#include <stdlib.h>\n\n");
+  for (n = 0; n < num_types; ++n) {
+    fprintf(fp, "struct genbench_t%d { int value_; };\n", n);
+  }
+
+  fprintf(fp, "\n%%scanner%%\n%%prefix genbench_\n\n: [\\ \\n]+;\n");
+  for (n = 0; n < num_chains; ++n) {
+    fprintf(fp, "T%d: t%d;\nU%d: u%d;\n", n, n, n, n);
+  }
+
+  fprintf(fp, "\n%%token");
+  for (n = 0; n < num_chains; ++n) {
+    fprintf(fp, " T%d U%d", n, n);
+  }
+  fprintf(fp, "\n%%nt start");
+  for (n = 0; n < num_chains; ++n) {
+    fprintf(fp, " A%d B%d", n, n);
+  }
+
+  fprintf(fp, "\n\n%%grammar%%\n\n");
+  for (n = 0; n < num_types; ++n) {
+    int chain;
+    fprintf(fp, "%%type");
+    for (chain = n; chain < num_chains; chain += num_types) {
+      fprintf(fp, " T%d U%d A%d B%d", chain, chain, chain, chain);
+    }
+    fprintf(fp, ": struct genbench_t%d\n", n);
+    fprintf(fp, "%%constructor $$.value_ = %d;\n", n);
+    fprintf(fp, "%%destructor $$.value_ = -1;\n");
+    fprintf(fp, "%%move $$ = $0;\n\n");
+  }
+
+  for (n = 0; n < num_chains; ++n) {
+    fprintf(fp, "start: A%d;\n", n);
+  }
+  for (n = 0; n < num_chains; ++n) {
+    fprintf(fp, "A%d: T%d B%d U%d;\nA%d: T%d U%d;\nB%d: A%d;\nB%d: B%d A%d;\n", n, n, n, n, n, n, n, n, n, n, n, n);
+  }
+  fprintf(fp, "\n%%%%\n");
+
+  if (fclose(fp)) {
+    fprintf(stderr, "Failed to write \"%s\"\n", filename);
+    return -1;
+  }
+  return 0;
+}
+
+static double wall_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+  int num_chains = 2000;
+  int num_types = 32;
+  int num_runs = 3;
+  int n;
+  if ((argc < 3) || (argc > 6)) {
+    fprintf(stderr, "Usage: genbench <carburetta> <work-dir> [<num-chains> [<num-types> [<num-runs>]]]\n");
+    return EXIT_FAILURE;
+  }
+  if (argc > 3) num_chains = atoi(argv[3]);
+  if (argc > 4) num_types = atoi(argv[4]);
+  if (argc > 5) num_runs = atoi(argv[5]);
+  if ((num_chains < 1) || (num_types < 1) || (num_runs < 1)) {
+    fprintf(stderr, "Counts must be positive\n");
+    return EXIT_FAILURE;
+  }
+
+  char grammar[1024], output[1024], command[4096];
+  snprintf(grammar, sizeof(grammar), "%s/genbench.cbrt", argv[2]);
+  snprintf(output, sizeof(output), "%s/genbench.c", argv[2]);
+  if (write_grammar(grammar, num_chains, num_types)) return EXIT_FAILURE;
+  snprintf(command, sizeof(command), "\"%s\" \"%s\" --c \"%s\" --h", argv[1], grammar, output);
+
+  double best = 0.;
+  for (n = 0; n < num_runs; ++n) {
+    double start = wall_clock();
+    if (system(command)) {
+      fprintf(stderr, "Failed: %s\n", command);
+      return EXIT_FAILURE;
+    }
+    double elapsed = wall_clock() - start;
+    if (!n || (elapsed < best)) best = elapsed;
+  }
+  printf("%d symbols, %d types: best of %d runs %.3fs\n", 4 * num_chains, num_types, num_runs, best);
+  return EXIT_SUCCESS;
+}
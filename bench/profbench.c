@@ -0,0 +1,285 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Profile benchmark: writes a grammar with many keywords, each starting its own kind of
+ * statement, and generates its parser three times: with --instrument to collect a profile from a
+ * training input, then without and with --profile, and compares the throughput of the latter two
+ * on a different input drawn from the same distribution. The parsers are compiled with the C
+ * compiler given.
+ *
+ * Usage: profbench <carburetta> <cc> <work-dir> [<num-keywords> [<input-megabytes>]]
+ *
+ * Statement i is "<keyword i> <identifier> = <expression> ;", the keywords of the input follow a
+ * Zipf distribution, so a few statements are most of the input and most of the tables are rarely
+ * visited; the profiled tables place the rows and columns of the few together. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Driver appended to the grammar, main() parses the input file given 3 times and reports the
+ * best; the instrumented parser parses it once and writes the profile. */
+static const char driver[] =
+  "#include <time.h>\n"
+  "\n"
+  "static double profbench_clock(void) {\n"
+  "  struct timespec ts;\n"
+  "  clock_gettime(CLOCK_MONOTONIC, &ts);\n"
+  "  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;\n"
+  "}\n"
+  "\n"
+  "int main(int argc, char **argv) {\n"
+  "  FILE *fp = (argc >= 2) ? fopen(argv[1], \"rb\") : NULL;\n"
+  "  if (!fp) return EXIT_FAILURE;\n"
+  "  fseek(fp, 0, SEEK_END);\n"
+  "  size_t size = (size_t)ftell(fp);\n"
+  "  fseek(fp, 0, SEEK_SET);\n"
+  "  char *input = (char *)malloc(size ? size : 1);\n"
+  "  if (!input || (fread(input, 1, size, fp) != size)) return EXIT_FAILURE;\n"
+  "  fclose(fp);\n"
+  "  size_t num_stmts = 0;\n"
+  "  double best = 0.;\n"
+  "  int run;\n"
+  "#ifdef PROFBENCH_INSTRUMENT\n"
+  "  const int num_runs = 1;\n"
+  "#else\n"
+  "  const int num_runs = 3;\n"
+  "#endif\n"
+  "  for (run = 0; run < num_runs; ++run) {\n"
+  "    struct profbench_stack stack;\n"
+  "    profbench_stack_init(&stack);\n"
+  "    num_stmts = 0;\n"
+  "    double start = profbench_clock();\n"
+  "    profbench_set_input(&stack, input, size, 1);\n"
+  "    int r = profbench_scan(&stack, &num_stmts);\n"
+  "    double elapsed = profbench_clock() - start;\n"
+  "    profbench_stack_cleanup(&stack);\n"
+  "    if (r != _PROFBENCH_FINISH) {\n"
+  "      fprintf(stderr, \"Parse failed (%d)\\n\", r);\n"
+  "      return EXIT_FAILURE;\n"
+  "    }\n"
+  "    if (!run || (elapsed < best)) best = elapsed;\n"
+  "  }\n"
+  "#ifdef PROFBENCH_INSTRUMENT\n"
+  "  if ((argc != 3) || profbench_profile_write(argv[2])) {\n"
+  "    fprintf(stderr, \"Failed to write the profile\\n\");\n"
+  "    return EXIT_FAILURE;\n"
+  "  }\n"
+  "#endif\n"
+  "  printf(\"%zu statements, %.1f MB/s\\n\", num_stmts, (double)size / best / 1e6);\n"
+  "  free(input);\n"
+  "  return EXIT_SUCCESS;\n"
+  "}\n";
+
+/* Keyword i is "kw" followed by i in base 26, written with the letters a to z; IDENT also matches
+ * it, the keyword patterns come first and take precedence. */
+static void keyword(int i, char *buf) {
+  char digits[16];
+  int n = 0;
+  do {
+    digits[n++] = (char)('a' + i % 26);
+    i /= 26;
+  } while (i);
+  buf[0] = 'k';
+  buf[1] = 'w';
+  int k;
+  for (k = 0; k < n; ++k) {
+    buf[2 + k] = digits[n - k - 1];
+  }
+  buf[2 + n] = '\0';
+}
+
+static int write_grammar(const char *filename, int num_keywords) {
+  int n;
+  char kw[32];
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) {
+    fprintf(stderr, "Failed to open \"%s\" for writing\n", filename);
+    return -1;
+  }
+
+  fprintf(fp, "#include <stdio.h>\n#include <stdlib.h>\n\n");
+  fprintf(fp, "%%scanner%%\n%%prefix profbench_\n\n: [\\ \\n]+;\n");
+  for (n = 0; n < num_keywords; ++n) {
+    keyword(n, kw);
+    fprintf(fp, "K%d: %s;\n", n, kw);
+  }
+  fprintf(fp, "IDENT: [a-z][a-z0-9]*;\nNUMBER: [0-9]+;\nEQ: =;\nSEMI: \\;;\nPLUS: \\+;\nASTERISK: \\*;\n"
+              "PAR_OPEN: \\(;\nPAR_CLOSE: \\);\n\n");
+  fprintf(fp, "%%token IDENT NUMBER EQ SEMI PLUS ASTERISK PAR_OPEN PAR_CLOSE");
+  for (n = 0; n < num_keywords; ++n) {
+    fprintf(fp, " K%d", n);
+  }
+  fprintf(fp, "\n%%nt program stmt expr term factor\n\n%%grammar%%\n\n%%params size_t *num_stmts\n\n");
+  fprintf(fp, "program: ;\nprogram: program stmt { ++*num_stmts; }\n");
+  for (n = 0; n < num_keywords; ++n) {
+    fprintf(fp, "stmt: K%d IDENT EQ expr SEMI;\n", n);
+  }
+  fprintf(fp, "expr: term;\nexpr: expr PLUS term;\nterm: factor;\nterm: term ASTERISK factor;\n"
+              "factor: IDENT;\nfactor: NUMBER;\nfactor: PAR_OPEN expr PAR_CLOSE;\n");
+  fprintf(fp, "\n%%%%\n\n%s", driver);
+
+  if (fclose(fp)) {
+    fprintf(stderr, "Failed to write \"%s\"\n", filename);
+    return -1;
+  }
+  return 0;
+}
+
+static int write_input(const char *filename, size_t size, int num_keywords, unsigned seed) {
+  /* Statements whose keyword is drawn from a Zipf distribution, rank i with weight 1 / (i + 1),
+   * over a shuffled order of the keywords so the frequent ones are not the first constructed. */
+  size_t n = 0;
+  int k;
+  char kw[32];
+  int *order = (int *)malloc(sizeof(int) * (size_t)num_keywords);
+  double *cumulative = (double *)malloc(sizeof(double) * (size_t)num_keywords);
+  FILE *fp = fopen(filename, "wb");
+  if (!order || !cumulative || !fp) {
+    fprintf(stderr, "Failed to open \"%s\" for writing\n", filename);
+    free(order);
+    free(cumulative);
+    if (fp) fclose(fp);
+    return -1;
+  }
+  srand(1);
+  for (k = 0; k < num_keywords; ++k) {
+    order[k] = k;
+  }
+  for (k = num_keywords - 1; k > 0; --k) {
+    int j = rand() % (k + 1);
+    int t = order[k];
+    order[k] = order[j];
+    order[j] = t;
+  }
+  double sum = 0.;
+  for (k = 0; k < num_keywords; ++k) {
+    sum += 1. / (double)(k + 1);
+    cumulative[k] = sum;
+  }
+  srand(seed);
+  while (n < size) {
+    double u = sum * (double)rand() / ((double)RAND_MAX + 1.);
+    int lo = 0, hi = num_keywords - 1;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (cumulative[mid] <= u) lo = mid + 1;
+      else hi = mid;
+    }
+    keyword(order[lo], kw);
+    int written = fprintf(fp, "%s x%d = ", kw, rand() % 100);
+    int num_terms = 1 + rand() % 4;
+    while (num_terms--) {
+      switch (rand() % 3) {
+        case 0: written += fprintf(fp, "%d", rand() % 1000); break;
+        case 1: written += fprintf(fp, "v%d", rand() % 10); break;
+        case 2: written += fprintf(fp, "(y * %d)", rand() % 10); break;
+      }
+      if (num_terms) written += fprintf(fp, (rand() % 2) ? " + " : " * ");
+    }
+    written += fprintf(fp, ";\n");
+    n += (size_t)written;
+  }
+  free(order);
+  free(cumulative);
+  if (fclose(fp)) {
+    fprintf(stderr, "Failed to write \"%s\"\n", filename);
+    return -1;
+  }
+  return 0;
+}
+
+static double wall_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int run_timed(const char *command, double *elapsed) {
+  fflush(stdout);
+  double start = wall_clock();
+  if (system(command)) {
+    fprintf(stderr, "Failed: %s\n", command);
+    return -1;
+  }
+  *elapsed = wall_clock() - start;
+  return 0;
+}
+
+/* Generates the parser with the flags given and compiles it to <work-dir>/profbench_<name> */
+static int build(const char *carburetta, const char *cc, const char *dir, const char *name, const char *flags, const char *defines) {
+  char grammar[1024], output[1024], program[1024], command[4096];
+  double generation_time, compile_time;
+  snprintf(grammar, sizeof(grammar), "%s/profbench.cbrt", dir);
+  snprintf(output, sizeof(output), "%s/profbench_%s.c", dir, name);
+  snprintf(program, sizeof(program), "%s/profbench_%s", dir, name);
+  snprintf(command, sizeof(command), "\"%s\"%s \"%s\" --c \"%s\"", carburetta, flags, grammar, output);
+  if (run_timed(command, &generation_time)) return -1;
+  snprintf(command, sizeof(command), "%s -O2%s -o \"%s\" \"%s\"", cc, defines, program, output);
+  if (run_timed(command, &compile_time)) return -1;
+  printf("%-10s: generated in %.3fs, compiled in %.3fs, ", name, generation_time, compile_time);
+  return 0;
+}
+
+static int run(const char *dir, const char *name, const char *input, const char *profile) {
+  char command[4096];
+  fflush(stdout);
+  snprintf(command, sizeof(command), "\"%s/profbench_%s\" \"%s\"%s%s%s", dir, name, input,
+           profile ? " \"" : "", profile ? profile : "", profile ? "\"" : "");
+  if (system(command)) {
+    fprintf(stderr, "\nFailed: %s\n", command);
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int num_keywords = 500;
+  int input_megabytes = 16;
+  if ((argc < 4) || (argc > 6)) {
+    fprintf(stderr, "Usage: profbench <carburetta> <cc> <work-dir> [<num-keywords> [<input-megabytes>]]\n");
+    return EXIT_FAILURE;
+  }
+  if (argc > 4) num_keywords = atoi(argv[4]);
+  if (argc > 5) input_megabytes = atoi(argv[5]);
+  if ((num_keywords < 1) || (input_megabytes < 1)) {
+    fprintf(stderr, "A positive number of keywords and megabytes of input are needed\n");
+    return EXIT_FAILURE;
+  }
+
+  const char *carburetta = argv[1], *cc = argv[2], *dir = argv[3];
+  char grammar[1024], training[1024], input[1024], profile[1024], flags[1100];
+  snprintf(grammar, sizeof(grammar), "%s/profbench.cbrt", dir);
+  snprintf(training, sizeof(training), "%s/profbench_training.txt", dir);
+  snprintf(input, sizeof(input), "%s/profbench.txt", dir);
+  snprintf(profile, sizeof(profile), "%s/profbench.profile", dir);
+  if (write_grammar(grammar, num_keywords)) return EXIT_FAILURE;
+  if (write_input(training, (size_t)input_megabytes << 18, num_keywords, 2)) return EXIT_FAILURE;
+  if (write_input(input, (size_t)input_megabytes << 20, num_keywords, 3)) return EXIT_FAILURE;
+
+  /* Collect the profile on a quarter of the input size, from a different seed */
+  if (build(carburetta, cc, dir, "instrument", " --instrument", " -DPROFBENCH_INSTRUMENT")) return EXIT_FAILURE;
+  if (run(dir, "instrument", training, profile)) return EXIT_FAILURE;
+
+  if (build(carburetta, cc, dir, "plain", "", "")) return EXIT_FAILURE;
+  if (run(dir, "plain", input, NULL)) return EXIT_FAILURE;
+
+  snprintf(flags, sizeof(flags), " --profile \"%s\"", profile);
+  if (build(carburetta, cc, dir, "profiled", flags, "")) return EXIT_FAILURE;
+  if (run(dir, "profiled", input, NULL)) return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,200 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Reader benchmark: writes a scanner for words and numbers and compiles it twice, once reading its
+ * standard input with read() between scans, once through the background reader of
+ * runtime/cbrt_reader.c, and compares the throughput of both on a large file, read from disk and
+ * through a pipe from cat. The scanners are compiled with the C compiler given.
+ *
+ * Usage: readbench <carburetta> <cc> <runtime-dir> <work-dir> [<input-megabytes> [<buffer-kilobytes>]]
+ *
+ * The file is read from the page cache once it has been written, drop the caches between runs
+ * (as root: echo 3 > /proc/sys/vm/drop_caches) to measure reading from the disk itself. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Driver appended to the grammar, main() scans standard input and reports the time it took */
+static const char driver[] =
+  "#include <time.h>\n"
+  "#include <unistd.h>\n"
+  "#ifdef READBENCH_THREADED\n"
+  "#include \"cbrt_reader.h\"\n"
+  "#endif\n"
+  "\n"
+  "static double readbench_clock(void) {\n"
+  "  struct timespec ts;\n"
+  "  clock_gettime(CLOCK_MONOTONIC, &ts);\n"
+  "  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;\n"
+  "}\n"
+  "\n"
+  "int main(int argc, char **argv) {\n"
+  "  size_t buffer_size = (argc == 2) ? (size_t)atoi(argv[1]) * 1024 : 0;\n"
+  "  struct readbench_stack stack;\n"
+  "  size_t num_tokens = 0, total = 0;\n"
+  "  int r;\n"
+  "  double start = readbench_clock();\n"
+  "  readbench_stack_init(&stack);\n"
+  "#ifdef READBENCH_THREADED\n"
+  "  struct cbrt_reader *reader;\n"
+  "  if (cbrt_reader_open_fd(0, buffer_size, 0, &reader)) return EXIT_FAILURE;\n"
+  "  do {\n"
+  "    const char *data;\n"
+  "    size_t size;\n"
+  "    int is_final;\n"
+  "    if (cbrt_reader_next(reader, &data, &size, &is_final)) return EXIT_FAILURE;\n"
+  "    total += size;\n"
+  "    readbench_set_input(&stack, data, size, is_final);\n"
+  "    r = readbench_scan(&stack, &num_tokens);\n"
+  "  } while (r == _READBENCH_FEED_ME);\n"
+  "  cbrt_reader_close(reader);\n"
+  "#else\n"
+  "  char *buf = (char *)malloc(buffer_size);\n"
+  "  if (!buf) return EXIT_FAILURE;\n"
+  "  do {\n"
+  "    ssize_t size = read(0, buf, buffer_size);\n"
+  "    if (size < 0) return EXIT_FAILURE;\n"
+  "    total += (size_t)size;\n"
+  "    readbench_set_input(&stack, buf, (size_t)size, !size);\n"
+  "    r = readbench_scan(&stack, &num_tokens);\n"
+  "  } while (r == _READBENCH_FEED_ME);\n"
+  "  free(buf);\n"
+  "#endif\n"
+  "  readbench_stack_cleanup(&stack);\n"
+  "  double elapsed = readbench_clock() - start;\n"
+  "  if (r != _READBENCH_FINISH) {\n"
+  "    fprintf(stderr, \"Scan failed (%d)\\n\", r);\n"
+  "    return EXIT_FAILURE;\n"
+  "  }\n"
+  "  printf(\"%zu tokens, %.1f MB/s\\n\", num_tokens, (double)total / elapsed / 1e6);\n"
+  "  return EXIT_SUCCESS;\n"
+  "}\n";
+
+static int write_grammar(const char *filename) {
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) {
+    fprintf(stderr, "Failed to open \"%s\" for writing\n", filename);
+    return -1;
+  }
+
+  fprintf(fp, "#include <stdio.h>\n#include <stdlib.h>\n\n");
+  fprintf(fp, "%%scanner%%\n%%prefix readbench_\n%%params size_t *num_tokens\n\n: [\\ \\n]+;\n"
+              ": \\p{L}+ { ++*num_tokens; }\n: [0-9]+ { ++*num_tokens; }\n: [\\.\\,] { ++*num_tokens; }\n");
+  fprintf(fp, "\n%%%%\n\n%s", driver);
+
+  if (fclose(fp)) {
+    fprintf(stderr, "Failed to write \"%s\"\n", filename);
+    return -1;
+  }
+  return 0;
+}
+
+static int write_input(const char *filename, size_t size) {
+  /* Random words of lowercase letters and numbers, with some punctuation */
+  size_t n = 0;
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) {
+    fprintf(stderr, "Failed to open \"%s\" for writing\n", filename);
+    return -1;
+  }
+  srand(1);
+  while (n < size) {
+    int word_length = 1 + rand() % 12;
+    int is_number = !(rand() % 5);
+    while (word_length--) {
+      fputc(is_number ? '0' + rand() % 10 : 'a' + rand() % 26, fp);
+      n++;
+    }
+    if (!(rand() % 10)) {
+      fputc((rand() % 2) ? '.' : ',', fp);
+      n++;
+    }
+    fputc((rand() % 12) ? ' ' : '\n', fp);
+    n++;
+  }
+  if (fclose(fp)) {
+    fprintf(stderr, "Failed to write \"%s\"\n", filename);
+    return -1;
+  }
+  return 0;
+}
+
+static int run(const char *command) {
+  fflush(stdout);
+  if (system(command)) {
+    fprintf(stderr, "\nFailed: %s\n", command);
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int input_megabytes = 64;
+  int buffer_kilobytes = 256;
+  int threaded, from_pipe, n;
+  if ((argc < 5) || (argc > 7)) {
+    fprintf(stderr, "Usage: readbench <carburetta> <cc> <runtime-dir> <work-dir> [<input-megabytes> [<buffer-kilobytes>]]\n");
+    return EXIT_FAILURE;
+  }
+  if (argc > 5) input_megabytes = atoi(argv[5]);
+  if (argc > 6) buffer_kilobytes = atoi(argv[6]);
+  if ((input_megabytes < 1) || (buffer_kilobytes < 1)) {
+    fprintf(stderr, "A positive number of megabytes of input and kilobytes of buffer are needed\n");
+    return EXIT_FAILURE;
+  }
+
+  const char *runtime = argv[3], *dir = argv[4];
+  char grammar[1024], input[1024], output[1024], program[1024], command[4096];
+  snprintf(grammar, sizeof(grammar), "%s/readbench.cbrt", dir);
+  snprintf(input, sizeof(input), "%s/readbench.txt", dir);
+  if (write_grammar(grammar)) return EXIT_FAILURE;
+  if (write_input(input, (size_t)input_megabytes << 20)) return EXIT_FAILURE;
+
+  for (threaded = 0; threaded < 2; ++threaded) {
+    const char *mode = threaded ? "threaded" : "read";
+    snprintf(output, sizeof(output), "%s/readbench_%s.c", dir, mode);
+    snprintf(program, sizeof(program), "%s/readbench_%s", dir, mode);
+    snprintf(command, sizeof(command), "\"%s\" \"%s\" --c \"%s\"", argv[1], grammar, output);
+    if (run(command)) return EXIT_FAILURE;
+    if (threaded) {
+      snprintf(command, sizeof(command), "%s -O2 -DREADBENCH_THREADED -I\"%s\" -o \"%s\" \"%s\" \"%s/cbrt_reader.c\" -pthread",
+               argv[2], runtime, program, output, runtime);
+    }
+    else {
+      snprintf(command, sizeof(command), "%s -O2 -o \"%s\" \"%s\"", argv[2], program, output);
+    }
+    if (run(command)) return EXIT_FAILURE;
+  }
+
+  /* Alternate between the two so neither is favoured by what the other left in the caches */
+  for (from_pipe = 0; from_pipe < 2; ++from_pipe) {
+    for (n = 0; n < 3; ++n) {
+      for (threaded = 0; threaded < 2; ++threaded) {
+        const char *mode = threaded ? "threaded" : "read";
+        printf("%-8s %-4s run %d: ", mode, from_pipe ? "pipe" : "file", n + 1);
+        if (from_pipe) {
+          snprintf(command, sizeof(command), "cat \"%s\" | \"%s/readbench_%s\" %d", input, dir, mode, buffer_kilobytes);
+        }
+        else {
+          snprintf(command, sizeof(command), "\"%s/readbench_%s\" %d < \"%s\"", dir, mode, buffer_kilobytes, input);
+        }
+        if (run(command)) return EXIT_FAILURE;
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
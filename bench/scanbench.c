@@ -0,0 +1,204 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Scanner benchmark: writes a grammar whose patterns make the DFA explode, then generates its
+ * scanner both ahead of time and with --lazy-dfa, and compares the time to generate, the size of
+ * the tables and the throughput of each. The scanners are compiled with the C compiler given.
+ *
+ * Usage: scanbench <carburetta> <cc> <work-dir> [<num-patterns> [<tail-length> [<max-states>]]]
+ *
+ * Pattern i is any run of letters, followed by the i-th lowercase letter, followed by exactly
+ * <tail-length> more letters:
+ *   \p{L}*c\p{L}\p{L}...\p{L}
+ * so the DFA must remember which of the last <tail-length> + 1 letters was which of the pattern
+ * letters, in the order of <num-patterns> ^ <tail-length> states. The input is random words of
+ * letters, most of which the fallback pattern \p{L}+ also matches; only the states the input
+ * actually reaches are determinized by the lazy scanner. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Driver appended to the grammar, main() scans the input file given 3 times and reports the best */
+static const char driver[] =
+  "#include <time.h>\n"
+  "\n"
+  "static double scanbench_clock(void) {\n"
+  "  struct timespec ts;\n"
+  "  clock_gettime(CLOCK_MONOTONIC, &ts);\n"
+  "  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;\n"
+  "}\n"
+  "\n"
+  "int main(int argc, char **argv) {\n"
+  "  FILE *fp = (argc == 2) ? fopen(argv[1], \"rb\") : NULL;\n"
+  "  if (!fp) return EXIT_FAILURE;\n"
+  "  fseek(fp, 0, SEEK_END);\n"
+  "  size_t size = (size_t)ftell(fp);\n"
+  "  fseek(fp, 0, SEEK_SET);\n"
+  "  char *input = (char *)malloc(size ? size : 1);\n"
+  "  if (!input || (fread(input, 1, size, fp) != size)) return EXIT_FAILURE;\n"
+  "  fclose(fp);\n"
+  "  size_t num_tokens = 0;\n"
+  "  double best = 0.;\n"
+  "  int run;\n"
+  "  for (run = 0; run < 3; ++run) {\n"
+  "    struct scanbench_stack stack;\n"
+  "    scanbench_stack_init(&stack);\n"
+  "    num_tokens = 0;\n"
+  "    double start = scanbench_clock();\n"
+  "    scanbench_set_input(&stack, input, size, 1);\n"
+  "    int r = scanbench_scan(&stack, &num_tokens);\n"
+  "    double elapsed = scanbench_clock() - start;\n"
+  "    scanbench_stack_cleanup(&stack);\n"
+  "    if (r != _SCANBENCH_FINISH) {\n"
+  "      fprintf(stderr, \"Scan failed (%d)\\n\", r);\n"
+  "      return EXIT_FAILURE;\n"
+  "    }\n"
+  "    if (!run || (elapsed < best)) best = elapsed;\n"
+  "  }\n"
+  "#ifdef SCANBENCH_LAZY\n"
+  "  size_t table_size = sizeof(scanbench_scan_nfa_nodes_) + sizeof(scanbench_scan_nfa_trans_) +\n"
+  "                      sizeof(scanbench_scan_nfa_mode_starts_) + sizeof(scanbench_scan_lazy_group_symbols_);\n"
+  "#else\n"
+  "  size_t table_size = sizeof(scanbench_scan_table_grouped_rex_) + sizeof(scanbench_scan_actions_rex);\n"
+  "#endif\n"
+  "  table_size += sizeof(scanbench_utf8_decoder_);\n"
+  "  printf(\"%zu table bytes, %zu tokens, %.1f MB/s\\n\", table_size, num_tokens, (double)size / best / 1e6);\n"
+  "  free(input);\n"
+  "  return EXIT_SUCCESS;\n"
+  "}\n";
+
+static int write_grammar(const char *filename, int num_patterns, int tail_length) {
+  int n, k;
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) {
+    fprintf(stderr, "Failed to open \"%s\" for writing\n", filename);
+    return -1;
+  }
+
+  fprintf(fp, "#include <stdio.h>\n#include <stdlib.h>\n\n");
+  fprintf(fp, "%%scanner%%\n%%prefix scanbench_\n%%params size_t *num_tokens\n\n: [\\ \\n]+;\n");
+  for (n = 0; n < num_patterns; ++n) {
+    fprintf(fp, ": \\p{L}*%c", 'a' + n);
+    for (k = 0; k < tail_length; ++k) {
+      fprintf(fp, "\\p{L}");
+    }
+    fprintf(fp, " { ++*num_tokens; }\n");
+  }
+  fprintf(fp, ": \\p{L}+ { ++*num_tokens; }\n");
+  fprintf(fp, "\n%%%%\n\n%s", driver);
+
+  if (fclose(fp)) {
+    fprintf(stderr, "Failed to write \"%s\"\n", filename);
+    return -1;
+  }
+  return 0;
+}
+
+static int write_input(const char *filename, size_t size) {
+  /* Random words of lowercase letters, with an occasional two byte UTF-8 letter (e-acute) */
+  size_t n = 0;
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) {
+    fprintf(stderr, "Failed to open \"%s\" for writing\n", filename);
+    return -1;
+  }
+  srand(1);
+  while (n < size) {
+    int word_length = 1 + rand() % 24;
+    while (word_length--) {
+      if (!(rand() % 16)) {
+        fputs("\xC3\xA9", fp);
+        n += 2;
+      }
+      else {
+        fputc('a' + rand() % 26, fp);
+        n++;
+      }
+    }
+    fputc((rand() % 8) ? ' ' : '\n', fp);
+    n++;
+  }
+  if (fclose(fp)) {
+    fprintf(stderr, "Failed to write \"%s\"\n", filename);
+    return -1;
+  }
+  return 0;
+}
+
+static double wall_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int run_timed(const char *command, double *elapsed) {
+  fflush(stdout);
+  double start = wall_clock();
+  if (system(command)) {
+    fprintf(stderr, "Failed: %s\n", command);
+    return -1;
+  }
+  *elapsed = wall_clock() - start;
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int num_patterns = 4;
+  int tail_length = 3;
+  int max_states = 4096;
+  int lazy;
+  if ((argc < 4) || (argc > 7)) {
+    fprintf(stderr, "Usage: scanbench <carburetta> <cc> <work-dir> [<num-patterns> [<tail-length> [<max-states>]]]\n");
+    return EXIT_FAILURE;
+  }
+  if (argc > 4) num_patterns = atoi(argv[4]);
+  if (argc > 5) tail_length = atoi(argv[5]);
+  if (argc > 6) max_states = atoi(argv[6]);
+  if ((num_patterns < 1) || (num_patterns > 26) || (tail_length < 0) || (max_states < 1)) {
+    fprintf(stderr, "Between 1 and 26 patterns, and a positive number of states, are needed\n");
+    return EXIT_FAILURE;
+  }
+
+  char grammar[1024], input[1024], output[1024], program[1024], command[4096];
+  snprintf(grammar, sizeof(grammar), "%s/scanbench.cbrt", argv[3]);
+  snprintf(input, sizeof(input), "%s/scanbench.txt", argv[3]);
+  if (write_grammar(grammar, num_patterns, tail_length)) return EXIT_FAILURE;
+  if (write_input(input, 16 << 20)) return EXIT_FAILURE;
+
+  for (lazy = 0; lazy < 2; ++lazy) {
+    double generation_time, compile_time;
+    const char *mode = lazy ? "lazy" : "eager";
+    char lazy_flag[64] = "";
+    if (lazy) snprintf(lazy_flag, sizeof(lazy_flag), " --lazy-dfa %d", max_states);
+    snprintf(output, sizeof(output), "%s/scanbench_%s.c", argv[3], mode);
+    snprintf(program, sizeof(program), "%s/scanbench_%s", argv[3], mode);
+
+    snprintf(command, sizeof(command), "\"%s\"%s \"%s\" --c \"%s\"", argv[1], lazy_flag, grammar, output);
+    if (run_timed(command, &generation_time)) return EXIT_FAILURE;
+    snprintf(command, sizeof(command), "%s -O2%s -o \"%s\" \"%s\"", argv[2], lazy ? " -DSCANBENCH_LAZY" : "", program, output);
+    if (run_timed(command, &compile_time)) return EXIT_FAILURE;
+
+    printf("%-5s: generated in %.3fs, compiled in %.3fs, ", mode, generation_time, compile_time);
+    fflush(stdout);
+    snprintf(command, sizeof(command), "\"%s\" \"%s\"", program, input);
+    if (system(command)) {
+      fprintf(stderr, "\nFailed: %s\n", command);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,264 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Tilly benchmark: writes a tile grammar over many symbols, generates its matcher with the tilly
+ * given, and times labeling random subject trees with it. The matcher is compiled with the C
+ * compiler given. To compare two versions of tilly, run the benchmark with each; the checksum of
+ * the costs, tiles and states labeled must come out the same.
+ *
+ * Usage: tillybench <tilly> <cc> <work-dir> [<num-symbols> [<num-tiles> [<kilo-nodes>]]]
+ *
+ * Symbol i has i % 3 operands, each symbol has a tile reducing it to "reg" from "reg" operands,
+ * "addr" is a chain rule from "reg", and the remaining tiles are random patterns of up to three
+ * levels of symbols. Their prefixes overlap, so a transition the matcher takes often falls back
+ * along the failure function of the pattern automaton. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Maximum depth of the patterns of the random tiles, and of the random subject trees */
+#define TILLYBENCH_MAX_TILE_DEPTH 3
+#define TILLYBENCH_MAX_TREE_DEPTH 10
+
+/* Driver following the matcher, main() labels the trees 3 times and reports the best */
+static const char driver[] =
+  "static unsigned tillybench_seed_ = 1;\n"
+  "\n"
+  "static unsigned tillybench_rand(void) {\n"
+  "  tillybench_seed_ = tillybench_seed_ * 1103515245u + 12345u;\n"
+  "  return (tillybench_seed_ >> 8) & 0xFFFFFF;\n"
+  "}\n"
+  "\n"
+  "static double tillybench_clock(void) {\n"
+  "  struct timespec ts;\n"
+  "  clock_gettime(CLOCK_MONOTONIC, &ts);\n"
+  "  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;\n"
+  "}\n"
+  "\n"
+  "static struct subject_node *tillybench_tree(struct subject_node *pool, size_t *num_nodes,\n"
+  "                                            struct subject_node *parent, size_t operand_index, int depth) {\n"
+  "  struct subject_node *sn = pool + (*num_nodes)++;\n"
+  "  size_t sym = tillybench_rand() % NUM_SYMS;\n"
+  "  /* Symbols without operands are those at multiples of 3 */\n"
+  "  if (depth >= TILLYBENCH_MAX_TREE_DEPTH) sym -= sym % 3;\n"
+  "  memset(sn, 0, sizeof(*sn));\n"
+  "  sn->symbol_index_ = sym;\n"
+  "  sn->operand_index_in_parent_ = operand_index;\n"
+  "  sn->parent_ = parent;\n"
+  "  size_t n;\n"
+  "  for (n = 0; n < (sym % 3); ++n) {\n"
+  "    sn->children_[n] = tillybench_tree(pool, num_nodes, sn, n, depth + 1);\n"
+  "  }\n"
+  "  return sn;\n"
+  "}\n"
+  "\n"
+  "int main(int argc, char **argv) {\n"
+  "  size_t max_nodes = (argc == 2) ? (size_t)atoi(argv[1]) * 1024 : 0;\n"
+  "  /* A tree holds at most 2^(TILLYBENCH_MAX_TREE_DEPTH + 1) nodes */\n"
+  "  size_t tree_room = (size_t)2 << TILLYBENCH_MAX_TREE_DEPTH;\n"
+  "  struct subject_node *pool = (struct subject_node *)malloc(sizeof(*pool) * (max_nodes + tree_room));\n"
+  "  struct subject_node **roots = (struct subject_node **)malloc(sizeof(*roots) * (max_nodes + 1));\n"
+  "  if (!max_nodes || !pool || !roots) {\n"
+  "    fprintf(stderr, \"No room for %zu subject nodes of %zu bytes\\n\", max_nodes, sizeof(*pool));\n"
+  "    return EXIT_FAILURE;\n"
+  "  }\n"
+  "  size_t num_nodes = 0, num_roots = 0, n, k;\n"
+  "  while (num_nodes < max_nodes) {\n"
+  "    roots[num_roots++] = tillybench_tree(pool, &num_nodes, NULL, 0, 0);\n"
+  "  }\n"
+  "  double best = 0.;\n"
+  "  int run;\n"
+  "  for (run = 0; run < 3; ++run) {\n"
+  "    /* Leaves keep the costs they have when visited */\n"
+  "    for (n = 0; n < num_nodes; ++n) {\n"
+  "      for (k = 0; k < NUM_LABELS; ++k) {\n"
+  "        pool[n].reduction_cost_[k] = INT_MAX;\n"
+  "        pool[n].reduction_tile_[k] = SIZE_MAX;\n"
+  "      }\n"
+  "    }\n"
+  "    double start = tillybench_clock();\n"
+  "    for (n = 0; n < num_roots; ++n) {\n"
+  "      subject_node_visit(roots[n]);\n"
+  "    }\n"
+  "    double elapsed = tillybench_clock() - start;\n"
+  "    if (!run || (elapsed < best)) best = elapsed;\n"
+  "  }\n"
+  "  unsigned long long checksum = 0;\n"
+  "  for (n = 0; n < num_nodes; ++n) {\n"
+  "    for (k = 0; k < NUM_LABELS; ++k) {\n"
+  "      checksum = checksum * 31 + (unsigned long long)pool[n].reduction_cost_[k];\n"
+  "      checksum = checksum * 31 + (unsigned long long)pool[n].reduction_tile_[k];\n"
+  "    }\n"
+  "    checksum = checksum * 31 + (pool[n].state_ ? (unsigned long long)(pool[n].state_ - nodes_) : 0);\n"
+  "  }\n"
+  "  printf(\"%zu table bytes, %zu nodes, checksum %016llx, %.1f M nodes/s\\n\",\n"
+  "         sizeof(nodes_) + sizeof(acceptances_), num_nodes, checksum, (double)num_nodes / best / 1e6);\n"
+  "  free(pool);\n"
+  "  free(roots);\n"
+  "  return EXIT_SUCCESS;\n"
+  "}\n";
+
+/* Writes a random pattern rooted at a symbol with operands; the operands are "reg", "addr",
+ * symbols without operands, or, above the maximum depth, nested patterns. The terms of the cost,
+ * those of the labels found at the end of their path of operand indices, are written to cost. */
+static void write_pattern(FILE *fp, FILE *cost, int num_symbols, int depth, char *path, size_t path_len) {
+  /* Symbols with operands are those not at multiples of 3 */
+  int sym = rand() % num_symbols;
+  if (!(sym % 3)) sym = (sym + 1 < num_symbols) ? sym + 1 : 1;
+  int n;
+  fprintf(fp, "s%d(", sym);
+  for (n = 0; n < (sym % 3); ++n) {
+    if (n) fprintf(fp, ", ");
+    int k = (int)snprintf(path + path_len, 16, "%s%d", path_len ? "." : "", n);
+    int choice = rand() % 4;
+    if ((depth + 1 < TILLYBENCH_MAX_TILE_DEPTH) && (choice >= 2)) {
+      write_pattern(fp, cost, num_symbols, depth + 1, path, path_len + (size_t)k);
+    }
+    else if ((choice == 1) && (num_symbols > 3)) {
+      /* A symbol without operands, contributes no cost */
+      fprintf(fp, "s%d", 3 * (rand() % ((num_symbols + 2) / 3)));
+    }
+    else {
+      fprintf(fp, "%s", (choice == 3) ? "addr" : "reg");
+      fprintf(cost, " + $@%s$", path);
+    }
+    path[path_len] = '\0';
+  }
+  fprintf(fp, ")");
+}
+
+static int write_grammar(const char *filename, int num_symbols, int num_tiles) {
+  int n;
+  FILE *fp = fopen(filename, "wb");
+  FILE *cost = tmpfile();
+  if (!fp || !cost) {
+    fprintf(stderr, "Failed to open \"%s\" for writing\n", filename);
+    if (fp) fclose(fp);
+    if (cost) fclose(cost);
+    return -1;
+  }
+
+  fprintf(fp, "%%labels reg addr\n%%symbols");
+  for (n = 0; n < num_symbols; ++n) {
+    fprintf(fp, " s%d", n);
+  }
+  fprintf(fp, "\n%%%%\n");
+  fprintf(fp, "addr: reg { cost = $@$; } = { }\n");
+  for (n = 0; n < num_symbols; ++n) {
+    switch (n % 3) {
+      case 0: fprintf(fp, "reg: s%d { cost = 1; } = { }\n", n); break;
+      case 1: fprintf(fp, "reg: s%d(reg) { cost = 1 + $@0$; } = { }\n", n); break;
+      case 2: fprintf(fp, "reg: s%d(reg, reg) { cost = 1 + $@0$ + $@1$; } = { }\n", n); break;
+    }
+  }
+  srand(1);
+  for (n = num_symbols + 1; n < num_tiles; ++n) {
+    char path[TILLYBENCH_MAX_TILE_DEPTH * 16 + 1] = "";
+    char cost_expr[1024];
+    rewind(cost);
+    fprintf(fp, "%s: ", (rand() % 4) ? "reg" : "addr");
+    write_pattern(fp, cost, num_symbols, 0, path, 0);
+    long cost_len = ftell(cost);
+    rewind(cost);
+    if ((cost_len < 0) || ((size_t)cost_len >= sizeof(cost_expr))) cost_len = 0;
+    cost_expr[fread(cost_expr, 1, (size_t)cost_len, cost)] = '\0';
+    fprintf(fp, " { cost = %d%s; } = { }\n", 1 + rand() % 3, cost_expr);
+  }
+  fclose(cost);
+
+  if (fclose(fp)) {
+    fprintf(stderr, "Failed to write \"%s\"\n", filename);
+    return -1;
+  }
+  return 0;
+}
+
+static int write_driver(const char *filename) {
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) {
+    fprintf(stderr, "Failed to open \"%s\" for writing\n", filename);
+    return -1;
+  }
+  fprintf(fp, "#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n#include <time.h>\n\n"
+              "#include \"tillybench_matcher.c\"\n\n"
+              "#define TILLYBENCH_MAX_TREE_DEPTH %d\n\n%s", TILLYBENCH_MAX_TREE_DEPTH, driver);
+  if (fclose(fp)) {
+    fprintf(stderr, "Failed to write \"%s\"\n", filename);
+    return -1;
+  }
+  return 0;
+}
+
+static double wall_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int run_timed(const char *command, double *elapsed) {
+  fflush(stdout);
+  double start = wall_clock();
+  if (system(command)) {
+    fprintf(stderr, "Failed: %s\n", command);
+    return -1;
+  }
+  *elapsed = wall_clock() - start;
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int num_symbols = 60;
+  int num_tiles = 200;
+  int kilo_nodes = 1024;
+  if ((argc < 4) || (argc > 7)) {
+    fprintf(stderr, "Usage: tillybench <tilly> <cc> <work-dir> [<num-symbols> [<num-tiles> [<kilo-nodes>]]]\n");
+    return EXIT_FAILURE;
+  }
+  if (argc > 4) num_symbols = atoi(argv[4]);
+  if (argc > 5) num_tiles = atoi(argv[5]);
+  if (argc > 6) kilo_nodes = atoi(argv[6]);
+  if ((num_symbols < 2) || (num_tiles <= num_symbols) || (kilo_nodes < 1)) {
+    fprintf(stderr, "At least 2 symbols, more tiles than symbols and a positive number of nodes are needed\n");
+    return EXIT_FAILURE;
+  }
+
+  const char *tilly = argv[1], *cc = argv[2], *dir = argv[3];
+  char grammar[1024], matcher[1024], log[1024], source[1024], program[1024], command[4096];
+  double generation_time, compile_time;
+  snprintf(grammar, sizeof(grammar), "%s/tillybench.tly", dir);
+  snprintf(matcher, sizeof(matcher), "%s/tillybench_matcher.c", dir);
+  snprintf(log, sizeof(log), "%s/tillybench.log", dir);
+  snprintf(source, sizeof(source), "%s/tillybench.c", dir);
+  snprintf(program, sizeof(program), "%s/tillybench", dir);
+  if (write_grammar(grammar, num_symbols, num_tiles)) return EXIT_FAILURE;
+  if (write_driver(source)) return EXIT_FAILURE;
+
+  /* Tilly reports the automaton it built on stdout, keep it out of the way */
+  snprintf(command, sizeof(command), "\"%s\" \"%s\" --c \"%s\" > \"%s\"", tilly, grammar, matcher, log);
+  if (run_timed(command, &generation_time)) return EXIT_FAILURE;
+  snprintf(command, sizeof(command), "%s -O2 -o \"%s\" \"%s\"", cc, program, source);
+  if (run_timed(command, &compile_time)) return EXIT_FAILURE;
+  printf("generated in %.3fs, compiled in %.3fs, ", generation_time, compile_time);
+
+  fflush(stdout);
+  snprintf(command, sizeof(command), "\"%s\" %d", program, kilo_nodes);
+  if (system(command)) {
+    fprintf(stderr, "\nFailed: %s\n", command);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -68,6 +68,11 @@
 #include "situs.h"
 #endif
 
+#ifndef PPTK_CACHE_H_INCLUDED
+#define PPTK_CACHE_H_INCLUDED
+#include "pptk_cache.h"
+#endif
+
 #define CC_FILE_FP_BUFFER_SIZE 16834
 
 static int cc_template_default_handler(struct c_compiler *cc, char *templ_str, size_t templ_str_len, struct stmt **new_stmt, struct situs *location);
@@ -92,12 +97,83 @@ int cc_printf(struct c_compiler *cc, const char *fmt, ...) {
   return r;
 }
 
+static size_t cc_dirname_len(const char *filename) {
+  size_t len = strlen(filename);
+  while (len && (filename[len - 1] != '/') && (filename[len - 1] != '\\')) --len;
+  return len;
+}
+
+/* Key for cc->include_files_; the file an #include resolves to depends only on its argument
+ * and, for #include "header.h", on the directories of the including files (searched from the
+ * innermost outwards.) The terminating '>' or '"' cannot appear in the argument, and each
+ * directory is prefixed with its length, so keys are unambiguous.
+ * Returns a malloc()ed key or NULL if no memory is available. */
+static char *cc_include_key(struct c_compiler *cc, const char *headername, int is_system_include) {
+  size_t headername_len = strlen(headername);
+  size_t key_size = headername_len + 2;
+  struct input_file *ifile, *prev;
+  size_t dir_len;
+  if (!is_system_include) {
+    for (ifile = cc->input_stack_; ifile; ifile = ifile->containing_file_) {
+      key_size += cc_dirname_len(ifile->filename_) + 21 /* length digits and ':' */;
+    }
+  }
+  char *key = (char *)malloc(key_size);
+  if (!key) return NULL;
+  memcpy(key, headername, headername_len);
+  char *p = key + headername_len;
+  *p++ = is_system_include ? '>' : '"';
+  if (!is_system_include) {
+    for (ifile = cc->input_stack_; ifile; ifile = ifile->containing_file_) {
+      dir_len = cc_dirname_len(ifile->filename_);
+      for (prev = cc->input_stack_; prev != ifile; prev = prev->containing_file_) {
+        if ((cc_dirname_len(prev->filename_) == dir_len) && !memcmp(prev->filename_, ifile->filename_, dir_len)) break;
+      }
+      if (prev != ifile) {
+        /* Directory already searched */
+        continue;
+      }
+      p += sprintf(p, "%zu:", dir_len);
+      memcpy(p, ifile->filename_, dir_len);
+      p += dir_len;
+    }
+  }
+  *p = '\0';
+  return key;
+}
+
+static int cc_include_file_is_guarded(struct c_compiler *cc, const char *filename) {
+  struct cc_include_guard *guard = (struct cc_include_guard *)st_find(&cc->include_guards_, filename);
+  return guard && st_find(&cc->macro_table_, guard->macro_);
+}
+
+int cc_include_is_guarded(struct c_compiler *cc, const char *headername, int is_system_include) {
+  char *key = cc_include_key(cc, headername, is_system_include);
+  if (!key) return 0;
+  struct cc_include_file *inc = (struct cc_include_file *)st_find(&cc->include_files_, key);
+  free(key);
+  return inc && cc_include_file_is_guarded(cc, inc->filename_);
+}
+
 static struct input_file *cc_push_input_file(struct c_compiler *cc, const char *filename, size_t aux_data) {
   char *sf = cc_preserve_filename(cc, filename);
   if (!sf) return NULL;
+  int is_include = cc->pp_include_pending_ && cc->input_stack_ && !cc->pp_include_is_template_emit_;
+  cc->pp_include_pending_ = 0;
+  if (is_include) {
+    /* Remember what the #include resolved to; failing to do so only loses the optimization. */
+    char *key = cc_include_key(cc, cc->pp_include_file_arg_, cc->pp_include_is_system_include_);
+    if (key) {
+      int is_new = 0;
+      struct cc_include_file *inc = (struct cc_include_file *)st_find_or_insert(&cc->include_files_, key, &is_new, sizeof(struct cc_include_file));
+      if (inc) {
+        inc->filename_ = sf;
+      }
+      free(key);
+    }
+  }
   struct input_file *ifile = (struct input_file *)malloc(sizeof(struct input_file) + aux_data);
   if (!ifile) {
-    free(sf);
     return NULL;
   }
   if_init(ifile, cc);
@@ -106,12 +182,28 @@ static struct input_file *cc_push_input_file(struct c_compiler *cc, const char *
   ifile->ppld_input_line_filename_ = NULL;
   ifile->pptk_input_line_ = 1;
   ifile->pptk_input_line_filename_ = sf;
+  if (is_include && cc_include_file_is_guarded(cc, sf)) {
+    /* Guarded file included under a different name; pop without reading it. */
+    ifile->ppld_end_processed_pop_now_ = 1;
+  }
   return ifile;
 }
 
 static void cc_pop_input_file(struct c_compiler *cc) {
   struct input_file *ifile = cc->input_stack_;
   if (ifile) {
+    if (ifile->ppld_end_processed_pop_now_ && (ifile->include_guard_state_ == IFIG_CLOSED)) {
+      /* Processed in its entirety, and entirely wrapped in an include guard */
+      int is_new = 0;
+      struct cc_include_guard *guard = (struct cc_include_guard *)st_find_or_insert(&cc->include_guards_, ifile->filename_, &is_new, sizeof(struct cc_include_guard));
+      if (guard) {
+        guard->macro_ = ifile->include_guard_macro_;
+      }
+    }
+    if (ifile->pptk_cache_recording_ && !cc->have_error_) {
+      /* Tokenized without diagnostics; failing to write the cache file is not an error. */
+      pptk_cache_write(cc->pptk_cache_dir_, &ifile->pptk_cache_->key_, &ifile->pptk_cache_->recorder_);
+    }
     if_cleanup(ifile);
     free(ifile);
   }
@@ -124,6 +216,8 @@ void cc_init(struct c_compiler *cc) {
   cc->mode_set_ = 0;
   cc->asm_decoration_char_ = '$';
 
+  pptk_arena_init(&cc->pptk_arena_);
+
   cc->ppme_input_final_ = 0;
   cc->ppme_input_ = NULL;
   cc->ppme_input_file_ = NULL;
@@ -139,6 +233,7 @@ void cc_init(struct c_compiler *cc) {
   cc->all_done_ = 0;
   cc->have_error_ = 0;
   cc->fatal_error_ = 0;
+  cc->eval_by_tree_walk_ = 0;
 
   cc->cp_input_final_ = 0;
   cc->cp_input_ = NULL;
@@ -151,6 +246,8 @@ void cc_init(struct c_compiler *cc) {
 
   cc->input_stack_ = NULL;
 
+  cc->pptk_cache_dir_ = NULL;
+
   type_base_init(&cc->tb_);
   ds_init(&cc->ds_);
   st_init(&cc->macro_table_);
@@ -182,6 +279,9 @@ void cc_init(struct c_compiler *cc) {
   cc->pp_include_is_system_include_ = 0;
   cc->pp_include_is_template_emit_ = 0;
   cc->pp_include_file_arg_ = NULL;
+  cc->pp_include_pending_ = 0;
+  st_init(&cc->include_files_);
+  st_init(&cc->include_guards_);
 
   cc->template_handler_ = cc_template_default_handler;
   cc->default_handler_fn_name_ = g_cc_default_handler_fn_name_;
@@ -189,8 +289,8 @@ void cc_init(struct c_compiler *cc) {
 }
 
 void cc_cleanup(struct c_compiler *cc) {
-  while (cc->macro_table_.root_) {
-    struct macro *m = (struct macro *)cc->macro_table_.root_;
+  while (cc->macro_table_.seq_) {
+    struct macro *m = (struct macro *)cc->macro_table_.seq_;
     st_remove(&cc->macro_table_, &m->sym_);
     macro_free(m);
   }
@@ -223,16 +323,36 @@ void cc_cleanup(struct c_compiler *cc) {
     free(cc->pp_include_file_arg_);
   }
 
+  while (cc->include_files_.seq_) {
+    struct cc_include_file *inc = (struct cc_include_file *)cc->include_files_.seq_;
+    st_remove(&cc->include_files_, &inc->sym_);
+    free(inc);
+  }
+  st_cleanup(&cc->include_files_);
+  while (cc->include_guards_.seq_) {
+    struct cc_include_guard *guard = (struct cc_include_guard *)cc->include_guards_.seq_;
+    st_remove(&cc->include_guards_, &guard->sym_);
+    free(guard);
+  }
+  st_cleanup(&cc->include_guards_);
+
+  if (cc->pptk_cache_dir_) {
+    free(cc->pptk_cache_dir_);
+  }
+
   if (cc->default_handler_fn_name_ != g_cc_default_handler_fn_name_) {
     free(cc->default_handler_fn_name_);
   }
-  while (cc->link_table_.root_) {
-    struct cc_link_name *name = (struct cc_link_name *)cc->link_table_.root_;
-    st_remove(&cc->link_table_, cc->link_table_.root_);
+  while (cc->link_table_.seq_) {
+    struct cc_link_name *name = (struct cc_link_name *)cc->link_table_.seq_;
+    st_remove(&cc->link_table_, cc->link_table_.seq_);
     free(name);
   }
 
   st_cleanup(&cc->link_table_);
+
+  /* Last, all tokens should have been returned to the arena by now. */
+  pptk_arena_cleanup(&cc->pptk_arena_);
 }
 
 char *cc_preserve_filename(struct c_compiler *cc, const char *filename) {
@@ -267,6 +387,7 @@ struct input_file *cc_push_input_file_fp(struct c_compiler *cc, const char *file
   if (!ifile) return NULL;
   ifile->fp_ = fp;
   ifile->input_request_fn_ = cc_file_fp_input_request_callback;
+  ifile->pptk_cache_lookup_pending_ = !!cc->pptk_cache_dir_;
   return ifile;
 }
 
@@ -286,11 +407,105 @@ struct input_file *cc_push_input_file_mem(struct c_compiler *cc, const char *fil
   struct mem_input_file *ifile = (struct mem_input_file *)cc_push_input_file(cc, filename, sizeof(struct mem_input_file) - sizeof(struct input_file));
   if (!ifile) return NULL;
   ifile->if_.input_request_fn_ = cc_file_mem_input_request_callback;
+  ifile->if_.pptk_cache_lookup_pending_ = !!cc->pptk_cache_dir_;
   ifile->mem_ = mem;
   ifile->memsize_ = memsize;
   return &ifile->if_;
 }
 
+int cc_set_pptk_cache_dir(struct c_compiler *cc, const char *cache_dir) {
+  char *dir = NULL;
+  if (cache_dir) {
+    size_t len = strlen(cache_dir);
+    dir = (char *)malloc(len + 1);
+    if (!dir) return -1;
+    memcpy(dir, cache_dir, len + 1);
+  }
+  if (cc->pptk_cache_dir_) free(cc->pptk_cache_dir_);
+  cc->pptk_cache_dir_ = dir;
+  return 0;
+}
+
+static int cc_file_pptk_cache_content_input_request_callback(void *baton, struct input_file *ifile) {
+  if_set_input(ifile, ifile->pptk_cache_->content_, ifile->pptk_cache_->content_size_, 1);
+  return 0;
+}
+
+/* Looks up the input file in the pptk cache, this happens just before the file is first
+ * tokenized so the key reflects the tokenizer mode the file starts in. Upon a hit the file
+ * is replayed, otherwise its tokenization is recorded. Returns 0 upon success (including if
+ * the file cannot be cached), or non-zero if reading the file failed. */
+static int cc_pptk_cache_lookup(struct c_compiler *cc, struct input_file *ifile) {
+  const void *content;
+  size_t content_size;
+  struct pptk_cache_state *state;
+
+  ifile->pptk_cache_lookup_pending_ = 0;
+  if ((ifile->input_request_fn_ != cc_file_fp_input_request_callback) &&
+      (ifile->input_request_fn_ != cc_file_mem_input_request_callback)) {
+    /* Input supplied by the caller, the content is not known up front. */
+    return 0;
+  }
+
+  state = (struct pptk_cache_state *)malloc(sizeof(struct pptk_cache_state));
+  if (!state) return 0;
+  state->content_ = NULL;
+  state->content_size_ = 0;
+  state->image_.base_ = NULL;
+  pptk_cache_recorder_init(&state->recorder_);
+  ifile->pptk_cache_ = state;
+
+  if (ifile->input_request_fn_ == cc_file_fp_input_request_callback) {
+    /* Read the whole file to hash it, from here on the file is fed from the content. */
+    size_t size_allocated = 0;
+    for (;;) {
+      if ((size_allocated - state->content_size_) < CC_FILE_FP_BUFFER_SIZE) {
+        size_t new_size = size_allocated * 2 + CC_FILE_FP_BUFFER_SIZE;
+        void *new_content = (new_size > size_allocated) ? realloc(state->content_, new_size) : NULL;
+        if (!new_content) {
+          cc_no_memory(cc);
+          return -1;
+        }
+        state->content_ = new_content;
+        size_allocated = new_size;
+      }
+      size_t num_bytes_read = fread((char *)state->content_ + state->content_size_, 1, CC_FILE_FP_BUFFER_SIZE, ifile->fp_);
+      state->content_size_ += num_bytes_read;
+      if (num_bytes_read != CC_FILE_FP_BUFFER_SIZE) {
+        if (ferror(ifile->fp_)) {
+          return -1; /* an error occurred */
+        }
+        if (feof(ifile->fp_)) {
+          break;
+        }
+      }
+    }
+    ifile->input_request_fn_ = cc_file_pptk_cache_content_input_request_callback;
+    content = state->content_;
+    content_size = state->content_size_;
+  }
+  else {
+    struct mem_input_file *mif = (struct mem_input_file *)ifile;
+    content = mif->mem_;
+    content_size = mif->memsize_;
+  }
+
+  pptk_cache_key_init(&state->key_, cc, content, content_size, pptk_mode(&ifile->pptk_));
+  if (!pptk_cache_open(&state->image_, cc->pptk_cache_dir_, &state->key_)) {
+    ifile->pptk_cache_replaying_ = 1;
+    if (state->content_) {
+      free(state->content_);
+      state->content_ = NULL;
+    }
+  }
+  else if (!cc->have_error_) {
+    /* Record only if any diagnostics reported during tokenization are certain to be this
+     * file's, as replaying will not report them again. */
+    ifile->pptk_cache_recording_ = 1;
+  }
+  return 0;
+}
+
 struct cc_if_section *cc_if_push(struct c_compiler *cc) {
   struct cc_if_section *ldifs = (struct cc_if_section *)malloc(sizeof(struct cc_if_section));
   if (!ldifs) return NULL;
@@ -307,7 +522,52 @@ void cc_if_pop(struct c_compiler *cc) {
   free(ldifs);
 }
 
+void cc_include_guard_line(struct c_compiler *cc) {
+  struct input_file *ifile = cc->input_stack_;
+  if (ifile && (ifile->include_guard_state_ != IFIG_OPEN)) {
+    /* Content outside of the (candidate) include guard */
+    ifile->include_guard_state_ = IFIG_NONE;
+  }
+}
+
+void cc_include_guard_ifndef(struct c_compiler *cc, struct cc_if_section *sec, const char *macro) {
+  struct input_file *ifile = cc->input_stack_;
+  if (ifile && (ifile->include_guard_state_ == IFIG_START) && (sec->parent_ == ifile->include_guard_outer_section_)) {
+    ifile->include_guard_state_ = IFIG_OPEN;
+    ifile->include_guard_macro_ = macro;
+    ifile->include_guard_section_ = sec;
+  }
+  else {
+    cc_include_guard_line(cc);
+  }
+}
+
+void cc_include_guard_else(struct c_compiler *cc) {
+  struct input_file *ifile = cc->input_stack_;
+  if (ifile && (ifile->include_guard_state_ == IFIG_OPEN) && (cc->if_section_stack_ == ifile->include_guard_section_)) {
+    /* The guard has an alternative, so is not a guard */
+    ifile->include_guard_state_ = IFIG_NONE;
+  }
+  else {
+    cc_include_guard_line(cc);
+  }
+}
+
+void cc_include_guard_endif(struct c_compiler *cc) {
+  struct input_file *ifile = cc->input_stack_;
+  if (ifile && (ifile->include_guard_state_ == IFIG_OPEN) && (cc->if_section_stack_ == ifile->include_guard_section_)) {
+    ifile->include_guard_state_ = IFIG_CLOSED;
+    ifile->include_guard_section_ = NULL;
+  }
+  else {
+    cc_include_guard_line(cc);
+  }
+}
+
 enum c_compiler_result cc_preprocessor_stage(struct c_compiler *cc) {
+  /* Any input file pushed after this is not for the preceding CCR_NEW_INCLUDE */
+  cc->pp_include_pending_ = 0;
+
   macro_expander:
   if (cc->ppme_input_ || cc->ppme_input_final_) {
     int r;
@@ -319,7 +579,7 @@ enum c_compiler_result cc_preprocessor_stage(struct c_compiler *cc) {
       next_sym = PPME_INPUT_END;
     }
     if (next_sym == PPME_IDENT) {
-      struct macro *m = (struct macro *)st_find(&cc->macro_table_, cc->ppme_input_->text_);
+      struct macro *m = (struct macro *)st_find_hashed(&cc->macro_table_, cc->ppme_input_->text_, pptk_arena_text_hash(cc->ppme_input_->text_));
 
       if (m) {
         if (m->is_function_style_) {
@@ -420,6 +680,7 @@ line_directives:
         case PPLD_INCLUDE_FILE:
           cc->input_stack_->ppld_input_not_finished_ = 1;
           cc->have_ppld_input_line_ = 0;
+          cc->pp_include_pending_ = 1;
           return CCR_NEW_INCLUDE;
         case _PPLD_FINISH:
           cc->ppme_input_file_ = cc->input_stack_->ppld_input_line_filename_;
@@ -465,6 +726,12 @@ line_directives:
 
 tokenizer:;
   int pptk_r;
+  if (cc->input_stack_->pptk_cache_lookup_pending_) {
+    int cr = cc_pptk_cache_lookup(cc, cc->input_stack_);
+    if (cr) {
+      return cr;
+    }
+  }
   do {
     int break_out = 0;
     if (ppld_stack_accepts(&cc->input_stack_->ppld_, PPLD_HEADER_NAME)) {
@@ -497,7 +764,21 @@ tokenizer:;
       }
     }
     
-    pptk_r = pptk_scan(&cc->input_stack_->pptk_, cc, &cc->ppld_input_, &cc->input_stack_->post_line_continuation_situs_);
+    if (cc->input_stack_->pptk_cache_replaying_) {
+      pptk_r = pptk_cache_replay(cc, &cc->input_stack_->pptk_cache_->image_, cc->input_stack_->filename_, &cc->ppld_input_);
+    }
+    else {
+      struct pptk *prev_tail = cc->ppld_input_ ? cc->ppld_input_->prev_ : NULL;
+      pptk_r = pptk_scan(&cc->input_stack_->pptk_, cc, &cc->ppld_input_, &cc->input_stack_->post_line_continuation_situs_);
+      if (cc->input_stack_->pptk_cache_recording_) {
+        /* Capture the new tokens before the line directives parser consumes or relocates them */
+        struct pptk *first_new = cc->ppld_input_;
+        if (prev_tail) first_new = (prev_tail->next_ != cc->ppld_input_) ? prev_tail->next_ : NULL;
+        if (pptk_cache_record(&cc->input_stack_->pptk_cache_->recorder_, pptk_r, pptk_endline(&cc->input_stack_->pptk_), first_new, cc->ppld_input_, cc->input_stack_->filename_)) {
+          cc->input_stack_->pptk_cache_recording_ = 0;
+        }
+      }
+    }
     switch (pptk_r) {
       case PPTK_TOKENIZER_LINE_READY:
         cc->have_ppld_input_line_ = 1;
@@ -516,7 +797,7 @@ tokenizer:;
           } while (tk_chain != cc->ppld_input_);
         }
 
-        int current_line = pptk_endline(&cc->input_stack_->pptk_);
+        int current_line = cc->input_stack_->pptk_cache_replaying_ ? cc->input_stack_->pptk_cache_->image_.endline_ : pptk_endline(&cc->input_stack_->pptk_);
         cc->input_stack_->pptk_input_line_ += current_line - cc->input_stack_->pptk_true_input_line_number_at_start_;
         cc->input_stack_->pptk_true_input_line_number_at_start_ = current_line;
         goto line_directives;
@@ -581,6 +862,11 @@ tokenizer:;
     cc->ppld_input_final_ = 1;
     goto line_directives;
   }
+
+  if (cc->input_stack_->pptk_cache_replaying_) {
+    /* Replayed _PPTK_FEED_ME, the cache needs no input */
+    goto tokenizer;
+  }
 line_continuations:;
   int pplc_r;
   do {
@@ -611,12 +897,16 @@ line_continuations:;
       case _PPLC_FEED_ME:
         break;
     }
+    if ((pplc_r == _PPLC_SYNTAX_ERROR) || (pplc_r == _PPLC_LEXICAL_ERROR) || (pplc_r == _PPLC_INTERNAL_ERROR)) {
+      cc->input_stack_->pptk_cache_recording_ = 0;
+    }
   } while ((pplc_r != _PPLC_FEED_ME) && (pplc_r != _PPLC_FINISH));
 
   if (cc->input_stack_->post_line_continuation_size_ || (pplc_r == _PPLC_FINISH)) {
     /* Process output of line continuation translation phase first, to ensure we push as much as possible before asking
      * more input. */
-    pptk_set_input(&cc->input_stack_->pptk_, cc->input_stack_->post_line_continuation_, cc->input_stack_->post_line_continuation_size_, pplc_r == _PPLC_FINISH);
+    /* post_line_continuation_ is not written to until pptk asks for more input, so let pptk scan its tokens in place. */
+    pptk_set_input_in_place(&cc->input_stack_->pptk_, cc->input_stack_->post_line_continuation_, cc->input_stack_->post_line_continuation_size_, pplc_r == _PPLC_FINISH);
     cc->input_stack_->post_line_continuation_size_ = 0;
     goto tokenizer;
   }
@@ -651,12 +941,16 @@ trigraphs:;
       case _PPTG_FEED_ME:
         break;
     }
+    if ((pptg_r == _PPTG_SYNTAX_ERROR) || (pptg_r == _PPTG_LEXICAL_ERROR) || (pptg_r == _PPTG_INTERNAL_ERROR)) {
+      cc->input_stack_->pptk_cache_recording_ = 0;
+    }
   } while ((pptg_r != _PPTG_FEED_ME) && (pptg_r != _PPTG_FINISH));
 
   if (cc->input_stack_->post_trigraph_size_ || (pptg_r == _PPTG_FINISH)) {
     /* Process output of trigraph translation phase first, to ensure we push as much as possible before asking
      * more input. */
-    pplc_set_input(&cc->input_stack_->pplc_, cc->input_stack_->post_trigraph_, cc->input_stack_->post_trigraph_size_, pptg_r == _PPTG_FINISH);
+    /* post_trigraph_ is not written to until pplc asks for more input, so let pplc scan its tokens in place. */
+    pplc_set_input_in_place(&cc->input_stack_->pplc_, cc->input_stack_->post_trigraph_, cc->input_stack_->post_trigraph_size_, pptg_r == _PPTG_FINISH);
     cc->input_stack_->post_trigraph_size_ = 0;
     goto line_continuations;
   }
@@ -753,7 +1047,7 @@ c_parser_input:
             if (cc->ctx_.is_typedefname_permitted_ && cp_stack_accepts(&cc->cp_, CP_TYPEDEF_NAME)) {
               struct name_space *pns = cc->ctx_.block_ ? cc->ctx_.block_->ns_ : &cc->global_ns_;
               while (pns) {
-                struct sym *s = st_find(&pns->ordinary_idents_, tk->text_);
+                struct sym *s = st_find_hashed(&pns->ordinary_idents_, tk->text_, pptk_arena_text_hash(tk->text_));
                 if (s) {
                   struct decl *d = (struct decl *)s;
                   if (d->sc_ == SC_TYPEDEF) {
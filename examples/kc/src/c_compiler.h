@@ -64,6 +64,11 @@ struct c_compiler;
 #include "situs.h"
 #endif
 
+#ifndef PPTK_ARENA_H_INCLUDED
+#define PPTK_ARENA_H_INCLUDED
+#include "pptk_arena.h"
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -100,6 +105,19 @@ struct cc_if_section {
   int seen_else_:1;  /* if non-zero, the #else has already been processed (and further #else or #elif would be invalid.) */
 };
 
+/* Remembers the file the caller pushed for an #include, keyed by cc_include_key() */
+struct cc_include_file {
+  struct sym sym_;
+  const char *filename_; /* from cc_preserve_filename() */
+};
+
+/* A file that is entirely wrapped in an #ifndef macro_ ... #endif include guard, keyed by
+ * its filename */
+struct cc_include_guard {
+  struct sym sym_;
+  const char *macro_; /* interned in the pptk_arena_ */
+};
+
 struct cc_filename_buffer {
   struct cc_filename_buffer *next_;
   char filename_[1];
@@ -119,6 +137,9 @@ struct c_compiler {
    * with C generated names. */
   char asm_decoration_char_; 
 
+  /* All preprocessor tokens and their spellings for this compiler are allocated from here. */
+  struct pptk_arena pptk_arena_;
+
   int ppme_input_final_:1;
   struct pptk *ppme_input_;
   const char *ppme_input_file_;
@@ -136,6 +157,10 @@ struct c_compiler {
   int have_error_:1;
   int fatal_error_:1;
 
+  /* if non-zero, statements and expressions are executed by walking their tree rather than by running
+   * their compiled bytecode; the tree-walk is the reference against which the bytecode can be checked. */
+  int eval_by_tree_walk_:1;
+
   /* if non-zero, cp_input_ == NULL means there is no more input, not that more input is requested */
   int cp_input_final_; 
   struct pptk *cp_input_;
@@ -148,6 +173,10 @@ struct c_compiler {
 
   struct input_file *input_stack_;
 
+  /* If non-NULL, the directory where the pptk tokens of input files are cached (see pptk_cache.h);
+   * files whose content was tokenized before are then replayed from the cache rather than scanned. */
+  char *pptk_cache_dir_;
+
   struct type_base tb_;
   struct data_section ds_;
   struct symtab macro_table_;
@@ -164,6 +193,15 @@ struct c_compiler {
   int pp_include_is_template_emit_ : 1;   /* if non-zero, #emit "header.h" was used, if zero, #include was used. */
   char *pp_include_file_arg_;
 
+  /* Set while CCR_NEW_INCLUDE is returned for pp_include_file_arg_, so the next pushed input
+   * file can be recorded in include_files_ as the file the #include resolved to. */
+  int pp_include_pending_ : 1;
+
+  /* Multiple-include optimization: an #include that resolved to a file in include_guards_
+   * is skipped while the guard macro is defined, without returning CCR_NEW_INCLUDE. */
+  struct symtab include_files_;
+  struct symtab include_guards_;
+
   /* The function to be used for template literals (PPTK_TEMPLATE_LIT); if not explicitly initialized
    * by the caller, then a function will be called with the name in handler_fn_name_, this function
    * will have the prototype:
@@ -195,6 +233,11 @@ void cc_if_pop(struct c_compiler *cc);
 
 struct input_file *cc_push_input_file_fp(struct c_compiler *cc, const char *filename, FILE *fp);
 
+/* Sets the directory for caching the pptk tokens of input files, or disables the cache if
+ * cache_dir is NULL. Only affects input files pushed afterwards. The directory should exist.
+ * Returns 0 upon success, non-zero if no memory is available. */
+int cc_set_pptk_cache_dir(struct c_compiler *cc, const char *cache_dir);
+
 /* preprocess the input stack; puts resulting tokens as a chain in cc->cp_input_ ; 
  * sets cc->cp_input_final_ when there is no more input.
  * Returns CCR_SUCCESS if the compiler should process the cc->cp_input_ tokens and/or
@@ -245,9 +288,30 @@ void cc_no_memory(struct c_compiler *cc);
  * (the copy will remain valid for the remainder of cc's lifetime.) */
 char *cc_preserve_filename(struct c_compiler *cc, const char *filename);
 
+/* The #include argument for CCR_NEW_INCLUDE; the caller should resolve it and push the file
+ * with cc_push_input_file_fp() or cc_push_input_file_mem(). Include guarded files are not
+ * included again, so the caller is assumed to resolve an #include argument the same way each
+ * time it is included from the same directories (the directories of the files on the input
+ * stack for #include "header.h", independent of them for #include <header.h>.) */
 const char *cc_get_include_filename(struct c_compiler *cc);
 int cc_is_system_include(struct c_compiler *cc);
 
+/* Include guard detection for the multiple-include optimization, called from the line
+ * directives parser for the current input file:
+ * cc_include_guard_line() for every line other than an empty line or a null directive,
+ * cc_include_guard_ifndef() after pushing the if-section for an #ifndef,
+ * cc_include_guard_else() for #else and #elif, and
+ * cc_include_guard_endif() before popping the if-section for an #endif. */
+void cc_include_guard_line(struct c_compiler *cc);
+void cc_include_guard_ifndef(struct c_compiler *cc, struct cc_if_section *sec, const char *macro);
+void cc_include_guard_else(struct c_compiler *cc);
+void cc_include_guard_endif(struct c_compiler *cc);
+
+/* Returns non-zero if an #include of headername from the current input file's directories
+ * resolved to an include guarded file before, and its guard macro is currently defined. Returns 0 otherwise,
+ * including when out of memory. */
+int cc_include_is_guarded(struct c_compiler *cc, const char *headername, int is_system_include);
+
 /* Helper functions for pre-tokenization translation phases implementation. */
 int cc_pp_concat_sub_output_b(struct c_compiler *cc, struct situs *output_situs, char **output_buf, size_t *output_pos, size_t *output_buf_size, struct situs *span_situs, const char *span_text, size_t span_text_len);
 int cc_pp_concat_sub_output(struct c_compiler *cc, struct situs *output_situs, char **output_buf, size_t *output_pos, size_t *output_buf_size, struct situs *span_situs, const char *span_text);
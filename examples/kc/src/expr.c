@@ -78,6 +78,11 @@
 #include "invoke_x64.h"
 #endif
 
+#ifndef EXPR_CODE_H_INCLUDED
+#define EXPR_CODE_H_INCLUDED
+#include "expr_code.h"
+#endif
+
 int expr_pointer_decay(struct c_compiler *cc, struct expr **px) {
   /* 6.3.2.1-3 (arrays) and 6.3.2.1-4 (functions) decay into their pointers,
    * applies to almost all operator types, save for a few noted exceptions (sizeof
@@ -640,6 +645,7 @@ struct expr *expr_alloc(enum expr_type et) {
   x->dsp_ = NULL;
   x->decl_ = NULL;
   x->scratch_ = NULL;
+  x->code_ = NULL;
   return x;
 }
 
@@ -650,6 +656,7 @@ void expr_free(struct expr *x) {
   for (n = 0; n < (sizeof(x->children_) / sizeof(*x->children_)); ++n) {
     expr_free(x->children_[n]);
   }
+  expr_code_free(x->code_);
   free(x);
 }
 
@@ -1272,7 +1279,7 @@ static void complex_div_f(float *r, float *ri, float z, float zi, float w, float
   *ri = y;
 }
 
-static int expr_num_operands(struct expr *x) {
+int expr_num_operands(struct expr *x) {
   if (!x) return 0;
   int num_operands = 0;
   switch (x->et_) {
@@ -1315,6 +1322,9 @@ void expr_prepare(struct expr *x) {
   /* Start the count at 1, this allows us to discover (on debug) when
    * we failed to initialize the ordinals. */
   int ordinal = 1;
+  /* Any bytecode was compiled against the old ordinals */
+  expr_code_free(x->code_);
+  x->code_ = NULL;
   expr_prep_reset(x);
   expr_prep_visit(x, &ordinal);
 }
@@ -1401,6 +1411,12 @@ static int expr_eval_impl(struct c_compiler *cc, struct expr *x, struct expr_tem
     return -1;
   }
 
+  return expr_eval_node(cc, x, NULL, temps, is_constant_expr, nulled_out_decl, local_base, param_base, return_value_ptr);
+}
+
+int expr_eval_node(struct c_compiler *cc, struct expr *x, struct expr_decoded *dec, struct expr_temp *temps, int is_constant_expr, struct decl *nulled_out_decl, void *local_base, void *param_base, void *return_value_ptr) {
+  int r;
+
   enum impl_type {
     i8, i16, i32, i64,
     u8, u16, u32, u64,
@@ -1410,7 +1426,7 @@ static int expr_eval_impl(struct c_compiler *cc, struct expr *x, struct expr_tem
     b, enum_type, enum_cit,
     ptr,
     none
-  } load[3], store, c, si, sli, slli, ui, uli, ulli, uintptr, indi;
+  } load[3], store, final_store, c, si, sli, slli, ui, uli, ulli, uintptr, indi;
 
   enum operator {
     nop,
@@ -1557,6 +1573,21 @@ static int expr_eval_impl(struct c_compiler *cc, struct expr *x, struct expr_tem
     assert(0 && "Unsupported uintptr_equivalent");
   }
 
+  if (dec && dec->is_decoded_) {
+    if (!temps) {
+      /* Only decoding */
+      return 0;
+    }
+    /* Decoded on an earlier evaluation of x, skip straight to execution. */
+    op = (enum operator)dec->op_;
+    load[0] = (enum impl_type)dec->load_[0];
+    load[1] = (enum impl_type)dec->load_[1];
+    load[2] = (enum impl_type)dec->load_[2];
+    store = (enum impl_type)dec->store_;
+    final_store = (enum impl_type)dec->final_store_;
+    goto execute;
+  }
+
   double operands_d[3];
   double operands_di[3];
   int64_t operands_i[3];
@@ -2103,7 +2134,247 @@ static int expr_eval_impl(struct c_compiler *cc, struct expr *x, struct expr_tem
     if (load[opd] == ptr) {
       load[opd] = uintptr;
     }
+  }
+
+  if (op == indir) {
+    /* The type loaded through the pointer is that of the indirection itself */
+    struct type_node *tn = expr_type(cc, x);
+    tn = type_node_unqualified(tn);
+    enum type_kind tk = tn->kind_;
+    if (tk == tk_enumeration) {
+      tk = type_node_arith_type_kind_no_enum(&cc->tb_, tn);
+    }
+    if (tk == tk_pointer) {
+      tk = cc->tb_.uintptr_equivalent_;
+    }
+    switch (tk) {
+      case tk_char: indi = c; break;
+      case tk_signed_char: indi = i8; break;
+      case tk_short_int: indi = i16; break;
+      case tk_int: indi = si; break;
+      case tk_long_int: indi = sli; break;
+      case tk_long_long_int: indi = slli; break;
+      case tk_bool: indi = b; break;
+      case tk_unsigned_char: indi = u8; break;
+      case tk_unsigned_short_int: indi = u16; break;
+      case tk_unsigned_int: indi = ui; break;
+      case tk_unsigned_long_int: indi = uli; break;
+      case tk_unsigned_long_long_int: indi = ulli; break;
+      case tk_float: indi = f; break;
+      case tk_double: indi = d; break;
+      case tk_long_double: indi = ld; break;
+      case tk_float_complex: indi = fc; break;
+      case tk_double_complex: indi = dc; break;
+      case tk_long_double_complex: indi = ldc; break;
+      case tk_float_imaginary: indi = fi; break;
+      case tk_double_imaginary: indi = di; break;
+      case tk_long_double_imaginary: indi = ldi; break;
+      case tk_void:
+        assert(0 && "Indirection of void type not supported");
+        break;
+      case tk_enumeration:
+        assert(0 && "Enumeration with enumeration as integer type");
+        break;
+      case tk_array:
+        /* XXX: Handle array indirection; should array not have converted to pointer ?? */
+        assert(0 && "XXX: Not expecting array");
+        break;
+      case tk_structure:
+      case tk_union:
+        /* Silently ignore structures, the thinking is that this indirection is either at
+         * the root, or this is an intermediate expression tree. */
+        /* XXX: Find some field access operator for structures */
+        indi = none;
+        break;
+      case tk_function:
+        assert(0 && "Indirection of function not possible");
+        break;
+      case tk_pointer:
+        assert(0 && "Should not have pointer type");
+        break;
+      case tk_qualifier:
+        assert(0 && "Types should have been fully dequalified");
+        break;
+    }
+  }
+
+  final_store = (op == indir) ? indi : store;
+
+  /* Down-convert enumeration types to their integer representation (compatible integer type) */
+  if ((final_store == enum_cit) || (final_store == enum_type)) {
+    struct type_node *tn;
+    if (final_store == enum_cit) {
+      tn = expr_type(cc, x->children_[0]);
+    }
+    else /* (final_store == enum_type) */ {
+      tn = x->type_arg_;
+    }
+    assert(tn->kind_ == tk_enumeration && "Must have an enum as child");
+    tn = tn->derived_from_ /* get Compatible Integer Type */;
+
+    switch (tn->kind_) {
+      case tk_bool:
+        final_store = b;
+        break;
+      case tk_char:
+        final_store = c;
+        break;
+      case tk_signed_char:
+        final_store = i8;
+        break;
+      case tk_unsigned_char:
+        final_store = u8;
+        break;
+      case tk_short_int:
+        final_store = i16;
+        break;
+      case tk_unsigned_short_int:
+        final_store = u16;
+        break;
+      case tk_int:
+        final_store = si;
+        break;
+      case tk_long_int:
+        final_store = sli;
+        break;
+      case tk_long_long_int:
+        final_store = slli;
+        break;
+      case tk_unsigned_int:
+        final_store = ui;
+        break;
+      case tk_unsigned_long_int:
+        final_store = uli;
+        break;
+      case tk_unsigned_long_long_int:
+        final_store = ulli;
+        break;
+      default:
+        assert(0 && "Unsupported enum compatible integer type");
+        break;
+    }
+  }
+
+  if (final_store == ptr) {
+    final_store = uintptr;
+  }
+
+  if (dec) {
+    dec->op_ = (int)op;
+    dec->load_[0] = (int)load[0];
+    dec->load_[1] = (int)load[1];
+    dec->load_[2] = (int)load[2];
+    dec->store_ = (int)store;
+    dec->final_store_ = (int)final_store;
+
+    /* Lower to a tile for the typed bytecode operations, if the node is integer-only */
+    enum expr_int_rep reps[4];
+    enum impl_type impls[4] = { load[0], load[1], load[2], final_store };
+    int k;
+    for (k = 0; k < 4; ++k) {
+      switch (impls[k]) {
+        case i8: reps[k] = EIR_I8; break;
+        case i16: reps[k] = EIR_I16; break;
+        case i32: reps[k] = EIR_I32; break;
+        case i64: reps[k] = EIR_I64; break;
+        case u8: reps[k] = EIR_U8; break;
+        case u16: reps[k] = EIR_U16; break;
+        case u32: reps[k] = EIR_U32; break;
+        case u64: reps[k] = EIR_U64; break;
+        case b: reps[k] = EIR_BOOL; break;
+        case none: reps[k] = EIR_NONE; break;
+        default: reps[k] = EIR_OTHER; break;
+      }
+    }
+    /* The final store reads operands_i for signed results and operands_u for unsigned ones,
+     * these differ for some operations. */
+    int result_signed = (reps[3] == EIR_I8) || (reps[3] == EIR_I16) || (reps[3] == EIR_I32) || (reps[3] == EIR_I64) || (reps[3] == EIR_BOOL);
+    int result_unsigned = (reps[3] == EIR_U8) || (reps[3] == EIR_U16) || (reps[3] == EIR_U32) || (reps[3] == EIR_U64);
+    int num_loads = 0;
+    enum expr_tile tile = ETL_NONE;
+    int tile_bits = 0;
+    switch (op) {
+      case nop: tile = ETL_CONVERT; num_loads = 1; break;
+      case imm_si: case imm_sli: case imm_slli:
+      case imm_ui: case imm_uli: case imm_ulli: case imm_usi:
+        tile = ETL_IMM;
+        break;
+      case add: tile = ETL_ADD; num_loads = 2; break;
+      case sub: tile = ETL_SUB; num_loads = 2; break;
+      case mul: tile = ETL_MUL; num_loads = 2; break;
+      case bitwise_and: tile = ETL_AND; num_loads = 2; break;
+      case bitwise_or: tile = ETL_OR; num_loads = 2; break;
+      case bitwise_xor: tile = ETL_XOR; num_loads = 2; break;
+      case neg: tile = ETL_NEG; num_loads = 1; break;
+      case compl: tile = ETL_COMPL; num_loads = 1; break;
+      case shl: tile = ETL_SHL; num_loads = 2; break;
+      case shr: tile = ETL_SHR; num_loads = 2; break;
+      /* Comparisons only set operands_i */
+      case lt: if (result_signed) tile = ETL_LT; num_loads = 2; break;
+      case ult: if (result_signed) tile = ETL_ULT; num_loads = 2; break;
+      case gt: if (result_signed) tile = ETL_GT; num_loads = 2; break;
+      case ugt: if (result_signed) tile = ETL_UGT; num_loads = 2; break;
+      case lte: if (result_signed) tile = ETL_LTE; num_loads = 2; break;
+      case ulte: if (result_signed) tile = ETL_ULTE; num_loads = 2; break;
+      case gte: if (result_signed) tile = ETL_GTE; num_loads = 2; break;
+      case ugte: if (result_signed) tile = ETL_UGTE; num_loads = 2; break;
+      case equ_i: case equ_u: if (result_signed) tile = ETL_EQ; num_loads = 2; break;
+      case neq_i: case neq_u: if (result_signed) tile = ETL_NE; num_loads = 2; break;
+      case indir: if (result_signed || result_unsigned) tile = ETL_INDIR; num_loads = 1; break;
+      /* Signed stores only set operands_i, unsigned stores only set operands_u */
+      case storeslli: tile_bits = cc->tb_.bits_per_long_long_; if (!result_unsigned) tile = ETL_STORE; num_loads = 2; break;
+      case storesli: tile_bits = cc->tb_.bits_per_long_; if (!result_unsigned) tile = ETL_STORE; num_loads = 2; break;
+      case storesi: tile_bits = cc->tb_.bits_per_int_; if (!result_unsigned) tile = ETL_STORE; num_loads = 2; break;
+      case storess: tile_bits = 16; if (!result_unsigned) tile = ETL_STORE; num_loads = 2; break;
+      case storesc: tile_bits = 8; if (!result_unsigned) tile = ETL_STORE; num_loads = 2; break;
+      case storeulli: tile_bits = cc->tb_.bits_per_long_long_; if (!result_signed) tile = ETL_STORE; num_loads = 2; break;
+      case storeuli: tile_bits = cc->tb_.bits_per_long_; if (!result_signed) tile = ETL_STORE; num_loads = 2; break;
+      case storeui: tile_bits = cc->tb_.bits_per_int_; if (!result_signed) tile = ETL_STORE; num_loads = 2; break;
+      case storeus: tile_bits = 16; if (!result_signed) tile = ETL_STORE; num_loads = 2; break;
+      case storeuc: tile_bits = 8; if (!result_signed) tile = ETL_STORE; num_loads = 2; break;
+      case storeb: tile_bits = 8; if (!result_signed) tile = ETL_STORE; num_loads = 2; break;
+      case storec:
+        tile_bits = 8;
+        if (cc->tb_.char_is_signed_ ? !result_unsigned : !result_signed) tile = ETL_STORE;
+        num_loads = 2;
+        break;
+      case storeptr:
+        switch (cc->tb_.uintptr_equivalent_) {
+          case tk_unsigned_long_long_int: tile_bits = cc->tb_.bits_per_long_long_; break;
+          case tk_unsigned_long_int: tile_bits = cc->tb_.bits_per_long_; break;
+          case tk_unsigned_int: tile_bits = cc->tb_.bits_per_int_; break;
+        }
+        if (!result_signed) tile = ETL_STORE;
+        num_loads = 2;
+        break;
+      case local_addr: if (reps[3] == EIR_NONE) tile = ETL_LOCAL_ADDR; break;
+      case param_addr: if (reps[3] == EIR_NONE) tile = ETL_PARAM_ADDR; break;
+      default: break;
+    }
+    /* Every operand loaded must be an integer, every operand not loaded must be unused */
+    for (k = 0; k < 3; ++k) {
+      if ((k < num_loads) ? ((reps[k] == EIR_NONE) || (reps[k] == EIR_OTHER)) : (reps[k] != EIR_NONE)) {
+        tile = ETL_NONE;
+      }
+    }
+    if (reps[3] == EIR_OTHER) tile = ETL_NONE;
+    if ((tile == ETL_STORE) && (tile_bits != 8) && (tile_bits != 16) && (tile_bits != 32) && (tile_bits != 64)) tile = ETL_NONE;
+    dec->tile_ = tile;
+    dec->tile_load_[0] = reps[0];
+    dec->tile_load_[1] = reps[1];
+    dec->tile_store_ = reps[3];
+    dec->tile_bits_ = tile_bits;
+
+    dec->is_decoded_ = 1;
+  }
 
+  if (!temps) {
+    /* Only decoding */
+    return 0;
+  }
+
+execute:
+  for (opd = 0; opd < 3; ++opd) {
     switch (load[opd]) {
       case i8:
         operands_i[opd] = (int8_t)temps[x->children_[opd]->ord_].v_.i64_;
@@ -2384,66 +2655,7 @@ static int expr_eval_impl(struct c_compiler *cc, struct expr *x, struct expr_tem
       operands_fi[0] = 0.f;
       operands_di[0] = 0.;
 
-      struct type_node *tn = expr_type(cc, x);
-      tn = type_node_unqualified(tn);
-      enum type_kind tk = tn->kind_;
-      if (tk == tk_enumeration) {
-        tk = type_node_arith_type_kind_no_enum(&cc->tb_, tn);
-      }
-      if (tk == tk_pointer) {
-        tk = cc->tb_.uintptr_equivalent_;
-      }
-      switch (tk) {
-        case tk_char: indi = c; break;
-        case tk_signed_char: indi = i8; break;
-        case tk_short_int: indi = i16; break;
-        case tk_int: indi = si; break;
-        case tk_long_int: indi = sli; break;
-        case tk_long_long_int: indi = slli; break;
-        case tk_bool: indi = b; break;
-        case tk_unsigned_char: indi = u8; break;
-        case tk_unsigned_short_int: indi = u16; break;
-        case tk_unsigned_int: indi = ui; break;
-        case tk_unsigned_long_int: indi = uli; break;
-        case tk_unsigned_long_long_int: indi = ulli; break;
-        case tk_float: indi = f; break;
-        case tk_double: indi = d; break;
-        case tk_long_double: indi = ld; break;
-        case tk_float_complex: indi = fc; break;
-        case tk_double_complex: indi = dc; break;
-        case tk_long_double_complex: indi = ldc; break;
-        case tk_float_imaginary: indi = fi; break;
-        case tk_double_imaginary: indi = di; break;
-        case tk_long_double_imaginary: indi = ldi; break;
-        case tk_void:
-          assert(0 && "Indirection of void type not supported");
-          break;
-        case tk_enumeration:
-          assert(0 && "Enumeration with enumeration as integer type");
-          break;
-        case tk_array:
-          /* XXX: Handle array indirection; should array not have converted to pointer ?? */
-          assert(0 && "XXX: Not expecting array");
-          break;
-        case tk_structure:
-        case tk_union:
-          /* Silently ignore structures, the thinking is that this indirection is either at
-           * the root, or this is an intermediate expression tree. */
-          /* XXX: Find some field access operator for structures */
-          indi = none;
-          break;
-        case tk_function:
-          assert(0 && "Indirection of function not possible");
-          break;
-        case tk_pointer:
-          assert(0 && "Should not have pointer type");
-          break;
-        case tk_qualifier:
-          assert(0 && "Types should have been fully dequalified");
-          break;
-      }
-      store = indi;
-      switch (indi) {
+      switch (final_store) {
         case i8:
           operands_i[0] = *(int8_t *)p;
           break;
@@ -2843,66 +3055,7 @@ static int expr_eval_impl(struct c_compiler *cc, struct expr *x, struct expr_tem
       break;
   }
 
-    /* Down-convert enumeration types to their integer representation (compatible integer type) */
-  if ((store == enum_cit) || (store == enum_type)) {
-    struct type_node *tn;
-    if (store == enum_cit) {
-      tn = expr_type(cc, x->children_[0]);
-    }
-    else /* (store == enum_type) */ {
-      tn = x->type_arg_;
-    }
-    assert(tn->kind_ == tk_enumeration && "Must have an enum as child");
-    tn = tn->derived_from_ /* get Compatible Integer Type */;
-
-    switch (tn->kind_) {
-      case tk_bool:
-        store = b;
-        break;
-      case tk_char:
-        store = c;
-        break;
-      case tk_signed_char:
-        store = i8;
-        break;
-      case tk_unsigned_char:
-        store = u8;
-        break;
-      case tk_short_int:
-        store = i16;
-        break;
-      case tk_unsigned_short_int:
-        store = u16;
-        break;
-      case tk_int:
-        store = si;
-        break;
-      case tk_long_int:
-        store = sli;
-        break;
-      case tk_long_long_int:
-        store = slli;
-        break;
-      case tk_unsigned_int:
-        store = ui;
-        break;
-      case tk_unsigned_long_int:
-        store = uli;
-        break;
-      case tk_unsigned_long_long_int:
-        store = ulli;
-        break;
-      default:
-        assert(0 && "Unsupported enum compatible integer type");
-        break;
-    }
-  }
-
-  if (store == ptr) {
-    store = uintptr;
-  }
-
-  switch (store) {
+  switch (final_store) {
     case i8:
       temps[x->ord_].v_.i64_ = (int8_t)operands_i[0];
       break;
@@ -2968,10 +3121,39 @@ static int expr_eval_impl(struct c_compiler *cc, struct expr *x, struct expr_tem
   return 0;
 }
 
+int expr_decode_node(struct c_compiler *cc, struct expr *x, struct expr_decoded *dec) {
+  switch (x->et_) {
+    case ET_INVALID:
+    case ET_NOP:
+    case ET_C_LONG_DOUBLE:
+    case ET_LOGICAL_AND:
+    case ET_LOGICAL_OR:
+    case ET_CONDITION:
+      /* Not decoded by expr_eval_node() */
+      return -1;
+    case ET_INDIRECTION_PTR: {
+      /* Decoding asserts the type loaded through the pointer can be loaded */
+      struct type_node *tn = expr_type(cc, x);
+      if (!tn) return -1;
+      tn = type_node_unqualified(tn);
+      if ((tn->kind_ == tk_void) || (tn->kind_ == tk_array) || (tn->kind_ == tk_function)) return -1;
+      break;
+    }
+    default:
+      break;
+  }
+  memset(dec, 0, sizeof(*dec));
+  return expr_eval_node(cc, x, dec, NULL, 0, NULL, NULL, NULL, NULL);
+}
+
 int expr_eval(struct c_compiler *cc, struct expr_temp *result, struct expr *x, int is_constant_expr, struct decl *nulled_out_decl, void *local_base, void *param_base, void *return_value_ptr) {
   int r;
   if (!x) return -1;
 
+  if (x->code_ && !cc->eval_by_tree_walk_) {
+    return expr_code_run(cc, x->code_, result, is_constant_expr, nulled_out_decl, local_base, param_base, return_value_ptr);
+  }
+
 #ifdef _WIN32
 #define EXPR_ALLOCA _alloca
 #else
@@ -45,6 +45,8 @@ extern "C" {
 #define EXPR_FIND_DECL_MULTIPLE_FOUND 2
 #define EXPR_FIND_DECL_ERROR -1
 
+struct expr_code;
+
 struct expr_temp {
   /* Literal data of the node if it is a arithmetic value, or a pointer to the literal data
    * in the data section. The type of the expr node determines which field in the union (if any)
@@ -123,6 +125,54 @@ struct expr {
 
   /* Pointer to an expr used for cloning expression DAGs */
   struct expr *scratch_;
+
+  /* Bytecode for evaluating this expression if it is the root of an expression that was compiled
+   * by expr_code_compile(), NULL otherwise. */
+  struct expr_code *code_;
+};
+
+/* Integer representation of an operand or result, as seen by the typed bytecode operations. */
+enum expr_int_rep {
+  EIR_NONE,   /* operand not used, or result not stored */
+  EIR_I8, EIR_I16, EIR_I32, EIR_I64,
+  EIR_U8, EIR_U16, EIR_U32, EIR_U64,
+  EIR_BOOL,
+  EIR_OTHER   /* floating point, complex or imaginary */
+};
+
+/* Machine independent operation of a decoded expr node that the bytecode can run as a typed
+ * operation on 64 bit integers; anything else is ETL_NONE and must be evaluated by expr_eval_node().
+ * Operands are loaded per their expr_int_rep, the result is converted to the final store rep. */
+enum expr_tile {
+  ETL_NONE,
+  ETL_CONVERT,    /* result = opd0 */
+  ETL_IMM,        /* result = x->v_ */
+  ETL_ADD, ETL_SUB, ETL_MUL,
+  ETL_AND, ETL_OR, ETL_XOR,
+  ETL_NEG, ETL_COMPL,
+  ETL_SHL,
+  ETL_SHR,        /* arithmetic if the result is signed, logical otherwise */
+  ETL_LT, ETL_ULT, ETL_GT, ETL_UGT, ETL_LTE, ETL_ULTE, ETL_GTE, ETL_UGTE, ETL_EQ, ETL_NE,
+  ETL_INDIR,      /* result = *opd0, read as the final store rep */
+  ETL_STORE,      /* *opd0 = opd1 truncated to tile_bits_, result = opd1 */
+  ETL_LOCAL_ADDR, /* temps[x->ord_] = local_base + x->decl_->local_offset_ */
+  ETL_PARAM_ADDR  /* temps[x->ord_] = param_base + x->decl_->param_offset_ */
+};
+
+/* Operator and operand types of a single expr node, as expr_eval_node() decodes them from the node
+ * type and the types involved. Kept so repeated evaluations of the same node can skip decoding. */
+struct expr_decoded {
+  int is_decoded_:1;
+  int op_;
+  int load_[3];
+  int store_;
+  int final_store_;
+
+  /* The same, lowered to a tile for the typed bytecode operations */
+  enum expr_tile tile_;
+  enum expr_int_rep tile_load_[2];
+  enum expr_int_rep tile_store_;
+  int tile_bits_;
 };
 
 struct expr *expr_alloc(enum expr_type et);
@@ -167,6 +217,20 @@ struct expr *expr_convert_type(struct c_compiler *cc, struct type_node *to, stru
 enum type_kind expr_arith_type_kind_no_enum(struct c_compiler *cc, struct expr *x);
 
 void expr_prepare(struct expr *x);
+
+/* Returns the number of children of x that are operands evaluated before x itself. */
+int expr_num_operands(struct expr *x);
+
+/* Evaluates the single node x into temps[x->ord_], assuming all its operands have already been
+ * evaluated into temps. If dec is not NULL, it caches the decoded operation of x for subsequent calls.
+ * If temps is NULL, x is only decoded into dec. */
+int expr_eval_node(struct c_compiler *cc, struct expr *x, struct expr_decoded *dec, struct expr_temp *temps, int is_constant_expr, struct decl *nulled_out_decl, void *local_base, void *param_base, void *return_value_ptr);
+
+/* Decodes the single node x into dec ahead of its evaluation. Returns 0 upon success, or non-zero if
+ * x is a node whose decoding must wait for its evaluation (as decoding it reports the node as invalid,
+ * and it might never be evaluated.) */
+int expr_decode_node(struct c_compiler *cc, struct expr *x, struct expr_decoded *dec);
+
 int expr_eval(struct c_compiler *cc, struct expr_temp *result, struct expr *x, int is_constant_expr, struct decl *nulled_out_decl, void *local_base, void *param_base, void *return_value_ptr);
 
 int expr_constant_evaluation(struct c_compiler *cc, struct expr_temp *result, struct expr *x);
@@ -0,0 +1,912 @@
+/* Copyright 2023-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STDLIB_H_INCLUDED
+#define STDLIB_H_INCLUDED
+#include <stdlib.h>
+#endif
+
+#ifndef STRING_H_INCLUDED
+#define STRING_H_INCLUDED
+#include <string.h>
+#endif
+
+#ifndef LIMITS_H_INCLUDED
+#define LIMITS_H_INCLUDED
+#include <limits.h>
+#endif
+
+#ifndef C_COMPILER_H_INCLUDED
+#define C_COMPILER_H_INCLUDED
+#include "c_compiler.h"
+#endif
+
+#ifndef EXPR_H_INCLUDED
+#define EXPR_H_INCLUDED
+#include "expr.h"
+#endif
+
+#ifndef DECL_H_INCLUDED
+#define DECL_H_INCLUDED
+#include "decl.h"
+#endif
+
+#ifndef STMT_H_INCLUDED
+#define STMT_H_INCLUDED
+#include "stmt.h"
+#endif
+
+#ifndef EXPR_CODE_H_INCLUDED
+#define EXPR_CODE_H_INCLUDED
+#include "expr_code.h"
+#endif
+
+/* Statement code keeps the temps of all its expressions on the stack for the duration of the
+ * run; bodies needing more than this many are left to the tree-walk, which only needs the temps
+ * of one expression at a time. */
+#define EXPR_CODE_MAX_STMT_TEMPS 1024
+
+enum expr_code_patch_kind {
+  ECP_BREAK,    /* jump to the end of loop or switch target_ */
+  ECP_CONTINUE, /* jump to the continuation of loop target_ */
+  ECP_GOTO,     /* jump to labeled statement target_ */
+  ECP_RETURN    /* jump to the ECO_END */
+};
+
+/* Jump whose target is not known when it is emitted */
+struct expr_code_patch {
+  enum expr_code_patch_kind kind_;
+  size_t insn_;
+  struct stmt *target_;
+};
+
+struct expr_code_compiler {
+  struct c_compiler *cc_;
+  struct expr_code *code_;
+
+  /* Temp of ordinal 0 of the expression being compiled, its ordinal n is in temp base_ + n */
+  int base_;
+
+  /* Representation known to be held by the temp of each ordinal of the expression being compiled,
+   * EIR_OTHER if unknown */
+  enum expr_int_rep *reps_;
+  int num_reps_allocated_;
+
+  size_t num_patches_;
+  size_t num_patches_allocated_;
+  struct expr_code_patch *patches_;
+};
+
+static struct expr_insn *expr_code_emit(struct expr_code *code, enum expr_code_op op) {
+  if (code->num_insns_ == code->num_insns_allocated_) {
+    size_t new_num_allocated = code->num_insns_allocated_ * 2 + 16;
+    if (new_num_allocated <= code->num_insns_allocated_) {
+      /* overflow */
+      return NULL;
+    }
+    if (new_num_allocated > (SIZE_MAX / sizeof(struct expr_insn))) {
+      return NULL;
+    }
+    struct expr_insn *new_insns = (struct expr_insn *)realloc(code->insns_, new_num_allocated * sizeof(struct expr_insn));
+    if (!new_insns) return NULL;
+    code->insns_ = new_insns;
+    code->num_insns_allocated_ = new_num_allocated;
+  }
+  struct expr_insn *insn = code->insns_ + code->num_insns_++;
+  memset(insn, 0, sizeof(*insn));
+  insn->code_ = op;
+  return insn;
+}
+
+static int expr_code_emit_patch(struct expr_code_compiler *ecc, enum expr_code_op op, enum expr_code_patch_kind kind, struct stmt *target) {
+  if (ecc->num_patches_ == ecc->num_patches_allocated_) {
+    size_t new_num_allocated = ecc->num_patches_allocated_ * 2 + 16;
+    if (new_num_allocated > (SIZE_MAX / sizeof(struct expr_code_patch))) {
+      return -1;
+    }
+    struct expr_code_patch *new_patches = (struct expr_code_patch *)realloc(ecc->patches_, new_num_allocated * sizeof(struct expr_code_patch));
+    if (!new_patches) return -1;
+    ecc->patches_ = new_patches;
+    ecc->num_patches_allocated_ = new_num_allocated;
+  }
+  struct expr_code_patch *patch = ecc->patches_ + ecc->num_patches_++;
+  patch->kind_ = kind;
+  patch->insn_ = ecc->code_->num_insns_;
+  patch->target_ = target;
+  return expr_code_emit(ecc->code_, op) ? 0 : -1;
+}
+
+/* Resolves the jumps of kind to target, to continue at insn at */
+static void expr_code_resolve_patches(struct expr_code_compiler *ecc, enum expr_code_patch_kind kind, struct stmt *target, size_t at) {
+  size_t n;
+  for (n = 0; n < ecc->num_patches_; ++n) {
+    struct expr_code_patch *patch = ecc->patches_ + n;
+    if ((patch->kind_ == kind) && (patch->target_ == target)) {
+      ecc->code_->insns_[patch->insn_].target_ = at;
+    }
+  }
+}
+
+static struct expr_code *expr_code_alloc(void) {
+  struct expr_code *code = (struct expr_code *)malloc(sizeof(struct expr_code));
+  if (!code) return NULL;
+  code->num_temps_ = 0;
+  code->num_insns_ = code->num_insns_allocated_ = 0;
+  code->insns_ = NULL;
+  return code;
+}
+
+/* Converts v to the representation rep */
+static uint64_t expr_code_convert(enum expr_int_rep rep, uint64_t v) {
+  switch (rep) {
+    case EIR_I8: return (uint64_t)(int64_t)(int8_t)v;
+    case EIR_I16: return (uint64_t)(int64_t)(int16_t)v;
+    case EIR_I32: return (uint64_t)(int64_t)(int32_t)v;
+    case EIR_U8: return (uint8_t)v;
+    case EIR_U16: return (uint16_t)v;
+    case EIR_U32: return (uint32_t)v;
+    case EIR_BOOL: return !!v;
+    default: return v;
+  }
+}
+
+/* Returns non-zero if operand opd of x, loaded as dec->tile_load_[opd], needs no conversion. All 64
+ * bits of a temp are its value as a 64 bit integer, smaller representations depend on the node
+ * that computed it. */
+static int expr_code_operand_holds(struct expr_code_compiler *ecc, struct expr *x, struct expr_decoded *dec, int opd) {
+  enum expr_int_rep load = dec->tile_load_[opd];
+  if ((load == EIR_I64) || (load == EIR_U64)) return 1;
+  return (load != EIR_NONE) && (load != EIR_OTHER) && (ecc->reps_[x->children_[opd]->ord_] == load);
+}
+
+/* Selects the typed operation for the decoded node x; returns 0 and sets *op if there is one,
+ * non-zero if x is to be evaluated by ECO_EVAL. */
+static int expr_code_select(struct expr_code_compiler *ecc, struct expr *x, struct expr_decoded *dec, enum expr_code_op *op) {
+  enum expr_int_rep rep = dec->tile_store_;
+  int is_32 = (rep == EIR_I32) || (rep == EIR_U32);
+  int is_64 = (rep == EIR_I64) || (rep == EIR_U64);
+  int is_signed = (rep == EIR_I8) || (rep == EIR_I16) || (rep == EIR_I32) || (rep == EIR_I64);
+  int is_unsigned = (rep == EIR_U8) || (rep == EIR_U16) || (rep == EIR_U32) || (rep == EIR_U64);
+  int opd;
+
+  switch (dec->tile_) {
+    case ETL_NONE:
+      return -1;
+    case ETL_IMM:
+      *op = ECO_IMM;
+      return 0;
+    case ETL_LOCAL_ADDR:
+      *op = ECO_LOCAL_ADDR;
+      return 0;
+    case ETL_PARAM_ADDR:
+      *op = ECO_PARAM_ADDR;
+      return 0;
+    case ETL_CONVERT:
+    case ETL_NEG:
+    case ETL_COMPL:
+    case ETL_INDIR:
+      if (!expr_code_operand_holds(ecc, x, dec, 0)) return -1;
+      break;
+    default:
+      for (opd = 0; opd < 2; ++opd) {
+        if (!expr_code_operand_holds(ecc, x, dec, opd)) return -1;
+      }
+      break;
+  }
+
+  switch (dec->tile_) {
+    case ETL_CONVERT:
+      switch (rep) {
+        case EIR_I8: *op = ECO_CVT_I8; return 0;
+        case EIR_I16: *op = ECO_CVT_I16; return 0;
+        case EIR_I32: *op = ECO_CVT_I32; return 0;
+        case EIR_U8: *op = ECO_CVT_U8; return 0;
+        case EIR_U16: *op = ECO_CVT_U16; return 0;
+        case EIR_U32: *op = ECO_CVT_U32; return 0;
+        case EIR_I64: case EIR_U64: *op = ECO_CVT_64; return 0;
+        case EIR_BOOL: *op = ECO_CVT_BOOL; return 0;
+        default: return -1;
+      }
+    case ETL_ADD:
+    case ETL_SUB:
+    case ETL_MUL:
+    case ETL_NEG:
+    case ETL_SHL: {
+      /* The low 32 or 64 bits of the result do not depend on the upper bits of the operands */
+      static const enum expr_code_op ops[][3] = {
+        { ECO_ADD_I32, ECO_ADD_U32, ECO_ADD_64 },
+        { ECO_SUB_I32, ECO_SUB_U32, ECO_SUB_64 },
+        { ECO_MUL_I32, ECO_MUL_U32, ECO_MUL_64 },
+        { ECO_NEG_I32, ECO_NEG_U32, ECO_NEG_64 },
+        { ECO_SHL_I32, ECO_SHL_U32, ECO_SHL_64 }
+      };
+      int row = (dec->tile_ == ETL_ADD) ? 0 : (dec->tile_ == ETL_SUB) ? 1 : (dec->tile_ == ETL_MUL) ? 2 : (dec->tile_ == ETL_NEG) ? 3 : 4;
+      if (!is_32 && !is_64) return -1;
+      *op = ops[row][(rep == EIR_I32) ? 0 : (rep == EIR_U32) ? 1 : 2];
+      return 0;
+    }
+    case ETL_AND:
+    case ETL_OR:
+    case ETL_XOR:
+      /* Operands of the same representation as the result stay in it */
+      if ((dec->tile_load_[0] != rep) || (dec->tile_load_[1] != rep)) return -1;
+      *op = (dec->tile_ == ETL_AND) ? ECO_AND : (dec->tile_ == ETL_OR) ? ECO_OR : ECO_XOR;
+      return 0;
+    case ETL_COMPL:
+      if (dec->tile_load_[0] != rep) return -1;
+      if (rep == EIR_U32) *op = ECO_COMPL_U32;
+      else if (is_signed || (rep == EIR_U64)) *op = ECO_COMPL;
+      else return -1;
+      return 0;
+    case ETL_SHR:
+      if (dec->tile_load_[0] != rep) return -1;
+      if (is_signed) *op = ECO_SHR_S;
+      else if (is_unsigned) *op = ECO_SHR_U;
+      else return -1;
+      return 0;
+    case ETL_LT: *op = ECO_LT_S; return 0;
+    case ETL_ULT: *op = ECO_LT_U; return 0;
+    case ETL_GT: *op = ECO_GT_S; return 0;
+    case ETL_UGT: *op = ECO_GT_U; return 0;
+    case ETL_LTE: *op = ECO_LTE_S; return 0;
+    case ETL_ULTE: *op = ECO_LTE_U; return 0;
+    case ETL_GTE: *op = ECO_GTE_S; return 0;
+    case ETL_UGTE: *op = ECO_GTE_U; return 0;
+    case ETL_EQ: *op = ECO_EQ; return 0;
+    case ETL_NE: *op = ECO_NE; return 0;
+    case ETL_INDIR:
+      switch (rep) {
+        case EIR_I8: *op = ECO_LOAD_I8; return 0;
+        case EIR_I16: *op = ECO_LOAD_I16; return 0;
+        case EIR_I32: *op = ECO_LOAD_I32; return 0;
+        case EIR_I64: case EIR_U64: *op = ECO_LOAD_64; return 0;
+        case EIR_U8: *op = ECO_LOAD_U8; return 0;
+        case EIR_U16: *op = ECO_LOAD_U16; return 0;
+        case EIR_U32: *op = ECO_LOAD_U32; return 0;
+        case EIR_BOOL: *op = ECO_LOAD_BOOL; return 0;
+        default: return -1;
+      }
+    case ETL_STORE:
+      /* The result is the operand stored */
+      if (dec->tile_load_[1] != rep) return -1;
+      switch (dec->tile_bits_) {
+        case 8: *op = ECO_STORE_8; return 0;
+        case 16: *op = ECO_STORE_16; return 0;
+        case 32: *op = ECO_STORE_32; return 0;
+        case 64: *op = ECO_STORE_64; return 0;
+        default: return -1;
+      }
+    default:
+      return -1;
+  }
+}
+
+static int expr_code_compile_node(struct expr_code_compiler *ecc, struct expr *x) {
+  struct expr_decoded dec;
+  enum expr_code_op op;
+  struct expr_insn *insn;
+  int dst = ecc->base_ + x->ord_;
+
+  ecc->reps_[x->ord_] = EIR_OTHER;
+  if (expr_decode_node(ecc->cc_, x, &dec)) {
+    /* Decoded by ECO_EVAL once it is reached */
+    insn = expr_code_emit(ecc->code_, ECO_EVAL);
+    if (!insn) return -1;
+    insn->x_ = x;
+    insn->base_ = ecc->base_;
+    return 0;
+  }
+
+  if ((dec.tile_store_ != EIR_NONE) && (dec.tile_store_ != EIR_OTHER)) {
+    /* The final store of the node converts to its representation */
+    ecc->reps_[x->ord_] = dec.tile_store_;
+  }
+
+  if (expr_code_select(ecc, x, &dec, &op)) {
+    insn = expr_code_emit(ecc->code_, ECO_EVAL);
+    if (!insn) return -1;
+    insn->x_ = x;
+    insn->base_ = ecc->base_;
+    insn->dec_ = dec;
+    return 0;
+  }
+
+  insn = expr_code_emit(ecc->code_, op);
+  if (!insn) return -1;
+  insn->dst_ = dst;
+  if ((op == ECO_LOCAL_ADDR) || (op == ECO_PARAM_ADDR)) {
+    insn->decl_ = x->decl_;
+  }
+  else if (op == ECO_IMM) {
+    insn->imm_ = expr_code_convert(dec.tile_store_, x->v_.u64_);
+  }
+  else {
+    insn->src_[0] = ecc->base_ + x->children_[0]->ord_;
+    if ((dec.tile_load_[1] != EIR_NONE) && x->children_[1]) {
+      insn->src_[1] = ecc->base_ + x->children_[1]->ord_;
+    }
+  }
+  return 0;
+}
+
+static int expr_code_emit_move(struct expr_code_compiler *ecc, enum expr_code_op op, struct expr *x, struct expr *src) {
+  struct expr_insn *insn = expr_code_emit(ecc->code_, op);
+  if (!insn) return -1;
+  insn->dst_ = ecc->base_ + x->ord_;
+  insn->src_[0] = ecc->base_ + src->ord_;
+  return 0;
+}
+
+static int expr_code_emit_branch(struct expr_code_compiler *ecc, enum expr_code_op op, int src, size_t *at) {
+  struct expr_insn *insn;
+  *at = ecc->code_->num_insns_;
+  insn = expr_code_emit(ecc->code_, op);
+  if (!insn) return -1;
+  insn->src_[0] = src;
+  return 0;
+}
+
+static int expr_code_compile_impl(struct expr_code_compiler *ecc, struct expr *x, int parent_ordinal) {
+  /* Mirrors expr_eval_impl() in expr.c; the sequence of nodes evaluated must match the order in
+   * which the tree-walk evaluates them. */
+  int r;
+  size_t skip_at, end_at;
+  if (!x) return -1;
+
+  /* Only execute the tree once, as the tree may actually be a DAG */
+  if (x->ord_ < parent_ordinal) return 0;
+
+  if ((x->et_ == ET_LOGICAL_AND) || (x->et_ == ET_LOGICAL_OR)) {
+    r = expr_code_compile_impl(ecc, x->children_[0], x->ord_);
+    if (r) return r;
+
+    /* AND skips to false when the first branch is zero, OR skips to true when it is non-zero */
+    r = expr_code_emit_branch(ecc, (x->et_ == ET_LOGICAL_AND) ? ECO_JUMP_IF_ZERO : ECO_JUMP_IF_NONZERO, ecc->base_ + x->children_[0]->ord_, &skip_at);
+    if (r) return r;
+
+    /* Evaluation equals that of second branch */
+    r = expr_code_compile_impl(ecc, x->children_[1], x->ord_);
+    if (r) return r;
+    r = expr_code_emit_move(ecc, ECO_MOVE, x, x->children_[1]);
+    if (r) return r;
+    r = expr_code_emit_branch(ecc, ECO_JUMP, 0, &end_at);
+    if (r) return r;
+
+    ecc->code_->insns_[skip_at].target_ = ecc->code_->num_insns_;
+    if (x->et_ == ET_LOGICAL_AND) {
+      struct expr_insn *insn = expr_code_emit(ecc->code_, ECO_CLEAR);
+      if (!insn) return -1;
+      insn->dst_ = ecc->base_ + x->ord_;
+      /* Zero is held by any representation */
+      ecc->reps_[x->ord_] = ecc->reps_[x->children_[1]->ord_];
+    }
+    else {
+      r = expr_code_emit_move(ecc, ECO_MOVE, x, x->children_[0]);
+      if (r) return r;
+      ecc->reps_[x->ord_] = (ecc->reps_[x->children_[0]->ord_] == ecc->reps_[x->children_[1]->ord_]) ? ecc->reps_[x->children_[0]->ord_] : EIR_OTHER;
+    }
+
+    ecc->code_->insns_[end_at].target_ = ecc->code_->num_insns_;
+    return 0;
+  }
+  else if (x->et_ == ET_CONDITION) {
+    r = expr_code_compile_impl(ecc, x->children_[0], x->ord_);
+    if (r) return r;
+
+    r = expr_code_emit_branch(ecc, ECO_JUMP_IF_ZERO, ecc->base_ + x->children_[0]->ord_, &skip_at);
+    if (r) return r;
+
+    r = expr_code_compile_impl(ecc, x->children_[1], x->ord_);
+    if (r) return r;
+    r = expr_code_emit_move(ecc, ECO_MOVE, x, x->children_[1]);
+    if (r) return r;
+    r = expr_code_emit_branch(ecc, ECO_JUMP, 0, &end_at);
+    if (r) return r;
+
+    ecc->code_->insns_[skip_at].target_ = ecc->code_->num_insns_;
+    r = expr_code_compile_impl(ecc, x->children_[2], x->ord_);
+    if (r) return r;
+    r = expr_code_emit_move(ecc, ECO_MOVE, x, x->children_[2]);
+    if (r) return r;
+    ecc->reps_[x->ord_] = (ecc->reps_[x->children_[1]->ord_] == ecc->reps_[x->children_[2]->ord_]) ? ecc->reps_[x->children_[1]->ord_] : EIR_OTHER;
+
+    ecc->code_->insns_[end_at].target_ = ecc->code_->num_insns_;
+    return 0;
+  }
+
+  int num_operands = expr_num_operands(x);
+  if (x->et_ == ET_FUNCTION_CALL) {
+    /* NULL is a valid second argument (would normally be ET_FUNCTION_CALL_ARG_LIST but can be NULL if no arguments.) */
+    if (!x->children_[1]) num_operands--;
+  }
+  int n;
+  int at_sibling_ord = x->ord_ + 1;
+
+  for (n = 0; n < num_operands; ++n) {
+    r = expr_code_compile_impl(ecc, x->children_[n], at_sibling_ord);
+    if (r) return r;
+    if (x->children_[n]->ord_ >= at_sibling_ord) {
+      /* This was not a back-reference, proceed with increment. */
+      at_sibling_ord += x->children_[n]->num_ords_;
+    }
+  }
+
+  if (x->et_ == ET_SEQ) {
+    r = expr_code_emit_move(ecc, ECO_COPY, x, x->children_[1]);
+    if (r) return r;
+    ecc->reps_[x->ord_] = ecc->reps_[x->children_[1]->ord_];
+    return 0;
+  }
+
+  return expr_code_compile_node(ecc, x);
+}
+
+/* Compiles expression x into the temps following those of any expressions compiled before it,
+ * setting *value to the temp that holds its value. */
+static int expr_code_compile_expr(struct expr_code_compiler *ecc, struct expr *x, int *value) {
+  int n;
+  if (!x || (x->num_ords_ < 1)) return -1;
+  if (x->num_ords_ >= (INT_MAX - ecc->code_->num_temps_)) return -1;
+
+  if (x->num_ords_ >= ecc->num_reps_allocated_) {
+    enum expr_int_rep *new_reps = (enum expr_int_rep *)realloc(ecc->reps_, (x->num_ords_ + 1) * sizeof(enum expr_int_rep));
+    if (!new_reps) return -1;
+    ecc->reps_ = new_reps;
+    ecc->num_reps_allocated_ = x->num_ords_ + 1;
+  }
+  for (n = 0; n <= x->num_ords_; ++n) {
+    ecc->reps_[n] = EIR_OTHER;
+  }
+
+  ecc->base_ = ecc->code_->num_temps_;
+  ecc->code_->num_temps_ += x->num_ords_;
+  *value = ecc->base_ + x->ord_;
+  return expr_code_compile_impl(ecc, x, 0);
+}
+
+static void expr_code_compiler_init(struct expr_code_compiler *ecc, struct c_compiler *cc, struct expr_code *code) {
+  ecc->cc_ = cc;
+  ecc->code_ = code;
+  ecc->base_ = 0;
+  ecc->reps_ = NULL;
+  ecc->num_reps_allocated_ = 0;
+  ecc->num_patches_ = ecc->num_patches_allocated_ = 0;
+  ecc->patches_ = NULL;
+}
+
+static void expr_code_compiler_cleanup(struct expr_code_compiler *ecc) {
+  if (ecc->reps_) free(ecc->reps_);
+  if (ecc->patches_) free(ecc->patches_);
+}
+
+int expr_code_compile(struct c_compiler *cc, struct expr *x) {
+  int r;
+  int value;
+  struct expr_code_compiler ecc;
+  if (!x) return -1;
+
+  struct expr_code *code = expr_code_alloc();
+  if (!code) return -1;
+  expr_code_compiler_init(&ecc, cc, code);
+
+  r = expr_code_compile_expr(&ecc, x, &value);
+  if (!r && !expr_code_emit(code, ECO_END)) r = -1;
+  expr_code_compiler_cleanup(&ecc);
+  if (r) {
+    expr_code_free(code);
+    return r;
+  }
+
+  expr_code_free(x->code_);
+  x->code_ = code;
+  return 0;
+}
+
+static int expr_code_compile_stmt_impl(struct expr_code_compiler *ecc, struct stmt *s);
+
+/* Compiles first and the statements following it, up to the end of the list of its parent, in the
+ * same way that stmt_exec() steps to the next statement. */
+static int expr_code_compile_stmt_list(struct expr_code_compiler *ecc, struct stmt *first) {
+  int r;
+  struct stmt *s = first;
+  if (!s) return 0;
+  for (;;) {
+    r = expr_code_compile_stmt_impl(ecc, s);
+    if (r) return r;
+    if (!s->parent_) {
+      /* stmt_exec() ends execution here */
+      return -1;
+    }
+    if ((s->next_ == s->parent_->child0_) || (s->next_ == s->parent_->child1_)) {
+      return 0;
+    }
+    s = s->next_;
+  }
+}
+
+/* Compiles the condition x, followed by a branch of kind op on its value, setting *at to the branch */
+static int expr_code_compile_cond(struct expr_code_compiler *ecc, struct expr *x, enum expr_code_op op, size_t *at) {
+  int value;
+  int r = expr_code_compile_expr(ecc, x, &value);
+  if (r) return r;
+  return expr_code_emit_branch(ecc, op, value, at);
+}
+
+static int expr_code_compile_stmt_impl(struct expr_code_compiler *ecc, struct stmt *s) {
+  /* Mirrors stmt_exec() in stmt.c */
+  int r;
+  int value;
+  size_t top_at, cont_at, skip_at, end_at;
+  struct expr_code *code = ecc->code_;
+
+  s->code_at_ = code->num_insns_;
+  switch (s->type_) {
+    case ST_LABEL:
+    case ST_CASE:
+    case ST_DEFAULT:
+    case ST_BLOCK:
+      return expr_code_compile_stmt_list(ecc, s->child0_);
+    case ST_EXPR:
+      return expr_code_compile_expr(ecc, s->expr0_, &value);
+    case ST_IF:
+      r = expr_code_compile_cond(ecc, s->expr0_, ECO_JUMP_IF_ZERO, &skip_at);
+      if (r) return r;
+      r = expr_code_compile_stmt_list(ecc, s->child0_);
+      if (r) return r;
+      code->insns_[skip_at].target_ = code->num_insns_;
+      return 0;
+    case ST_IF_ELSE:
+      r = expr_code_compile_cond(ecc, s->expr0_, ECO_JUMP_IF_ZERO, &skip_at);
+      if (r) return r;
+      r = expr_code_compile_stmt_list(ecc, s->child0_);
+      if (r) return r;
+      r = expr_code_emit_branch(ecc, ECO_JUMP, 0, &end_at);
+      if (r) return r;
+      code->insns_[skip_at].target_ = code->num_insns_;
+      r = expr_code_compile_stmt_list(ecc, s->child1_);
+      if (r) return r;
+      code->insns_[end_at].target_ = code->num_insns_;
+      return 0;
+    case ST_SWITCH: {
+      r = expr_code_compile_cond(ecc, s->expr0_, ECO_SWITCH, &skip_at);
+      if (r) return r;
+      code->insns_[skip_at].switch_ = s;
+      r = expr_code_compile_stmt_list(ecc, s->child0_);
+      if (r) return r;
+      /* No case and no default falls through to the statement after the switch */
+      code->insns_[skip_at].target_ = code->num_insns_;
+      expr_code_resolve_patches(ecc, ECP_BREAK, s, code->num_insns_);
+      return 0;
+    }
+    case ST_WHILE:
+      top_at = code->num_insns_;
+      r = expr_code_compile_cond(ecc, s->expr0_, ECO_JUMP_IF_ZERO, &skip_at);
+      if (r) return r;
+      r = expr_code_compile_stmt_list(ecc, s->child0_);
+      if (r) return r;
+      r = expr_code_emit_branch(ecc, ECO_JUMP, 0, &end_at);
+      if (r) return r;
+      code->insns_[end_at].target_ = top_at;
+      code->insns_[skip_at].target_ = code->num_insns_;
+      expr_code_resolve_patches(ecc, ECP_CONTINUE, s, top_at);
+      expr_code_resolve_patches(ecc, ECP_BREAK, s, code->num_insns_);
+      return 0;
+    case ST_DO_WHILE:
+      top_at = code->num_insns_;
+      r = expr_code_compile_stmt_list(ecc, s->child0_);
+      if (r) return r;
+      cont_at = code->num_insns_;
+      r = expr_code_compile_cond(ecc, s->expr0_, ECO_JUMP_IF_NONZERO, &end_at);
+      if (r) return r;
+      code->insns_[end_at].target_ = top_at;
+      expr_code_resolve_patches(ecc, ECP_CONTINUE, s, cont_at);
+      expr_code_resolve_patches(ecc, ECP_BREAK, s, code->num_insns_);
+      return 0;
+    case ST_FOR:
+      if (s->expr0_) {
+        r = expr_code_compile_expr(ecc, s->expr0_, &value);
+        if (r) return r;
+      }
+      top_at = code->num_insns_;
+      if (s->expr1_) {
+        r = expr_code_compile_cond(ecc, s->expr1_, ECO_JUMP_IF_ZERO, &skip_at);
+        if (r) return r;
+      }
+      r = expr_code_compile_stmt_list(ecc, s->child0_);
+      if (r) return r;
+      cont_at = code->num_insns_;
+      if (s->expr2_) {
+        r = expr_code_compile_expr(ecc, s->expr2_, &value);
+        if (r) return r;
+      }
+      r = expr_code_emit_branch(ecc, ECO_JUMP, 0, &end_at);
+      if (r) return r;
+      code->insns_[end_at].target_ = top_at;
+      if (s->expr1_) {
+        code->insns_[skip_at].target_ = code->num_insns_;
+      }
+      expr_code_resolve_patches(ecc, ECP_CONTINUE, s, cont_at);
+      expr_code_resolve_patches(ecc, ECP_BREAK, s, code->num_insns_);
+      return 0;
+    case ST_GOTO:
+      if (!s->goto_destination_) return -1;
+      return expr_code_emit_patch(ecc, ECO_JUMP, ECP_GOTO, s->goto_destination_);
+    case ST_CONTINUE:
+      if (!s->continue_parent_) return -1;
+      return expr_code_emit_patch(ecc, ECO_JUMP, ECP_CONTINUE, s->continue_parent_);
+    case ST_BREAK:
+      if (!s->break_parent_) return -1;
+      return expr_code_emit_patch(ecc, ECO_JUMP, ECP_BREAK, s->break_parent_);
+    case ST_RETURN:
+      if (s->expr0_) {
+        r = expr_code_compile_expr(ecc, s->expr0_, &value);
+        if (r) return r;
+      }
+      return expr_code_emit_patch(ecc, ECO_JUMP, ECP_RETURN, NULL);
+    case ST_NOP:
+      return 0;
+  }
+  return -1;
+}
+
+int expr_code_compile_stmt(struct c_compiler *cc, struct stmt *root) {
+  int r;
+  size_t n;
+  struct expr_code_compiler ecc;
+  if (!root) return -1;
+
+  struct expr_code *code = expr_code_alloc();
+  if (!code) return -1;
+  expr_code_compiler_init(&ecc, cc, code);
+
+  r = expr_code_compile_stmt_impl(&ecc, root);
+  if (!r && (code->num_temps_ > EXPR_CODE_MAX_STMT_TEMPS)) r = -1;
+  if (!r && !expr_code_emit(code, ECO_END)) r = -1;
+  for (n = 0; !r && (n < ecc.num_patches_); ++n) {
+    struct expr_code_patch *patch = ecc.patches_ + n;
+    if (patch->kind_ == ECP_RETURN) {
+      code->insns_[patch->insn_].target_ = code->num_insns_ - 1;
+    }
+    else if (patch->kind_ == ECP_GOTO) {
+      /* The label must be inside root for its code_at_ to be that of this code */
+      struct stmt *s = patch->target_;
+      while (s && (s != root)) s = s->parent_;
+      if (!s) r = -1;
+      else code->insns_[patch->insn_].target_ = patch->target_->code_at_;
+    }
+    else {
+      /* break and continue are resolved by their loop or switch, which must then be inside root */
+      struct stmt *s = patch->target_;
+      while (s && (s != root)) s = s->parent_;
+      if (!s) r = -1;
+    }
+  }
+  expr_code_compiler_cleanup(&ecc);
+  if (r) {
+    expr_code_free(code);
+    return r;
+  }
+
+  expr_code_free(root->code_);
+  root->code_ = code;
+  return 0;
+}
+
+void expr_code_free(struct expr_code *code) {
+  if (!code) return;
+  if (code->insns_) free(code->insns_);
+  free(code);
+}
+
+/* Finishes running the code at ip after a node raised a fatal error, as the tree-walk does: the
+ * control flow continues, but evaluating any further node fails. */
+static int expr_code_run_after_fatal(struct expr_code *code, struct expr_insn *ip, struct expr_temp *temps, struct expr_temp *result) {
+  struct expr_insn *insns = code->insns_;
+  for (;;) {
+    switch (ip->code_) {
+      case ECO_JUMP:
+        ip = insns + ip->target_;
+        break;
+      case ECO_JUMP_IF_ZERO:
+        ip = temps[ip->src_[0]].v_.i64_ ? ip + 1 : insns + ip->target_;
+        break;
+      case ECO_JUMP_IF_NONZERO:
+        ip = temps[ip->src_[0]].v_.i64_ ? insns + ip->target_ : ip + 1;
+        break;
+      case ECO_MOVE:
+        temps[ip->dst_].v_ = temps[ip->src_[0]].v_;
+        ++ip;
+        break;
+      case ECO_CLEAR:
+        temps[ip->dst_].v_.i64_ = 0;
+        ++ip;
+        break;
+      case ECO_SWITCH: {
+        struct switch_case *sc = switch_find_case(&ip->switch_->cases_, temps[ip->src_[0]].v_.u64_);
+        if (!sc) sc = ip->switch_->cases_.default_;
+        ip = sc ? insns + sc->case_stmt_->code_at_ : insns + ip->target_;
+        break;
+      }
+      case ECO_END:
+        memcpy(result, &temps[1], sizeof(*result));
+        return 0;
+      default:
+        /* Evaluation of a node */
+        return -1;
+    }
+  }
+}
+
+int expr_code_run(struct c_compiler *cc, struct expr_code *code, struct expr_temp *result, int is_constant_expr, struct decl *nulled_out_decl, void *local_base, void *param_base, void *return_value_ptr) {
+  int r;
+  struct expr_insn *insns = code->insns_;
+  struct expr_insn *ip = insns;
+
+#ifdef _WIN32
+#define EXPR_CODE_ALLOCA _alloca
+#else
+#define EXPR_CODE_ALLOCA alloca
+#endif
+  struct expr_temp *temps = (struct expr_temp *)EXPR_CODE_ALLOCA((1 + code->num_temps_ /* ordinals are 1-based */) * sizeof(struct expr_temp));
+  memset(temps, 0, (1 + code->num_temps_) * sizeof(struct expr_temp));
+
+  if (cc->fatal_error_) {
+    return expr_code_run_after_fatal(code, ip, temps, result);
+  }
+
+#define ECO_DST temps[ip->dst_].v_
+#define ECO_A temps[ip->src_[0]].v_
+#define ECO_B temps[ip->src_[1]].v_
+#define ECO_SHIFT (ECO_B.u64_ & 63)
+#define ECO_PTR(type) ((type *)(uintptr_t)ECO_A.u64_)
+
+#ifdef __GNUC__
+  /* Threaded dispatch; each instruction jumps directly to the handler of the next, giving the
+   * branch predictor one indirect branch per handler rather than a single shared one. */
+  static void *dispatch[] = {
+#define xx(op) &&handle_##op,
+    ENUM_EXPR_CODE_OPS
+#undef xx
+  };
+#define ECO_CASE(op) handle_##op:
+#define ECO_NEXT() goto *dispatch[ip->code_]
+
+  ECO_NEXT();
+#else
+#define ECO_CASE(op) case op:
+#define ECO_NEXT() continue
+
+  for (;;) {
+    switch (ip->code_) {
+#endif
+      ECO_CASE(ECO_EVAL)
+        /* A fatal error leaves the rest of the code to expr_code_run_after_fatal(), so it is not set here */
+        r = expr_eval_node(cc, ip->x_, &ip->dec_, temps + ip->base_, is_constant_expr, nulled_out_decl, local_base, param_base, return_value_ptr);
+        if (r) return r;
+        ++ip;
+        if (cc->fatal_error_) {
+          return expr_code_run_after_fatal(code, ip, temps, result);
+        }
+        ECO_NEXT();
+
+      ECO_CASE(ECO_JUMP)
+        ip = insns + ip->target_;
+        ECO_NEXT();
+
+      ECO_CASE(ECO_JUMP_IF_ZERO)
+        ip = ECO_A.i64_ ? ip + 1 : insns + ip->target_;
+        ECO_NEXT();
+
+      ECO_CASE(ECO_JUMP_IF_NONZERO)
+        ip = ECO_A.i64_ ? insns + ip->target_ : ip + 1;
+        ECO_NEXT();
+
+      ECO_CASE(ECO_MOVE)
+      ECO_CASE(ECO_COPY)
+        ECO_DST = ECO_A;
+        ++ip;
+        ECO_NEXT();
+
+      ECO_CASE(ECO_CLEAR)
+        ECO_DST.i64_ = 0;
+        ++ip;
+        ECO_NEXT();
+
+      ECO_CASE(ECO_SWITCH) {
+        struct switch_case *sc = switch_find_case(&ip->switch_->cases_, ECO_A.u64_);
+        if (!sc) sc = ip->switch_->cases_.default_;
+        ip = sc ? insns + sc->case_stmt_->code_at_ : insns + ip->target_;
+        ECO_NEXT();
+      }
+
+      ECO_CASE(ECO_END)
+        memcpy(result, &temps[1], sizeof(*result));
+        return 0;
+
+#define ECO_OP(op, expr) ECO_CASE(op) expr; ++ip; ECO_NEXT();
+      ECO_OP(ECO_IMM, ECO_DST.u64_ = ip->imm_)
+      ECO_OP(ECO_LOCAL_ADDR, ECO_DST.u64_ = (uint64_t)(uintptr_t)(((char *)local_base) + ip->decl_->local_offset_))
+      ECO_OP(ECO_PARAM_ADDR, ECO_DST.u64_ = (uint64_t)(uintptr_t)(((char *)param_base) + ip->decl_->param_offset_))
+
+      ECO_OP(ECO_ADD_I32, ECO_DST.i64_ = (int32_t)(ECO_A.u64_ + ECO_B.u64_))
+      ECO_OP(ECO_ADD_U32, ECO_DST.u64_ = (uint32_t)(ECO_A.u64_ + ECO_B.u64_))
+      ECO_OP(ECO_ADD_64, ECO_DST.u64_ = ECO_A.u64_ + ECO_B.u64_)
+      ECO_OP(ECO_SUB_I32, ECO_DST.i64_ = (int32_t)(ECO_A.u64_ - ECO_B.u64_))
+      ECO_OP(ECO_SUB_U32, ECO_DST.u64_ = (uint32_t)(ECO_A.u64_ - ECO_B.u64_))
+      ECO_OP(ECO_SUB_64, ECO_DST.u64_ = ECO_A.u64_ - ECO_B.u64_)
+      ECO_OP(ECO_MUL_I32, ECO_DST.i64_ = (int32_t)(ECO_A.u64_ * ECO_B.u64_))
+      ECO_OP(ECO_MUL_U32, ECO_DST.u64_ = (uint32_t)(ECO_A.u64_ * ECO_B.u64_))
+      ECO_OP(ECO_MUL_64, ECO_DST.u64_ = ECO_A.u64_ * ECO_B.u64_)
+      ECO_OP(ECO_NEG_I32, ECO_DST.i64_ = (int32_t)(0 - ECO_A.u64_))
+      ECO_OP(ECO_NEG_U32, ECO_DST.u64_ = (uint32_t)(0 - ECO_A.u64_))
+      ECO_OP(ECO_NEG_64, ECO_DST.u64_ = 0 - ECO_A.u64_)
+      ECO_OP(ECO_SHL_I32, ECO_DST.i64_ = (int32_t)(ECO_A.u64_ << ECO_SHIFT))
+      ECO_OP(ECO_SHL_U32, ECO_DST.u64_ = (uint32_t)(ECO_A.u64_ << ECO_SHIFT))
+      ECO_OP(ECO_SHL_64, ECO_DST.u64_ = ECO_A.u64_ << ECO_SHIFT)
+
+      ECO_OP(ECO_AND, ECO_DST.u64_ = ECO_A.u64_ & ECO_B.u64_)
+      ECO_OP(ECO_OR, ECO_DST.u64_ = ECO_A.u64_ | ECO_B.u64_)
+      ECO_OP(ECO_XOR, ECO_DST.u64_ = ECO_A.u64_ ^ ECO_B.u64_)
+      ECO_OP(ECO_COMPL, ECO_DST.u64_ = ~ECO_A.u64_)
+      ECO_OP(ECO_COMPL_U32, ECO_DST.u64_ = (uint32_t)~ECO_A.u64_)
+      ECO_OP(ECO_SHR_S, ECO_DST.i64_ = ECO_A.i64_ >> ECO_SHIFT)
+      ECO_OP(ECO_SHR_U, ECO_DST.u64_ = ECO_A.u64_ >> ECO_SHIFT)
+
+      ECO_OP(ECO_LT_S, ECO_DST.i64_ = ECO_A.i64_ < ECO_B.i64_)
+      ECO_OP(ECO_LT_U, ECO_DST.i64_ = ECO_A.u64_ < ECO_B.u64_)
+      ECO_OP(ECO_GT_S, ECO_DST.i64_ = ECO_A.i64_ > ECO_B.i64_)
+      ECO_OP(ECO_GT_U, ECO_DST.i64_ = ECO_A.u64_ > ECO_B.u64_)
+      ECO_OP(ECO_LTE_S, ECO_DST.i64_ = ECO_A.i64_ <= ECO_B.i64_)
+      ECO_OP(ECO_LTE_U, ECO_DST.i64_ = ECO_A.u64_ <= ECO_B.u64_)
+      ECO_OP(ECO_GTE_S, ECO_DST.i64_ = ECO_A.i64_ >= ECO_B.i64_)
+      ECO_OP(ECO_GTE_U, ECO_DST.i64_ = ECO_A.u64_ >= ECO_B.u64_)
+      ECO_OP(ECO_EQ, ECO_DST.i64_ = ECO_A.u64_ == ECO_B.u64_)
+      ECO_OP(ECO_NE, ECO_DST.i64_ = ECO_A.u64_ != ECO_B.u64_)
+
+      ECO_OP(ECO_LOAD_I8, ECO_DST.i64_ = *ECO_PTR(int8_t))
+      ECO_OP(ECO_LOAD_I16, ECO_DST.i64_ = *ECO_PTR(int16_t))
+      ECO_OP(ECO_LOAD_I32, ECO_DST.i64_ = *ECO_PTR(int32_t))
+      ECO_OP(ECO_LOAD_64, ECO_DST.u64_ = *ECO_PTR(uint64_t))
+      ECO_OP(ECO_LOAD_U8, ECO_DST.u64_ = *ECO_PTR(uint8_t))
+      ECO_OP(ECO_LOAD_U16, ECO_DST.u64_ = *ECO_PTR(uint16_t))
+      ECO_OP(ECO_LOAD_U32, ECO_DST.u64_ = *ECO_PTR(uint32_t))
+      ECO_OP(ECO_LOAD_BOOL, ECO_DST.i64_ = !!*ECO_PTR(char))
+
+      ECO_OP(ECO_STORE_8, *ECO_PTR(uint8_t) = (uint8_t)ECO_B.u64_; ECO_DST.u64_ = ECO_B.u64_)
+      ECO_OP(ECO_STORE_16, *ECO_PTR(uint16_t) = (uint16_t)ECO_B.u64_; ECO_DST.u64_ = ECO_B.u64_)
+      ECO_OP(ECO_STORE_32, *ECO_PTR(uint32_t) = (uint32_t)ECO_B.u64_; ECO_DST.u64_ = ECO_B.u64_)
+      ECO_OP(ECO_STORE_64, *ECO_PTR(uint64_t) = ECO_B.u64_; ECO_DST.u64_ = ECO_B.u64_)
+
+      ECO_OP(ECO_CVT_I8, ECO_DST.i64_ = (int8_t)ECO_A.u64_)
+      ECO_OP(ECO_CVT_I16, ECO_DST.i64_ = (int16_t)ECO_A.u64_)
+      ECO_OP(ECO_CVT_I32, ECO_DST.i64_ = (int32_t)ECO_A.u64_)
+      ECO_OP(ECO_CVT_U8, ECO_DST.u64_ = (uint8_t)ECO_A.u64_)
+      ECO_OP(ECO_CVT_U16, ECO_DST.u64_ = (uint16_t)ECO_A.u64_)
+      ECO_OP(ECO_CVT_U32, ECO_DST.u64_ = (uint32_t)ECO_A.u64_)
+      ECO_OP(ECO_CVT_64, ECO_DST.u64_ = ECO_A.u64_)
+      ECO_OP(ECO_CVT_BOOL, ECO_DST.i64_ = !!ECO_A.u64_)
+#undef ECO_OP
+#ifndef __GNUC__
+    }
+  }
+#endif
+#undef ECO_CASE
+#undef ECO_NEXT
+#undef ECO_DST
+#undef ECO_A
+#undef ECO_B
+#undef ECO_SHIFT
+#undef ECO_PTR
+}
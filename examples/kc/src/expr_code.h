@@ -0,0 +1,157 @@
+/* Copyright 2023-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXPR_CODE_H
+#define EXPR_CODE_H
+
+#ifndef STDLIB_H_INCLUDED
+#define STDLIB_H_INCLUDED
+#include <stdlib.h>
+#endif
+
+#ifndef STDINT_H_INCLUDED
+#define STDINT_H_INCLUDED
+#include <stdint.h>
+#endif
+
+#ifndef EXPR_H_INCLUDED
+#define EXPR_H_INCLUDED
+#include "expr.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct c_compiler;
+struct decl;
+struct stmt;
+
+/* Operations of the bytecode. Operands are temps, resolved from the ordinals of the nodes when
+ * compiling; temps of a statement tree are those of each of its expressions, one after the other.
+ * The typed operations (from ECO_COPY on) each evaluate a node; they work on the 64 bit value of
+ * their operands, which the compiler has verified to already hold the representation (enum
+ * expr_int_rep) that the node loads them as, so only the result needs converting. Nodes that do
+ * not fit a typed operation are evaluated by ECO_EVAL. */
+#define ENUM_EXPR_CODE_OPS \
+  xx(ECO_EVAL)            /* evaluate node x_ by expr_eval_node() on the temps at base_ */ \
+  xx(ECO_JUMP)            /* continue at target_ */ \
+  xx(ECO_JUMP_IF_ZERO)    /* continue at target_ if temps[src_[0]] is zero */ \
+  xx(ECO_JUMP_IF_NONZERO) /* continue at target_ if temps[src_[0]] is non-zero */ \
+  xx(ECO_MOVE)            /* temps[dst_] = temps[src_[0]], the value of a branch of &&, || or ?: */ \
+  xx(ECO_CLEAR)           /* temps[dst_] = 0 */ \
+  xx(ECO_SWITCH)          /* continue at the case of switch_ for temps[src_[0]], or at target_ */ \
+  xx(ECO_END)             /* evaluation complete, result is in temps[1] */ \
+\
+  xx(ECO_COPY)            /* temps[dst_] = temps[src_[0]], the value of an ET_SEQ */ \
+  xx(ECO_IMM)             /* temps[dst_] = imm_ */ \
+  xx(ECO_LOCAL_ADDR)      /* temps[dst_] = local_base + decl_->local_offset_ */ \
+  xx(ECO_PARAM_ADDR)      /* temps[dst_] = param_base + decl_->param_offset_ */ \
+\
+  /* temps[dst_] = opd0 op opd1, as 32 bit signed, 32 bit unsigned, or 64 bit */ \
+  xx(ECO_ADD_I32) xx(ECO_ADD_U32) xx(ECO_ADD_64) \
+  xx(ECO_SUB_I32) xx(ECO_SUB_U32) xx(ECO_SUB_64) \
+  xx(ECO_MUL_I32) xx(ECO_MUL_U32) xx(ECO_MUL_64) \
+  xx(ECO_NEG_I32) xx(ECO_NEG_U32) xx(ECO_NEG_64) \
+  xx(ECO_SHL_I32) xx(ECO_SHL_U32) xx(ECO_SHL_64) \
+\
+  /* Bitwise operations and right shifts keep operands of the same representation in it */ \
+  xx(ECO_AND) xx(ECO_OR) xx(ECO_XOR) \
+  xx(ECO_COMPL)           /* ~opd0, for signed and 64 bit unsigned representations */ \
+  xx(ECO_COMPL_U32) \
+  xx(ECO_SHR_S) xx(ECO_SHR_U) \
+\
+  /* temps[dst_] = 1 if the comparison holds, 0 otherwise */ \
+  xx(ECO_LT_S) xx(ECO_LT_U) xx(ECO_GT_S) xx(ECO_GT_U) \
+  xx(ECO_LTE_S) xx(ECO_LTE_U) xx(ECO_GTE_S) xx(ECO_GTE_U) \
+  xx(ECO_EQ) xx(ECO_NE) \
+\
+  /* temps[dst_] = *opd0 */ \
+  xx(ECO_LOAD_I8) xx(ECO_LOAD_I16) xx(ECO_LOAD_I32) xx(ECO_LOAD_64) \
+  xx(ECO_LOAD_U8) xx(ECO_LOAD_U16) xx(ECO_LOAD_U32) xx(ECO_LOAD_BOOL) \
+\
+  /* *opd0 = opd1 truncated to the bits of the store, temps[dst_] = opd1 */ \
+  xx(ECO_STORE_8) xx(ECO_STORE_16) xx(ECO_STORE_32) xx(ECO_STORE_64) \
+\
+  /* temps[dst_] = opd0 converted */ \
+  xx(ECO_CVT_I8) xx(ECO_CVT_I16) xx(ECO_CVT_I32) \
+  xx(ECO_CVT_U8) xx(ECO_CVT_U16) xx(ECO_CVT_U32) \
+  xx(ECO_CVT_64) xx(ECO_CVT_BOOL)
+
+enum expr_code_op {
+#define xx(op) op,
+  ENUM_EXPR_CODE_OPS
+#undef xx
+};
+
+struct expr_insn {
+  enum expr_code_op code_;
+
+  /* Temps of the result and of the operands */
+  int dst_;
+  int src_[2];
+
+  size_t target_;
+
+  /* Value of ECO_IMM, already converted to the representation of the node */
+  uint64_t imm_;
+
+  /* Declaration of ECO_LOCAL_ADDR and ECO_PARAM_ADDR, its offset is not known until the locals are
+   * realized, after the code is compiled. */
+  struct decl *decl_;
+
+  /* Statement of ECO_SWITCH */
+  struct stmt *switch_;
+
+  /* Node of ECO_EVAL and the temp holding ordinal 0 of its expression; the decoded operation is
+   * filled in when compiling, or on first execution for nodes that cannot be decoded ahead. */
+  struct expr *x_;
+  int base_;
+  struct expr_decoded dec_;
+};
+
+/* Linear bytecode for an expression DAG, or for a statement tree and all its expressions. The
+ * instructions evaluate the nodes in the same order as the recursive tree-walk in expr.c does,
+ * and execute the statements as stmt_exec() does, but with the recursion, the short circuiting
+ * of &&, || and ?:, and the control flow of statements flattened into jumps. */
+struct expr_code {
+  /* Number of temps needed (not counting temps[0], as ordinals are 1-based.) */
+  int num_temps_;
+
+  size_t num_insns_;
+  size_t num_insns_allocated_;
+  struct expr_insn *insns_;
+};
+
+/* Compiles the prepared expression x into bytecode, storing the result in x->code_.
+ * Returns 0 upon success, or non-zero if x cannot be compiled, in which case x->code_
+ * remains NULL and evaluation falls back to walking the tree. */
+int expr_code_compile(struct c_compiler *cc, struct expr *x);
+
+/* Compiles the prepared statement root, and all statements and expressions in it, into bytecode,
+ * storing the result in root->code_. Returns 0 upon success, or non-zero if root cannot be compiled,
+ * in which case root->code_ remains NULL and execution falls back to walking the tree. */
+int expr_code_compile_stmt(struct c_compiler *cc, struct stmt *root);
+
+void expr_code_free(struct expr_code *code);
+
+/* Runs the bytecode, storing the value of the expression in result; arguments are as for expr_eval(). */
+int expr_code_run(struct c_compiler *cc, struct expr_code *code, struct expr_temp *result, int is_constant_expr, struct decl *nulled_out_decl, void *local_base, void *param_base, void *return_value_ptr);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* EXPR_CODE_H */
@@ -43,6 +43,11 @@
 #include "c_compiler.h"
 #endif
 
+#ifndef PPTK_CACHE_H_INCLUDED
+#define PPTK_CACHE_H_INCLUDED
+#include "pptk_cache.h"
+#endif
+
 void if_init(struct input_file *ifile, struct c_compiler *cc) {
   ifile->unpoppable_ = 0;
   ifile->cc_ = cc;
@@ -68,6 +73,16 @@ void if_init(struct input_file *ifile, struct c_compiler *cc) {
   ifile->pptk_true_input_line_number_at_start_ = 1;
   ifile->pptk_pushed_final_source_line_ = 0;
 
+  ifile->pptk_cache_lookup_pending_ = 0;
+  ifile->pptk_cache_replaying_ = 0;
+  ifile->pptk_cache_recording_ = 0;
+  ifile->pptk_cache_ = NULL;
+
+  ifile->include_guard_state_ = IFIG_START;
+  ifile->include_guard_macro_ = NULL;
+  ifile->include_guard_section_ = NULL;
+  ifile->include_guard_outer_section_ = cc->if_section_stack_;
+
   pplc_stack_init(&ifile->pplc_);
 
   situs_init(&ifile->post_line_continuation_situs_);
@@ -98,6 +113,8 @@ int if_set_filename(struct c_compiler *cc, struct input_file *ifile, const char
 }
 
 void if_cleanup(struct input_file *ifile) {
+  /* pptk_ and pplc_ scan post_line_continuation_ and post_trigraph_ in place, and restore bytes
+   * of those buffers when cleaned up, so they are cleaned up before the buffers are freed. */
   ppld_stack_cleanup(&ifile->ppld_);
   pptk_stack_cleanup(&ifile->pptk_);
 
@@ -132,6 +149,8 @@ void if_cleanup(struct input_file *ifile) {
   if (ifile->post_trigraph_) {
     free(ifile->post_trigraph_);
   }
+
+  pptk_cache_state_free(ifile->pptk_cache_);
 }
 
 void if_set_input(struct input_file *ifile, const void *input_buf, size_t input_buf_size, int is_final) {
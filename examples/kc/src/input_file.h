@@ -23,6 +23,8 @@
 
 struct pptk;
 struct c_compiler;
+struct pptk_cache_state;
+struct cc_if_section;
 
 #ifndef PP_TOKENIZER_H_INCLUDED
 #define PP_TOKENIZER_H_INCLUDED
@@ -64,6 +66,20 @@ enum input_file_kind {
   IFK_MANUAL
 };
 
+enum input_file_include_guard {
+  /* Nothing but empty lines so far */
+  IFIG_START,
+
+  /* Inside the #ifndef of a candidate include guard */
+  IFIG_OPEN,
+
+  /* Past the #endif of the include guard, nothing but empty lines since */
+  IFIG_CLOSED,
+
+  /* Not entirely wrapped in an include guard */
+  IFIG_NONE
+};
+
 struct input_file {
   /* If set, the input file is unpoppable (and EOF will not clear it from the stack) */
   int unpoppable_:1;
@@ -115,6 +131,23 @@ struct input_file {
    * line happens to be empty. */
   int pptk_pushed_final_source_line_:1;
 
+  /* Pre-tokenized file cache: pptk_cache_lookup_pending_ is set if the cache should be consulted
+   * before the file is first tokenized. Upon a hit, pptk_cache_replaying_ is set and the tokens
+   * come from the cache rather than the tokenizer. Upon a miss, pptk_cache_recording_ is set
+   * until tokenization of the file turns out to be uncacheable. */
+  int pptk_cache_lookup_pending_:1;
+  int pptk_cache_replaying_:1;
+  int pptk_cache_recording_:1;
+  struct pptk_cache_state *pptk_cache_;
+
+  /* Include guard detection: the file is guarded if it is entirely wrapped in an #ifndef
+   * include_guard_macro_ (interned) whose if-section, include_guard_section_, is nested
+   * directly in include_guard_outer_section_, the if-section the file was pushed in. */
+  enum input_file_include_guard include_guard_state_;
+  const char *include_guard_macro_;
+  struct cc_if_section *include_guard_section_;
+  struct cc_if_section *include_guard_outer_section_;
+
   /* Tokenizer for line continuations, filters line continuations out from the text */
   struct pplc_stack pplc_;
 
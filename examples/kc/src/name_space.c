@@ -65,8 +65,9 @@ void ns_cleanup(struct name_space *ns) {
 
 struct sym *ns_find_ordinary_ident(struct name_space *ns, const char *id) {
   struct sym *s;
+  uint64_t hash_value = st_hash(id);
   do {
-    s = st_find(&ns->ordinary_idents_, id);
+    s = st_find_hashed(&ns->ordinary_idents_, id, hash_value);
     if (s) return s;
     ns = ns->parent_;
   } while (ns);
@@ -76,8 +77,9 @@ struct sym *ns_find_ordinary_ident(struct name_space *ns, const char *id) {
 
 struct ns_tagged_type_sym *ns_find_struct(struct name_space *ns, const char *id) {
   struct sym *s;
+  uint64_t hash_value = st_hash(id);
   do {
-    s = st_find(&ns->struct_tags_, id);
+    s = st_find_hashed(&ns->struct_tags_, id, hash_value);
     if (s) return (struct ns_tagged_type_sym *)s;
     ns = ns->parent_;
   } while (ns);
@@ -87,8 +89,9 @@ struct ns_tagged_type_sym *ns_find_struct(struct name_space *ns, const char *id)
 
 struct ns_tagged_type_sym *ns_find_union(struct name_space *ns, const char *id) {
   struct sym *s;
+  uint64_t hash_value = st_hash(id);
   do {
-    s = st_find(&ns->union_tags_, id);
+    s = st_find_hashed(&ns->union_tags_, id, hash_value);
     if (s) return (struct ns_tagged_type_sym *)s;
     ns = ns->parent_;
   } while (ns);
@@ -98,8 +101,9 @@ struct ns_tagged_type_sym *ns_find_union(struct name_space *ns, const char *id)
 
 struct ns_tagged_type_sym *ns_find_enum(struct name_space *ns, const char *id) {
   struct sym *s;
+  uint64_t hash_value = st_hash(id);
   do {
-    s = st_find(&ns->enum_tags_, id);
+    s = st_find_hashed(&ns->enum_tags_, id, hash_value);
     if (s) return (struct ns_tagged_type_sym *)s;
     ns = ns->parent_;
   } while (ns);
@@ -107,31 +107,148 @@ static int pptk_is_whitespace(struct pptk *tk) {
   return (tk->tok_ == PPTK_WHITESPACE) || (tk->tok_ == PPTK_NEWLINE_WHITESPACE);
 }
 
-struct pptk *pptk_alloc_len(struct c_compiler *cc, struct pptk **pp_chain, const char *text, size_t text_len, int sym, struct situs *psit) {
-  struct pptk *tk = (struct pptk *)malloc(sizeof(struct pptk));
-  if (tk) {
-    tk->next_ = tk->prev_ = tk;
-    tk->tok_ = sym;
-    tk->text_len_ = text_len;
-    tk->text_ = malloc(text_len + 1);
-    if (tk->text_) {
-      memcpy(tk->text_, text, text_len);
-      tk->text_[text_len] = '\0';
+#define PPTK_SLAB_SIZE 256
+
+struct pptk_slab {
+  struct pptk_slab *next_;
+  struct pptk tokens_[PPTK_SLAB_SIZE];
+};
+
+struct pptk_spelling {
+  struct pptk_spelling *next_;
+  uint64_t hash_value_;
+  size_t len_;
+  char text_[1]; /* allocated as part of the spelling, null terminated */
+};
+
+void pptk_arena_init(struct pptk_arena *arena) {
+  arena->slabs_ = NULL;
+  arena->free_list_ = NULL;
+  arena->spellings_ = NULL;
+  arena->num_spellings_ = 0;
+  arena->num_spelling_buckets_ = 0;
+}
+
+void pptk_arena_cleanup(struct pptk_arena *arena) {
+  while (arena->slabs_) {
+    struct pptk_slab *slab = arena->slabs_;
+    arena->slabs_ = slab->next_;
+    free(slab);
+  }
+  arena->free_list_ = NULL;
+  size_t n;
+  for (n = 0; n < arena->num_spelling_buckets_; ++n) {
+    while (arena->spellings_[n]) {
+      struct pptk_spelling *sp = arena->spellings_[n];
+      arena->spellings_[n] = sp->next_;
+      free(sp);
+    }
+  }
+  if (arena->spellings_) free(arena->spellings_);
+  arena->spellings_ = NULL;
+  arena->num_spellings_ = 0;
+  arena->num_spelling_buckets_ = 0;
+}
+
+static uint64_t pptk_spelling_hash(const char *text, size_t text_len) {
+  /* FNV-1a */
+  uint64_t hash_value = 14695981039346656037ULL;
+  size_t n;
+  for (n = 0; n < text_len; ++n) {
+    hash_value ^= (uint8_t)text[n];
+    hash_value *= 1099511628211ULL;
+  }
+  return hash_value;
+}
+
+static int pptk_arena_grow_spellings(struct pptk_arena *arena) {
+  size_t new_num_buckets = arena->num_spelling_buckets_ ? arena->num_spelling_buckets_ * 2 : 1024;
+  struct pptk_spelling **new_buckets = (struct pptk_spelling **)calloc(new_num_buckets, sizeof(struct pptk_spelling *));
+  if (!new_buckets) return -1;
+  size_t n;
+  for (n = 0; n < arena->num_spelling_buckets_; ++n) {
+    while (arena->spellings_[n]) {
+      struct pptk_spelling *sp = arena->spellings_[n];
+      arena->spellings_[n] = sp->next_;
+      size_t bucket = (size_t)(sp->hash_value_ & (new_num_buckets - 1));
+      sp->next_ = new_buckets[bucket];
+      new_buckets[bucket] = sp;
+    }
+  }
+  if (arena->spellings_) free(arena->spellings_);
+  arena->spellings_ = new_buckets;
+  arena->num_spelling_buckets_ = new_num_buckets;
+  return 0;
+}
+
+const char *pptk_arena_intern(struct pptk_arena *arena, const char *text, size_t text_len) {
+  uint64_t hash_value = pptk_spelling_hash(text, text_len);
+  struct pptk_spelling *sp;
+  if (arena->num_spelling_buckets_) {
+    for (sp = arena->spellings_[hash_value & (arena->num_spelling_buckets_ - 1)]; sp; sp = sp->next_) {
+      if ((sp->hash_value_ == hash_value) && (sp->len_ == text_len) && !memcmp(sp->text_, text, text_len)) {
+        return sp->text_;
+      }
     }
-    situs_init(&tk->situs_);
-    situs_clone(&tk->situs_, psit);
-    if (sym == PPTK_STRING_LIT) {
-      tk->v_.string_.wide_ = 0;
-      tk->v_.string_.data_ = NULL;
-      tk->v_.string_.length_ = 0;
+  }
+  if (arena->num_spellings_ >= arena->num_spelling_buckets_) {
+    if (pptk_arena_grow_spellings(arena)) return NULL;
+  }
+  sp = (struct pptk_spelling *)malloc(sizeof(struct pptk_spelling) + text_len);
+  if (!sp) return NULL;
+  sp->hash_value_ = hash_value;
+  sp->len_ = text_len;
+  if (text_len) memcpy(sp->text_, text, text_len);
+  sp->text_[text_len] = '\0';
+  size_t bucket = (size_t)(hash_value & (arena->num_spelling_buckets_ - 1));
+  sp->next_ = arena->spellings_[bucket];
+  arena->spellings_[bucket] = sp;
+  arena->num_spellings_++;
+  return sp->text_;
+}
+
+uint64_t pptk_arena_text_hash(const char *interned_text) {
+  const struct pptk_spelling *sp = (const struct pptk_spelling *)(interned_text - offsetof(struct pptk_spelling, text_));
+  return sp->hash_value_;
+}
+
+static struct pptk *pptk_arena_alloc(struct pptk_arena *arena) {
+  if (!arena->free_list_) {
+    struct pptk_slab *slab = (struct pptk_slab *)malloc(sizeof(struct pptk_slab));
+    if (!slab) return NULL;
+    slab->next_ = arena->slabs_;
+    arena->slabs_ = slab;
+    size_t n;
+    for (n = 0; n < PPTK_SLAB_SIZE; ++n) {
+      slab->tokens_[n].next_ = arena->free_list_;
+      arena->free_list_ = slab->tokens_ + n;
     }
-    tk->v_.expr_ = NULL;
   }
-  if (!tk || !tk->text_) {
-    if (tk) free(tk);
+  struct pptk *tk = arena->free_list_;
+  arena->free_list_ = tk->next_;
+  return tk;
+}
+
+/* Allocates a token for text that is already interned in the compiler's arena */
+struct pptk *pptk_alloc_interned(struct c_compiler *cc, struct pptk **pp_chain, const char *interned_text, size_t text_len, int sym, struct situs *psit) {
+  struct pptk *tk = pptk_arena_alloc(&cc->pptk_arena_);
+  if (!tk) {
     cc_no_memory(cc);
     return NULL;
   }
+  tk->next_ = tk->prev_ = tk;
+  tk->arena_ = &cc->pptk_arena_;
+  tk->tok_ = sym;
+  tk->text_len_ = text_len;
+  tk->text_ = interned_text;
+  situs_init(&tk->situs_);
+  situs_clone(&tk->situs_, psit);
+  if (sym == PPTK_STRING_LIT) {
+    tk->v_.string_.wide_ = 0;
+    tk->v_.string_.data_ = NULL;
+    tk->v_.string_.length_ = 0;
+  }
+  tk->v_.expr_ = NULL;
 
   if (pp_chain) {
     *pp_chain = pptk_join(*pp_chain, tk);
@@ -140,8 +257,17 @@ struct pptk *pptk_alloc_len(struct c_compiler *cc, struct pptk **pp_chain, const
   return tk;
 }
 
+struct pptk *pptk_alloc_len(struct c_compiler *cc, struct pptk **pp_chain, const char *text, size_t text_len, int sym, struct situs *psit) {
+  const char *interned_text = pptk_arena_intern(&cc->pptk_arena_, text ? text : "", text_len);
+  if (!interned_text) {
+    cc_no_memory(cc);
+    return NULL;
+  }
+  return pptk_alloc_interned(cc, pp_chain, interned_text, text_len, sym, psit);
+}
+
 struct pptk *pptk_alloc(struct c_compiler *cc, struct pptk **pp_chain, const char *text, int sym, struct situs *psit) {
-  return pptk_alloc_len(cc, pp_chain, text, strlen(text), sym, psit);
+  return pptk_alloc_len(cc, pp_chain, text, text ? strlen(text) : 0, sym, psit);
 }
 
 void pptk_free(struct pptk *tk_chain) {
@@ -153,7 +279,6 @@ void pptk_free(struct pptk *tk_chain) {
       tk = next;
       next = tk->next_;
 
-      if (tk->text_) free(tk->text_);
       if (tk->tok_ == PPTK_STRING_LIT) {
         if (tk->v_.string_.data_) free(tk->v_.string_.data_);
       }
@@ -161,7 +286,8 @@ void pptk_free(struct pptk *tk_chain) {
         expr_free(tk->v_.expr_);
       }
       situs_cleanup(&tk->situs_);
-      free(tk);
+      tk->next_ = tk->arena_->free_list_;
+      tk->arena_->free_list_ = tk;
 
     } while (tk != tk_chain);
   }
@@ -301,7 +427,7 @@ int pptk_is_identical(const struct pptk *a, const struct pptk *b) {
 
 struct pptk *pptk_clone_single(struct c_compiler *cc, struct pptk *one) {
   if (!one) return NULL;
-  struct pptk *clone = pptk_alloc(cc, NULL, one->text_, one->tok_, &one->situs_);
+  struct pptk *clone = pptk_alloc_interned(cc, NULL, one->text_, one->text_len_, one->tok_, &one->situs_);
   if (!clone) {
     return NULL;
   }
@@ -450,7 +576,7 @@ int pptk_perform_macro_expansion(struct c_compiler *cc, struct pptk **pp_chain,
       next_sym = PPME_IDENT;
     }
     if (next_sym == PPME_IDENT) {
-      struct macro *m = (struct macro *)st_find(&cc->macro_table_, token_chain->text_);
+      struct macro *m = (struct macro *)st_find_hashed(&cc->macro_table_, token_chain->text_, pptk_arena_text_hash(token_chain->text_));
       if (m) {
         if (m->is_function_style_) {
           next_sym = PPME_FUNCTION;
@@ -599,6 +725,9 @@ int pptk_scan_str(struct c_compiler *cc, const char *text, struct pptk **pp_outp
   situs_init(&input_chain_situs);
   input_chain_situs.num_spans_ = 1;
   input_chain_situs.u_.one_.filename_ = "";
+  input_chain_situs.u_.one_.is_substitution_ = 0;
+  input_chain_situs.u_.one_.is_aux_ = 0;
+  input_chain_situs.u_.one_.num_bytes_ = text_len;
   input_chain_situs.u_.one_.start_ = 0;
   input_chain_situs.u_.one_.start_line_ = 1;
   input_chain_situs.u_.one_.start_col_= 1;
@@ -853,6 +982,13 @@ void pptk_text_cpy(char *dst, struct pptk *chain) {
   *dst = '\0';
 }
 
+char *pptk_text_dup(struct pptk *tk) {
+  char *dup = (char *)malloc(tk->text_len_ + 1);
+  if (!dup) return NULL;
+  memcpy(dup, tk->text_, tk->text_len_ + 1);
+  return dup;
+}
+
 int macro_validate(struct c_compiler *cc, struct situs *loc, struct macro *m) {
   /* C99 6.10.3.3-1 ## not at start or end of replacement list */
   if (m->replacement_list_ && (m->replacement_list_->tok_ == PPTK_HASH_HASH_MARK)) {
@@ -32,6 +32,11 @@
 #include "symtab.h"
 #endif
 
+#ifndef PPTK_ARENA_H_INCLUDED
+#define PPTK_ARENA_H_INCLUDED
+#include "pptk_arena.h"
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -186,9 +191,10 @@ enum pptoken {
 
 struct pptk {
   struct pptk *next_, *prev_;
+  struct pptk_arena *arena_; /* arena the token is recycled to */
   enum pptoken tok_;
   size_t text_len_;
-  char *text_;
+  const char *text_; /* interned in arena_, do not free */
   struct situs situs_;
   union {
     struct expr *expr_; /* Either NULL or an expression unless... */
@@ -244,6 +250,8 @@ extern int g_pptk_to_cp_[];
 
 struct pptk *pptk_alloc(struct c_compiler *cc, struct pptk **pp_chain, const char *text, int sym, struct situs *psit);
 struct pptk *pptk_alloc_len(struct c_compiler *cc, struct pptk **pp_chain, const char *text, size_t text_len, int sym, struct situs *psit);
+/* As pptk_alloc_len(), but for text that was already interned in cc->pptk_arena_ */
+struct pptk *pptk_alloc_interned(struct c_compiler *cc, struct pptk **pp_chain, const char *interned_text, size_t text_len, int sym, struct situs *psit);
 void pptk_free(struct pptk *tk);
 struct pptk *pptk_join(struct pptk *front, struct pptk *back);
 
@@ -286,6 +294,10 @@ int macro_expand(struct c_compiler *cc, struct pptk *macro_ident, struct macro *
 size_t pptk_text_len(struct pptk *chain);
 void pptk_text_cpy(char *dst, struct pptk *chain);
 
+/* Returns a malloc()'ed copy of the token's text, for when it needs to outlive the token, or NULL if
+ * no memory is available. */
+char *pptk_text_dup(struct pptk *tk);
+
 /* Perform in-place macro expansion for a single chain of pptk tokens; chain is modified in-place to reflect the expansions (if any). */
 int pptk_perform_macro_expansion(struct c_compiler *cc, struct pptk **pp_chain, int keep_defined);
 
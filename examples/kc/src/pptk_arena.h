@@ -0,0 +1,57 @@
+/* Copyright 2023-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PPTK_ARENA_H
+#define PPTK_ARENA_H
+
+#ifndef STDDEF_H_INCLUDED
+#define STDDEF_H_INCLUDED
+#include <stddef.h>
+#endif
+
+#ifndef STDINT_H_INCLUDED
+#define STDINT_H_INCLUDED
+#include <stdint.h>
+#endif
+
+struct pptk;
+struct pptk_slab;
+struct pptk_spelling;
+
+/* Per translation unit allocator for pptk tokens. Tokens are carved out of slabs and pptk_free()
+ * recycles them through free_list_. Token text is interned, so all tokens with the same spelling
+ * share the same text_; everything is released at once by pptk_arena_cleanup(). */
+struct pptk_arena {
+  struct pptk_slab *slabs_;
+  struct pptk *free_list_;
+
+  /* Hash table of interned spellings, each bucket chains through pptk_spelling::next_ */
+  struct pptk_spelling **spellings_;
+  size_t num_spellings_;
+  size_t num_spelling_buckets_;
+};
+
+void pptk_arena_init(struct pptk_arena *arena);
+void pptk_arena_cleanup(struct pptk_arena *arena);
+
+/* Returns the interned copy of text, null terminated, or NULL if no memory is available. */
+const char *pptk_arena_intern(struct pptk_arena *arena, const char *text, size_t text_len);
+
+/* Returns the hash of text previously returned by pptk_arena_intern(), without rehashing it.
+ * For text without embedded null characters, this is the same value st_hash() returns, so
+ * interned identifiers can be looked up with st_find_hashed() directly. */
+uint64_t pptk_arena_text_hash(const char *interned_text);
+
+#endif /* PPTK_ARENA_H */
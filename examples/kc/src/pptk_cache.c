@@ -0,0 +1,909 @@
+/* Copyright 2023-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef _WIN32
+#ifndef WINDOWS_H_INCLUDED
+#define WINDOWS_H_INCLUDED
+#define VC_EXTRALEAN
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+#else
+#ifndef SYS_MMAN_H_INCLUDED
+#define SYS_MMAN_H_INCLUDED
+#include <sys/mman.h>
+#endif
+
+#ifndef SYS_STAT_H_INCLUDED
+#define SYS_STAT_H_INCLUDED
+#include <sys/stat.h>
+#endif
+
+#ifndef FCNTL_H_INCLUDED
+#define FCNTL_H_INCLUDED
+#include <fcntl.h>
+#endif
+
+#ifndef UNISTD_H_INCLUDED
+#define UNISTD_H_INCLUDED
+#include <unistd.h>
+#endif
+#endif
+
+#ifndef STDIO_H_INCLUDED
+#define STDIO_H_INCLUDED
+#include <stdio.h>
+#endif
+
+#ifndef STDLIB_H_INCLUDED
+#define STDLIB_H_INCLUDED
+#include <stdlib.h>
+#endif
+
+#ifndef STRING_H_INCLUDED
+#define STRING_H_INCLUDED
+#include <string.h>
+#endif
+
+#ifndef LIMITS_H_INCLUDED
+#define LIMITS_H_INCLUDED
+#include <limits.h>
+#endif
+
+#ifndef C_COMPILER_H_INCLUDED
+#define C_COMPILER_H_INCLUDED
+#include "c_compiler.h"
+#endif
+
+#ifndef PP_TOKENS_H_INCLUDED
+#define PP_TOKENS_H_INCLUDED
+#include "pp_tokens.h"
+#endif
+
+#ifndef PP_TOKENIZER_H_INCLUDED
+#define PP_TOKENIZER_H_INCLUDED
+#include "pp_tokenizer.h"
+#endif
+
+#ifndef PPTK_CACHE_H_INCLUDED
+#define PPTK_CACHE_H_INCLUDED
+#include "pptk_cache.h"
+#endif
+
+#ifndef KLT_SHA256_H_INCLUDED
+#define KLT_SHA256_H_INCLUDED
+#include "sha256.h"
+#endif
+
+/* Number of enum pptoken values, for validating tok_ */
+#define xx(id, ld_id, ppce_id, ppme_id, cp_id) + 1
+static const uint32_t g_pptk_cache_num_pptokens_ = 0 PPTK_ENUM_PPTOKENS;
+#undef xx
+
+void pptk_cache_key_init(struct pptk_cache_key *key, struct c_compiler *cc, const void *content, size_t content_size, int pptk_mode) {
+  struct sha256_inner_state state;
+  memset(key, 0, sizeof(*key));
+  sha256_init(&state);
+  sha256_process(&state, content, content_size);
+  sha256_finish(&state, key->digest_);
+  key->bits_per_int_ = (uint32_t)cc->tb_.bits_per_int_;
+  key->bits_per_long_ = (uint32_t)cc->tb_.bits_per_long_;
+  key->bits_per_long_long_ = (uint32_t)cc->tb_.bits_per_long_long_;
+  key->char_is_signed_ = (uint32_t)!!cc->tb_.char_is_signed_;
+  key->pptk_mode_ = (uint32_t)pptk_mode;
+}
+
+void pptk_cache_path(char *path, const char *cache_dir, const struct pptk_cache_key *key) {
+  /* The filename is the hash of the whole key, so files for different options can coexist */
+  static const char hex[] = "0123456789abcdef";
+  struct sha256_inner_state state;
+  uint8_t digest[32];
+  size_t n;
+  sha256_init(&state);
+  sha256_process(&state, key, sizeof(*key));
+  sha256_finish(&state, digest);
+
+  size_t dir_len = strlen(cache_dir);
+  memcpy(path, cache_dir, dir_len);
+  path += dir_len;
+  *path++ = '/';
+  for (n = 0; n < sizeof(digest); ++n) {
+    *path++ = hex[digest[n] >> 4];
+    *path++ = hex[digest[n] & 0xF];
+  }
+  memcpy(path, ".kcpt", 6);
+}
+
+static int pptk_cache_is_literal_type(uint64_t et) {
+  /* The expr types pp_tokenizer.cbrt allocates for literals */
+  switch (et) {
+    case ET_INVALID:
+    case ET_C_INT:
+    case ET_C_LONG_INT:
+    case ET_C_LONG_LONG_INT:
+    case ET_C_UNSIGNED_SHORT_INT:
+    case ET_C_UNSIGNED_INT:
+    case ET_C_UNSIGNED_LONG_INT:
+    case ET_C_UNSIGNED_LONG_LONG_INT:
+    case ET_C_FLOAT:
+    case ET_C_DOUBLE:
+    case ET_C_LONG_DOUBLE:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static void pptk_cache_position_init(struct pptk_cache_position *pos) {
+  pos->end_ = 0;
+  pos->end_line_ = 1;
+  pos->end_col_ = 1;
+}
+
+struct pptk_cache_reader {
+  const unsigned char *pos_;
+  const unsigned char *end_;
+  int failed_;
+};
+
+static uint64_t pptk_cache_read_u(struct pptk_cache_reader *rd) {
+  uint64_t v = 0;
+  int shift = 0;
+  while (rd->pos_ != rd->end_) {
+    unsigned char c = *rd->pos_++;
+    if ((shift == 63) && (c & 0x7E)) {
+      /* More than 64 bits */
+      break;
+    }
+    v |= ((uint64_t)(c & 0x7F)) << shift;
+    if (!(c & 0x80)) return v;
+    shift += 7;
+    if (shift > 63) break;
+  }
+  rd->failed_ = 1;
+  return 0;
+}
+
+static int64_t pptk_cache_read_s(struct pptk_cache_reader *rd) {
+  uint64_t u = pptk_cache_read_u(rd);
+  return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+static int pptk_cache_read_int(struct pptk_cache_reader *rd) {
+  int64_t v = pptk_cache_read_s(rd);
+  if ((v < INT_MIN) || (v > INT_MAX)) {
+    rd->failed_ = 1;
+    return 0;
+  }
+  return (int)v;
+}
+
+static size_t pptk_cache_read_size(struct pptk_cache_reader *rd) {
+  uint64_t v = pptk_cache_read_u(rd);
+  if (v > SIZE_MAX) {
+    rd->failed_ = 1;
+    return 0;
+  }
+  return (size_t)v;
+}
+
+/* Adds the signed delta to base, failing if the result does not fit */
+static size_t pptk_cache_offset_add(struct pptk_cache_reader *rd, size_t base, int64_t delta) {
+  if (delta < 0) {
+    if (((uint64_t)-(delta + 1)) >= (uint64_t)base) {
+      rd->failed_ = 1;
+      return 0;
+    }
+    return base - (size_t)(uint64_t)-delta;
+  }
+  if ((uint64_t)delta > (uint64_t)(SIZE_MAX - base)) {
+    rd->failed_ = 1;
+    return 0;
+  }
+  return base + (size_t)delta;
+}
+
+static int pptk_cache_int_add(struct pptk_cache_reader *rd, int base, int64_t delta) {
+  int64_t v = (int64_t)base + delta;
+  if ((delta < INT_MIN) || (delta > INT_MAX) || (v < INT_MIN) || (v > INT_MAX)) {
+    rd->failed_ = 1;
+    return 0;
+  }
+  return (int)v;
+}
+
+struct pptk_cache_decoded_token {
+  uint32_t tok_;
+  uint32_t flags_;
+  uint32_t spelling_;
+  uint32_t et_;
+  uint64_t value_;
+  size_t string_length_;
+  size_t string_offset_;
+  size_t num_spans_;
+  int spans_encoding_;
+  int spans_are_aux_;
+};
+
+/* Decodes the token up to its spans, checking it against the header; returns 0 upon success. */
+static int pptk_cache_decode_token(struct pptk_cache_reader *rd, const struct pptk_cache_header *hdr, struct pptk_cache_decoded_token *dt) {
+  uint64_t head = pptk_cache_read_u(rd);
+  uint64_t spelling = pptk_cache_read_u(rd);
+  if ((head >> 3) >= g_pptk_cache_num_pptokens_) return -1;
+  if (spelling >= hdr->num_spellings_) return -1;
+  dt->tok_ = (uint32_t)(head >> 3);
+  dt->flags_ = (uint32_t)(head & 7);
+  dt->spelling_ = (uint32_t)spelling;
+  if (dt->flags_ & PPTK_CACHE_TOKEN_HAS_EXPR) {
+    uint64_t et = pptk_cache_read_u(rd);
+    if (!pptk_cache_is_literal_type(et)) return -1;
+    if ((dt->tok_ == PPTK_STRING_LIT) || (dt->tok_ == PPTK_TYPEDEF_NAME)) return -1;
+    if (dt->flags_ & (PPTK_CACHE_TOKEN_HAS_STRING | PPTK_CACHE_TOKEN_WIDE_STRING)) return -1;
+    dt->et_ = (uint32_t)et;
+    dt->value_ = pptk_cache_read_u(rd);
+  }
+  else if (dt->flags_ & PPTK_CACHE_TOKEN_HAS_STRING) {
+    size_t elem_size = (dt->flags_ & PPTK_CACHE_TOKEN_WIDE_STRING) ? sizeof(uint16_t) : sizeof(char);
+    if (dt->tok_ != PPTK_STRING_LIT) return -1;
+    dt->string_length_ = pptk_cache_read_size(rd);
+    dt->string_offset_ = pptk_cache_read_size(rd);
+    if (dt->string_length_ >= (hdr->text_size_ / elem_size)) return -1;
+    uint64_t string_size = ((uint64_t)dt->string_length_ + 1) * elem_size;
+    if ((dt->string_offset_ > hdr->text_size_) || (string_size > (hdr->text_size_ - dt->string_offset_))) return -1;
+  }
+  else if (dt->flags_) {
+    return -1;
+  }
+  uint64_t spans = pptk_cache_read_u(rd);
+  dt->spans_encoding_ = (int)(spans & 3);
+  dt->spans_are_aux_ = (int)((spans >> 2) & 1);
+  spans >>= 3;
+  switch (dt->spans_encoding_) {
+    case PPTK_CACHE_SPANS_EXPLICIT:
+      if (dt->spans_are_aux_) return -1;
+      break;
+    case PPTK_CACHE_SPANS_ADJACENT:
+    case PPTK_CACHE_SPANS_RELATIVE:
+      if (spans != 1) return -1;
+      break;
+    default:
+      return -1;
+  }
+  /* Every span takes at least one byte, which bounds the allocation for the situs */
+  if (spans > (uint64_t)(rd->end_ - rd->pos_)) return -1;
+  dt->num_spans_ = (size_t)spans;
+  return rd->failed_ ? -1 : 0;
+}
+
+/* Decodes the next span of a token, prev is updated to its end. */
+static int pptk_cache_decode_span(struct pptk_cache_reader *rd, const struct pptk_cache_decoded_token *dt, struct pptk_cache_position *prev, const char *filename, struct situs_span *span) {
+  if (dt->spans_encoding_ == PPTK_CACHE_SPANS_EXPLICIT) {
+    uint64_t flags = pptk_cache_read_u(rd);
+    if (flags & ~(uint64_t)(PPTK_CACHE_SPAN_HAS_FILENAME | PPTK_CACHE_SPAN_SUBSTITUTION | PPTK_CACHE_SPAN_AUX)) return -1;
+    span->filename_ = (flags & PPTK_CACHE_SPAN_HAS_FILENAME) ? filename : NULL;
+    span->start_ = pptk_cache_read_size(rd);
+    span->end_ = pptk_cache_read_size(rd);
+    span->num_bytes_ = pptk_cache_read_size(rd);
+    span->start_line_ = pptk_cache_read_int(rd);
+    span->start_col_ = pptk_cache_read_int(rd);
+    span->end_line_ = pptk_cache_read_int(rd);
+    span->end_col_ = pptk_cache_read_int(rd);
+    span->is_substitution_ = !!(flags & PPTK_CACHE_SPAN_SUBSTITUTION);
+    span->is_aux_ = !!(flags & PPTK_CACHE_SPAN_AUX);
+  }
+  else {
+    size_t num_bytes;
+    span->filename_ = filename;
+    if (dt->spans_encoding_ == PPTK_CACHE_SPANS_ADJACENT) {
+      num_bytes = pptk_cache_read_size(rd);
+      span->start_ = prev->end_;
+      span->start_line_ = prev->end_line_;
+      span->start_col_ = prev->end_col_;
+      span->end_line_ = span->start_line_;
+      span->end_col_ = pptk_cache_int_add(rd, span->start_col_, (int64_t)num_bytes);
+    }
+    else /* (dt->spans_encoding_ == PPTK_CACHE_SPANS_RELATIVE) */ {
+      int64_t start_delta = pptk_cache_read_s(rd);
+      num_bytes = pptk_cache_read_size(rd);
+      int64_t start_line_delta = pptk_cache_read_s(rd);
+      int64_t start_col_delta = pptk_cache_read_s(rd);
+      int64_t end_line_delta = pptk_cache_read_s(rd);
+      int64_t end_col_delta = pptk_cache_read_s(rd);
+      span->start_ = pptk_cache_offset_add(rd, prev->end_, start_delta);
+      span->start_line_ = pptk_cache_int_add(rd, prev->end_line_, start_line_delta);
+      span->start_col_ = pptk_cache_int_add(rd, prev->end_col_, start_col_delta);
+      span->end_line_ = pptk_cache_int_add(rd, span->start_line_, end_line_delta);
+      span->end_col_ = pptk_cache_int_add(rd, span->start_col_, end_col_delta);
+    }
+    if ((uint64_t)num_bytes > (uint64_t)INT64_MAX) rd->failed_ = 1;
+    span->end_ = pptk_cache_offset_add(rd, span->start_, (int64_t)num_bytes);
+    span->num_bytes_ = num_bytes;
+    span->is_substitution_ = 0;
+    span->is_aux_ = dt->spans_are_aux_;
+  }
+  prev->end_ = span->end_;
+  prev->end_line_ = span->end_line_;
+  prev->end_col_ = span->end_col_;
+  return rd->failed_ ? -1 : 0;
+}
+
+int pptk_cache_validate(const void *base, size_t size, const struct pptk_cache_key *key) {
+  const struct pptk_cache_header *hdr = (const struct pptk_cache_header *)base;
+  size_t n;
+  if (size < sizeof(struct pptk_cache_header)) return -1;
+  if (memcmp(hdr->magic_, PPTK_CACHE_MAGIC, sizeof(hdr->magic_))) return -1;
+  if (hdr->version_ != PPTK_CACHE_VERSION) return -1;
+  if (hdr->byte_order_ != PPTK_CACHE_BYTE_ORDER) return -1;
+  if (memcmp(&hdr->key_, key, sizeof(*key))) return -1;
+
+  if ((hdr->stream_size_ > (uint64_t)size) || (hdr->text_size_ > (uint64_t)size)) return -1;
+  uint64_t expected_size = (uint64_t)sizeof(struct pptk_cache_header)
+                         + (uint64_t)hdr->num_spellings_ * sizeof(struct pptk_cache_spelling)
+                         + hdr->stream_size_ + hdr->text_size_;
+  if (expected_size != (uint64_t)size) return -1;
+
+  const struct pptk_cache_spelling *spellings = (const struct pptk_cache_spelling *)(hdr + 1);
+  for (n = 0; n < hdr->num_spellings_; ++n) {
+    if ((spellings[n].offset_ > hdr->text_size_) || (spellings[n].len_ > (hdr->text_size_ - spellings[n].offset_))) return -1;
+  }
+
+  struct pptk_cache_reader rd;
+  rd.pos_ = (const unsigned char *)(spellings + hdr->num_spellings_);
+  rd.end_ = rd.pos_ + hdr->stream_size_;
+  rd.failed_ = 0;
+  struct pptk_cache_position prev;
+  pptk_cache_position_init(&prev);
+  int result = _PPTK_FEED_ME;
+  uint32_t event;
+  for (event = 0; event < hdr->num_events_; ++event) {
+    result = pptk_cache_read_int(&rd);
+    pptk_cache_read_int(&rd); /* endline */
+    uint64_t num_tokens = pptk_cache_read_u(&rd);
+    if (rd.failed_) return -1;
+    switch (result) {
+      case PPTK_TOKENIZER_LINE_READY:
+      case PPTK_TOKENIZER_HEADERNAME_CHECK:
+      case _PPTK_FEED_ME:
+      case _PPTK_FINISH:
+        break;
+      default:
+        return -1;
+    }
+    uint64_t t;
+    for (t = 0; t < num_tokens; ++t) {
+      struct pptk_cache_decoded_token dt;
+      struct situs_span span;
+      if (pptk_cache_decode_token(&rd, hdr, &dt)) return -1;
+      for (n = 0; n < dt.num_spans_; ++n) {
+        if (pptk_cache_decode_span(&rd, &dt, &prev, "", &span)) return -1;
+      }
+    }
+  }
+  if (result != _PPTK_FINISH) return -1;
+  if (rd.pos_ != rd.end_) return -1;
+
+  return 0;
+}
+
+void pptk_cache_image_init(struct pptk_cache_image *img, const void *base, size_t size) {
+  img->base_ = base;
+  img->size_ = size;
+  img->is_mapped_ = 0;
+  img->header_ = (const struct pptk_cache_header *)base;
+  img->spellings_ = (const struct pptk_cache_spelling *)(img->header_ + 1);
+  img->stream_ = (const unsigned char *)(img->spellings_ + img->header_->num_spellings_);
+  img->text_ = (const char *)(img->stream_ + img->header_->stream_size_);
+  img->interned_ = NULL;
+  img->stream_pos_ = 0;
+  img->next_event_ = 0;
+  pptk_cache_position_init(&img->prev_);
+  img->endline_ = 1;
+}
+
+int pptk_cache_open(struct pptk_cache_image *img, const char *cache_dir, const struct pptk_cache_key *key) {
+  char *path = (char *)malloc(strlen(cache_dir) + PPTK_CACHE_FILENAME_SIZE);
+  if (!path) return -1;
+  pptk_cache_path(path, cache_dir, key);
+
+#ifdef _WIN32
+  HANDLE fh = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  free(path);
+  if (fh == INVALID_HANDLE_VALUE) return -1;
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(fh, &file_size) || (file_size.QuadPart < (LONGLONG)sizeof(struct pptk_cache_header)) || ((ULONGLONG)file_size.QuadPart > (ULONGLONG)SIZE_MAX)) {
+    CloseHandle(fh);
+    return -1;
+  }
+  HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mh) {
+    CloseHandle(fh);
+    return -1;
+  }
+  const void *base = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+  if (!base) {
+    CloseHandle(mh);
+    CloseHandle(fh);
+    return -1;
+  }
+  size_t size = (size_t)file_size.QuadPart;
+  if (pptk_cache_validate(base, size, key)) {
+    UnmapViewOfFile(base);
+    CloseHandle(mh);
+    CloseHandle(fh);
+    return -1;
+  }
+  pptk_cache_image_init(img, base, size);
+  img->file_handle_ = fh;
+  img->mapping_handle_ = mh;
+#else
+  int fd = open(path, O_RDONLY);
+  free(path);
+  if (fd == -1) return -1;
+  struct stat st;
+  if (fstat(fd, &st) || (st.st_size < (off_t)sizeof(struct pptk_cache_header)) || ((uint64_t)st.st_size > (uint64_t)SIZE_MAX)) {
+    close(fd);
+    return -1;
+  }
+  size_t size = (size_t)st.st_size;
+  void *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  /* The mapping keeps the file referenced, the descriptor is no longer needed */
+  close(fd);
+  if (base == MAP_FAILED) return -1;
+  if (pptk_cache_validate(base, size, key)) {
+    munmap(base, size);
+    return -1;
+  }
+  pptk_cache_image_init(img, base, size);
+#endif
+  img->is_mapped_ = 1;
+  return 0;
+}
+
+void pptk_cache_close(struct pptk_cache_image *img) {
+  if (!img->base_) return;
+  if (img->interned_) free((void *)img->interned_);
+  if (img->is_mapped_) {
+#ifdef _WIN32
+    UnmapViewOfFile(img->base_);
+    CloseHandle((HANDLE)img->mapping_handle_);
+    CloseHandle((HANDLE)img->file_handle_);
+#else
+    munmap((void *)img->base_, img->size_);
+#endif
+  }
+  img->base_ = NULL;
+}
+
+static struct pptk *pptk_cache_replay_token(struct c_compiler *cc, struct pptk_cache_image *img, struct pptk_cache_reader *rd, const char *filename, struct pptk **pp_chain) {
+  struct pptk_cache_decoded_token dt;
+  struct situs sit;
+  struct situs_span *spans;
+  size_t n;
+
+  if (pptk_cache_decode_token(rd, img->header_, &dt)) return NULL;
+
+  situs_init(&sit);
+  if (dt.num_spans_ > 1) {
+    sit.u_.many_.spans_ = (struct situs_span *)malloc(dt.num_spans_ * sizeof(struct situs_span));
+    if (!sit.u_.many_.spans_) {
+      cc_no_memory(cc);
+      return NULL;
+    }
+    sit.u_.many_.num_spans_allocated_ = dt.num_spans_;
+    spans = sit.u_.many_.spans_;
+  }
+  else {
+    spans = &sit.u_.one_;
+  }
+  sit.num_spans_ = dt.num_spans_;
+  for (n = 0; n < dt.num_spans_; ++n) {
+    if (pptk_cache_decode_span(rd, &dt, &img->prev_, filename, spans + n)) {
+      situs_cleanup(&sit);
+      return NULL;
+    }
+  }
+
+  const char *text = img->interned_[dt.spelling_];
+  size_t text_len = img->spellings_[dt.spelling_].len_;
+  if (!text) {
+    text = pptk_arena_intern(&cc->pptk_arena_, img->text_ + img->spellings_[dt.spelling_].offset_, text_len);
+    if (!text) {
+      cc_no_memory(cc);
+      situs_cleanup(&sit);
+      return NULL;
+    }
+    img->interned_[dt.spelling_] = text;
+  }
+
+  struct situs no_situs;
+  situs_init(&no_situs);
+  struct pptk *tk = pptk_alloc_interned(cc, NULL, text, text_len, (int)dt.tok_, &no_situs);
+  if (!tk) {
+    situs_cleanup(&sit);
+    return NULL;
+  }
+  situs_swap(&tk->situs_, &sit);
+  situs_cleanup(&sit);
+
+  if (dt.flags_ & PPTK_CACHE_TOKEN_HAS_STRING) {
+    size_t elem_size = (dt.flags_ & PPTK_CACHE_TOKEN_WIDE_STRING) ? sizeof(uint16_t) : sizeof(char);
+    size_t alloc_size = (dt.string_length_ + 1) * elem_size;
+    void *blob = malloc(alloc_size);
+    if (!blob) {
+      cc_no_memory(cc);
+      pptk_free(tk);
+      return NULL;
+    }
+    memcpy(blob, img->text_ + dt.string_offset_, alloc_size);
+    tk->v_.string_.wide_ = !!(dt.flags_ & PPTK_CACHE_TOKEN_WIDE_STRING);
+    tk->v_.string_.data_ = blob;
+    tk->v_.string_.length_ = dt.string_length_;
+  }
+  else if (dt.flags_ & PPTK_CACHE_TOKEN_HAS_EXPR) {
+    tk->v_.expr_ = expr_alloc((enum expr_type)dt.et_);
+    if (!tk->v_.expr_) {
+      cc_no_memory(cc);
+      pptk_free(tk);
+      return NULL;
+    }
+    tk->v_.expr_->v_.u64_ = dt.value_;
+  }
+
+  *pp_chain = pptk_join(*pp_chain, tk);
+  return tk;
+}
+
+int pptk_cache_replay(struct c_compiler *cc, struct pptk_cache_image *img, const char *filename, struct pptk **pp_chain) {
+  const struct pptk_cache_header *hdr = img->header_;
+  if (img->next_event_ == hdr->num_events_) {
+    return _PPTK_FINISH;
+  }
+  if (!img->interned_) {
+    img->interned_ = (const char **)calloc(hdr->num_spellings_ ? hdr->num_spellings_ : 1, sizeof(const char *));
+    if (!img->interned_) {
+      cc_no_memory(cc);
+      img->next_event_ = hdr->num_events_;
+      return _PPTK_FINISH;
+    }
+  }
+
+  struct pptk_cache_reader rd;
+  rd.pos_ = img->stream_ + img->stream_pos_;
+  rd.end_ = img->stream_ + hdr->stream_size_;
+  rd.failed_ = 0;
+  int result = pptk_cache_read_int(&rd);
+  int endline = pptk_cache_read_int(&rd);
+  uint64_t num_tokens = pptk_cache_read_u(&rd);
+  uint64_t n;
+  for (n = 0; n < num_tokens; ++n) {
+    if (!pptk_cache_replay_token(cc, img, &rd, filename, pp_chain)) {
+      /* Memory failure has been reported as fatal (the image was validated, so it is not
+       * malformed); end the file here. */
+      img->next_event_ = hdr->num_events_;
+      return _PPTK_FINISH;
+    }
+  }
+  img->stream_pos_ = (size_t)(rd.pos_ - img->stream_);
+  img->next_event_++;
+  img->endline_ = endline;
+  return result;
+}
+
+void pptk_cache_recorder_init(struct pptk_cache_recorder *rec) {
+  rec->num_events_ = 0;
+  rec->stream_ = NULL;
+  rec->stream_size_ = rec->stream_size_allocated_ = 0;
+  rec->text_ = NULL;
+  rec->text_size_ = rec->text_size_allocated_ = 0;
+  rec->spellings_ = NULL;
+  rec->num_spellings_ = rec->num_spellings_allocated_ = 0;
+  rec->spelling_keys_ = NULL;
+  rec->spelling_values_ = NULL;
+  rec->num_spelling_buckets_ = 0;
+  pptk_cache_position_init(&rec->prev_);
+  rec->is_complete_ = 0;
+}
+
+void pptk_cache_recorder_cleanup(struct pptk_cache_recorder *rec) {
+  if (rec->stream_) free(rec->stream_);
+  if (rec->text_) free(rec->text_);
+  if (rec->spellings_) free(rec->spellings_);
+  if (rec->spelling_keys_) free((void *)rec->spelling_keys_);
+  if (rec->spelling_values_) free(rec->spelling_values_);
+}
+
+static int pptk_cache_emit_u(struct pptk_cache_recorder *rec, uint64_t v) {
+  if ((rec->stream_size_allocated_ - rec->stream_size_) < 10 /* max varint size */) {
+    size_t new_size = rec->stream_size_allocated_ * 2 + 4096;
+    if (new_size <= rec->stream_size_allocated_) return -1;
+    unsigned char *new_stream = (unsigned char *)realloc(rec->stream_, new_size);
+    if (!new_stream) return -1;
+    rec->stream_ = new_stream;
+    rec->stream_size_allocated_ = new_size;
+  }
+  while (v >= 0x80) {
+    rec->stream_[rec->stream_size_++] = (unsigned char)(v | 0x80);
+    v >>= 7;
+  }
+  rec->stream_[rec->stream_size_++] = (unsigned char)v;
+  return 0;
+}
+
+static int pptk_cache_emit_s(struct pptk_cache_recorder *rec, int64_t v) {
+  return pptk_cache_emit_u(rec, (((uint64_t)v) << 1) ^ (uint64_t)(v >> 63));
+}
+
+static int pptk_cache_add_text(struct pptk_cache_recorder *rec, const void *text, size_t len, size_t *offset) {
+  if ((rec->text_size_allocated_ - rec->text_size_) < len) {
+    size_t new_size = rec->text_size_allocated_ * 2 + len + 4096;
+    if (new_size <= rec->text_size_allocated_) return -1;
+    char *new_text = (char *)realloc(rec->text_, new_size);
+    if (!new_text) return -1;
+    rec->text_ = new_text;
+    rec->text_size_allocated_ = new_size;
+  }
+  if (len) memcpy(rec->text_ + rec->text_size_, text, len);
+  *offset = rec->text_size_;
+  rec->text_size_ += len;
+  return 0;
+}
+
+static size_t pptk_cache_spelling_bucket(const struct pptk_cache_recorder *rec, const char *text) {
+  uint64_t h = ((uint64_t)(uintptr_t)text) * 0x9E3779B97F4A7C15ull;
+  return (size_t)(h >> 32) & (rec->num_spelling_buckets_ - 1);
+}
+
+/* Returns the index of the spelling of the interned text in *index, adding it if needed. */
+static int pptk_cache_find_spelling(struct pptk_cache_recorder *rec, const char *text, size_t text_len, uint32_t *index) {
+  size_t n;
+  if ((rec->num_spellings_ * 2) >= rec->num_spelling_buckets_) {
+    size_t new_num_buckets = rec->num_spelling_buckets_ ? rec->num_spelling_buckets_ * 2 : 256;
+    const char **new_keys = (const char **)calloc(new_num_buckets, sizeof(const char *));
+    uint32_t *new_values = (uint32_t *)malloc(new_num_buckets * sizeof(uint32_t));
+    if (!new_keys || !new_values) {
+      free((void *)new_keys);
+      free(new_values);
+      return -1;
+    }
+    const char **old_keys = rec->spelling_keys_;
+    uint32_t *old_values = rec->spelling_values_;
+    size_t old_num_buckets = rec->num_spelling_buckets_;
+    rec->spelling_keys_ = new_keys;
+    rec->spelling_values_ = new_values;
+    rec->num_spelling_buckets_ = new_num_buckets;
+    for (n = 0; n < old_num_buckets; ++n) {
+      if (old_keys[n]) {
+        size_t b = pptk_cache_spelling_bucket(rec, old_keys[n]);
+        while (new_keys[b]) b = (b + 1) & (new_num_buckets - 1);
+        new_keys[b] = old_keys[n];
+        new_values[b] = old_values[n];
+      }
+    }
+    free((void *)old_keys);
+    free(old_values);
+  }
+
+  size_t b = pptk_cache_spelling_bucket(rec, text);
+  while (rec->spelling_keys_[b]) {
+    if (rec->spelling_keys_[b] == text) {
+      *index = rec->spelling_values_[b];
+      return 0;
+    }
+    b = (b + 1) & (rec->num_spelling_buckets_ - 1);
+  }
+
+  if (rec->num_spellings_ == rec->num_spellings_allocated_) {
+    size_t new_num_allocated = rec->num_spellings_allocated_ * 2 + 256;
+    if (new_num_allocated > UINT32_MAX) return -1;
+    struct pptk_cache_spelling *new_spellings = (struct pptk_cache_spelling *)realloc(rec->spellings_, new_num_allocated * sizeof(struct pptk_cache_spelling));
+    if (!new_spellings) return -1;
+    rec->spellings_ = new_spellings;
+    rec->num_spellings_allocated_ = new_num_allocated;
+  }
+  size_t offset;
+  if (pptk_cache_add_text(rec, text, text_len, &offset)) return -1;
+  if ((offset > UINT32_MAX) || (text_len > UINT32_MAX)) return -1;
+  rec->spellings_[rec->num_spellings_].offset_ = (uint32_t)offset;
+  rec->spellings_[rec->num_spellings_].len_ = (uint32_t)text_len;
+  rec->spelling_keys_[b] = text;
+  rec->spelling_values_[b] = (uint32_t)rec->num_spellings_;
+  *index = (uint32_t)rec->num_spellings_++;
+  return 0;
+}
+
+static int pptk_cache_record_token(struct pptk_cache_recorder *rec, struct pptk *tk, const char *filename) {
+  uint32_t spelling;
+  uint32_t flags = 0;
+  int r = 0;
+  if (pptk_cache_find_spelling(rec, tk->text_, tk->text_len_, &spelling)) return -1;
+
+  if (tk->tok_ == PPTK_STRING_LIT) {
+    if (tk->v_.string_.data_) {
+      flags = PPTK_CACHE_TOKEN_HAS_STRING | (tk->v_.string_.wide_ ? PPTK_CACHE_TOKEN_WIDE_STRING : 0);
+    }
+  }
+  else if (tk->tok_ == PPTK_TYPEDEF_NAME) {
+    /* Not produced by the tokenizer; v_.type_ cannot be cached. */
+    return -1;
+  }
+  else if (tk->v_.expr_) {
+    if (!pptk_cache_is_literal_type((uint64_t)tk->v_.expr_->et_)) return -1;
+    flags = PPTK_CACHE_TOKEN_HAS_EXPR;
+  }
+
+  r = r || pptk_cache_emit_u(rec, (((uint64_t)tk->tok_) << 3) | flags);
+  r = r || pptk_cache_emit_u(rec, spelling);
+  if (flags & PPTK_CACHE_TOKEN_HAS_EXPR) {
+    r = r || pptk_cache_emit_u(rec, (uint64_t)tk->v_.expr_->et_);
+    r = r || pptk_cache_emit_u(rec, tk->v_.expr_->v_.u64_);
+  }
+  else if (flags & PPTK_CACHE_TOKEN_HAS_STRING) {
+    size_t elem_size = tk->v_.string_.wide_ ? sizeof(uint16_t) : sizeof(char);
+    size_t offset;
+    r = r || pptk_cache_add_text(rec, tk->v_.string_.data_, (tk->v_.string_.length_ + 1) * elem_size, &offset);
+    r = r || pptk_cache_emit_u(rec, tk->v_.string_.length_);
+    r = r || pptk_cache_emit_u(rec, offset);
+  }
+
+  const struct situs_span *spans = (tk->situs_.num_spans_ > 1) ? tk->situs_.u_.many_.spans_ : &tk->situs_.u_.one_;
+  size_t num_spans = tk->situs_.num_spans_;
+  size_t n;
+  for (n = 0; n < num_spans; ++n) {
+    if (spans[n].filename_ && (spans[n].filename_ != filename)) {
+      /* Situs refers to a file other than the one being cached. */
+      return -1;
+    }
+  }
+  int encoding = PPTK_CACHE_SPANS_EXPLICIT;
+  int are_aux = 0;
+  if ((num_spans == 1) && spans->filename_ && !spans->is_substitution_ &&
+      (spans->end_ >= spans->start_) && ((spans->end_ - spans->start_) == spans->num_bytes_)) {
+    are_aux = spans->is_aux_;
+    if ((spans->start_ == rec->prev_.end_) && (spans->start_line_ == rec->prev_.end_line_) && (spans->start_col_ == rec->prev_.end_col_) &&
+        (spans->end_line_ == spans->start_line_) && (((int64_t)spans->end_col_ - (int64_t)spans->start_col_) == (int64_t)spans->num_bytes_)) {
+      encoding = PPTK_CACHE_SPANS_ADJACENT;
+    }
+    else {
+      encoding = PPTK_CACHE_SPANS_RELATIVE;
+    }
+  }
+  r = r || pptk_cache_emit_u(rec, (((uint64_t)num_spans) << 3) | (are_aux ? 4 : 0) | (uint64_t)encoding);
+  if (encoding == PPTK_CACHE_SPANS_ADJACENT) {
+    r = r || pptk_cache_emit_u(rec, spans->num_bytes_);
+  }
+  else if (encoding == PPTK_CACHE_SPANS_RELATIVE) {
+    r = r || pptk_cache_emit_s(rec, (int64_t)(spans->start_ - rec->prev_.end_));
+    r = r || pptk_cache_emit_u(rec, spans->num_bytes_);
+    r = r || pptk_cache_emit_s(rec, (int64_t)spans->start_line_ - (int64_t)rec->prev_.end_line_);
+    r = r || pptk_cache_emit_s(rec, (int64_t)spans->start_col_ - (int64_t)rec->prev_.end_col_);
+    r = r || pptk_cache_emit_s(rec, (int64_t)spans->end_line_ - (int64_t)spans->start_line_);
+    r = r || pptk_cache_emit_s(rec, (int64_t)spans->end_col_ - (int64_t)spans->start_col_);
+  }
+  else {
+    for (n = 0; n < num_spans; ++n) {
+      const struct situs_span *span = spans + n;
+      r = r || pptk_cache_emit_u(rec, (span->filename_ ? PPTK_CACHE_SPAN_HAS_FILENAME : 0)
+                                    | (span->is_substitution_ ? PPTK_CACHE_SPAN_SUBSTITUTION : 0)
+                                    | (span->is_aux_ ? PPTK_CACHE_SPAN_AUX : 0));
+      r = r || pptk_cache_emit_u(rec, span->start_);
+      r = r || pptk_cache_emit_u(rec, span->end_);
+      r = r || pptk_cache_emit_u(rec, span->num_bytes_);
+      r = r || pptk_cache_emit_s(rec, span->start_line_);
+      r = r || pptk_cache_emit_s(rec, span->start_col_);
+      r = r || pptk_cache_emit_s(rec, span->end_line_);
+      r = r || pptk_cache_emit_s(rec, span->end_col_);
+    }
+  }
+  if (num_spans) {
+    rec->prev_.end_ = spans[num_spans - 1].end_;
+    rec->prev_.end_line_ = spans[num_spans - 1].end_line_;
+    rec->prev_.end_col_ = spans[num_spans - 1].end_col_;
+  }
+  return r ? -1 : 0;
+}
+
+int pptk_cache_record(struct pptk_cache_recorder *rec, int result, int endline, struct pptk *first_new, struct pptk *chain, const char *filename) {
+  switch (result) {
+    case PPTK_TOKENIZER_LINE_READY:
+    case PPTK_TOKENIZER_HEADERNAME_CHECK:
+    case _PPTK_FEED_ME:
+    case _PPTK_FINISH:
+      break;
+    default:
+      /* Errors are reported while scanning, and would not be reported when replaying */
+      return -1;
+  }
+  if (rec->num_events_ == UINT32_MAX) return -1;
+  uint64_t num_tokens = 0;
+  struct pptk *tk = first_new;
+  if (tk) {
+    do {
+      num_tokens++;
+      tk = tk->next_;
+    } while (tk != chain);
+  }
+  if (pptk_cache_emit_s(rec, result) || pptk_cache_emit_s(rec, endline) || pptk_cache_emit_u(rec, num_tokens)) return -1;
+  tk = first_new;
+  if (tk) {
+    do {
+      if (pptk_cache_record_token(rec, tk, filename)) return -1;
+      tk = tk->next_;
+    } while (tk != chain);
+  }
+  rec->num_events_++;
+  if (result == _PPTK_FINISH) {
+    rec->is_complete_ = 1;
+  }
+  return 0;
+}
+
+int pptk_cache_write(const char *cache_dir, const struct pptk_cache_key *key, const struct pptk_cache_recorder *rec) {
+  if (!rec->is_complete_) return -1;
+  size_t dir_len = strlen(cache_dir);
+  char *path = (char *)malloc(dir_len + PPTK_CACHE_FILENAME_SIZE);
+  char *tmp_path = (char *)malloc(dir_len + PPTK_CACHE_FILENAME_SIZE + 32);
+  if (!path || !tmp_path) {
+    free(path);
+    free(tmp_path);
+    return -1;
+  }
+  pptk_cache_path(path, cache_dir, key);
+#ifdef _WIN32
+  sprintf(tmp_path, "%s.%lu.tmp", path, (unsigned long)GetCurrentProcessId());
+#else
+  sprintf(tmp_path, "%s.%lu.tmp", path, (unsigned long)getpid());
+#endif
+
+  struct pptk_cache_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic_, PPTK_CACHE_MAGIC, sizeof(hdr.magic_));
+  hdr.version_ = PPTK_CACHE_VERSION;
+  hdr.byte_order_ = PPTK_CACHE_BYTE_ORDER;
+  hdr.key_ = *key;
+  hdr.num_events_ = rec->num_events_;
+  hdr.num_spellings_ = (uint32_t)rec->num_spellings_;
+  hdr.stream_size_ = rec->stream_size_;
+  hdr.text_size_ = rec->text_size_;
+
+  int r = -1;
+  FILE *fp = fopen(tmp_path, "wb");
+  if (fp) {
+    int failed = (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+              || (rec->num_spellings_ && (fwrite(rec->spellings_, sizeof(*rec->spellings_), rec->num_spellings_, fp) != rec->num_spellings_))
+              || (rec->stream_size_ && (fwrite(rec->stream_, 1, rec->stream_size_, fp) != rec->stream_size_))
+              || (rec->text_size_ && (fwrite(rec->text_, 1, rec->text_size_, fp) != rec->text_size_));
+    failed = fclose(fp) || failed;
+    if (!failed && !rename(tmp_path, path)) {
+      r = 0;
+    }
+    else {
+      /* Includes the case where another compiler wrote the same file first (rename() does not
+       * replace existing files on Windows), in which case the cache is fine as it is. */
+      remove(tmp_path);
+    }
+  }
+
+  free(path);
+  free(tmp_path);
+  return r;
+}
+
+void pptk_cache_state_free(struct pptk_cache_state *state) {
+  if (!state) return;
+  pptk_cache_close(&state->image_);
+  pptk_cache_recorder_cleanup(&state->recorder_);
+  if (state->content_) free(state->content_);
+  free(state);
+}
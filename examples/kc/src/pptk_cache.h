@@ -0,0 +1,231 @@
+/* Copyright 2023-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PPTK_CACHE_H
+#define PPTK_CACHE_H
+
+#ifndef STDDEF_H_INCLUDED
+#define STDDEF_H_INCLUDED
+#include <stddef.h>
+#endif
+
+#ifndef STDINT_H_INCLUDED
+#define STDINT_H_INCLUDED
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct c_compiler;
+struct pptk;
+
+/* On-disk cache of the pptk tokens of an input file, as produced by the trigraph, line
+ * continuation and tokenizer phases (translation phases 1 through 3.) A cached file replays
+ * every pptk_scan() result it recorded, so the line directives parser sees exactly the same
+ * sequence of tokens and lines as it would when the file is tokenized from scratch.
+ *
+ * The file is a pptk_cache_header, followed by num_spellings_ pptk_cache_spelling records,
+ * stream_size_ bytes of token stream and text_size_ bytes of text (the spellings and the data
+ * of string literals.) The file is used in place as it is mapped into memory; nothing refers
+ * to anything by pointer.
+ *
+ * The token stream is a sequence of num_events_ events, one for each pptk_scan(), all numbers
+ * are LEB128 varints, signed numbers are zigzag encoded:
+ *   event:  result, endline, num_tokens, followed by num_tokens tokens
+ *   token:  (tok << 3) | PPTK_CACHE_TOKEN_xxx flags, spelling index,
+ *           [expr type, value]             if PPTK_CACHE_TOKEN_HAS_EXPR
+ *           [string length, text offset]   if PPTK_CACHE_TOKEN_HAS_STRING
+ *           (num_spans << 3) | (is_aux << 2) | PPTK_CACHE_SPANS_xxx encoding, followed by the spans
+ *   PPTK_CACHE_SPANS_ADJACENT (one span in the file, starting where the previous span ended,
+ *   on a single line with a column for each byte):
+ *           num_bytes
+ *   PPTK_CACHE_SPANS_RELATIVE (one span in the file, no substitution):
+ *           start - previous end, num_bytes, start_line - previous end_line,
+ *           start_col - previous end_col, end_line - start_line, end_col - start_col
+ *   PPTK_CACHE_SPANS_EXPLICIT, for each span:
+ *           PPTK_CACHE_SPAN_xxx flags, start, end, num_bytes, start_line, start_col, end_line, end_col
+ * where the previous end is that of the last span of the preceding token, or offset 0 at
+ * line 1, column 1 for the first token of the file.
+ * Header and spelling records are in the byte order of the machine that wrote the file, as is
+ * the value of literals; byte_order_ rejects files from machines of another byte order. */
+
+#define PPTK_CACHE_MAGIC "KCPPTK\x1A\0"
+#define PPTK_CACHE_VERSION 1
+#define PPTK_CACHE_BYTE_ORDER 0x01020304
+
+/* Everything the tokens of a file depend on; two files with an identical key have identical
+ * tokens. */
+struct pptk_cache_key {
+  uint8_t digest_[32];          /* sha256 of the file content */
+  uint32_t bits_per_int_;       /* type sizes determine the types of integer literals */
+  uint32_t bits_per_long_;
+  uint32_t bits_per_long_long_;
+  uint32_t char_is_signed_;
+  uint32_t pptk_mode_;          /* mode the tokenizer starts the file in (e.g. M_PPTK_TEMPLATE_START) */
+  uint32_t reserved_;
+};
+
+struct pptk_cache_header {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t byte_order_;
+  struct pptk_cache_key key_;
+  uint32_t num_events_;
+  uint32_t num_spellings_;
+  uint64_t stream_size_;
+  uint64_t text_size_;
+};
+
+/* Distinct token text, tokens refer to these by index */
+struct pptk_cache_spelling {
+  uint32_t offset_;
+  uint32_t len_;
+};
+
+#define PPTK_CACHE_TOKEN_HAS_EXPR    0x1  /* v_.expr_ is an expr_alloc(type) with v_.u64_ == value */
+#define PPTK_CACHE_TOKEN_HAS_STRING  0x2  /* v_.string_ data, including null terminator, is in the text */
+#define PPTK_CACHE_TOKEN_WIDE_STRING 0x4  /* v_.string_.wide_ */
+
+#define PPTK_CACHE_SPANS_EXPLICIT 0
+#define PPTK_CACHE_SPANS_ADJACENT 1
+#define PPTK_CACHE_SPANS_RELATIVE 2
+
+#define PPTK_CACHE_SPAN_HAS_FILENAME 0x1  /* filename_ is that of the input file, otherwise NULL */
+#define PPTK_CACHE_SPAN_SUBSTITUTION 0x2
+#define PPTK_CACHE_SPAN_AUX          0x4
+
+/* End of the last span of the previous token, spans are encoded relative to it */
+struct pptk_cache_position {
+  size_t end_;
+  int end_line_;
+  int end_col_;
+};
+
+/* A cache file mapped into memory and the position of its replay */
+struct pptk_cache_image {
+  const void *base_;
+  size_t size_;
+  int is_mapped_:1;
+#ifdef _WIN32
+  void *file_handle_;
+  void *mapping_handle_;
+#endif
+
+  const struct pptk_cache_header *header_;
+  const struct pptk_cache_spelling *spellings_;
+  const unsigned char *stream_;
+  const char *text_;
+
+  /* Spellings interned in the compiler's pptk_arena_, filled in as they are first replayed */
+  const char **interned_;
+
+  size_t stream_pos_;
+  uint32_t next_event_;
+  struct pptk_cache_position prev_;
+
+  /* endline_ of the most recently replayed event */
+  int endline_;
+};
+
+/* Collects the pptk_scan() results of a file as it is tokenized, for writing to the cache. */
+struct pptk_cache_recorder {
+  uint32_t num_events_;
+
+  unsigned char *stream_;
+  size_t stream_size_, stream_size_allocated_;
+
+  char *text_;
+  size_t text_size_, text_size_allocated_;
+
+  struct pptk_cache_spelling *spellings_;
+  size_t num_spellings_, num_spellings_allocated_;
+
+  /* Open addressing hash table from interned token text (as a pointer) to spelling index + 1 */
+  const char **spelling_keys_;
+  uint32_t *spelling_values_;
+  size_t num_spelling_buckets_;
+
+  struct pptk_cache_position prev_;
+
+  /* Set once _PPTK_FINISH was recorded. */
+  int is_complete_:1;
+};
+
+/* Per input_file caching state */
+struct pptk_cache_state {
+  struct pptk_cache_key key_;
+
+  /* Entire file content, if it was read from a FILE* to compute the key; the input_file is
+   * fed from here when the file is tokenized. */
+  void *content_;
+  size_t content_size_;
+
+  struct pptk_cache_image image_;
+  struct pptk_cache_recorder recorder_;
+};
+
+/* Fills in key for a file with the given content, starting in the given tokenizer mode. */
+void pptk_cache_key_init(struct pptk_cache_key *key, struct c_compiler *cc, const void *content, size_t content_size, int pptk_mode);
+
+/* Writes the path of the cache file for key in cache_dir to path, which should have room for
+ * strlen(cache_dir) + PPTK_CACHE_FILENAME_SIZE bytes (including null terminator). */
+#define PPTK_CACHE_FILENAME_SIZE (1 + 64 + 5 + 1)
+void pptk_cache_path(char *path, const char *cache_dir, const struct pptk_cache_key *key);
+
+/* Checks that the size bytes at base are a well-formed cache file for key; the entire token
+ * stream is decoded and every index, offset and count is checked, so that replaying the file
+ * cannot reach outside of it.
+ * Returns 0 if the file is valid, non-zero otherwise. */
+int pptk_cache_validate(const void *base, size_t size, const struct pptk_cache_key *key);
+
+/* Maps the cache file for key in cache_dir and validates it. Returns 0 if the file was found
+ * and is valid, non-zero otherwise (in which case there is nothing to close.) */
+int pptk_cache_open(struct pptk_cache_image *img, const char *cache_dir, const struct pptk_cache_key *key);
+
+/* Prepares an already validated in-memory image for replay; pptk_cache_open() calls this for the
+ * mapped file. */
+void pptk_cache_image_init(struct pptk_cache_image *img, const void *base, size_t size);
+
+/* Unmaps the image, if it was mapped by pptk_cache_open(), and frees the interned spellings */
+void pptk_cache_close(struct pptk_cache_image *img);
+
+/* Replays the next pptk_scan() of the image, appending its tokens to pp_chain with their situs
+ * spans attributed to filename. Returns the result the pptk_scan() originally returned, and
+ * _PPTK_FINISH once all events are replayed. */
+int pptk_cache_replay(struct c_compiler *cc, struct pptk_cache_image *img, const char *filename, struct pptk **pp_chain);
+
+void pptk_cache_recorder_init(struct pptk_cache_recorder *rec);
+void pptk_cache_recorder_cleanup(struct pptk_cache_recorder *rec);
+
+/* Records a pptk_scan() that returned result and appended the tokens from first_new to the
+ * end of chain (first_new is NULL if no tokens were appended.) Returns 0 upon success, or
+ * non-zero if the scan cannot be recorded, in which case the file should not be cached (this
+ * happens on memory failure, or if a token has a situs outside of filename.) */
+int pptk_cache_record(struct pptk_cache_recorder *rec, int result, int endline, struct pptk *first_new, struct pptk *chain, const char *filename);
+
+/* Writes the recording as the cache file for key in cache_dir. The file is written under a
+ * temporary name first and then renamed, so concurrent compilers never see a partial file.
+ * Returns 0 upon success, non-zero upon failure. */
+int pptk_cache_write(const char *cache_dir, const struct pptk_cache_key *key, const struct pptk_cache_recorder *rec);
+
+void pptk_cache_state_free(struct pptk_cache_state *state);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* PPTK_CACHE_H */
@@ -172,6 +172,7 @@ static int situs_chop(struct situs *chop, struct situs *from, size_t byte_length
   chop->num_spans_ = 1;
   chop->u_.one_.filename_ = sf->filename_;
   chop->u_.one_.is_substitution_ = 0;
+  chop->u_.one_.is_aux_ = 0;
   chop->u_.one_.num_bytes_ = byte_length;
   chop->u_.one_.start_ = sf->start_;
   chop->u_.one_.start_line_ = sf->start_line_;
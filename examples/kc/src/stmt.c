@@ -48,6 +48,11 @@
 #include "templ_parser.h"
 #endif
 
+#ifndef EXPR_CODE_H_INCLUDED
+#define EXPR_CODE_H_INCLUDED
+#include "expr_code.h"
+#endif
+
 #ifndef NAME_SPACE_H_INCLUDED
 #define NAME_SPACE_H_INCLUDED
 #include "name_space.h"
@@ -90,6 +95,8 @@ struct stmt *stmt_alloc(struct c_compiler *cc, enum stmt_type st, struct situs *
   s->continue_parent_ = NULL;
   switch_case_map_init(&s->cases_);
   s->goto_destination_ = NULL;
+  s->code_ = NULL;
+  s->code_at_ = 0;
   return s;
 }
 
@@ -145,6 +152,8 @@ void stmt_free(struct stmt *s) {
     expr_free(s->expr1_);
     expr_free(s->expr2_);
 
+    expr_code_free(s->code_);
+
     switch_case_map_cleanup(&s->cases_);
 
     situs_cleanup(&s->location_);
@@ -171,7 +180,7 @@ void stmt_set_parent(struct stmt *s, struct stmt *new_parent) {
   }
 }
 
-int stmt_prepare(struct c_compiler *cc, struct stmt *root) {
+static int stmt_prepare_tree(struct c_compiler *cc, struct stmt *root) {
   /* Iterate through s and all its children, resolve goto's to their labels; as
    * defined by cx->current_func_'s namespace. */
   struct stmt *enter = root, *s;
@@ -185,6 +194,11 @@ int stmt_prepare(struct c_compiler *cc, struct stmt *root) {
       if (s->expr1_) expr_prepare(s->expr1_);
       if (s->expr2_) expr_prepare(s->expr2_);
 
+      /* Failure to compile is not an error, the expression is then evaluated by walking its tree. */
+      if (s->expr0_) expr_code_compile(cc, s->expr0_);
+      if (s->expr1_) expr_code_compile(cc, s->expr1_);
+      if (s->expr2_) expr_code_compile(cc, s->expr2_);
+
       switch (s->type_) {
         case ST_GOTO:
           /* Perform lookup of label */
@@ -203,6 +217,11 @@ int stmt_prepare(struct c_compiler *cc, struct stmt *root) {
             if (!failure) failure = -1;
           }
           break;
+        case ST_SWITCH:
+          /* All cases are known by now, pick how to dispatch on them. Failure leaves the
+           * cases to be found by walking the tree, so is not an error either. */
+          switch_case_map_prepare(&s->cases_);
+          break;
       }
 
       if (s->child0_) {
@@ -238,11 +257,29 @@ int stmt_prepare(struct c_compiler *cc, struct stmt *root) {
   }
 }
 
+int stmt_prepare(struct c_compiler *cc, struct stmt *root) {
+  int r;
+  /* Any bytecode was compiled against the statements and expressions as they were */
+  expr_code_free(root->code_);
+  root->code_ = NULL;
+
+  r = stmt_prepare_tree(cc, root);
+  if (r) return r;
+
+  /* Failure to compile is not an error, the statements are then executed by walking their tree. */
+  expr_code_compile_stmt(cc, root);
+  return 0;
+}
+
 int stmt_exec(struct c_compiler *cc, struct stmt *root, void *local_base, void *param_base, void *return_value_ptr) {
   int r;
   struct expr_temp result;
   struct stmt *s = NULL;
   struct stmt *enter = root;
+
+  if (root->code_ && !cc->eval_by_tree_walk_) {
+    return expr_code_run(cc, root->code_, &result, 0, NULL, local_base, param_base, return_value_ptr);
+  }
   for (;;) {
     do {
       /* Entering for execution */
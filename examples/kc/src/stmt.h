@@ -32,6 +32,7 @@ extern "C" {
 
 struct c_compiler;
 struct expr;
+struct expr_code;
 
 enum stmt_type {
   ST_LABEL,
@@ -88,6 +89,14 @@ struct stmt {
 
   /* Goto destination statement (this must be an ST_GOTO.) */
   struct stmt *goto_destination_;
+
+  /* Bytecode executing this statement tree if it is the root of a statement tree that was compiled
+   * by expr_code_compile_stmt(), NULL otherwise. */
+  struct expr_code *code_;
+
+  /* Index of the first instruction of the statement in the bytecode of the statement tree, set by
+   * expr_code_compile_stmt() for the targets of goto and case. */
+  size_t code_at_;
 };
 
 struct stmt *stmt_alloc(struct c_compiler *cc, enum stmt_type st, struct situs *location);
@@ -23,14 +23,41 @@
 #include "switch.h"
 #endif
 
+/* Switches with up to this many cases are dispatched by a linear scan */
+#define SWITCH_MAX_LINEAR_CASES 8
+
+/* A jump table is used if at least 1 in this many of its entries has a case */
+#define SWITCH_MIN_JUMP_TABLE_DENSITY 4
+
 void switch_case_map_init(struct switch_case_map *scm) {
   scm->first_ = NULL;
   scm->root_ = NULL;
   scm->default_ = NULL;
+  scm->dispatch_ = SWD_TREE;
+  scm->num_values_ = 0;
+  scm->values_ = NULL;
+  scm->cases_ = NULL;
+  scm->jump_base_ = 0;
+  scm->jump_range_ = 0;
+  scm->jump_table_ = NULL;
+}
+
+static void switch_dispatch_reset(struct switch_case_map *scm) {
+  if (scm->values_) free(scm->values_);
+  if (scm->cases_) free(scm->cases_);
+  if (scm->jump_table_) free(scm->jump_table_);
+  scm->dispatch_ = SWD_TREE;
+  scm->num_values_ = 0;
+  scm->values_ = NULL;
+  scm->cases_ = NULL;
+  scm->jump_base_ = 0;
+  scm->jump_range_ = 0;
+  scm->jump_table_ = NULL;
 }
 
 void switch_case_map_cleanup(struct switch_case_map *scm) {
   struct switch_case *sc;
+  switch_dispatch_reset(scm);
   /* Free all switch_cases without a care for the red black tree */
   sc = scm->first_;
   if (sc) {
@@ -55,6 +82,7 @@ struct switch_case *switch_alloc_case(struct switch_case_map *scm, struct stmt *
   if (sc && !sc->case_stmt_) {
     /* New insertion */
     sc->case_stmt_ = case_stmt;
+    switch_dispatch_reset(scm);
   
     if (scm->first_) {
       sc->next_ = scm->first_;
@@ -97,6 +125,7 @@ struct switch_case *switch_alloc_default(struct switch_case_map *scm, struct stm
 
 void switch_free_case(struct switch_case_map *scm, uint64_t case_value) {
   struct switch_case *deleted;
+  switch_dispatch_reset(scm);
   scm->root_ = switch_delete_at(scm->root_, case_value, &deleted);
   if (scm->root_) scm->root_->is_red_ = 0;
   if (deleted) {
@@ -279,7 +308,119 @@ static struct switch_case *switch_delete_at(struct switch_case *h, uint64_t case
   return switch_fixup(h);
 }
 
+static void switch_flatten(struct switch_case *n, uint64_t *values, struct switch_case **cases, size_t *pos) {
+  while (n) {
+    switch_flatten(n->left_, values, cases, pos);
+    values[*pos] = n->case_value_;
+    cases[*pos] = n;
+    (*pos)++;
+    n = n->right_;
+  }
+}
+
+int switch_case_map_prepare(struct switch_case_map *scm) {
+  struct switch_case *sc;
+  size_t num_values = 0;
+  size_t n;
+
+  switch_dispatch_reset(scm);
+
+  sc = scm->first_;
+  if (sc) {
+    do {
+      if (sc != scm->default_) num_values++;
+      sc = sc->next_;
+    } while (sc != scm->first_);
+  }
+  if (!num_values) {
+    /* Nothing to find */
+    return 0;
+  }
+
+  scm->values_ = (uint64_t *)malloc(num_values * sizeof(uint64_t));
+  scm->cases_ = (struct switch_case **)malloc(num_values * sizeof(struct switch_case *));
+  if (!scm->values_ || !scm->cases_) {
+    switch_dispatch_reset(scm);
+    return -1;
+  }
+  n = 0;
+  switch_flatten(scm->root_, scm->values_, scm->cases_, &n);
+  scm->num_values_ = n;
+
+  if (n <= SWITCH_MAX_LINEAR_CASES) {
+    scm->dispatch_ = SWD_LINEAR;
+    return 0;
+  }
+
+  /* Values are sorted as unsigned, so for a signed switch, negative case values sort after all
+   * positive ones. Take the range to start after the largest gap between successive values,
+   * wrapping around, so a range of cases around zero is still found to be dense. */
+  size_t start = 0;
+  uint64_t largest_gap = scm->values_[0] - scm->values_[n - 1];
+  size_t k;
+  for (k = 1; k < n; ++k) {
+    uint64_t gap = scm->values_[k] - scm->values_[k - 1];
+    if (gap > largest_gap) {
+      largest_gap = gap;
+      start = k;
+    }
+  }
+  uint64_t base = scm->values_[start];
+  uint64_t range = scm->values_[(start + n - 1) % n] - base;
+
+  if (range < ((uint64_t)n * SWITCH_MIN_JUMP_TABLE_DENSITY)) {
+    struct switch_case **jump_table = (struct switch_case **)calloc((size_t)range + 1, sizeof(struct switch_case *));
+    if (jump_table) {
+      for (k = 0; k < n; ++k) {
+        jump_table[scm->values_[k] - base] = scm->cases_[k];
+      }
+      free(scm->values_);
+      free(scm->cases_);
+      scm->values_ = NULL;
+      scm->cases_ = NULL;
+      scm->num_values_ = 0;
+      scm->jump_base_ = base;
+      scm->jump_range_ = range;
+      scm->jump_table_ = jump_table;
+      scm->dispatch_ = SWD_JUMP_TABLE;
+      return 0;
+    }
+    /* Fall back to binary search */
+  }
+
+  scm->dispatch_ = SWD_BINARY;
+  return 0;
+}
+
 struct switch_case *switch_find_case(struct switch_case_map *scm, uint64_t case_value) {
+  switch (scm->dispatch_) {
+    case SWD_JUMP_TABLE: {
+      uint64_t index = case_value - scm->jump_base_;
+      return (index <= scm->jump_range_) ? scm->jump_table_[index] : NULL;
+    }
+    case SWD_BINARY: {
+      /* Narrow down to the last value not above case_value; the halving selects rather than
+       * branches, so mispredictions don't depend on the case value. */
+      const uint64_t *base = scm->values_;
+      size_t n = scm->num_values_;
+      while (n > 1) {
+        size_t half = n / 2;
+        base = (base[half] <= case_value) ? base + half : base;
+        n -= half;
+      }
+      return (*base == case_value) ? scm->cases_[base - scm->values_] : NULL;
+    }
+    case SWD_LINEAR: {
+      size_t n;
+      for (n = 0; n < scm->num_values_; ++n) {
+        if (scm->values_[n] == case_value) return scm->cases_[n];
+      }
+      return NULL;
+    }
+    case SWD_TREE:
+      break;
+  }
+
   struct switch_case *n = scm->root_;
   while (n) {
     if (case_value < n->case_value_) {
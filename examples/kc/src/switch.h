@@ -16,6 +16,11 @@
 #ifndef SWITCH_H
 #define SWITCH_H
 
+#ifndef STDDEF_H_INCLUDED
+#define STDDEF_H_INCLUDED
+#include <stddef.h>
+#endif
+
 #ifndef STDINT_H_INCLUDED
 #define STDINT_H_INCLUDED
 #include <stdint.h>
@@ -28,10 +33,28 @@ extern "C" {
 
 struct stmt; /* forward declaration from "stmt.h" */
 
+/* How switch_find_case() finds a case, chosen by switch_case_map_prepare() */
+enum switch_dispatch {
+  SWD_TREE,       /* not prepared, walk the red-black tree */
+  SWD_LINEAR,     /* few cases, scan values_ */
+  SWD_BINARY,     /* sparse cases, binary search of the sorted values_ */
+  SWD_JUMP_TABLE  /* dense cases, index jump_table_ by (case_value - jump_base_) */
+};
+
 struct switch_case_map {
   struct switch_case *first_; /* first case in next_/prev_ chain */
   struct switch_case *root_;  /* root of red-black tree */
   struct switch_case *default_; /* default case ; cannot exist in RB tree but does exist in chain.*/
+
+  /* Flattened form of the tree built by switch_case_map_prepare(), reset to SWD_TREE whenever
+   * a case is added or removed. */
+  enum switch_dispatch dispatch_;
+  size_t num_values_;
+  uint64_t *values_;             /* sorted case values (SWD_LINEAR, SWD_BINARY) */
+  struct switch_case **cases_;   /* case for each of values_ */
+  uint64_t jump_base_;           /* lowest case value (SWD_JUMP_TABLE) */
+  uint64_t jump_range_;          /* highest case value - jump_base_ */
+  struct switch_case **jump_table_; /* jump_range_ + 1 entries, NULL for values without a case */
 };
 
 struct switch_case {
@@ -56,6 +79,12 @@ void switch_free_case(struct switch_case_map *scm, uint64_t case_value);
 
 struct switch_case *switch_find_case(struct switch_case_map *scm, uint64_t case_value);
 
+/* Builds the dispatch for switch_find_case() once all cases are known; a jump table for dense
+ * case values, a sorted array for sparse values, or a linear scan for small switches.
+ * Returns 0 upon success, non-zero if no memory is available (in which case switch_find_case()
+ * keeps using the tree.) */
+int switch_case_map_prepare(struct switch_case_map *scm);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -49,109 +49,40 @@
 #include "symtab.h"
 #endif
 
-static int st_count_leaf_depth(struct sym *s) {
-  int count = 0;
-  if (!s) return 0;
-  if (!s->is_red_) {
-    count = 1;
-  }
-  count += st_count_leaf_depth(s->left_);
-  return count;
-}
-
-static int st_validate_leaf_depth(struct sym *s, int current_depth, int must_match) {
-  int next_depth = current_depth;
-  if (!s) {
-    return (must_match == current_depth);
-  }
-  if (!s->is_red_) {
-    next_depth++;;
-  }
-  if (!st_validate_leaf_depth(s->left_, next_depth, must_match)) {
-    return 0;
-  }
-  if (!st_validate_leaf_depth(s->right_, next_depth, must_match)) {
-    return 0;
-  }
-  return 1;
-}
+#define ST_MIN_NUM_BUCKETS 8
 
 int st_check_sanity(struct symtab *st) {
   int ret = 1;
-  int black_depth = st_count_leaf_depth(st->root_);
-
-  if (!st_validate_leaf_depth(st->root_, 0, black_depth)) {
-    LOGERROR("symtab is not balanced");
+  size_t n;
+  size_t num_syms = 0;
+
+  for (n = 0; n < st->num_buckets_; ++n) {
+    struct sym *s = st->buckets_[n];
+    if (s) {
+      num_syms++;
+      if (st_find_hashed(st, s->ident_, s->hash_value_) != s) {
+        LOGERROR("symtab sym \"%s\" cannot be found from its bucket", s->ident_);
+        ret = 0;
+      }
+    }
+  }
+  if (num_syms != st->num_syms_) {
+    LOGERROR("symtab count mismatch");
     ret = 0;
   }
 
   return ret;
 }
 
-static struct sym *st_rotate_left(struct sym *h) {
-  struct sym *x = h->right_;
-  h->right_ = x->left_;
-  x->left_ = h;
-  x->is_red_ = h->is_red_;
-  h->is_red_ = 1;
-  return x;
-}
-
-static struct sym *st_rotate_right(struct sym *h) {
-  struct sym *x;
-  x = h->left_;
-  h->left_ = x->right_;
-  x->right_ = h;
-  x->is_red_ = h->is_red_;
-  h->is_red_ = 1;
-  return x;
-}
-
-static void st_flip_colors(struct sym *h) {
-  struct sym *left = h->left_;
-  struct sym *right = h->right_;
-  h->is_red_ = !h->is_red_;
-  left->is_red_ = !left->is_red_;
-  right->is_red_ = !right->is_red_;
-}
-
-static struct sym *st_move_red_left(struct sym *h) {
-  struct sym *right = h->right_;
-  st_flip_colors(h);
-  if (right && right->left_ && right->left_->is_red_) {
-    h->right_ = st_rotate_right(h->right_);
-    h = st_rotate_left(h);
-    st_flip_colors(h);
-  }
-  return h;
-}
-
-static struct sym *st_move_red_right(struct sym *h) {
-  struct sym *left = h->left_;
-  st_flip_colors(h);
-  if (left && left->left_ && left->left_->is_red_) {
-    h = st_rotate_right(h);
-    st_flip_colors(h);
-  }
-  return h;
-}
-
-static struct sym *st_fixup(struct sym *h) {
-  if (h->right_ && h->right_->is_red_ && (!h->left_ || !h->left_->is_red_)) {
-    h = st_rotate_left(h);
-  }
-  
-  if (h->left_ && h->left_->is_red_) {
-    if (h->left_->left_ && h->left_->left_->is_red_) {
-      h = st_rotate_right(h);
-    }
-  }
-
-  if (h->left_ && h->left_->is_red_ && h->right_ && h->right_->is_red_) {
-    st_flip_colors(h);
+uint64_t st_hash(const char *value) {
+  /* FNV-1a */
+  uint64_t hash_value = 14695981039346656037ULL;
+  while (*value) {
+    hash_value ^= *(uint8_t *)value;
+    hash_value *= 1099511628211ULL;
+    value++;
   }
-
-  return h;
+  return hash_value;
 }
 
 static struct sym *st_alloc(size_t sym_size, const char *ident) {
@@ -162,188 +93,138 @@ static struct sym *st_alloc(size_t sym_size, const char *ident) {
   s->ident_ = ((char *)s) + sym_size; /* Right after the sym */
   memcpy(s->ident_, ident, ident_len);
   s->ident_[ident_len - 1] = '\0';
-  s->is_red_ = 0;
-  s->left_ = s->right_ = NULL;
   return s;
 }
 
-static struct sym *st_find_or_insert_at_node(struct sym *h, uint64_t hash_key, const char *ident, struct sym **result, int *result_is_new, size_t sym_size) {
-  if (!h) {
-    /* At leaf, did not find an existing sym so allocate a new one */
-    struct sym *n = st_alloc(sym_size, ident);
-    *result = n;
-    if (!n) {
-      return NULL;
+static int st_grow(struct symtab *st) {
+  size_t new_num_buckets = st->num_buckets_ ? st->num_buckets_ * 2 : ST_MIN_NUM_BUCKETS;
+  struct sym **new_buckets = (struct sym **)calloc(new_num_buckets, sizeof(struct sym *));
+  if (!new_buckets) return -1;
+  size_t mask = new_num_buckets - 1;
+  size_t n;
+  for (n = 0; n < st->num_buckets_; ++n) {
+    struct sym *s = st->buckets_[n];
+    if (s) {
+      size_t bucket = (size_t)s->hash_value_ & mask;
+      while (new_buckets[bucket]) bucket = (bucket + 1) & mask;
+      new_buckets[bucket] = s;
     }
-    *result_is_new = 1;
-    n->hash_value_ = hash_key;
-    n->is_red_ = 1;
-    n->left_ = n->right_ = NULL;
-    return n;
-  }
-
-  if ((hash_key < h->hash_value_) || ((hash_key == h->hash_value_) && (strcmp(ident, h->ident_) < 0))) {
-    struct sym *new_left_branch = st_find_or_insert_at_node(h->left_, hash_key, ident, result, result_is_new, sym_size);
-    h->left_ = new_left_branch;
-  }
-  else if ((hash_key > h->hash_value_) || ((hash_key == h->hash_value_) && (strcmp(ident, h->ident_) > 0))) {
-    struct sym *new_right_branch = st_find_or_insert_at_node(h->right_, hash_key, ident, result, result_is_new, sym_size);
-    h->right_ = new_right_branch;
-  }
-  else /* hash_key == h->hash_value_ && value_key == h->value_ */ {
-    *result = h;
-    *result_is_new = 0;
-  }
-
-  return st_fixup(h);
-}
-
-static uint64_t st_hash(const char *value) {
-  uint64_t hash_value = 0;
-  while (*value) {
-    hash_value = (hash_value << 7) | (hash_value >> ((-7) & 63));
-    hash_value += *(uint8_t *)value;
-    value++;
   }
-  return hash_value;
+  if (st->buckets_) free(st->buckets_);
+  st->buckets_ = new_buckets;
+  st->num_buckets_ = new_num_buckets;
+  return 0;
 }
 
-static struct sym *st_delete_and_retrieve_min(struct sym *h, struct sym **min_sym) {
-  if (h->left_ == NULL) {
-    *min_sym = h;
-    return NULL;
+struct sym *st_find_or_insert(struct symtab *st, const char *ident, int *s_is_new, size_t sym_size) {
+  uint64_t hash_value = st_hash(ident);
+  struct sym *s = st_find_hashed(st, ident, hash_value);
+  if (s) {
+    *s_is_new = 0;
+    return s;
   }
-  
-  if ((!h->left_ || !h->left_->is_red_) && (!h->left_ || !h->left_->left_ || !h->left_->left_->is_red_)) {
-    h = st_move_red_left(h);
+  /* Keep the load factor at or below 1/2 so probe sequences stay short */
+  if (((st->num_syms_ + 1) * 2) > st->num_buckets_) {
+    if (st_grow(st)) return NULL;
   }
-
-  h->left_ = st_delete_and_retrieve_min(h->left_, min_sym);
-
-  return st_fixup(h);
-}
-
-static struct sym *st_delete_at(struct sym *h, uint64_t hash_key, const char *value_key, struct sym **sym_deleted) {
-  if ((hash_key < h->hash_value_) || (hash_key == h->hash_value_) && (strcmp(value_key, h->ident_) < 0)) {
-    if (!h->left_) {
-      /* key not found in tree */
-      *sym_deleted = NULL;
-      return h;
-    }
-    if ((!h->left_->is_red_) && (!h->left_->left_ || !h->left_->left_->is_red_)) {
-      h = st_move_red_left(h);
-    }
-    h->left_ = st_delete_at(h->left_, hash_key, value_key, sym_deleted);
+  s = st_alloc(sym_size, ident);
+  if (!s) return NULL;
+  s->hash_value_ = hash_value;
+  size_t mask = st->num_buckets_ - 1;
+  size_t bucket = (size_t)hash_value & mask;
+  while (st->buckets_[bucket]) bucket = (bucket + 1) & mask;
+  st->buckets_[bucket] = s;
+  st->num_syms_++;
+  *s_is_new = 1;
+
+  /* Append new s to tail of sequence */
+  if (st->seq_) {
+    s->next_ = st->seq_;
+    s->prev_ = st->seq_->prev_;
+    s->next_->prev_ = s->prev_->next_ = s;
   }
   else {
-    if (h->left_ && h->left_->is_red_) {
-      h = st_rotate_right(h);
-    }
-
-    if (((hash_key == h->hash_value_) && !strcmp(value_key, h->ident_)) && !h->right_) {
-      /* Found match at leaf */
-      *sym_deleted = h;
-      return NULL;
-    }
-
-    if ((!h->right_ || (!h->right_->is_red_)) && (!h->right_ || !h->right_->left_ || !h->right_->left_->is_red_)) {
-      h = st_move_red_right(h);
-    }
+    s->next_ = s->prev_ = st->seq_ = s;
+  }
+  return s;
+}
 
-    if ((hash_key == h->hash_value_) && !strcmp(value_key, h->ident_)) {
-      /* Found match at inner node */
-      *sym_deleted = h;
-      struct sym *sub;
-      struct sym *subs_right_arm = st_delete_and_retrieve_min(h->right_, &sub);
-      sub->left_ = h->left_;
-      /* Preserve read-ness of this node, even as we're replacing this node. */
-      sub->is_red_ = h->is_red_;
-      h = sub;
-      h->right_ = subs_right_arm;
-    }
-    else {
-      if (!h->right_) {
-        /* key not found in tree */
-        *sym_deleted = NULL;
-        return h;
-      }
-      h->right_ = st_delete_at(h->right_, hash_key, value_key, sym_deleted);
+struct sym *st_find_hashed(struct symtab *st, const char *value_key, uint64_t hash_value) {
+  if (!st->num_syms_) return NULL;
+  size_t mask = st->num_buckets_ - 1;
+  size_t bucket = (size_t)hash_value & mask;
+  struct sym *s;
+  while ((s = st->buckets_[bucket]) != NULL) {
+    if ((s->hash_value_ == hash_value) && !strcmp(value_key, s->ident_)) {
+      return s;
     }
+    bucket = (bucket + 1) & mask;
   }
-
-  return st_fixup(h);
+  return NULL; /* not found */
 }
 
+struct sym *st_find(struct symtab *st, const char *value_key) {
+  if (!st->num_syms_) return NULL;
+  return st_find_hashed(st, value_key, st_hash(value_key));
+}
 
-struct sym *st_find_or_insert(struct symtab *st, const char *ident, int *s_is_new, size_t sym_size) {
-  struct sym *s = NULL;
-  /* Value -1 should never survive, if it does, something is broken in st_find_or_insert_at_node() */
-  *s_is_new = -1;
-  st->root_ = st_find_or_insert_at_node(st->root_, st_hash(ident), ident, &s, s_is_new, sym_size);
-  if (st->root_) st->root_->is_red_ = 0;
-  if (!s) { return NULL; }
-  if (*s_is_new) {
-    /* Append new s to tail of sequence */
-    if (st->seq_) {
-      s->next_ = st->seq_;
-      s->prev_ = st->seq_->prev_;
-      s->next_->prev_ = s->prev_->next_ = s;
-    }
-    else {
-      s->next_ = s->prev_ = st->seq_ = s;
+int st_remove(struct symtab *st, struct sym *s) {
+  if (!st->num_syms_) return 0;
+  size_t mask = st->num_buckets_ - 1;
+  size_t bucket = (size_t)s->hash_value_ & mask;
+  while (st->buckets_[bucket] != s) {
+    if (!st->buckets_[bucket]) {
+      /* s is not in the table */
+      return 0;
     }
+    bucket = (bucket + 1) & mask;
   }
-  return s;
-}
 
-struct sym *st_find(struct symtab *st, const char *value_key) {
-  uint64_t hash = st_hash(value_key);
-  struct sym *s = st->root_;
+  /* Remove by shifting back any syms further along the probe sequence that would otherwise
+   * no longer be reachable from their home bucket. */
+  size_t hole = bucket;
+  st->buckets_[hole] = NULL;
   for (;;) {
-    if (!s) return NULL; /* not found */
-    if ((hash < s->hash_value_) || ((hash == s->hash_value_) && (strcmp(value_key, s->ident_) < 0))) {
-      s = s->left_;
-    }
-    else if ((hash > s->hash_value_) || ((hash == s->hash_value_) && (strcmp(value_key, s->ident_) > 0))) {
-      s = s->right_;
-    }
-    else /* hash == s->hash_value_ && value_key == s->value_ */ {
-      return s;
+    bucket = (bucket + 1) & mask;
+    struct sym *other = st->buckets_[bucket];
+    if (!other) break;
+    size_t home = (size_t)other->hash_value_ & mask;
+    int home_in_range = (hole <= bucket) ? ((hole < home) && (home <= bucket)) : ((hole < home) || (home <= bucket));
+    if (!home_in_range) {
+      st->buckets_[hole] = other;
+      st->buckets_[bucket] = NULL;
+      hole = bucket;
     }
   }
-}
+  st->num_syms_--;
 
-int st_remove(struct symtab *st, struct sym *s) {
-  struct sym *s_deleted;
-  st->root_ = st_delete_at(st->root_, s->hash_value_, s->ident_, &s_deleted);
-  if (st->root_) st->root_->is_red_ = 0;
-  assert((s == s_deleted) || !s_deleted); /* if a match exists in the table, it must be s and not some other sym */
-  if (s_deleted) {
-    if (s_deleted->next_ == s) {
-      st->seq_ = NULL;
-    }
-    else {
-      if (st->seq_ == s_deleted) {
-        st->seq_ = s_deleted->next_;
-      }
-      s_deleted->next_->prev_ = s_deleted->prev_;
-      s_deleted->prev_->next_ = s_deleted->next_;
+  if (s->next_ == s) {
+    st->seq_ = NULL;
+  }
+  else {
+    if (st->seq_ == s) {
+      st->seq_ = s->next_;
     }
-    s->next_ = s->prev_ = NULL;
-    
-    return 1;
+    s->next_->prev_ = s->prev_;
+    s->prev_->next_ = s->next_;
   }
-  return 0;
+  s->next_ = s->prev_ = NULL;
+
+  return 1;
 }
 
 void st_init(struct symtab *st) {
-  st->root_ = NULL;
+  st->buckets_ = NULL;
+  st->num_buckets_ = 0;
+  st->num_syms_ = 0;
   st->seq_ = NULL;
 }
 
 void st_cleanup(struct symtab *st) {
-  while (st->root_) {
-    st_remove(st, st->root_);
+  while (st->seq_) {
+    st_remove(st, st->seq_);
   }
+  if (st->buckets_) free(st->buckets_);
+  st->buckets_ = NULL;
+  st->num_buckets_ = 0;
 }
-
@@ -16,6 +16,11 @@
 #ifndef SYMTAB_H
 #define SYMTAB_H
 
+#ifndef STDDEF_H_INCLUDED
+#define STDDEF_H_INCLUDED
+#include <stddef.h>
+#endif
+
 #ifndef STDINT_H_INCLUDED
 #define STDINT_H_INCLUDED
 #include <stdint.h>
@@ -26,18 +31,20 @@ extern "C" {
 #endif
 
 struct sym {
-  uint64_t hash_value_;
+  uint64_t hash_value_; /* st_hash() of ident_ */
   char *ident_; /* ident_ storage is allocated as part of sym, free()'ing the sym frees the ident_ with it. */
-  int is_red_ : 1;
-  struct sym *left_, *right_;
   struct sym *next_, *prev_;
 };
 
+/* Hash table of syms, using open addressing with linear probing; buckets_ is allocated upon
+ * first insertion, so empty scopes cost nothing. */
 struct symtab {
-  struct sym *root_;
-  
+  struct sym **buckets_;
+  size_t num_buckets_; /* power of two, or 0 */
+  size_t num_syms_;
+
   /* All symbols in the table as a cyclic list in order of declaration, points
-   * to the first sym declared */
+   * to the first sym declared (NULL if the table is empty.) */
   struct sym *seq_;
 };
 
@@ -48,9 +55,17 @@ void st_init(struct symtab *st);
  * is embedded in. */
 void st_cleanup(struct symtab *st);
 
+/* Hash of a null terminated identifier (FNV-1a, the same hash pptk_text_hash() returns for
+ * interned token text.) */
+uint64_t st_hash(const char *value_key);
+
 struct sym *st_find_or_insert(struct symtab *st, const char *value_key, int *s_is_new, size_t sym_size);
 struct sym *st_find(struct symtab *st, const char *value_key);
 
+/* As st_find(), but with the st_hash() of value_key already known, this saves rehashing the
+ * key when looking up the same identifier in several tables. */
+struct sym *st_find_hashed(struct symtab *st, const char *value_key, uint64_t hash_value);
+
 int st_remove(struct symtab *st, struct sym *s);
 
 int st_check_sanity(struct symtab *st);
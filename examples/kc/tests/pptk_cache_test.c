@@ -0,0 +1,351 @@
+/* Copyright 2023-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Tests of the pptk cache: a file preprocessed with a cache directory writes a cache file that
+ * pptk_cache_validate() accepts and that replays to the same tokens, while truncated and corrupt
+ * cache files are rejected.
+ * Usage: pptk_cache_test <work directory> */
+
+#ifndef STDIO_H_INCLUDED
+#define STDIO_H_INCLUDED
+#include <stdio.h>
+#endif
+
+#ifndef STDLIB_H_INCLUDED
+#define STDLIB_H_INCLUDED
+#include <stdlib.h>
+#endif
+
+#ifndef STRING_H_INCLUDED
+#define STRING_H_INCLUDED
+#include <string.h>
+#endif
+
+#ifndef C_COMPILER_H_INCLUDED
+#define C_COMPILER_H_INCLUDED
+#include "c_compiler.h"
+#endif
+
+#ifndef PP_TOKENS_H_INCLUDED
+#define PP_TOKENS_H_INCLUDED
+#include "pp_tokens.h"
+#endif
+
+#ifndef EXPR_H_INCLUDED
+#define EXPR_H_INCLUDED
+#include "expr.h"
+#endif
+
+#ifndef PP_TOKENIZER_H_INCLUDED
+#define PP_TOKENIZER_H_INCLUDED
+#include "pp_tokenizer.h"
+#endif
+
+#ifndef PPTK_CACHE_H_INCLUDED
+#define PPTK_CACHE_H_INCLUDED
+#include "pptk_cache.h"
+#endif
+
+static const char g_source_[] =
+  "/* pptk cache test */\n"
+  "#define SQUARE(x) ((x) * (x))\n"
+  "static const char *s = \"a string\" \"??= trigraph\";\n"
+  "static const unsigned long long big = 0xFFFFFFFFFFFFFFFFull;\n"
+  "static double d = 1.5e3 + 'c' + L'w';\n"
+  "int f(int y) { return SQUARE(y) \\\n"
+  "  + 42; }\n";
+
+static const char *g_work_dir_;
+static char *g_source_path_;
+static char *g_cache_dir_;
+
+/* The cache file of g_source_, as written by preprocess(), and its key */
+static struct pptk_cache_key g_key_;
+static unsigned char *g_cache_file_;
+static size_t g_cache_file_size_;
+
+static char *path_join(const char *dir, const char *name) {
+  size_t dir_len = strlen(dir), name_len = strlen(name);
+  char *path = (char *)malloc(dir_len + 1 + name_len + 1);
+  if (!path) return NULL;
+  memcpy(path, dir, dir_len);
+  path[dir_len] = '/';
+  memcpy(path + dir_len + 1, name, name_len + 1);
+  return path;
+}
+
+static int read_file(const char *path, unsigned char **pbuf, size_t *psize) {
+  FILE *fp = fopen(path, "rb");
+  unsigned char *buf = NULL;
+  size_t size = 0, size_allocated = 0;
+  if (!fp) return -1;
+  for (;;) {
+    if (size == size_allocated) {
+      size_t new_size_allocated = size_allocated ? size_allocated * 2 : 4096;
+      unsigned char *new_buf = (unsigned char *)realloc(buf, new_size_allocated);
+      if (!new_buf) {
+        free(buf);
+        fclose(fp);
+        return -1;
+      }
+      buf = new_buf;
+      size_allocated = new_size_allocated;
+    }
+    size_t n = fread(buf + size, 1, size_allocated - size, fp);
+    if (!n) break;
+    size += n;
+  }
+  fclose(fp);
+  *pbuf = buf;
+  *psize = size;
+  return 0;
+}
+
+/* Appends a line describing each token of chain to the text at *pdump */
+static int dump_tokens(char **pdump, size_t *pdump_size, struct pptk *chain) {
+  struct pptk *tk = chain;
+  if (!tk) return 0;
+  do {
+    char line[512];
+    int n = snprintf(line, sizeof(line), "%d [%.*s] %d:%d n%zu",
+                     tk->tok_, (int)(tk->text_len_ < 256 ? tk->text_len_ : 256), tk->text_,
+                     situs_line(&tk->situs_), situs_col(&tk->situs_), tk->situs_.num_spans_);
+    if (tk->tok_ == PPTK_STRING_LIT) {
+      n += snprintf(line + n, sizeof(line) - n, " s%d:%zu", tk->v_.string_.wide_, tk->v_.string_.length_);
+    }
+    else if ((tk->tok_ != PPTK_TYPEDEF_NAME) && tk->v_.expr_) {
+      n += snprintf(line + n, sizeof(line) - n, " e%d:%llx", (int)tk->v_.expr_->et_, (unsigned long long)tk->v_.expr_->v_.u64_);
+    }
+    n += snprintf(line + n, sizeof(line) - n, "\n");
+    char *new_dump = (char *)realloc(*pdump, *pdump_size + n + 1);
+    if (!new_dump) return -1;
+    memcpy(new_dump + *pdump_size, line, n + 1);
+    *pdump = new_dump;
+    *pdump_size += n;
+    tk = tk->next_;
+  } while (tk != chain);
+  return 0;
+}
+
+/* Preprocesses g_source_ with the cache in g_cache_dir_, the tokens are dumped to *pdump */
+static int preprocess(char **pdump) {
+  struct c_compiler cc;
+  size_t dump_size = 0;
+  int r = 0;
+  *pdump = NULL;
+  cc_init(&cc);
+  if (cc_set_pptk_cache_dir(&cc, g_cache_dir_)) {
+    cc_cleanup(&cc);
+    return -1;
+  }
+  FILE *fp = fopen(g_source_path_, "rb");
+  if (!fp) {
+    cc_cleanup(&cc);
+    return -1;
+  }
+  if (!cc_push_input_file_fp(&cc, g_source_path_, fp)) {
+    fclose(fp);
+    cc_cleanup(&cc);
+    return -1;
+  }
+  for (;;) {
+    enum c_compiler_result ccr = cc_preprocessor_stage(&cc);
+    if (ccr == CCR_SUCCESS) {
+      if (dump_tokens(pdump, &dump_size, cc.cp_input_)) r = -1;
+      pptk_free(cc.cp_input_);
+      cc.cp_input_ = NULL;
+      if (r || cc.cp_input_final_) break;
+    }
+    else if (ccr == CCR_OLD_INCLUDE) {
+      continue;
+    }
+    else {
+      /* No includes in g_source_, anything else is a failure */
+      r = -1;
+      break;
+    }
+  }
+  if (cc.have_error_) r = -1;
+  cc_cleanup(&cc);
+  if (!r && !*pdump) r = -1;
+  return r;
+}
+
+static int validate_copy(const unsigned char *file, size_t size, const struct pptk_cache_key *key) {
+  /* Validate an exactly sized heap copy, so any read past the end is caught by a memory checker */
+  unsigned char *copy = (unsigned char *)malloc(size ? size : 1);
+  if (!copy) return -1;
+  memcpy(copy, file, size);
+  int r = pptk_cache_validate(copy, size, key);
+  free(copy);
+  return r;
+}
+
+static int t1(void) {
+  char *fresh = NULL, *replayed = NULL;
+  char *cache_path = NULL;
+  struct c_compiler cc;
+  struct pptk_cache_image img;
+  int r = 0;
+
+  FILE *fp = fopen(g_source_path_, "wb");
+  if (!fp) return 1;
+  if (fwrite(g_source_, 1, sizeof(g_source_) - 1, fp) != (sizeof(g_source_) - 1)) r = 2;
+  if (fclose(fp)) r = 2;
+  if (r) return r;
+
+  cc_init(&cc);
+  pptk_cache_key_init(&g_key_, &cc, g_source_, sizeof(g_source_) - 1, M_PPTK_DEFAULT);
+  cc_cleanup(&cc);
+  cache_path = (char *)malloc(strlen(g_cache_dir_) + PPTK_CACHE_FILENAME_SIZE);
+  if (!cache_path) return 3;
+  pptk_cache_path(cache_path, g_cache_dir_, &g_key_);
+  remove(cache_path); /* from a previous run */
+
+  if (preprocess(&fresh)) r = 4;
+  else if (read_file(cache_path, &g_cache_file_, &g_cache_file_size_)) r = 5;
+  else if (validate_copy(g_cache_file_, g_cache_file_size_, &g_key_)) r = 6;
+  else if (pptk_cache_open(&img, g_cache_dir_, &g_key_)) r = 7;
+  else {
+    pptk_cache_close(&img);
+    /* The second time around the tokens are replayed from the cache file */
+    if (preprocess(&replayed)) r = 8;
+    else if (strcmp(fresh, replayed)) r = 9;
+  }
+  free(fresh);
+  free(replayed);
+  free(cache_path);
+  return r;
+}
+
+static int t2(void) {
+  size_t size;
+  if (!g_cache_file_) return 1;
+  for (size = 0; size < g_cache_file_size_; ++size) {
+    if (!validate_copy(g_cache_file_, size, &g_key_)) {
+      fprintf(stderr, "cache file truncated to %zu of %zu bytes was accepted\n", size, g_cache_file_size_);
+      return 2;
+    }
+  }
+  return 0;
+}
+
+static int t3(void) {
+  unsigned char *file;
+  struct pptk_cache_header *hdr;
+  struct pptk_cache_spelling *spellings;
+  unsigned char *stream;
+  struct pptk_cache_key other_key;
+  size_t n;
+  int bit;
+  int r = 0;
+  if (!g_cache_file_) return 1;
+  file = (unsigned char *)malloc(g_cache_file_size_);
+  if (!file) return 1;
+  hdr = (struct pptk_cache_header *)file;
+  spellings = (struct pptk_cache_spelling *)(hdr + 1);
+
+#define corrupt(rv, change) \
+  memcpy(file, g_cache_file_, g_cache_file_size_); \
+  change; \
+  if (!r && !validate_copy(file, g_cache_file_size_, &g_key_)) r = rv;
+
+  corrupt(2, hdr->magic_[0] ^= 1)
+  corrupt(3, hdr->version_++)
+  corrupt(4, hdr->byte_order_ = 0x04030201)
+  corrupt(5, hdr->num_events_++)
+  corrupt(6, hdr->num_events_--)
+  corrupt(7, hdr->num_spellings_++)
+  corrupt(8, hdr->stream_size_++)
+  corrupt(9, spellings[0].offset_ = (uint32_t)hdr->text_size_)
+  corrupt(10, spellings[0].len_ = (uint32_t)hdr->text_size_ + 1)
+  /* The last byte of the stream is the token count of the _PPTK_FINISH event, a continuation bit
+   * there makes the varint run past the end of the stream */
+  corrupt(11, stream = (unsigned char *)(spellings + hdr->num_spellings_); stream[hdr->stream_size_ - 1] |= 0x80)
+#undef corrupt
+
+  /* A valid file for a different key */
+  other_key = g_key_;
+  other_key.bits_per_long_ = (other_key.bits_per_long_ == 32) ? 64 : 32;
+  if (!r && !validate_copy(g_cache_file_, g_cache_file_size_, &other_key)) r = 12;
+
+  /* Every field of the header is checked, so any bit flipped there is rejected; elsewhere a flip
+   * may still be a valid file (e.g. a different character of a spelling), but must never read
+   * outside of it. */
+  for (n = 0; n < g_cache_file_size_; ++n) {
+    for (bit = 0; bit < 8; ++bit) {
+      memcpy(file, g_cache_file_, g_cache_file_size_);
+      file[n] ^= (unsigned char)(1 << bit);
+      int vr = validate_copy(file, g_cache_file_size_, &g_key_);
+      if (!r && !vr && (n < sizeof(struct pptk_cache_header))) {
+        fprintf(stderr, "cache file with bit %d of header byte %zu flipped was accepted\n", bit, n);
+        r = 13;
+      }
+    }
+  }
+
+  free(file);
+  return r;
+}
+
+#define enum_tests \
+xx(t1, "Cache file written, validated and replayed") \
+xx(t2, "Truncated cache file rejected") \
+xx(t3, "Corrupt cache file rejected")
+
+int main(int argc, char **argv) {
+  int r;
+  int failed = 0;
+  int num_tests_passed = 0;
+  int total_num_tests = 0;
+
+  if (argc != 2) {
+    fprintf(stderr, "Usage: pptk_cache_test <work directory>\n");
+    return EXIT_FAILURE;
+  }
+  g_work_dir_ = argv[1];
+  g_source_path_ = path_join(g_work_dir_, "pptk_cache_test.c");
+  g_cache_dir_ = path_join(g_work_dir_, "cache");
+  if (!g_source_path_ || !g_cache_dir_) {
+    fprintf(stderr, "No memory\n");
+    return EXIT_FAILURE;
+  }
+
+#define xx(id, desc) total_num_tests++;
+  enum_tests
+#undef xx
+#define xx(id, desc) \
+  r = id(); \
+  if (r) { \
+    fprintf(stderr, "%s %s: failed test (%d)\n", #id, desc, r); \
+    failed = 1; \
+  } \
+  else { \
+    num_tests_passed++; \
+  }
+  enum_tests
+#undef xx
+
+  free(g_cache_file_);
+  free(g_cache_dir_);
+  free(g_source_path_);
+
+  if (failed) {
+    fprintf(stderr, "FAILED: %d/%d tests passed\n", num_tests_passed, total_num_tests);
+    return EXIT_FAILURE;
+  }
+  printf("%d/%d tests passed\n", num_tests_passed, total_num_tests);
+  return EXIT_SUCCESS;
+}
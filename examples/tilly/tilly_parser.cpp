@@ -667,7 +667,7 @@ void TillyParser::process_lc() {
 
     switch (r) {
       case _LC_FINISH: {
-        mlc_set_input(&mlc_, (const char *)lc_to_mlc_data_.data(), lc_to_mlc_data_.size(), /* is_final_input: */1);
+        mlc_set_input_in_place(&mlc_, (char *)lc_to_mlc_data_.data(), lc_to_mlc_data_.size(), /* is_final_input: */1);
         have_mlc_data_to_process_ = true;
         have_lc_data_to_process_ = false;
         break;
@@ -690,7 +690,9 @@ void TillyParser::process_lc() {
       case LC_LINE_AVAILABLE:
         // Specific value returned for each line, caller is to pop the input in lc_to_mc_data and
         // lc_to_mc_situs and pass to the multiline comment scanner.
-        mlc_set_input(&mlc_, (const char *)lc_to_mlc_data_.data(), lc_to_mlc_data_.size(), 0);
+        // lc_to_mlc_data_ is left alone until mlc asks for more, so mlc can scan its tokens
+        // in place rather than copy them.
+        mlc_set_input_in_place(&mlc_, (char *)lc_to_mlc_data_.data(), lc_to_mlc_data_.size(), 0);
         have_mlc_data_to_process_ = true;
         return;
         // XXX: Who resets, and when ?
@@ -899,23 +901,33 @@ void TillyParser::write_output(FILE *fp) {
 
   size_t num_transitions = symbols_.size() + labels_.size();
 
+  // Resolve the failure functions at generation time, so each row of the emitted table holds
+  // the final successor state for every transition, and matching at runtime is a single lookup
+  // per subject node. Root and operand nodes transition on symbols, symbol nodes on operands.
+  std::vector<std::vector<AutomatonNode *> > successors;
+  successors.resize(automaton_nodes_.size());
+  for (auto &an: automaton_nodes_) {
+    auto &row = successors[an->num_];
+    row.resize(num_transitions, nullptr);
+    bool transitions_on_symbols = !an->parent_ || an->is_operand_;
+    for (size_t n = 0; n < num_transitions; ++n) {
+      row[n] = transitions_on_symbols ? an->succ_sym(*this, n) : an->succ_opd(n);
+    }
+  }
+
   // First size the columns for each transition.
   std::vector<int> column_widths;
   column_widths.resize(num_transitions);
   size_t num_rows = 0;
   int num_num_automaton_node_digits = num_digits(automaton_nodes_.size());
-  int max_num_failure_digits = 0;
   int max_num_num_acceptances_digits = 0;
   for (auto &an: automaton_nodes_) {
     num_rows++;
-    int num_failure_digits = an->failure_func_ ? num_digits(an->failure_func_->num_) : 1;
-    if (max_num_failure_digits < num_failure_digits) {
-      max_num_failure_digits = num_failure_digits;
-    }
-    for (auto *child: an->children_) {
-      int num_column_digits = num_digits(child->num_);
-      if (num_column_digits > column_widths[child->index_]) {
-        column_widths[child->index_] = num_column_digits;
+    for (size_t n = 0; n < num_transitions; ++n) {
+      AutomatonNode *succ = successors[an->num_][n];
+      int num_column_digits = succ ? num_digits(succ->num_) : 1;
+      if (num_column_digits > column_widths[n]) {
+        column_widths[n] = num_column_digits;
       }
     }
     int num_num_acceptances_digits = num_digits(an->accepting_ids_.size());
@@ -949,7 +961,6 @@ void TillyParser::write_output(FILE *fp) {
   fprintf(fp, "};\n\n");
 
   fprintf(fp, "struct automaton_node {\n"
-              "  struct automaton_node *failure_func_;\n"
               "  size_t num_acceptances_;\n"
               "  struct automaton_acceptance *acceptances_;\n"
               "  struct automaton_node *out_[%zu];\n"
@@ -960,13 +971,6 @@ void TillyParser::write_output(FILE *fp) {
     row_num++;
     bool last_row = row_num == num_rows;
 
-    if (an->failure_func_) {
-      fprintf(fp, "nodes_ + %*zu, ", max_num_failure_digits, an->failure_func_->num_);
-    }
-    else {
-      fprintf(fp, "%*s0, ", 9 + max_num_failure_digits - 1, "");
-    }
-    
     fprintf(fp, "%*zu, ", max_num_num_acceptances_digits, an->accepting_ids_.size());
     if (an->accepting_ids_.size()) {
       fprintf(fp, "acceptances_ + %*zu, ", max_num_acceptances_digits, an->acceptance_offset_);
@@ -977,16 +981,12 @@ void TillyParser::write_output(FILE *fp) {
 
     fprintf(fp, "{ ");
     for (size_t n = 0; n < num_transitions; ++n) {
-      bool found_transition = false;
+      AutomatonNode *succ = successors[an->num_][n];
       int max_num_digits = column_widths[n];
-      for (auto *child: an->children_) {
-        if (child->index_ == n) {
-          found_transition = true;
-          fprintf(fp, "nodes_ + %*zu%s", max_num_digits, child->num_, ((n + 1) == column_widths.size()) ? "" : ", ");
-          break;
-        }
+      if (succ) {
+        fprintf(fp, "nodes_ + %*zu%s", max_num_digits, succ->num_, ((n + 1) == column_widths.size()) ? "" : ", ");
       }
-      if (!found_transition) {
+      else {
         fprintf(fp, "0%*s%s", 9 + max_num_digits - 1, "", ((n + 1) == column_widths.size()) ? "" : ", ");
       }
     }
@@ -1033,28 +1033,13 @@ void TillyParser::write_output(FILE *fp) {
 
 
   fprintf(fp, "\n"
+              "/* Failure functions are already folded into out_, so each transition is a single lookup. */\n"
               "struct automaton_node *automaton_node_succ_sym(struct automaton_node *an, size_t sym_index) {\n"
-              "  struct automaton_node *s = an->out_[sym_index];\n"
-              "  while (!s) {\n"
-              "    if (!an->failure_func_) {\n"
-              "      return nodes_->out_[sym_index];\n"
-              "    }\n"
-              "    an = an->failure_func_;\n"
-              "    s = an->out_[sym_index];\n"
-              "  }\n"
-              "  return s;\n"
+              "  return an ? an->out_[sym_index] : NULL;\n"
               "}\n"
               "\n"
               "struct automaton_node *automaton_node_succ_opd(struct automaton_node *an, size_t opd_index) {\n"
-              "  struct automaton_node *s = an->out_[opd_index];\n"
-              "  while (!s) {\n"
-              "    if (!an->failure_func_) {\n"
-              "      return NULL;\n"
-              "    }\n"
-              "    an = an->failure_func_;\n"
-              "    s = an->out_[opd_index];\n"
-              "  }\n"
-              "  return s;\n"
+              "  return an ? an->out_[opd_index] : NULL;\n"
               "}\n"
               "\n"
               "void subject_node_visit(struct subject_node *sn) {\n"
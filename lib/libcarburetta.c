@@ -0,0 +1,269 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STDLIB_H_INCLUDED
+#define STDLIB_H_INCLUDED
+#include <stdlib.h>
+#endif
+
+#ifndef STRING_H_INCLUDED
+#define STRING_H_INCLUDED
+#include <string.h>
+#endif
+
+#ifndef REPORT_ERROR_H_INCLUDED
+#define REPORT_ERROR_H_INCLUDED
+#include "report_error.h"
+#endif
+
+#ifndef LINE_ASSEMBLY_H_INCLUDED
+#define LINE_ASSEMBLY_H_INCLUDED
+#include "line_assembly.h"
+#endif
+
+#ifndef LINE_DEFS_H_INCLUDED
+#define LINE_DEFS_H_INCLUDED
+#include "line_defs.h"
+#endif
+
+#ifndef DECOMMENT_H_INCLUDED
+#define DECOMMENT_H_INCLUDED
+#include "decomment.h"
+#endif
+
+#ifndef TOKENS_H_INCLUDED
+#define TOKENS_H_INCLUDED
+#include "tokens.h"
+#endif
+
+#ifndef PRD_GRAM_H_INCLUDED
+#define PRD_GRAM_H_INCLUDED
+#include "prd_gram.h"
+#endif
+
+#ifndef GRAMMAR_TABLE_H_INCLUDED
+#define GRAMMAR_TABLE_H_INCLUDED
+#include "grammar_table.h"
+#endif
+
+#ifndef LALR_H_INCLUDED
+#define LALR_H_INCLUDED
+#include "lalr.h"
+#endif
+
+#ifndef REX_H_INCLUDED
+#define REX_H_INCLUDED
+#include "rex.h"
+#endif
+
+#ifndef CARBURETTA_CONTEXT_H_INCLUDED
+#define CARBURETTA_CONTEXT_H_INCLUDED
+#include "carburetta_context.h"
+#endif
+
+#ifndef EMIT_C_H_INCLUDED
+#define EMIT_C_H_INCLUDED
+#include "emit_c.h"
+#endif
+
+#ifndef PARSE_INPUT_H_INCLUDED
+#define PARSE_INPUT_H_INCLUDED
+#include "parse_input.h"
+#endif
+
+#ifndef BUILD_TABLES_H_INCLUDED
+#define BUILD_TABLES_H_INCLUDED
+#include "build_tables.h"
+#endif
+
+#ifndef TABLE_IMAGE_H_INCLUDED
+#define TABLE_IMAGE_H_INCLUDED
+#include "table_image.h"
+#endif
+
+#ifndef CBRT_TABLES_H_INCLUDED
+#define CBRT_TABLES_H_INCLUDED
+#include "cbrt_tables.h"
+#endif
+
+#ifndef LIBCARBURETTA_H_INCLUDED
+#define LIBCARBURETTA_H_INCLUDED
+#include "libcarburetta.h"
+#endif
+
+int carb_init(void) {
+  if (ldl_init()) return _CARB_INTERNAL_ERROR;
+  if (tok_init()) return _CARB_INTERNAL_ERROR;
+  if (las_init()) return _CARB_INTERNAL_ERROR;
+  if (dct_init()) return _CARB_INTERNAL_ERROR;
+  return _CARB_OK;
+}
+
+void carb_cleanup(void) {
+  dct_cleanup();
+  las_cleanup();
+  tok_cleanup();
+  ldl_cleanup();
+}
+
+void carb_options_init(struct carb_options *opts) {
+  opts->raw_ = 0;
+  opts->cache_dir_ = NULL;
+}
+
+void carb_result_init(struct carb_result *res) {
+  res->tables_ = NULL;
+  res->tables_size_ = 0;
+  res->num_diagnostics_ = 0;
+  res->diagnostics_ = NULL;
+  res->num_parse_states_ = 0;
+  res->num_productions_ = 0;
+  res->num_syms_ = 0;
+  res->num_scan_states_ = 0;
+  res->num_patterns_ = 0;
+  res->num_modes_ = 0;
+}
+
+void carb_result_cleanup(struct carb_result *res) {
+  size_t n;
+  if (res->tables_) free(res->tables_);
+  for (n = 0; n < res->num_diagnostics_; ++n) {
+    struct carb_diagnostic *d = res->diagnostics_ + n;
+    if (d->filename_) free(d->filename_);
+    if (d->message_) free(d->message_);
+  }
+  if (res->diagnostics_) free(res->diagnostics_);
+  carb_result_init(res);
+}
+
+/* Collects the errors reported while building into the result, in place of stderr */
+struct carb_sink {
+  struct carb_result *res_;
+  size_t num_diagnostics_allocated_;
+  int no_memory_:1;
+};
+
+static void carb_sink_report(void *arg, const char *filename, int line, int col, const char *message) {
+  struct carb_sink *sink = (struct carb_sink *)arg;
+  struct carb_result *res = sink->res_;
+  if (res->num_diagnostics_ == sink->num_diagnostics_allocated_) {
+    size_t new_num_allocated = sink->num_diagnostics_allocated_ * 2 + 4;
+    struct carb_diagnostic *p = (struct carb_diagnostic *)realloc(res->diagnostics_, sizeof(struct carb_diagnostic) * new_num_allocated);
+    if (!p) {
+      sink->no_memory_ = 1;
+      return;
+    }
+    res->diagnostics_ = p;
+    sink->num_diagnostics_allocated_ = new_num_allocated;
+  }
+  struct carb_diagnostic *d = res->diagnostics_ + res->num_diagnostics_;
+  d->filename_ = filename ? strdup(filename) : NULL;
+  d->line_ = line;
+  d->col_ = col;
+  d->message_ = strdup(message);
+  if ((filename && !d->filename_) || !d->message_) {
+    if (d->filename_) free(d->filename_);
+    if (d->message_) free(d->message_);
+    sink->no_memory_ = 1;
+    return;
+  }
+  res->num_diagnostics_++;
+}
+
+int carb_build_tables(const char *grammar, size_t grammar_size, const char *filename, const struct carb_options *opts, struct carb_result *res) {
+  int r;
+  struct carb_options default_opts;
+  if (!opts) {
+    carb_options_init(&default_opts);
+    opts = &default_opts;
+  }
+
+  carb_result_cleanup(res);
+
+  struct carb_sink sink;
+  sink.res_ = res;
+  sink.num_diagnostics_allocated_ = 0;
+  sink.no_memory_ = 0;
+  re_set_thread_sink(carb_sink_report, &sink);
+
+  struct carburetta_context cc;
+  carburetta_context_init(&cc);
+
+  struct prd_grammar prdg;
+  prd_grammar_init(&prdg);
+
+  struct grammar_table gt;
+  gt_grammar_table_init(&gt);
+
+  struct lr_generator lalr;
+  lr_init(&lalr);
+
+  struct rex_scanner rex;
+  rex_init(&rex);
+
+  cc.utf8_experimental_ = !opts->raw_;
+  if (opts->cache_dir_) {
+    cc.cache_dir_ = strdup(opts->cache_dir_);
+    if (!cc.cache_dir_) {
+      r = _CARB_NO_MEMORY;
+      goto cleanup_exit;
+    }
+  }
+
+  if (pi_parse_input_buffer(grammar, grammar_size, filename ? filename : "(grammar)", &cc, &prdg) ||
+      bt_build_tables(&cc, &prdg, &gt, &rex, &lalr)) {
+    r = _CARB_GRAMMAR_ERROR;
+    goto cleanup_exit;
+  }
+
+  if (cc.utf8_experimental_ && prdg.num_patterns_ && !cc.utf8_decoder_table_) {
+    if (emit_utf8_decoder_table(&rex.dfa_, &cc.utf8_decoder_num_rows_, &cc.utf8_decoder_table_)) {
+      r = _CARB_NO_MEMORY;
+      goto cleanup_exit;
+    }
+  }
+
+  if (ti_make_tables(&cc, &prdg, &rex, &lalr, &res->tables_, &res->tables_size_)) {
+    r = _CARB_NO_MEMORY;
+    goto cleanup_exit;
+  }
+
+  const struct cbrt_tables_header *header = (const struct cbrt_tables_header *)res->tables_;
+  res->num_parse_states_ = header->num_parse_states_;
+  res->num_productions_ = header->num_productions_ - 1 /* synthetic root production */;
+  res->num_syms_ = header->num_syms_;
+  res->num_scan_states_ = header->num_scan_states_;
+  res->num_patterns_ = header->num_patterns_;
+  res->num_modes_ = header->num_modes_;
+
+  r = _CARB_OK;
+cleanup_exit:
+  lr_cleanup(&lalr);
+
+  rex_cleanup(&rex);
+
+  gt_grammar_table_cleanup(&gt);
+
+  prd_grammar_cleanup(&prdg);
+
+  carburetta_context_cleanup(&cc);
+
+  re_set_thread_sink(NULL, NULL);
+
+  /* Diagnostics went missing */
+  if (r && sink.no_memory_) r = _CARB_NO_MEMORY;
+
+  return r;
+}
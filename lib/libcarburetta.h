@@ -0,0 +1,101 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBCARBURETTA_H
+#define LIBCARBURETTA_H
+
+/* libcarburetta runs carburetta in-process: it builds the tables for a grammar held in memory
+ * and returns them as a tables image (see runtime/cbrt_tables.h) together with the errors found,
+ * without writing any files or spawning a process. The image can be handed straight to
+ * cbrt_tables_from_memory(), the generic driver is part of the library, so a program can go from
+ * grammar text to parsing input without a build step in between.
+ *
+ * Grammars may be built concurrently on any number of threads; each build has its own state and
+ * collects its own diagnostics. */
+
+#ifndef STDDEF_H_INCLUDED
+#define STDDEF_H_INCLUDED
+#include <stddef.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Return codes */
+#define _CARB_OK 0
+#define _CARB_GRAMMAR_ERROR 1     /* The grammar has errors, see the diagnostics */
+#define _CARB_NO_MEMORY 2
+#define _CARB_INTERNAL_ERROR 3
+
+/* An error, as carburetta would report it on the command line */
+struct carb_diagnostic {
+  /* Location of the error; filename_ is NULL if the error has no location, line_ and col_ are 0
+   * if unknown. */
+  char *filename_;
+  int line_, col_;
+
+  char *message_;
+};
+
+struct carb_options {
+  /* Set to scan input as raw bytes rather than as UTF-8 (as --x-raw) */
+  int raw_;
+
+  /* Directory of the table cache (as --cache-dir), or NULL to build all tables anew */
+  const char *cache_dir_;
+};
+
+struct carb_result {
+  /* Tables image, allocated with malloc(), NULL if the build failed */
+  void *tables_;
+  size_t tables_size_;
+
+  size_t num_diagnostics_;
+  struct carb_diagnostic *diagnostics_;
+
+  /* Sizes of the tables built. num_productions_ and num_patterns_ count those in the grammar,
+   * num_syms_ includes the error and input end symbols, num_scan_states_ the states of all
+   * modes together. */
+  size_t num_parse_states_;
+  size_t num_productions_;
+  size_t num_syms_;
+  size_t num_scan_states_;
+  size_t num_patterns_;
+  size_t num_modes_;
+};
+
+/* Initializes the scanners carburetta uses to read grammars. Call once, before any other call,
+ * and not concurrently with anything else; returns _CARB_OK upon success. */
+int carb_init(void);
+void carb_cleanup(void);
+
+void carb_options_init(struct carb_options *opts);
+
+void carb_result_init(struct carb_result *res);
+void carb_result_cleanup(struct carb_result *res);
+
+/* Builds the tables for the grammar_size bytes of grammar, in the format of a .cbrt file; the
+ * filename is only used in diagnostics (and may be NULL.) opts may be NULL for the defaults. res
+ * must be initialized, whatever it held is released first. Returns _CARB_OK with the tables in
+ * res, or an error, in which case res->diagnostics_ holds what was found. Action code in the
+ * grammar is parsed but otherwise ignored, see struct cbrt_callbacks. */
+int carb_build_tables(const char *grammar, size_t grammar_size, const char *filename, const struct carb_options *opts, struct carb_result *res);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* LIBCARBURETTA_H */
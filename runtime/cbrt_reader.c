@@ -0,0 +1,278 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STDLIB_H_INCLUDED
+#define STDLIB_H_INCLUDED
+#include <stdlib.h>
+#endif
+
+#ifndef LIMITS_H_INCLUDED
+#define LIMITS_H_INCLUDED
+#include <limits.h>
+#endif
+
+#ifndef ERRNO_H_INCLUDED
+#define ERRNO_H_INCLUDED
+#include <errno.h>
+#endif
+
+#ifdef _WIN32
+#ifndef WINDOWS_H_INCLUDED
+#define WINDOWS_H_INCLUDED
+#include <Windows.h>
+#endif
+
+#ifndef IO_H_INCLUDED
+#define IO_H_INCLUDED
+#include <io.h>
+#endif
+#else
+#ifndef PTHREAD_H_INCLUDED
+#define PTHREAD_H_INCLUDED
+#include <pthread.h>
+#endif
+
+#ifndef UNISTD_H_INCLUDED
+#define UNISTD_H_INCLUDED
+#include <unistd.h>
+#endif
+#endif
+
+#ifndef CBRT_READER_H_INCLUDED
+#define CBRT_READER_H_INCLUDED
+#include "cbrt_reader.h"
+#endif
+
+/* What a buffer holds once filled */
+#define CBRT_READER_DATA 0
+#define CBRT_READER_END 1
+#define CBRT_READER_ERROR 2
+
+struct cbrt_reader_buffer {
+  char *data_;
+  size_t size_;
+  int status_;
+};
+
+struct cbrt_reader {
+  int fd_;
+  size_t buffer_size_;
+  size_t num_buffers_;
+  struct cbrt_reader_buffer *buffers_;
+  char *memory_;
+
+  /* The thread fills buffers_[fill_] and the buffers after it, the caller takes buffers_[take_];
+   * num_ready_ are filled and not yet taken, held_ is set while the caller holds the buffer before
+   * buffers_[take_]. All under lock_. */
+  size_t fill_;
+  size_t take_;
+  size_t num_ready_;
+  int held_;
+  int stop_;
+
+  /* Last buffer returned, returned again once the input ended or failed */
+  struct cbrt_reader_buffer *last_;
+
+#ifdef _WIN32
+  CRITICAL_SECTION lock_;
+  CONDITION_VARIABLE ready_;    /* a buffer was filled */
+  CONDITION_VARIABLE space_;    /* a buffer was handed back, or the thread is to stop */
+  HANDLE thread_;
+#else
+  pthread_mutex_t lock_;
+  pthread_cond_t ready_;
+  pthread_cond_t space_;
+  pthread_t thread_;
+#endif
+};
+
+static void cbrt_reader_lock(struct cbrt_reader *rd) {
+#ifdef _WIN32
+  EnterCriticalSection(&rd->lock_);
+#else
+  pthread_mutex_lock(&rd->lock_);
+#endif
+}
+
+static void cbrt_reader_unlock(struct cbrt_reader *rd) {
+#ifdef _WIN32
+  LeaveCriticalSection(&rd->lock_);
+#else
+  pthread_mutex_unlock(&rd->lock_);
+#endif
+}
+
+#ifdef _WIN32
+#define cbrt_reader_wait(rd, cond) SleepConditionVariableCS(&(rd)->cond, &(rd)->lock_, INFINITE)
+#define cbrt_reader_signal(rd, cond) WakeConditionVariable(&(rd)->cond)
+#else
+#define cbrt_reader_wait(rd, cond) pthread_cond_wait(&(rd)->cond, &(rd)->lock_)
+#define cbrt_reader_signal(rd, cond) pthread_cond_signal(&(rd)->cond)
+#endif
+
+/* Reads once into buf, as much as is available up to its size; returns the status of buf */
+static int cbrt_reader_fill(struct cbrt_reader *rd, struct cbrt_reader_buffer *buf) {
+  for (;;) {
+#ifdef _WIN32
+    int r = _read(rd->fd_, buf->data_, (unsigned int)rd->buffer_size_);
+#else
+    ssize_t r = read(rd->fd_, buf->data_, rd->buffer_size_);
+#endif
+    if (r > 0) {
+      buf->size_ = (size_t)r;
+      return CBRT_READER_DATA;
+    }
+    buf->size_ = 0;
+    if (!r) return CBRT_READER_END;
+    if (errno != EINTR) return CBRT_READER_ERROR;
+  }
+}
+
+static void cbrt_reader_work(struct cbrt_reader *rd) {
+  int status;
+  do {
+    cbrt_reader_lock(rd);
+    while (!rd->stop_ && ((rd->num_ready_ + (size_t)rd->held_) == rd->num_buffers_)) {
+      cbrt_reader_wait(rd, space_);
+    }
+    if (rd->stop_) {
+      cbrt_reader_unlock(rd);
+      return;
+    }
+    struct cbrt_reader_buffer *buf = rd->buffers_ + rd->fill_;
+    cbrt_reader_unlock(rd);
+
+    /* The buffer is the thread's until it is counted as ready */
+    status = buf->status_ = cbrt_reader_fill(rd, buf);
+
+    cbrt_reader_lock(rd);
+    rd->fill_ = (rd->fill_ + 1) % rd->num_buffers_;
+    rd->num_ready_++;
+    cbrt_reader_signal(rd, ready_);
+    cbrt_reader_unlock(rd);
+  } while (status == CBRT_READER_DATA);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI cbrt_reader_thread(LPVOID arg) {
+  cbrt_reader_work((struct cbrt_reader *)arg);
+  return 0;
+}
+#else
+static void *cbrt_reader_thread(void *arg) {
+  cbrt_reader_work((struct cbrt_reader *)arg);
+  return NULL;
+}
+#endif
+
+int cbrt_reader_open_fd(int fd, size_t buffer_size, size_t num_buffers, struct cbrt_reader **preader) {
+  size_t n;
+  if (!buffer_size) buffer_size = CBRT_READER_DEFAULT_BUFFER_SIZE;
+  if (!num_buffers) num_buffers = CBRT_READER_DEFAULT_NUM_BUFFERS;
+  if (num_buffers < 2) num_buffers = 2;
+  if (buffer_size > INT_MAX) buffer_size = INT_MAX;
+  if (buffer_size > (((size_t)-1) / num_buffers)) return _CBRT_NO_MEMORY;
+
+  struct cbrt_reader *rd = (struct cbrt_reader *)calloc(1, sizeof(struct cbrt_reader));
+  if (!rd) return _CBRT_NO_MEMORY;
+  rd->fd_ = fd;
+  rd->buffer_size_ = buffer_size;
+  rd->num_buffers_ = num_buffers;
+  rd->buffers_ = (struct cbrt_reader_buffer *)calloc(num_buffers, sizeof(struct cbrt_reader_buffer));
+  rd->memory_ = (char *)malloc(buffer_size * num_buffers);
+  if (!rd->buffers_ || !rd->memory_) {
+    free(rd->buffers_);
+    free(rd->memory_);
+    free(rd);
+    return _CBRT_NO_MEMORY;
+  }
+  for (n = 0; n < num_buffers; ++n) {
+    rd->buffers_[n].data_ = rd->memory_ + n * buffer_size;
+  }
+
+  int started;
+#ifdef _WIN32
+  InitializeCriticalSection(&rd->lock_);
+  InitializeConditionVariable(&rd->ready_);
+  InitializeConditionVariable(&rd->space_);
+  rd->thread_ = CreateThread(NULL, 0, cbrt_reader_thread, rd, 0, NULL);
+  started = !!rd->thread_;
+  if (!started) DeleteCriticalSection(&rd->lock_);
+#else
+  pthread_mutex_init(&rd->lock_, NULL);
+  pthread_cond_init(&rd->ready_, NULL);
+  pthread_cond_init(&rd->space_, NULL);
+  started = !pthread_create(&rd->thread_, NULL, cbrt_reader_thread, rd);
+  if (!started) {
+    pthread_cond_destroy(&rd->space_);
+    pthread_cond_destroy(&rd->ready_);
+    pthread_mutex_destroy(&rd->lock_);
+  }
+#endif
+  if (!started) {
+    free(rd->buffers_);
+    free(rd->memory_);
+    free(rd);
+    return _CBRT_INTERNAL_ERROR;
+  }
+
+  *preader = rd;
+  return _CBRT_OK;
+}
+
+int cbrt_reader_next(struct cbrt_reader *rd, const char **pdata, size_t *psize, int *pis_final) {
+  struct cbrt_reader_buffer *buf = rd->last_;
+  if (!buf || (buf->status_ == CBRT_READER_DATA)) {
+    cbrt_reader_lock(rd);
+    if (rd->held_) {
+      rd->held_ = 0;
+      cbrt_reader_signal(rd, space_);
+    }
+    while (!rd->num_ready_) {
+      cbrt_reader_wait(rd, ready_);
+    }
+    buf = rd->last_ = rd->buffers_ + rd->take_;
+    rd->take_ = (rd->take_ + 1) % rd->num_buffers_;
+    rd->num_ready_--;
+    rd->held_ = 1;
+    cbrt_reader_unlock(rd);
+  }
+
+  *pdata = buf->data_;
+  *psize = buf->size_;
+  *pis_final = buf->status_ != CBRT_READER_DATA;
+  return (buf->status_ == CBRT_READER_ERROR) ? _CBRT_IO_ERROR : _CBRT_OK;
+}
+
+void cbrt_reader_close(struct cbrt_reader *rd) {
+  if (!rd) return;
+  cbrt_reader_lock(rd);
+  rd->stop_ = 1;
+  cbrt_reader_signal(rd, space_);
+  cbrt_reader_unlock(rd);
+#ifdef _WIN32
+  WaitForSingleObject(rd->thread_, INFINITE);
+  CloseHandle(rd->thread_);
+  DeleteCriticalSection(&rd->lock_);
+#else
+  pthread_join(rd->thread_, NULL);
+  pthread_cond_destroy(&rd->space_);
+  pthread_cond_destroy(&rd->ready_);
+  pthread_mutex_destroy(&rd->lock_);
+#endif
+  free(rd->buffers_);
+  free(rd->memory_);
+  free(rd);
+}
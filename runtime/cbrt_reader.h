@@ -0,0 +1,82 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CBRT_READER_H
+#define CBRT_READER_H
+
+/* Background reader for feeding a generated scanner from a file descriptor (a file, a pipe, a
+ * socket.) A thread reads ahead into a ring of buffers while the scanner works through the buffer
+ * it was handed, so reading and scanning overlap rather than take turns. A program links
+ * cbrt_reader.c (which depends only on the return codes in cbrt_tables.h, and on pthreads outside
+ * Windows) and feeds the scanner with:
+ *
+ *   struct cbrt_reader *reader;
+ *   const char *data;
+ *   size_t size;
+ *   int is_final;
+ *   r = cbrt_reader_open_fd(fd, 0, 0, &reader);
+ *   while (!r && !(r = cbrt_reader_next(reader, &data, &size, &is_final))) {
+ *     prefix_set_input(&stack, data, size, is_final);
+ *     r = prefix_scan(&stack);
+ *     if (r != _PREFIX_FEED_ME) break;
+ *     r = 0;
+ *   }
+ *   cbrt_reader_close(reader);
+ *
+ * A buffer goes back to the reading thread on the next call to cbrt_reader_next(), which is only
+ * to be made once the scanner returned _PREFIX_FEED_ME: by then it has copied the part of a token
+ * that runs up to the end of the buffer to its match buffer, and no longer refers to the buffer.
+ * The buffers are read-only, use <prefix>set_input(), not <prefix>set_input_in_place(). */
+
+#ifndef STDDEF_H_INCLUDED
+#define STDDEF_H_INCLUDED
+#include <stddef.h>
+#endif
+
+#ifndef CBRT_TABLES_H_INCLUDED
+#define CBRT_TABLES_H_INCLUDED
+#include "cbrt_tables.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CBRT_READER_DEFAULT_BUFFER_SIZE (256 * 1024)
+#define CBRT_READER_DEFAULT_NUM_BUFFERS 3
+
+struct cbrt_reader;
+
+/* Starts a thread reading fd into num_buffers buffers of buffer_size bytes each; 0 for either
+ * picks the default, at least 2 buffers are used. The reader does not close fd. Returns _CBRT_OK
+ * and the reader in *preader, or _CBRT_NO_MEMORY or _CBRT_INTERNAL_ERROR if no thread could be
+ * started. */
+int cbrt_reader_open_fd(int fd, size_t buffer_size, size_t num_buffers, struct cbrt_reader **preader);
+
+/* Hands the buffer returned by the previous call back to the reading thread, then waits for the
+ * next buffer, and returns _CBRT_OK with its data and size; *pis_final is set on the last buffer,
+ * which holds no data but marks the end of the input. Further calls return the last buffer again.
+ * Returns _CBRT_IO_ERROR if reading failed, the input up to the failure has been returned. */
+int cbrt_reader_next(struct cbrt_reader *reader, const char **pdata, size_t *psize, int *pis_final);
+
+/* Stops the reading thread and frees the reader; if the thread is blocked reading, waits for the
+ * read to return. reader may be NULL. */
+void cbrt_reader_close(struct cbrt_reader *reader);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* CBRT_READER_H */
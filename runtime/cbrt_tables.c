@@ -0,0 +1,679 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STDLIB_H_INCLUDED
+#define STDLIB_H_INCLUDED
+#include <stdlib.h>
+#endif
+
+#ifndef STRING_H_INCLUDED
+#define STRING_H_INCLUDED
+#include <string.h>
+#endif
+
+#ifdef _WIN32
+#ifndef WINDOWS_H_INCLUDED
+#define WINDOWS_H_INCLUDED
+#include <Windows.h>
+#endif
+#else
+#ifndef SYS_MMAN_H_INCLUDED
+#define SYS_MMAN_H_INCLUDED
+#include <sys/mman.h>
+#endif
+
+#ifndef SYS_STAT_H_INCLUDED
+#define SYS_STAT_H_INCLUDED
+#include <sys/stat.h>
+#endif
+
+#ifndef FCNTL_H_INCLUDED
+#define FCNTL_H_INCLUDED
+#include <fcntl.h>
+#endif
+
+#ifndef UNISTD_H_INCLUDED
+#define UNISTD_H_INCLUDED
+#include <unistd.h>
+#endif
+#endif
+
+#ifndef CBRT_TABLES_H_INCLUDED
+#define CBRT_TABLES_H_INCLUDED
+#include "cbrt_tables.h"
+#endif
+
+/* Anchor columns, after the symbol group (or byte) columns of the scan table */
+#define CBRT_ANCHOR_START_OF_INPUT 4
+#define CBRT_ANCHOR_START_OF_LINE 3
+#define CBRT_ANCHOR_END_OF_LINE 2
+#define CBRT_ANCHOR_END_OF_INPUT 1
+
+/* Values are aligned to this many bytes */
+#define CBRT_VALUE_ALIGNMENT 16
+
+struct cbrt_tables {
+  const unsigned char *image_;
+  size_t image_size_;
+  const struct cbrt_tables_header *header_;
+
+  const int32_t *scan_table_;
+  const uint32_t *scan_actions_;
+  const int32_t *utf8_decoder_;
+  const int32_t *pattern_syms_;
+  const uint32_t *mode_start_states_;
+  const uint32_t *mode_names_;
+  const int32_t *parse_table_;
+  const uint32_t *production_lengths_;
+  const int32_t *production_syms_;
+  const uint32_t *sym_names_;
+  const char *strings_;
+
+  /* Set if image_ was mapped by cbrt_tables_open() and is to be unmapped upon close */
+  int is_mapped_;
+#ifdef _WIN32
+  HANDLE file_;
+  HANDLE mapping_;
+#endif
+};
+
+/* Returns a pointer to the section of num_elements of element_size bytes at offset, or NULL if
+ * it does not lie entirely within the image. */
+static const void *cbrt_section(const struct cbrt_tables *t, uint32_t offset, uint64_t num_elements, size_t element_size) {
+  uint64_t size = num_elements * (uint64_t)element_size;
+  if (num_elements && (size / num_elements != element_size)) return NULL;
+  if (offset % sizeof(uint32_t)) return NULL;
+  if ((uint64_t)offset > t->header_->image_size_) return NULL;
+  if (size > ((uint64_t)t->header_->image_size_ - offset)) return NULL;
+  return t->image_ + offset;
+}
+
+static int cbrt_is_string(const struct cbrt_tables *t, uint32_t offset) {
+  return offset < t->header_->strings_size_;
+}
+
+/* Checks the image and every entry in its tables, so the driver can index the tables without
+ * further checks. Returns _CBRT_OK or _CBRT_INVALID_TABLES. */
+static int cbrt_validate(struct cbrt_tables *t) {
+  const struct cbrt_tables_header *h;
+  uint64_t n;
+  if (t->image_size_ < sizeof(struct cbrt_tables_header)) return _CBRT_INVALID_TABLES;
+  h = t->header_ = (const struct cbrt_tables_header *)t->image_;
+  if (memcmp(h->magic_, CBRT_TABLES_MAGIC, sizeof(h->magic_))) return _CBRT_INVALID_TABLES;
+  if ((h->version_ != CBRT_TABLES_VERSION) || (h->byte_order_ != CBRT_TABLES_BYTE_ORDER)) return _CBRT_INVALID_TABLES;
+  if (h->image_size_ > t->image_size_) return _CBRT_INVALID_TABLES;
+
+  uint64_t num_scan_cells = (uint64_t)h->num_scan_states_ * h->num_scan_columns_;
+  uint64_t num_parse_cells = (uint64_t)h->num_parse_states_ * h->num_parse_columns_;
+  t->scan_table_ = (const int32_t *)cbrt_section(t, h->scan_table_, num_scan_cells, sizeof(int32_t));
+  t->scan_actions_ = (const uint32_t *)cbrt_section(t, h->scan_actions_, h->num_scan_states_, sizeof(uint32_t));
+  t->utf8_decoder_ = (const int32_t *)cbrt_section(t, h->utf8_decoder_, (uint64_t)h->num_utf8_decoder_rows_ * 256, sizeof(int32_t));
+  t->pattern_syms_ = (const int32_t *)cbrt_section(t, h->pattern_syms_, h->num_patterns_, sizeof(int32_t));
+  t->mode_start_states_ = (const uint32_t *)cbrt_section(t, h->mode_start_states_, h->num_modes_, sizeof(uint32_t));
+  t->mode_names_ = (const uint32_t *)cbrt_section(t, h->mode_names_, h->num_modes_, sizeof(uint32_t));
+  t->parse_table_ = (const int32_t *)cbrt_section(t, h->parse_table_, num_parse_cells, sizeof(int32_t));
+  t->production_lengths_ = (const uint32_t *)cbrt_section(t, h->production_lengths_, h->num_productions_, sizeof(uint32_t));
+  t->production_syms_ = (const int32_t *)cbrt_section(t, h->production_syms_, h->num_productions_, sizeof(int32_t));
+  t->sym_names_ = (const uint32_t *)cbrt_section(t, h->sym_names_, h->num_syms_, sizeof(uint32_t));
+  t->strings_ = (const char *)cbrt_section(t, h->strings_, h->strings_size_, 1);
+  if (!t->scan_table_ || !t->scan_actions_ || !t->utf8_decoder_ || !t->pattern_syms_ || !t->mode_start_states_ ||
+      !t->mode_names_ || !t->parse_table_ || !t->production_lengths_ || !t->production_syms_ || !t->sym_names_ || !t->strings_) {
+    return _CBRT_INVALID_TABLES;
+  }
+  if (!h->strings_size_ || t->strings_[h->strings_size_ - 1]) return _CBRT_INVALID_TABLES;
+
+  /* Scanner */
+  if (h->num_scan_states_) {
+    if (h->num_scan_columns_ <= 4) return _CBRT_INVALID_TABLES;
+    if (h->flags_ & CBRT_TABLES_UTF8) {
+      if (!h->num_utf8_decoder_rows_) return _CBRT_INVALID_TABLES;
+    }
+    else if (h->num_scan_columns_ != 256 + 4) {
+      return _CBRT_INVALID_TABLES;
+    }
+    if (!h->num_modes_ || (h->default_mode_ >= h->num_modes_)) return _CBRT_INVALID_TABLES;
+  }
+  for (n = 0; n < num_scan_cells; ++n) {
+    if ((t->scan_table_[n] < 0) || ((uint32_t)t->scan_table_[n] >= h->num_scan_states_)) return _CBRT_INVALID_TABLES;
+  }
+  for (n = 0; n < h->num_scan_states_; ++n) {
+    if (t->scan_actions_[n] > h->num_patterns_) return _CBRT_INVALID_TABLES;
+  }
+  for (n = 0; n < (uint64_t)h->num_utf8_decoder_rows_ * 256; ++n) {
+    int32_t next = t->utf8_decoder_[n];
+    if (next >= 0) {
+      /* Complete codepoint, in symbol group next */
+      if ((uint32_t)next >= h->num_scan_columns_ - 4) return _CBRT_INVALID_TABLES;
+    }
+    else if (next != -1) {
+      /* Partial codepoint, continue decoding in row ~next */
+      if ((uint32_t)~next >= h->num_utf8_decoder_rows_) return _CBRT_INVALID_TABLES;
+    }
+  }
+  for (n = 0; n < h->num_patterns_; ++n) {
+    int32_t sym = t->pattern_syms_[n];
+    if ((sym != -1) && ((sym < h->min_sym_) || ((uint64_t)(sym - h->min_sym_) >= h->num_parse_columns_))) return _CBRT_INVALID_TABLES;
+  }
+  for (n = 0; n < h->num_modes_; ++n) {
+    if (t->mode_start_states_[n] >= h->num_scan_states_) return _CBRT_INVALID_TABLES;
+    if (!cbrt_is_string(t, t->mode_names_[n])) return _CBRT_INVALID_TABLES;
+  }
+
+  /* Parser */
+  if (!h->num_parse_states_ || !h->num_productions_) return _CBRT_INVALID_TABLES;
+  if ((h->input_end_sym_ < h->min_sym_) || ((uint64_t)(h->input_end_sym_ - h->min_sym_) >= h->num_parse_columns_)) return _CBRT_INVALID_TABLES;
+  for (n = 0; n < num_parse_cells; ++n) {
+    int32_t action = t->parse_table_[n];
+    if ((action > 0) && ((uint32_t)action >= h->num_parse_states_)) return _CBRT_INVALID_TABLES;
+    if ((action < 0) && ((uint32_t)(-(action + 1)) >= h->num_productions_)) return _CBRT_INVALID_TABLES;
+  }
+  for (n = 0; n < h->num_productions_; ++n) {
+    int32_t sym = t->production_syms_[n];
+    if ((sym < h->min_sym_) || ((uint64_t)(sym - h->min_sym_) >= h->num_parse_columns_)) return _CBRT_INVALID_TABLES;
+  }
+  for (n = 0; n < h->num_syms_; ++n) {
+    if (!cbrt_is_string(t, t->sym_names_[n])) return _CBRT_INVALID_TABLES;
+  }
+
+  return _CBRT_OK;
+}
+
+int cbrt_tables_from_memory(const void *image, size_t image_size, struct cbrt_tables **ptables) {
+  struct cbrt_tables *t = (struct cbrt_tables *)calloc(1, sizeof(struct cbrt_tables));
+  if (!t) return _CBRT_NO_MEMORY;
+  t->image_ = (const unsigned char *)image;
+  t->image_size_ = image_size;
+  if (((uintptr_t)image % 8) || cbrt_validate(t)) {
+    free(t);
+    return _CBRT_INVALID_TABLES;
+  }
+  *ptables = t;
+  return _CBRT_OK;
+}
+
+int cbrt_tables_open(const char *filename, struct cbrt_tables **ptables) {
+  int r;
+  const void *image;
+  size_t image_size;
+#ifdef _WIN32
+  HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) return _CBRT_IO_ERROR;
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    return _CBRT_IO_ERROR;
+  }
+  if (!file_size.QuadPart || (file_size.QuadPart > 0xFFFFFFFF)) {
+    CloseHandle(file);
+    return _CBRT_INVALID_TABLES;
+  }
+  image_size = (size_t)file_size.QuadPart;
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mapping) {
+    CloseHandle(file);
+    return _CBRT_IO_ERROR;
+  }
+  image = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!image) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return _CBRT_IO_ERROR;
+  }
+  r = cbrt_tables_from_memory(image, image_size, ptables);
+  if (r) {
+    UnmapViewOfFile(image);
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return r;
+  }
+  (*ptables)->file_ = file;
+  (*ptables)->mapping_ = mapping;
+#else
+  struct stat st;
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) return _CBRT_IO_ERROR;
+  if (fstat(fd, &st)) {
+    close(fd);
+    return _CBRT_IO_ERROR;
+  }
+  if ((st.st_size <= 0) || ((uint64_t)st.st_size > 0xFFFFFFFF)) {
+    close(fd);
+    return _CBRT_INVALID_TABLES;
+  }
+  image_size = (size_t)st.st_size;
+  image = mmap(NULL, image_size, PROT_READ, MAP_SHARED, fd, 0);
+  /* The mapping keeps the file open */
+  close(fd);
+  if (image == MAP_FAILED) return _CBRT_IO_ERROR;
+  r = cbrt_tables_from_memory(image, image_size, ptables);
+  if (r) {
+    munmap((void *)image, image_size);
+    return r;
+  }
+#endif
+  (*ptables)->is_mapped_ = 1;
+  return _CBRT_OK;
+}
+
+void cbrt_tables_close(struct cbrt_tables *tables) {
+  if (!tables) return;
+  if (tables->is_mapped_) {
+#ifdef _WIN32
+    UnmapViewOfFile(tables->image_);
+    CloseHandle(tables->mapping_);
+    CloseHandle(tables->file_);
+#else
+    munmap((void *)tables->image_, tables->image_size_);
+#endif
+  }
+  free(tables);
+}
+
+int cbrt_tables_find_sym(const struct cbrt_tables *tables, const char *name) {
+  uint32_t n;
+  if (!*name) return -1;
+  for (n = 0; n < tables->header_->num_syms_; ++n) {
+    if (!strcmp(tables->strings_ + tables->sym_names_[n], name)) return (int)n;
+  }
+  return -1;
+}
+
+int cbrt_tables_find_mode(const struct cbrt_tables *tables, const char *name) {
+  uint32_t n;
+  for (n = 0; n < tables->header_->num_modes_; ++n) {
+    if (!strcmp(tables->strings_ + tables->mode_names_[n], name)) return (int)n;
+  }
+  return -1;
+}
+
+const char *cbrt_tables_sym_name(const struct cbrt_tables *tables, int sym) {
+  if ((sym < 0) || ((uint32_t)sym >= tables->header_->num_syms_)) return NULL;
+  if (!tables->sym_names_[sym]) return NULL;
+  return tables->strings_ + tables->sym_names_[sym];
+}
+
+int cbrt_tables_input_end_sym(const struct cbrt_tables *tables) {
+  return tables->header_->input_end_sym_;
+}
+
+void cbrt_parser_init(struct cbrt_parser *parser, const struct cbrt_tables *tables, size_t value_size, const struct cbrt_callbacks *callbacks, void *arg) {
+  static const struct cbrt_callbacks no_callbacks = { NULL, NULL, NULL };
+  parser->tables_ = tables;
+  parser->callbacks_ = callbacks ? callbacks : &no_callbacks;
+  parser->arg_ = arg;
+  if (!value_size) value_size = 1;
+  parser->value_size_ = value_size;
+  parser->value_stride_ = (value_size + CBRT_VALUE_ALIGNMENT - 1) & ~(size_t)(CBRT_VALUE_ALIGNMENT - 1);
+  parser->pos_ = 0;
+  parser->num_allocated_ = 0;
+  parser->states_ = NULL;
+  parser->syms_ = NULL;
+  parser->values_ = NULL;
+  parser->token_value_ = NULL;
+  parser->result_value_ = NULL;
+  parser->finished_ = 0;
+  parser->mode_ = tables->header_->default_mode_;
+  parser->token_offset_ = parser->offset_ = 0;
+  parser->token_line_ = parser->line_ = 1;
+  parser->token_col_ = parser->col_ = 1;
+}
+
+/* Discards the values on the stack, leaving only the initial state */
+static void cbrt_discard_stack(struct cbrt_parser *parser) {
+  while (parser->pos_ > 1) {
+    parser->pos_--;
+    if (parser->callbacks_->discard_) {
+      parser->callbacks_->discard_(parser->arg_, parser->syms_[parser->pos_], parser->values_ + parser->pos_ * parser->value_stride_);
+    }
+  }
+}
+
+void cbrt_parser_cleanup(struct cbrt_parser *parser) {
+  cbrt_discard_stack(parser);
+  if (parser->states_) free(parser->states_);
+  if (parser->syms_) free(parser->syms_);
+  if (parser->values_) free(parser->values_);
+  if (parser->token_value_) free(parser->token_value_);
+  parser->states_ = NULL;
+  parser->syms_ = NULL;
+  parser->values_ = NULL;
+  parser->token_value_ = parser->result_value_ = NULL;
+  parser->pos_ = parser->num_allocated_ = 0;
+}
+
+void cbrt_parser_reset(struct cbrt_parser *parser) {
+  cbrt_discard_stack(parser);
+  parser->pos_ = 0;
+  parser->finished_ = 0;
+  parser->token_offset_ = parser->offset_ = 0;
+  parser->token_line_ = parser->line_ = 1;
+  parser->token_col_ = parser->col_ = 1;
+}
+
+int cbrt_set_mode(struct cbrt_parser *parser, int mode) {
+  if ((mode < 0) || ((uint32_t)mode >= parser->tables_->header_->num_modes_)) return _CBRT_INVALID_ARGUMENT;
+  parser->mode_ = (uint32_t)mode;
+  return _CBRT_OK;
+}
+
+int cbrt_mode(const struct cbrt_parser *parser) {
+  return (int)parser->mode_;
+}
+
+void *cbrt_value(const struct cbrt_parser *parser, void *values, size_t n) {
+  return (unsigned char *)values + n * parser->value_stride_;
+}
+
+void *cbrt_result(struct cbrt_parser *parser) {
+  return parser->finished_ ? parser->result_value_ : NULL;
+}
+
+/* Ensures there is room for one more entry on the stack, pushing the initial state if the stack
+ * is empty. Returns _CBRT_OK or _CBRT_NO_MEMORY. */
+static int cbrt_reserve(struct cbrt_parser *parser) {
+  if (!parser->token_value_) {
+    /* Scratch for the token and the result, allocated together */
+    parser->token_value_ = (unsigned char *)malloc(2 * parser->value_stride_);
+    if (!parser->token_value_) return _CBRT_NO_MEMORY;
+    parser->result_value_ = parser->token_value_ + parser->value_stride_;
+  }
+  if (parser->pos_ == parser->num_allocated_) {
+    size_t new_num_allocated = parser->num_allocated_ * 2 + 16;
+    int *states = (int *)realloc(parser->states_, new_num_allocated * sizeof(int));
+    if (!states) return _CBRT_NO_MEMORY;
+    parser->states_ = states;
+    int *syms = (int *)realloc(parser->syms_, new_num_allocated * sizeof(int));
+    if (!syms) return _CBRT_NO_MEMORY;
+    parser->syms_ = syms;
+    unsigned char *values = (unsigned char *)realloc(parser->values_, new_num_allocated * parser->value_stride_);
+    if (!values) return _CBRT_NO_MEMORY;
+    parser->values_ = values;
+    parser->num_allocated_ = new_num_allocated;
+  }
+  if (!parser->pos_) {
+    parser->states_[0] = 0;
+    parser->syms_[0] = -1;
+    parser->pos_ = 1;
+  }
+  return _CBRT_OK;
+}
+
+static void cbrt_push(struct cbrt_parser *parser, int state, int sym, const unsigned char *value) {
+  parser->states_[parser->pos_] = state;
+  parser->syms_[parser->pos_] = sym;
+  memcpy(parser->values_ + parser->pos_ * parser->value_stride_, value, parser->value_stride_);
+  parser->pos_++;
+}
+
+/* Discards the value of the token that could not be shifted; the input end symbol has none */
+static void cbrt_discard_token(struct cbrt_parser *parser, int sym) {
+  if (parser->callbacks_->discard_ && (sym != parser->tables_->header_->input_end_sym_)) {
+    parser->callbacks_->discard_(parser->arg_, sym, parser->token_value_);
+  }
+}
+
+/* Parses sym with its value in parser->token_value_ */
+static int cbrt_parse_token(struct cbrt_parser *parser, int sym) {
+  const struct cbrt_tables *t = parser->tables_;
+  const struct cbrt_tables_header *h = t->header_;
+  int r;
+  if (parser->finished_) cbrt_parser_reset(parser);
+  if ((sym < h->min_sym_) || ((uint32_t)(sym - h->min_sym_) >= h->num_parse_columns_)) {
+    cbrt_discard_token(parser, sym);
+    return _CBRT_INVALID_ARGUMENT;
+  }
+  for (;;) {
+    r = cbrt_reserve(parser);
+    if (r) {
+      cbrt_discard_token(parser, sym);
+      return r;
+    }
+    int32_t action = t->parse_table_[(size_t)h->num_parse_columns_ * parser->states_[parser->pos_ - 1] + (sym - h->min_sym_)];
+    if (action > 0) {
+      cbrt_push(parser, action, sym, parser->token_value_);
+      return _CBRT_OK;
+    }
+    if (!action) {
+      /* Error recovery through the error symbol is not supported by the driver */
+      cbrt_discard_token(parser, sym);
+      cbrt_discard_stack(parser);
+      parser->pos_ = 0;
+      return _CBRT_SYNTAX_ERROR;
+    }
+
+    uint32_t production = (uint32_t)(-(action + 1));
+    uint32_t length = t->production_lengths_[production];
+    if (length >= parser->pos_) {
+      cbrt_discard_token(parser, sym);
+      return _CBRT_INTERNAL_ERROR;
+    }
+    if (!production) {
+      /* Accept, the start symbol is on top of the stack */
+      parser->pos_--;
+      memcpy(parser->result_value_, parser->values_ + parser->pos_ * parser->value_stride_, parser->value_stride_);
+      cbrt_discard_stack(parser);
+      parser->pos_ = 0;
+      parser->finished_ = 1;
+      return _CBRT_FINISH;
+    }
+    memset(parser->result_value_, 0, parser->value_stride_);
+    if (parser->callbacks_->reduce_) {
+      /* Grammar productions are numbered from 0, the tables' production 0 is the synthetic root */
+      r = parser->callbacks_->reduce_(parser->arg_, parser, (int)production - 1, parser->result_value_,
+                                      parser->values_ + (parser->pos_ - length) * parser->value_stride_);
+      if (r) {
+        cbrt_discard_token(parser, sym);
+        return r;
+      }
+    }
+    parser->pos_ -= length;
+    int nonterminal = t->production_syms_[production];
+    int32_t goto_state = t->parse_table_[(size_t)h->num_parse_columns_ * parser->states_[parser->pos_ - 1] + (nonterminal - h->min_sym_)];
+    if (goto_state <= 0) {
+      if (parser->callbacks_->discard_) {
+        parser->callbacks_->discard_(parser->arg_, nonterminal, parser->result_value_);
+      }
+      cbrt_discard_token(parser, sym);
+      return _CBRT_INTERNAL_ERROR;
+    }
+    /* Only an empty production can grow the stack here */
+    r = cbrt_reserve(parser);
+    if (r) {
+      if (parser->callbacks_->discard_) {
+        parser->callbacks_->discard_(parser->arg_, nonterminal, parser->result_value_);
+      }
+      cbrt_discard_token(parser, sym);
+      return r;
+    }
+    cbrt_push(parser, goto_state, nonterminal, parser->result_value_);
+  }
+}
+
+int cbrt_parse_sym(struct cbrt_parser *parser, int sym, const void *value) {
+  int r = cbrt_reserve(parser);
+  if (r) return r;
+  memset(parser->token_value_, 0, parser->value_stride_);
+  if (value) memcpy(parser->token_value_, value, parser->value_size_);
+  return cbrt_parse_token(parser, sym);
+}
+
+/* Scans the next token of input from parser->offset_ on. Returns _CBRT_OK with the pattern matched
+ * in *ppattern and the token's size in *ptoken_size, _CBRT_FINISH at the end of input, or
+ * _CBRT_LEXICAL_ERROR. */
+static int cbrt_scan(struct cbrt_parser *parser, const char *input, size_t input_size, int *ppattern, size_t *ptoken_size) {
+  const struct cbrt_tables *t = parser->tables_;
+  const struct cbrt_tables_header *h = t->header_;
+  size_t row_size = h->num_scan_columns_;
+  int is_utf8 = !!(h->flags_ & CBRT_TABLES_UTF8);
+  uint32_t state = t->mode_start_states_[parser->mode_];
+
+  size_t index = parser->offset_;
+  size_t offset = parser->offset_;
+  int line = parser->line_;
+  int col = parser->col_;
+
+  uint32_t best_action = 0;
+  size_t best_index = index;
+  int best_line = line, best_col = col;
+
+  parser->token_offset_ = offset;
+  parser->token_line_ = line;
+  parser->token_col_ = col;
+
+  while (index < input_size) {
+    size_t cp_start = index;
+    unsigned char first = (unsigned char)input[index];
+    size_t group;
+    if (is_utf8) {
+      int32_t row = 0;
+      for (;;) {
+        if (index == input_size) {
+          /* Incomplete codepoint at the end of input, treat as an invalid encoding */
+          group = 0;
+          break;
+        }
+        int32_t next = t->utf8_decoder_[256 * (size_t)row + (unsigned char)input[index]];
+        if (next >= 0) {
+          index++;
+          group = (size_t)next;
+          break;
+        }
+        if (next == -1) {
+          /* Invalid encoding, the unused symbol group 0 ends the token; eat at least a byte so
+           * we make progress, a byte that breaks a multi-byte codepoint starts the next one. */
+          if (!row) index++;
+          group = 0;
+          break;
+        }
+        row = ~next;
+        index++;
+      }
+    }
+    else {
+      group = first;
+      index++;
+    }
+
+    for (;;) {
+      const int32_t *anchors = t->scan_table_ + row_size * (state + 1);
+      if (((uint32_t)anchors[-CBRT_ANCHOR_START_OF_INPUT] != state) && !offset) {
+        state = (uint32_t)anchors[-CBRT_ANCHOR_START_OF_INPUT];
+      }
+      else if (((uint32_t)anchors[-CBRT_ANCHOR_START_OF_LINE] != state) && (col == 1)) {
+        state = (uint32_t)anchors[-CBRT_ANCHOR_START_OF_LINE];
+      }
+      else if (((uint32_t)anchors[-CBRT_ANCHOR_END_OF_LINE] != state) && (first == '\n')) {
+        state = (uint32_t)anchors[-CBRT_ANCHOR_END_OF_LINE];
+      }
+      else {
+        break;
+      }
+    }
+    if (t->scan_actions_[state]) {
+      best_action = t->scan_actions_[state];
+      best_index = cp_start;
+      best_line = line;
+      best_col = col;
+    }
+    state = (uint32_t)t->scan_table_[row_size * state + group];
+    if (!state) {
+      /* End of token, or an error if nothing matched before */
+      index = cp_start;
+      break;
+    }
+    offset += index - cp_start;
+    if (first != '\n') {
+      col++;
+    }
+    else {
+      col = 1;
+      line++;
+    }
+  }
+
+  if (index == input_size) {
+    if (index == parser->offset_) {
+      return _CBRT_FINISH;
+    }
+    for (;;) {
+      const int32_t *anchors = t->scan_table_ + row_size * (state + 1);
+      if (((uint32_t)anchors[-CBRT_ANCHOR_START_OF_INPUT] != state) && !offset) {
+        state = (uint32_t)anchors[-CBRT_ANCHOR_START_OF_INPUT];
+      }
+      else if (((uint32_t)anchors[-CBRT_ANCHOR_START_OF_LINE] != state) && (col == 1)) {
+        state = (uint32_t)anchors[-CBRT_ANCHOR_START_OF_LINE];
+      }
+      else if ((uint32_t)anchors[-CBRT_ANCHOR_END_OF_LINE] != state) {
+        /* End of line is always true at the end of input */
+        state = (uint32_t)anchors[-CBRT_ANCHOR_END_OF_LINE];
+      }
+      else if ((uint32_t)anchors[-CBRT_ANCHOR_END_OF_INPUT] != state) {
+        state = (uint32_t)anchors[-CBRT_ANCHOR_END_OF_INPUT];
+      }
+      else {
+        break;
+      }
+    }
+    if (t->scan_actions_[state]) {
+      best_action = t->scan_actions_[state];
+      best_index = index;
+      best_line = line;
+      best_col = col;
+    }
+  }
+
+  /* An empty match would not make progress */
+  if (!best_action || (best_index == parser->offset_)) {
+    return _CBRT_LEXICAL_ERROR;
+  }
+
+  *ppattern = (int)best_action - 1;
+  *ptoken_size = best_index - parser->offset_;
+  parser->offset_ = best_index;
+  parser->line_ = best_line;
+  parser->col_ = best_col;
+  return _CBRT_OK;
+}
+
+int cbrt_parse(struct cbrt_parser *parser, const char *input, size_t input_size) {
+  const struct cbrt_tables *t = parser->tables_;
+  int r;
+  if (!t->header_->num_scan_states_) return _CBRT_INVALID_ARGUMENT;
+  cbrt_parser_reset(parser);
+  r = cbrt_reserve(parser);
+  if (r) return r;
+
+  for (;;) {
+    int pattern;
+    size_t token_size;
+    size_t token_start = parser->offset_;
+    r = cbrt_scan(parser, input, input_size, &pattern, &token_size);
+    if (r == _CBRT_FINISH) {
+      return cbrt_parse_sym(parser, t->header_->input_end_sym_, NULL);
+    }
+    if (r) return r;
+
+    int sym = t->pattern_syms_[pattern];
+    memset(parser->token_value_, 0, parser->value_stride_);
+    if (parser->callbacks_->token_) {
+      r = parser->callbacks_->token_(parser->arg_, parser, pattern, &sym, input + token_start, token_size, parser->token_value_);
+      if (r) return r;
+    }
+    if (sym == -1) continue;
+
+    r = cbrt_parse_token(parser, sym);
+    if (r) return r;
+  }
+}
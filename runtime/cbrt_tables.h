@@ -0,0 +1,221 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CBRT_TABLES_H
+#define CBRT_TABLES_H
+
+/* Generic driver for the tables carburetta writes with --tables. Rather than compiling a parser
+ * generated for one grammar, a program links this driver (cbrt_tables.c, which has no other
+ * dependencies) and loads the tables for a grammar at runtime. The scanner and parser behave as
+ * those of the generated C code; the code that would otherwise run for each pattern and
+ * production is supplied as callbacks instead of as snippets in the grammar.
+ *
+ * The tables image is designed to be mapped into memory as-is: a cbrt_tables_header followed by
+ * the tables, each at an offset that is a multiple of 8 and holding 32 bit integers in the byte
+ * order of the machine that wrote it. */
+
+#ifndef STDDEF_H_INCLUDED
+#define STDDEF_H_INCLUDED
+#include <stddef.h>
+#endif
+
+#ifndef STDINT_H_INCLUDED
+#define STDINT_H_INCLUDED
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CBRT_TABLES_MAGIC "CBRTIMG\x1A"
+
+/* Increment when the layout of the image changes */
+#define CBRT_TABLES_VERSION 1
+
+#define CBRT_TABLES_BYTE_ORDER 0x01020304
+
+/* Set in flags_ if the scanner reads its input as UTF-8, otherwise input is read as raw bytes */
+#define CBRT_TABLES_UTF8 1
+
+struct cbrt_tables_header {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t byte_order_;
+  uint32_t image_size_;
+  uint32_t flags_;
+
+  /* Scanner; num_scan_states_ is 0 if the grammar has no patterns. State 0 is the dead state, it
+   * ends the token being matched. */
+  uint32_t num_scan_states_;
+  uint32_t num_scan_columns_;     /* symbol groups (or 256 bytes if not UTF-8), followed by 4 anchors */
+  uint32_t num_utf8_decoder_rows_;
+  uint32_t num_patterns_;
+  uint32_t num_modes_;
+  uint32_t default_mode_;
+
+  /* Parser */
+  uint32_t num_parse_states_;
+  uint32_t num_parse_columns_;    /* symbols min_sym_ .. min_sym_ + num_parse_columns_ - 1 */
+  int32_t min_sym_;
+  int32_t input_end_sym_;
+  int32_t error_sym_;
+  uint32_t num_productions_;      /* including production 0, the synthetic root production */
+  uint32_t num_syms_;             /* symbols 0 .. num_syms_ - 1 have an entry in sym_names_ */
+  uint32_t strings_size_;
+
+  /* Byte offsets of the tables from the start of the image */
+  uint32_t scan_table_;           /* int32_t[num_scan_states_ * num_scan_columns_], next state */
+  uint32_t scan_actions_;         /* uint32_t[num_scan_states_], pattern matched + 1, or 0 for none */
+  uint32_t utf8_decoder_;         /* int32_t[num_utf8_decoder_rows_ * 256] */
+  uint32_t pattern_syms_;         /* int32_t[num_patterns_], terminal produced, or -1 if none */
+  uint32_t mode_start_states_;    /* uint32_t[num_modes_] */
+  uint32_t mode_names_;           /* uint32_t[num_modes_], offsets in strings_ */
+  uint32_t parse_table_;          /* int32_t[num_parse_states_ * num_parse_columns_] */
+  uint32_t production_lengths_;   /* uint32_t[num_productions_] */
+  uint32_t production_syms_;      /* int32_t[num_productions_], non-terminal reduced to */
+  uint32_t sym_names_;            /* uint32_t[num_syms_], offsets in strings_ */
+  uint32_t strings_;              /* char[strings_size_], NUL terminated strings, the first is "" */
+  uint32_t reserved_;
+};
+
+/* Return codes */
+#define _CBRT_OK 0                /* Parser needs the next symbol */
+#define _CBRT_FINISH 1            /* Input parsed successfully */
+#define _CBRT_SYNTAX_ERROR 2
+#define _CBRT_LEXICAL_ERROR 3
+#define _CBRT_NO_MEMORY 4
+#define _CBRT_INTERNAL_ERROR 5
+#define _CBRT_INVALID_TABLES 6    /* Image is not a valid tables image for this machine */
+#define _CBRT_IO_ERROR 7
+#define _CBRT_INVALID_ARGUMENT 8
+
+/* Loaded tables image, read-only once loaded; one cbrt_tables can be shared by any number of
+ * parsers, on any number of threads. */
+struct cbrt_tables;
+
+/* Maps the tables image in filename into memory. Returns _CBRT_OK and the tables in *ptables,
+ * or _CBRT_IO_ERROR, _CBRT_NO_MEMORY or _CBRT_INVALID_TABLES. */
+int cbrt_tables_open(const char *filename, struct cbrt_tables **ptables);
+
+/* As cbrt_tables_open(), for an image already in memory, for instance one embedded in the
+ * program. image must be aligned to 8 bytes and remain valid until cbrt_tables_close(). */
+int cbrt_tables_from_memory(const void *image, size_t image_size, struct cbrt_tables **ptables);
+
+void cbrt_tables_close(struct cbrt_tables *tables);
+
+/* Returns the symbol or mode with the name as it appears in the grammar, or -1 if none. */
+int cbrt_tables_find_sym(const struct cbrt_tables *tables, const char *name);
+int cbrt_tables_find_mode(const struct cbrt_tables *tables, const char *name);
+
+/* Returns the name of sym, or NULL if sym is not a symbol */
+const char *cbrt_tables_sym_name(const struct cbrt_tables *tables, int sym);
+
+int cbrt_tables_input_end_sym(const struct cbrt_tables *tables);
+
+struct cbrt_parser;
+
+/* Callbacks take the place of the action code in the grammar. Any of them may be NULL. A non-zero
+ * return value stops the parse and is returned by cbrt_parse() or cbrt_parse_sym(); pick values
+ * that do not collide with the _CBRT_ return codes. */
+struct cbrt_callbacks {
+  /* Called for each token scanned. pattern is the index of the pattern that matched, in the order
+   * the patterns appear in the grammar, and *sym the terminal it produces, or -1 if the pattern
+   * produces none (for instance whitespace.) The callback may change *sym, including to -1 to
+   * skip the token, and initialize value, which is zeroed beforehand. text is not NUL terminated.
+   * The position of the token is available from the parser. */
+  int (*token_)(void *arg, struct cbrt_parser *parser, int pattern, int *sym, const char *text, size_t text_size, void *value);
+
+  /* Called for each production reduced. production is the index of the production, in the order
+   * the productions appear in the grammar. values holds the values of the production's symbols,
+   * use cbrt_value() to get at each; result, zeroed beforehand, is to hold the value of the
+   * non-terminal. Upon success, ownership of whatever the values held passes to result. */
+  int (*reduce_)(void *arg, struct cbrt_parser *parser, int production, void *result, void *values);
+
+  /* Called for each value that is discarded without being reduced, for instance upon an error,
+   * or when the parser is reset or cleaned up. */
+  void (*discard_)(void *arg, int sym, void *value);
+};
+
+/* Parser state; treat as opaque, except for the fields documented as readable. */
+struct cbrt_parser {
+  const struct cbrt_tables *tables_;
+  const struct cbrt_callbacks *callbacks_;
+  void *arg_;
+
+  /* Size of each value, and rounded up so consecutive values are aligned. Values are moved as
+   * bytes when the stack grows, so must not point into themselves. */
+  size_t value_size_;
+  size_t value_stride_;
+
+  size_t pos_, num_allocated_;
+  int *states_;
+  int *syms_;
+  unsigned char *values_;
+
+  /* Scratch for the token being shifted and the non-terminal being reduced to */
+  unsigned char *token_value_;
+  unsigned char *result_value_;
+
+  /* Set once the input has been accepted, the value of the start symbol is in result_value_ */
+  int finished_;
+
+  uint32_t mode_;
+
+  /* Readable: position of the start of the token being scanned, and of the input following it */
+  size_t token_offset_;
+  int token_line_, token_col_;
+  size_t offset_;
+  int line_, col_;
+};
+
+void cbrt_parser_init(struct cbrt_parser *parser, const struct cbrt_tables *tables, size_t value_size, const struct cbrt_callbacks *callbacks, void *arg);
+
+/* Discards all values on the stack */
+void cbrt_parser_cleanup(struct cbrt_parser *parser);
+
+/* Discards all values on the stack and returns the parser to its initial state, the mode is
+ * left as is. */
+void cbrt_parser_reset(struct cbrt_parser *parser);
+
+/* Switches the scanner to mode, as $set_mode() does in a grammar; may be called from the token
+ * callback. Returns _CBRT_OK or _CBRT_INVALID_ARGUMENT. */
+int cbrt_set_mode(struct cbrt_parser *parser, int mode);
+int cbrt_mode(const struct cbrt_parser *parser);
+
+/* Returns a pointer to the value of the n-th symbol of a production, for values as passed to the
+ * reduce callback. */
+void *cbrt_value(const struct cbrt_parser *parser, void *values, size_t n);
+
+/* Value of the start symbol once a parse returned _CBRT_FINISH; ownership passes to the caller,
+ * it is not discarded. */
+void *cbrt_result(struct cbrt_parser *parser);
+
+/* Parses sym, with value value_size bytes at value (or zeroes if value is NULL), the value is
+ * moved into the parser and discarded if it cannot be shifted. Pass the input end symbol to
+ * complete the parse, its value is ignored. Returns _CBRT_OK if the next symbol is needed,
+ * _CBRT_FINISH, an error or a callback's return value. A parse that finished or had a syntax
+ * error starts anew on the next call; after any other error, call cbrt_parser_reset() first. */
+int cbrt_parse_sym(struct cbrt_parser *parser, int sym, const void *value);
+
+/* Scans and parses input as a whole, using the scanner tables. Returns _CBRT_FINISH, an error or
+ * a callback's return value. */
+int cbrt_parse(struct cbrt_parser *parser, const char *input, size_t input_size);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* CBRT_TABLES_H */
@@ -0,0 +1,315 @@
+/* Copyright 2020-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STDLIB_H_INCLUDED
+#define STDLIB_H_INCLUDED
+#include <stdlib.h>
+#endif
+
+#ifndef STDIO_H_INCLUDED
+#define STDIO_H_INCLUDED
+#include <stdio.h>
+#endif
+
+#ifndef STRING_H_INCLUDED
+#define STRING_H_INCLUDED
+#include <string.h>
+#endif
+
+#ifdef _WIN32
+#ifndef WINDOWS_H_INCLUDED
+#define WINDOWS_H_INCLUDED
+#include <Windows.h>
+#endif
+#else
+#ifndef PTHREAD_H_INCLUDED
+#define PTHREAD_H_INCLUDED
+#include <pthread.h>
+#endif
+#endif
+
+#ifndef REPORT_ERROR_H_INCLUDED
+#define REPORT_ERROR_H_INCLUDED
+#include "report_error.h"
+#endif
+
+#ifndef BATCH_H_INCLUDED
+#define BATCH_H_INCLUDED
+#include "batch.h"
+#endif
+
+void bat_manifest_init(struct bat_manifest *bm) {
+  bm->num_entries_ = bm->num_entries_allocated_ = 0;
+  bm->entries_ = NULL;
+}
+
+static void bat_free_argv(int argc, char **argv) {
+  int n;
+  if (!argv) return;
+  for (n = 0; n < argc; ++n) {
+    if (argv[n]) free(argv[n]);
+  }
+  free(argv);
+}
+
+void bat_manifest_cleanup(struct bat_manifest *bm) {
+  size_t n;
+  for (n = 0; n < bm->num_entries_; ++n) {
+    bat_free_argv(bm->entries_[n].argc_, bm->entries_[n].argv_);
+  }
+  if (bm->entries_) free(bm->entries_);
+}
+
+static int bat_append_char(char **buf, size_t *buf_size, size_t *buf_size_allocated, char c) {
+  if (*buf_size == *buf_size_allocated) {
+    size_t new_size = *buf_size_allocated * 2 + 64;
+    char *p = (char *)realloc(*buf, new_size);
+    if (!p) return -1;
+    *buf = p;
+    *buf_size_allocated = new_size;
+  }
+  (*buf)[(*buf_size)++] = c;
+  return 0;
+}
+
+static int bat_append_arg(int *argc, char ***argv, size_t *argv_allocated, char *arg) {
+  if ((size_t)*argc == *argv_allocated) {
+    size_t new_size = *argv_allocated * 2 + 8;
+    char **p = (char **)realloc(*argv, new_size * sizeof(char *));
+    if (!p) return -1;
+    *argv = p;
+    *argv_allocated = new_size;
+  }
+  (*argv)[(*argc)++] = arg;
+  return 0;
+}
+
+static int bat_append_entry(struct bat_manifest *bm, int line, int argc, char **argv) {
+  if (bm->num_entries_ == bm->num_entries_allocated_) {
+    size_t new_size = bm->num_entries_allocated_ * 2 + 16;
+    struct bat_manifest_entry *p = (struct bat_manifest_entry *)realloc(bm->entries_, new_size * sizeof(struct bat_manifest_entry));
+    if (!p) return -1;
+    bm->entries_ = p;
+    bm->num_entries_allocated_ = new_size;
+  }
+  struct bat_manifest_entry *bme = bm->entries_ + bm->num_entries_++;
+  bme->line_ = line;
+  bme->argc_ = argc;
+  bme->argv_ = argv;
+  return 0;
+}
+
+int bat_read_manifest(struct bat_manifest *bm, FILE *fp, const char *filename) {
+  int line = 1;
+  int entry_line = 1;
+  int argc = 0;
+  char **argv = NULL;
+  size_t argv_allocated = 0;
+  char *arg = NULL;
+  size_t arg_size = 0, arg_size_allocated = 0;
+  int in_arg = 0, in_quotes = 0, in_comment = 0;
+  int c;
+
+  do {
+    c = fgetc(fp);
+
+    if (in_comment) {
+      if ((c != '\n') && (c != EOF)) continue;
+      in_comment = 0;
+    }
+
+    if (in_quotes) {
+      if (c == EOF) {
+        re_error_flc(filename, line, 0, "Error, missing closing quote");
+        goto fail;
+      }
+      if (c == '\"') {
+        in_quotes = 0;
+        continue;
+      }
+      if (c == '\\') {
+        int next = fgetc(fp);
+        if ((next == '\"') || (next == '\\')) {
+          c = next;
+        }
+        else if (next != EOF) {
+          ungetc(next, fp);
+        }
+      }
+      if (c == '\n') line++;
+      if (bat_append_char(&arg, &arg_size, &arg_size_allocated, (char)c)) goto no_memory;
+      continue;
+    }
+
+    if ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n') || (c == EOF)) {
+      if (in_arg) {
+        /* Complete the argument */
+        if (bat_append_char(&arg, &arg_size, &arg_size_allocated, '\0')) goto no_memory;
+        if (!argc) {
+          /* Program name in the conventional argv[0] spot */
+          char *program = strdup(filename);
+          if (!program) goto no_memory;
+          if (bat_append_arg(&argc, &argv, &argv_allocated, program)) {
+            free(program);
+            goto no_memory;
+          }
+          entry_line = line;
+        }
+        char *completed_arg = (char *)realloc(arg, arg_size);
+        if (!completed_arg) completed_arg = arg;
+        arg = NULL;
+        arg_size = arg_size_allocated = 0;
+        if (bat_append_arg(&argc, &argv, &argv_allocated, completed_arg)) {
+          free(completed_arg);
+          goto no_memory;
+        }
+        in_arg = 0;
+      }
+      if (((c == '\n') || (c == EOF)) && argc) {
+        /* Complete the entry */
+        if (bat_append_entry(bm, entry_line, argc, argv)) goto no_memory;
+        argc = 0;
+        argv = NULL;
+        argv_allocated = 0;
+      }
+      if (c == '\n') line++;
+      continue;
+    }
+
+    if (!in_arg && (c == '#')) {
+      in_comment = 1;
+      continue;
+    }
+
+    in_arg = 1;
+    if (c == '\"') {
+      in_quotes = 1;
+      continue;
+    }
+    if (bat_append_char(&arg, &arg_size, &arg_size_allocated, (char)c)) goto no_memory;
+  } while (c != EOF);
+
+  if (ferror(fp)) {
+    re_error_flc(filename, line, 0, "Error, failed to read manifest");
+    goto fail;
+  }
+
+  return 0;
+
+no_memory:
+  re_error_nowhere("Error, no memory");
+fail:
+  if (arg) free(arg);
+  bat_free_argv(argc, argv);
+  return -1;
+}
+
+struct bat_queue {
+  size_t next_job_;
+  size_t num_jobs_;
+  void (*job_fn_)(void *arg, size_t job_index);
+  void *arg_;
+#ifdef _WIN32
+  CRITICAL_SECTION lock_;
+#else
+  pthread_mutex_t lock_;
+#endif
+};
+
+static void bat_work(struct bat_queue *q) {
+  for (;;) {
+    size_t job_index;
+#ifdef _WIN32
+    EnterCriticalSection(&q->lock_);
+#else
+    pthread_mutex_lock(&q->lock_);
+#endif
+    job_index = q->next_job_;
+    if (job_index < q->num_jobs_) q->next_job_++;
+#ifdef _WIN32
+    LeaveCriticalSection(&q->lock_);
+#else
+    pthread_mutex_unlock(&q->lock_);
+#endif
+    if (job_index >= q->num_jobs_) return;
+
+    q->job_fn_(q->arg_, job_index);
+  }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI bat_thread(LPVOID arg) {
+  bat_work((struct bat_queue *)arg);
+  return 0;
+}
+#else
+static void *bat_thread(void *arg) {
+  bat_work((struct bat_queue *)arg);
+  return NULL;
+}
+#endif
+
+void bat_run(size_t num_jobs, int num_threads, void (*job_fn)(void *arg, size_t job_index), void *arg) {
+  struct bat_queue q;
+  q.next_job_ = 0;
+  q.num_jobs_ = num_jobs;
+  q.job_fn_ = job_fn;
+  q.arg_ = arg;
+
+  /* No point in having more threads than jobs; the calling thread is one of the threads. */
+  size_t num_extra_threads = (num_threads > 1) ? (size_t)(num_threads - 1) : 0;
+  if (num_extra_threads >= num_jobs) num_extra_threads = num_jobs ? num_jobs - 1 : 0;
+
+#ifdef _WIN32
+  HANDLE *threads = NULL;
+  InitializeCriticalSection(&q.lock_);
+  if (num_extra_threads) threads = (HANDLE *)malloc(num_extra_threads * sizeof(HANDLE));
+#else
+  pthread_t *threads = NULL;
+  pthread_mutex_init(&q.lock_, NULL);
+  if (num_extra_threads) threads = (pthread_t *)malloc(num_extra_threads * sizeof(pthread_t));
+#endif
+  size_t num_started = 0;
+  if (threads) {
+    while (num_started < num_extra_threads) {
+#ifdef _WIN32
+      threads[num_started] = CreateThread(NULL, 0, bat_thread, &q, 0, NULL);
+      if (!threads[num_started]) break;
+#else
+      if (pthread_create(threads + num_started, NULL, bat_thread, &q)) break;
+#endif
+      num_started++;
+    }
+  }
+
+  bat_work(&q);
+
+  size_t n;
+  for (n = 0; n < num_started; ++n) {
+#ifdef _WIN32
+    WaitForSingleObject(threads[n], INFINITE);
+    CloseHandle(threads[n]);
+#else
+    pthread_join(threads[n], NULL);
+#endif
+  }
+
+#ifdef _WIN32
+  DeleteCriticalSection(&q.lock_);
+#else
+  pthread_mutex_destroy(&q.lock_);
+#endif
+  if (threads) free(threads);
+}
@@ -0,0 +1,73 @@
+/* Copyright 2020-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#ifndef STDDEF_H_INCLUDED
+#define STDDEF_H_INCLUDED
+#include <stddef.h>
+#endif
+
+#ifndef STDIO_H_INCLUDED
+#define STDIO_H_INCLUDED
+#include <stdio.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A batch manifest lists one grammar per line, each line holding the arguments that would
+ * otherwise be passed on the command line, for instance:
+ *   # comment
+ *   grammar.cbrt --c grammar.c --h
+ *   "other grammar.cbrt" --c other.c --nolinedir
+ * Arguments are separated by whitespace; an argument in double quotes may contain whitespace,
+ * with \" and \\ as escapes for a quote and a backslash. A # at the start of an argument starts
+ * a comment that runs to the end of the line. Lines without arguments are skipped. */
+struct bat_manifest_entry {
+  /* Line in the manifest, for error reporting */
+  int line_;
+
+  /* argv_[0] is the filename of the manifest, in the place a command line holds the program name;
+   * the arguments proper start at argv_[1]. */
+  int argc_;
+  char **argv_;
+};
+
+struct bat_manifest {
+  size_t num_entries_, num_entries_allocated_;
+  struct bat_manifest_entry *entries_;
+};
+
+void bat_manifest_init(struct bat_manifest *bm);
+void bat_manifest_cleanup(struct bat_manifest *bm);
+
+/* Reads the manifest from fp, filename is used for error reporting and as argv_[0] of each entry.
+ * Returns 0 upon success, non-zero upon failure, in which case an error has been reported. */
+int bat_read_manifest(struct bat_manifest *bm, FILE *fp, const char *filename);
+
+/* Calls job_fn(arg, job_index) once for each job_index from 0 up to num_jobs, spread out over
+ * num_threads threads (including the calling thread.) Jobs are handed out in order as threads
+ * become available. If fewer threads can be created, the jobs are run on the threads that could.
+ * Returns once all jobs have completed. */
+void bat_run(size_t num_jobs, int num_threads, void (*job_fn)(void *arg, size_t job_index), void *arg);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* BATCH_H */
@@ -0,0 +1,707 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STDLIB_H_INCLUDED
+#define STDLIB_H_INCLUDED
+#include <stdlib.h>
+#endif
+
+#ifndef STRING_H_INCLUDED
+#define STRING_H_INCLUDED
+#include <string.h>
+#endif
+
+#ifndef REPORT_ERROR_H_INCLUDED
+#define REPORT_ERROR_H_INCLUDED
+#include "report_error.h"
+#endif
+
+#ifndef REX_H_INCLUDED
+#define REX_H_INCLUDED
+#include "rex.h"
+#endif
+
+#ifndef PRD_GRAM_H_INCLUDED
+#define PRD_GRAM_H_INCLUDED
+#include "prd_gram.h"
+#endif
+
+#ifndef GRAMMAR_TABLE_H_INCLUDED
+#define GRAMMAR_TABLE_H_INCLUDED
+#include "grammar_table.h"
+#endif
+
+#ifndef LALR_H_INCLUDED
+#define LALR_H_INCLUDED
+#include "lalr.h"
+#endif
+
+#ifndef SYMBOL_H_INCLUDED
+#define SYMBOL_H_INCLUDED
+#include "symbol.h"
+#endif
+
+#ifndef CARBURETTA_CONTEXT_H_INCLUDED
+#define CARBURETTA_CONTEXT_H_INCLUDED
+#include "carburetta_context.h"
+#endif
+
+#ifndef EMIT_C_H_INCLUDED
+#define EMIT_C_H_INCLUDED
+#include "emit_c.h"
+#endif
+
+#ifndef TABLE_CACHE_H_INCLUDED
+#define TABLE_CACHE_H_INCLUDED
+#include "table_cache.h"
+#endif
+
+#ifndef PROFILE_H_INCLUDED
+#define PROFILE_H_INCLUDED
+#include "profile.h"
+#endif
+
+#ifndef BUILD_TABLES_H_INCLUDED
+#define BUILD_TABLES_H_INCLUDED
+#include "build_tables.h"
+#endif
+
+int bt_build_tables(struct carburetta_context *cc, struct prd_grammar *prdg, struct grammar_table *gt, struct rex_scanner *rex, struct lr_generator *lalr) {
+  int r;
+
+  struct tc_key tck;
+  tc_key_init(&tck);
+
+  struct tc_tables tct;
+  tc_tables_init(&tct);
+
+  struct prof_profile prof;
+  prof_init(&prof);
+
+  /* Set if tct holds the tables from the --cache-dir, and which of those were used */
+  int have_cached_tables = 0;
+  int lalr_from_cache = 0;
+  int dfa_from_cache = 0;
+
+  /* Assign types to all symbols */
+  struct symbol *sym;
+
+  /* Assign the token type to tokens that don't yet have a type assigned. */
+  sym = cc->symtab_.terminals_;
+  if (sym) {
+    do {
+      sym = sym->next_;
+
+      if (!sym->assigned_type_) {
+        sym->assigned_type_ = cc->token_assigned_type_;
+      }
+    } while (sym != cc->symtab_.terminals_);
+  }
+
+  /* Ensure we have error and end-of-input tokens */
+  if (!cc->error_sym_) {
+    struct xlts error_id;
+    xlts_init(&error_id);
+    r = xlts_append_xlat(&error_id, strlen("error"), "error");
+    if (r) {
+      re_error_nowhere("Error: no memory");
+      r = -1;
+      goto cleanup_exit;
+    }
+    int is_new = 0;
+    struct symbol *sym = symbol_find_or_add(&cc->symtab_, SYM_TERMINAL, &error_id, &is_new);
+    xlts_cleanup(&error_id);
+    if (!sym) {
+      re_error_nowhere("Error: no memory");
+      r = -1;
+      goto cleanup_exit;
+    }
+    if (!is_new) {
+      re_error(&sym->def_, "Error: \"error\" token already in use. Define an error token explicitly using %%error_token or ensure the \"error\" identifier is not used anywhere.");
+      r = -1;
+      goto cleanup_exit;
+    }
+    cc->error_sym_ = sym;
+  }
+
+  if (!cc->input_end_sym_) {
+    struct xlts input_end_id;
+    xlts_init(&input_end_id);
+    r = xlts_append_xlat(&input_end_id, strlen("input-end"), "input-end");
+    if (r) {
+      re_error_nowhere("Error: no memory");
+      r = -1;
+      goto cleanup_exit;
+    }
+    int is_new = 0;
+    struct symbol *sym = symbol_find_or_add(&cc->symtab_, SYM_TERMINAL, &input_end_id, &is_new);
+    xlts_cleanup(&input_end_id);
+    if (!sym) {
+      re_error_nowhere("Error: no memory");
+      r = -1;
+      goto cleanup_exit;
+    }
+    if (!is_new) {
+      re_error(&sym->def_, "Error: \"error\" token already in use. Define an error token explicitly using %%error_token or ensure the \"error\" identifier is not used anywhere.");
+      r = -1;
+      goto cleanup_exit;
+    }
+    cc->input_end_sym_ = sym;
+  }
+
+  /* Number all symbols */
+  int RULE_END, GRAMMAR_END;
+  RULE_END = 1;
+  GRAMMAR_END = 2;
+  int next_ordinal;
+  next_ordinal = 3;
+  sym = cc->symtab_.terminals_;
+  if (sym) {
+    do {
+      sym = sym->next_;
+
+      if ((sym != cc->error_sym_) && (sym != cc->input_end_sym_)) {
+        sym->ordinal_ = next_ordinal++;
+      }
+    } while (sym != cc->symtab_.terminals_);
+  }
+  cc->error_sym_->ordinal_ = next_ordinal++;
+  cc->input_end_sym_->ordinal_ = next_ordinal++;
+  int INPUT_END;
+  INPUT_END = cc->input_end_sym_->ordinal_;
+  sym = cc->symtab_.non_terminals_;
+  if (sym) {
+    do {
+      sym = sym->next_;
+
+      sym->ordinal_ = next_ordinal++;
+    } while (sym != cc->symtab_.non_terminals_);
+  }
+  int SYNTHETIC_S;
+  SYNTHETIC_S = next_ordinal++;
+  if (symbol_table_index_ordinals(&cc->symtab_)) {
+    re_error_nowhere("Error: no memory");
+    r = -1;
+    goto cleanup_exit;
+  }
+
+  /* Resolve all symbol references in the productions */
+  size_t prod_idx;
+  for (prod_idx = 0; prod_idx < prdg->num_productions_; ++prod_idx) {
+    struct prd_production *prod = prdg->productions_ + prod_idx;
+    if (!prod->nt_.id_.num_translated_) {
+      prdg->have_errors_ = 1;
+      continue;
+    }
+    struct symbol *sym = symbol_find(&cc->symtab_, prod->nt_.id_.translated_);
+    if (!sym || (sym->st_ != SYM_NONTERMINAL)) {
+      re_error(&prod->nt_.id_, "Error, symbol \"%s\" not declared as %%nt", prod->nt_.id_.translated_);
+      prdg->have_errors_ = 1;
+    }
+    else {
+      prod->nt_.sym_ = sym;
+    }
+    size_t sym_idx;
+    for (sym_idx = 0; sym_idx < prod->num_syms_; ++sym_idx) {
+      struct prd_production_sym *prod_sym = prod->syms_ + sym_idx;
+      if (!prod_sym->id_.num_translated_) {
+        prdg->have_errors_ = 1;
+        continue;
+      }
+      sym = symbol_find(&cc->symtab_, prod_sym->id_.translated_);
+      if (!sym) {
+        re_error(&prod_sym->id_, "Error, symbol \"%s\" was not declared as %%nt or %%token", prod_sym->id_.translated_);
+        prdg->have_errors_ = 1;
+        continue;
+      }
+      prod_sym->sym_ = sym;
+    }
+  }
+
+  /* Resolve all symbol references in the patterns */
+  size_t pat_idx;
+  for (pat_idx = 0; pat_idx < prdg->num_patterns_; ++pat_idx) {
+    struct prd_pattern *pat = prdg->patterns_ + pat_idx;
+    if (!pat->term_.id_.num_translated_) {
+      /* Not resolving to a terminal.. but pattern will still match its action so keep it around */
+      continue;
+    }
+    struct symbol *sym = symbol_find(&cc->symtab_, pat->term_.id_.translated_);
+    if (!sym) {
+      re_error(&pat->term_.id_, "Error, symbol \"%s\" not declared as %%token", pat->term_.id_.translated_);
+      prdg->have_errors_ = 1;
+    }
+    else if (sym->st_ != SYM_TERMINAL) {
+      re_error(&pat->term_.id_, "Error, pattern symbol \"%s\" must be declared as %%token, not as %%nt", pat->term_.id_.translated_);
+      prdg->have_errors_ = 1;
+    }
+    else {
+      pat->term_.sym_ = sym;
+    }
+  }
+
+  if (prdg->have_errors_) {
+    r = -1;
+    goto cleanup_exit;
+  }
+
+  /* Take the production "syntax tree" and transcribe it into the form used for consumption by lalr.c */
+  r = gt_transcribe_grammar(gt, prdg->num_productions_, prdg->productions_, RULE_END, GRAMMAR_END);
+  if (r) {
+    r = -1;
+    goto cleanup_exit;
+  }
+
+  //gt_debug_grammar(gt, prdg->num_productions_, prdg->productions_, RULE_END, GRAMMAR_END);
+
+  /* Resolve all conflict resolutions */
+  struct conflict_resolution *confres;
+  confres = cc->conflict_resolutions_;
+  if (confres) {
+    do {
+      confres = confres->next_;
+
+      struct prd_production *prods[] = {
+        &confres->prefer_prod_,
+        &confres->over_prod_
+      };
+
+      size_t matches[sizeof(prods) / sizeof(*prods)];
+      
+      size_t n;
+      for (n = 0; n < sizeof(prods) / sizeof(*prods); ++n) {
+        int had_failed_lookup = 0;
+        struct prd_production *prod = prods[n];
+
+        prod->nt_.sym_ = symbol_find(&cc->symtab_, prod->nt_.id_.translated_);
+        if (!prod->nt_.sym_ || (prod->nt_.sym_->st_ != SYM_NONTERMINAL)) {
+          re_error(&prod->nt_.id_, "Error, symbol \"%s\" was not declared as %%nt", prod->nt_.id_.translated_);
+          prdg->have_errors_ = 1;
+          had_failed_lookup = 1;
+        }
+        size_t sym_idx;
+        for (sym_idx = 0; sym_idx < prod->num_syms_; ++sym_idx) {
+          struct prd_production_sym *ps = prod->syms_ + sym_idx;
+          ps->sym_ = symbol_find(&cc->symtab_, ps->id_.translated_);
+          if (!ps->sym_) {
+            re_error(&prod->nt_.id_, "Error, symbol \"%s\" was not declared as %%nt or %%token", ps->id_.translated_);
+            prdg->have_errors_ = 1;
+            had_failed_lookup = 1;
+          }
+        }
+
+        if (had_failed_lookup) {
+          continue;
+        }
+        /* Find a match; if possible */
+        size_t prod_idx;
+        for (prod_idx = 0; prod_idx < prdg->num_productions_; ++prod_idx) {
+          struct prd_production *gp = prdg->productions_ + prod_idx;
+          if (gp->nt_.sym_ != prod->nt_.sym_) {
+            continue;
+          }
+          if (gp->num_syms_ != prod->num_syms_) {
+            continue;
+          }
+          for (sym_idx = 0; sym_idx < prod->num_syms_; ++sym_idx) {
+            if (gp->syms_[sym_idx].sym_ != prod->syms_[sym_idx].sym_) {
+              break;
+            }
+          }
+          if (sym_idx != prod->num_syms_) {
+            continue;
+          }
+          /* Production matches */
+          break;
+        }
+        if (prod_idx != prdg->num_productions_) {
+          /* Production prod_idx matches */
+          matches[n] = prod_idx;
+        }
+        else {
+          re_error(&prod->nt_.id_, "Error, no matching production found");
+          prdg->have_errors_ = 1;
+        }
+      }
+
+      /* Productions are 1 based for LALR (as production 0 is the synthetic S reduction) */
+      r = lr_add_conflict_resolution(lalr, 1 + (int)matches[0], confres->prefer_prod_place_, 1 + (int)matches[1], confres->over_prod_place_);
+      if (r) {
+        re_error_nowhere("Error, no memory");
+        r = -1;
+        goto cleanup_exit;
+      }
+
+    } while (confres != cc->conflict_resolutions_);
+  }
+
+  if (prdg->have_errors_) {
+    r = -1;
+    goto cleanup_exit;
+  }
+
+  if (cc->cache_dir_) {
+    if (tc_make_key(&tck, cc, prdg, gt, lalr, RULE_END, GRAMMAR_END, INPUT_END, SYNTHETIC_S)) {
+      re_error_nowhere("Error, no memory");
+      r = -1;
+      goto cleanup_exit;
+    }
+    have_cached_tables = !tc_load(cc->cache_dir_, &tck, &tct);
+  }
+
+  /* A cached parse table that does not fit the productions is ignored and generated anew */
+  if (have_cached_tables && (LR_OK == lr_load_parser(lalr, gt->ordinals_, RULE_END, GRAMMAR_END, INPUT_END, SYNTHETIC_S, tct.nr_states_, tct.parse_table_, tct.num_parse_table_cells_))) {
+    lalr_from_cache = 1;
+    r = 0;
+  }
+  else {
+    r = gt_generate_lalr(gt, lalr, RULE_END, GRAMMAR_END, INPUT_END, SYNTHETIC_S);
+  }
+  if (r == GT_CONFLICTS) {
+    struct lr_conflict_pair *cp;
+    for (cp = lalr->conflicts_; cp; cp = cp->chain_) {
+      /* NOTE: lalr parser inserts a rule 0, so consider all conflicts 1-based. */
+      struct {
+        int production, position;
+      } conflict[2] = {
+        {cp->production_a_ - 1, cp->position_a_},
+        {cp->production_b_ - 1, cp->position_b_}
+      };
+      size_t n;
+      const char *a;
+      const char *b;
+      if (conflict[0].position == (int)prdg->productions_[conflict[0].production].num_syms_) {
+        /* A = reduce */
+        a = "reduce";
+      }
+      else {
+        a = "shift";
+      }
+      if (conflict[1].position == (int)prdg->productions_[conflict[1].production].num_syms_) {
+        /* B = reduce */
+        b = "reduce";
+      }
+      else {
+        b = "shift";
+      }
+
+      re_error_nowhere("Error, %s/%s conflict found:", a, b);
+      for (n = 0; n < sizeof(conflict) / sizeof(*conflict); ++n) {
+        int prod_idx, pos_idx;
+        prod_idx = conflict[n].production;
+        pos_idx = conflict[n].position;
+        struct prd_production *gp = prdg->productions_ + prod_idx;
+        size_t sym_idx;
+        size_t msg_size = 0;
+        msg_size = gp->nt_.id_.num_translated_ + 2 /* ": " */;
+        for (sym_idx = 0; sym_idx < gp->num_syms_; ++sym_idx) {
+          msg_size += gp->syms_[sym_idx].id_.num_translated_ + 1 /* " " */;
+        }
+        msg_size += 2 /* " *" */;
+
+        if (sym_idx == (size_t)pos_idx) {
+          msg_size += strlen(" (reduce)");
+        }
+        else {
+          msg_size += strlen(" (shift)");
+        }
+
+        msg_size++ /* '\0' */;
+
+        char *msg = (char *)malloc(msg_size);
+        if (!msg) {
+          re_error_nowhere("Error, no memory");
+          r = -1;
+          goto cleanup_exit;
+        }
+
+        msg[0] = '\0';
+        strcat(msg, gp->nt_.id_.translated_);
+        strcat(msg, ":");
+
+        for (sym_idx = 0; sym_idx < gp->num_syms_; ++sym_idx) {
+          if (sym_idx == (size_t)pos_idx) strcat(msg, " *");
+          strcat(msg, " ");
+          strcat(msg, gp->syms_[sym_idx].id_.translated_);
+        }
+        if (sym_idx == (size_t)pos_idx) {
+          strcat(msg, " * (reduce)");
+        }
+        else {
+          strcat(msg, " (shift)");
+        }
+
+        re_error(&gp->nt_.id_, msg);
+        free(msg);
+      }
+    }
+    re_error_nowhere("(Use %%prefer %%over directives to force resolution of conflicts)");
+  }
+  if (r) {
+    r = -1;
+    goto cleanup_exit;
+  }
+
+  struct mode *default_mode;
+  struct xlts default_keyword;
+  xlts_init(&default_keyword);
+  xlts_append_xlat(&default_keyword, strlen("default"), "default");
+  int is_default_new = -1;
+  default_mode = mode_find_or_add(&cc->modetab_, &default_keyword, &is_default_new);
+  xlts_cleanup(&default_keyword);
+  if (!default_mode) {
+    re_error_nowhere("Error, no memory");
+    r = -1;
+    goto cleanup_exit;
+  }
+  if (!is_default_new) {
+    re_error(&default_mode->def_, "Error, \"default\" mode is implicit and should not be explicitly declared");
+    r = -1;
+    goto cleanup_exit;
+  }
+  /* Make sure that the "default" mode gets the first rex_mode allocation is
+   * this has consequences for the order of the states in the final table */
+  r = rex_add_mode(rex, &default_mode->rex_mode_);
+  if (r) {
+    switch (r) {
+    case _REX_NO_MEMORY:
+      re_error_nowhere("Error, no memory");
+      r = -1;
+      goto cleanup_exit;
+    default:
+      /* All errors here are internal */
+      re_error_nowhere("Internal error");
+      r = -1;
+      goto cleanup_exit;
+    }
+  }
+
+  struct mode *m;
+  m = cc->modetab_.modes_;
+  if (m) {
+    do {
+      m = m->next_;
+
+      if (!m->rex_mode_) {
+        r = rex_add_mode(rex, &m->rex_mode_);
+        if (r) {
+          switch (r) {
+          case _REX_NO_MEMORY:
+            re_error_nowhere("Error, no memory");
+            r = -1;
+            goto cleanup_exit;
+          default:
+            /* All errors here are internal */
+            re_error_nowhere("Internal error");
+            r = -1;
+            goto cleanup_exit;
+          }
+        }
+      }
+    } while (m != cc->modetab_.modes_);
+  }
+
+  if (prdg->num_patterns_) {
+    size_t n;
+    for (n = 0; n < prdg->num_patterns_; ++n) {
+      struct prd_pattern *prd_pat = prdg->patterns_ + n;
+      r = rex_add_pattern(rex, prd_pat->regex_, n + 1, &prd_pat->pat_);
+      if (r) {
+        /* Failure occurred, report */
+        switch (r) {
+        case _REX_NO_MEMORY:
+          re_error_nowhere("Error, no memory");
+          r = -1;
+          goto cleanup_exit;
+        case _REX_SYNTAX_ERROR:
+        case _REX_LEXICAL_ERROR:
+          /* The regex should already be validated to be
+          * a correct regular expression (otherwise */
+          re_error_nowhere("Internal error, inconsistent syntax");
+          r = -1;
+          goto cleanup_exit;
+        default:
+          /* All errors here are internal */
+          re_error_nowhere("Internal error");
+          r = -1;
+          goto cleanup_exit;
+        }
+      }
+    }
+  }
+
+  size_t mode_group_idx;
+  int have_error = 0;
+  for (mode_group_idx = 0; mode_group_idx < prdg->num_mode_groups_; ++mode_group_idx) {
+    struct prd_mode_group *mg = prdg->mode_groups_ + mode_group_idx;
+    size_t mode_group_mode_idx;
+    for (mode_group_mode_idx = 0; mode_group_mode_idx < mg->num_modes_; ++mode_group_mode_idx) {
+      struct prd_mode *md = mg->modes_ + mode_group_mode_idx;
+      struct mode *m = mode_find(&cc->modetab_, md->id_.translated_);
+      if (!m) {
+        re_error(&md->id_, "Error, mode \"%s\" not declared using %%mode", md->id_.translated_);
+        have_error = 1;
+      }
+      else {
+        size_t n;
+        for (n = mg->pattern_start_index_; n < mg->pattern_end_index_; ++n) {
+          struct prd_pattern *prd_pat = prdg->patterns_ + n;
+          r = rex_add_pattern_to_mode(m->rex_mode_, prd_pat->pat_);
+          prd_pat->touched_by_mode_ = 1;
+          if (r) {
+            switch (r) {
+            case _REX_NO_MEMORY:
+              re_error_nowhere("Error, no memory");
+              r = -1;
+              goto cleanup_exit;
+            default:
+              /* All errors here are internal */
+              re_error_nowhere("Internal error");
+              r = -1;
+              goto cleanup_exit;
+            }
+          }
+        }
+      }
+    }
+  }
+  if (have_error) {
+    r = -1;
+    goto cleanup_exit;
+  }
+  /* Add any untouched patterns to the default mode */
+  size_t pattern_index;
+  for (pattern_index = 0; pattern_index < prdg->num_patterns_; ++pattern_index) {
+    struct prd_pattern *pat = prdg->patterns_ + pattern_index;
+    if (!pat->touched_by_mode_) {
+      r = rex_add_pattern_to_mode(default_mode->rex_mode_, pat->pat_);
+      if (r) {
+        switch (r) {
+        case _REX_NO_MEMORY:
+          re_error_nowhere("Error, no memory");
+          r = -1;
+          goto cleanup_exit;
+        default:
+          /* All errors here are internal */
+          re_error_nowhere("Internal error");
+          r = -1;
+          goto cleanup_exit;
+        }
+      }
+    }
+  }
+
+  /* With --lazy-dfa the generated scanner determinizes the NFA itself, so there is no DFA to build
+   * or cache; it only needs the symbol groups. */
+  int dfa_is_cached;
+  dfa_is_cached = prdg->num_patterns_ && !cc->lazy_dfa_max_states_;
+
+  if (prdg->num_patterns_) {
+    if (have_cached_tables && tct.num_dfa_values_ && dfa_is_cached) {
+      /* As with the parse table, a cached DFA that does not fit is constructed anew */
+      dfa_from_cache = !rex_dfa_load(rex, tct.num_dfa_values_, tct.dfa_values_);
+    }
+    r = 0;
+    if (cc->lazy_dfa_max_states_) {
+      r = rex_link_modes(rex);
+      if (!r) {
+        r = rex_nfa_make_symbol_groups(rex);
+      }
+    }
+    else if (!dfa_from_cache) {
+      r = rex_realize_modes(rex);
+      if (!r) {
+        r = rex_dfa_make_symbol_groups(&rex->dfa_);
+      }
+    }
+    if (!r && dfa_is_cached) {
+      /* Keep the states of each mode together; also for DFAs cached before they were, as this is a
+       * no-op on a DFA already partitioned */
+      r = rex_dfa_partition_modes(rex, NULL);
+    }
+    if (r) {
+      switch (r) {
+      case _REX_NO_MEMORY:
+        re_error_nowhere("Error, no memory");
+        r = -1;
+        goto cleanup_exit;
+      default:
+        /* All errors here are internal */
+        re_error_nowhere("Internal error");
+        r = -1;
+        goto cleanup_exit;
+      }
+    }
+
+  }
+
+  if (cc->cache_dir_) {
+    int utf8_decoder_from_cache = 1;
+    if (cc->utf8_experimental_ && dfa_is_cached) {
+      if (dfa_from_cache && tct.utf8_decoder_) {
+        /* Take ownership, so the emitter uses it */
+        cc->utf8_decoder_table_ = tct.utf8_decoder_;
+        cc->utf8_decoder_num_rows_ = tct.num_utf8_decoder_rows_;
+        tct.utf8_decoder_ = NULL;
+      }
+      else {
+        utf8_decoder_from_cache = 0;
+        if (emit_utf8_decoder_table(&rex->dfa_, &cc->utf8_decoder_num_rows_, &cc->utf8_decoder_table_)) {
+          r = -1;
+          goto cleanup_exit;
+        }
+      }
+    }
+
+    if (!lalr_from_cache || (dfa_is_cached && !dfa_from_cache) || !utf8_decoder_from_cache) {
+      /* Some of the tables were constructed, (re-)write the cache entry; failing to do so is not fatal. */
+      struct tc_tables store;
+      tc_tables_init(&store);
+      store.nr_states_ = lalr->nr_states_;
+      store.num_parse_table_cells_ = (size_t)lalr->nr_states_ * (size_t)(lalr->max_sym_ - lalr->min_sym_ + 1);
+      store.parse_table_ = lalr->parse_table_;
+      if (dfa_is_cached) {
+        r = rex_dfa_save(rex, &store.num_dfa_values_, &store.dfa_values_);
+        if (r) {
+          re_error_nowhere("Error, no memory");
+          r = -1;
+          goto cleanup_exit;
+        }
+      }
+      store.num_utf8_decoder_rows_ = cc->utf8_decoder_num_rows_;
+      store.utf8_decoder_ = cc->utf8_decoder_table_;
+      tc_store(cc->cache_dir_, &tck, &store);
+      if (store.dfa_values_) free(store.dfa_values_);
+    }
+  }
+
+  /* Renumbering follows the cache, which keeps the tables as constructed, as profiles number them */
+  if (cc->profile_filename_) {
+    if (prof_load(&prof, cc->profile_filename_) || prof_apply(&prof, cc, rex, lalr)) {
+      r = -1;
+      goto cleanup_exit;
+    }
+  }
+
+  r = 0;
+cleanup_exit:
+  prof_cleanup(&prof);
+
+  tc_key_cleanup(&tck);
+
+  tc_tables_cleanup(&tct);
+
+  return r;
+}
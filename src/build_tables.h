@@ -0,0 +1,41 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BUILD_TABLES_H
+#define BUILD_TABLES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct carburetta_context;
+struct prd_grammar;
+struct grammar_table;
+struct rex_scanner;
+struct lr_generator;
+
+/* Builds the parse table (in lalr) and the scanner (in rex) for the grammar parsed into cc and
+ * prdg by pi_parse_input(), resolving the symbols, productions, patterns, modes and conflict
+ * resolutions along the way; when cc->cache_dir_ is set, tables are loaded from and stored to
+ * the table cache. This is all of carburetta short of emitting output, it writes nothing. The
+ * productions of lalr point into gt, so gt must outlive it. Returns 0 upon success, non-zero
+ * upon failure, in which case errors have been reported. */
+int bt_build_tables(struct carburetta_context *cc, struct prd_grammar *prdg, struct grammar_table *gt, struct rex_scanner *rex, struct lr_generator *lalr);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* BUILD_TABLES_H */
@@ -143,28 +143,26 @@
 #include "indented_printer.h"
 #endif
 
+#ifndef BATCH_H_INCLUDED
+#define BATCH_H_INCLUDED
+#include "batch.h"
+#endif
 
-/* Following globals control the output file. If we fail execution (eg. user error in the input or an
- * unforeseen problem internally) then we wish to retain whatever output was already there.
- * Consequently, we write output to a temp file, and only rename it to the final file if execution
- * completes successfully. An atexit() handler guards the case where we fail early, and deletes the
- * created temp file.
- */
+#ifndef TABLE_CACHE_H_INCLUDED
+#define TABLE_CACHE_H_INCLUDED
+#include "table_cache.h"
+#endif
 
-char *g_temp_output_filename_ = NULL;
-FILE *g_temp_output_file = NULL;
+#ifndef TABLE_IMAGE_H_INCLUDED
+#define TABLE_IMAGE_H_INCLUDED
+#include "table_image.h"
+#endif
+
+#ifndef BUILD_TABLES_H_INCLUDED
+#define BUILD_TABLES_H_INCLUDED
+#include "build_tables.h"
+#endif
 
-void at_exit_delete_temp_output_handler(void) {
-  if (g_temp_output_file) {
-    fclose(g_temp_output_file);
-    g_temp_output_file = NULL;
-  }
-  if (g_temp_output_filename_) {
-    remove(g_temp_output_filename_);
-    free(g_temp_output_filename_);
-    g_temp_output_filename_ = NULL;
-  }
-}
 
 void print_dbg_char(FILE *fp, int c) {
   if ((c >= 0) && (c <= 255) && isprint(c) && (c != '\\') && (c != '\'') && (c != '\"')) {
@@ -207,7 +205,18 @@ struct cli_args {
   { '8', "x-utf8", NULL, "Generate a parser that reads input as UTF-8 (default)", 0},
   { 'r', "x-raw", NULL, "Generate a parser that reads input as raw (latin-1) bytes", 0},
   { 'n', "sym-names", NULL, "Generate a \"const char * const <prefix>symbol_names_[]\" table through which the name of a symbol can be retrieved for debug purposes. The length of the table is stored in \"const int <prefix>symbol_names_length_\". Entries which are invalid symbol ordinals will contain NULL.", 0},
-  { 'L', "nolinedir", NULL, "Disables emitting #line directives for code snippets in the generated output. If not specified, the default behavior is to emit #line directives.", 0}
+  { 'L', "nolinedir", NULL, "Disables emitting #line directives for code snippets in the generated output. If not specified, the default behavior is to emit #line directives.", 0},
+  { 'l', "linear-scan", NULL, "Generate a scanner that remembers which (state, position) pairs failed to produce a longer match, guaranteeing tokenization in time linear to the size of the input. Without this, inputs that repeatedly match the prefix of a long pattern but never complete it may take quadratic time to scan. Costs some memory and time per character scanned.", 0},
+  { 'g', "computed-goto", NULL, "Generate code that, when compiled with GCC or Clang, dispatches the reduction of productions and the resumption of action continuations by jumping through a table of label addresses (the \"labels as values\" extension) rather than through a switch. Other compilers continue to use the switch.", 0},
+  { 'd', "lazy-dfa", "<max-states>", "Generate a scanner that carries the NFA of the patterns rather than the DFA, and determinizes the DFA states as the input reaches them, keeping up to max-states of them (at least the number of modes plus two) in a cache that is flushed when full. For scanners whose DFA is huge, for instance many patterns over large Unicode classes, this avoids constructing and emitting the DFA at the cost of scanning time whenever the input reaches a state not in the cache. Cannot be combined with --linear-scan or --tables.", 1},
+  { 'k', "compact-scan", NULL, "Generate a scanner whose transition table stores each distinct row once, with the states sharing a row referring to it, and stores a row that differs from an earlier row in only a few columns as that row plus the differing transitions. For scanners with many similar states, for instance inside string literals and comments, this makes the table a fraction of its size at the cost of an indirection on each transition. Cannot be combined with --lazy-dfa.", 0},
+  { 's', "segmented-stack", NULL, "Generate a parser whose stack grows by allocating additional segments rather than by reallocating it. Symbol data on the stack is never moved once constructed, so no move snippets run as the stack grows and pointers to symbol data remain valid for as long as the symbol is on the stack. Costs an extra indirection on each access to the stack.", 0},
+  { 'b', "batch", "<manifest>", "Generate all grammars listed in the manifest file in a single run, rather than a single grammar. Each line of the manifest holds the arguments for one grammar as they would otherwise appear on the command line, for instance \"grammar.cbrt --c grammar.c --h\"; arguments containing spaces can be enclosed in double quotes and a # starts a comment. Each grammar must have a C or tables output filename. Output files whose content would not change are left untouched, so anything depending on them is not rebuilt. If manifest is '-' (an isolated dash) it is read from standard input. No input file or other flags may be specified alongside --batch, except for --jobs and --cache-dir.", 1},
+  { 'j', "jobs", "<count>", "Generate up to count grammars of a --batch concurrently, each on its own thread (default 1).", 1},
+  { 'T', "tables", "<filename>", "Write the scanner and parse tables to filename as a binary image, for loading at runtime by the generic driver in runtime/cbrt_tables.c rather than compiling a generated parser. The driver runs callbacks in place of the action code of the grammar. The image is in the byte order of the machine that generated it. Unless --c or --h is also specified, no C file is generated.", 1},
+  { 'C', "cache-dir", "<dir>", "Keep the tables that are expensive to construct (the parse table, the scanner and the UTF-8 decoder) in directory dir, which must exist. The tables are keyed on the structure of the grammar; its symbols, productions, %prefer/%over directives, patterns and modes. A later run for a grammar of the same structure, for instance after only action code or types were edited, loads the tables rather than constructing them again. When specified alongside --batch, applies to all grammars in the manifest that do not specify their own.", 1},
+  { 'i', "instrument", NULL, "Generate a parser that counts how often each row and column of its scanner and parse tables is used, and a function \"int <prefix>profile_write(const char *filename)\" that writes the counts to a profile for --profile, returning 0 upon success. The counts are kept for the program as a whole, and are not updated atomically. Cannot be combined with --lazy-dfa or --profile.", 0},
+  { 'p', "profile", "<filename>", "Renumber the scan states, symbol groups, parse states and terminals so those used most often, according to the profile in filename, are adjacent in the tables and so share cache lines and pages. The profile is written by a parser of the same grammar generated with --instrument (and without --profile), profiles of several runs can be concatenated. Parts of the profile that no longer fit the grammar are ignored with a warning. Note that the values of the terminals change. Cannot be combined with --lazy-dfa.", 1}
 };
 
 int process_option(int argc, const char **argv, int *arg_index, int permit_default_arg) {
@@ -279,9 +288,10 @@ void print_usage(FILE *fp) {
               "https://carburetta.com/\n"
               "\n"
               "carburetta <inputfile.cbrt> <flags>\n"
+              "carburetta --batch <manifest> [--jobs <count>] [--cache-dir <dir>]\n"
               "\n"
               "<inputfile.cbrt>\n"
-              "         The input file containing the grammar (mandatory). If '-' (an isolated dash) is specified, then carburetta will read from standard input.\n"
+              "         The input file containing the grammar (mandatory, unless --batch is specified). If '-' (an isolated dash) is specified, then carburetta will read from standard input.\n"
               "\n"        
               "<flags>\n"
   );
@@ -302,76 +312,170 @@ void print_version(FILE *fp) {
   fprintf(fp, "Carburetta " CARBURETTA_VERSION_STR "\n");
 }
 
-int main(int argc, char **argv) {
-  int r;
+/* A job generates the output for a single grammar; normally carburetta runs a single job for the
+ * grammar on its command line, in batch mode it runs a job for each grammar in the manifest.
+ * If we fail execution (eg. user error in the input or an unforeseen problem internally) then we
+ * wish to retain whatever output was already there. Consequently, we write output to a temp file,
+ * and only rename it to the final file if execution completes successfully; a job that fails
+ * deletes the temp file it was writing. */
+struct carburetta_job {
+  struct carburetta_context cc_;
+
+  char *input_filename_;
+  int read_from_stdin_:1;
+  int generate_cfile_:1; /* --c was specified */
+  int generate_hfile_:1;
+
+  /* Set to leave an output file untouched (including its timestamp) if the newly generated output
+   * is identical to it, so whatever depends on it is not rebuilt. */
+  int only_write_changes_:1;
+
+  /* Output file being written and its temp filename, NULL when not writing */
+  char *temp_output_filename_;
+  FILE *temp_output_file_;
+
+  /* EXIT_SUCCESS or EXIT_FAILURE once the job has run */
+  int exit_code_;
+};
 
-  r = ldl_init();
-  if (r) {
-    re_error_nowhere("Failed to initialize ldl");
-    return EXIT_FAILURE;
+static void job_init(struct carburetta_job *job) {
+  carburetta_context_init(&job->cc_);
+  job->input_filename_ = NULL;
+  job->read_from_stdin_ = 0;
+  job->generate_cfile_ = 0;
+  job->generate_hfile_ = 0;
+  job->only_write_changes_ = 0;
+  job->temp_output_filename_ = NULL;
+  job->temp_output_file_ = NULL;
+  job->exit_code_ = EXIT_FAILURE;
+}
+
+static void job_discard_temp_output(struct carburetta_job *job) {
+  if (job->temp_output_file_) {
+    fclose(job->temp_output_file_);
+    job->temp_output_file_ = NULL;
   }
-  r = tok_init();
-  if (r) {
-    re_error_nowhere("Failed to initialize tok");
-    return EXIT_FAILURE;
+  if (job->temp_output_filename_) {
+    remove(job->temp_output_filename_);
+    free(job->temp_output_filename_);
+    job->temp_output_filename_ = NULL;
   }
-  r = las_init();
-  if (r) {
-    re_error_nowhere("Failed to initialize las");
-    return EXIT_FAILURE;
-  }
-  r = dct_init();
-  if (r) {
-    re_error_nowhere("Failed to initialize dct");
-    return EXIT_FAILURE;
+}
+
+static void job_cleanup(struct carburetta_job *job) {
+  job_discard_temp_output(job);
+  carburetta_context_cleanup(&job->cc_);
+  if (job->input_filename_) free(job->input_filename_);
+}
+
+/* Closes the temp output file and renames it to filename, replacing any prior file. Returns 0
+ * upon success, non-zero upon failure. */
+static int complete_output(struct carburetta_job *job, const char *filename) {
+  fclose(job->temp_output_file_);
+  job->temp_output_file_ = NULL;
+
+  if (job->only_write_changes_ && to_same_content(job->temp_output_filename_, filename)) {
+    job_discard_temp_output(job);
+    return 0;
   }
 
-  struct carburetta_context cc;
-  carburetta_context_init(&cc);
+  /* don't care if this fails, file likely does not exist. */
+  remove(filename);
 
-  struct prd_grammar prdg;
-  prd_grammar_init(&prdg);
+  if (rename(job->temp_output_filename_, filename)) {
+    int err = errno;
+    re_error_nowhere("Failed to complete output to file \"%s\": %s", filename, strerror(err));
+    return -1;
+  }
 
-  struct grammar_table gt;
-  gt_grammar_table_init(&gt);
+  free(job->temp_output_filename_);
+  job->temp_output_filename_ = NULL;
+  return 0;
+}
 
-  struct lr_generator lalr;
-  lr_init(&lalr);
+/* Options that apply to the carburetta process as a whole, rather than to a single grammar */
+struct process_args {
+  const char *manifest_filename_;
+  int num_threads_;
 
-  struct rex_scanner rex;
-  rex_init(&rex);
+  /* Number of arguments that apply to a single grammar, including the input filename */
+  int num_job_args_;
+};
+
+#define ARGS_PROCEED 0
+#define ARGS_EXIT_SUCCESS 1
+#define ARGS_EXIT_FAILURE 2
 
-  int generate_cfile = 1;
-  int generate_hfile = 0;
-  char *input_filename = NULL;
+static int is_process_option(int option) {
+  return (option == 'H') || (option == 'v') || (option == '?') || (option == 'b') || (option == 'j');
+}
 
+/* Parses the arguments for a single grammar into job. If pa is NULL, the arguments come from a
+ * batch manifest and options that apply to the process as a whole are not permitted.
+ * Returns ARGS_PROCEED, ARGS_EXIT_SUCCESS (nothing to generate, eg. help was requested) or
+ * ARGS_EXIT_FAILURE (error already reported.) */
+static int parse_job_args(struct carburetta_job *job, struct process_args *pa, int argc, const char **argv) {
+  struct carburetta_context *cc = &job->cc_;
   int option_index = 0;
   int have_input_file = 0;
-  int read_from_stdin = 0;
   int option;
   do {
-    option = process_option(argc, (const char **)argv, &option_index, !have_input_file);
+    option = process_option(argc, argv, &option_index, !have_input_file);
+    if (is_process_option(option)) {
+      if (!pa) {
+        /* Options with a value have already advanced past the option itself */
+        re_error_nowhere("Error: option %s not permitted in a batch manifest", argv[((option == 'b') || (option == 'j')) ? option_index - 1 : option_index]);
+        return ARGS_EXIT_FAILURE;
+      }
+    }
+    else if (option && pa && (option != 'C')) {
+      /* --cache-dir is both; alongside --batch it is the default for the grammars in the manifest */
+      pa->num_job_args_++;
+    }
     switch (option) {
       case 0:
         break;
       case 'H':
         print_usage(stdout);
-        goto exit_arg_eval_success;
+        return ARGS_EXIT_SUCCESS;
       case 'v':
         print_version(stdout);
-        goto exit_arg_eval_success;
+        return ARGS_EXIT_SUCCESS;
+      case 'b':
+        if (option_index == argc) {
+          re_error_nowhere("Error: --batch requires a manifest filename");
+          print_usage(stderr);
+          return ARGS_EXIT_FAILURE;
+        }
+        pa->manifest_filename_ = argv[option_index];
+        break;
+      case 'j': {
+        char *endp = NULL;
+        long num_threads = 0;
+        if (option_index < argc) {
+          num_threads = strtol(argv[option_index], &endp, 10);
+        }
+        if (!endp || *endp || (num_threads < 1) || (num_threads > 1024)) {
+          re_error_nowhere("Error: --jobs requires a count between 1 and 1024");
+          print_usage(stderr);
+          return ARGS_EXIT_FAILURE;
+        }
+        pa->num_threads_ = (int)num_threads;
+        break;
+      }
       case 'c':
+        job->generate_cfile_ = 1;
         if ((option_index < argc) && (argv[option_index])[0] != '-') {
           /* filename specified */
-          if (cc.c_output_filename_) {
+          if (cc->c_output_filename_) {
             re_error_nowhere("Error: only one C output file permitted");
             print_usage(stderr);
-            goto exit_arg_eval;
+            return ARGS_EXIT_FAILURE;
           }
-          cc.c_output_filename_ = strdup(argv[option_index]);
-          if (!cc.c_output_filename_) {
+          cc->c_output_filename_ = strdup(argv[option_index]);
+          if (!cc->c_output_filename_) {
             re_error_nowhere("Error: no memory");
-            goto exit_arg_eval;
+            return ARGS_EXIT_FAILURE;
           }
         }
         else {
@@ -380,18 +484,18 @@ int main(int argc, char **argv) {
         }
         break;
       case 'h':
-        generate_hfile = 1;
+        job->generate_hfile_ = 1;
         if ((option_index < argc) && (argv[option_index])[0] != '-') {
           /* filename specified */
-          if (cc.c_output_filename_) {
+          if (cc->c_output_filename_) {
             re_error_nowhere("Error: only one C output file permitted");
             print_usage(stderr);
-            goto exit_arg_eval;
+            return ARGS_EXIT_FAILURE;
           }
-          cc.c_output_filename_ = strdup(argv[option_index]);
-          if (!cc.c_output_filename_) {
+          cc->c_output_filename_ = strdup(argv[option_index]);
+          if (!cc->c_output_filename_) {
             re_error_nowhere("Error: no memory");
-            goto exit_arg_eval;
+            return ARGS_EXIT_FAILURE;
           }
         }
         else if ((option_index < argc) && !strcmp(argv[option_index], "-")) {
@@ -403,634 +507,276 @@ int main(int argc, char **argv) {
         }
         break;
       case '8':
-        if (cc.utf8_experimental_) {
+        if (cc->utf8_experimental_) {
           re_error_nowhere("Deprecated: --x-utf8 not necessary, UTF-8 is now the default");
         }
-        cc.utf8_experimental_ = 1;
+        cc->utf8_experimental_ = 1;
         break;
       case 'r':
-        cc.utf8_experimental_ = 0;
+        cc->utf8_experimental_ = 0;
         break;
       case 'L':
-        cc.emit_line_directives_ = 0;
+        cc->emit_line_directives_ = 0;
         break;
       case 'n':
-        cc.emit_symbol_name_table_ = 1;
+        cc->emit_symbol_name_table_ = 1;
+        break;
+      case 'l':
+        cc->linear_scan_ = 1;
+        break;
+      case 'g':
+        cc->computed_goto_ = 1;
+        break;
+      case 'k':
+        cc->compact_scan_ = 1;
+        break;
+      case 'd': {
+        char *endp = NULL;
+        long max_states = 0;
+        if (option_index < argc) {
+          max_states = strtol(argv[option_index], &endp, 10);
+        }
+        if (!endp || *endp || (max_states < 1) || (max_states > 0x1000000)) {
+          re_error_nowhere("Error: --lazy-dfa requires a number of states between 1 and 16777216");
+          print_usage(stderr);
+          return ARGS_EXIT_FAILURE;
+        }
+        cc->lazy_dfa_max_states_ = (size_t)max_states;
+        break;
+      }
+      case 's':
+        cc->segmented_stack_ = 1;
+        break;
+      case 'T':
+        if (option_index == argc) {
+          re_error_nowhere("Error: --tables requires a filename");
+          print_usage(stderr);
+          return ARGS_EXIT_FAILURE;
+        }
+        if (cc->tables_filename_) {
+          re_error_nowhere("Error: only one tables output file permitted");
+          print_usage(stderr);
+          return ARGS_EXIT_FAILURE;
+        }
+        cc->tables_filename_ = strdup(argv[option_index]);
+        if (!cc->tables_filename_) {
+          re_error_nowhere("Error: no memory");
+          return ARGS_EXIT_FAILURE;
+        }
+        break;
+      case 'C':
+        if (option_index == argc) {
+          re_error_nowhere("Error: --cache-dir requires a directory");
+          print_usage(stderr);
+          return ARGS_EXIT_FAILURE;
+        }
+        if (cc->cache_dir_) free(cc->cache_dir_);
+        cc->cache_dir_ = strdup(argv[option_index]);
+        if (!cc->cache_dir_) {
+          re_error_nowhere("Error: no memory");
+          return ARGS_EXIT_FAILURE;
+        }
+        break;
+      case 'i':
+        cc->instrument_ = 1;
+        break;
+      case 'p':
+        if (option_index == argc) {
+          re_error_nowhere("Error: --profile requires a filename");
+          print_usage(stderr);
+          return ARGS_EXIT_FAILURE;
+        }
+        if (cc->profile_filename_) {
+          re_error_nowhere("Error: only one profile permitted");
+          print_usage(stderr);
+          return ARGS_EXIT_FAILURE;
+        }
+        cc->profile_filename_ = strdup(argv[option_index]);
+        if (!cc->profile_filename_) {
+          re_error_nowhere("Error: no memory");
+          return ARGS_EXIT_FAILURE;
+        }
         break;
       case '?':
         print_usage(stdout);
-        goto exit_arg_eval_success;
+        return ARGS_EXIT_SUCCESS;
       case '-':
         /* default argument */
         if (!strcmp("-", argv[option_index])) {
           /* read from stdin */
-          input_filename = strdup("(stdin)");
+          job->input_filename_ = strdup("(stdin)");
           /* Reading from standard input implies no line directives */
-          cc.emit_line_directives_ = 0;
-          read_from_stdin = 1;
+          cc->emit_line_directives_ = 0;
+          job->read_from_stdin_ = 1;
         }
         else {
-          input_filename = strdup(argv[option_index]);
+          job->input_filename_ = strdup(argv[option_index]);
         }
-        if (!input_filename) {
+        if (!job->input_filename_) {
           re_error_nowhere("Error: no memory");
-          goto exit_arg_eval;
+          return ARGS_EXIT_FAILURE;
         }
         have_input_file = 1;
         break;
       default:
         re_error_nowhere("Error: unknown option");
         print_usage(stderr);
-        goto exit_arg_eval;
+        return ARGS_EXIT_FAILURE;
     }
   } while (option);
 
-  if (!input_filename) {
+  return ARGS_PROCEED;
+}
+
+/* Checks the parsed arguments of job for completeness and derives the header filename, if
+ * needed. Returns 0 upon success, non-zero upon failure (error already reported.) */
+static int finish_job_args(struct carburetta_job *job) {
+  struct carburetta_context *cc = &job->cc_;
+  if (!job->input_filename_) {
     re_error_nowhere("Error: need an input filename");
     print_usage(stderr);
-    goto exit_arg_eval;
+    return -1;
   }
 
-  if (generate_hfile && !cc.h_output_filename_) {
-    if (!cc.c_output_filename_) {
+  if (job->generate_hfile_ && !cc->h_output_filename_) {
+    if (!cc->c_output_filename_) {
       re_error_nowhere("Error: Need C output filename to derive a C header output filename");
-      goto exit_arg_eval;
+      return -1;
     }
-    const char *ext = strrchr(cc.c_output_filename_, '.');
+    const char *ext = strrchr(cc->c_output_filename_, '.');
     if (!ext || (strlen(ext) < 2)) {
       re_error_nowhere("Error: Need C output filename that ends in a filename extension to derive a C header output filename");
-      goto exit_arg_eval;
-    }
-    cc.h_output_filename_ = strdup(cc.c_output_filename_);
-
-    memcpy(cc.h_output_filename_ + (ext - cc.c_output_filename_), ".h", 3 /* inc terminator */);
-  }
-
-  if (read_from_stdin && cc.emit_line_directives_) {
-    re_error_nowhere("Error: Cannot emit #line directives when source is standard input and not a filename. (add --nolinedir or specify an input file.)");
-    print_usage(stderr);
-    goto exit_arg_eval;
-  }
-
-  if (0) {
-    int rv;
-  exit_arg_eval_success:
-    rv = EXIT_SUCCESS;
-    goto exit_arg_eval_i;
-  exit_arg_eval:
-    rv = EXIT_FAILURE;
-  exit_arg_eval_i:
-    carburetta_context_cleanup(&cc);
-    if (input_filename) free(input_filename);
-    return rv;
-  }
-
-  FILE *fp = NULL;
-  if (!read_from_stdin) {
-    fp = fopen(input_filename, "rb");
-    if (!fp) {
-      int err = errno;
-      re_error_nowhere("Failed to open file \"%s\": %s", input_filename, strerror(err));
-      r = EXIT_FAILURE;
-      goto cleanup_exit;
+      return -1;
     }
-    fprintf(stderr, "%s\n", input_filename);
-  }
-  else {
-    fp = stdin;
-  }
-
-  r = pi_parse_input(fp, input_filename, &cc, &prdg);
-  if (r) {
-    r = EXIT_FAILURE;
-    goto cleanup_exit;
-  }
-
-  /* Assign types to all symbols */
-  struct symbol *sym;
-
-  /* Assign the token type to tokens that don't yet have a type assigned. */
-  sym = cc.symtab_.terminals_;
-  if (sym) {
-    do {
-      sym = sym->next_;
-
-      if (!sym->assigned_type_) {
-        sym->assigned_type_ = cc.token_assigned_type_;
-      }
-    } while (sym != cc.symtab_.terminals_);
-  }
-
-  /* Ensure we have error and end-of-input tokens */
-  if (!cc.error_sym_) {
-    struct xlts error_id;
-    xlts_init(&error_id);
-    r = xlts_append_xlat(&error_id, strlen("error"), "error");
-    if (r) {
-      re_error_nowhere("Error: no memory");
-      r = EXIT_FAILURE;
-      goto cleanup_exit;
-    }
-    int is_new = 0;
-    struct symbol *sym = symbol_find_or_add(&cc.symtab_, SYM_TERMINAL, &error_id, &is_new);
-    if (!sym) {
+    cc->h_output_filename_ = strdup(cc->c_output_filename_);
+    if (!cc->h_output_filename_) {
       re_error_nowhere("Error: no memory");
-      r = EXIT_FAILURE;
-      goto cleanup_exit;
+      return -1;
     }
-    if (!is_new) {
-      re_error(&sym->def_, "Error: \"error\" token already in use. Define an error token explicitly using %%error_token or ensure the \"error\" identifier is not used anywhere.");
-      r = EXIT_FAILURE;
-      goto cleanup_exit;
-    }
-    cc.error_sym_ = sym;
-  }
 
-  if (!cc.input_end_sym_) {
-    struct xlts input_end_id;
-    xlts_init(&input_end_id);
-    r = xlts_append_xlat(&input_end_id, strlen("input-end"), "input-end");
-    if (r) {
-      re_error_nowhere("Error: no memory");
-      r = EXIT_FAILURE;
-      goto cleanup_exit;
-    }
-    int is_new = 0;
-    struct symbol *sym = symbol_find_or_add(&cc.symtab_, SYM_TERMINAL, &input_end_id, &is_new);
-    if (!sym) {
-      re_error_nowhere("Error: no memory");
-      r = EXIT_FAILURE;
-      goto cleanup_exit;
-    }
-    if (!is_new) {
-      re_error(&sym->def_, "Error: \"error\" token already in use. Define an error token explicitly using %%error_token or ensure the \"error\" identifier is not used anywhere.");
-      r = EXIT_FAILURE;
-      goto cleanup_exit;
-    }
-    cc.input_end_sym_ = sym;
+    memcpy(cc->h_output_filename_ + (ext - cc->c_output_filename_), ".h", 3 /* inc terminator */);
   }
 
-  /* Number all symbols */
-  int RULE_END, GRAMMAR_END;
-  RULE_END = 1;
-  GRAMMAR_END = 2;
-  int next_ordinal;
-  next_ordinal = 3;
-  sym = cc.symtab_.terminals_;
-  if (sym) {
-    do {
-      sym = sym->next_;
-
-      if ((sym != cc.error_sym_) && (sym != cc.input_end_sym_)) {
-        sym->ordinal_ = next_ordinal++;
-      }
-    } while (sym != cc.symtab_.terminals_);
-  }
-  cc.error_sym_->ordinal_ = next_ordinal++;
-  cc.input_end_sym_->ordinal_ = next_ordinal++;
-  int INPUT_END;
-  INPUT_END = cc.input_end_sym_->ordinal_;
-  sym = cc.symtab_.non_terminals_;
-  if (sym) {
-    do {
-      sym = sym->next_;
-
-      sym->ordinal_ = next_ordinal++;
-    } while (sym != cc.symtab_.non_terminals_);
-  }
-  int SYNTHETIC_S;
-  SYNTHETIC_S = next_ordinal++;
-
-  /* Resolve all symbol references in the productions */
-  size_t prod_idx;
-  for (prod_idx = 0; prod_idx < prdg.num_productions_; ++prod_idx) {
-    struct prd_production *prod = prdg.productions_ + prod_idx;
-    if (!prod->nt_.id_.num_translated_) {
-      prdg.have_errors_ = 1;
-      continue;
-    }
-    struct symbol *sym = symbol_find(&cc.symtab_, prod->nt_.id_.translated_);
-    if (!sym || (sym->st_ != SYM_NONTERMINAL)) {
-      re_error(&prod->nt_.id_, "Error, symbol \"%s\" not declared as %%nt", prod->nt_.id_.translated_);
-      prdg.have_errors_ = 1;
-    }
-    else {
-      prod->nt_.sym_ = sym;
-    }
-    size_t sym_idx;
-    for (sym_idx = 0; sym_idx < prod->num_syms_; ++sym_idx) {
-      struct prd_production_sym *prod_sym = prod->syms_ + sym_idx;
-      if (!prod_sym->id_.num_translated_) {
-        prdg.have_errors_ = 1;
-        continue;
-      }
-      sym = symbol_find(&cc.symtab_, prod_sym->id_.translated_);
-      if (!sym) {
-        re_error(&prod_sym->id_, "Error, symbol \"%s\" was not declared as %%nt or %%token", prod_sym->id_.translated_);
-        prdg.have_errors_ = 1;
-        continue;
-      }
-      prod_sym->sym_ = sym;
-    }
+  if (cc->lazy_dfa_max_states_ && cc->linear_scan_) {
+    re_error_nowhere("Error: --lazy-dfa cannot be combined with --linear-scan");
+    return -1;
   }
 
-  /* Resolve all symbol references in the patterns */
-  size_t pat_idx;
-  for (pat_idx = 0; pat_idx < prdg.num_patterns_; ++pat_idx) {
-    struct prd_pattern *pat = prdg.patterns_ + pat_idx;
-    if (!pat->term_.id_.num_translated_) {
-      /* Not resolving to a terminal.. but pattern will still match its action so keep it around */
-      continue;
-    }
-    struct symbol *sym = symbol_find(&cc.symtab_, pat->term_.id_.translated_);
-    if (!sym) {
-      re_error(&pat->term_.id_, "Error, symbol \"%s\" not declared as %%token", pat->term_.id_.translated_);
-      prdg.have_errors_ = 1;
-    }
-    else if (sym->st_ != SYM_TERMINAL) {
-      re_error(&pat->term_.id_, "Error, pattern symbol \"%s\" must be declared as %%token, not as %%nt", pat->term_.id_.translated_);
-      prdg.have_errors_ = 1;
-    }
-    else {
-      pat->term_.sym_ = sym;
-    }
+  if (cc->lazy_dfa_max_states_ && cc->tables_filename_) {
+    re_error_nowhere("Error: --lazy-dfa cannot be combined with --tables, the tables image holds the DFA");
+    return -1;
   }
 
-  if (prdg.have_errors_) {
-    r = EXIT_FAILURE;
-    goto cleanup_exit;
+  if (cc->lazy_dfa_max_states_ && (cc->instrument_ || cc->profile_filename_)) {
+    re_error_nowhere("Error: --lazy-dfa cannot be combined with --instrument or --profile, its states are numbered as the input reaches them");
+    return -1;
   }
 
-  /* Take the production "syntax tree" and transcribe it into the form used for consumption by lalr.c */
-  r = gt_transcribe_grammar(&gt, prdg.num_productions_, prdg.productions_, RULE_END, GRAMMAR_END);
-  if (r) {
-    r = EXIT_FAILURE;
-    goto cleanup_exit;
+  if (cc->lazy_dfa_max_states_ && cc->compact_scan_) {
+    re_error_nowhere("Error: --lazy-dfa cannot be combined with --compact-scan, it has no DFA table to compact");
+    return -1;
   }
 
-  //gt_debug_grammar(&gt, prdg.num_productions_, prdg.productions_, RULE_END, GRAMMAR_END);
-
-  /* Resolve all conflict resolutions */
-  struct conflict_resolution *confres;
-  confres = cc.conflict_resolutions_;
-  if (confres) {
-    do {
-      confres = confres->next_;
-
-      struct prd_production *prods[] = {
-        &confres->prefer_prod_,
-        &confres->over_prod_
-      };
-
-      size_t matches[sizeof(prods) / sizeof(*prods)];
-      
-      size_t n;
-      for (n = 0; n < sizeof(prods) / sizeof(*prods); ++n) {
-        int had_failed_lookup = 0;
-        struct prd_production *prod = prods[n];
-
-        prod->nt_.sym_ = symbol_find(&cc.symtab_, prod->nt_.id_.translated_);
-        if (!prod->nt_.sym_ || (prod->nt_.sym_->st_ != SYM_NONTERMINAL)) {
-          re_error(&prod->nt_.id_, "Error, symbol \"%s\" was not declared as %%nt", prod->nt_.id_.translated_);
-          prdg.have_errors_ = 1;
-          had_failed_lookup = 1;
-        }
-        size_t sym_idx;
-        for (sym_idx = 0; sym_idx < prod->num_syms_; ++sym_idx) {
-          struct prd_production_sym *ps = prod->syms_ + sym_idx;
-          ps->sym_ = symbol_find(&cc.symtab_, ps->id_.translated_);
-          if (!ps->sym_) {
-            re_error(&prod->nt_.id_, "Error, symbol \"%s\" was not declared as %%nt or %%token", ps->id_.translated_);
-            prdg.have_errors_ = 1;
-            had_failed_lookup = 1;
-          }
-        }
-
-        if (had_failed_lookup) {
-          continue;
-        }
-        /* Find a match; if possible */
-        size_t prod_idx;
-        for (prod_idx = 0; prod_idx < prdg.num_productions_; ++prod_idx) {
-          struct prd_production *gp = prdg.productions_ + prod_idx;
-          if (gp->nt_.sym_ != prod->nt_.sym_) {
-            continue;
-          }
-          if (gp->num_syms_ != prod->num_syms_) {
-            continue;
-          }
-          for (sym_idx = 0; sym_idx < prod->num_syms_; ++sym_idx) {
-            if (gp->syms_[sym_idx].sym_ != prod->syms_[sym_idx].sym_) {
-              break;
-            }
-          }
-          if (sym_idx != prod->num_syms_) {
-            continue;
-          }
-          /* Production matches */
-          break;
-        }
-        if (prod_idx != prdg.num_productions_) {
-          /* Production prod_idx matches */
-          matches[n] = prod_idx;
-        }
-        else {
-          re_error(&prod->nt_.id_, "Error, no matching production found");
-          prdg.have_errors_ = 1;
-        }
-      }
-
-      /* Productions are 1 based for LALR (as production 0 is the synthetic S reduction) */
-      r = lr_add_conflict_resolution(&lalr, 1 + (int)matches[0], confres->prefer_prod_place_, 1 + (int)matches[1], confres->over_prod_place_);
-      if (r) {
-        re_error_nowhere("Error, no memory");
-        r = EXIT_FAILURE;
-        goto cleanup_exit;
-      }
-
-    } while (confres != cc.conflict_resolutions_);
+  if (cc->instrument_ && cc->profile_filename_) {
+    re_error_nowhere("Error: --instrument cannot be combined with --profile, profiles are collected from tables as they were constructed");
+    return -1;
   }
 
-  if (prdg.have_errors_) {
-    r = EXIT_FAILURE;
-    goto cleanup_exit;
+  if (job->read_from_stdin_ && cc->emit_line_directives_) {
+    re_error_nowhere("Error: Cannot emit #line directives when source is standard input and not a filename. (add --nolinedir or specify an input file.)");
+    print_usage(stderr);
+    return -1;
   }
 
-  r = gt_generate_lalr(&gt, &lalr, RULE_END, GRAMMAR_END, INPUT_END, SYNTHETIC_S);
-  if (r == GT_CONFLICTS) {
-    struct lr_conflict_pair *cp;
-    for (cp = lalr.conflicts_; cp; cp = cp->chain_) {
-      /* NOTE: lalr parser inserts a rule 0, so consider all conflicts 1-based. */
-      struct {
-        int production, position;
-      } conflict[2] = {
-        {cp->production_a_ - 1, cp->position_a_},
-        {cp->production_b_ - 1, cp->position_b_}
-      };
-      size_t n;
-      const char *a;
-      const char *b;
-      if (conflict[0].position == (int)prdg.productions_[conflict[0].production].num_syms_) {
-        /* A = reduce */
-        a = "reduce";
-      }
-      else {
-        a = "shift";
-      }
-      if (conflict[1].position == (int)prdg.productions_[conflict[1].production].num_syms_) {
-        /* B = reduce */
-        b = "reduce";
-      }
-      else {
-        b = "shift";
-      }
+  return 0;
+}
 
-      re_error_nowhere("Error, %s/%s conflict found:", a, b);
-      for (n = 0; n < sizeof(conflict) / sizeof(*conflict); ++n) {
-        int prod_idx, pos_idx;
-        prod_idx = conflict[n].production;
-        pos_idx = conflict[n].position;
-        struct prd_production *gp = prdg.productions_ + prod_idx;
-        size_t sym_idx;
-        size_t msg_size = 0;
-        msg_size = gp->nt_.id_.num_translated_ + 2 /* ": " */;
-        for (sym_idx = 0; sym_idx < gp->num_syms_; ++sym_idx) {
-          msg_size += gp->syms_[sym_idx].id_.num_translated_ + 1 /* " " */;
-        }
-        msg_size += 2 /* " *" */;
+/* Generates the output for the grammar of job, returns EXIT_SUCCESS or EXIT_FAILURE. */
+static int generate(struct carburetta_job *job) {
+  int r;
+  struct carburetta_context *cc = &job->cc_;
 
-        if (sym_idx == (size_t)pos_idx) {
-          msg_size += strlen(" (reduce)");
-        }
-        else {
-          msg_size += strlen(" (shift)");
-        }
+  struct prd_grammar prdg;
+  prd_grammar_init(&prdg);
 
-        msg_size++ /* '\0' */;
+  struct grammar_table gt;
+  gt_grammar_table_init(&gt);
 
-        char *msg = (char *)malloc(msg_size);
-        if (!msg) {
-          re_error_nowhere("Error, no memory");
-          r = EXIT_FAILURE;
-          goto cleanup_exit;
-        }
+  struct lr_generator lalr;
+  lr_init(&lalr);
 
-        msg[0] = '\0';
-        strcat(msg, gp->nt_.id_.translated_);
-        strcat(msg, ":");
+  struct rex_scanner rex;
+  rex_init(&rex);
 
-        for (sym_idx = 0; sym_idx < gp->num_syms_; ++sym_idx) {
-          if (sym_idx == (size_t)pos_idx) strcat(msg, " *");
-          strcat(msg, " ");
-          strcat(msg, gp->syms_[sym_idx].id_.translated_);
-        }
-        if (sym_idx == (size_t)pos_idx) {
-          strcat(msg, " * (reduce)");
-        }
-        else {
-          strcat(msg, " (shift)");
-        }
+  /* With only --tables, the tables are all the output */
+  int generate_cfile = !cc->tables_filename_ || job->generate_cfile_ || job->generate_hfile_;
 
-        re_error(&gp->nt_.id_, msg);
-        free(msg);
-      }
+  FILE *fp = NULL;
+  if (!job->read_from_stdin_) {
+    fp = fopen(job->input_filename_, "rb");
+    if (!fp) {
+      int err = errno;
+      re_error_nowhere("Failed to open file \"%s\": %s", job->input_filename_, strerror(err));
+      r = EXIT_FAILURE;
+      goto cleanup_exit;
     }
-    re_error_nowhere("(Use %%prefer %%over directives to force resolution of conflicts)");
+    fprintf(stderr, "%s\n", job->input_filename_);
   }
-  if (r) {
-    r = EXIT_FAILURE;
-    goto cleanup_exit;
+  else {
+    fp = stdin;
   }
 
-  struct mode *default_mode;
-  struct xlts default_keyword;
-  xlts_init(&default_keyword);
-  xlts_append_xlat(&default_keyword, strlen("default"), "default");
-  int is_default_new = -1;
-  default_mode = mode_find_or_add(&cc.modetab_, &default_keyword, &is_default_new);
-  xlts_cleanup(&default_keyword);
-  if (!default_mode) {
-    re_error_nowhere("Error, no memory");
+  r = pi_parse_input(fp, job->input_filename_, cc, &prdg);
+  if (r) {
     r = EXIT_FAILURE;
     goto cleanup_exit;
   }
-  if (!is_default_new) {
-    re_error(&default_mode->def_, "Error, \"default\" mode is implicit and should not be explicitly declared");
+
+  if (bt_build_tables(cc, &prdg, &gt, &rex, &lalr)) {
     r = EXIT_FAILURE;
     goto cleanup_exit;
   }
-  /* Make sure that the "default" mode gets the first rex_mode allocation is
-   * this has consequences for the order of the states in the final table */
-  r = rex_add_mode(&rex, &default_mode->rex_mode_);
-  if (r) {
-    switch (r) {
-    case _REX_NO_MEMORY:
-      re_error_nowhere("Error, no memory");
-      r = EXIT_FAILURE;
-      goto cleanup_exit;
-    default:
-      /* All errors here are internal */
-      re_error_nowhere("Internal error");
-      r = EXIT_FAILURE;
-      goto cleanup_exit;
-    }
-  }
-
-  struct mode *m;
-  m = cc.modetab_.modes_;
-  if (m) {
-    do {
-      m = m->next_;
-
-      if (!m->rex_mode_) {
-        r = rex_add_mode(&rex, &m->rex_mode_);
-        if (r) {
-          switch (r) {
-          case _REX_NO_MEMORY:
-            re_error_nowhere("Error, no memory");
-            r = EXIT_FAILURE;
-            goto cleanup_exit;
-          default:
-            /* All errors here are internal */
-            re_error_nowhere("Internal error");
-            r = EXIT_FAILURE;
-            goto cleanup_exit;
-          }
-        }
-      }
-    } while (m != cc.modetab_.modes_);
-  }
 
-  if (prdg.num_patterns_) {
-    size_t n;
-    for (n = 0; n < prdg.num_patterns_; ++n) {
-      struct prd_pattern *prd_pat = prdg.patterns_ + n;
-      r = rex_add_pattern(&rex, prd_pat->regex_, n + 1, &prd_pat->pat_);
-      if (r) {
-        /* Failure occurred, report */
-        switch (r) {
-        case _REX_NO_MEMORY:
-          re_error_nowhere("Error, no memory");
-          r = EXIT_FAILURE;
-          goto cleanup_exit;
-        case _REX_SYNTAX_ERROR:
-        case _REX_LEXICAL_ERROR:
-          /* The regex should already be validated to be
-          * a correct regular expression (otherwise */
-          re_error_nowhere("Internal error, inconsistent syntax");
-          r = EXIT_FAILURE;
-          goto cleanup_exit;
-        default:
-          /* All errors here are internal */
-          re_error_nowhere("Internal error");
-          r = EXIT_FAILURE;
-          goto cleanup_exit;
-        }
-      }
-    }
-  }
+  FILE *outfp;
+  outfp = NULL;
 
-  size_t mode_group_idx;
-  int have_error = 0;
-  for (mode_group_idx = 0; mode_group_idx < prdg.num_mode_groups_; ++mode_group_idx) {
-    struct prd_mode_group *mg = prdg.mode_groups_ + mode_group_idx;
-    size_t mode_group_mode_idx;
-    for (mode_group_mode_idx = 0; mode_group_mode_idx < mg->num_modes_; ++mode_group_mode_idx) {
-      struct prd_mode *md = mg->modes_ + mode_group_mode_idx;
-      struct mode *m = mode_find(&cc.modetab_, md->id_.translated_);
-      if (!m) {
-        re_error(&md->id_, "Error, mode \"%s\" not declared using %%mode", md->id_.translated_);
-        have_error = 1;
-      }
-      else {
-        size_t n;
-        for (n = mg->pattern_start_index_; n < mg->pattern_end_index_; ++n) {
-          struct prd_pattern *prd_pat = prdg.patterns_ + n;
-          r = rex_add_pattern_to_mode(m->rex_mode_, prd_pat->pat_);
-          prd_pat->touched_by_mode_ = 1;
-          if (r) {
-            switch (r) {
-            case _REX_NO_MEMORY:
-              re_error_nowhere("Error, no memory");
-              r = EXIT_FAILURE;
-              goto cleanup_exit;
-            default:
-              /* All errors here are internal */
-              re_error_nowhere("Internal error");
-              r = EXIT_FAILURE;
-              goto cleanup_exit;
-            }
-          }
-        }
+  if (cc->tables_filename_) {
+    if (cc->utf8_experimental_ && prdg.num_patterns_ && !cc->utf8_decoder_table_) {
+      /* Build it once, for both the tables and the C file */
+      if (emit_utf8_decoder_table(&rex.dfa_, &cc->utf8_decoder_num_rows_, &cc->utf8_decoder_table_)) {
+        r = EXIT_FAILURE;
+        goto cleanup_exit;
       }
     }
-  }
-  if (have_error) {
-    r = EXIT_FAILURE;
-    goto cleanup_exit;
-  }
-  /* Add any untouched patterns to the default mode */
-  size_t pattern_index;
-  for (pattern_index = 0; pattern_index < prdg.num_patterns_; ++pattern_index) {
-    struct prd_pattern *pat = prdg.patterns_ + pattern_index;
-    if (!pat->touched_by_mode_) {
-      r = rex_add_pattern_to_mode(default_mode->rex_mode_, pat->pat_);
-      if (r) {
-        switch (r) {
-        case _REX_NO_MEMORY:
-          re_error_nowhere("Error, no memory");
-          r = EXIT_FAILURE;
-          goto cleanup_exit;
-        default:
-          /* All errors here are internal */
-          re_error_nowhere("Internal error");
-          r = EXIT_FAILURE;
-          goto cleanup_exit;
-        }
-      }
+    outfp = to_make_temp(cc->tables_filename_, &job->temp_output_filename_);
+    if (!outfp) {
+      int err = errno;
+      re_error_nowhere("Failed to open file \"%s\" for writing: %s", cc->tables_filename_, strerror(err));
+      r = EXIT_FAILURE;
+      goto cleanup_exit;
     }
-  }
-
-  if (prdg.num_patterns_) {
-    r = rex_realize_modes(&rex);
-    if (!r) {
-      r = rex_dfa_make_symbol_groups(&rex.dfa_);
+    job->temp_output_file_ = outfp;
+    if (ti_write_tables(outfp, cc, &prdg, &rex, &lalr)) {
+      r = EXIT_FAILURE;
+      goto cleanup_exit;
     }
-    if (r) {
-      switch (r) {
-      case _REX_NO_MEMORY:
-        re_error_nowhere("Error, no memory");
-        r = EXIT_FAILURE;
-        goto cleanup_exit;
-      default:
-        /* All errors here are internal */
-        re_error_nowhere("Internal error");
-        r = EXIT_FAILURE;
-        goto cleanup_exit;
-      }
+    if (complete_output(job, cc->tables_filename_)) {
+      r = EXIT_FAILURE;
+      goto cleanup_exit;
     }
-
+    outfp = NULL;
   }
 
-  FILE *outfp;
-  outfp = NULL;
-
-  g_temp_output_filename_ = NULL;
-  g_temp_output_file = NULL;
-  
-  /* Set the exit handler to delete any temp file we have created.. This helps to cleanup in case of failure. */
-  atexit(at_exit_delete_temp_output_handler);
-
   if (generate_cfile) {
-    if (cc.c_output_filename_) {
-      outfp = to_make_temp(cc.c_output_filename_, &g_temp_output_filename_);
+    if (cc->c_output_filename_) {
+      outfp = to_make_temp(cc->c_output_filename_, &job->temp_output_filename_);
       if (!outfp) {
         int err = errno;
-        re_error_nowhere("Failed to open file \"%s\" for writing: %s", cc.c_output_filename_, strerror(err));
+        re_error_nowhere("Failed to open file \"%s\" for writing: %s", cc->c_output_filename_, strerror(err));
         r = EXIT_FAILURE;
         goto cleanup_exit;
       }
-      g_temp_output_file = outfp;
+      job->temp_output_file_ = outfp;
     }
     else {
       outfp = stdout;
@@ -1038,25 +784,25 @@ int main(int argc, char **argv) {
 
     /* Start generating files.. */
 
-    if (cc.h_output_filename_) {
+    if (cc->h_output_filename_) {
       /* First we develop the "include_guard" - this is used by the header file as the "#ifndef HEADER_INCLUDED"
        * header duplicate inclusion guard, and used by the C file to detect whether the header has been included
        * (and the declarations already made.) */
       const char *carburetta = "CARB_";
       size_t carburetta_len = strlen(carburetta);
-      size_t prefix_len = strlen(cc_PREFIX(&cc));
-      size_t header_filename_len = strlen(cc.h_output_filename_);
+      size_t prefix_len = strlen(cc_PREFIX(cc));
+      size_t header_filename_len = strlen(cc->h_output_filename_);
       const char *included = "_INCLUDED";
       size_t included_len = strlen(included);
       size_t include_guard_size = carburetta_len + prefix_len + header_filename_len + included_len + 1;
-      cc.include_guard_ = (char *)malloc(include_guard_size);
-      cc.include_guard_[0] = '\0';
-      strcat(cc.include_guard_, carburetta);
-      strcat(cc.include_guard_, cc_PREFIX(&cc));
+      cc->include_guard_ = (char *)malloc(include_guard_size);
+      cc->include_guard_[0] = '\0';
+      strcat(cc->include_guard_, carburetta);
+      strcat(cc->include_guard_, cc_PREFIX(cc));
       size_t n;
-      char *p = cc.include_guard_ + carburetta_len + prefix_len;
+      char *p = cc->include_guard_ + carburetta_len + prefix_len;
       for (n = 0; n < header_filename_len; ++n) {
-        char c = cc.h_output_filename_[n];
+        char c = cc->h_output_filename_[n];
         if ((c >= 'a') && (c <= 'z')) {
           c = c - 'a' + 'A';
         }
@@ -1078,13 +824,13 @@ int main(int argc, char **argv) {
       strcat(p, included);
     }
     else {
-      cc.include_guard_ = NULL;
+      cc->include_guard_ = NULL;
     }
 
     struct indented_printer ip;
-    ip_init(&ip, outfp, cc.c_output_filename_);
+    ip_init(&ip, outfp, cc->c_output_filename_);
 
-    emit_c_file(&ip, &cc, &prdg, &rex, &lalr);
+    emit_c_file(&ip, cc, &prdg, &rex, &lalr);
 
     if (ip.had_error_) {
       r = EXIT_FAILURE;
@@ -1096,34 +842,23 @@ int main(int argc, char **argv) {
     if (r) goto cleanup_exit;
 
     if (outfp != stdout) {
-      fclose(outfp);
-      g_temp_output_file = NULL;
-
-      /* don't care if this fails, file likely does not exist. */
-      remove(cc.c_output_filename_);
-
-      if (rename(g_temp_output_filename_, cc.c_output_filename_)) {
-        int err = errno;
-        re_error_nowhere("Failed to complete output to file \"%s\": %s", cc.c_output_filename_, strerror(err));
+      if (complete_output(job, cc->c_output_filename_)) {
         r = EXIT_FAILURE;
         goto cleanup_exit;
       }
-
-      free(g_temp_output_filename_);
-      g_temp_output_filename_ = NULL;
     }
   } /* generate_cfile */
 
-  if (generate_hfile) {
-    if (cc.h_output_filename_) {
-      outfp = to_make_temp(cc.h_output_filename_, &g_temp_output_filename_);
+  if (job->generate_hfile_) {
+    if (cc->h_output_filename_) {
+      outfp = to_make_temp(cc->h_output_filename_, &job->temp_output_filename_);
       if (!outfp) {
         int err = errno;
-        re_error_nowhere("Error, failed to open file \"%s\" for writing: %s", cc.h_output_filename_, strerror(err));
+        re_error_nowhere("Error, failed to open file \"%s\" for writing: %s", cc->h_output_filename_, strerror(err));
         r = EXIT_FAILURE;
         goto cleanup_exit;
       }
-      g_temp_output_file = outfp;
+      job->temp_output_file_ = outfp;
     }
     else {
       re_error_nowhere("Error, generating header file requires output filename");
@@ -1132,9 +867,9 @@ int main(int argc, char **argv) {
     }
 
     struct indented_printer ip;
-    ip_init(&ip, outfp, cc.c_output_filename_);
+    ip_init(&ip, outfp, cc->c_output_filename_);
 
-    emit_h_file(&ip, &cc, &prdg);
+    emit_h_file(&ip, cc, &prdg);
 
     if (ip.had_error_) {
       r = EXIT_FAILURE;
@@ -1144,43 +879,209 @@ int main(int argc, char **argv) {
     ip_cleanup(&ip);
 
     if (outfp != stdout) {
-      fclose(outfp);
-      g_temp_output_file = NULL;
-
-      /* don't care if this fails, file likely does not exist. */
-      remove(cc.h_output_filename_);
-
-      if (rename(g_temp_output_filename_, cc.h_output_filename_)) {
-        int err = errno;
-        re_error_nowhere("Failed to complete output to file \"%s\": %s", cc.h_output_filename_, strerror(err));
+      if (complete_output(job, cc->h_output_filename_)) {
         r = EXIT_FAILURE;
         goto cleanup_exit;
       }
-
-      free(g_temp_output_filename_);
-      g_temp_output_filename_ = NULL;
     }
   }
 
-
   r = EXIT_SUCCESS;
 cleanup_exit:
+  if (fp && (fp != stdin)) fclose(fp);
+
+  job_discard_temp_output(job);
+
   lr_cleanup(&lalr);
 
   rex_cleanup(&rex);
 
   gt_grammar_table_cleanup(&gt);
 
-  carburetta_context_cleanup(&cc);
-
   prd_grammar_cleanup(&prdg);
 
+  return r;
+}
+
+static void run_batch_job(void *arg, size_t job_index) {
+  struct carburetta_job *jobs = (struct carburetta_job *)arg;
+  jobs[job_index].exit_code_ = generate(jobs + job_index);
+}
+
+/* Generates all grammars listed in the manifest, num_threads at a time. Grammars that do not specify
+ * their own --cache-dir use cache_dir, if not NULL. Returns EXIT_SUCCESS if all of them were
+ * generated, EXIT_FAILURE otherwise. */
+static int run_batch(const char *manifest_filename, int num_threads, const char *cache_dir) {
+  int r = EXIT_FAILURE;
+  struct bat_manifest bm;
+  bat_manifest_init(&bm);
+  struct carburetta_job *jobs = NULL;
+  size_t num_jobs = 0;
+  size_t n, k;
+
+  int read_from_stdin = !strcmp(manifest_filename, "-");
+  FILE *fp;
+  if (read_from_stdin) {
+    fp = stdin;
+    manifest_filename = "(stdin)";
+  }
+  else {
+    fp = fopen(manifest_filename, "rb");
+    if (!fp) {
+      int err = errno;
+      re_error_nowhere("Failed to open file \"%s\": %s", manifest_filename, strerror(err));
+      goto cleanup_exit;
+    }
+  }
+  r = bat_read_manifest(&bm, fp, manifest_filename);
+  if (!read_from_stdin) fclose(fp);
+  if (r) {
+    r = EXIT_FAILURE;
+    goto cleanup_exit;
+  }
+  r = EXIT_FAILURE;
+
+  if (bm.num_entries_) {
+    jobs = (struct carburetta_job *)malloc(bm.num_entries_ * sizeof(struct carburetta_job));
+    if (!jobs) {
+      re_error_nowhere("Error: no memory");
+      goto cleanup_exit;
+    }
+  }
+
+  /* Parse the arguments of all grammars before generating any of them; a manifest with errors is
+   * rejected as a whole. */
+  int have_error = 0;
+  for (n = 0; n < bm.num_entries_; ++n) {
+    struct bat_manifest_entry *bme = bm.entries_ + n;
+    struct carburetta_job *job = jobs + num_jobs++;
+    job_init(job);
+    job->only_write_changes_ = 1;
+    if ((ARGS_PROCEED != parse_job_args(job, NULL, bme->argc_, (const char **)bme->argv_)) || finish_job_args(job)) {
+      re_error_flc(manifest_filename, bme->line_, 0, "Error, invalid arguments");
+      have_error = 1;
+      continue;
+    }
+    if (cache_dir && !job->cc_.cache_dir_) {
+      job->cc_.cache_dir_ = strdup(cache_dir);
+      if (!job->cc_.cache_dir_) {
+        re_error_nowhere("Error: no memory");
+        have_error = 1;
+        continue;
+      }
+    }
+    if (job->read_from_stdin_) {
+      re_error_flc(manifest_filename, bme->line_, 0, "Error, a grammar in a batch cannot be read from standard input");
+      have_error = 1;
+      continue;
+    }
+    if (!job->cc_.c_output_filename_ && !(job->cc_.tables_filename_ && !job->generate_cfile_ && !job->generate_hfile_)) {
+      re_error_flc(manifest_filename, bme->line_, 0, "Error, a grammar in a batch needs a C or tables output filename");
+      have_error = 1;
+      continue;
+    }
+    /* Grammars may run concurrently, so no two may write the same file */
+    const char *outputs[] = { job->cc_.c_output_filename_, job->cc_.h_output_filename_, job->cc_.tables_filename_ };
+    for (k = 0; k < n; ++k) {
+      size_t i, j;
+      const char *prior_outputs[] = { jobs[k].cc_.c_output_filename_, jobs[k].cc_.h_output_filename_, jobs[k].cc_.tables_filename_ };
+      for (i = 0; i < sizeof(outputs) / sizeof(*outputs); ++i) {
+        for (j = 0; j < sizeof(prior_outputs) / sizeof(*prior_outputs); ++j) {
+          if (outputs[i] && prior_outputs[j] && !strcmp(outputs[i], prior_outputs[j])) {
+            re_error_flc(manifest_filename, bme->line_, 0, "Error, output file \"%s\" is also written by line %d", outputs[i], bm.entries_[k].line_);
+            have_error = 1;
+          }
+        }
+      }
+    }
+  }
+  if (have_error) goto cleanup_exit;
+
+  bat_run(num_jobs, num_threads, run_batch_job, jobs);
+
+  r = EXIT_SUCCESS;
+  for (n = 0; n < num_jobs; ++n) {
+    if (jobs[n].exit_code_ != EXIT_SUCCESS) {
+      r = EXIT_FAILURE;
+    }
+  }
+
+cleanup_exit:
+  for (n = 0; n < num_jobs; ++n) {
+    job_cleanup(jobs + n);
+  }
+  if (jobs) free(jobs);
+  bat_manifest_cleanup(&bm);
+
+  return r;
+}
+
+int main(int argc, char **argv) {
+  int r;
+
+  r = ldl_init();
+  if (r) {
+    re_error_nowhere("Failed to initialize ldl");
+    return EXIT_FAILURE;
+  }
+  r = tok_init();
+  if (r) {
+    re_error_nowhere("Failed to initialize tok");
+    return EXIT_FAILURE;
+  }
+  r = las_init();
+  if (r) {
+    re_error_nowhere("Failed to initialize las");
+    return EXIT_FAILURE;
+  }
+  r = dct_init();
+  if (r) {
+    re_error_nowhere("Failed to initialize dct");
+    return EXIT_FAILURE;
+  }
+
+  struct carburetta_job job;
+  job_init(&job);
+
+  struct process_args pa;
+  pa.manifest_filename_ = NULL;
+  pa.num_threads_ = 1;
+  pa.num_job_args_ = 0;
+
+  r = parse_job_args(&job, &pa, argc, (const char **)argv);
+  if (r == ARGS_EXIT_SUCCESS) {
+    r = EXIT_SUCCESS;
+    goto cleanup_exit;
+  }
+  else if (r != ARGS_PROCEED) {
+    r = EXIT_FAILURE;
+    goto cleanup_exit;
+  }
+
+  if (pa.manifest_filename_) {
+    if (pa.num_job_args_) {
+      re_error_nowhere("Error: --batch cannot be combined with an input file or flags for generating a grammar, specify these for each grammar in the manifest instead");
+      print_usage(stderr);
+      r = EXIT_FAILURE;
+      goto cleanup_exit;
+    }
+    r = run_batch(pa.manifest_filename_, pa.num_threads_, job.cc_.cache_dir_);
+  }
+  else {
+    if (finish_job_args(&job)) {
+      r = EXIT_FAILURE;
+      goto cleanup_exit;
+    }
+    r = generate(&job);
+  }
+
+cleanup_exit:
+  job_cleanup(&job);
+
   dct_cleanup();
   las_cleanup();
   tok_cleanup();
   ldl_cleanup();
 
-  if (input_filename) free(input_filename);
-
   return r;
 }
@@ -68,6 +68,12 @@ void carburetta_context_init(struct carburetta_context *cc) {
   cc->h_output_filename_ = NULL;
   cc->c_output_filename_ = NULL;
   cc->include_guard_ = NULL;
+  cc->tables_filename_ = NULL;
+  cc->cache_dir_ = NULL;
+  cc->utf8_decoder_table_ = NULL;
+  cc->utf8_decoder_num_rows_ = 0;
+  cc->lazy_dfa_max_states_ = 0;
+  cc->profile_filename_ = NULL;
   xlts_init(&cc->prologue_);
   xlts_init(&cc->header_);
   xlts_init(&cc->epilogue_);
@@ -76,6 +82,11 @@ void carburetta_context_init(struct carburetta_context *cc) {
   cc->utf8_experimental_ = 1; /* default on, use --x-raw to set to false. */
   cc->emit_line_directives_ = 1;
   cc->emit_symbol_name_table_ = 0;
+  cc->linear_scan_ = 0;
+  cc->computed_goto_ = 0;
+  cc->segmented_stack_ = 0;
+  cc->instrument_ = 0;
+  cc->compact_scan_ = 0;
 }
 
 void carburetta_context_cleanup(struct carburetta_context *cc) {
@@ -119,6 +130,10 @@ void carburetta_context_cleanup(struct carburetta_context *cc) {
   if (cc->c_output_filename_) free(cc->c_output_filename_);
   if (cc->h_output_filename_) free(cc->h_output_filename_);
   if (cc->include_guard_) free(cc->include_guard_);
+  if (cc->tables_filename_) free(cc->tables_filename_);
+  if (cc->cache_dir_) free(cc->cache_dir_);
+  if (cc->profile_filename_) free(cc->profile_filename_);
+  if (cc->utf8_decoder_table_) free(cc->utf8_decoder_table_);
   xlts_cleanup(&cc->prologue_);
   xlts_cleanup(&cc->header_);
   xlts_cleanup(&cc->epilogue_);
@@ -98,6 +98,12 @@ struct carburetta_context {
   char *h_output_filename_;
   char *c_output_filename_;
   char *include_guard_;
+  char *tables_filename_; /* Output filename for the tables image (--tables), or NULL if not generated */
+  char *cache_dir_; /* Directory of the table cache (--cache-dir), or NULL if tables are not cached */
+  int *utf8_decoder_table_; /* UTF-8 decoder table (256 columns) if loaded from the table cache, otherwise NULL and built by the emitter */
+  size_t utf8_decoder_num_rows_;
+  size_t lazy_dfa_max_states_; /* Number of DFA states the generated scanner caches when determinizing its NFA as it goes (--lazy-dfa), or 0 to emit the DFA as tables */
+  char *profile_filename_; /* Profile by which to renumber the tables (--profile), or NULL to keep them as constructed */
   struct xlts prologue_;
   struct xlts header_;
   struct xlts epilogue_;
@@ -106,6 +112,11 @@ struct carburetta_context {
   int utf8_experimental_:1;
   int emit_line_directives_:1;
   int emit_symbol_name_table_:1;
+  int linear_scan_:1; /* Generate a scanner that memoizes failed (state, position) pairs to guarantee linear time tokenization */
+  int computed_goto_:1; /* Dispatch reductions and continuations through tables of label addresses on GCC and Clang */
+  int segmented_stack_:1; /* Grow the parse stack in segments that are never moved, stack_ holds pointers to sym_data */
+  int instrument_:1; /* Generate code that counts the visits to each table row and column, for writing a profile */
+  int compact_scan_:1; /* Emit the scanner table with identical rows shared and near-identical rows as a base row plus exceptions */
 };
 
 void carburetta_context_init(struct carburetta_context *cc);
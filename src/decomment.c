@@ -64,6 +64,7 @@ typedef enum dct_token {
 
 static struct sc_scanner g_dct_scanner_;
 
+#if defined(GENERATE_AND_DUMP_SCANNER_TABLES) || defined(VERIFY_GENERATED_SCANNER_TABLES)
 #if __GNUC__
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wmissing-braces"
@@ -78,12 +79,30 @@ ENUM_DCT_TOKENS
 #if __GNUC__
 #pragma GCC diagnostic pop
 #endif
+#endif
+
+#ifndef GENERATE_AND_DUMP_SCANNER_TABLES
+#include "decomment_generated_scanners.c"
+#endif
 
 int dct_init(void) {
   int r;
   sc_scanner_init(&g_dct_scanner_);
 
+#ifdef GENERATE_AND_DUMP_SCANNER_TABLES
   r = sc_scanner_compile(&g_dct_scanner_, DCT_UNKNOWN, sizeof(g_dct_scanner_rules_) / sizeof(*g_dct_scanner_rules_), g_dct_scanner_rules_);
+  if (r) return r;
+
+  struct sc_scanner *const scanners[] = { &g_dct_scanner_ };
+  const char *const scanner_ids[] = { "g_dct_compact_scanner_" };
+  r = sc_scanners_write_c_file("src/decomment_generated_scanners.c", "dct_init() in decomment.c", sizeof(scanners) / sizeof(*scanners), scanners, scanner_ids);
+#else
+#ifdef VERIFY_GENERATED_SCANNER_TABLES
+  r = sc_scanner_verify(&g_dct_compact_scanner_, "src/decomment_generated_scanners.c", DCT_UNKNOWN, sizeof(g_dct_scanner_rules_) / sizeof(*g_dct_scanner_rules_), g_dct_scanner_rules_);
+  if (r) return r;
+#endif
+  r = sc_scanner_expand(&g_dct_scanner_, &g_dct_compact_scanner_);
+#endif
 
   return r;
 }
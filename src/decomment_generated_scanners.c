@@ -0,0 +1,56 @@
+/* Copyright 2020-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+ /** NOTE: This file is generated at dct_init() in decomment.c by defining GENERATE_AND_DUMP_SCANNER_TABLES (see "make scanner-tables") **/
+static const uint8_t g_dct_compact_scanner_byte_classes_[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+static const uint16_t g_dct_compact_scanner_transitions_[] = {
+  0, 0, 0, 0, 0,
+  0, 0, 0, 0, 2,
+  0, 0, 0, 3, 4,
+  6, 7, 7, 8, 6,
+  5, 0, 5, 5, 5,
+  5, 0, 5, 5, 5,
+  6, 7, 7, 8, 6,
+  6, 7, 7, 8, 6,
+  9, 10, 10, 11, 12,
+  6, 7, 7, 8, 6,
+  6, 7, 7, 8, 6,
+  9, 10, 10, 11, 0,
+  0, 0, 0, 0, 0
+};
+static const struct sc_action g_dct_compact_scanner_actions_[] = {
+  {0,0},
+  {0,0},
+  {0,0},
+  {0,0},
+  {2,2},
+  {2,2},
+  {0,0},
+  {0,0},
+  {0,0},
+  {0,0},
+  {0,0},
+  {0,0},
+  {1,1}
+};
+static const struct sc_compact_scanner g_dct_compact_scanner_ = { 13, 1, 0, 5, g_dct_compact_scanner_byte_classes_, g_dct_compact_scanner_transitions_, g_dct_compact_scanner_actions_ };
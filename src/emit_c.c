@@ -63,6 +63,15 @@
 #include "indented_printer.h"
 #endif
 
+/* Columns of a state in the --compact-scan <prefix>scan_states_ table: the offset of its row in
+ * <prefix>scan_rows_, its first exception, and its 4 anchor transitions */
+#define EMIT_SCAN_COMPACT_STATE_COLUMNS 6
+
+/* Most exceptions to its base row a state may have with --compact-scan, and the number of distinct
+ * rows before it searched for that base row */
+#define EMIT_SCAN_COMPACT_MAX_EXCEPTIONS 4
+#define EMIT_SCAN_COMPACT_WINDOW 32
+
 enum dest_type {
   SEDT_NONE,
   SEDT_FMT,
@@ -932,13 +941,181 @@ static int emit_snippet_code_emission(struct indented_printer *ip, struct carbur
 }
 
 static void emit_snippet_continuation_jump(struct indented_printer *ip, struct carburetta_context *cc) {
+  int n;
+  if (cc->computed_goto_) {
+    /* Jump straight to the continuation through a table of label addresses */
+    ip_printf(ip, "#if defined(__GNUC__)\n");
+    ip_printf(ip, "{\n");
+    ip_printf(ip, "  static const void *const continuation_labels[] = {\n");
+    ip_printf(ip, "    &&C0");
+    for (n = 1; n < cc->current_snippet_continuation_; ++n) {
+      ip_printf(ip, ", &&C%d", n);
+    }
+    ip_printf(ip, "\n");
+    ip_printf(ip, "  };\n");
+    ip_printf(ip, "  goto *continuation_labels[stack->continue_at_];\n");
+    ip_printf(ip, "}\n");
+    ip_printf(ip, "C0:; /* fall through to regular code path */\n");
+    ip_printf(ip, "#else\n");
+  }
   ip_printf(ip, "switch (stack->continue_at_) {\n");
   ip_printf(ip, "case 0: break; /* fall through to regular code path */\n");
-  int n;
   for (n = 1; n < cc->current_snippet_continuation_; ++n) {
     ip_printf(ip, "case %d: goto C%d;\n", n, n);
   }
   ip_printf(ip, "} /* continuation switch */\n");
+  if (cc->computed_goto_) {
+    ip_printf(ip, "#endif\n");
+  }
+}
+
+/* Emits the dispatch to the reduction of a production, with computed_goto_ this jumps through a
+ * table of label addresses on GCC and Clang, reaching the same case labels as the switch that
+ * follows it does elsewhere. The R0 label for production 0 is emitted by
+ * emit_reduce_dispatch_end(). */
+static void emit_reduce_dispatch(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, const char *indent) {
+  if (cc->computed_goto_) {
+    size_t row;
+    ip_printf(ip, "#if defined(__GNUC__)\n");
+    ip_printf(ip, "%s{\n", indent);
+    ip_printf(ip, "%s  static const void *const reduce_labels[] = {\n", indent);
+    ip_printf(ip, "%s    &&R0", indent);
+    for (row = 0; row < prdg->num_productions_; ++row) {
+      ip_printf(ip, ", &&R%d", (int)row + 1);
+    }
+    ip_printf(ip, "\n");
+    ip_printf(ip, "%s  };\n", indent);
+    ip_printf(ip, "%s  goto *reduce_labels[production];\n", indent);
+    ip_printf(ip, "%s}\n", indent);
+    ip_printf(ip, "#endif\n");
+  }
+  ip_printf(ip, "%sswitch (production) {\n", indent);
+}
+
+/* Emits the case label for the reduction of production row; opens_body is zero for all but the
+ * last of the productions that share the same code (see group_reduce_cases()). */
+static void emit_reduce_case(struct indented_printer *ip, struct carburetta_context *cc, size_t row, int opens_body, const char *indent) {
+  if (!cc->computed_goto_) {
+    if (opens_body) {
+      ip_printf(ip, "%s  case %d: {\n", indent, (int)row + 1);
+    }
+    else {
+      ip_printf(ip, "%s  case %d:\n", indent, (int)row + 1);
+    }
+    return;
+  }
+  ip_printf(ip, "%s  case %d:\n", indent, (int)row + 1);
+  ip_printf(ip, "#if defined(__GNUC__)\n");
+  ip_printf(ip, "%s  R%d:\n", indent, (int)row + 1);
+  ip_printf(ip, "#endif\n");
+  if (opens_body) {
+    ip_printf(ip, "%s  {\n", indent);
+  }
+}
+
+/* Returns non-zero if the action snippet uses $$ or any $n whose data type differs between
+ * productions a and b, or cannot be resolved in either; such snippets expand differently (or
+ * fail to expand) and cannot be shared. */
+static int action_types_differ(struct prd_production *a, struct prd_production *b) {
+  size_t col;
+  const struct snippet *s = &a->action_sequence_;
+  for (col = 0; col < s->num_tokens_; ++col) {
+    const struct snippet_token *st = s->tokens_ + col;
+    if (st->match_ == TOK_SPECIAL_IDENT_DST) {
+      if (!a->nt_.sym_->assigned_type_) return 1;
+    }
+    else if ((st->match_ == TOK_SPECIAL_IDENT_STR) && (st->text_.num_translated_ > 1) && isdigit((unsigned char)st->text_.translated_[1])) {
+      size_t n;
+      size_t sym_index = 0;
+      for (n = 1; n < st->text_.num_translated_; ++n) {
+        char c = st->text_.translated_[n];
+        if (!isdigit((unsigned char)c)) return 1;
+        if (multiply_size_t(10, sym_index, NULL, &sym_index)) return 1;
+        sym_index += (size_t)(c - '0');
+      }
+      if ((sym_index >= a->num_syms_) || (sym_index >= b->num_syms_)) return 1;
+      if (!a->syms_[sym_index].sym_->assigned_type_) return 1;
+      if (a->syms_[sym_index].sym_->assigned_type_ != b->syms_[sym_index].sym_->assigned_type_) return 1;
+    }
+  }
+  return 0;
+}
+
+/* Groups together the productions whose reduce cases expand to identical code, so each group
+ * shares one case body with a label for every production in it. This is the case if their
+ * common action and action snippets are identical, their non-terminals have the same data type,
+ * and every $n in the action resolves to the same data type. The non-terminals themselves may
+ * differ, the shared body then takes slot_1_sym_ from current_production_nonterminal_.
+ * Upon success, *pgroups points to 2 * num_productions_ entries: the first num_productions_ hold
+ * the first production of the group of each production, the second num_productions_ the next
+ * production in the same group, or SIZE_MAX for the last.
+ * Returns 0 upon success, non-zero upon memory failure. */
+static int group_reduce_cases(struct prd_grammar *prdg, size_t **pgroups) {
+  size_t num_productions = prdg->num_productions_;
+  size_t *groups = NULL;
+  size_t *scratch = NULL;
+  size_t row;
+  *pgroups = NULL;
+  if (!num_productions) return 0;
+  groups = (size_t *)malloc(sizeof(size_t) * 2 * num_productions);
+  scratch = (size_t *)malloc(sizeof(size_t) * 3 * num_productions);
+  if (!groups || !scratch) {
+    free(groups);
+    free(scratch);
+    return -1;
+  }
+  size_t *leaders = groups;
+  size_t *next = groups + num_productions;
+  /* Hash table of the first production of each group, and the last production of each group so
+   * productions can be appended in order. */
+  size_t *bucket_heads = scratch;
+  size_t *hash_chain = scratch + num_productions;
+  size_t *tails = scratch + 2 * num_productions;
+  for (row = 0; row < num_productions; ++row) {
+    bucket_heads[row] = SIZE_MAX;
+  }
+  for (row = 0; row < num_productions; ++row) {
+    struct prd_production *pd = prdg->productions_ + row;
+    uint64_t hash_value = snippet_hash(&pd->action_sequence_);
+    hash_value = (hash_value << 7) | (hash_value >> ((-7) & 63));
+    hash_value += snippet_hash(&pd->common_action_sequence_);
+    size_t bucket = (size_t)(hash_value % num_productions);
+    size_t leader;
+    leaders[row] = row;
+    next[row] = SIZE_MAX;
+    for (leader = bucket_heads[bucket]; leader != SIZE_MAX; leader = hash_chain[leader]) {
+      struct prd_production *lpd = prdg->productions_ + leader;
+      if ((lpd->nt_.sym_->assigned_type_ == pd->nt_.sym_->assigned_type_) &&
+          !snippet_cmp(&lpd->action_sequence_, &pd->action_sequence_) &&
+          !snippet_cmp(&lpd->common_action_sequence_, &pd->common_action_sequence_) &&
+          !action_types_differ(lpd, pd)) {
+        break;
+      }
+    }
+    if (leader == SIZE_MAX) {
+      /* New group */
+      hash_chain[row] = bucket_heads[bucket];
+      bucket_heads[bucket] = row;
+      tails[row] = row;
+    }
+    else {
+      next[tails[leader]] = row;
+      tails[leader] = row;
+      leaders[row] = leader;
+    }
+  }
+  free(scratch);
+  *pgroups = groups;
+  return 0;
+}
+
+static void emit_reduce_dispatch_end(struct indented_printer *ip, struct carburetta_context *cc, const char *indent) {
+  ip_printf(ip, "%s} /* switch */\n", indent);
+  if (cc->computed_goto_) {
+    ip_printf(ip, "#if defined(__GNUC__)\n");
+    ip_printf(ip, "%sR0:;\n", indent);
+    ip_printf(ip, "#endif\n");
+  }
 }
 
 static int emit_common_action_snippet(struct indented_printer *ip, struct carburetta_context *cc, struct prd_production *prd) {
@@ -949,9 +1126,9 @@ static int emit_common_action_snippet(struct indented_printer *ip, struct carbur
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_FMT;
   se.common_fmt_prefix_ = "(stack->sym_data_[";
-  se.common_fmt_suffix_ = "].common_)";
+  se.common_fmt_suffix_ = cc->segmented_stack_ ? "]->common_)" : "].common_)";
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[1].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->common_)" : "(stack->stack_[1].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -974,16 +1151,16 @@ static int emit_action_snippet(struct indented_printer *ip, struct carburetta_co
   if (!prd) return 0;
   se.code_ = &prd->action_sequence_;
   se.dest_type_ = SEDT_FMT_DATATYPE_ORDINAL;
-  se.dest_fmt_ = "(stack->stack_[1].v_.uv%d_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->v_.uv%d_)" : "(stack->stack_[1].v_.uv%d_)";
   se.dest_ = &prd->nt_;
   se.sym_type_ = SEST_FMT_INDEX_ORDINAL;
-  se.sym_fmt_ = "(stack->sym_data_[%zu].v_.uv%d_)";
+  se.sym_fmt_ = cc->segmented_stack_ ? "(stack->sym_data_[%zu]->v_.uv%d_)" : "(stack->sym_data_[%zu].v_.uv%d_)";
   se.prod_ = prd;
   se.common_type_ = SECT_FMT;
   se.common_fmt_prefix_ = "(stack->sym_data_[";
-  se.common_fmt_suffix_ = "].common_)";
+  se.common_fmt_suffix_ = cc->segmented_stack_ ? "]->common_)" : "].common_)";
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[1].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->common_)" : "(stack->stack_[1].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1006,11 +1183,11 @@ static int emit_token_action_snippet(struct indented_printer *ip, struct carbure
   se.code_ = &ts->token_action_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "(stack->sym_data_->v_.uv%d_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->sym_data_[0]->v_.uv%d_)" : "(stack->sym_data_->v_.uv%d_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->sym_data_->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->sym_data_[0]->common_)" : "(stack->sym_data_->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1032,11 +1209,11 @@ static int emit_constructor_top_of_stack_snippet(struct indented_printer *ip, st
   se.code_ = &ts->constructor_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "((stack->stack_ + stack->pos_ - 1)->v_.uv%d_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->pos_ - 1]->v_.uv%d_)" : "((stack->stack_ + stack->pos_ - 1)->v_.uv%d_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "((stack->stack_ + stack->pos_ - 1)->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->pos_ - 1]->common_)" : "((stack->stack_ + stack->pos_ - 1)->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1086,7 +1263,7 @@ static int emit_move_snippet_newbuf_indexed_by_nbspp(struct indented_printer *ip
   se.dest_typestr_ = ts;
   se.dest_fmt_ = "stack->new_buf_[stack->new_buf_sym_partial_pos_].v_.uv%d_";
   se.sym_type_ = SEST_FMT_FIXED_INDEX_0_ORDINAL;
-  se.sym_fmt_ = "(stack->stack_[stack->new_buf_sym_partial_pos_].v_.uv%d_)";
+  se.sym_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->new_buf_sym_partial_pos_]->v_.uv%d_)" : "(stack->stack_[stack->new_buf_sym_partial_pos_].v_.uv%d_)";
   se.fixed_sym_0_ = ts;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
@@ -1112,13 +1289,13 @@ static int emit_move_to_top_of_stack_from_slot_0_snippet(struct indented_printer
   se.code_ = &ts->move_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "stack->stack_[stack->pos_ - 1].v_.uv%d_";
+  se.dest_fmt_ = cc->segmented_stack_ ? "stack->stack_[stack->pos_ - 1]->v_.uv%d_" : "stack->stack_[stack->pos_ - 1].v_.uv%d_";
   se.sym_type_ = SEST_FMT_FIXED_INDEX_0_ORDINAL;
-  se.sym_fmt_ = "(stack->stack_[0].v_.uv%d_)";
+  se.sym_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->v_.uv%d_)" : "(stack->stack_[0].v_.uv%d_)";
   se.fixed_sym_0_ = ts;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[stack->pos_ - 1].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->pos_ - 1]->common_)" : "(stack->stack_[stack->pos_ - 1].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1140,13 +1317,13 @@ static int emit_move_to_top_of_stack_from_slot_1_snippet(struct indented_printer
   se.code_ = &ts->move_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "stack->stack_[stack->pos_ - 1].v_.uv%d_";
+  se.dest_fmt_ = cc->segmented_stack_ ? "stack->stack_[stack->pos_ - 1]->v_.uv%d_" : "stack->stack_[stack->pos_ - 1].v_.uv%d_";
   se.sym_type_ = SEST_FMT_FIXED_INDEX_0_ORDINAL;
-  se.sym_fmt_ = "(stack->stack_[1].v_.uv%d_)";
+  se.sym_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->v_.uv%d_)" : "(stack->stack_[1].v_.uv%d_)";
   se.fixed_sym_0_ = ts;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[stack->pos_ - 1].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->pos_ - 1]->common_)" : "(stack->stack_[stack->pos_ - 1].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1169,7 +1346,7 @@ static int emit_common_move_snippet_indexed_by_nbspp(struct indented_printer *ip
   se.dest_type_ = SEDT_FMT;
   se.dest_fmt_ = "stack->new_buf_[stack->new_buf_sym_partial_pos_].common_";
   se.sym_type_ = SEST_FMT_FIXED_INDEX_0_ORDINAL;
-  se.sym_fmt_ = "(stack->stack_[stack->new_buf_sym_partial_pos_].common_)";
+  se.sym_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->new_buf_sym_partial_pos_]->common_)" : "(stack->stack_[stack->new_buf_sym_partial_pos_].common_)";
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
   se.common_dest_fmt_ = "(stack->new_buf_[stack->new_buf_sym_partial_pos_].common_)";
@@ -1193,12 +1370,12 @@ static int emit_common_move_to_top_of_stack_from_slot_0_snippet(struct indented_
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->move_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "stack->stack_[stack->pos_ - 1].common_";
+  se.dest_fmt_ = cc->segmented_stack_ ? "stack->stack_[stack->pos_ - 1]->common_" : "stack->stack_[stack->pos_ - 1].common_";
   se.sym_type_ = SEST_FMT_FIXED_INDEX_0_ORDINAL;
-  se.sym_fmt_ = "(stack->stack_[0].common_)";
+  se.sym_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[stack->pos_ - 1].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->pos_ - 1]->common_)" : "(stack->stack_[stack->pos_ - 1].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1219,12 +1396,12 @@ static int emit_common_move_to_top_of_stack_from_slot_1_snippet(struct indented_
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->move_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "stack->stack_[stack->pos_ - 1].common_";
+  se.dest_fmt_ = cc->segmented_stack_ ? "stack->stack_[stack->pos_ - 1]->common_" : "stack->stack_[stack->pos_ - 1].common_";
   se.sym_type_ = SEST_FMT_FIXED_INDEX_0_ORDINAL;
-  se.sym_fmt_ = "(stack->stack_[1].common_)";
+  se.sym_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->common_)" : "(stack->stack_[1].common_)";
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[stack->pos_ - 1].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->pos_ - 1]->common_)" : "(stack->stack_[stack->pos_ - 1].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1246,11 +1423,11 @@ static int emit_dst_sym_constructor_snippet(struct indented_printer *ip, struct
   se.code_ = &ts->constructor_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "(stack->stack_[1].v_.uv%d_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->v_.uv%d_)" : "(stack->stack_[1].v_.uv%d_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[1].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->common_)" : "(stack->stack_[1].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1271,11 +1448,11 @@ static int emit_common_constructor_top_of_stack_snippet(struct indented_printer
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->constructor_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "((stack->stack_ + stack->pos_ - 1)->common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->pos_ - 1]->common_)" : "((stack->stack_ + stack->pos_ - 1)->common_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT_PREFIX;
-  se.common_dest_fmt_ = "((stack->stack_ + stack->pos_ - 1)->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->pos_ - 1]->common_)" : "((stack->stack_ + stack->pos_ - 1)->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1323,11 +1500,11 @@ static int emit_dst_common_constructor_snippet(struct indented_printer *ip, stru
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->constructor_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "(stack->stack_[1].common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->common_)" : "(stack->stack_[1].common_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[1].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->common_)" : "(stack->stack_[1].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1348,11 +1525,11 @@ static int emit_token_common_constructor_snippet(struct indented_printer *ip, st
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->constructor_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "(stack->sym_data_->common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->sym_data_[0]->common_)" : "(stack->sym_data_->common_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->sym_data_->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->sym_data_[0]->common_)" : "(stack->sym_data_->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1373,11 +1550,11 @@ static int emit_pattern_token_common_constructor_snippet(struct indented_printer
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->constructor_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "(stack->stack_[0].common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[0].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1385,7 +1562,7 @@ static int emit_pattern_token_common_constructor_snippet(struct indented_printer
   se.len_fmt_ = "(stack->token_size_)";
   se.discard_type_ = SEDIT_NONE;
   se.text_type_ = SETT_FMT;
-  se.text_fmt_ = "(stack->match_buffer_)";
+  se.text_fmt_ = "(stack->token_text_)";
   se.line_type_ = SELIT_FMT;
   se.line_fmt_ = "(stack->match_line_)";
   se.col_type_ = SECOT_FMT;
@@ -1406,11 +1583,11 @@ static int emit_token_common_action_snippet(struct indented_printer *ip, struct
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->token_action_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "(stack->sym_data_->common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->sym_data_[0]->common_)" : "(stack->sym_data_->common_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->sym_data_->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->sym_data_[0]->common_)" : "(stack->sym_data_->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1432,11 +1609,11 @@ static int emit_token_constructor_snippet(struct indented_printer *ip, struct ca
   se.code_ = &ts->constructor_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "(stack->sym_data_->v_.uv%d_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->sym_data_[0]->v_.uv%d_)" : "(stack->sym_data_->v_.uv%d_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->sym_data_->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->sym_data_[0]->common_)" : "(stack->sym_data_->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1458,11 +1635,11 @@ static int emit_pattern_token_constructor_snippet(struct indented_printer *ip, s
   se.code_ = &ts->constructor_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "(stack->stack_[0].v_.uv%d_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->v_.uv%d_)" : "(stack->stack_[0].v_.uv%d_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[0].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1470,7 +1647,7 @@ static int emit_pattern_token_constructor_snippet(struct indented_printer *ip, s
   se.len_fmt_ = "(stack->token_size_)";
   se.discard_type_ = SEDIT_NONE;
   se.text_type_ = SETT_FMT;
-  se.text_fmt_ = "(stack->match_buffer_)";
+  se.text_fmt_ = "(stack->token_text_)";
   se.line_type_ = SELIT_FMT;
   se.line_fmt_ = "(stack->match_line_)";
   se.col_type_ = SECOT_FMT;
@@ -1495,11 +1672,11 @@ static int emit_destructor_snippet(struct indented_printer *ip, struct carburett
   se.code_ = &ts->destructor_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "((stack->stack_ + stack->sym_idx_)->v_.uv%d_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->sym_idx_]->v_.uv%d_)" : "((stack->stack_ + stack->sym_idx_)->v_.uv%d_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "((stack->stack_ + stack->sym_idx_)->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->sym_idx_]->common_)" : "((stack->stack_ + stack->sym_idx_)->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1526,11 +1703,11 @@ static int emit_destructor_snippet_indexed_by_n(struct indented_printer *ip, str
   se.code_ = &ts->destructor_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "((stack->stack_ + n)->v_.uv%d_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[n]->v_.uv%d_)" : "((stack->stack_ + n)->v_.uv%d_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "((stack->stack_ + n)->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[n]->common_)" : "((stack->stack_ + n)->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1588,11 +1765,11 @@ int emit_destructor_snippet_indexed_by_nbspp(struct indented_printer *ip, struct
   se.code_ = &ts->destructor_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "((stack->stack_ + stack->new_buf_sym_partial_pos_)->v_.uv%d_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->new_buf_sym_partial_pos_]->v_.uv%d_)" : "((stack->stack_ + stack->new_buf_sym_partial_pos_)->v_.uv%d_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "((stack->stack_ + stack->new_buf_sym_partial_pos_)->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->new_buf_sym_partial_pos_]->common_)" : "((stack->stack_ + stack->new_buf_sym_partial_pos_)->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1619,11 +1796,11 @@ static int emit_destructor_snippet_indexed_by_0(struct indented_printer *ip, str
   se.code_ = &ts->destructor_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "(stack->stack_[0].v_.uv%d_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->v_.uv%d_)" : "(stack->stack_[0].v_.uv%d_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[0].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1650,11 +1827,11 @@ static int emit_destructor_snippet_indexed_by_1(struct indented_printer *ip, str
   se.code_ = &ts->destructor_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "(stack->stack_[1].v_.uv%d_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->v_.uv%d_)" : "(stack->stack_[1].v_.uv%d_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[1].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->common_)" : "(stack->stack_[1].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1680,11 +1857,11 @@ static int emit_common_destructor_snippet(struct indented_printer *ip, struct ca
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->destructor_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "((stack->stack_ + stack->sym_idx_)->common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->sym_idx_]->common_)" : "((stack->stack_ + stack->sym_idx_)->common_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "((stack->stack_ + stack->sym_idx_)->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->sym_idx_]->common_)" : "((stack->stack_ + stack->sym_idx_)->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1710,11 +1887,11 @@ static int emit_pattern_token_common_destructor_snippet(struct indented_printer
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->destructor_snippet_;
   se.dest_type_ = SEDT_FMT;;
-  se.dest_fmt_ = "(stack->stack_[0].common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[0].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1740,11 +1917,11 @@ static int emit_common_destructor_snippet_indexed_by_n(struct indented_printer *
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->destructor_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "((stack->stack_ + n)->common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[n]->common_)" : "((stack->stack_ + n)->common_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "((stack->stack_ + n)->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[n]->common_)" : "((stack->stack_ + n)->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1800,11 +1977,11 @@ static int emit_common_destructor_snippet_indexed_by_nbspp(struct indented_print
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->destructor_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "((stack->stack_ + stack->new_buf_sym_partial_pos_)->common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->new_buf_sym_partial_pos_]->common_)" : "((stack->stack_ + stack->new_buf_sym_partial_pos_)->common_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "((stack->stack_ + stack->new_buf_sym_partial_pos_)->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[stack->new_buf_sym_partial_pos_]->common_)" : "((stack->stack_ + stack->new_buf_sym_partial_pos_)->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1830,11 +2007,11 @@ static int emit_common_destructor_snippet_index_0(struct indented_printer *ip, s
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->destructor_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "(stack->stack_[0].common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[0].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1860,11 +2037,11 @@ static int emit_common_destructor_snippet_index_1(struct indented_printer *ip, s
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->destructor_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "(stack->stack_[1].common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->common_)" : "(stack->stack_[1].common_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[1].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[1]->common_)" : "(stack->stack_[1].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1887,12 +2064,12 @@ static int emit_pattern_common_action_snippet(struct indented_printer *ip, struc
   if (!pat) return 0;
   se.code_ = &pat->common_action_sequence_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "(stack->stack_[0].common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.sym_type_ = SEST_NONE;
   se.prod_ = NULL;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[0].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -1901,7 +2078,7 @@ static int emit_pattern_common_action_snippet(struct indented_printer *ip, struc
   se.discard_type_ = SEDIT_FMT;
   se.discard_fmt_ = "stack->discard_remaining_actions_ = 1;";
   se.text_type_ = SETT_FMT;
-  se.text_fmt_ = "(stack->match_buffer_)";
+  se.text_fmt_ = "(stack->token_text_)";
   se.line_type_ = SELIT_FMT;
   se.line_fmt_ = "(stack->match_line_)";
   se.col_type_ = SECOT_FMT;
@@ -1925,7 +2102,7 @@ static int emit_pattern_action_snippet(struct indented_printer *ip, struct carbu
   if (ts) {
     se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
     se.dest_typestr_ = ts;
-    se.dest_fmt_ = "(stack->stack_[0].v_.uv%d_)";
+    se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->v_.uv%d_)" : "(stack->stack_[0].v_.uv%d_)";
   }
   else {
     se.dest_type_ = SEDT_NONE;
@@ -1934,7 +2111,7 @@ static int emit_pattern_action_snippet(struct indented_printer *ip, struct carbu
   se.prod_ = NULL;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "(stack->stack_[0].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_VALID;
   se.settoken_type_ = SESTT_NONE;
@@ -1943,7 +2120,7 @@ static int emit_pattern_action_snippet(struct indented_printer *ip, struct carbu
   se.discard_type_ = SEDIT_FMT;
   se.discard_fmt_ = "stack->discard_remaining_actions_ = 1;";
   se.text_type_ = SETT_FMT;
-  se.text_fmt_ = "(stack->match_buffer_)";
+  se.text_fmt_ = "(stack->token_text_)";
   se.line_type_ = SELIT_FMT;
   se.line_fmt_ = "(stack->match_line_)";
   se.col_type_ = SECOT_FMT;
@@ -1967,7 +2144,7 @@ static int emit_scan_token_snippet(struct indented_printer *ip, struct carburett
   se.prod_ = NULL;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_NONE;
-  se.common_dest_fmt_ = "(stack->stack_[0].common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[0]->common_)" : "(stack->stack_[0].common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_VALID;
@@ -1992,11 +2169,11 @@ static int emit_visit_snippet_indexed_by_n(struct indented_printer *ip, struct c
   se.code_ = &ts->visit_snippet_;
   se.dest_type_ = SEDT_FMT_TYPESTR_ORDINAL;
   se.dest_typestr_ = ts;
-  se.dest_fmt_ = "((stack->stack_ + n)->v_.uv%d_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[n]->v_.uv%d_)" : "((stack->stack_ + n)->v_.uv%d_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "((stack->stack_ + n)->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[n]->common_)" : "((stack->stack_ + n)->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -2022,11 +2199,11 @@ static int emit_common_visit_snippet_indexed_by_n(struct indented_printer *ip, s
   if (!cc->common_data_assigned_type_) return 0;
   se.code_ = &cc->common_data_assigned_type_->visit_snippet_;
   se.dest_type_ = SEDT_FMT;
-  se.dest_fmt_ = "((stack->stack_ + n)->common_)";
+  se.dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[n]->common_)" : "((stack->stack_ + n)->common_)";
   se.sym_type_ = SEST_NONE;
   se.common_type_ = SECT_NONE;
   se.common_dest_type_ = SECDT_FMT;
-  se.common_dest_fmt_ = "((stack->stack_ + n)->common_)";
+  se.common_dest_fmt_ = cc->segmented_stack_ ? "(stack->stack_[n]->common_)" : "((stack->stack_ + n)->common_)";
   se.setmode_type_ = SESMT_VALID;
   se.chgterm_type_ = SECTT_NONE;
   se.settoken_type_ = SESTT_NONE;
@@ -2106,6 +2283,720 @@ static int emit_newbuf_common_visit_snippet_indexed_by_n(struct indented_printer
 }
 
 
+static void emit_scan_memo_functions(struct indented_printer *ip, struct carburetta_context *cc) {
+  /* Emits the helpers for --linear-scan; these memoize the (scan state, position) pairs from which
+   * the scanner was found to not reach any accepting state (following Reps, "Maximal-Munch" Tokenization
+   * in Linear Time, 1998.) Once a pair is known to fail, any later token that reaches it can stop
+   * scanning right there, so each pair is scanned past at most once, and tokenization as a whole is
+   * linear in the size of the input. */
+  ip_printf(ip, "static void %sscan_memo_clear(struct %sstack *stack) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  if (stack->scan_memo_num_rows_) {\n");
+  ip_printf(ip, "    memset(stack->scan_memo_, 0, stack->scan_memo_num_rows_ * %sscan_memo_row_size_);\n", cc_prefix(cc));
+  ip_printf(ip, "  }\n"
+                "  stack->scan_memo_num_rows_ = 0;\n"
+                "  stack->scan_memo_skip_ = 0;\n"
+                "}\n"
+                "\n");
+  ip_printf(ip, "static void %sscan_memo_advance(struct %sstack *stack, size_t token_size) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  /* Memo rows are indexed by position relative to the start of the match buffer, once a token\n"
+                "   * is moved out of the way, skip its rows. */\n"
+                "  stack->scan_memo_skip_ += token_size;\n"
+                "  if (stack->scan_memo_skip_ >= stack->scan_memo_num_rows_) {\n"
+                "    /* Nothing remembered about the remaining input */\n");
+  ip_printf(ip, "    %sscan_memo_clear(stack);\n", cc_prefix(cc));
+  ip_printf(ip, "  }\n"
+                "  else if (stack->scan_memo_skip_ > (stack->scan_memo_num_rows_allocated_ / 2)) {\n"
+                "    /* Compact; but only once the rows skipped dominate, so this amortizes to constant time per token. */\n"
+                "    size_t num_rows_kept = stack->scan_memo_num_rows_ - stack->scan_memo_skip_;\n");
+  ip_printf(ip, "    memmove(stack->scan_memo_, stack->scan_memo_ + stack->scan_memo_skip_ * %sscan_memo_row_size_, num_rows_kept * %sscan_memo_row_size_);\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "    memset(stack->scan_memo_ + num_rows_kept * %sscan_memo_row_size_, 0, stack->scan_memo_skip_ * %sscan_memo_row_size_);\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "    stack->scan_memo_num_rows_ = num_rows_kept;\n"
+                "    stack->scan_memo_skip_ = 0;\n"
+                "  }\n"
+                "}\n"
+                "\n");
+  ip_printf(ip, "static int %sscan_memo_failed(struct %sstack *stack, size_t scan_state, size_t pos) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  size_t row = stack->scan_memo_skip_ + pos;\n"
+                "  if (row >= stack->scan_memo_num_rows_) return 0;\n");
+  ip_printf(ip, "  return !!(stack->scan_memo_[row * %sscan_memo_row_size_ + (scan_state >> 3)] & (1 << (scan_state & 7)));\n", cc_prefix(cc));
+  ip_printf(ip, "}\n"
+                "\n");
+  ip_printf(ip, "static int %sscan_memo_trail(struct %sstack *stack, size_t scan_state, size_t pos) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  if (stack->scan_trail_size_ == stack->scan_trail_size_allocated_) {\n"
+                "    size_t size_to_allocate = stack->scan_trail_size_allocated_ * 2 + 16;\n"
+                "    if ((size_to_allocate <= stack->scan_trail_size_allocated_) || (size_to_allocate > (SIZE_MAX / (2 * sizeof(size_t))))) {\n");
+  ip_printf(ip, "      return _%sOVERFLOW;\n", cc_PREFIX(cc));
+  ip_printf(ip, "    }\n"
+                "    void *buf = realloc(stack->scan_trail_, size_to_allocate * 2 * sizeof(size_t));\n"
+                "    if (!buf) {\n");
+  ip_printf(ip, "      return _%sNO_MEMORY;\n", cc_PREFIX(cc));
+  ip_printf(ip, "    }\n"
+                "    stack->scan_trail_ = (size_t *)buf;\n"
+                "    stack->scan_trail_size_allocated_ = size_to_allocate;\n"
+                "  }\n"
+                "  stack->scan_trail_[2 * stack->scan_trail_size_] = pos;\n"
+                "  stack->scan_trail_[2 * stack->scan_trail_size_ + 1] = scan_state;\n"
+                "  stack->scan_trail_size_++;\n"
+                "  return 0;\n"
+                "}\n"
+                "\n");
+  ip_printf(ip, "static int %sscan_memo_fail(struct %sstack *stack, size_t from_pos) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  /* Every pair on the trail at or beyond from_pos was visited after the last accepting state\n"
+                "   * of the token and led to no match, remember these and start a new trail for the next token. */\n"
+                "  size_t n = stack->scan_trail_size_;\n"
+                "  if (n && (stack->scan_trail_[2 * (n - 1)] >= from_pos)) {\n"
+                "    size_t num_rows_needed = stack->scan_memo_skip_ + stack->scan_trail_[2 * (n - 1)] + 1;\n"
+                "    if (num_rows_needed > stack->scan_memo_num_rows_allocated_) {\n"
+                "      size_t num_rows_to_allocate = stack->scan_memo_num_rows_allocated_ * 2 + 1;\n"
+                "      if (num_rows_to_allocate < num_rows_needed) {\n"
+                "        num_rows_to_allocate = num_rows_needed;\n"
+                "      }\n");
+  ip_printf(ip, "      if (num_rows_to_allocate > (SIZE_MAX / %sscan_memo_row_size_)) {\n", cc_prefix(cc));
+  ip_printf(ip, "        return _%sOVERFLOW;\n", cc_PREFIX(cc));
+  ip_printf(ip, "      }\n");
+  ip_printf(ip, "      void *buf = realloc(stack->scan_memo_, num_rows_to_allocate * %sscan_memo_row_size_);\n", cc_prefix(cc));
+  ip_printf(ip, "      if (!buf) {\n");
+  ip_printf(ip, "        return _%sNO_MEMORY;\n", cc_PREFIX(cc));
+  ip_printf(ip, "      }\n"
+                "      stack->scan_memo_ = (unsigned char *)buf;\n"
+                "      /* Rows beyond scan_memo_num_rows_ are kept clear at all times */\n");
+  ip_printf(ip, "      memset(stack->scan_memo_ + stack->scan_memo_num_rows_allocated_ * %sscan_memo_row_size_, 0, (num_rows_to_allocate - stack->scan_memo_num_rows_allocated_) * %sscan_memo_row_size_);\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "      stack->scan_memo_num_rows_allocated_ = num_rows_to_allocate;\n"
+                "    }\n"
+                "    if (num_rows_needed > stack->scan_memo_num_rows_) {\n"
+                "      stack->scan_memo_num_rows_ = num_rows_needed;\n"
+                "    }\n"
+                "    while (n && (stack->scan_trail_[2 * (n - 1)] >= from_pos)) {\n"
+                "      n--;\n"
+                "      size_t row = stack->scan_memo_skip_ + stack->scan_trail_[2 * n];\n"
+                "      size_t scan_state = stack->scan_trail_[2 * n + 1];\n");
+  ip_printf(ip, "      stack->scan_memo_[row * %sscan_memo_row_size_ + (scan_state >> 3)] |= (unsigned char)(1 << (scan_state & 7));\n", cc_prefix(cc));
+  ip_printf(ip, "    }\n"
+                "  }\n"
+                "  stack->scan_trail_size_ = 0;\n"
+                "  return 0;\n"
+                "}\n"
+                "\n");
+}
+
+static void emit_segmented_stack_functions(struct indented_printer *ip, struct carburetta_context *cc) {
+  /* Emits the helpers for --segmented-stack; stack->stack_ is an array of pointers to the entries,
+   * which live in segments of 16, 16, 32, 64, .. entries starting at stack->stack_[0], [16], [32],
+   * [64], .. Growing the stack allocates one more segment and reallocates only the array of
+   * pointers, so entries never move and no constructor, move or destructor snippets are run. */
+  ip_printf(ip, "static int %sgrow_segmented_stack(struct %sstack *stack) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  size_t new_num_allocated;\n"
+                "  size_t n;\n"
+                "  struct %ssym_data *segment;\n"
+                "  void *p;\n", cc_prefix(cc));
+  ip_printf(ip, "  if (stack->num_stack_allocated_) {\n"
+                "    new_num_allocated = stack->num_stack_allocated_ * 2;\n"
+                "    if (new_num_allocated <= stack->num_stack_allocated_) {\n"
+                "      /* Overflow in allocation */\n"
+                "      return _%sOVERFLOW;\n", cc_PREFIX(cc));
+  ip_printf(ip, "    }\n"
+                "  }\n"
+                "  else {\n"
+                "    new_num_allocated = 16;\n"
+                "  }\n"
+                "  if (new_num_allocated > (SIZE_MAX / sizeof(struct %ssym_data))) {\n", cc_prefix(cc));
+  ip_printf(ip, "    /* Overflow in allocation */\n"
+                "    return _%sOVERFLOW;\n", cc_PREFIX(cc));
+  ip_printf(ip, "  }\n"
+                "  segment = (struct %ssym_data *)malloc((new_num_allocated - stack->num_stack_allocated_) * sizeof(struct %ssym_data));\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  if (!segment) {\n"
+                "    /* Out of memory */\n"
+                "    return _%sNO_MEMORY;\n", cc_PREFIX(cc));
+  ip_printf(ip, "  }\n"
+                "  p = realloc(stack->stack_, new_num_allocated * sizeof(struct %ssym_data *));\n", cc_prefix(cc));
+  ip_printf(ip, "  if (!p) {\n"
+                "    free(segment);\n"
+                "    /* Out of memory */\n"
+                "    return _%sNO_MEMORY;\n", cc_PREFIX(cc));
+  ip_printf(ip, "  }\n"
+                "  stack->stack_ = (struct %ssym_data **)p;\n", cc_prefix(cc));
+  ip_printf(ip, "  for (n = stack->num_stack_allocated_; n < new_num_allocated; ++n) {\n"
+                "    stack->stack_[n] = segment + (n - stack->num_stack_allocated_);\n"
+                "  }\n"
+                "  stack->num_stack_allocated_ = new_num_allocated;\n"
+                "  return 0;\n"
+                "}\n"
+                "\n");
+  ip_printf(ip, "static void %sfree_segmented_stack(struct %sstack *stack) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  size_t n;\n"
+                "  if (!stack->stack_) return;\n"
+                "  free(stack->stack_[0]);\n"
+                "  for (n = 16; n < stack->num_stack_allocated_; n *= 2) {\n"
+                "    free(stack->stack_[n]);\n"
+                "  }\n"
+                "  free(stack->stack_);\n"
+                "}\n"
+                "\n");
+}
+
+static void emit_scan_lazy_functions(struct indented_printer *ip, struct carburetta_context *cc) {
+  /* Emits the runtime of --lazy-dfa; rather than a DFA computed ahead of time, the scanner carries
+   * the NFA and determinizes the states it actually reaches as it goes, a state being the set of NFA
+   * nodes the input may have led to. States are kept in a cache of a fixed number of states, when it
+   * runs full all but the dead state and the start states of the modes are flushed, so memory stays
+   * bounded however much of the DFA the input explores. */
+  ip_printf(ip, "/* DFA states determinized so far. State 0 is the dead state, states 1 up to and including\n"
+                " * %snum_scan_modes_ are the start states of the modes; these survive a flush. */\n", cc_prefix(cc));
+  ip_printf(ip, "struct %sscan_lazy_dfa {\n", cc_prefix(cc));
+  ip_printf(ip, "  size_t num_states_;\n"
+                "  size_t num_flushes_;\n");
+  ip_printf(ip, "  /* %snum_scan_lazy_columns_ per state, the next state, or -1 if not yet determinized */\n", cc_prefix(cc));
+  ip_printf(ip, "  int *table_;\n"
+                "  size_t *actions_;\n"
+                "  /* NFA nodes of state s, in ascending order, are nodes_[node_index_[s]] up to\n"
+                "   * nodes_[node_index_[s + 1]] */\n"
+                "  size_t *node_index_;\n"
+                "  int *nodes_;\n"
+                "  size_t num_nodes_allocated_;\n"
+                "  /* Open addressing hash of the states by their NFA nodes, each slot is the state + 1, or 0 */\n"
+                "  size_t *hash_;\n"
+                "  /* NFA nodes of the state being determinized, and whether each node is among them */\n"
+                "  int *work_;\n"
+                "  unsigned char *in_work_;\n"
+                "};\n"
+                "\n");
+
+  ip_printf(ip, "static int %sscan_lazy_cmp(const void *left, const void *right) {\n", cc_prefix(cc));
+  ip_printf(ip, "  int l = *(const int *)left;\n"
+                "  int r = *(const int *)right;\n"
+                "  return (l < r) ? -1 : ((l > r) ? 1 : 0);\n"
+                "}\n"
+                "\n");
+
+  ip_printf(ip, "static size_t %sscan_lazy_hash_slot(const int *nodes, size_t num_nodes) {\n", cc_prefix(cc));
+  ip_printf(ip, "  size_t n;\n"
+                "  size_t h = 0;\n"
+                "  for (n = 0; n < num_nodes; ++n) {\n"
+                "    h = h * 31 + (size_t)nodes[n];\n"
+                "  }\n");
+  ip_printf(ip, "  return h %% (2 * %sscan_lazy_max_states_);\n", cc_prefix(cc));
+  ip_printf(ip, "}\n"
+                "\n");
+
+  ip_printf(ip, "static void %sscan_lazy_hash_state(struct %sscan_lazy_dfa *lazy, size_t state) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  size_t first = lazy->node_index_[state];\n");
+  ip_printf(ip, "  size_t slot = %sscan_lazy_hash_slot(lazy->nodes_ + first, lazy->node_index_[state + 1] - first);\n", cc_prefix(cc));
+  ip_printf(ip, "  while (lazy->hash_[slot]) {\n");
+  ip_printf(ip, "    slot = (slot + 1) %% (2 * %sscan_lazy_max_states_);\n", cc_prefix(cc));
+  ip_printf(ip, "  }\n"
+                "  lazy->hash_[slot] = state + 1;\n"
+                "}\n"
+                "\n");
+
+  ip_printf(ip, "static void %sscan_lazy_free(struct %sscan_lazy_dfa *lazy) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  if (lazy->table_) free(lazy->table_);\n"
+                "  if (lazy->actions_) free(lazy->actions_);\n"
+                "  if (lazy->node_index_) free(lazy->node_index_);\n"
+                "  if (lazy->nodes_) free(lazy->nodes_);\n"
+                "  if (lazy->hash_) free(lazy->hash_);\n"
+                "  if (lazy->work_) free(lazy->work_);\n"
+                "  if (lazy->in_work_) free(lazy->in_work_);\n"
+                "  free(lazy);\n"
+                "}\n"
+                "\n");
+
+  ip_printf(ip, "static size_t %sscan_lazy_closure(struct %sscan_lazy_dfa *lazy, size_t num_work, int anchor) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  /* Adds to the NFA nodes in work_ all those reachable over empty transitions, and over the\n"
+                "   * transitions of anchor (-1 for none); returns the new number of nodes. */\n"
+                "  size_t n;\n"
+                "  int t;\n"
+                "  for (n = 0; n < num_work; ++n) {\n"
+                "    int node = lazy->work_[n];\n");
+  ip_printf(ip, "    for (t = %sscan_nfa_nodes_[2 * node + 1]; t < %sscan_nfa_nodes_[2 * node + 3]; ++t) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "      const int *trans = %sscan_nfa_trans_ + 3 * t;\n", cc_prefix(cc));
+  ip_printf(ip, "      if (((trans[1] == -1) || (trans[1] == (-2 - anchor))) && !lazy->in_work_[trans[0]]) {\n"
+                "        lazy->in_work_[trans[0]] = 1;\n"
+                "        lazy->work_[num_work++] = trans[0];\n"
+                "      }\n"
+                "    }\n"
+                "  }\n"
+                "  return num_work;\n"
+                "}\n"
+                "\n");
+
+  ip_printf(ip, "static int %sscan_lazy_add(struct %sscan_lazy_dfa *lazy, size_t num_work) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  /* Adds the state for the (sorted) NFA nodes in work_, the cache must have room for it; returns\n"
+                "   * the state, or -1 if out of memory. */\n"
+                "  size_t state = lazy->num_states_;\n"
+                "  size_t first = lazy->node_index_[state];\n"
+                "  size_t action = 0;\n"
+                "  size_t n;\n"
+                "  if ((lazy->num_nodes_allocated_ - first) < num_work) {\n"
+                "    size_t num_nodes_allocated = lazy->num_nodes_allocated_ * 2 + num_work;\n"
+                "    int *nodes = (int *)realloc(lazy->nodes_, num_nodes_allocated * sizeof(int));\n"
+                "    if (!nodes) return -1;\n"
+                "    lazy->nodes_ = nodes;\n"
+                "    lazy->num_nodes_allocated_ = num_nodes_allocated;\n"
+                "  }\n"
+                "  memcpy(lazy->nodes_ + first, lazy->work_, num_work * sizeof(int));\n"
+                "  lazy->node_index_[state + 1] = first + num_work;\n"
+                "  for (n = 0; n < num_work; ++n) {\n");
+  ip_printf(ip, "    size_t node_action = (size_t)%sscan_nfa_nodes_[2 * lazy->work_[n]];\n", cc_prefix(cc));
+  ip_printf(ip, "    /* Patterns earlier in the grammar have lower actions and take precedence */\n"
+                "    if (node_action && (!action || (node_action < action))) action = node_action;\n"
+                "  }\n"
+                "  lazy->actions_[state] = action;\n");
+  ip_printf(ip, "  for (n = 0; n < %snum_scan_lazy_columns_; ++n) {\n", cc_prefix(cc));
+  ip_printf(ip, "    lazy->table_[state * %snum_scan_lazy_columns_ + n] = -1;\n", cc_prefix(cc));
+  ip_printf(ip, "  }\n"
+                "  lazy->num_states_++;\n");
+  ip_printf(ip, "  %sscan_lazy_hash_state(lazy, state);\n", cc_prefix(cc));
+  ip_printf(ip, "  return (int)state;\n"
+                "}\n"
+                "\n");
+
+  ip_printf(ip, "static void %sscan_lazy_flush(struct %sscan_lazy_dfa *lazy) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  /* Drops all states but the dead state and the start states of the modes; the transitions of\n"
+                "   * the latter are determinized anew as they are needed. */\n"
+                "  size_t state, col;\n");
+  ip_printf(ip, "  lazy->num_states_ = 1 + %snum_scan_modes_;\n", cc_prefix(cc));
+  ip_printf(ip, "  lazy->num_flushes_++;\n");
+  ip_printf(ip, "  memset(lazy->hash_, 0, 2 * %sscan_lazy_max_states_ * sizeof(size_t));\n", cc_prefix(cc));
+  ip_printf(ip, "  for (state = 0; state < lazy->num_states_; ++state) {\n"
+                "    if (state) {\n");
+  ip_printf(ip, "      for (col = 0; col < %snum_scan_lazy_columns_; ++col) {\n", cc_prefix(cc));
+  ip_printf(ip, "        lazy->table_[state * %snum_scan_lazy_columns_ + col] = -1;\n", cc_prefix(cc));
+  ip_printf(ip, "      }\n"
+                "    }\n");
+  ip_printf(ip, "    %sscan_lazy_hash_state(lazy, state);\n", cc_prefix(cc));
+  ip_printf(ip, "  }\n"
+                "}\n"
+                "\n");
+
+  ip_printf(ip, "static int %sscan_lazy_find_or_add(struct %sscan_lazy_dfa *lazy, size_t num_work) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  /* Returns the state for the NFA nodes in work_, adding it if it is new (flushing the cache first\n"
+                "   * if it is full), or -1 if out of memory. */\n"
+                "  size_t n;\n"
+                "  for (n = 0; n < num_work; ++n) {\n"
+                "    lazy->in_work_[lazy->work_[n]] = 0;\n"
+                "  }\n");
+  ip_printf(ip, "  qsort(lazy->work_, num_work, sizeof(int), %sscan_lazy_cmp);\n", cc_prefix(cc));
+  ip_printf(ip, "  size_t slot = %sscan_lazy_hash_slot(lazy->work_, num_work);\n", cc_prefix(cc));
+  ip_printf(ip, "  while (lazy->hash_[slot]) {\n"
+                "    size_t state = lazy->hash_[slot] - 1;\n"
+                "    size_t first = lazy->node_index_[state];\n"
+                "    if (((lazy->node_index_[state + 1] - first) == num_work) && !memcmp(lazy->nodes_ + first, lazy->work_, num_work * sizeof(int))) {\n"
+                "      return (int)state;\n"
+                "    }\n");
+  ip_printf(ip, "    slot = (slot + 1) %% (2 * %sscan_lazy_max_states_);\n", cc_prefix(cc));
+  ip_printf(ip, "  }\n");
+  ip_printf(ip, "  if (lazy->num_states_ == %sscan_lazy_max_states_) {\n", cc_prefix(cc));
+  ip_printf(ip, "    %sscan_lazy_flush(lazy);\n", cc_prefix(cc));
+  ip_printf(ip, "  }\n");
+  ip_printf(ip, "  return %sscan_lazy_add(lazy, num_work);\n", cc_prefix(cc));
+  ip_printf(ip, "}\n"
+                "\n");
+
+  ip_printf(ip, "static int %sscan_lazy_init(struct %sstack *stack) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  /* Allocates the cache with the dead state and the start state of each mode in it */\n");
+  ip_printf(ip, "  struct %sscan_lazy_dfa *lazy = (struct %sscan_lazy_dfa *)malloc(sizeof(struct %sscan_lazy_dfa));\n", cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  size_t n;\n");
+  ip_printf(ip, "  if (!lazy) return _%sNO_MEMORY;\n", cc_PREFIX(cc));
+  ip_printf(ip, "  lazy->num_states_ = 0;\n"
+                "  lazy->num_flushes_ = 0;\n");
+  ip_printf(ip, "  lazy->table_ = (int *)malloc(%sscan_lazy_max_states_ * %snum_scan_lazy_columns_ * sizeof(int));\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  lazy->actions_ = (size_t *)malloc(%sscan_lazy_max_states_ * sizeof(size_t));\n", cc_prefix(cc));
+  ip_printf(ip, "  lazy->node_index_ = (size_t *)malloc((%sscan_lazy_max_states_ + 1) * sizeof(size_t));\n", cc_prefix(cc));
+  ip_printf(ip, "  lazy->num_nodes_allocated_ = %snum_scan_nfa_nodes_;\n", cc_prefix(cc));
+  ip_printf(ip, "  lazy->nodes_ = (int *)malloc(lazy->num_nodes_allocated_ * sizeof(int));\n");
+  ip_printf(ip, "  lazy->hash_ = (size_t *)calloc(2 * %sscan_lazy_max_states_, sizeof(size_t));\n", cc_prefix(cc));
+  ip_printf(ip, "  lazy->work_ = (int *)malloc(%snum_scan_nfa_nodes_ * sizeof(int));\n", cc_prefix(cc));
+  ip_printf(ip, "  lazy->in_work_ = (unsigned char *)calloc(%snum_scan_nfa_nodes_, 1);\n", cc_prefix(cc));
+  ip_printf(ip, "  if (!lazy->table_ || !lazy->actions_ || !lazy->node_index_ || !lazy->nodes_ || !lazy->hash_ || !lazy->work_ || !lazy->in_work_) {\n");
+  ip_printf(ip, "    %sscan_lazy_free(lazy);\n", cc_prefix(cc));
+  ip_printf(ip, "    return _%sNO_MEMORY;\n", cc_PREFIX(cc));
+  ip_printf(ip, "  }\n"
+                "  lazy->node_index_[0] = 0;\n"
+                "\n"
+                "  /* Dead state, all its transitions lead back to it */\n");
+  ip_printf(ip, "  %sscan_lazy_add(lazy, 0);\n", cc_prefix(cc));
+  ip_printf(ip, "  for (n = 0; n < %snum_scan_lazy_columns_; ++n) {\n", cc_prefix(cc));
+  ip_printf(ip, "    lazy->table_[n] = 0;\n"
+                "  }\n"
+                "\n"
+                "  /* Start states of the modes, in order, so M_ constants are their states */\n");
+  ip_printf(ip, "  for (n = 0; n < %snum_scan_modes_; ++n) {\n", cc_prefix(cc));
+  ip_printf(ip, "    lazy->work_[0] = %sscan_nfa_mode_starts_[n];\n", cc_prefix(cc));
+  ip_printf(ip, "    lazy->in_work_[lazy->work_[0]] = 1;\n");
+  ip_printf(ip, "    if (%sscan_lazy_find_or_add(lazy, %sscan_lazy_closure(lazy, 1, -1)) < 0) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "      %sscan_lazy_free(lazy);\n", cc_prefix(cc));
+  ip_printf(ip, "      return _%sNO_MEMORY;\n", cc_PREFIX(cc));
+  ip_printf(ip, "    }\n"
+                "  }\n"
+                "  stack->scan_lazy_ = lazy;\n"
+                "  return 0;\n"
+                "}\n"
+                "\n");
+
+  ip_printf(ip, "static int %sscan_lazy_next(struct %sstack *stack, size_t scan_state, size_t column) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  /* Determinizes the transition of scan_state on column, a symbol group (or byte) or one of the\n"
+                "   * 4 anchors that follow them, and caches it; returns the next state, or -1 if out of memory. */\n");
+  ip_printf(ip, "  struct %sscan_lazy_dfa *lazy = stack->scan_lazy_;\n", cc_prefix(cc));
+  ip_printf(ip, "  const int *nodes = lazy->nodes_ + lazy->node_index_[scan_state];\n"
+                "  size_t num_nodes = lazy->node_index_[scan_state + 1] - lazy->node_index_[scan_state];\n"
+                "  size_t num_work = 0;\n"
+                "  size_t num_flushes = lazy->num_flushes_;\n"
+                "  size_t n;\n"
+                "  int anchor = -1;\n"
+                "  int t;\n"
+                "  int next_state;\n");
+  ip_printf(ip, "  if (column >= (%snum_scan_lazy_columns_ - 4)) {\n", cc_prefix(cc));
+  ip_printf(ip, "    /* An anchor keeps the NFA nodes we have, and adds those its transitions lead to */\n");
+  ip_printf(ip, "    anchor = (int)(column - (%snum_scan_lazy_columns_ - 4));\n", cc_prefix(cc));
+  ip_printf(ip, "    for (n = 0; n < num_nodes; ++n) {\n"
+                "      lazy->in_work_[nodes[n]] = 1;\n"
+                "      lazy->work_[num_work++] = nodes[n];\n"
+                "    }\n"
+                "  }\n"
+                "  else {\n");
+  if (cc->utf8_experimental_) {
+    ip_printf(ip, "    /* All symbols in a group have the same transitions, so any one of them will do */\n");
+    ip_printf(ip, "    int sym = %sscan_lazy_group_symbols_[column];\n", cc_prefix(cc));
+  }
+  else {
+    ip_printf(ip, "    int sym = (int)column;\n");
+  }
+  ip_printf(ip, "    for (n = 0; n < num_nodes; ++n) {\n");
+  ip_printf(ip, "      for (t = %sscan_nfa_nodes_[2 * nodes[n] + 1]; t < %sscan_nfa_nodes_[2 * nodes[n] + 3]; ++t) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "        const int *trans = %sscan_nfa_trans_ + 3 * t;\n", cc_prefix(cc));
+  ip_printf(ip, "        if ((trans[1] <= sym) && (sym < trans[2]) && !lazy->in_work_[trans[0]]) {\n"
+                "          lazy->in_work_[trans[0]] = 1;\n"
+                "          lazy->work_[num_work++] = trans[0];\n"
+                "        }\n"
+                "      }\n"
+                "    }\n"
+                "  }\n");
+  ip_printf(ip, "  num_work = %sscan_lazy_closure(lazy, num_work, anchor);\n", cc_prefix(cc));
+  ip_printf(ip, "  next_state = %sscan_lazy_find_or_add(lazy, num_work);\n", cc_prefix(cc));
+  ip_printf(ip, "  if (next_state < 0) return -1;\n"
+                "  /* Upon a flush, scan_state is gone unless it is a start state */\n");
+  ip_printf(ip, "  if ((num_flushes == lazy->num_flushes_) || (scan_state <= %snum_scan_modes_)) {\n", cc_prefix(cc));
+  ip_printf(ip, "    lazy->table_[scan_state * %snum_scan_lazy_columns_ + column] = next_state;\n", cc_prefix(cc));
+  ip_printf(ip, "  }\n"
+                "  return next_state;\n"
+                "}\n"
+                "\n");
+
+  ip_printf(ip, "static int %sscan_lazy_anchor(struct %sstack *stack, size_t scan_state, int anchor) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  /* Returns the state following the anchor transition of scan_state, or -1 if out of memory */\n");
+  ip_printf(ip, "  size_t column = %snum_scan_lazy_columns_ - 4 + (size_t)anchor;\n", cc_prefix(cc));
+  ip_printf(ip, "  int next_state = stack->scan_lazy_->table_[scan_state * %snum_scan_lazy_columns_ + column];\n", cc_prefix(cc));
+  ip_printf(ip, "  if (next_state < 0) {\n");
+  ip_printf(ip, "    next_state = %sscan_lazy_next(stack, scan_state, column);\n", cc_prefix(cc));
+  ip_printf(ip, "  }\n"
+                "  return next_state;\n"
+                "}\n"
+                "\n");
+}
+
+static void emit_scan_compact_functions(struct indented_printer *ip, struct carburetta_context *cc) {
+  /* Emits the lookup of a transition in the --compact-scan tables (see emit_scan_compact_tables().) The
+   * exceptions of a state end where those of the next state begin, the sentinel row after the last
+   * state holds the end of the exceptions of the last state. */
+  ip_printf(ip, "static size_t %sscan_next(size_t scan_state, size_t column) {\n", cc_prefix(cc));
+  ip_printf(ip, "  const int *state = %sscan_states_ + %d * scan_state;\n", cc_prefix(cc), EMIT_SCAN_COMPACT_STATE_COLUMNS);
+  ip_printf(ip, "  int n;\n");
+  ip_printf(ip, "  for (n = state[1]; n < state[%d]; ++n) {\n", EMIT_SCAN_COMPACT_STATE_COLUMNS + 1);
+  ip_printf(ip, "    if ((size_t)%sscan_exceptions_[2 * n] == column) return (size_t)%sscan_exceptions_[2 * n + 1];\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  }\n");
+  ip_printf(ip, "  return (size_t)%sscan_rows_[(size_t)state[0] + column];\n", cc_prefix(cc));
+  ip_printf(ip, "}\n"
+                "\n");
+}
+
+static void emit_scan_compact_anchors(struct indented_printer *ip, struct carburetta_context *cc, const char *start_of_input_cond, const char *start_of_line_cond, const char *end_of_line_cond, int at_end_of_input) {
+  /* Emits the --compact-scan counterpart of the loop following the anchor transitions of scan_state,
+   * which are kept in the row of the state in <prefix>scan_states_ rather than in the transition table.
+   * end_of_line_cond is NULL if end of line always holds (at the end of input.) */
+  static const char *anchor_names[] = { "start of input", "start of line", "end of line", "end of input" };
+  const char *conds[4];
+  int anchor, num_anchors;
+  conds[REX_ANCHOR_START_OF_INPUT] = start_of_input_cond;
+  conds[REX_ANCHOR_START_OF_LINE] = start_of_line_cond;
+  conds[REX_ANCHOR_END_OF_LINE] = end_of_line_cond;
+  conds[REX_ANCHOR_END_OF_INPUT] = NULL;
+  num_anchors = at_end_of_input ? 4 : 3;
+  ip_printf(ip, "for (;;) {\n");
+  ip_printf(ip, "  const int *anchors = %sscan_states_ + %d * scan_state + 2;\n", cc_prefix(cc), EMIT_SCAN_COMPACT_STATE_COLUMNS);
+  for (anchor = 0; anchor < num_anchors; ++anchor) {
+    if (conds[anchor]) {
+      ip_printf(ip, "  /* Check for %s */\n", anchor_names[anchor]);
+      ip_printf(ip, "  if ((((size_t)anchors[%d]) != scan_state) && (%s)) {\n", anchor, conds[anchor]);
+    }
+    else {
+      ip_printf(ip, "  /* Check for %s (always true at end of input) */\n", anchor_names[anchor]);
+      ip_printf(ip, "  if (((size_t)anchors[%d]) != scan_state) {\n", anchor);
+    }
+    ip_printf(ip, "    scan_state = (size_t)anchors[%d];\n"
+                  "    continue;\n"
+                  "  }\n", anchor);
+  }
+  if (!at_end_of_input) {
+    ip_printf(ip, "  /* (No need to check for end of input; we have at least 1 character ahead) */\n");
+  }
+  ip_printf(ip, "  break;\n"
+                "}\n");
+}
+
+static void emit_scan_transition(struct indented_printer *ip, struct carburetta_context *cc, const char *pos_expr, const char *column_expr) {
+  /* Emits the transition of scan_state on the current input, column_expr is its column in the transition table
+   * and its position relative to the start of the match buffer is in pos_expr (needed for --linear-scan only.) */
+  if (cc->instrument_) {
+    ip_printf(ip, "++%sprofile_scan_states_[scan_state];\n", cc_prefix(cc));
+    if (cc->utf8_experimental_) {
+      ip_printf(ip, "++%sprofile_scan_columns_[%s];\n", cc_prefix(cc), column_expr);
+    }
+  }
+  if (cc->lazy_dfa_max_states_) {
+    /* Negative if not yet determinized */
+    ip_printf(ip, "{\n"
+                  "  int next_state = transition_table[row_size * scan_state + %s];\n", column_expr);
+    ip_printf(ip, "  if (next_state < 0) {\n"
+                  "    next_state = %sscan_lazy_next(stack, scan_state, %s);\n", cc_prefix(cc), column_expr);
+    ip_printf(ip, "    if (next_state < 0) return _%sNO_MEMORY;\n", cc_PREFIX(cc));
+    ip_printf(ip, "  }\n"
+                  "  scan_state = (size_t)next_state;\n"
+                  "}\n");
+    return;
+  }
+  if (!cc->linear_scan_) {
+    if (cc->compact_scan_) {
+      ip_printf(ip, "scan_state = %sscan_next(scan_state, %s);\n", cc_prefix(cc), column_expr);
+    }
+    else {
+      ip_printf(ip, "scan_state = transition_table[row_size * scan_state + %s];\n", column_expr);
+    }
+    return;
+  }
+  ip_printf(ip, "if (%sscan_memo_failed(stack, scan_state, %s)) {\n", cc_prefix(cc), pos_expr);
+  ip_printf(ip, "  /* Known to not lead to a match from here on, no need to scan any further */\n"
+                "  scan_state = 0;\n"
+                "}\n"
+                "else {\n");
+  ip_printf(ip, "  r = %sscan_memo_trail(stack, scan_state, %s);\n", cc_prefix(cc), pos_expr);
+  ip_printf(ip, "  if (r) return r;\n");
+  if (cc->compact_scan_) {
+    ip_printf(ip, "  scan_state = %sscan_next(scan_state, %s);\n", cc_prefix(cc), column_expr);
+  }
+  else {
+    ip_printf(ip, "  scan_state = transition_table[row_size * scan_state + %s];\n", column_expr);
+  }
+  ip_printf(ip, "}\n");
+}
+
+static void emit_parse_profile_count(struct indented_printer *ip, struct carburetta_context *cc, const char *sym_expr) {
+  /* Emits the counting, for --instrument, of the lookup in the parse table for sym_expr in the state on top of the stack */
+  if (!cc->instrument_) return;
+  ip_printf(ip, cc->segmented_stack_ ? "++%sprofile_parse_states_[stack->stack_[stack->pos_ - 1]->state_];\n"
+                                     : "++%sprofile_parse_states_[stack->stack_[stack->pos_ - 1].state_];\n", cc_prefix(cc));
+  ip_printf(ip, "++%sprofile_parse_columns_[%s - %sminimum_sym];\n", cc_prefix(cc), sym_expr, cc_prefix(cc));
+}
+
+static void emit_profile_counters(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct rex_scanner *rex, struct lr_generator *lalr) {
+  /* Emits the counts kept by a parser generated with --instrument, and <prefix>profile_write() to write them
+   * out in the format read by --profile (see profile.h), sized as the tables are. */
+  size_t num_scan_states = (prdg->num_patterns_ && rex->dfa_.nodes_) ? (size_t)rex->dfa_.nodes_->ordinal_ + 1 : 0;
+  size_t num_scan_columns = (num_scan_states && cc->utf8_experimental_ && rex->dfa_.symbol_groups_) ? (size_t)rex->dfa_.symbol_groups_->ordinal_ + 1 : 0;
+  size_t num_parse_columns = (size_t)(1 + lalr->max_sym_ - lalr->min_sym_);
+  if (num_scan_states) {
+    ip_printf(ip, "static unsigned long long %sprofile_scan_states_[%zu];\n", cc_prefix(cc), num_scan_states);
+  }
+  if (num_scan_columns) {
+    ip_printf(ip, "static unsigned long long %sprofile_scan_columns_[%zu];\n", cc_prefix(cc), num_scan_columns);
+  }
+  ip_printf(ip, "static unsigned long long %sprofile_parse_states_[%d];\n", cc_prefix(cc), lalr->nr_states_);
+  ip_printf(ip, "static unsigned long long %sprofile_parse_columns_[%zu];\n", cc_prefix(cc), num_parse_columns);
+  ip_printf(ip, "static void %sprofile_write_counts(FILE *fp, const char *size_keyword, const char *count_keyword, const unsigned long long *counts, size_t num_counts) {\n", cc_prefix(cc));
+  ip_printf(ip, "  size_t n;\n"
+                "  fprintf(fp, \"%%s %%lu\\n\", size_keyword, (unsigned long)num_counts);\n"
+                "  for (n = 0; n < num_counts; ++n) {\n"
+                "    if (counts[n]) fprintf(fp, \"%%s %%lu %%llu\\n\", count_keyword, (unsigned long)n, counts[n]);\n"
+                "  }\n"
+                "}\n");
+  ip_printf(ip, "int %sprofile_write(const char *filename) {\n", cc_prefix(cc));
+  ip_printf(ip, "  FILE *fp = fopen(filename, \"w\");\n"
+                "  if (!fp) return -1;\n"
+                "  fprintf(fp, \"carburetta-profile 1\\n\");\n");
+  if (num_scan_states) {
+    ip_printf(ip, "  %sprofile_write_counts(fp, \"scan-states\", \"scan-state\", %sprofile_scan_states_, %zu);\n", cc_prefix(cc), cc_prefix(cc), num_scan_states);
+  }
+  if (num_scan_columns) {
+    ip_printf(ip, "  %sprofile_write_counts(fp, \"scan-columns\", \"scan-column\", %sprofile_scan_columns_, %zu);\n", cc_prefix(cc), cc_prefix(cc), num_scan_columns);
+  }
+  ip_printf(ip, "  %sprofile_write_counts(fp, \"parse-states\", \"parse-state\", %sprofile_parse_states_, %d);\n", cc_prefix(cc), cc_prefix(cc), lalr->nr_states_);
+  ip_printf(ip, "  %sprofile_write_counts(fp, \"parse-columns\", \"parse-column\", %sprofile_parse_columns_, %zu);\n", cc_prefix(cc), cc_prefix(cc), num_parse_columns);
+  ip_printf(ip, "  return fclose(fp) ? -1 : 0;\n"
+                "}\n");
+}
+
+static void emit_scan_lazy_locals(struct indented_printer *ip, struct carburetta_context *cc) {
+  /* Emits the locals of the lex function for --lazy-dfa, the transition table is that of the states
+   * determinized so far, which is allocated upon first use. */
+  ip_printf(ip, "  if (!stack->scan_lazy_) {\n");
+  ip_printf(ip, "    r = %sscan_lazy_init(stack);\n", cc_prefix(cc));
+  ip_printf(ip, "    if (r) return r;\n"
+                "  }\n"
+                "  const int *transition_table = stack->scan_lazy_->table_;\n"
+                "  const size_t *actions = stack->scan_lazy_->actions_;\n");
+  ip_printf(ip, "  const size_t row_size = %snum_scan_lazy_columns_;\n", cc_prefix(cc));
+}
+
+static void emit_scan_lazy_anchors(struct indented_printer *ip, struct carburetta_context *cc, const char *start_of_input_cond, const char *start_of_line_cond, const char *end_of_line_cond, int at_end_of_input) {
+  /* Emits the --lazy-dfa counterpart of the loop following the anchor transitions of scan_state; each
+   * anchor whose condition holds is taken if it leads elsewhere, after determinizing it if needed.
+   * end_of_line_cond is NULL if end of line always holds (at the end of input.) */
+  static const char *anchor_names[] = { "start of input", "start of line", "end of line", "end of input" };
+  const char *conds[4];
+  int anchor, num_anchors;
+  conds[REX_ANCHOR_START_OF_INPUT] = start_of_input_cond;
+  conds[REX_ANCHOR_START_OF_LINE] = start_of_line_cond;
+  conds[REX_ANCHOR_END_OF_LINE] = end_of_line_cond;
+  conds[REX_ANCHOR_END_OF_INPUT] = NULL;
+  num_anchors = at_end_of_input ? 4 : 3;
+  ip_printf(ip, "for (;;) {\n"
+                "  int anchor_state;\n");
+  for (anchor = 0; anchor < num_anchors; ++anchor) {
+    if (conds[anchor]) {
+      ip_printf(ip, "  /* Check for %s */\n", anchor_names[anchor]);
+      ip_printf(ip, "  if (%s) {\n", conds[anchor]);
+    }
+    else {
+      ip_printf(ip, "  /* Check for %s (always true at end of input) */\n", anchor_names[anchor]);
+      ip_printf(ip, "  {\n");
+    }
+    ip_printf(ip, "    anchor_state = %sscan_lazy_anchor(stack, scan_state, %d);\n", cc_prefix(cc), anchor);
+    ip_printf(ip, "    if (anchor_state < 0) return _%sNO_MEMORY;\n", cc_PREFIX(cc));
+    ip_printf(ip, "    if ((size_t)anchor_state != scan_state) {\n"
+                  "      scan_state = (size_t)anchor_state;\n"
+                  "      continue;\n"
+                  "    }\n"
+                  "  }\n");
+  }
+  if (!at_end_of_input) {
+    ip_printf(ip, "  /* (No need to check for end of input; we have at least 1 character ahead) */\n");
+  }
+  ip_printf(ip, "  break;\n"
+                "}\n");
+}
+
+static void emit_scan_memo_fail(struct indented_printer *ip, struct carburetta_context *cc, const char *from_pos_expr) {
+  if (!cc->linear_scan_) return;
+  ip_printf(ip, "r = %sscan_memo_fail(stack, %s);\n", cc_prefix(cc), from_pos_expr);
+  ip_printf(ip, "if (r) return r;\n");
+}
+
+static void emit_terminator_repair_in_place(struct indented_printer *ip, struct carburetta_context *cc) {
+  /* Emits the restoration of the input byte overwritten by the zero-terminator of a token matched in
+   * place, for when the stack lets go of the token without scanning the next. */
+  ip_printf(ip, "  if (stack->token_size_ && (stack->token_text_ != stack->match_buffer_)) {\n"
+                "    /* Token was matched in place, restore the caller's input */\n"
+                "    stack->token_text_[stack->token_size_] = stack->terminator_repair_;\n"
+                "  }\n");
+}
+
+static void emit_set_input_in_place(struct indented_printer *ip, struct carburetta_context *cc) {
+  /* Emits <prefix>set_input_in_place(), its comment states how long the caller must keep input */
+  ip_printf(ip, "/* As %sset_input(), but a token lying entirely within input is zero-terminated where it\n"
+                "** is rather than copied to the match buffer. The byte overwritten, just past the end of the\n"
+                "** token and always within input, is put back on the next call to %sscan() or %slex(), or\n"
+                "** by %sstack_reset() or %sstack_cleanup(), whichever comes first; until then input must\n"
+                "** remain valid and is not to be changed by the caller. As the stack may hold on to the last\n"
+                "** token returned, a buffer passed here must outlive the stack, or %sstack_reset() must be\n"
+                "** called before the buffer is released. */\n",
+                cc_prefix(cc), cc_prefix(cc), cc_prefix(cc), cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "void %sset_input_in_place(struct %sstack *stack, char *input, size_t input_size, int is_final_input) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  stack->input_ = input;\n"
+                "  stack->input_size_ = input_size;\n"
+                "  stack->is_final_input_ = is_final_input;\n"
+                "  stack->input_in_place_ = 1;\n"
+                "  stack->input_index_ = 0;\n");
+  ip_printf(ip, "}\n"
+                "\n");
+}
+
+static void emit_lex_match_in_place(struct indented_printer *ip, struct carburetta_context *cc) {
+  /* Emits the branch of the input loop that, on end of token, returns a token lying entirely within
+   * input passed to set_input_in_place() without copying it to the match buffer. */
+  ip_printf(ip, "if (stack->input_in_place_ && !stack->match_buffer_size_ && (best_match_action != default_action)) {\n"
+                "  /* Terminate the token inside the input rather than copying it, anything scanned past the\n"
+                "   * end of the token is scanned again from the input on the next call. */\n"
+                "  stack->token_text_ = (char *)input + stack->input_index_;\n"
+                "  stack->terminator_repair_ = stack->token_text_[best_match_size];\n"
+                "  stack->token_text_[best_match_size] = '\\0';\n"
+                "  stack->token_size_ = best_match_size;\n"
+                "  stack->best_match_action_ = best_match_action;\n"
+                "  stack->best_match_size_ = best_match_size;\n"
+                "  stack->best_match_offset_ = best_match_offset;\n"
+                "  stack->best_match_line_ = best_match_line;\n"
+                "  stack->best_match_col_ = best_match_col;\n"
+                "\n"
+                "  stack->input_index_ += best_match_size;\n"
+                "  stack->input_offset_ = best_match_offset;\n"
+                "  stack->input_line_ = best_match_line;\n"
+                "  stack->input_col_ = best_match_col;\n");
+  if (cc->utf8_experimental_) {
+    ip_printf(ip, "\n"
+                  "  stack->cp_ = stack->codepoint_;\n"
+                  "  stack->sym_grp_ = 0;\n");
+  }
+  ip_printf(ip, "\n");
+  emit_scan_memo_fail(ip, cc, "best_match_size + 1");
+  ip_printf(ip, "  return _%sMATCH;\n", cc_PREFIX(cc));
+  ip_printf(ip, "}\n");
+}
+
+static int typestr_has_code(struct typestr *ts) {
+  /* Returns non-zero if data of type ts needs code to be constructed, moved or destructed */
+  return ts && (ts->constructor_snippet_.num_tokens_ || ts->move_snippet_.num_tokens_ || ts->destructor_snippet_.num_tokens_);
+}
+
+static int scan_fused_applies(struct carburetta_context *cc) {
+  /* Returns non-zero if <prefix>scan() gets the fast path of <prefix>scan_fused(); the scanner must use
+   * the plain transition tables, and no code must run for every token regardless of its pattern. */
+  if (cc->lazy_dfa_max_states_ || cc->compact_scan_ || cc->linear_scan_ || cc->instrument_) return 0;
+  if (cc->on_scan_token_snippet_.num_tokens_) return 0;
+  if (typestr_has_code(cc->common_data_assigned_type_)) return 0;
+  return 1;
+}
+
+static void emit_lex_match_rescan(struct indented_printer *ip, struct carburetta_context *cc) {
+  /* Emits the branch of the input loop that, on end of token, copies only the token to the match buffer
+   * when all of the lookahead lies within the current input; leaving the match buffer empty once the
+   * token is moved out of the way, so <prefix>scan_fused() can take over again on the next token. */
+  ip_printf(ip, "if ((best_match_action != default_action) && (best_match_size >= stack->match_buffer_size_)) {\n"
+                "  /* Anything scanned past the end of the token is scanned again from the input on the next call. */\n"
+                "  size_t token_remainder = best_match_size - stack->match_buffer_size_;\n");
+  ip_printf(ip, "  r = %sappend_match_buffer(stack, input + stack->input_index_, token_remainder);\n", cc_prefix(cc));
+  ip_printf(ip, "  if (r) return r;\n"
+                "  stack->terminator_repair_ = stack->match_buffer_[best_match_size];\n"
+                "  stack->match_buffer_[best_match_size] = '\\0';\n"
+                "  stack->token_text_ = stack->match_buffer_;\n"
+                "  stack->token_size_ = best_match_size;\n"
+                "  stack->best_match_action_ = best_match_action;\n"
+                "  stack->best_match_size_ = best_match_size;\n"
+                "  stack->best_match_offset_ = best_match_offset;\n"
+                "  stack->best_match_line_ = best_match_line;\n"
+                "  stack->best_match_col_ = best_match_col;\n"
+                "\n"
+                "  stack->input_index_ += token_remainder;\n"
+                "  stack->input_offset_ = best_match_offset;\n"
+                "  stack->input_line_ = best_match_line;\n"
+                "  stack->input_col_ = best_match_col;\n");
+  if (cc->utf8_experimental_) {
+    ip_printf(ip, "\n"
+                  "  stack->cp_ = stack->codepoint_;\n"
+                  "  stack->sym_grp_ = 0;\n");
+  }
+  ip_printf(ip, "\n"
+                "  return _%sMATCH;\n", cc_PREFIX(cc));
+  ip_printf(ip, "}\n");
+}
+
 static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg) {
   /* Emit the scan function, it scans the input for regex matches without actually executing any actions */
   /* (we're obviously in need of a templating language..) */
@@ -2123,6 +3014,19 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                 "  if (size_needed < 128) {\n"
                 "    size_needed = 128;\n"
                 "  }\n"
+                "  if (size_needed > (stack->match_buffer_size_allocated_ - stack->match_buffer_skip_)) {\n"
+                "    /* Out of room at the tail; if more than half the buffer is held by tokens already consumed,\n"
+                "     * reclaim that space by moving the remainder down, otherwise account for it and grow. */\n"
+                "    if (stack->match_buffer_skip_ > (stack->match_buffer_size_allocated_ / 2)) {\n"
+                "      memmove(stack->match_buffer_ - stack->match_buffer_skip_, stack->match_buffer_, stack->match_buffer_size_);\n"
+                "      stack->match_buffer_ -= stack->match_buffer_skip_;\n"
+                "      stack->match_buffer_skip_ = 0;\n"
+                "    }\n"
+                "    if (stack->match_buffer_skip_ > (SIZE_MAX - size_needed)) {\n");
+  ip_printf(ip, "      return _%sOVERFLOW;\n", cc_PREFIX(cc));
+  ip_printf(ip, "    }\n"
+                "    size_needed += stack->match_buffer_skip_;\n"
+                "  }\n"
                 "  if (size_needed > stack->match_buffer_size_allocated_) {\n"
                 "    /* intent of code: grow buffer size by powers of 2-1, unless our needs require more now. */\n"
                 "    size_t size_to_allocate = stack->match_buffer_size_allocated_ * 2 + 1;\n"
@@ -2132,11 +3036,11 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                 "    if (size_to_allocate < size_needed) {\n"
                 "      size_to_allocate = size_needed;\n"
                 "    }\n"
-                "    void *buf = realloc(stack->match_buffer_, size_to_allocate);\n"
+                "    void *buf = realloc(stack->match_buffer_skip_ ? stack->match_buffer_ - stack->match_buffer_skip_ : stack->match_buffer_, size_to_allocate);\n"
                 "    if (!buf) {\n");
   ip_printf(ip, "      return _%sNO_MEMORY;\n", cc_PREFIX(cc));
   ip_printf(ip, "    }\n"
-                "    stack->match_buffer_ = (char *)buf;\n"
+                "    stack->match_buffer_ = (char *)buf + stack->match_buffer_skip_;\n"
                 "    stack->match_buffer_size_allocated_ = size_to_allocate;\n"
                 "  }\n"
                 "\n"
@@ -2150,10 +3054,13 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
   ip_printf(ip, "  stack->input_ = input;\n"
                 "  stack->input_size_ = input_size;\n"
                 "  stack->is_final_input_ = is_final_input;\n"
+                "  stack->input_in_place_ = 0;\n"
                 "  stack->input_index_ = 0;\n");
   ip_printf(ip, "}\n"
                 "\n");
 
+  emit_set_input_in_place(ip, cc);
+
   ip_printf(ip,  "void %sset_location(struct %sstack *stack, int line, int col, size_t offset) {\n", cc_prefix(cc), cc_prefix(cc));
   ip_printf(ip,  "  if (stack->token_size_) {\n");
   ip_printf(ip,  "    /* Parsing of next token not in progress, set end location of this token as\n");
@@ -2179,11 +3086,15 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
   ip_printf(ip,  "  stack->match_line_ = line;\n");
   ip_printf(ip,  "  stack->match_col_ = col;\n");
   ip_printf(ip,  "  stack->match_offset_ = offset;\n");
+  if (cc->linear_scan_) {
+    /* Anchors depend on the location, so anything learned before may no longer hold */
+    ip_printf(ip, "  %sscan_memo_clear(stack);\n", cc_prefix(cc));
+  }
   ip_printf(ip, "}\n"
                 "\n");
 
   ip_printf(ip, "const char *%stext(struct %sstack *stack) {\n"
-                "  return stack->match_buffer_;\n"
+                "  return stack->token_text_;\n"
                 "}\n"
                 "\n", cc_prefix(cc), cc_prefix(cc));
 
@@ -2224,7 +3135,8 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
 
   ip_printf(ip, "void *%stoken_common_data(struct %sstack *stack) {\n", cc_prefix(cc), cc_prefix(cc));
   if (cc->common_data_assigned_type_) {
-    ip_printf(ip, "  return stack->slot_0_has_common_data_ ? &stack->stack_[0].common_ : NULL;\n");
+    ip_printf(ip, cc->segmented_stack_ ? "  return stack->slot_0_has_common_data_ ? &stack->stack_[0]->common_ : NULL;\n"
+                                       : "  return stack->slot_0_has_common_data_ ? &stack->stack_[0].common_ : NULL;\n");
   }
   else {
     ip_printf(ip, "  return NULL; /* no %%common_type or %%common_class so this is always NULL */\n");
@@ -2238,12 +3150,26 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "  size_t input_size = stack->input_size_;\n"
                  "  int is_final_input = !!stack->is_final_input_;\n"
                  "  size_t scan_state = stack->scan_state_;\n");
-  ip_printf(ip,  "  const int *transition_table = %sscan_table_grouped_rex_;\n", cc_prefix(cc));
-  ip_printf(ip,  "  const size_t *actions = %sscan_actions_rex;\n", cc_prefix(cc));
-  ip_printf(ip,  "  const size_t row_size = %snum_scan_table_grouped_columns_;\n", cc_prefix(cc));
+  if (cc->lazy_dfa_max_states_) {
+    emit_scan_lazy_locals(ip, cc);
+  }
+  else if (cc->compact_scan_) {
+    ip_printf(ip,  "  const size_t *actions = %sscan_actions_rex;\n", cc_prefix(cc));
+  }
+  else {
+    ip_printf(ip,  "  const int *transition_table = %sscan_table_grouped_rex_;\n", cc_prefix(cc));
+    ip_printf(ip,  "  const size_t *actions = %sscan_actions_rex;\n", cc_prefix(cc));
+    ip_printf(ip,  "  const size_t row_size = %snum_scan_table_grouped_columns_;\n", cc_prefix(cc));
+  }
   ip_printf(ip,  "  const size_t default_action = %zu;\n", 0);
   ip_printf(ip,  "  const size_t start_action = 0;\n", cc_prefix(cc));
-  ip_printf(ip,  "  char *cp = stack->cp_;\n");
+  ip_printf(ip,  "  /* The codepoint being decoded is kept in a local copy, so its byte stores cannot alias the\n"
+                 "   * fields of the stack and those fields read in the loops below stay in registers; it is\n"
+                 "   * spilled back to the stack whenever we return. */\n"
+                 "  char codepoint[sizeof(stack->codepoint_)];\n"
+                 "  char *cp;\n"
+                 "  memcpy(codepoint, stack->codepoint_, sizeof(codepoint));\n"
+                 "  cp = codepoint + (stack->cp_ - stack->codepoint_);\n");
   ip_printf(ip,  "\n"
                  "  size_t match_index = stack->match_index_;\n"
                  "\n"
@@ -2263,11 +3189,21 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "\n"
                  "  /* Move any prior token out of the way */\n"
                  "  if (stack->token_size_) {\n"
-                 "    stack->match_buffer_[stack->token_size_] = stack->terminator_repair_;\n"
+                 "    stack->token_text_[stack->token_size_] = stack->terminator_repair_;\n"
                  "\n"
-                 "    memcpy(stack->match_buffer_, stack->match_buffer_ + stack->token_size_, stack->match_buffer_size_ - stack->token_size_);\n"
-                 "    stack->match_buffer_size_ -= stack->token_size_;\n"
-                 "    stack->match_offset_ = stack->best_match_offset_;\n"
+                 "    if (stack->token_text_ == stack->match_buffer_) {\n"
+                 "      /* Step past it rather than moving the remainder down, %sappend_match_buffer() compacts lazily */\n"
+                 "      stack->match_buffer_ += stack->token_size_;\n"
+                 "      stack->match_buffer_skip_ += stack->token_size_;\n"
+                 "      stack->match_buffer_size_ -= stack->token_size_;\n"
+                 "    }\n"
+                 "    stack->token_text_ = stack->match_buffer_;\n",
+                 cc_prefix(cc)
+                 );
+  if (cc->linear_scan_) {
+    ip_printf(ip, "    %sscan_memo_advance(stack, stack->token_size_);\n", cc_prefix(cc));
+  }
+  ip_printf(ip,  "    stack->match_offset_ = stack->best_match_offset_;\n"
                  "    stack->match_line_ = stack->best_match_line_;\n"
                  "    stack->match_col_ = stack->best_match_col_;\n"
                  "    \n"
@@ -2305,28 +3241,36 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "          *cp++ = c;\n"
                  "        }\n"
                  "      }\n"
-                 "\n"
-                 "      for (;;) {\n"
-                 "        /* Check for start of input */\n"
-                 "        if ((((size_t)transition_table[row_size * (1 + scan_state) - 4]) != scan_state) && (!at_match_index_offset)) {\n"
-                 "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 4];\n"
-                 "        }\n"
-                 "        /* Check for start of line */\n"
-                 "        else if ((((size_t)transition_table[row_size * (1 + scan_state) - 3]) != scan_state) && (at_match_index_col == 1)) {\n"
-                 "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 3];\n"
-                 "        }\n"
-                 "        /* Check for end of line */\n"
-                 "        else if ((((size_t)transition_table[row_size * (1 + scan_state) - 2]) != scan_state) && ('\\n' == stack->codepoint_[0])) {\n"
-                 "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 2];\n"
-                 "        }\n"
-                 "        /* (No need to check for end of input; we have at least 1 character ahead) */\n"
-                 "        else {\n"
-                 "          break;\n"
-                 "        }\n"
-                 "      }\n"
-                 "      size_t state_action;\n"
+                 "\n");
+  if (cc->lazy_dfa_max_states_) {
+    emit_scan_lazy_anchors(ip, cc, "!at_match_index_offset", "at_match_index_col == 1", "'\\n' == codepoint[0]", 0);
+  }
+  else if (cc->compact_scan_) {
+    emit_scan_compact_anchors(ip, cc, "!at_match_index_offset", "at_match_index_col == 1", "'\\n' == codepoint[0]", 0);
+  }
+  else {
+    ip_printf(ip, "      for (;;) {\n"
+                  "        /* Check for start of input */\n"
+                  "        if ((((size_t)transition_table[row_size * (1 + scan_state) - 4]) != scan_state) && (!at_match_index_offset)) {\n"
+                  "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 4];\n"
+                  "        }\n"
+                  "        /* Check for start of line */\n"
+                  "        else if ((((size_t)transition_table[row_size * (1 + scan_state) - 3]) != scan_state) && (at_match_index_col == 1)) {\n"
+                  "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 3];\n"
+                  "        }\n"
+                  "        /* Check for end of line */\n"
+                  "        else if ((((size_t)transition_table[row_size * (1 + scan_state) - 2]) != scan_state) && ('\\n' == codepoint[0])) {\n"
+                  "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 2];\n"
+                  "        }\n"
+                  "        /* (No need to check for end of input; we have at least 1 character ahead) */\n"
+                  "        else {\n"
+                  "          break;\n"
+                  "        }\n"
+                  "      }\n");
+  }
+  ip_printf(ip,  "      size_t state_action;\n"
                  "      state_action = actions[scan_state];\n"
-                 "      ptrdiff_t cp_len = cp - stack->codepoint_;\n"
+                 "      ptrdiff_t cp_len = cp - codepoint;\n"
                  "      if (state_action != default_action) /* replace with actual */ {\n"
                  "        best_match_action = state_action;\n"
                  "        best_match_size = match_index - cp_len;\n"
@@ -2334,13 +3278,14 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "        best_match_line = at_match_index_line;\n"
                  "        best_match_col = at_match_index_col;\n"
                  "      }\n"
-                 "      scan_state = transition_table[row_size * scan_state + symgrp];\n"
-                 "      /* reset decoder */\n"
+                 );
+  emit_scan_transition(ip, cc, "match_index - (size_t)cp_len", "symgrp");
+  ip_printf(ip,  "      /* reset decoder */\n"
                  "      symgrp = 0;\n"
-                 "      cp = stack->codepoint_;\n"
+                 "      cp = codepoint;\n"
                  "      if (scan_state) {\n"
                  "        at_match_index_offset += (size_t)cp_len;\n"
-                 "        if (stack->codepoint_[0] != '\\n') {\n"
+                 "        if (codepoint[0] != '\\n') {\n"
                  "          at_match_index_col++;\n"
                  "        }\n"
                  "        else {\n"
@@ -2357,6 +3302,7 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "        /* Ensure token match is null terminated */\n"
                  "        stack->terminator_repair_ = stack->match_buffer_[best_match_size];\n"
                  "        stack->match_buffer_[best_match_size] = '\\0';\n"
+                 "        stack->token_text_ = stack->match_buffer_;\n"
                  "        stack->token_size_ = best_match_size;\n"
                  "        stack->best_match_action_ = best_match_action;\n"
                  "        stack->best_match_size_ = best_match_size;\n"
@@ -2369,9 +3315,11 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "        stack->input_line_ = input_line;\n"
                  "        stack->input_col_ = input_col;\n"
                  "\n"
-                 "        stack->cp_ = cp;\n"
+                 "        memcpy(stack->codepoint_, codepoint, sizeof(codepoint));\n"
+                 "        stack->cp_ = stack->codepoint_ + (cp - codepoint);\n"
                  "        stack->sym_grp_ = symgrp;\n"
                  "\n");
+  emit_scan_memo_fail(ip, cc, "best_match_size + 1");
   ip_printf(ip,  "        return _%sMATCH;\n", cc_PREFIX(cc));
   ip_printf(ip,  "      }\n"
                  "    }\n"
@@ -2406,30 +3354,38 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "        }\n"
                  "      }\n"
                  "\n");
-  ip_printf(ip,  "      for (;;) {\n"
-                 "        /* Check for start of input */\n"
-                 /* 256 + REX_ANCHOR_START_OF_INPUT */
-                 "        if ((((size_t)transition_table[row_size * (1 + scan_state) - 4]) != scan_state) && (!input_offset)) {\n"
-                 "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 4];\n"
-                 "        }\n"
-                 "        /* Check for start of line */\n"
-                 /* 256 + REX_ANCHOR_START_OF_LINE */
-                 "        else if ((((size_t)transition_table[row_size * (1 + scan_state) - 3]) != scan_state) && (input_col == 1)) {\n"
-                 "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 3];\n"
-                 "        }\n"
-                 "        /* Check for end of line */\n"
-                 /* 256 + REX_ANCHOR_END_OF_LINE */
-                 "        else if ((((size_t)transition_table[row_size * (1 + scan_state) - 2]) != scan_state) && ('\\n' == stack->codepoint_[0])) {\n"
-                 "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 2];\n"
-                 "        }\n"
-                 "        /* (No need to check for end of input; we have at least 1 character ahead) */\n"
-                 "        else {\n"
-                 "          break;\n"
-                 "        }\n"
-                 "      }\n"
-                 "      size_t state_action;\n"
+  if (cc->lazy_dfa_max_states_) {
+    emit_scan_lazy_anchors(ip, cc, "!input_offset", "input_col == 1", "'\\n' == codepoint[0]", 0);
+  }
+  else if (cc->compact_scan_) {
+    emit_scan_compact_anchors(ip, cc, "!input_offset", "input_col == 1", "'\\n' == codepoint[0]", 0);
+  }
+  else {
+    ip_printf(ip, "      for (;;) {\n"
+                  "        /* Check for start of input */\n"
+                  /* 256 + REX_ANCHOR_START_OF_INPUT */
+                  "        if ((((size_t)transition_table[row_size * (1 + scan_state) - 4]) != scan_state) && (!input_offset)) {\n"
+                  "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 4];\n"
+                  "        }\n"
+                  "        /* Check for start of line */\n"
+                  /* 256 + REX_ANCHOR_START_OF_LINE */
+                  "        else if ((((size_t)transition_table[row_size * (1 + scan_state) - 3]) != scan_state) && (input_col == 1)) {\n"
+                  "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 3];\n"
+                  "        }\n"
+                  "        /* Check for end of line */\n"
+                  /* 256 + REX_ANCHOR_END_OF_LINE */
+                  "        else if ((((size_t)transition_table[row_size * (1 + scan_state) - 2]) != scan_state) && ('\\n' == codepoint[0])) {\n"
+                  "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 2];\n"
+                  "        }\n"
+                  "        /* (No need to check for end of input; we have at least 1 character ahead) */\n"
+                  "        else {\n"
+                  "          break;\n"
+                  "        }\n"
+                  "      }\n");
+  }
+  ip_printf(ip,  "      size_t state_action;\n"
                  "      state_action = actions[scan_state];\n"
-                 "      ptrdiff_t cp_len = cp - stack->codepoint_;\n"
+                 "      ptrdiff_t cp_len = cp - codepoint;\n"
                  "      if (state_action != default_action) /* replace with actual */ {\n"
                  "        best_match_action = state_action;\n"
                  "        best_match_size = stack->match_buffer_size_ + input_index - stack->input_index_ - cp_len;\n"
@@ -2437,21 +3393,24 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "        best_match_col = input_col;\n"
                  "        best_match_line = input_line;\n"
                  "      }\n"
-                 "      scan_state = transition_table[row_size * scan_state + symgrp];\n"
-                 "      /* Reset decoder */\n"
+                 );
+  emit_scan_transition(ip, cc, "stack->match_buffer_size_ + input_index - stack->input_index_ - (size_t)cp_len", "symgrp");
+  ip_printf(ip,  "      /* Reset decoder */\n"
                  "      symgrp = 0;\n" 
-                 "      cp = stack->codepoint_;\n"
+                 "      cp = codepoint;\n"
                  "      /* We advanced input_index by a codepoint and so must process line and col to keep them in sync. */\n"
                  "      input_offset += (size_t)cp_len;\n"
-                 "      if (stack->codepoint_[0] != '\\n') {\n"
+                 "      if (codepoint[0] != '\\n') {\n"
                  "        input_col++;\n"
                  "      }\n"
                  "      else {\n"
                  "        input_col = 1;\n"
                  "        input_line++;\n"
                  "      }\n"
-                 "      if (!scan_state) {\n"
-                 "        /* Append from stack->input_index_ to input_index, excluding input_index itself */\n"
+                 "      if (!scan_state) {\n");
+  emit_lex_match_in_place(ip, cc);
+  if (scan_fused_applies(cc)) emit_lex_match_rescan(ip, cc);
+  ip_printf(ip,  "        /* Append from stack->input_index_ to input_index, excluding input_index itself */\n"
                  "        r = %sappend_match_buffer(stack, input + stack->input_index_, input_index - stack->input_index_);\n", cc_prefix(cc));
   ip_printf(ip,  "        if (r) return r;\n"
                  " \n"
@@ -2463,6 +3422,7 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "         * (likely) be longer than the last section we matched. */\n"
                  "        stack->terminator_repair_ = stack->match_buffer_[best_match_size];\n"
                  "        stack->match_buffer_[best_match_size] = '\\0';\n"
+                 "        stack->token_text_ = stack->match_buffer_;\n"
                  "        stack->token_size_ = best_match_size;\n"
                  "        stack->best_match_action_ = best_match_action;\n"
                  "        stack->best_match_size_ = best_match_size;\n"
@@ -2475,9 +3435,11 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "        stack->input_line_ = input_line;\n"
                  "        stack->input_col_ = input_col;\n"
                  "\n"
-                 "        stack->cp_ = cp;\n"
+                 "        memcpy(stack->codepoint_, codepoint, sizeof(codepoint));\n"
+                 "        stack->cp_ = stack->codepoint_ + (cp - codepoint);\n"
                  "        stack->sym_grp_ = symgrp;\n"
                  "\n");
+  emit_scan_memo_fail(ip, cc, "best_match_size + 1");
   ip_printf(ip,  "        return _%sMATCH;\n", cc_PREFIX(cc));
   ip_printf(ip,  "      }\n"
                  "    }\n"
@@ -2512,38 +3474,47 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "\n"
                  "    stack->match_index_ = match_index;\n"
                  "\n"
-                 "    stack->cp_ = cp;\n"
+                 "    memcpy(stack->codepoint_, codepoint, sizeof(codepoint));\n"
+                 "    stack->cp_ = stack->codepoint_ + (cp - codepoint);\n"
                  "    stack->sym_grp_ = symgrp;\n"
                  "\n");
   ip_printf(ip,  "    return _%sFEED_ME;\n", cc_PREFIX(cc));
-  ip_printf(ip,  "  }\n"
-                 "  for (;;) {\n"
-                 "    /* Check for start of input */\n"
-                 /* 256 + REX_ANCHOR_START_OF_INPUT */
-                 "    if ((((size_t)transition_table[row_size * (1 + scan_state) - 4]) != scan_state) && (!input_offset)) {\n"
-                 "      scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 4];\n"
-                 "    }\n"
-                 "    /* Check for start of line */\n"
-                 /* 256 + REX_ANCHOR_START_OF_LINE */
-                 "    else if ((((size_t)transition_table[row_size * (1 + scan_state) - 3]) != scan_state) && (input_col == 1)) {\n"
-                 "      scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 3];\n"
-                 "    }\n"
-                 "    /* Check for end of line (always true at end of input) */\n"
-                 /* 256 + REX_ANCHOR_END_OF_LINE */
-                 "    else if (((size_t)transition_table[row_size * (1 + scan_state) - 2]) != scan_state) {\n"
-                 "      scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 2];\n"
-                 "    }\n"
-                 "    /* Check for end of input (always true) */\n"
-                 /* 256 + REX_ANCHOR_END_OF_INPUT */
-                 "    else if (((size_t)transition_table[row_size * (1 + scan_state) - 1]) != scan_state) {\n"
-                 "      scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 1];\n"
-                 "    }\n"
-                 "    /* (No need to check for end of input; we have at least 1 character ahead) */\n"
-                 "    else {\n"
-                 "      break;\n"
-                 "    }\n"
-                 "  }\n"
-                 "  size_t state_action;\n"
+  ip_printf(ip,  "  }\n");
+  if (cc->lazy_dfa_max_states_) {
+    emit_scan_lazy_anchors(ip, cc, "!input_offset", "input_col == 1", NULL, 1);
+  }
+  else if (cc->compact_scan_) {
+    emit_scan_compact_anchors(ip, cc, "!input_offset", "input_col == 1", NULL, 1);
+  }
+  else {
+    ip_printf(ip, "  for (;;) {\n"
+                  "    /* Check for start of input */\n"
+                  /* 256 + REX_ANCHOR_START_OF_INPUT */
+                  "    if ((((size_t)transition_table[row_size * (1 + scan_state) - 4]) != scan_state) && (!input_offset)) {\n"
+                  "      scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 4];\n"
+                  "    }\n"
+                  "    /* Check for start of line */\n"
+                  /* 256 + REX_ANCHOR_START_OF_LINE */
+                  "    else if ((((size_t)transition_table[row_size * (1 + scan_state) - 3]) != scan_state) && (input_col == 1)) {\n"
+                  "      scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 3];\n"
+                  "    }\n"
+                  "    /* Check for end of line (always true at end of input) */\n"
+                  /* 256 + REX_ANCHOR_END_OF_LINE */
+                  "    else if (((size_t)transition_table[row_size * (1 + scan_state) - 2]) != scan_state) {\n"
+                  "      scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 2];\n"
+                  "    }\n"
+                  "    /* Check for end of input (always true) */\n"
+                  /* 256 + REX_ANCHOR_END_OF_INPUT */
+                  "    else if (((size_t)transition_table[row_size * (1 + scan_state) - 1]) != scan_state) {\n"
+                  "      scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 1];\n"
+                  "    }\n"
+                  "    /* (No need to check for end of input; we have at least 1 character ahead) */\n"
+                  "    else {\n"
+                  "      break;\n"
+                  "    }\n"
+                  "  }\n");
+  }
+  ip_printf(ip,  "  size_t state_action;\n"
                  "  state_action = actions[scan_state];\n"
                  "  if (state_action != default_action) /* replace with actual */ {\n"
                  "    best_match_action = state_action;\n"
@@ -2568,7 +3539,8 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "    stack->input_offset_ = input_offset;\n"
                  "    stack->input_line_ = input_line;\n"
                  "    stack->input_col_ = input_col;\n"
-                 "        stack->cp_ = cp;\n"
+                 "        memcpy(stack->codepoint_, codepoint, sizeof(codepoint));\n"
+                 "        stack->cp_ = stack->codepoint_ + (cp - codepoint);\n"
                  "        stack->sym_grp_ = symgrp;\n"
                  "\n");
   ip_printf(ip,  "    return _%sEND_OF_INPUT;\n", cc_PREFIX(cc));
@@ -2581,6 +3553,7 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "  /* Ensure token match is null terminated */\n"
                  "  stack->terminator_repair_ = stack->match_buffer_[best_match_size];\n"
                  "  stack->match_buffer_[best_match_size] = '\\0';\n"
+                 "  stack->token_text_ = stack->match_buffer_;\n"
                  "  stack->token_size_ = best_match_size;\n"
                  "  stack->best_match_action_ = best_match_action;\n"
                  "  stack->best_match_size_ = best_match_size;\n"
@@ -2592,9 +3565,11 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "  stack->input_offset_ = input_offset;\n"
                  "  stack->input_line_ = input_line;\n"
                  "  stack->input_col_ = input_col;\n"
-                 "  stack->cp_ = cp;\n"
+                 "  memcpy(stack->codepoint_, codepoint, sizeof(codepoint));\n"
+                 "  stack->cp_ = stack->codepoint_ + (cp - codepoint);\n"
                  "  stack->sym_grp_ = symgrp;\n"
                  "\n");
+  emit_scan_memo_fail(ip, cc, "best_match_size + 1");
   ip_printf(ip,  "  return _%sMATCH;\n", cc_PREFIX(cc));
   ip_printf(ip,  "syntax_error: {\n"
                  "  /* compute length of first codepoint in the match; this is not necessarily the\n"
@@ -2641,14 +3616,17 @@ static void emit_lex_function_x(struct indented_printer *ip, struct carburetta_c
                  "  stack->token_size_ = cp_len;\n"
                  "  stack->terminator_repair_ = stack->match_buffer_[cp_len];\n"
                  "  stack->match_buffer_[cp_len] = '\\0';\n"
+                 "  stack->token_text_ = stack->match_buffer_;\n"
                  "\n"
                  "  stack->input_index_ = input_index;\n"
                  "  stack->input_offset_ = input_offset;\n"
                  "  stack->input_line_ = input_line;\n"
                  "  stack->input_col_ = input_col;\n"
-                 "  stack->cp_ = cp;\n"
+                 "  memcpy(stack->codepoint_, codepoint, sizeof(codepoint));\n"
+                 "  stack->cp_ = stack->codepoint_ + (cp - codepoint);\n"
                  "  stack->sym_grp_ = symgrp;\n"
                  "\n");
+  emit_scan_memo_fail(ip, cc, "0");
   ip_printf(ip,  "  return _%sLEXICAL_ERROR;\n", cc_PREFIX(cc));
   ip_printf(ip,  "}\n"); /* syntax_error: */
   ip_printf(ip,  "}\n");
@@ -2676,6 +3654,19 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                 "  if (size_needed < 128) {\n"
                 "    size_needed = 128;\n"
                 "  }\n"
+                "  if (size_needed > (stack->match_buffer_size_allocated_ - stack->match_buffer_skip_)) {\n"
+                "    /* Out of room at the tail; if more than half the buffer is held by tokens already consumed,\n"
+                "     * reclaim that space by moving the remainder down, otherwise account for it and grow. */\n"
+                "    if (stack->match_buffer_skip_ > (stack->match_buffer_size_allocated_ / 2)) {\n"
+                "      memmove(stack->match_buffer_ - stack->match_buffer_skip_, stack->match_buffer_, stack->match_buffer_size_);\n"
+                "      stack->match_buffer_ -= stack->match_buffer_skip_;\n"
+                "      stack->match_buffer_skip_ = 0;\n"
+                "    }\n"
+                "    if (stack->match_buffer_skip_ > (SIZE_MAX - size_needed)) {\n");
+  ip_printf(ip, "      return _%sOVERFLOW;\n", cc_PREFIX(cc));
+  ip_printf(ip, "    }\n"
+                "    size_needed += stack->match_buffer_skip_;\n"
+                "  }\n"
                 "  if (size_needed > stack->match_buffer_size_allocated_) {\n"
                 "    /* intent of code: grow buffer size by powers of 2-1, unless our needs require more now. */\n"
                 "    size_t size_to_allocate = stack->match_buffer_size_allocated_ * 2 + 1;\n"
@@ -2685,11 +3676,11 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                 "    if (size_to_allocate < size_needed) {\n"
                 "      size_to_allocate = size_needed;\n"
                 "    }\n"
-                "    void *buf = realloc(stack->match_buffer_, size_to_allocate);\n"
+                "    void *buf = realloc(stack->match_buffer_skip_ ? stack->match_buffer_ - stack->match_buffer_skip_ : stack->match_buffer_, size_to_allocate);\n"
                 "    if (!buf) {\n");
   ip_printf(ip, "      return _%sNO_MEMORY;\n", cc_PREFIX(cc));
   ip_printf(ip, "    }\n"
-                "    stack->match_buffer_ = (char *)buf;\n"
+                "    stack->match_buffer_ = (char *)buf + stack->match_buffer_skip_;\n"
                 "    stack->match_buffer_size_allocated_ = size_to_allocate;\n"
                 "  }\n"
                 "\n"
@@ -2703,10 +3694,13 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
   ip_printf(ip, "  stack->input_ = input;\n"
                 "  stack->input_size_ = input_size;\n"
                 "  stack->is_final_input_ = is_final_input;\n"
+                "  stack->input_in_place_ = 0;\n"
                 "  stack->input_index_ = 0;\n");
   ip_printf(ip, "}\n"
                 "\n");
 
+  emit_set_input_in_place(ip, cc);
+
   ip_printf(ip,  "void %sset_location(struct %sstack *stack, int line, int col, size_t offset) {\n", cc_prefix(cc), cc_prefix(cc));
   ip_printf(ip,  "  if (stack->token_size_) {\n");
   ip_printf(ip,  "    /* Parsing of next token not in progress, set end location of this token as\n");
@@ -2732,11 +3726,15 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
   ip_printf(ip,  "  stack->match_line_ = line;\n");
   ip_printf(ip,  "  stack->match_col_ = col;\n");
   ip_printf(ip,  "  stack->match_offset_ = offset;\n");
+  if (cc->linear_scan_) {
+    /* Anchors depend on the location, so anything learned before may no longer hold */
+    ip_printf(ip, "  %sscan_memo_clear(stack);\n", cc_prefix(cc));
+  }
   ip_printf(ip, "}\n"
                 "\n");
 
   ip_printf(ip, "const char *%stext(struct %sstack *stack) {\n"
-                "  return stack->match_buffer_;\n"
+                "  return stack->token_text_;\n"
                 "}\n"
                 "\n", cc_prefix(cc), cc_prefix(cc));
 
@@ -2777,7 +3775,8 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
 
   ip_printf(ip, "void *%stoken_common_data(struct %sstack *stack) {\n", cc_prefix(cc), cc_prefix(cc));
   if (cc->common_data_assigned_type_) {
-    ip_printf(ip, "  return stack->slot_0_has_common_data_ ? &stack->stack_[0].common_ : NULL;\n");
+    ip_printf(ip, cc->segmented_stack_ ? "  return stack->slot_0_has_common_data_ ? &stack->stack_[0]->common_ : NULL;\n"
+                                       : "  return stack->slot_0_has_common_data_ ? &stack->stack_[0].common_ : NULL;\n");
   }
   else {
     ip_printf(ip, "  return NULL; /* no %%common_type or %%common_class so this is always NULL */\n");
@@ -2796,9 +3795,17 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
   ip_printf(ip,  "  const size_t *actions = %sscan_actions;\n", cc_prefix(cc));
   ip_printf(ip,  "  const size_t row_size = 256;\n");
 #else
-  ip_printf(ip,  "  const size_t *transition_table = %sscan_table_rex;\n", cc_prefix(cc));
-  ip_printf(ip,  "  const size_t *actions = %sscan_actions_rex;\n", cc_prefix(cc));
-  ip_printf(ip,  "  const size_t row_size = 260;\n");
+  if (cc->lazy_dfa_max_states_) {
+    emit_scan_lazy_locals(ip, cc);
+  }
+  else if (cc->compact_scan_) {
+    ip_printf(ip,  "  const size_t *actions = %sscan_actions_rex;\n", cc_prefix(cc));
+  }
+  else {
+    ip_printf(ip,  "  const size_t *transition_table = %sscan_table_rex;\n", cc_prefix(cc));
+    ip_printf(ip,  "  const size_t *actions = %sscan_actions_rex;\n", cc_prefix(cc));
+    ip_printf(ip,  "  const size_t row_size = 260;\n");
+  }
 #endif
   ip_printf(ip,  "  const size_t default_action = %zu;\n", 0);
   ip_printf(ip,  "  const size_t start_action = 0;\n", cc_prefix(cc));
@@ -2818,11 +3825,21 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "\n"
                  "  /* Move any prior token out of the way */\n"
                  "  if (stack->token_size_) {\n"
-                 "    stack->match_buffer_[stack->token_size_] = stack->terminator_repair_;\n"
+                 "    stack->token_text_[stack->token_size_] = stack->terminator_repair_;\n"
                  "\n"
-                 "    memcpy(stack->match_buffer_, stack->match_buffer_ + stack->token_size_, stack->match_buffer_size_ - stack->token_size_);\n"
-                 "    stack->match_buffer_size_ -= stack->token_size_;\n"
-                 "    stack->match_offset_ = stack->best_match_offset_;\n"
+                 "    if (stack->token_text_ == stack->match_buffer_) {\n"
+                 "      /* Step past it rather than moving the remainder down, %sappend_match_buffer() compacts lazily */\n"
+                 "      stack->match_buffer_ += stack->token_size_;\n"
+                 "      stack->match_buffer_skip_ += stack->token_size_;\n"
+                 "      stack->match_buffer_size_ -= stack->token_size_;\n"
+                 "    }\n"
+                 "    stack->token_text_ = stack->match_buffer_;\n",
+                 cc_prefix(cc)
+                 );
+  if (cc->linear_scan_) {
+    ip_printf(ip, "    %sscan_memo_advance(stack, stack->token_size_);\n", cc_prefix(cc));
+  }
+  ip_printf(ip,  "    stack->match_offset_ = stack->best_match_offset_;\n"
                  "    stack->match_line_ = stack->best_match_line_;\n"
                  "    stack->match_col_ = stack->best_match_col_;\n"
                  "    \n"
@@ -2839,29 +3856,37 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "  int at_match_index_line = stack->match_line_;\n"
                  "  int at_match_index_col = stack->match_col_;\n"
                  "  while (match_index < stack->match_buffer_size_) {\n"
-                 "    c = (unsigned char)stack->match_buffer_[match_index];\n"
-                 "    for (;;) {\n"
-                 "      /* Check for start of input */\n"
-                 /* 256 + REX_ANCHOR_START_OF_INPUT */
-                 "      if ((transition_table[row_size * scan_state + 256] != scan_state) && (!at_match_index_offset)) {\n"
-                 "        scan_state = transition_table[row_size * scan_state + 256];\n"
-                 "      }\n"
-                 "      /* Check for start of line */\n"
-                 /* 256 + REX_ANCHOR_START_OF_LINE */
-                 "      else if ((transition_table[row_size * scan_state + 257] != scan_state) && (at_match_index_col == 1)) {\n"
-                 "        scan_state = transition_table[row_size * scan_state + 257];\n"
-                 "      }\n"
-                 "      /* Check for end of line */\n"
-                 /* 256 + REX_ANCHOR_END_OF_LINE */
-                 "      else if ((transition_table[row_size * scan_state + 258] != scan_state) && ('\\n' == c)) {\n"
-                 "        scan_state = transition_table[row_size * scan_state + 258];\n"
-                 "      }\n"
-                 "      /* (No need to check for end of input; we have at least 1 character ahead) */\n"
-                 "      else {\n"
-                 "        break;\n"
-                 "      }\n"
-                 "    }\n"
-                 "    size_t state_action;\n"
+                 "    c = (unsigned char)stack->match_buffer_[match_index];\n");
+  if (cc->lazy_dfa_max_states_) {
+    emit_scan_lazy_anchors(ip, cc, "!at_match_index_offset", "at_match_index_col == 1", "'\\n' == c", 0);
+  }
+  else if (cc->compact_scan_) {
+    emit_scan_compact_anchors(ip, cc, "!at_match_index_offset", "at_match_index_col == 1", "'\\n' == c", 0);
+  }
+  else {
+    ip_printf(ip, "    for (;;) {\n"
+                  "      /* Check for start of input */\n"
+                  /* 256 + REX_ANCHOR_START_OF_INPUT */
+                  "      if ((transition_table[row_size * scan_state + 256] != scan_state) && (!at_match_index_offset)) {\n"
+                  "        scan_state = transition_table[row_size * scan_state + 256];\n"
+                  "      }\n"
+                  "      /* Check for start of line */\n"
+                  /* 256 + REX_ANCHOR_START_OF_LINE */
+                  "      else if ((transition_table[row_size * scan_state + 257] != scan_state) && (at_match_index_col == 1)) {\n"
+                  "        scan_state = transition_table[row_size * scan_state + 257];\n"
+                  "      }\n"
+                  "      /* Check for end of line */\n"
+                  /* 256 + REX_ANCHOR_END_OF_LINE */
+                  "      else if ((transition_table[row_size * scan_state + 258] != scan_state) && ('\\n' == c)) {\n"
+                  "        scan_state = transition_table[row_size * scan_state + 258];\n"
+                  "      }\n"
+                  "      /* (No need to check for end of input; we have at least 1 character ahead) */\n"
+                  "      else {\n"
+                  "        break;\n"
+                  "      }\n"
+                  "    }\n");
+  }
+  ip_printf(ip,  "    size_t state_action;\n"
                  "    state_action = actions[scan_state];\n"
                  "    if (state_action != default_action) /* replace with actual */ {\n"
                  "      best_match_action = state_action;\n"
@@ -2870,8 +3895,9 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "      best_match_line = at_match_index_line;\n"
                  "      best_match_col = at_match_index_col;\n"
                  "    }\n"
-                 "    scan_state = transition_table[row_size * scan_state + c];\n"
-                 "    if (scan_state) {\n"
+                 );
+  emit_scan_transition(ip, cc, "match_index", "c");
+  ip_printf(ip,  "    if (scan_state) {\n"
                  "      at_match_index_offset++;\n"
                  "      if (c != '\\n') {\n"
                  "        at_match_index_col++;\n"
@@ -2892,6 +3918,7 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "      /* Ensure token match is null terminated */\n"
                  "      stack->terminator_repair_ = stack->match_buffer_[best_match_size];\n"
                  "      stack->match_buffer_[best_match_size] = '\\0';\n"
+                 "      stack->token_text_ = stack->match_buffer_;\n"
                  "      stack->token_size_ = best_match_size;\n"
                  "      stack->best_match_action_ = best_match_action;\n"
                  "      stack->best_match_size_ = best_match_size;\n"
@@ -2904,34 +3931,43 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "      stack->input_line_ = input_line;\n"
                  "      stack->input_col_ = input_col;\n"
                  );
+  emit_scan_memo_fail(ip, cc, "best_match_size + 1");
   ip_printf(ip,  "      return _%sMATCH;\n", cc_PREFIX(cc));
   ip_printf(ip,  "    }\n"
                  "  }\n"
                  "\n"
                  "  while (input_index < input_size) {\n"
-                 "    c = (unsigned char)input[input_index];\n"
-                 "    for (;;) {\n"
-                 "      /* Check for start of input */\n"
-                 /* 256 + REX_ANCHOR_START_OF_INPUT */
-                 "      if ((transition_table[row_size * scan_state + 256] != scan_state) && (!input_offset)) {\n"
-                 "        scan_state = transition_table[row_size * scan_state + 256];\n"
-                 "      }\n"
-                 "      /* Check for start of line */\n"
-                 /* 256 + REX_ANCHOR_START_OF_LINE */
-                 "      else if ((transition_table[row_size * scan_state + 257] != scan_state) && (input_col == 1)) {\n"
-                 "        scan_state = transition_table[row_size * scan_state + 257];\n"
-                 "      }\n"
-                 "      /* Check for end of line */\n"
-                 /* 256 + REX_ANCHOR_END_OF_LINE */
-                 "      else if ((transition_table[row_size * scan_state + 258] != scan_state) && ('\\n' == c)) {\n"
-                 "        scan_state = transition_table[row_size * scan_state + 258];\n"
-                 "      }\n"
-                 "      /* (No need to check for end of input; we have at least 1 character ahead) */\n"
-                 "      else {\n"
-                 "        break;\n"
-                 "      }\n"
-                 "    }\n"
-                 "    size_t state_action;\n"
+                 "    c = (unsigned char)input[input_index];\n");
+  if (cc->lazy_dfa_max_states_) {
+    emit_scan_lazy_anchors(ip, cc, "!input_offset", "input_col == 1", "'\\n' == c", 0);
+  }
+  else if (cc->compact_scan_) {
+    emit_scan_compact_anchors(ip, cc, "!input_offset", "input_col == 1", "'\\n' == c", 0);
+  }
+  else {
+    ip_printf(ip, "    for (;;) {\n"
+                  "      /* Check for start of input */\n"
+                  /* 256 + REX_ANCHOR_START_OF_INPUT */
+                  "      if ((transition_table[row_size * scan_state + 256] != scan_state) && (!input_offset)) {\n"
+                  "        scan_state = transition_table[row_size * scan_state + 256];\n"
+                  "      }\n"
+                  "      /* Check for start of line */\n"
+                  /* 256 + REX_ANCHOR_START_OF_LINE */
+                  "      else if ((transition_table[row_size * scan_state + 257] != scan_state) && (input_col == 1)) {\n"
+                  "        scan_state = transition_table[row_size * scan_state + 257];\n"
+                  "      }\n"
+                  "      /* Check for end of line */\n"
+                  /* 256 + REX_ANCHOR_END_OF_LINE */
+                  "      else if ((transition_table[row_size * scan_state + 258] != scan_state) && ('\\n' == c)) {\n"
+                  "        scan_state = transition_table[row_size * scan_state + 258];\n"
+                  "      }\n"
+                  "      /* (No need to check for end of input; we have at least 1 character ahead) */\n"
+                  "      else {\n"
+                  "        break;\n"
+                  "      }\n"
+                  "    }\n");
+  }
+  ip_printf(ip,  "    size_t state_action;\n"
                  "    state_action = actions[scan_state];\n"
                  "    if (state_action != default_action) /* replace with actual */ {\n"
                  "      best_match_action = state_action;\n"
@@ -2940,8 +3976,9 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "      best_match_col = input_col;\n"
                  "      best_match_line = input_line;\n"
                  "    }\n"
-                 "    scan_state = transition_table[row_size * scan_state + c];\n"
-                 "    if (scan_state) {\n"
+                 );
+  emit_scan_transition(ip, cc, "stack->match_buffer_size_ + input_index - stack->input_index_", "c");
+  ip_printf(ip,  "    if (scan_state) {\n"
                  "      input_offset++;\n"
                  "      if (c != '\\n') {\n"
                  "        input_col++;\n"
@@ -2952,8 +3989,10 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "      }\n"
                  "      input_index++;\n"
                  "    }\n"
-                 "    else {\n"
-                 "      /* Append from stack->input_index_ to input_index, excluding input_index itself */\n"
+                 "    else {\n");
+  emit_lex_match_in_place(ip, cc);
+  if (scan_fused_applies(cc)) emit_lex_match_rescan(ip, cc);
+  ip_printf(ip,  "      /* Append from stack->input_index_ to input_index, excluding input_index itself */\n"
                  "      r = %sappend_match_buffer(stack, input + stack->input_index_, input_index - stack->input_index_);\n", cc_prefix(cc));
   ip_printf(ip,  "      if (r) return r;\n"
                  " \n"
@@ -2965,6 +4004,7 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "       * (likely) be longer than the last section we matched. */\n"
                  "      stack->terminator_repair_ = stack->match_buffer_[best_match_size];\n"
                  "      stack->match_buffer_[best_match_size] = '\\0';\n"
+                 "      stack->token_text_ = stack->match_buffer_;\n"
                  "      stack->token_size_ = best_match_size;\n"
                  "      stack->best_match_action_ = best_match_action;\n"
                  "      stack->best_match_size_ = best_match_size;\n"
@@ -2976,6 +4016,7 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "      stack->input_offset_ = input_offset;\n"
                  "      stack->input_line_ = input_line;\n"
                  "      stack->input_col_ = input_col;\n");
+  emit_scan_memo_fail(ip, cc, "best_match_size + 1");
   ip_printf(ip,  "      return _%sMATCH;\n", cc_PREFIX(cc));
   ip_printf(ip,  "    }\n"
                  "  }\n"
@@ -3004,34 +4045,42 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "    stack->match_index_ = match_index;\n"
                  "\n");
   ip_printf(ip,  "    return _%sFEED_ME;\n", cc_PREFIX(cc));
-  ip_printf(ip,  "  }\n"
-                 "  for (;;) {\n"
-                 "    /* Check for start of input */\n"
-                 /* 256 + REX_ANCHOR_START_OF_INPUT */
-                 "    if ((transition_table[row_size * scan_state + 256] != scan_state) && (!input_offset)) {\n"
-                 "      scan_state = transition_table[row_size * scan_state + 256];\n"
-                 "    }\n"
-                 "    /* Check for start of line */\n"
-                 /* 256 + REX_ANCHOR_START_OF_LINE */
-                 "    else if ((transition_table[row_size * scan_state + 257] != scan_state) && (input_col == 1)) {\n"
-                 "      scan_state = transition_table[row_size * scan_state + 257];\n"
-                 "    }\n"
-                 "    /* Check for end of line (always true at end of input) */\n"
-                 /* 256 + REX_ANCHOR_END_OF_LINE */
-                 "    else if (transition_table[row_size * scan_state + 258] != scan_state) {\n"
-                 "      scan_state = transition_table[row_size * scan_state + 258];\n"
-                 "    }\n"
-                 "    /* Check for end of input (always true) */\n"
-                 /* 256 + REX_ANCHOR_END_OF_INPUT */
-                 "    else if (transition_table[row_size * scan_state + 259] != scan_state) {\n"
-                 "      scan_state = transition_table[row_size * scan_state + 259];\n"
-                 "    }\n"
-                 "    /* (No need to check for end of input; we have at least 1 character ahead) */\n"
-                 "    else {\n"
-                 "      break;\n"
-                 "    }\n"
-                 "  }\n"
-                 "  size_t state_action;\n"
+  ip_printf(ip,  "  }\n");
+  if (cc->lazy_dfa_max_states_) {
+    emit_scan_lazy_anchors(ip, cc, "!input_offset", "input_col == 1", NULL, 1);
+  }
+  else if (cc->compact_scan_) {
+    emit_scan_compact_anchors(ip, cc, "!input_offset", "input_col == 1", NULL, 1);
+  }
+  else {
+    ip_printf(ip, "  for (;;) {\n"
+                  "    /* Check for start of input */\n"
+                  /* 256 + REX_ANCHOR_START_OF_INPUT */
+                  "    if ((transition_table[row_size * scan_state + 256] != scan_state) && (!input_offset)) {\n"
+                  "      scan_state = transition_table[row_size * scan_state + 256];\n"
+                  "    }\n"
+                  "    /* Check for start of line */\n"
+                  /* 256 + REX_ANCHOR_START_OF_LINE */
+                  "    else if ((transition_table[row_size * scan_state + 257] != scan_state) && (input_col == 1)) {\n"
+                  "      scan_state = transition_table[row_size * scan_state + 257];\n"
+                  "    }\n"
+                  "    /* Check for end of line (always true at end of input) */\n"
+                  /* 256 + REX_ANCHOR_END_OF_LINE */
+                  "    else if (transition_table[row_size * scan_state + 258] != scan_state) {\n"
+                  "      scan_state = transition_table[row_size * scan_state + 258];\n"
+                  "    }\n"
+                  "    /* Check for end of input (always true) */\n"
+                  /* 256 + REX_ANCHOR_END_OF_INPUT */
+                  "    else if (transition_table[row_size * scan_state + 259] != scan_state) {\n"
+                  "      scan_state = transition_table[row_size * scan_state + 259];\n"
+                  "    }\n"
+                  "    /* (No need to check for end of input; we have at least 1 character ahead) */\n"
+                  "    else {\n"
+                  "      break;\n"
+                  "    }\n"
+                  "  }\n");
+  }
+  ip_printf(ip,  "  size_t state_action;\n"
                  "  state_action = actions[scan_state];\n"
                  "  if (state_action != default_action) /* replace with actual */ {\n"
                  "    best_match_action = state_action;\n"
@@ -3066,6 +4115,7 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "  /* Ensure token match is null terminated */\n"
                  "  stack->terminator_repair_ = stack->match_buffer_[best_match_size];\n"
                  "  stack->match_buffer_[best_match_size] = '\\0';\n"
+                 "  stack->token_text_ = stack->match_buffer_;\n"
                  "  stack->token_size_ = best_match_size;\n"
                  "  stack->best_match_action_ = best_match_action;\n"
                  "  stack->best_match_size_ = best_match_size;\n"
@@ -3077,6 +4127,7 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "  stack->input_offset_ = input_offset;\n"
                  "  stack->input_line_ = input_line;\n"
                  "  stack->input_col_ = input_col;\n");
+  emit_scan_memo_fail(ip, cc, "best_match_size + 1");
   ip_printf(ip,  "  return _%sMATCH;\n", cc_PREFIX(cc));
   ip_printf(ip,  "syntax_error:\n"
                  "  if (stack->match_buffer_size_) {\n"
@@ -3113,12 +4164,14 @@ static void emit_lex_function(struct indented_printer *ip, struct carburetta_con
                  "  stack->token_size_ = 1;\n"
                  "  stack->terminator_repair_ = stack->match_buffer_[1];\n"
                  "  stack->match_buffer_[1] = '\\0';\n"
+                 "  stack->token_text_ = stack->match_buffer_;\n"
                  "\n"
                  "  stack->input_index_ = input_index;\n"
                  "  stack->input_offset_ = input_offset;\n"
                  "  stack->input_line_ = input_line;\n"
                  "  stack->input_col_ = input_col;\n"
                  "\n");
+  emit_scan_memo_fail(ip, cc, "0");
   ip_printf(ip,  "  return _%sLEXICAL_ERROR;\n", cc_PREFIX(cc));
   ip_printf(ip,  "}\n");
 }
@@ -3262,7 +4315,74 @@ static int check_have_sym_types(struct carburetta_context *cc) {
 }
 
 
-static void emit_push_state(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct lr_generator *lalr, int *state_syms, const char *action) {
+/* The symbol shifted to enter each state, and the states chained by the type of that symbol, so
+ * passes that emit a case for every state of a given type visit only the states of that type. */
+struct state_syms {
+  /* For each state, the symbol shifted to enter it, or NULL (e.g. for the initial state) */
+  struct symbol **syms_;
+
+  /* For each typestr ordinal, the first state whose symbol has that type, or SIZE_MAX if none */
+  size_t *first_state_of_type_;
+
+  /* For each state, the next state whose symbol has the same type, or SIZE_MAX for the last */
+  size_t *next_state_of_type_;
+};
+
+static void state_syms_init(struct state_syms *ss) {
+  ss->syms_ = NULL;
+  ss->first_state_of_type_ = NULL;
+  ss->next_state_of_type_ = NULL;
+}
+
+static void state_syms_cleanup(struct state_syms *ss) {
+  if (ss->syms_) free(ss->syms_);
+  if (ss->first_state_of_type_) free(ss->first_state_of_type_);
+  if (ss->next_state_of_type_) free(ss->next_state_of_type_);
+  state_syms_init(ss);
+}
+
+/* Fills in ss from the symbol ordinal of each state (-1 for none), states are chained in
+ * ascending order. Returns 0 upon success, non-zero upon memory failure. */
+static int state_syms_index(struct state_syms *ss, struct carburetta_context *cc, struct lr_generator *lalr, const int *state_sym_ordinals) {
+  size_t num_states = (size_t)lalr->nr_states_;
+  size_t num_types = cc->tstab_.num_typestrs_;
+  size_t n;
+  ss->syms_ = (struct symbol **)malloc(sizeof(struct symbol *) * (num_states ? num_states : 1));
+  ss->first_state_of_type_ = (size_t *)malloc(sizeof(size_t) * (num_types ? num_types : 1));
+  ss->next_state_of_type_ = (size_t *)malloc(sizeof(size_t) * (num_states ? num_states : 1));
+  if (!ss->syms_ || !ss->first_state_of_type_ || !ss->next_state_of_type_) {
+    state_syms_cleanup(ss);
+    return -1;
+  }
+  for (n = 0; n < num_types; ++n) {
+    ss->first_state_of_type_[n] = SIZE_MAX;
+  }
+  n = num_states;
+  while (n--) {
+    struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_sym_ordinals[n]);
+    ss->syms_[n] = sym;
+    ss->next_state_of_type_[n] = SIZE_MAX;
+    if (sym && sym->assigned_type_) {
+      size_t type_ordinal = (size_t)sym->assigned_type_->ordinal_;
+      ss->next_state_of_type_[n] = ss->first_state_of_type_[type_ordinal];
+      ss->first_state_of_type_[type_ordinal] = n;
+    }
+  }
+  return 0;
+}
+
+static void emit_push_state(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct lr_generator *lalr, struct state_syms *state_syms, const char *action) {
+  if (cc->segmented_stack_) {
+    /* Growth appends a segment, no entries are moved so there is nothing to construct, move or destruct */
+    ip_printf(ip, "  if (stack->num_stack_allocated_ == stack->pos_) {\n"
+                  "    int grow_result = %sgrow_segmented_stack(stack);\n", cc_prefix(cc));
+    ip_printf(ip, "    if (grow_result) return grow_result;\n"
+                  "  }\n");
+    ip_printf(ip, "  stack->stack_[stack->pos_++]->state_ = %s;\n", action);
+    ip_printf(ip, "  stack->top_of_stack_has_sym_data_ = 0;\n");
+    ip_printf(ip, "  stack->top_of_stack_has_common_data_ = 0;\n");
+    return;
+  }
   ip_printf(ip, "  if (stack->num_stack_allocated_ == stack->pos_) {\n"
                 "    stack->action_preservation_ = %s;\n", action);
   ip_printf(ip, "    size_t new_num_allocated;\n"
@@ -3292,8 +4412,8 @@ static void emit_push_state(struct indented_printer *ip, struct carburetta_conte
         ts->destructor_snippet_.num_tokens_ ||
         ts->move_snippet_.num_tokens_) {
       size_t state_idx;
-      for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-        struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+      for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+        struct symbol *sym = state_syms->syms_[state_idx];
         if (sym && sym->assigned_type_ == ts) {
           have_any_cases = 1;
           break;
@@ -3319,6 +4439,8 @@ static void emit_push_state(struct indented_printer *ip, struct carburetta_conte
     ip_printf(ip, "      /* Out of memory */\n"
                   "        return _%sNO_MEMORY;\n", cc_PREFIX(cc));
     ip_printf(ip, "    }\n");
+    ip_printf(ip, "    stack->stack_ = (struct %ssym_data *)p;\n", cc_prefix(cc));
+    ip_printf(ip, "    stack->new_buf_num_allocated_ = new_num_allocated;\n");
   }
   else {
     ip_printf(ip, "    stack->new_buf_ = (struct %ssym_data *)malloc(new_num_allocated * sizeof(struct %ssym_data));\n", cc_prefix(cc), cc_prefix(cc));
@@ -3495,8 +4617,8 @@ static void emit_push_state(struct indented_printer *ip, struct carburetta_conte
           int have_cases = 0; /* always true if all types are always used */
           /* Type has a constructor associated.. Find all state for whose corresponding symbol has the associated type */
           size_t state_idx;
-          for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-            struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+          for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+            struct symbol *sym = state_syms->syms_[state_idx];
             if (!sym) continue;
             if (sym->assigned_type_ == ts) {
               ip_printf(ip, "    case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -3558,8 +4680,8 @@ static void emit_push_state(struct indented_printer *ip, struct carburetta_conte
         else {
           /* Not yet handled the move, gather up all cases */
           size_t state_idx;
-          for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-            struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+          for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+            struct symbol *sym = state_syms->syms_[state_idx];
             if (!sym) continue;
             if (sym->assigned_type_ == ts) {
               ip_printf(ip, "    case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -3594,6 +4716,23 @@ static void emit_stack_static_slots_init(struct indented_printer *ip, struct car
   ip_printf(ip, "  /* reserve slots [0] and [1] for temporary storage of inflight syms and tokens.\n"
                 "   * note that initialization and lifetime of these slots is controlled by\n"
                 "   * flags, so no sym data constructors are called here. */\n");
+  if (cc->segmented_stack_) {
+    ip_printf(ip, "  if (stack->num_stack_allocated_ <= (stack->pos_ + 1)) {\n"
+                  "    int grow_result = %sgrow_segmented_stack(stack);\n", cc_prefix(cc));
+    ip_printf(ip, "    if (grow_result == _%sOVERFLOW) {\n", cc_PREFIX(cc));
+    ip_printf(ip, "      /* Overflow in allocation */\n");
+    emit_overflow_error(ip, cc);
+    ip_printf(ip, "    }\n"
+                  "    else if (grow_result) {\n"
+                  "      /* Out of memory */\n");
+    emit_alloc_error(ip, cc);
+    ip_printf(ip, "    }\n"
+                  "  }\n"
+                  "  stack->stack_[0]->state_ = 0;\n"
+                  "  stack->stack_[1]->state_ = 0;\n"
+                  "  stack->pos_ = 2;\n");
+    return;
+  }
   ip_printf(ip, "  if (stack->num_stack_allocated_ <= (stack->pos_ + 1)) {\n"
                 "    size_t new_num_allocated;\n"
                 "    if (stack->num_stack_allocated_) {\n"
@@ -3625,14 +4764,14 @@ static void emit_stack_static_slots_init(struct indented_printer *ip, struct car
                 "  stack->pos_ = 2;\n");
 }
 
-static int have_destructor_switch_by_state_cases(struct carburetta_context *cc, struct lr_generator *lalr, int *state_syms) {
+static int have_destructor_switch_by_state_cases(struct carburetta_context *cc, struct lr_generator *lalr, struct state_syms *state_syms) {
   size_t typestr_idx;
   for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
     struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
     if (ts->destructor_snippet_.num_tokens_) {
       size_t state_idx;
-      for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-        struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+      for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+        struct symbol *sym = state_syms->syms_[state_idx];
         if (!sym) continue;
         if (sym->assigned_type_ == ts) {
           return 1; /* have at least 1 case */
@@ -3644,14 +4783,14 @@ static int have_destructor_switch_by_state_cases(struct carburetta_context *cc,
   return 0;
 }
 
-static int have_visitation_switch_by_state_cases(struct carburetta_context *cc, struct lr_generator *lalr, int *state_syms) {
+static int have_visitation_switch_by_state_cases(struct carburetta_context *cc, struct lr_generator *lalr, struct state_syms *state_syms) {
   size_t typestr_idx;
   for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
     struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
     if (ts->visit_snippet_.num_tokens_) {
       size_t state_idx;
-      for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-        struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+      for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+        struct symbol *sym = state_syms->syms_[state_idx];
         if (!sym) continue;
         if (sym->assigned_type_ == ts) {
           return 1; /* have at least 1 case */
@@ -3663,8 +4802,359 @@ static int have_visitation_switch_by_state_cases(struct carburetta_context *cc,
   return 0;
 }
 
-static void emit_scan_function(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct lr_generator *lalr, int *state_syms) {
+static int scan_fused_pattern(struct prd_pattern *pat) {
+  /* Returns non-zero if the token of pat can be skipped or shifted without running any code */
+  if (pat->common_action_sequence_.num_tokens_ || pat->action_sequence_.num_tokens_) return 0;
+  return !pat->term_.sym_ || !typestr_has_code(pat->term_.sym_->assigned_type_);
+}
+
+static int scan_fused_production(struct prd_production *pd) {
+  /* Returns non-zero if pd can be reduced without running any code */
+  size_t n;
+  if (pd->common_action_sequence_.num_tokens_ || pd->action_sequence_.num_tokens_) return 0;
+  if (typestr_has_code(pd->nt_.sym_->assigned_type_)) return 0;
+  for (n = 0; n < pd->num_syms_; ++n) {
+    struct typestr *ts = pd->syms_[n].sym_->assigned_type_;
+    if (ts && ts->destructor_snippet_.num_tokens_) return 0;
+  }
+  return 1;
+}
+
+static void emit_scan_fused_advance(struct indented_printer *ip) {
+  /* Emits moving the position of <prefix>scan_fused() past the token it just acted on */
+  ip_printf(ip, "input_index += best_match_size;\n"
+                "input_offset = best_match_offset;\n"
+                "input_line = best_match_line;\n"
+                "input_col = best_match_col;\n");
+}
+
+static void emit_scan_fused_spill(struct indented_printer *ip, struct carburetta_context *cc) {
+  /* Emits writing back the parse state kept in locals by <prefix>scan_fused(), the flags are as the
+   * regular path leaves them after a shift or reduction. */
+  ip_printf(ip, "stack->pos_ = pos;\n"
+                "if (parsed) {\n"
+                "  stack->top_of_stack_has_sym_data_ = 0;\n");
+  ip_printf(ip, "  stack->top_of_stack_has_common_data_ = %d;\n", cc->common_data_assigned_type_ ? 1 : 0);
+  ip_printf(ip, "}\n"
+                "if (shifted) stack->slot_0_has_current_sym_data_ = 0;\n");
+  if (cc->common_data_assigned_type_) {
+    ip_printf(ip, "stack->slot_0_has_common_data_ = slot_0_has_common_data;\n");
+  }
+}
+
+static void emit_scan_fused_function(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg) {
+  /* Emits the fast path of <prefix>scan(), see scan_fused_applies() for when it is emitted */
+  const char *sel = cc->segmented_stack_ ? "->" : ".";
+  size_t pat_idx, row;
+  ip_printf(ip, "static int %sscan_fused(struct %sstack *stack) {\n", cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  /* Fast path of %sscan(); scans tokens straight from the input and, for as long as no action code\n"
+                "   * needs to run, skips or shifts them and reduces productions, keeping the position in the input\n"
+                "   * and the top of the parse stack in locals until it stops. Returns non-zero if it stopped at a\n"
+                "   * token that needs the regular path, the token is then left as %slex() leaves it on a match;\n"
+                "   * returns zero if %slex() is to scan the next token, such as one cut off by the end of the input. */\n",
+                cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "  const char *input = stack->input_;\n"
+                "  size_t input_size = stack->input_size_;\n");
+  if (cc->utf8_experimental_) {
+    ip_printf(ip, "  const int *transition_table = %sscan_table_grouped_rex_;\n", cc_prefix(cc));
+    ip_printf(ip, "  const size_t *actions = %sscan_actions_rex;\n", cc_prefix(cc));
+    ip_printf(ip, "  const size_t row_size = %snum_scan_table_grouped_columns_;\n", cc_prefix(cc));
+  }
+  else {
+    ip_printf(ip, "  const size_t *transition_table = %sscan_table_rex;\n", cc_prefix(cc));
+    ip_printf(ip, "  const size_t *actions = %sscan_actions_rex;\n", cc_prefix(cc));
+    ip_printf(ip, "  const size_t row_size = 260;\n");
+  }
+  ip_printf(ip, "  size_t start_state;\n"
+                "  size_t input_index, input_offset;\n"
+                "  int input_line, input_col;\n"
+                "  size_t best_match_action, best_match_size, best_match_offset;\n"
+                "  int best_match_line, best_match_col;\n");
+  ip_printf(ip, cc->segmented_stack_ ? "  struct %ssym_data **sym_data = stack->stack_;\n"
+                                     : "  struct %ssym_data *sym_data = stack->stack_;\n", cc_prefix(cc));
+  ip_printf(ip, "  size_t pos = stack->pos_;\n"
+                "  size_t num_allocated = stack->num_stack_allocated_;\n"
+                "  int state;\n"
+                "  int parsed = 0, shifted = 0;\n");
+  if (cc->common_data_assigned_type_) {
+    ip_printf(ip, "  int slot_0_has_common_data = stack->slot_0_has_common_data_;\n");
+  }
+  ip_printf(ip, "\n"
+                "  if (stack->error_recovery_ || stack->mute_error_turns_) return 0;\n"
+                "\n"
+                "  /* Move any prior token out of the way, as %slex() would */\n", cc_prefix(cc));
+  ip_printf(ip, "  if (stack->token_size_) {\n"
+                "    stack->token_text_[stack->token_size_] = stack->terminator_repair_;\n"
+                "    if (stack->token_text_ == stack->match_buffer_) {\n"
+                "      stack->match_buffer_ += stack->token_size_;\n"
+                "      stack->match_buffer_skip_ += stack->token_size_;\n"
+                "      stack->match_buffer_size_ -= stack->token_size_;\n"
+                "    }\n"
+                "    stack->token_text_ = stack->match_buffer_;\n"
+                "    stack->match_offset_ = stack->best_match_offset_;\n"
+                "    stack->match_line_ = stack->best_match_line_;\n"
+                "    stack->match_col_ = stack->best_match_col_;\n"
+                "    stack->match_index_ = 0;\n"
+                "    stack->best_match_action_ = 0;\n"
+                "    stack->best_match_size_ = 0;\n"
+                "    stack->scan_state_ = stack->current_mode_start_state_;\n"
+                "    stack->token_size_ = 0;\n"
+                "  }\n");
+  ip_printf(ip, "  if (stack->match_buffer_size_ || stack->best_match_action_ || (stack->scan_state_ != stack->current_mode_start_state_)%s) {\n"
+                "    /* Scanning of a token is in progress */\n"
+                "    return 0;\n"
+                "  }\n", cc->utf8_experimental_ ? " || (stack->cp_ != stack->codepoint_)" : "");
+  ip_printf(ip, "  start_state = stack->current_mode_start_state_;\n"
+                "  input_index = stack->input_index_;\n"
+                "  input_offset = stack->input_offset_;\n"
+                "  input_line = stack->input_line_;\n"
+                "  input_col = stack->input_col_;\n");
+  ip_printf(ip, "  state = sym_data[pos - 1]%sstate_;\n", sel);
+  ip_printf(ip, "\n"
+                "  for (;;) {\n"
+                "    size_t scan_state = start_state;\n"
+                "    size_t index = input_index;\n"
+                "    size_t offset = input_offset;\n"
+                "    int line = input_line;\n"
+                "    int col = input_col;\n"
+                "    int sym;\n"
+                "    best_match_action = 0;\n"
+                "    best_match_size = 0;\n"
+                "    best_match_offset = 0;\n"
+                "    best_match_line = best_match_col = 0;\n"
+                "    for (;;) {\n"
+                "      unsigned char c;\n");
+  ip_printf(ip, "      if (index == input_size) {\n"
+                "        /* Cannot tell where the token ends without more input, or the end of it */\n"
+                "        goto scan_in_lex;\n"
+                "      }\n"
+                "      c = (unsigned char)input[index];\n");
+  if (cc->utf8_experimental_) {
+    ip_printf(ip, "      size_t cp_len = 1;\n"
+                  "      int symgrp = %sutf8_decoder_[c];\n", cc_prefix(cc));
+    ip_printf(ip, "      while (symgrp < 0) {\n"
+                  "        /* Multi-byte codepoint, invalid encodings and codepoints cut off by the end of the input\n"
+                  "         * are left to %slex() */\n", cc_prefix(cc));
+    ip_printf(ip, "        if (!~symgrp || ((index + cp_len) == input_size)) goto scan_in_lex;\n"
+                  "        symgrp = %sutf8_decoder_[256 * ~symgrp + (unsigned char)input[index + cp_len]];\n", cc_prefix(cc));
+    ip_printf(ip, "        cp_len++;\n"
+                  "      }\n"
+                  "      for (;;) {\n"
+                  "        /* Check for start of input */\n"
+                  "        if ((((size_t)transition_table[row_size * (1 + scan_state) - 4]) != scan_state) && (!offset)) {\n"
+                  "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 4];\n"
+                  "        }\n"
+                  "        /* Check for start of line */\n"
+                  "        else if ((((size_t)transition_table[row_size * (1 + scan_state) - 3]) != scan_state) && (col == 1)) {\n"
+                  "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 3];\n"
+                  "        }\n"
+                  "        /* Check for end of line */\n"
+                  "        else if ((((size_t)transition_table[row_size * (1 + scan_state) - 2]) != scan_state) && ('\\n' == c)) {\n"
+                  "          scan_state = (size_t)transition_table[row_size * (1 + scan_state) - 2];\n"
+                  "        }\n"
+                  "        else {\n"
+                  "          break;\n"
+                  "        }\n"
+                  "      }\n");
+  }
+  else {
+    ip_printf(ip, "      for (;;) {\n"
+                  "        /* Check for start of input */\n"
+                  "        if ((transition_table[row_size * scan_state + 256] != scan_state) && (!offset)) {\n"
+                  "          scan_state = transition_table[row_size * scan_state + 256];\n"
+                  "        }\n"
+                  "        /* Check for start of line */\n"
+                  "        else if ((transition_table[row_size * scan_state + 257] != scan_state) && (col == 1)) {\n"
+                  "          scan_state = transition_table[row_size * scan_state + 257];\n"
+                  "        }\n"
+                  "        /* Check for end of line */\n"
+                  "        else if ((transition_table[row_size * scan_state + 258] != scan_state) && ('\\n' == c)) {\n"
+                  "          scan_state = transition_table[row_size * scan_state + 258];\n"
+                  "        }\n"
+                  "        else {\n"
+                  "          break;\n"
+                  "        }\n"
+                  "      }\n");
+  }
+  ip_printf(ip, "      if (actions[scan_state]) {\n"
+                "        best_match_action = actions[scan_state];\n"
+                "        best_match_size = index - input_index;\n"
+                "        best_match_offset = offset;\n"
+                "        best_match_line = line;\n"
+                "        best_match_col = col;\n"
+                "      }\n");
+  if (cc->utf8_experimental_) {
+    ip_printf(ip, "      scan_state = (size_t)transition_table[row_size * scan_state + symgrp];\n"
+                  "      if (!scan_state) break;\n"
+                  "      index += cp_len;\n"
+                  "      offset += cp_len;\n");
+  }
+  else {
+    ip_printf(ip, "      scan_state = transition_table[row_size * scan_state + c];\n"
+                  "      if (!scan_state) break;\n"
+                  "      index++;\n"
+                  "      offset++;\n");
+  }
+  ip_printf(ip, "      if (c != '\\n') {\n"
+                "        col++;\n"
+                "      }\n"
+                "      else {\n"
+                "        col = 1;\n"
+                "        line++;\n"
+                "      }\n"
+                "    }\n"
+                "    if (!best_match_action) {\n"
+                "      /* Lexical error */\n"
+                "      goto scan_in_lex;\n"
+                "    }\n"
+                "\n"
+                "    switch (best_match_action) {\n");
+  for (pat_idx = 0; pat_idx < prdg->num_patterns_; ++pat_idx) {
+    struct prd_pattern *pat = prdg->patterns_ + pat_idx;
+    if (!scan_fused_pattern(pat)) continue;
+    ip_printf(ip, "      case %zu: ", pat_idx + 1);
+    print_regex_as_comment(ip, pat->regex_);
+    ip_printf(ip, "\n");
+    if (pat->term_.sym_) {
+      ip_printf(ip, "        sym = ");
+      if (print_sym_as_c_ident(ip, cc, pat->term_.sym_)) {
+        ip->had_error_ = 1;
+        return;
+      }
+      ip_printf(ip, ";\n"
+                    "        break;\n");
+    }
+    else {
+      ip_printf(ip, "        /* Pattern does not have a symbol */\n");
+      if (cc->common_data_assigned_type_) {
+        ip_printf(ip, "        slot_0_has_common_data = 1;\n");
+      }
+      ip_printf(ip, "        ");
+      emit_scan_fused_advance(ip);
+      ip_printf(ip, "        continue;\n");
+    }
+  }
+  ip_printf(ip, "      default:\n"
+                "        /* Pattern has action code */\n"
+                "        goto match;\n"
+                "    }\n"
+                "\n"
+                "    for (;;) {\n");
+  ip_printf(ip, "      int action = %sparse_table[%snum_columns * state + (sym - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "      if (action > 0) {\n"
+                "        if (pos == num_allocated) {\n"
+                "          /* Growing the stack is left to the regular path */\n"
+                "          goto match;\n"
+                "        }\n");
+  ip_printf(ip, "        sym_data[pos]%sstate_ = action;\n", sel);
+  if (cc->common_data_assigned_type_) {
+    ip_printf(ip, "        memcpy(&sym_data[pos]%scommon_, &sym_data[0]%scommon_, sizeof(sym_data[0]%scommon_));\n", sel, sel, sel);
+    ip_printf(ip, "        slot_0_has_common_data = 0;\n");
+  }
+  if (cc->have_typed_symbols_) {
+    ip_printf(ip, "        memcpy(&sym_data[pos]%sv_, &sym_data[0]%sv_, sizeof(sym_data[0]%sv_));\n", sel, sel, sel);
+  }
+  ip_printf(ip, "        pos++;\n"
+                "        state = action;\n"
+                "        parsed = shifted = 1;\n"
+                "        break;\n"
+                "      }\n"
+                "      if (action < 0) {\n"
+                "        int production = -action - 1;\n"
+                "        size_t production_length;\n"
+                "        switch (production) {\n");
+  for (row = 0; row < prdg->num_productions_; ++row) {
+    struct prd_production *pd = prdg->productions_ + row;
+    size_t n;
+    if (!scan_fused_production(pd)) continue;
+    ip_printf(ip, "          case %d: /* %s:", (int)row + 1, pd->nt_.id_.translated_);
+    for (n = 0; n < pd->num_syms_; ++n) {
+      ip_printf(ip, " %s", pd->syms_[n].id_.translated_);
+    }
+    ip_printf(ip, " */\n");
+  }
+  ip_printf(ip, "            break;\n"
+                "          default:\n"
+                "            /* Production has action code, or is the start production */\n"
+                "            goto match;\n"
+                "        }\n");
+  ip_printf(ip, "        production_length = %sproduction_lengths[production];\n", cc_prefix(cc));
+  ip_printf(ip, "        if (!production_length && (pos == num_allocated)) {\n"
+                "          goto match;\n"
+                "        }\n");
+  ip_printf(ip, "        action = %sparse_table[%snum_columns * sym_data[pos - production_length - 1]%sstate_ + (%sproduction_syms[production] - %sminimum_sym)];\n",
+                cc_prefix(cc), cc_prefix(cc), sel, cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, "        if (action <= 0) {\n"
+                "          /* Internal error, reported by the regular path */\n"
+                "          goto match;\n"
+                "        }\n"
+                "        pos -= production_length;\n");
+  ip_printf(ip, "        sym_data[pos]%sstate_ = action;\n", sel);
+  if (cc->common_data_assigned_type_) {
+    ip_printf(ip, "        memset(&sym_data[pos]%scommon_, 0, sizeof(sym_data[0]%scommon_));\n", sel, sel);
+  }
+  if (cc->have_typed_symbols_) {
+    ip_printf(ip, "        memset(&sym_data[pos]%sv_, 0, sizeof(sym_data[0]%sv_));\n", sel, sel);
+  }
+  ip_printf(ip, "        pos++;\n"
+                "        state = action;\n"
+                "        parsed = 1;\n"
+                "        continue;\n"
+                "      }\n"
+                "      /* Syntax error, recovered from or reported by the regular path */\n"
+                "      goto match;\n"
+                "    }\n"
+                "    ");
+  emit_scan_fused_advance(ip);
+  ip_printf(ip, "  }\n"
+                "\n"
+                "match:\n"
+                "  /* Leave the token as %slex() would on a match */\n", cc_prefix(cc));
+  ip_printf(ip, "  if (stack->input_in_place_) {\n"
+                "    stack->token_text_ = (char *)input + input_index;\n"
+                "  }\n"
+                "  else {\n"
+                "    if (%sappend_match_buffer(stack, input + input_index, best_match_size)) goto scan_in_lex;\n", cc_prefix(cc));
+  ip_printf(ip, "    stack->token_text_ = stack->match_buffer_;\n"
+                "  }\n"
+                "  stack->terminator_repair_ = stack->token_text_[best_match_size];\n"
+                "  stack->token_text_[best_match_size] = '\\0';\n"
+                "  stack->token_size_ = best_match_size;\n"
+                "  stack->best_match_action_ = best_match_action;\n"
+                "  stack->best_match_size_ = best_match_size;\n"
+                "  stack->best_match_offset_ = best_match_offset;\n"
+                "  stack->best_match_line_ = best_match_line;\n"
+                "  stack->best_match_col_ = best_match_col;\n"
+                "  stack->match_offset_ = input_offset;\n"
+                "  stack->match_line_ = input_line;\n"
+                "  stack->match_col_ = input_col;\n"
+                "  stack->input_index_ = input_index + best_match_size;\n"
+                "  stack->input_offset_ = best_match_offset;\n"
+                "  stack->input_line_ = best_match_line;\n"
+                "  stack->input_col_ = best_match_col;\n");
+  ip_printf(ip, "  ");
+  emit_scan_fused_spill(ip, cc);
+  ip_printf(ip, "  return 1;\n"
+                "\n"
+                "scan_in_lex:\n"
+                "  stack->input_index_ = input_index;\n"
+                "  stack->input_offset_ = stack->match_offset_ = stack->best_match_offset_ = input_offset;\n"
+                "  stack->input_line_ = stack->match_line_ = stack->best_match_line_ = input_line;\n"
+                "  stack->input_col_ = stack->match_col_ = stack->best_match_col_ = input_col;\n"
+                "  ");
+  emit_scan_fused_spill(ip, cc);
+  ip_printf(ip, "  return 0;\n"
+                "}\n"
+                "\n");
+}
+
+static void emit_scan_function(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct lr_generator *lalr, struct state_syms *state_syms) {
   /* Emit the parse function */
+  int fused = scan_fused_applies(cc);
+  if (fused) {
+    emit_scan_fused_function(ip, cc, prdg);
+    if (ip->had_error_) return;
+  }
   cc->current_snippet_continuation_ = 1;
   if (cc->params_snippet_.num_tokens_) {
     ip_printf(ip, "int %sscan(struct %sstack *stack, ", cc_prefix(cc), cc_prefix(cc));
@@ -3695,7 +5185,12 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
   }
 
   ip_printf(ip, "    if (stack->need_sym_) {\n");
-  ip_printf(ip, "      switch (%slex(stack)) {\n", cc_prefix(cc));
+  if (fused) {
+    ip_printf(ip, "      switch (%sscan_fused(stack) ? _%sMATCH : %slex(stack)) {\n", cc_prefix(cc), cc_PREFIX(cc), cc_prefix(cc));
+  }
+  else {
+    ip_printf(ip, "      switch (%slex(stack)) {\n", cc_prefix(cc));
+  }
   ip_printf(ip, "        case _%sMATCH:\n", cc_PREFIX(cc));
   ip_printf(ip, "          stack->need_sym_ = 0;\n");
   ip_printf(ip, "          stack->discard_remaining_actions_ = 0;\n");
@@ -3841,8 +5336,10 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
   ip_printf(ip, "      int sym;\n"
                 "      sym = stack->current_sym_;\n"
                 "      if (!stack->error_recovery_) {\n"
-                "        int action;\n"
-                "        action = %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1].state_ + (sym - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
+                "        int action;\n");
+  emit_parse_profile_count(ip, cc, "sym");
+  ip_printf(ip, cc->segmented_stack_ ? "        action = %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1]->state_ + (sym - %sminimum_sym)];\n"
+                                     : "        action = %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1].state_ + (sym - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
   /* Shift logic */
   ip_printf(ip, "        if (action > 0) {\n");
   emit_push_state(ip, cc, prdg, lalr, state_syms, "action");
@@ -3858,7 +5355,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
     }
     else if (cc->common_data_assigned_type_->move_snippet_.num_tokens_) {
       /* clear to 0 if a move is defined. */
-      ip_printf(ip, "          memset(&stack->stack_[stack->pos_ - 1].common_, 0, sizeof(stack->stack_->common_));\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          memset(&stack->stack_[stack->pos_ - 1]->common_, 0, sizeof(stack->stack_[0]->common_));\n"
+                                         : "          memset(&stack->stack_[stack->pos_ - 1].common_, 0, sizeof(stack->stack_->common_));\n");
     }
     if (cc->common_data_assigned_type_->is_raii_constructor_) {
       ip_printf(ip, "          stack->top_of_stack_has_common_data_ = 1;\n");
@@ -3871,7 +5369,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
       }
     }
     else {
-      ip_printf(ip, "          memcpy(&stack->stack_[stack->pos_ - 1].common_, &stack->stack_[0].common_, sizeof(stack->stack_[0].common_)); /*1*/\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          memcpy(&stack->stack_[stack->pos_ - 1]->common_, &stack->stack_[0]->common_, sizeof(stack->stack_[0]->common_)); /*1*/\n"
+                                         : "          memcpy(&stack->stack_[stack->pos_ - 1].common_, &stack->stack_[0].common_, sizeof(stack->stack_[0].common_)); /*1*/\n");
     }
     ip_printf(ip, "          stack->slot_0_has_common_data_ = 0;\n");
   }
@@ -3884,8 +5383,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
           ts->destructor_snippet_.num_tokens_  ||
           ts->move_snippet_.num_tokens_) {
         size_t state_idx;
-        for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-          struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+        for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+          struct symbol *sym = state_syms->syms_[state_idx];
           if (sym && sym->assigned_type_ == ts) {
             have_any_cases = 1;
             break;
@@ -3896,17 +5395,19 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
     }
 
     if (!have_any_cases) {
-      ip_printf(ip, "          memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[0].v_, sizeof(stack->stack_[0].v_));\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          memcpy(&stack->stack_[stack->pos_ - 1]->v_, &stack->stack_[0]->v_, sizeof(stack->stack_[0]->v_));\n"
+                                         : "          memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[0].v_, sizeof(stack->stack_[0].v_));\n");
     }
     else {
-      ip_printf(ip, "          switch(stack->stack_[stack->pos_ - 1].state_) {\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          switch(stack->stack_[stack->pos_ - 1]->state_) {\n"
+                                         : "          switch(stack->stack_[stack->pos_ - 1].state_) {\n");
       for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
         struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
         int have_cases = 0; /* always true if all types are always used */
         /* Type has a constructor associated.. Find all state for whose corresponding symbol has the associated type */
         size_t state_idx;
-        for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-          struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+        for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+          struct symbol *sym = state_syms->syms_[state_idx];
           if (!sym) continue;
           if (sym->assigned_type_ == ts) {
             ip_printf(ip, "    case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -3928,7 +5429,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
             }
             else if (ts->move_snippet_.num_tokens_) {
               /* clear to 0 if a move is defined but no constructor. */
-              ip_printf(ip, "      memset(&stack->stack_[stack->pos_ - 1].v_, 0, sizeof(stack->stack_->v_));\n");
+              ip_printf(ip, cc->segmented_stack_ ? "      memset(&stack->stack_[stack->pos_ - 1]->v_, 0, sizeof(stack->stack_[0]->v_));\n"
+                                                 : "      memset(&stack->stack_[stack->pos_ - 1].v_, 0, sizeof(stack->stack_->v_));\n");
             }
             if (ts->is_raii_constructor_) {
               ip_printf(ip, "      stack->top_of_stack_has_sym_data_ = 1;\n");
@@ -3946,12 +5448,14 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
               }
             }
             else {
-              ip_printf(ip, "    memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[0].v_, sizeof(stack->stack_->v_)); /*2*/\n");
+              ip_printf(ip, cc->segmented_stack_ ? "    memcpy(&stack->stack_[stack->pos_ - 1]->v_, &stack->stack_[0]->v_, sizeof(stack->stack_[0]->v_)); /*2*/\n"
+                                                 : "    memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[0].v_, sizeof(stack->stack_->v_)); /*2*/\n");
             }
           }
           else {
             /* No %constructor, %destructor or %move defined. Just copy the value. */
-            ip_printf(ip, "          memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[0].v_, sizeof(stack->stack_->v_)); /*3*/\n");
+            ip_printf(ip, cc->segmented_stack_ ? "          memcpy(&stack->stack_[stack->pos_ - 1]->v_, &stack->stack_[0]->v_, sizeof(stack->stack_[0]->v_)); /*3*/\n"
+                                               : "          memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[0].v_, sizeof(stack->stack_->v_)); /*3*/\n");
           }
           ip_printf(ip, "break;\n");
         }
@@ -3983,8 +5487,9 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
   }
 
   ip_printf(ip, "          }\n"
-                "\n"
-                "          memset(&stack->stack_[1], 0, sizeof(struct %ssym_data));\n", cc_prefix(cc));
+                "\n");
+  ip_printf(ip, cc->segmented_stack_ ? "          memset(stack->stack_[1], 0, sizeof(struct %ssym_data));\n"
+                                     : "          memset(&stack->stack_[1], 0, sizeof(struct %ssym_data));\n", cc_prefix(cc));
 
   ip_printf(ip, "          { /* scope guard */\n"
                 "            stack->sym_data_ = stack->stack_ + stack->pos_ - stack->current_production_length_;\n", cc_prefix(cc));
@@ -4002,23 +5507,40 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
     ip_printf(ip, "          /* Note: no productions to process */\n");
   }
   else {
-    ip_printf(ip, "            switch (production) {\n");
+    size_t *reduce_groups;
+    if (group_reduce_cases(prdg, &reduce_groups)) {
+      re_error_nowhere("Error, no memory");
+      ip->had_error_ = 1;
+      goto cleanup_exit;
+    }
+    emit_reduce_dispatch(ip, cc, prdg, "            ");
     size_t row;
     for (row = 0; row < prdg->num_productions_; ++row) {
       struct prd_production *pd = prdg->productions_ + row;
-      ip_printf(ip, "            /* %s:", pd->nt_.id_.translated_);
-      size_t n;
-      for (n = 0; n < pd->num_syms_; ++n) {
-        ip_printf(ip, " %s", pd->syms_[n].id_.translated_);
+      size_t member;
+      int mixes_nonterminals = 0;
+      if (reduce_groups[row] != row) {
+        /* Emitted with the first production of its group */
+        continue;
+      }
+      for (member = row; member != SIZE_MAX; member = reduce_groups[prdg->num_productions_ + member]) {
+        struct prd_production *mpd = prdg->productions_ + member;
+        ip_printf(ip, "            /* %s:", mpd->nt_.id_.translated_);
+        size_t n;
+        for (n = 0; n < mpd->num_syms_; ++n) {
+          ip_printf(ip, " %s", mpd->syms_[n].id_.translated_);
+        }
+        ip_printf(ip, " */\n");
+        emit_reduce_case(ip, cc, member, reduce_groups[prdg->num_productions_ + member] == SIZE_MAX, "            ");
+        if (mpd->nt_.sym_ != pd->nt_.sym_) mixes_nonterminals = 1;
       }
-      ip_printf(ip, " */\n");
-      ip_printf(ip, "              case %d: {\n", (int)row + 1);
       if (cc->common_data_assigned_type_) {
         if (!cc->common_data_assigned_type_->is_raii_constructor_) {
           ip_printf(ip, "                stack->slot_1_has_common_data_ = 1;\n");
         }
         /* Emit dst_sym_data constructor first */
         if (emit_dst_common_constructor_snippet(ip, cc, cc->common_data_assigned_type_->is_raii_constructor_)) {
+          free(reduce_groups);
           ip->had_error_ = 1;
           goto cleanup_exit;
         }
@@ -4031,10 +5553,16 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
         if (!pd->nt_.sym_->assigned_type_->is_raii_constructor_) {
           ip_printf(ip, "                stack->slot_1_has_sym_data_ = 1;\n");
         }
-        ip_printf(ip, "                stack->slot_1_sym_ = ");
-        print_sym_as_c_ident(ip, cc, pd->nt_.sym_);
-        ip_printf(ip, ";\n");
+        if (mixes_nonterminals) {
+          ip_printf(ip, "                stack->slot_1_sym_ = stack->current_production_nonterminal_;\n");
+        }
+        else {
+          ip_printf(ip, "                stack->slot_1_sym_ = ");
+          print_sym_as_c_ident(ip, cc, pd->nt_.sym_);
+          ip_printf(ip, ";\n");
+        }
         if (emit_dst_sym_constructor_snippet(ip, cc, pd->nt_.sym_->assigned_type_, pd->nt_.sym_->assigned_type_->is_raii_constructor_)) {
+          free(reduce_groups);
           ip->had_error_ = 1;
           goto cleanup_exit;
         }
@@ -4044,6 +5572,7 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
       }
       if (pd->common_action_sequence_.num_tokens_) {
         if (emit_common_action_snippet(ip, cc, pd)) {
+          free(reduce_groups);
           ip->had_error_ = 1;
           goto cleanup_exit;
         }
@@ -4053,6 +5582,7 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
         ip_printf(ip, "              if (!stack->discard_remaining_actions_) {\n");
       }
       if (emit_action_snippet(ip, cc, pd)) {
+        free(reduce_groups);
         ip->had_error_ = 1;
         goto cleanup_exit;
       }
@@ -4064,7 +5594,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
       ip_printf(ip, "              }\n"
                     "              break;\n");
     }
-    ip_printf(ip, "            } /* switch */\n");
+    free(reduce_groups);
+    emit_reduce_dispatch_end(ip, cc, "            ");
   }
   ip_printf(ip, "          } /* scope guard */\n");
   ip_printf(ip, "\n");
@@ -4075,7 +5606,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
                   "         * push nonterminal_data_reduced_to */\n");
     ip_printf(ip, "        for (stack->sym_idx_ = stack->pos_ - stack->current_production_length_; stack->sym_idx_ < stack->pos_; ++stack->sym_idx_) {\n");
     if (have_specific_destructors) {
-      ip_printf(ip, "          switch (stack->stack_[stack->sym_idx_].state_) {\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          switch (stack->stack_[stack->sym_idx_]->state_) {\n"
+                                         : "          switch (stack->stack_[stack->sym_idx_].state_) {\n");
       size_t typestr_idx;
       for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
         struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
@@ -4083,8 +5615,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
           int have_cases = 0; /* always true if all types are always used */
           /* Type has a destructor associated.. Find all state for whose corresponding symbol has the associated type */
           size_t state_idx;
-          for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-            struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+          for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+            struct symbol *sym = state_syms->syms_[state_idx];
             if (!sym) continue;
             if (sym->assigned_type_ == ts) {
               ip_printf(ip, "            case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -4117,8 +5649,10 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
     ip_printf(ip, "        } /* for */\n");
   }
   ip_printf(ip, "          stack->pos_ -= stack->current_production_length_;\n"
-                "          stack->top_of_stack_has_sym_data_ = stack->top_of_stack_has_common_data_ = 1;\n"
-                "          action = %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1].state_ + (stack->current_production_nonterminal_ - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
+                "          stack->top_of_stack_has_sym_data_ = stack->top_of_stack_has_common_data_ = 1;\n");
+  emit_parse_profile_count(ip, cc, "stack->current_production_nonterminal_");
+  ip_printf(ip, cc->segmented_stack_ ? "          action = %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1]->state_ + (stack->current_production_nonterminal_ - %sminimum_sym)];\n"
+                                     : "          action = %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1].state_ + (stack->current_production_nonterminal_ - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
   ip_printf(ip, "          if (action <= 0) {\n");
   emit_internal_error(ip, cc);
   ip_printf(ip, "          }\n");
@@ -4134,7 +5668,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
     }
     else if (cc->common_data_assigned_type_->move_snippet_.num_tokens_) {
       /* clear to 0 if a move is defined. */
-      ip_printf(ip, "          memset(&stack->stack_[stack->pos_ - 1].common_, 0, sizeof(stack->stack_->common_));\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          memset(&stack->stack_[stack->pos_ - 1]->common_, 0, sizeof(stack->stack_[0]->common_));\n"
+                                         : "          memset(&stack->stack_[stack->pos_ - 1].common_, 0, sizeof(stack->stack_->common_));\n");
     }
     if (cc->common_data_assigned_type_->is_raii_constructor_) {
       ip_printf(ip, "          stack->top_of_stack_has_common_data_ = 1;\n");
@@ -4147,7 +5682,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
       }
     }
     else {
-      ip_printf(ip, "          memcpy(&stack->stack_[stack->pos_ - 1].common_, &stack->stack_[1].common_, sizeof(stack->stack_->common_));\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          memcpy(&stack->stack_[stack->pos_ - 1]->common_, &stack->stack_[1]->common_, sizeof(stack->stack_[0]->common_));\n"
+                                         : "          memcpy(&stack->stack_[stack->pos_ - 1].common_, &stack->stack_[1].common_, sizeof(stack->stack_->common_));\n");
     }
     ip_printf(ip, "          stack->slot_1_has_common_data_ = 0;\n");
   }
@@ -4160,8 +5696,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
           ts->destructor_snippet_.num_tokens_ ||
           ts->move_snippet_.num_tokens_) {
         size_t state_idx;
-        for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-          struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+        for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+          struct symbol *sym = state_syms->syms_[state_idx];
           if (sym && sym->assigned_type_ == ts) {
             have_any_cases = 1;
             break;
@@ -4172,17 +5708,19 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
     }
 
     if (!have_any_cases) {
-      ip_printf(ip, "          memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[1].v_, sizeof(stack->stack_->v_));\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          memcpy(&stack->stack_[stack->pos_ - 1]->v_, &stack->stack_[1]->v_, sizeof(stack->stack_[0]->v_));\n"
+                                         : "          memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[1].v_, sizeof(stack->stack_->v_));\n");
     }
     else {
-      ip_printf(ip, "          switch(stack->stack_[stack->pos_ - 1].state_) {\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          switch(stack->stack_[stack->pos_ - 1]->state_) {\n"
+                                         : "          switch(stack->stack_[stack->pos_ - 1].state_) {\n");
       for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
         struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
         int have_cases = 0; /* always true if all types are always used */
         /* Type has a constructor associated.. Find all state for whose corresponding symbol has the associated type */
         size_t state_idx;
-        for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-          struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+        for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+          struct symbol *sym = state_syms->syms_[state_idx];
           if (!sym) continue;
           if (sym->assigned_type_ == ts) {
             ip_printf(ip, "    case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -4204,7 +5742,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
             }
             else if (ts->move_snippet_.num_tokens_) {
               /* clear to 0 if a move is defined but no constructor. */
-              ip_printf(ip, "      memset(&stack->stack_[stack->pos_ - 1].v_, 0, sizeof(stack->stack_->v_));\n");
+              ip_printf(ip, cc->segmented_stack_ ? "      memset(&stack->stack_[stack->pos_ - 1]->v_, 0, sizeof(stack->stack_[0]->v_));\n"
+                                                 : "      memset(&stack->stack_[stack->pos_ - 1].v_, 0, sizeof(stack->stack_->v_));\n");
             }
             if (ts->is_raii_constructor_) {
               ip_printf(ip, "      stack->top_of_stack_has_sym_data_ = 1;\n");
@@ -4222,12 +5761,14 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
               }
             }
             else {
-              ip_printf(ip, "    memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[1].v_, sizeof(stack->stack_->v_));\n");
+              ip_printf(ip, cc->segmented_stack_ ? "    memcpy(&stack->stack_[stack->pos_ - 1]->v_, &stack->stack_[1]->v_, sizeof(stack->stack_[0]->v_));\n"
+                                                 : "    memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[1].v_, sizeof(stack->stack_->v_));\n");
             }
           }
           else {
             /* No %constructor, %destructor or %move defined. Just copy the value. */
-            ip_printf(ip, "          memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[1].v_, sizeof(stack->stack_->v_));\n");
+            ip_printf(ip, cc->segmented_stack_ ? "          memcpy(&stack->stack_[stack->pos_ - 1]->v_, &stack->stack_[1]->v_, sizeof(stack->stack_[0]->v_));\n"
+                                               : "          memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[1].v_, sizeof(stack->stack_->v_));\n");
           }
           ip_printf(ip, "break;\n");
         }
@@ -4243,7 +5784,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
   ip_printf(ip, "          /* check if we can recover using an error token. */\n"
                 "          size_t n;\n"
                 "          for (n = 0; n < stack->pos_; ++n) {\n");
-  ip_printf(ip, "            stack->current_err_action_ = %sparse_table[%snum_columns * stack->stack_[n].state_ + (%d /* error token */ - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc->error_sym_->ordinal_, cc_prefix(cc));
+  ip_printf(ip, cc->segmented_stack_ ? "            stack->current_err_action_ = %sparse_table[%snum_columns * stack->stack_[n]->state_ + (%d /* error token */ - %sminimum_sym)];\n"
+                                     : "            stack->current_err_action_ = %sparse_table[%snum_columns * stack->stack_[n].state_ + (%d /* error token */ - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc->error_sym_->ordinal_, cc_prefix(cc));
   ip_printf(ip, "            if (stack->current_err_action_ > 0) {\n"
                 "              /* we can transition on the error token somewhere on the stack */\n"
                 "              break;\n"
@@ -4365,7 +5907,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
                 "          do {\n"
                 "            --n;\n"
                 "            /* Can we shift an error token? */\n");
-  ip_printf(ip, "            stack->current_err_action_ = %sparse_table[%snum_columns * stack->stack_[n].state_ + (%d /* error token */ - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc->error_sym_->ordinal_, cc_prefix(cc));
+  ip_printf(ip, cc->segmented_stack_ ? "            stack->current_err_action_ = %sparse_table[%snum_columns * stack->stack_[n]->state_ + (%d /* error token */ - %sminimum_sym)];\n"
+                                     : "            stack->current_err_action_ = %sparse_table[%snum_columns * stack->stack_[n].state_ + (%d /* error token */ - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc->error_sym_->ordinal_, cc_prefix(cc));
   ip_printf(ip, "            if (stack->current_err_action_ > 0) {\n");
   ip_printf(ip, "              /* Does the resulting state accept the current symbol? */\n"
                 "              int err_sym_action;\n");
@@ -4378,7 +5921,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
     ip_printf(ip, "                /* Free symdata for every symbol up to the state where we will shift the error token */\n");
     ip_printf(ip, "                for (stack->sym_idx_ = n + 1; stack->sym_idx_ < stack->pos_; ++stack->sym_idx_) {\n");
     if (have_specific_destructors) {
-      ip_printf(ip, "                  switch (stack->stack_[stack->sym_idx_].state_) {\n");
+      ip_printf(ip, cc->segmented_stack_ ? "                  switch (stack->stack_[stack->sym_idx_]->state_) {\n"
+                                         : "                  switch (stack->stack_[stack->sym_idx_].state_) {\n");
       size_t typestr_idx;
       for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
         struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
@@ -4386,8 +5930,8 @@ static void emit_scan_function(struct indented_printer *ip, struct carburetta_co
           int have_cases = 0; /* always true if all types are always used */
           /* Type has a destructor associated.. Find all state for whose corresponding symbol has the associated type */
           size_t state_idx;
-          for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-            struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+          for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+            struct symbol *sym = state_syms->syms_[state_idx];
             if (!sym) continue;
             if (sym->assigned_type_ == ts) {
               ip_printf(ip, "                    case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -4513,7 +6057,7 @@ cleanup_exit:
 }
 
 
-static void emit_parse_function(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct lr_generator *lalr, int *state_syms) {
+static void emit_parse_function(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct lr_generator *lalr, struct state_syms *state_syms) {
   /* Emit the parse function */
   cc->current_snippet_continuation_ = 1;
   if (cc->params_snippet_.num_tokens_) {
@@ -4538,8 +6082,10 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
   ip_printf(ip, "  if (stack->mute_error_turns_) stack->mute_error_turns_--;\n");
   ip_printf(ip, "  for (;;) {\n"
                 "    if (!stack->error_recovery_) {\n"
-                "      int action;\n"
-                "      action = %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1].state_ + (sym - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
+                "      int action;\n");
+  emit_parse_profile_count(ip, cc, "sym");
+  ip_printf(ip, cc->segmented_stack_ ? "      action = %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1]->state_ + (sym - %sminimum_sym)];\n"
+                                     : "      action = %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1].state_ + (sym - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
 
   /* Shift logic */
   ip_printf(ip, "      if (action > 0) {\n");
@@ -4652,8 +6198,9 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
   }
 
   ip_printf(ip, "        }\n"
-                "\n"
-                "          memset(&stack->stack_[1], 0, sizeof(struct %ssym_data));\n", cc_prefix(cc));
+                "\n");
+  ip_printf(ip, cc->segmented_stack_ ? "          memset(stack->stack_[1], 0, sizeof(struct %ssym_data));\n"
+                                     : "          memset(&stack->stack_[1], 0, sizeof(struct %ssym_data));\n", cc_prefix(cc));
 
   ip_printf(ip, "        { /* scope guard */\n"
                 "          stack->sym_data_ = stack->stack_ + stack->pos_ - stack->current_production_length_;\n", cc_prefix(cc));
@@ -4671,23 +6218,40 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
     ip_printf(ip, "          /* Note: no productions to process */\n");
   }
   else {
-    ip_printf(ip, "          switch (production) {\n");
+    size_t *reduce_groups;
+    if (group_reduce_cases(prdg, &reduce_groups)) {
+      re_error_nowhere("Error, no memory");
+      ip->had_error_ = 1;
+      goto cleanup_exit;
+    }
+    emit_reduce_dispatch(ip, cc, prdg, "          ");
     size_t row;
     for (row = 0; row < prdg->num_productions_; ++row) {
       struct prd_production *pd = prdg->productions_ + row;
-      ip_printf(ip, "            /* %s:", pd->nt_.id_.translated_);
-      size_t n;
-      for (n = 0; n < pd->num_syms_; ++n) {
-        ip_printf(ip, " %s", pd->syms_[n].id_.translated_);
+      size_t member;
+      int mixes_nonterminals = 0;
+      if (reduce_groups[row] != row) {
+        /* Emitted with the first production of its group */
+        continue;
+      }
+      for (member = row; member != SIZE_MAX; member = reduce_groups[prdg->num_productions_ + member]) {
+        struct prd_production *mpd = prdg->productions_ + member;
+        ip_printf(ip, "            /* %s:", mpd->nt_.id_.translated_);
+        size_t n;
+        for (n = 0; n < mpd->num_syms_; ++n) {
+          ip_printf(ip, " %s", mpd->syms_[n].id_.translated_);
+        }
+        ip_printf(ip, " */\n");
+        emit_reduce_case(ip, cc, member, reduce_groups[prdg->num_productions_ + member] == SIZE_MAX, "          ");
+        if (mpd->nt_.sym_ != pd->nt_.sym_) mixes_nonterminals = 1;
       }
-      ip_printf(ip, " */\n");
-      ip_printf(ip, "            case %d: {\n", (int)row + 1);
       if (cc->common_data_assigned_type_) {
         if (!cc->common_data_assigned_type_->is_raii_constructor_) {
           ip_printf(ip, "              stack->slot_1_has_common_data_ = 1;\n");
         }
         /* Emit dst_sym_data constructor first */
         if (emit_dst_common_constructor_snippet(ip, cc, cc->common_data_assigned_type_->is_raii_constructor_)) {
+          free(reduce_groups);
           ip->had_error_ = 1;
           goto cleanup_exit;
         }
@@ -4700,11 +6264,17 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
         if (!pd->nt_.sym_->assigned_type_->is_raii_constructor_) {
           ip_printf(ip, "              stack->slot_1_has_sym_data_ = 1;\n");
         }
-        ip_printf(ip, "              stack->slot_1_sym_ = ");
-        print_sym_as_c_ident(ip, cc, pd->nt_.sym_);
-        ip_printf(ip, ";\n");
+        if (mixes_nonterminals) {
+          ip_printf(ip, "              stack->slot_1_sym_ = stack->current_production_nonterminal_;\n");
+        }
+        else {
+          ip_printf(ip, "              stack->slot_1_sym_ = ");
+          print_sym_as_c_ident(ip, cc, pd->nt_.sym_);
+          ip_printf(ip, ";\n");
+        }
 
         if (emit_dst_sym_constructor_snippet(ip, cc, pd->nt_.sym_->assigned_type_, pd->nt_.sym_->assigned_type_->is_raii_constructor_)) {
+          free(reduce_groups);
           ip->had_error_ = 1;
           goto cleanup_exit;
         }
@@ -4715,6 +6285,7 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
       }
 
       if (emit_common_action_snippet(ip, cc, pd)) {
+        free(reduce_groups);
         ip->had_error_ = 1;
         goto cleanup_exit;
       }
@@ -4725,6 +6296,7 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
       }
 
       if (emit_action_snippet(ip, cc, pd)) {
+        free(reduce_groups);
         ip->had_error_ = 1;
         goto cleanup_exit;
       }
@@ -4736,7 +6308,8 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
       ip_printf(ip, "            }\n");
       ip_printf(ip, "            break;\n");
     }
-    ip_printf(ip, "          } /* switch */\n");
+    free(reduce_groups);
+    emit_reduce_dispatch_end(ip, cc, "          ");
   }
   ip_printf(ip, "        } /* scope guard */\n");
   ip_printf(ip, "\n");
@@ -4747,7 +6320,8 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
                   "         * push nonterminal_data_reduced_to */\n");
     ip_printf(ip, "        for (stack->sym_idx_ = stack->pos_ - stack->current_production_length_; stack->sym_idx_ < stack->pos_; ++stack->sym_idx_) {\n");
     if (have_specific_destructors) {
-      ip_printf(ip, "          switch (stack->stack_[stack->sym_idx_].state_) {\n", cc_prefix(cc));
+      ip_printf(ip, cc->segmented_stack_ ? "          switch (stack->stack_[stack->sym_idx_]->state_) {\n"
+                                         : "          switch (stack->stack_[stack->sym_idx_].state_) {\n", cc_prefix(cc));
       size_t typestr_idx;
       for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
         struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
@@ -4755,8 +6329,8 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
           int have_cases = 0; /* always true if all types are always used */
           /* Type has a destructor associated.. Find all state for whose corresponding symbol has the associated type */
           size_t state_idx;
-          for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-            struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+          for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+            struct symbol *sym = state_syms->syms_[state_idx];
             if (!sym) continue;
             if (sym->assigned_type_ == ts) {
               ip_printf(ip, "            case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -4790,8 +6364,10 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
   }
  
   ip_printf(ip, "        stack->pos_ -= stack->current_production_length_;\n"
-                "        stack->top_of_stack_has_sym_data_ = stack->top_of_stack_has_common_data_ = 1;\n"
-                "        action = %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1].state_ + (stack->current_production_nonterminal_ - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
+                "        stack->top_of_stack_has_sym_data_ = stack->top_of_stack_has_common_data_ = 1;\n");
+  emit_parse_profile_count(ip, cc, "stack->current_production_nonterminal_");
+  ip_printf(ip, cc->segmented_stack_ ? "        action = %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1]->state_ + (stack->current_production_nonterminal_ - %sminimum_sym)];\n"
+                                     : "        action = %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1].state_ + (stack->current_production_nonterminal_ - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
   ip_printf(ip, "        if (action <= 0) {\n"
                 "          ");
   emit_internal_error(ip, cc);
@@ -4808,7 +6384,8 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
     }
     else if (cc->common_data_assigned_type_->move_snippet_.num_tokens_) {
       /* clear to 0 if a move is defined. */
-      ip_printf(ip, "          memset(&stack->stack_[stack->pos_ - 1].common_, 0, sizeof(stack->stack_->common_));\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          memset(&stack->stack_[stack->pos_ - 1]->common_, 0, sizeof(stack->stack_[0]->common_));\n"
+                                         : "          memset(&stack->stack_[stack->pos_ - 1].common_, 0, sizeof(stack->stack_->common_));\n");
     }
     if (cc->common_data_assigned_type_->is_raii_constructor_) {
       ip_printf(ip, "          stack->top_of_stack_has_common_data_ = 1;\n");
@@ -4821,7 +6398,8 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
       }
     }
     else {
-      ip_printf(ip, "          memcpy(&stack->stack_[stack->pos_ - 1].common_, &stack->stack_[1].common_, sizeof(stack->stack_->common_));\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          memcpy(&stack->stack_[stack->pos_ - 1]->common_, &stack->stack_[1]->common_, sizeof(stack->stack_[0]->common_));\n"
+                                         : "          memcpy(&stack->stack_[stack->pos_ - 1].common_, &stack->stack_[1].common_, sizeof(stack->stack_->common_));\n");
     }
     ip_printf(ip, "          stack->slot_1_has_common_data_ = 0;\n");
   }
@@ -4834,8 +6412,8 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
           ts->destructor_snippet_.num_tokens_ ||
           ts->move_snippet_.num_tokens_) {
         size_t state_idx;
-        for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-          struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+        for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+          struct symbol *sym = state_syms->syms_[state_idx];
           if (sym && sym->assigned_type_ == ts) {
             have_any_cases = 1;
             break;
@@ -4846,17 +6424,19 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
     }
 
     if (!have_any_cases) {
-      ip_printf(ip, "          memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[1].v_, sizeof(stack->stack_->v_));\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          memcpy(&stack->stack_[stack->pos_ - 1]->v_, &stack->stack_[1]->v_, sizeof(stack->stack_[0]->v_));\n"
+                                         : "          memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[1].v_, sizeof(stack->stack_->v_));\n");
     }
     else {
-      ip_printf(ip, "          switch(stack->stack_[stack->pos_ - 1].state_) {\n");
+      ip_printf(ip, cc->segmented_stack_ ? "          switch(stack->stack_[stack->pos_ - 1]->state_) {\n"
+                                         : "          switch(stack->stack_[stack->pos_ - 1].state_) {\n");
       for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
         struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
         int have_cases = 0; /* always true if all types are always used */
         /* Type has a constructor associated.. Find all state for whose corresponding symbol has the associated type */
         size_t state_idx;
-        for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-          struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+        for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+          struct symbol *sym = state_syms->syms_[state_idx];
           if (!sym) continue;
           if (sym->assigned_type_ == ts) {
             ip_printf(ip, "    case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -4878,7 +6458,8 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
             }
             else if (ts->move_snippet_.num_tokens_) {
               /* clear to 0 if a move is defined but no constructor. */
-              ip_printf(ip, "      memset(&stack->stack_[stack->pos_ - 1].v_, 0, sizeof(stack->stack_->v_));\n");
+              ip_printf(ip, cc->segmented_stack_ ? "      memset(&stack->stack_[stack->pos_ - 1]->v_, 0, sizeof(stack->stack_[0]->v_));\n"
+                                                 : "      memset(&stack->stack_[stack->pos_ - 1].v_, 0, sizeof(stack->stack_->v_));\n");
             }
             if (ts->is_raii_constructor_) {
               ip_printf(ip, "      stack->top_of_stack_has_sym_data_ = 1;\n");
@@ -4896,12 +6477,14 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
               }
             }
             else {
-              ip_printf(ip, "    memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[1].v_, sizeof(stack->stack_->v_));\n");
+              ip_printf(ip, cc->segmented_stack_ ? "    memcpy(&stack->stack_[stack->pos_ - 1]->v_, &stack->stack_[1]->v_, sizeof(stack->stack_[0]->v_));\n"
+                                                 : "    memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[1].v_, sizeof(stack->stack_->v_));\n");
             }
           }
           else {
             /* No %constructor, %destructor or %move defined. Just copy the value. */
-            ip_printf(ip, "          memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[1].v_, sizeof(stack->stack_->v_));\n");
+            ip_printf(ip, cc->segmented_stack_ ? "          memcpy(&stack->stack_[stack->pos_ - 1]->v_, &stack->stack_[1]->v_, sizeof(stack->stack_[0]->v_));\n"
+                                               : "          memcpy(&stack->stack_[stack->pos_ - 1].v_, &stack->stack_[1].v_, sizeof(stack->stack_->v_));\n");
           }
           ip_printf(ip, "break;\n");
         }
@@ -4917,7 +6500,8 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
   ip_printf(ip, "        /* check if we can recover using an error token. */\n"
                 "        size_t n;\n"
                 "        for (n = 0; n < stack->pos_; ++n) {\n");
-  ip_printf(ip, "          stack->current_err_action_ = %sparse_table[%snum_columns * stack->stack_[n].state_ + (%d /* error token */ - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc->error_sym_->ordinal_, cc_prefix(cc));
+  ip_printf(ip, cc->segmented_stack_ ? "          stack->current_err_action_ = %sparse_table[%snum_columns * stack->stack_[n]->state_ + (%d /* error token */ - %sminimum_sym)];\n"
+                                     : "          stack->current_err_action_ = %sparse_table[%snum_columns * stack->stack_[n].state_ + (%d /* error token */ - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc->error_sym_->ordinal_, cc_prefix(cc));
   ip_printf(ip, "          if (stack->current_err_action_ > 0) {\n"
                 "            /* we can transition on the error token somewhere on the stack */\n"
                 "            break;\n"
@@ -4965,7 +6549,8 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
                 "        do {\n"
                 "          --n;\n"
                 "          /* Can we shift an error token? */\n");
-  ip_printf(ip, "          stack->current_err_action_ = %sparse_table[%snum_columns * stack->stack_[n].state_ + (%d /* error token */ - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc->error_sym_->ordinal_, cc_prefix(cc));
+  ip_printf(ip, cc->segmented_stack_ ? "          stack->current_err_action_ = %sparse_table[%snum_columns * stack->stack_[n]->state_ + (%d /* error token */ - %sminimum_sym)];\n"
+                                     : "          stack->current_err_action_ = %sparse_table[%snum_columns * stack->stack_[n].state_ + (%d /* error token */ - %sminimum_sym)];\n", cc_prefix(cc), cc_prefix(cc), cc->error_sym_->ordinal_, cc_prefix(cc));
   ip_printf(ip, "          if (stack->current_err_action_ > 0) {\n");
   ip_printf(ip, "            /* Does the resulting state accept the current symbol? */\n"
                 "            int err_sym_action;\n");
@@ -4977,7 +6562,8 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
     ip_printf(ip, "                /* Free symdata for every symbol up to the state where we will shift the error token */\n");
     ip_printf(ip, "                for (stack->sym_idx_ = n + 1; stack->sym_idx_ < stack->pos_; ++stack->sym_idx_) {\n");
     if (have_specific_destructors) {
-      ip_printf(ip, "                  switch (stack->stack_[stack->sym_idx_].state_) {\n");
+      ip_printf(ip, cc->segmented_stack_ ? "                  switch (stack->stack_[stack->sym_idx_]->state_) {\n"
+                                         : "                  switch (stack->stack_[stack->sym_idx_].state_) {\n");
       size_t typestr_idx;
       for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
         struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
@@ -4985,8 +6571,8 @@ static void emit_parse_function(struct indented_printer *ip, struct carburetta_c
           int have_cases = 0; /* always true if all types are always used */
           /* Type has a destructor associated.. Find all state for whose corresponding symbol has the associated type */
           size_t state_idx;
-          for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-            struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+          for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+            struct symbol *sym = state_syms->syms_[state_idx];
             if (!sym) continue;
             if (sym->assigned_type_ == ts) {
               ip_printf(ip, "                    case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -5162,6 +6748,7 @@ int emit_stack_struct_decl(struct indented_printer *ip, struct carburetta_contex
   if (prdg->num_patterns_) {
     ip_printf(ip, "  int need_sym_:1;\n"
                   "  int is_final_input_:1;\n"
+                  "  int input_in_place_:1;\n"
                   "  int slot_0_has_current_sym_data_:1;\n"
                   "  int slot_0_has_common_data_:1;\n"
                   "  int current_sym_;\n"
@@ -5179,8 +6766,14 @@ int emit_stack_struct_decl(struct indented_printer *ip, struct carburetta_contex
   ip_printf(ip, "  int continue_at_;\n");
   ip_printf(ip, "  int mute_error_turns_;\n");
   ip_printf(ip, "  size_t pos_, num_stack_allocated_;\n");
-  ip_printf(ip, "  struct %ssym_data *stack_;\n", cc_prefix(cc));
-  ip_printf(ip, "  struct %ssym_data *sym_data_;\n", cc_prefix(cc));
+  if (cc->segmented_stack_) {
+    ip_printf(ip, "  struct %ssym_data **stack_;\n", cc_prefix(cc));
+    ip_printf(ip, "  struct %ssym_data **sym_data_;\n", cc_prefix(cc));
+  }
+  else {
+    ip_printf(ip, "  struct %ssym_data *stack_;\n", cc_prefix(cc));
+    ip_printf(ip, "  struct %ssym_data *sym_data_;\n", cc_prefix(cc));
+  }
   ip_printf(ip, "  struct %ssym_data *new_buf_;\n", cc_prefix(cc));
   ip_printf(ip, "  size_t new_buf_num_allocated_;\n");
   ip_printf(ip, "  size_t new_buf_sym_partial_pos_;\n");
@@ -5197,6 +6790,8 @@ int emit_stack_struct_decl(struct indented_printer *ip, struct carburetta_contex
                   "  size_t input_offset_;\n"
                   "  size_t match_buffer_size_;\n"
                   "  size_t match_buffer_size_allocated_;\n"
+                  "  /* bytes of consumed tokens at the head of the allocation, preceding match_buffer_ */\n"
+                  "  size_t match_buffer_skip_;\n"
                   "  /* offset, line and column at the start of match_buffer_ */\n"
                   "  size_t match_offset_;\n"
                   "  int match_line_;\n"
@@ -5208,6 +6803,9 @@ int emit_stack_struct_decl(struct indented_printer *ip, struct carburetta_contex
                   "  int best_match_col_;\n"
                   "  size_t token_size_;\n"
                   "  char *match_buffer_;\n"
+                  "  /* start of the current token, either in match_buffer_, or in the input if it was set\n"
+                  "   * with set_input_in_place() and the token lies entirely within it. */\n"
+                  "  char *token_text_;\n"
                   "  char terminator_repair_;\n"
                   "  int input_line_;\n"
                   "  int input_col_;\n");
@@ -5216,6 +6814,22 @@ int emit_stack_struct_decl(struct indented_printer *ip, struct carburetta_contex
       ip_printf(ip, "  char codepoint_[4];\n");
       ip_printf(ip, "  char *cp_;\n");
     }
+    if (cc->lazy_dfa_max_states_) {
+      ip_printf(ip, "  /* DFA states determinized so far, allocated upon first use */\n");
+      ip_printf(ip, "  struct %sscan_lazy_dfa *scan_lazy_;\n", cc_prefix(cc));
+    }
+    if (cc->linear_scan_) {
+      ip_printf(ip, "  /* bitset rows, one per position in match_buffer_ (offset by scan_memo_skip_), of\n"
+                    "   * scan states known to not lead to a match from that position onwards. */\n"
+                    "  unsigned char *scan_memo_;\n"
+                    "  size_t scan_memo_skip_;\n"
+                    "  size_t scan_memo_num_rows_;\n"
+                    "  size_t scan_memo_num_rows_allocated_;\n"
+                    "  /* (position, scan state) pairs visited since the start of the current token */\n"
+                    "  size_t *scan_trail_;\n"
+                    "  size_t scan_trail_size_;\n"
+                    "  size_t scan_trail_size_allocated_;\n");
+    }
   }
   ip_printf(ip, "};\n");
   return 0;
@@ -5280,58 +6894,306 @@ int emit_table(struct indented_printer *ip, int *table, size_t num_rows, size_t
   return 0;
 }
 
-/* set to 1 to debug print the transitions made */
-#define DEBUG_DUMP_ENCODE_UTF8_CODE_UNITS 0
+static int emit_scan_compact_tables(struct indented_printer *ip, struct carburetta_context *cc, const int *table, size_t num_rows, size_t num_columns) {
+  /* Emits the scan table (num_rows rows of num_columns, the last 4 the anchor columns) for --compact-scan.
+   * Each distinct row of the symbol columns is stored once in <prefix>scan_rows_; a state whose row
+   * differs from one of the distinct rows shortly before it in only a few columns refers to that row
+   * and lists the columns that differ, and the states they lead to, in <prefix>scan_exceptions_. Each
+   * state has a row in <prefix>scan_states_ with the offset of its row, the index of its first
+   * exception and its anchor transitions, followed by a sentinel row that ends the exceptions of the
+   * last state. As the states of a mode are numbered together, similar states tend to be close. */
+  size_t num_symbol_columns = num_columns - 4;
+  size_t max_exceptions = num_symbol_columns / 4;
+  size_t num_unique = 0, num_exceptions = 0;
+  size_t row, col, n;
+  int r = -1;
+  if (max_exceptions > EMIT_SCAN_COMPACT_MAX_EXCEPTIONS) max_exceptions = EMIT_SCAN_COMPACT_MAX_EXCEPTIONS;
+
+  size_t num_cells;
+  if (multiply_size_t(num_rows, num_symbol_columns, NULL, &num_cells) || (num_cells > INT_MAX)) {
+    re_error_nowhere("Error, overflow\n");
+    ip->had_error_ = 1;
+    return -1;
+  }
+  int *rows = (int *)malloc(sizeof(int) * (num_cells ? num_cells : 1));
+  uint32_t *row_hashes = (uint32_t *)malloc(sizeof(uint32_t) * (num_rows ? num_rows : 1));
+  int *states = (int *)malloc(sizeof(int) * EMIT_SCAN_COMPACT_STATE_COLUMNS * (num_rows + 1));
+  int *exceptions = (int *)malloc(sizeof(int) * 2 * (num_rows * max_exceptions + 1));
+  if (!rows || !row_hashes || !states || !exceptions) {
+    re_error_nowhere("Error, no memory\n");
+    ip->had_error_ = 1;
+    goto cleanup_exit;
+  }
 
-int encode_utf8_code_units(struct rex_scanner *rex, size_t num_digits, uint8_t *low, uint8_t *high, uint8_t *min, uint8_t *max, size_t from_nfa, size_t to_nfa) {
-  enum {
-    EXACT,
-    ADJACENT,
-    RANGE
-  } needs[6];
-  
-  struct {
-    size_t top;
-    size_t mid;
-    size_t bottom;
-  } nodes[(sizeof(needs)/sizeof(*needs))];
+  for (row = 0; row < num_rows; ++row) {
+    const int *cells = table + row * num_columns;
+    uint32_t hash = 2166136261u;
+    for (col = 0; col < num_symbol_columns; ++col) {
+      hash = (hash ^ (uint32_t)cells[col]) * 16777619u;
+    }
 
-  assert(num_digits < ((sizeof(needs)/sizeof(*needs)) - 1));
-  size_t n;
-  needs[0] = EXACT;
-  for (n = 0; n < num_digits; ++n) {
-    if (needs[n] == EXACT) {
-      if (low[n] == high[n]) {
-        needs[n + 1] = EXACT;
-      }
-      else if ((low[n] + 1) == high[n]) {
-        needs[n + 1] = ADJACENT;
-      }
-      else {
-        needs[n + 1] = RANGE;
+    size_t base = num_unique;
+    for (n = 0; n < num_unique; ++n) {
+      if ((row_hashes[n] == hash) && !memcmp(rows + n * num_symbol_columns, cells, sizeof(int) * num_symbol_columns)) {
+        base = n;
+        break;
       }
     }
-    else if (needs[n] == ADJACENT) {
-      if ((low[n] == max[n]) && (high[n] == min[n])) {
-        needs[n + 1] = ADJACENT;
+
+    size_t num_differences = 0;
+    if (base == num_unique) {
+      /* No identical row, look for the nearest recent row that differs in the fewest columns */
+      size_t fewest = max_exceptions + 1;
+      for (n = num_unique; n && ((num_unique - n) < EMIT_SCAN_COMPACT_WINDOW); --n) {
+        const int *candidate = rows + (n - 1) * num_symbol_columns;
+        size_t count = 0;
+        for (col = 0; (col < num_symbol_columns) && (count < fewest); ++col) {
+          if (candidate[col] != cells[col]) count++;
+        }
+        if (count < fewest) {
+          fewest = count;
+          base = n - 1;
+        }
+      }
+      if (base != num_unique) {
+        num_differences = fewest;
       }
       else {
-        needs[n + 1] = RANGE;
+        memcpy(rows + num_unique * num_symbol_columns, cells, sizeof(int) * num_symbol_columns);
+        row_hashes[num_unique++] = hash;
       }
     }
-    else {
-      needs[n + 1] = RANGE;
+
+    int *state = states + row * EMIT_SCAN_COMPACT_STATE_COLUMNS;
+    state[0] = (int)(base * num_symbol_columns);
+    state[1] = (int)num_exceptions;
+    for (n = 0; n < 4; ++n) {
+      state[2 + n] = cells[num_symbol_columns + n];
+    }
+    if (num_differences) {
+      const int *base_cells = rows + base * num_symbol_columns;
+      for (col = 0; col < num_symbol_columns; ++col) {
+        if (base_cells[col] != cells[col]) {
+          exceptions[2 * num_exceptions] = (int)col;
+          exceptions[2 * num_exceptions + 1] = cells[col];
+          num_exceptions++;
+        }
+      }
     }
   }
-
-  if (needs[num_digits] == EXACT) {
-    nodes[num_digits].mid = to_nfa;
+  int *sentinel = states + num_rows * EMIT_SCAN_COMPACT_STATE_COLUMNS;
+  for (n = 0; n < EMIT_SCAN_COMPACT_STATE_COLUMNS; ++n) {
+    sentinel[n] = 0;
   }
-  else if (needs[num_digits] == ADJACENT) {
-    nodes[num_digits].top = to_nfa;
-    nodes[num_digits].bottom = to_nfa;
+  sentinel[1] = (int)num_exceptions;
+  if (!num_exceptions) {
+    /* C has no empty arrays */
+    exceptions[0] = exceptions[1] = 0;
   }
-  else if (needs[num_digits] == RANGE) {
+
+  ip_printf(ip, "/* %zu scan states share %zu distinct rows of %zu columns, with %zu exceptions */\n", num_rows, num_unique, num_symbol_columns, num_exceptions);
+  ip_printf(ip, "static const int %sscan_rows_[] = {\n", cc_prefix(cc));
+  if (emit_table(ip, rows, num_unique, num_symbol_columns)) goto cleanup_exit;
+  ip_printf(ip, "};\n");
+  ip_printf(ip, "static const int %sscan_states_[] = {\n", cc_prefix(cc));
+  if (emit_table(ip, states, num_rows + 1, EMIT_SCAN_COMPACT_STATE_COLUMNS)) goto cleanup_exit;
+  ip_printf(ip, "};\n");
+  ip_printf(ip, "static const int %sscan_exceptions_[] = {\n", cc_prefix(cc));
+  if (emit_table(ip, exceptions, num_exceptions ? num_exceptions : 1, 2)) goto cleanup_exit;
+  ip_printf(ip, "};\n");
+
+  r = 0;
+cleanup_exit:
+  if (rows) free(rows);
+  if (row_hashes) free(row_hashes);
+  if (states) free(states);
+  if (exceptions) free(exceptions);
+  return r;
+}
+
+static int mode_start_state(struct carburetta_context *cc, struct rex_mode *rm) {
+  /* Scan state a mode starts in; with --lazy-dfa these are the states right after the dead state,
+   * in the order of the modes, otherwise they are wherever they ended up in the DFA. */
+  if (cc->lazy_dfa_max_states_) return 1 + rm->ordinal_;
+  return rm->dfa_node_->ordinal_;
+}
+
+static int emit_scan_lazy_tables(struct indented_printer *ip, struct carburetta_context *cc, struct rex_scanner *rex) {
+  /* Emits the NFA the --lazy-dfa scanner determinizes from. Each node has its action (0 for none) and
+   * its first transition, followed by a sentinel; each transition has the node it leads to and the
+   * symbols it is on, first up to end (exclusive), an empty transition is on -1 up to -1, an anchor
+   * transition on -2 - anchor up to -2 - anchor. */
+  size_t num_nodes = rex->nfa_.num_nfa_nodes_;
+  size_t num_trans = 0;
+  size_t num_modes = rex->modes_ ? (size_t)rex->modes_->ordinal_ + 1 : 0;
+  size_t num_groups = rex->dfa_.symbol_groups_ ? (size_t)rex->dfa_.symbol_groups_->ordinal_ : 0;
+  size_t n;
+  int r = 0;
+  int *nodes = NULL;
+  int *trans = NULL;
+  int *mode_starts = NULL;
+  int *group_symbols = NULL;
+  for (n = 0; n < num_nodes; ++n) {
+    struct rex_nfa_trans *t = rex->nfa_.nfa_nodes_[n].outbound_;
+    if (t) {
+      do {
+        t = t->from_peer_;
+        num_trans++;
+      } while (t != rex->nfa_.nfa_nodes_[n].outbound_);
+    }
+  }
+  nodes = (int *)malloc(sizeof(int) * 2 * (num_nodes + 1));
+  trans = (int *)malloc(sizeof(int) * 3 * (num_trans ? num_trans : 1));
+  mode_starts = (int *)malloc(sizeof(int) * (num_modes ? num_modes : 1));
+  group_symbols = (int *)malloc(sizeof(int) * (num_groups + 1));
+  if (!nodes || !trans || !mode_starts || !group_symbols) {
+    re_error_nowhere("Error, no memory\n");
+    r = -1;
+    goto cleanup_exit;
+  }
+
+  num_trans = 0;
+  for (n = 0; n < num_nodes; ++n) {
+    struct rex_nfa_node *nn = rex->nfa_.nfa_nodes_ + n;
+    nodes[2 * n] = nn->pattern_matched_ ? (int)nn->pattern_matched_->action_ : 0;
+    nodes[2 * n + 1] = (int)num_trans;
+    struct rex_nfa_trans *t = nn->outbound_;
+    if (t) {
+      do {
+        t = t->from_peer_;
+        trans[3 * num_trans] = (int)t->to_;
+        if (t->is_empty_) {
+          trans[3 * num_trans + 1] = trans[3 * num_trans + 2] = -1;
+        }
+        else if (t->is_anchor_) {
+          trans[3 * num_trans + 1] = trans[3 * num_trans + 2] = -2 - (int)t->symbol_start_;
+        }
+        else {
+          trans[3 * num_trans + 1] = (int)t->symbol_start_;
+          trans[3 * num_trans + 2] = (int)t->symbol_end_;
+        }
+        num_trans++;
+      } while (t != nn->outbound_);
+    }
+  }
+  nodes[2 * num_nodes] = 0;
+  nodes[2 * num_nodes + 1] = (int)num_trans;
+
+  struct rex_mode *m = rex->modes_;
+  if (m) {
+    do {
+      m = m->chain_;
+      mode_starts[m->ordinal_] = (int)m->nfa_begin_state_;
+    } while (m != rex->modes_);
+  }
+
+  ip_printf(ip, "static const int %sscan_nfa_nodes_[] = {\n", cc_prefix(cc));
+  if (emit_table(ip, nodes, num_nodes + 1, 2)) {
+    r = -1;
+    goto cleanup_exit;
+  }
+  ip_printf(ip, "};\n");
+  ip_printf(ip, "static const int %sscan_nfa_trans_[] = {\n", cc_prefix(cc));
+  if (emit_table(ip, trans, num_trans ? num_trans : 1, 3)) {
+    r = -1;
+    goto cleanup_exit;
+  }
+  ip_printf(ip, "};\n");
+  ip_printf(ip, "static const int %sscan_nfa_mode_starts_[] = {\n", cc_prefix(cc));
+  if (emit_table(ip, mode_starts, 1, num_modes)) {
+    r = -1;
+    goto cleanup_exit;
+  }
+  ip_printf(ip, "};\n");
+
+  size_t num_columns = 256 + 4;
+  if (cc->utf8_experimental_) {
+    /* A symbol of each group, the one it starts with; group 0 (invalid or no transitions) has none */
+    group_symbols[0] = -1;
+    struct rex_symbol_group *sg = rex->dfa_.symbol_groups_;
+    if (sg) {
+      do {
+        sg = sg->chain_;
+        group_symbols[sg->ordinal_] = (int)sg->ranges_->chain_->symbol_start_;
+      } while (sg != rex->dfa_.symbol_groups_);
+    }
+    ip_printf(ip, "static const int %sscan_lazy_group_symbols_[] = {\n", cc_prefix(cc));
+    if (emit_table(ip, group_symbols, 1, num_groups + 1)) {
+      r = -1;
+      goto cleanup_exit;
+    }
+    ip_printf(ip, "};\n");
+    num_columns = num_groups + 1 + 4;
+  }
+
+  /* Room for at least the dead state, the start states and one more */
+  size_t max_states = cc->lazy_dfa_max_states_;
+  if (max_states < (num_modes + 2)) max_states = num_modes + 2;
+  ip_printf(ip, "static const size_t %snum_scan_nfa_nodes_ = %zu;\n", cc_prefix(cc), num_nodes);
+  ip_printf(ip, "static const size_t %snum_scan_modes_ = %zu;\n", cc_prefix(cc), num_modes);
+  ip_printf(ip, "static const size_t %snum_scan_lazy_columns_ = %zu;\n", cc_prefix(cc), num_columns);
+  ip_printf(ip, "static const size_t %sscan_lazy_max_states_ = %zu;\n", cc_prefix(cc), max_states);
+
+cleanup_exit:
+  if (nodes) free(nodes);
+  if (trans) free(trans);
+  if (mode_starts) free(mode_starts);
+  if (group_symbols) free(group_symbols);
+  return r;
+}
+
+/* set to 1 to debug print the transitions made */
+#define DEBUG_DUMP_ENCODE_UTF8_CODE_UNITS 0
+
+int encode_utf8_code_units(struct rex_scanner *rex, size_t num_digits, uint8_t *low, uint8_t *high, uint8_t *min, uint8_t *max, size_t from_nfa, size_t to_nfa) {
+  enum {
+    EXACT,
+    ADJACENT,
+    RANGE
+  } needs[6];
+  
+  struct {
+    size_t top;
+    size_t mid;
+    size_t bottom;
+  } nodes[(sizeof(needs)/sizeof(*needs))];
+
+  assert(num_digits < ((sizeof(needs)/sizeof(*needs)) - 1));
+  size_t n;
+  needs[0] = EXACT;
+  for (n = 0; n < num_digits; ++n) {
+    if (needs[n] == EXACT) {
+      if (low[n] == high[n]) {
+        needs[n + 1] = EXACT;
+      }
+      else if ((low[n] + 1) == high[n]) {
+        needs[n + 1] = ADJACENT;
+      }
+      else {
+        needs[n + 1] = RANGE;
+      }
+    }
+    else if (needs[n] == ADJACENT) {
+      if ((low[n] == max[n]) && (high[n] == min[n])) {
+        needs[n + 1] = ADJACENT;
+      }
+      else {
+        needs[n + 1] = RANGE;
+      }
+    }
+    else {
+      needs[n + 1] = RANGE;
+    }
+  }
+
+  if (needs[num_digits] == EXACT) {
+    nodes[num_digits].mid = to_nfa;
+  }
+  else if (needs[num_digits] == ADJACENT) {
+    nodes[num_digits].top = to_nfa;
+    nodes[num_digits].bottom = to_nfa;
+  }
+  else if (needs[num_digits] == RANGE) {
     nodes[num_digits].top = to_nfa;
     nodes[num_digits].mid = to_nfa;
     nodes[num_digits].bottom = to_nfa;
@@ -5531,7 +7393,299 @@ int encode_utf8_range(struct rex_scanner *rex, uint32_t u32_start, uint32_t u32_
   return 0;
 }
 
-static int emit_stack_deconstruction(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct lr_generator *lalr, int *state_syms) {
+int emit_scan_table_grouped(struct rex_dfa *dfa, size_t *pnum_rows, size_t *pnum_columns, int **ptable) {
+  /* +1 to include a 0 column, +4 to include room for anchors (start-of-input, start-of-line, end-of-line, end-of-input) */
+  size_t num_columns = dfa->symbol_groups_ ? dfa->symbol_groups_->ordinal_ + 1 + 4 : 1;
+  size_t first_anchor_column = dfa->symbol_groups_->ordinal_ + 1;
+
+  size_t num_rows = dfa->nodes_->ordinal_ + 1;
+  size_t num_cells;
+  if (multiply_size_t(num_columns, num_rows, NULL, &num_cells)) {
+    /* Overflow */
+    re_error_nowhere("Error, overflow\n");
+    return -1;
+  }
+  int *table = (int *)calloc(num_cells, sizeof(int));
+  if (!table) {
+    /* No memory */
+    re_error_nowhere("Error, no memory\n");
+    return -1;
+  }
+  struct rex_dfa_node *dn = dfa->nodes_;
+  if (dn) {
+    do {
+      dn = dn->chain_;
+
+      int *row = table + num_columns * dn->ordinal_;
+
+      memset(row, 0, sizeof(int) * num_columns);
+
+      /* Loop over all transition groups from the current DFA node.
+       * XXX: Note, we loop over all, and filter. Inefficient. */
+      struct rex_dfa_trans_group *tg = dfa->trans_groups_;
+      if (tg) {
+        do {
+          tg = tg->sibling_;
+
+          if (tg->transitions_->from_ == dn) {
+            struct rex_selector *selector = tg->selectors_;
+            if (selector) {
+              do {
+                selector = selector->next_in_dfa_transition_group_;
+
+                row[selector->symbol_group_->ordinal_] = tg->transitions_->to_->ordinal_;
+
+              } while (selector != tg->selectors_);
+            }
+          }
+
+        } while (tg != dfa->trans_groups_);
+      }
+
+      struct rex_dfa_trans *dt = dn->outbound_;
+      size_t n;
+      for (n = 0; n < 4; ++n) {
+        /* Default is for anchor cells to aim to own state */
+        row[first_anchor_column + n] = dn->ordinal_;
+      }
+      if (dt) {
+        do {
+          dt = dt->from_peer_;
+
+          if (dt->is_anchor_) {
+            /* Actual anchor transitions point to other state, overwriting default.
+             * See REX_ANCHOR_XXX constants for dt->symbol_start_ values (0..3) if is_anchor_*/
+            row[first_anchor_column + dt->symbol_start_] = dt->to_->ordinal_;
+          }
+
+        } while (dt != dn->outbound_);
+      }
+    } while (dn != dfa->nodes_);
+  }
+  *pnum_rows = num_rows;
+  *pnum_columns = num_columns;
+  *ptable = table;
+  return 0;
+}
+
+int emit_scan_table_raw(struct rex_dfa *dfa, size_t *pnum_rows, int **ptable) {
+  const size_t num_columns = 256 + 4;
+  size_t num_rows = dfa->nodes_->ordinal_ + 1;
+  size_t num_cells;
+  if (multiply_size_t(num_columns, num_rows, NULL, &num_cells)) {
+    re_error_nowhere("Error, overflow\n");
+    return -1;
+  }
+  int *table = (int *)calloc(num_cells, sizeof(int));
+  if (!table) {
+    re_error_nowhere("Error, no memory\n");
+    return -1;
+  }
+  struct rex_dfa_node *dn = dfa->nodes_;
+  if (dn) {
+    do {
+      dn = dn->chain_;
+
+      int *row = table + num_columns * dn->ordinal_;
+      size_t n;
+      for (n = 256; n < num_columns; ++n) {
+        /* Default is for anchor cells to aim to own state */
+        row[n] = dn->ordinal_;
+      }
+
+      struct rex_dfa_trans *dt = dn->outbound_;
+      if (dt) {
+        do {
+          dt = dt->from_peer_;
+
+          if (dt->is_anchor_) {
+            row[256 + dt->symbol_start_] = dt->to_->ordinal_;
+          }
+          else {
+            uint32_t input_sym;
+            for (input_sym = dt->symbol_start_; (input_sym < dt->symbol_end_) && (input_sym < 256); ++input_sym) {
+              row[input_sym] = dt->to_->ordinal_;
+            }
+          }
+
+        } while (dt != dn->outbound_);
+      }
+    } while (dn != dfa->nodes_);
+  }
+  *pnum_rows = num_rows;
+  *ptable = table;
+  return 0;
+}
+
+int emit_utf8_decoder_table(struct rex_dfa *dfa, size_t *pnum_rows, int **ptable) {
+  /* UTF-8 encoding map */
+  int *table = NULL;
+  struct rex_scanner utf8_scanner;
+  rex_init(&utf8_scanner);
+
+  struct rex_mode *default_mode = NULL;
+  int r;
+  r = rex_add_mode(&utf8_scanner, &default_mode);
+  if (r) goto fail;
+
+  struct rex_symbol_group *sg = dfa->symbol_groups_;
+  if (sg) {
+    do {
+      sg = sg->chain_;
+
+      struct rex_pattern *pat = NULL;
+      
+      r = rex_alloc_pattern(&utf8_scanner, (uintptr_t)sg->ordinal_, &pat);
+      if (r) goto fail;
+      pat->nfa_begin_state_ = rex_nfa_make_node(&utf8_scanner.nfa_);
+      pat->nfa_final_state_ = rex_nfa_make_node(&utf8_scanner.nfa_);
+      if ((pat->nfa_begin_state_ == SIZE_MAX) || (pat->nfa_final_state_ == SIZE_MAX)) goto fail;
+      utf8_scanner.nfa_.nfa_nodes_[pat->nfa_final_state_].pattern_matched_ = pat;
+      r = rex_add_pattern_to_mode(default_mode, pat);
+      if (r) goto fail;
+
+      struct rex_symbol_range *sr = sg->ranges_;
+      if (sr) {
+        do {
+          sr = sr->chain_;
+
+          r = encode_utf8_range(&utf8_scanner, sr->symbol_start_, sr->symbol_end_ - 1, pat->nfa_begin_state_, pat->nfa_final_state_);
+          if (r) goto fail;
+
+        } while (sr != sg->ranges_);
+      }
+    } while (sg != dfa->symbol_groups_);
+  }
+
+  /* Catch-all symbol group #0 (entire unicode range) -- this distinguishes valid UTF-8 encodings from invalid ones. */
+  struct rex_pattern *pat = NULL;
+  r = rex_alloc_pattern(&utf8_scanner, 0, &pat);
+  if (r) goto fail;
+  pat->nfa_begin_state_ = rex_nfa_make_node(&utf8_scanner.nfa_);
+  pat->nfa_final_state_ = rex_nfa_make_node(&utf8_scanner.nfa_);
+  if ((pat->nfa_begin_state_ == SIZE_MAX) || (pat->nfa_final_state_ == SIZE_MAX)) goto fail;
+  utf8_scanner.nfa_.nfa_nodes_[pat->nfa_final_state_].pattern_matched_ = pat;
+  r = rex_add_pattern_to_mode(default_mode, pat);
+  if (r) goto fail;
+
+  r = encode_utf8_range(&utf8_scanner, 0x00, 0x10FFFF, pat->nfa_begin_state_, pat->nfa_final_state_);
+  if (r) goto fail;
+
+  r = rex_realize_modes(&utf8_scanner);
+  if (r) goto fail;
+
+  /* Renumber the ordinals for the DFA nodes. DFA nodes that have a matching pattern are not part of the final set (as the
+   * transition /to/ the DFA node is the moment the action is taken; for any UTF-8 codepoint there can only be a single
+   * match, there is no notion of a "longest" match.)
+   * Node number 0 is the starting node, it is never a destination as there are no cycles in the UTF-8 decoding DFA. A
+   * destination of 0 means the encoding under examination is invalid. */
+  struct rex_dfa_node *dn = utf8_scanner.dfa_.nodes_;
+  /* ordinal 0 is for invalid encodings, 
+   * regular symbol groups start at 1. */
+  int ordinal = 1;
+  if (dn) {
+    do {
+      dn = dn->chain_;
+
+      if (dn == default_mode->dfa_node_) {
+        /* Start condition */
+        dn->ordinal_ = 0;
+      }
+      else if (!dn->pattern_matched_) {
+        dn->ordinal_ = ordinal++;
+      }
+      else {
+        /* DFA node with pattern match. These are not emitted */
+        dn->ordinal_ = INT_MIN;
+      }
+    } while (dn != utf8_scanner.dfa_.nodes_);
+  }
+
+  size_t num_columns = 256;
+  size_t num_rows = (size_t)ordinal;
+  size_t num_cells;
+
+  if (multiply_size_t(num_rows, num_columns, NULL, &num_cells)) {
+    re_error_nowhere("Error, overflow\n");
+    rex_cleanup(&utf8_scanner);
+    return -1;
+  }
+
+  table = (int *)calloc(num_cells, sizeof(int));
+  if (!table) {
+    re_error_nowhere("Error, no memory\n");
+    rex_cleanup(&utf8_scanner);
+    return -1;
+  }
+  size_t cell_idx;
+  for (cell_idx = 0; cell_idx < num_cells; ++cell_idx) {
+    /* Default cell is -1, which equals an error transition (invalid encoding) */
+    /* Regular transitions start at -2 and go down. Two's complement ~cell will
+     * return 0 for errors, non-zero for appropriate transition (row 0 is the
+     * start row..) */
+    table[cell_idx] = ~0;
+  }
+  dn = utf8_scanner.dfa_.nodes_;
+  if (dn) {
+    do {
+      dn = dn->chain_;
+
+      int *row = NULL;
+
+      if (dn == default_mode->dfa_node_) {
+        /* Start condition */
+        row = table;
+      }
+      else if (!dn->pattern_matched_) {
+        row = table + num_columns * (size_t)dn->ordinal_;
+      }
+      else {
+        /* DFA node with pattern match. These are not emitted */
+      }
+      if (row) {
+        struct rex_dfa_trans *dt = dn->outbound_;
+        if (dt) {
+          do {
+            dt = dt->from_peer_;
+                            
+            if (dt->to_->pattern_matched_) {
+              uint32_t c;
+              /* Completion of pattern dt->to_->pattern_matched_ */
+              for (c = dt->symbol_start_; c < dt->symbol_end_; ++c) {
+                row[c] = (int)dt->to_->pattern_matched_->action_;
+              }
+            }
+            else {
+              uint32_t c;
+              /* Transition to state dt->to_. */
+              for (c = dt->symbol_start_; c < dt->symbol_end_; ++c) {
+                /* We bitwise-complement instead of negate the ordinal of the 
+                 * destination state. Thus, -1 is reserved for an erroneous encoding,
+                 * and -2 (0xFFFE) is the first valid destination state (~0xFFFE == 1),
+                 * note that destination state 0 (~0 == 0xFFFF), while the initial state,
+                 * can never be a destination state. */
+                row[c] = ~dt->to_->ordinal_;
+              }
+            }
+
+          } while (dt != dn->outbound_);
+        }
+      }
+    } while (dn != utf8_scanner.dfa_.nodes_);
+  }
+
+  rex_cleanup(&utf8_scanner);
+  *pnum_rows = num_rows;
+  *ptable = table;
+  return 0;
+
+fail:
+  re_error_nowhere("Error, failed to build the UTF-8 decoder\n");
+  rex_cleanup(&utf8_scanner);
+  return -1;
+}
+
+static int emit_stack_deconstruction(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct lr_generator *lalr, struct state_syms *state_syms) {
   int have_state_cases = have_destructor_switch_by_state_cases(cc, lalr, state_syms);
   int have_any_destructors = (cc->common_data_assigned_type_ && cc->common_data_assigned_type_->destructor_snippet_.num_tokens_) || have_state_cases;
   int have_common_destructor = cc->common_data_assigned_type_ && cc->common_data_assigned_type_->destructor_snippet_.num_tokens_;
@@ -5652,15 +7806,16 @@ static int emit_stack_deconstruction(struct indented_printer *ip, struct carbure
 
     if (have_state_cases) {
       ip_printf(ip, "    if (need_state_deconstruct) {\n");
-      ip_printf(ip, "    switch (stack->stack_[n].state_) {\n");
+      ip_printf(ip, cc->segmented_stack_ ? "    switch (stack->stack_[n]->state_) {\n"
+                                         : "    switch (stack->stack_[n].state_) {\n");
       for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
         struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
         if (ts->destructor_snippet_.num_tokens_) {
           int have_cases = 0; /* always true if all types are always used */
           /* Type has a destructor associated.. Find all state for whose corresponding symbol has the associated type */
           size_t state_idx;
-          for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-            struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+          for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+            struct symbol *sym = state_syms->syms_[state_idx];
             if (!sym) continue;
             if (sym->assigned_type_ == ts) {
               ip_printf(ip, "    case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -5694,6 +7849,10 @@ static int emit_stack_deconstruction(struct indented_printer *ip, struct carbure
     }
     ip_printf(ip, "  }\n");
 
+    if (cc->segmented_stack_) {
+      /* Segmented stacks grow without a stack->new_buf_, so there is nothing more to be deconstructed. */
+      return 0;
+    }
     ip_printf(ip, "  if (stack->new_buf_) {\n");
     ip_printf(ip, "    /* same deconstructors as above, but now for stack->new_buf_ -- stack->new_buf_ only\n"
                   "     * exists for a brief period time when we resize stack->stack_, however, because\n"
@@ -5804,15 +7963,16 @@ static int emit_stack_deconstruction(struct indented_printer *ip, struct carbure
 
     if (have_state_cases) {
       ip_printf(ip, "    if (need_state_deconstruct) {\n");
-      ip_printf(ip, "    switch (stack->stack_[n].state_) {\n");
+      ip_printf(ip, cc->segmented_stack_ ? "    switch (stack->stack_[n]->state_) {\n"
+                                         : "    switch (stack->stack_[n].state_) {\n");
       for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
         struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
         if (ts->destructor_snippet_.num_tokens_) {
           int have_cases = 0; /* always true if all types are always used */
           /* Type has a destructor associated.. Find all state for whose corresponding symbol has the associated type */
           size_t state_idx;
-          for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-            struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+          for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+            struct symbol *sym = state_syms->syms_[state_idx];
             if (!sym) continue;
             if (sym->assigned_type_ == ts) {
               ip_printf(ip, "    case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -5853,7 +8013,7 @@ static int emit_stack_deconstruction(struct indented_printer *ip, struct carbure
   return 0;
 }
 
-static int emit_stack_visit(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct lr_generator *lalr, int *state_syms) {
+static int emit_stack_visit(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct lr_generator *lalr, struct state_syms *state_syms) {
   int have_state_cases = have_visitation_switch_by_state_cases(cc, lalr, state_syms);
   int have_common_visitation = cc->common_data_assigned_type_ && cc->common_data_assigned_type_->visit_snippet_.num_tokens_;
   int have_any_visitation = have_common_visitation || have_state_cases;
@@ -5975,15 +8135,16 @@ static int emit_stack_visit(struct indented_printer *ip, struct carburetta_conte
 
     if (have_state_cases) {
       ip_printf(ip, "    if (need_state_visit) {\n");
-      ip_printf(ip, "    switch (stack->stack_[n].state_) {\n");
+      ip_printf(ip, cc->segmented_stack_ ? "    switch (stack->stack_[n]->state_) {\n"
+                                         : "    switch (stack->stack_[n].state_) {\n");
       for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
         struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
         if (ts->visit_snippet_.num_tokens_) {
           int have_cases = 0; /* always true if all types are always used */
           /* Type has a visit snippet associated.. Find all state for whose corresponding symbol has the associated type */
           size_t state_idx;
-          for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-            struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+          for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+            struct symbol *sym = state_syms->syms_[state_idx];
             if (!sym) continue;
             if (sym->assigned_type_ == ts) {
               ip_printf(ip, "    case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -6018,6 +8179,10 @@ static int emit_stack_visit(struct indented_printer *ip, struct carburetta_conte
     ip_printf(ip, "  }\n");
     ////////////////////////////////////////////////////////////
     ///////////////////////////////////////////////////////////
+    if (cc->segmented_stack_) {
+      /* Segmented stacks grow without a stack->new_buf_, so there is nothing more to be visited. */
+      return 0;
+    }
     ip_printf(ip, "  if (stack->new_buf_) {\n");
     ip_printf(ip, "    /* same visitation as above, but now for stack->new_buf_ -- stack->new_buf_ only\n"
                   "     * exists for a brief period time when we resize stack->stack_ and are copying things\n"
@@ -6127,15 +8292,16 @@ static int emit_stack_visit(struct indented_printer *ip, struct carburetta_conte
 
     if (have_state_cases) {
       ip_printf(ip, "    if (need_state_visit) {\n");
-      ip_printf(ip, "    switch (stack->stack_[n].state_) {\n");
+      ip_printf(ip, cc->segmented_stack_ ? "    switch (stack->stack_[n]->state_) {\n"
+                                         : "    switch (stack->stack_[n].state_) {\n");
       for (typestr_idx = 0; typestr_idx < cc->tstab_.num_typestrs_; ++typestr_idx) {
         struct typestr *ts = cc->tstab_.typestrs_[typestr_idx];
         if (ts->visit_snippet_.num_tokens_) {
           int have_cases = 0; /* always true if all types are always used */
           /* Type has a visit snippet associated.. Find all state for whose corresponding symbol has the associated type */
           size_t state_idx;
-          for (state_idx = 0; state_idx < lalr->nr_states_; ++state_idx) {
-            struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, state_syms[state_idx]);
+          for (state_idx = state_syms->first_state_of_type_[ts->ordinal_]; state_idx != SIZE_MAX; state_idx = state_syms->next_state_of_type_[state_idx]) {
+            struct symbol *sym = state_syms->syms_[state_idx];
             if (!sym) continue;
             if (sym->assigned_type_ == ts) {
               ip_printf(ip, "    case %d: /* %s */\n", (int)state_idx, sym->def_.translated_);
@@ -6177,8 +8343,10 @@ static int emit_stack_visit(struct indented_printer *ip, struct carburetta_conte
 }
 
 void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct rex_scanner *rex, struct lr_generator *lalr) {
-  int *state_syms;
-  state_syms = NULL;
+  int *state_sym_ordinals;
+  state_sym_ordinals = NULL;
+  struct state_syms state_syms;
+  state_syms_init(&state_syms);
 
   if (cc->emit_line_directives_) {
     int line = emit_line_num(ip, cc, &cc->prologue_);
@@ -6215,6 +8383,9 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
   ip_printf(ip, "#include <string.h> /* memcpy() */\n");
   ip_printf(ip, "#include <stddef.h> /* size_t */\n");
   ip_printf(ip, "#include <stdint.h> /* SIZE_MAX */\n");
+  if (cc->instrument_) {
+    ip_printf(ip, "#include <stdio.h> /* fopen(), fprintf(), fclose() */\n");
+  }
   if (cc->have_cpp_classes_) {
     ip_printf(ip, "#ifndef __cplusplus\n");
     ip_printf(ip, "#error use of %%class directive requires compilation as C++\n");
@@ -6266,297 +8437,69 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
 
   if (prdg->num_patterns_) {
     if (cc->utf8_experimental_) {
-      /* +1 to include a 0 column, +4 to include room for anchors (start-of-input, start-of-line, end-of-line, end-of-input) */
-      size_t num_columns = rex->dfa_.symbol_groups_ ? rex->dfa_.symbol_groups_->ordinal_ + 1 + 4 : 1;
-      size_t first_anchor_column = rex->dfa_.symbol_groups_->ordinal_ + 1;
-
-      size_t num_rows = rex->dfa_.nodes_->ordinal_ + 1;
-      size_t num_cells;
-      if (multiply_size_t(num_columns, num_rows, NULL, &num_cells)) {
-        /* Overflow */
-        re_error_nowhere("Error, overflow\n");
-        ip->had_error_ = 1;
-        goto cleanup_exit;
-      }
-      int *table = (int *)calloc(num_cells, sizeof(int));
-      if (!table) {
-        /* No memory */
-        re_error_nowhere("Error, no memory\n");
-        ip->had_error_ = 1;
-        goto cleanup_exit;
-      }
-      struct rex_dfa_node *dn = rex->dfa_.nodes_;
-      if (dn) {
-        do {
-          dn = dn->chain_;
-
-          int *row = table + num_columns * dn->ordinal_;
-
-          memset(row, 0, sizeof(int) * num_columns);
-
-          /* Loop over all transition groups from the current DFA node.
-           * XXX: Note, we loop over all, and filter. Inefficient. */
-          struct rex_dfa_trans_group *tg = rex->dfa_.trans_groups_;
-          if (tg) {
-            do {
-              tg = tg->sibling_;
-
-              if (tg->transitions_->from_ == dn) {
-                struct rex_selector *selector = tg->selectors_;
-                if (selector) {
-                  do {
-                    selector = selector->next_in_dfa_transition_group_;
-
-                    row[selector->symbol_group_->ordinal_] = tg->transitions_->to_->ordinal_;
-
-                  } while (selector != tg->selectors_);
-                }
-              }
-
-            } while (tg != rex->dfa_.trans_groups_);
-          }
-
-          struct rex_dfa_trans *dt = dn->outbound_;
-          size_t n;
-          for (n = 0; n < 4; ++n) {
-            /* Default is for anchor cells to aim to own state */
-            row[first_anchor_column + n] = dn->ordinal_;
-          }
-          if (dt) {
-            do {
-              dt = dt->from_peer_;
-
-              if (dt->is_anchor_) {
-                /* Actual anchor transitions point to other state, overwriting default.
-                 * See REX_ANCHOR_XXX constants for dt->symbol_start_ values (0..3) if is_anchor_*/
-                row[first_anchor_column + dt->symbol_start_] = dt->to_->ordinal_;
-              }
-
-            } while (dt != dn->outbound_);
-          }
-        } while (dn != rex->dfa_.nodes_);
-      }
-      ip_printf(ip, "static const int %sscan_table_grouped_rex_[] = {\n", cc_prefix(cc));
-      if (emit_table(ip, table, num_rows, num_columns)) {
-        ip->had_error_ = 1;
-        free(table);
-        goto cleanup_exit;
-      }
-      free(table);
-      ip_printf(ip, "};\n");
-      ip_printf(ip, "static const size_t %snum_scan_table_grouped_columns_ = %zu;\n", cc_prefix(cc), num_columns);
-
-      /* UTF-8 encoding map */
-      struct rex_scanner utf8_scanner;
-      rex_init(&utf8_scanner);
-
-      struct rex_mode *default_mode = NULL;
-      int r;
-      r = rex_add_mode(&utf8_scanner, &default_mode);
-      if (r) {
-        ip->had_error_ = 1;
-        rex_cleanup(&utf8_scanner);
-        goto cleanup_exit;
-      }
-
-      struct rex_symbol_group *sg =rex->dfa_.symbol_groups_;
-      if (sg) {
-        do {
-          sg = sg->chain_;
-
-          struct rex_pattern *pat = NULL;
-          
-          r = rex_alloc_pattern(&utf8_scanner, (uintptr_t)sg->ordinal_, &pat);
-          if (r) {
-            ip->had_error_ = 1;
-            rex_cleanup(&utf8_scanner);
-            goto cleanup_exit;
-          }
-          pat->nfa_begin_state_ = rex_nfa_make_node(&utf8_scanner.nfa_);
-          pat->nfa_final_state_ = rex_nfa_make_node(&utf8_scanner.nfa_);
-          if ((pat->nfa_begin_state_ == SIZE_MAX) || (pat->nfa_final_state_ == SIZE_MAX)) {
+      if (!cc->lazy_dfa_max_states_) {
+        size_t num_rows, num_columns;
+        int *table;
+        if (emit_scan_table_grouped(&rex->dfa_, &num_rows, &num_columns, &table)) {
+          ip->had_error_ = 1;
+          goto cleanup_exit;
+        }
+        if (cc->compact_scan_) {
+          int failed = emit_scan_compact_tables(ip, cc, table, num_rows, num_columns);
+          free(table);
+          if (failed) {
             ip->had_error_ = 1;
-            rex_cleanup(&utf8_scanner);
             goto cleanup_exit;
           }
-          utf8_scanner.nfa_.nfa_nodes_[pat->nfa_final_state_].pattern_matched_ = pat;
-          r = rex_add_pattern_to_mode(default_mode, pat);
-          if (r) {
+        }
+        else {
+          ip_printf(ip, "static const int %sscan_table_grouped_rex_[] = {\n", cc_prefix(cc));
+          if (emit_table(ip, table, num_rows, num_columns)) {
             ip->had_error_ = 1;
-            rex_cleanup(&utf8_scanner);
+            free(table);
             goto cleanup_exit;
           }
-
-          struct rex_symbol_range *sr = sg->ranges_;
-          if (sr) {
-            do {
-              sr = sr->chain_;
-
-              r = encode_utf8_range(&utf8_scanner, sr->symbol_start_, sr->symbol_end_ - 1, pat->nfa_begin_state_, pat->nfa_final_state_);
-              if (r) {
-                ip->had_error_ = 1;
-                rex_cleanup(&utf8_scanner);
-                goto cleanup_exit;
-              }
-
-            } while (sr != sg->ranges_);
-          }
-        } while (sg != rex->dfa_.symbol_groups_);
-      }
-
-      /* Catch-all symbol group #0 (entire unicode range) -- this distinguishes valid UTF-8 encodings from invalid ones. */
-      struct rex_pattern *pat = NULL;
-      r = rex_alloc_pattern(&utf8_scanner, 0, &pat);
-      if (r) {
-        ip->had_error_ = 1;
-        rex_cleanup(&utf8_scanner);
-        goto cleanup_exit;
-      }
-      pat->nfa_begin_state_ = rex_nfa_make_node(&utf8_scanner.nfa_);
-      pat->nfa_final_state_ = rex_nfa_make_node(&utf8_scanner.nfa_);
-      if ((pat->nfa_begin_state_ == SIZE_MAX) || (pat->nfa_final_state_ == SIZE_MAX)) {
-        ip->had_error_ = 1;
-        rex_cleanup(&utf8_scanner);
-        goto cleanup_exit;
-      }
-      utf8_scanner.nfa_.nfa_nodes_[pat->nfa_final_state_].pattern_matched_ = pat;
-      r = rex_add_pattern_to_mode(default_mode, pat);
-      if (r) {
-        ip->had_error_ = 1;
-        rex_cleanup(&utf8_scanner);
-        goto cleanup_exit;
-      }
-
-      r = encode_utf8_range(&utf8_scanner, 0x00, 0x10FFFF, pat->nfa_begin_state_, pat->nfa_final_state_);
-      if (r) {
-        ip->had_error_ = 1;
-        rex_cleanup(&utf8_scanner);
-        goto cleanup_exit;
-      }
-
-      r = rex_realize_modes(&utf8_scanner);
-      if (r) {
-        ip->had_error_ = 1;
-        rex_cleanup(&utf8_scanner);
-        goto cleanup_exit;
-      }
-
-      /* Renumber the ordinals for the DFA nodes. DFA nodes that have a matching pattern are not part of the final set (as the
-       * transition /to/ the DFA node is the moment the action is taken; for any UTF-8 codepoint there can only be a single
-       * match, there is no notion of a "longest" match.)
-       * Node number 0 is the starting node, it is never a destination as there are no cycles in the UTF-8 decoding DFA. A
-       * destination of 0 means the encoding under examination is invalid. */
-      dn = utf8_scanner.dfa_.nodes_;
-      /* ordinal 0 is for invalid encodings, 
-       * regular symbol groups start at 1. */
-      int ordinal = 1;
-      if (dn) {
-        do {
-          dn = dn->chain_;
-
-          if (dn == default_mode->dfa_node_) {
-            /* Start condition */
-            dn->ordinal_ = 0;
-          }
-          else if (!dn->pattern_matched_) {
-            dn->ordinal_ = ordinal++;
-          }
-          else {
-            /* DFA node with pattern match. These are not emitted */
-            dn->ordinal_ = INT_MIN;
-          }
-        } while (dn != utf8_scanner.dfa_.nodes_);
-      }
-
-      num_columns = 256;
-      num_rows = (size_t)ordinal;
-      num_cells = num_rows * num_columns;
-
-      if (multiply_size_t(num_rows, num_columns, NULL, &num_cells)) {
-        re_error_nowhere("Error, overflow\n");
-        ip->had_error_ = 1;
-        rex_cleanup(&utf8_scanner);
-        goto cleanup_exit;
-      }
-
-      table = (int *)calloc(num_cells, sizeof(int));
-      if (!table) {
-        re_error_nowhere("Error, no memory\n");
-        ip->had_error_ = 1;
-        rex_cleanup(&utf8_scanner);
-        goto cleanup_exit;
-      }
-      size_t cell_idx;
-      for (cell_idx = 0; cell_idx < num_cells; ++cell_idx) {
-        /* Default cell is -1, which equals an error transition (invalid encoding) */
-        /* Regular transitions start at -2 and go down. Two's complement ~cell will
-         * return 0 for errors, non-zero for appropriate transition (row 0 is the
-         * start row..) */
-        table[cell_idx] = ~0;
+          free(table);
+          ip_printf(ip, "};\n");
+          ip_printf(ip, "static const size_t %snum_scan_table_grouped_columns_ = %zu;\n", cc_prefix(cc), num_columns);
+        }
       }
-      dn = utf8_scanner.dfa_.nodes_;
-      if (dn) {
-        do {
-          dn = dn->chain_;
-
-          int *row = NULL;
 
-          if (dn == default_mode->dfa_node_) {
-            /* Start condition */
-            row = table;
-          }
-          else if (!dn->pattern_matched_) {
-            row = table + num_columns * (size_t)dn->ordinal_;
-          }
-          else {
-            /* DFA node with pattern match. These are not emitted */
-          }
-          if (row) {
-            struct rex_dfa_trans *dt = dn->outbound_;
-            if (dt) {
-              do {
-                dt = dt->from_peer_;
-                                
-                if (dt->to_->pattern_matched_) {
-                  uint32_t c;
-                  /* Completion of pattern dt->to_->pattern_matched_ */
-                  for (c = dt->symbol_start_; c < dt->symbol_end_; ++c) {
-                    row[c] = (int)dt->to_->pattern_matched_->action_;
-                  }
-                }
-                else {
-                  uint32_t c;
-                  /* Transition to state dt->to_. */
-                  for (c = dt->symbol_start_; c < dt->symbol_end_; ++c) {
-                    /* We bitwise-complement instead of negate the ordinal of the 
-                     * destination state. Thus, -1 is reserved for an erroneous encoding,
-                     * and -2 (0xFFFE) is the first valid destination state (~0xFFFE == 1),
-                     * note that destination state 0 (~0 == 0xFFFF), while the initial state,
-                     * can never be a destination state. */
-                    row[c] = ~dt->to_->ordinal_;
-                  }
-                }
-
-              } while (dt != dn->outbound_);
-            }
-          }
-        } while (dn != utf8_scanner.dfa_.nodes_);
+      /* UTF-8 encoding map */
+      int *utf8_decoder = cc->utf8_decoder_table_;
+      size_t utf8_decoder_num_rows = cc->utf8_decoder_num_rows_;
+      if (!utf8_decoder) {
+        if (emit_utf8_decoder_table(&rex->dfa_, &utf8_decoder_num_rows, &utf8_decoder)) {
+          ip->had_error_ = 1;
+          goto cleanup_exit;
+        }
       }
       ip_printf(ip, "static const int %sutf8_decoder_[] = {\n", cc_prefix(cc));
-      if (emit_table(ip, table, num_rows, num_columns)) {
+      int emit_failed = emit_table(ip, utf8_decoder, utf8_decoder_num_rows, 256);
+      if (utf8_decoder != cc->utf8_decoder_table_) free(utf8_decoder);
+      if (emit_failed) {
         ip->had_error_ = 1;
-        free(table);
-        rex_cleanup(&utf8_scanner);
         goto cleanup_exit;
       }
-      free(table);
       ip_printf(ip, "};\n");
-
-      rex_cleanup(&utf8_scanner);
     }
   }
 
-  if (prdg->num_patterns_ && !cc->utf8_experimental_) {
+  if (prdg->num_patterns_ && !cc->utf8_experimental_ && cc->compact_scan_) {
+    size_t num_rows;
+    int *table;
+    if (emit_scan_table_raw(&rex->dfa_, &num_rows, &table)) {
+      ip->had_error_ = 1;
+      goto cleanup_exit;
+    }
+    int failed = emit_scan_compact_tables(ip, cc, table, num_rows, 256 + 4);
+    free(table);
+    if (failed) {
+      ip->had_error_ = 1;
+      goto cleanup_exit;
+    }
+  }
+  else if (prdg->num_patterns_ && !cc->utf8_experimental_ && !cc->lazy_dfa_max_states_) {
     ip_printf(ip, "static const size_t %sscan_table_rex[] = {\n", cc_prefix(cc));
     size_t col;
     char column_widths[256 + 4] = {0};
@@ -6779,7 +8722,13 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
     ip_printf(ip, "};\n");
   }
 
-  if (prdg->num_patterns_) {
+  if (prdg->num_patterns_ && cc->lazy_dfa_max_states_) {
+    if (emit_scan_lazy_tables(ip, cc, rex)) {
+      ip->had_error_ = 1;
+      goto cleanup_exit;
+    }
+  }
+  else if (prdg->num_patterns_) {
     ip_printf(ip, "static const size_t %sscan_actions_rex[] = { ", cc_prefix(cc));
     ip_printf(ip, "0"); /* dummy state 0 action */
     struct rex_dfa_node *dn = rex->dfa_.nodes_;
@@ -6793,6 +8742,11 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
     }
     ip_printf(ip, " };\n");
 
+    if (cc->linear_scan_) {
+      /* Number of bytes needed for a bitset of all scan states (including the dummy state 0) */
+      size_t num_scan_states = rex->dfa_.nodes_ ? (size_t)rex->dfa_.nodes_->ordinal_ + 1 : 1;
+      ip_printf(ip, "static const size_t %sscan_memo_row_size_ = %zu;\n", cc_prefix(cc), (num_scan_states + 7) / 8);
+    }
   }
 
   size_t num_columns;
@@ -6861,14 +8815,18 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
   }
   ip_printf(ip, "};\n");
 
-  state_syms = (int *)malloc(sizeof(int) * (size_t)lalr->nr_states_);
-  if (!state_syms) {
+  if (cc->instrument_) {
+    emit_profile_counters(ip, cc, prdg, rex, lalr);
+  }
+
+  state_sym_ordinals = (int *)malloc(sizeof(int) * (size_t)lalr->nr_states_);
+  if (!state_sym_ordinals) {
     re_error_nowhere("Error, no memory");
     ip->had_error_ = 1;
     goto cleanup_exit;
   }
   for (row = 0; row < lalr->nr_states_; ++row) {
-    state_syms[row] = -1;
+    state_sym_ordinals[row] = -1;
   }
   for (row = 0; row < lalr->nr_states_; ++row) {
     for (col = 0; col < num_columns; ++col) {
@@ -6877,13 +8835,12 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
         /* We're shifting to a destination state. */
         int sym_shifting = ((int)col) + lalr->min_sym_;
         int state_shifting_to = action;
-        if (state_syms[state_shifting_to] != sym_shifting) {
-          if (state_syms[state_shifting_to] == -1) {
-            state_syms[state_shifting_to] = sym_shifting;
+        if (state_sym_ordinals[state_shifting_to] != sym_shifting) {
+          if (state_sym_ordinals[state_shifting_to] == -1) {
+            state_sym_ordinals[state_shifting_to] = sym_shifting;
           }
           else {
             re_error_nowhere("Inconsistent state entry: each state should be entered by 1 unique symbol");
-            free(state_syms);
             ip->had_error_ = 1;
             goto cleanup_exit;
           }
@@ -6891,6 +8848,11 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
       }
     }
   }
+  if (state_syms_index(&state_syms, cc, lalr, state_sym_ordinals)) {
+    re_error_nowhere("Error, no memory");
+    ip->had_error_ = 1;
+    goto cleanup_exit;
+  }
 
   if (cc->include_guard_) {
     ip_printf(ip, "\n#ifndef %s\n", cc->include_guard_);
@@ -6967,7 +8929,7 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
         }
         *s++ = '\0';
 
-        ip_printf(ip, "#define M_%s%s %d\n", cc_PREFIX(cc), ident, m->rex_mode_->dfa_node_->ordinal_);
+        ip_printf(ip, "#define M_%s%s %d\n", cc_PREFIX(cc), ident, mode_start_state(cc, m->rex_mode_));
         free(ident);
       } while (m != cc->modetab_.modes_);
     }
@@ -7051,6 +9013,22 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
     ip_printf(ip, "};\n\n");
   }
 
+  if (prdg->num_patterns_ && cc->linear_scan_) {
+    emit_scan_memo_functions(ip, cc);
+  }
+
+  if (prdg->num_patterns_ && cc->lazy_dfa_max_states_) {
+    emit_scan_lazy_functions(ip, cc);
+  }
+
+  if (prdg->num_patterns_ && cc->compact_scan_) {
+    emit_scan_compact_functions(ip, cc);
+  }
+
+  if (cc->segmented_stack_) {
+    emit_segmented_stack_functions(ip, cc);
+  }
+
   /* Emit stack constructor, destructor and reset functions */
   ip_printf(ip, "void %sstack_init(struct %sstack *stack) {\n", cc_prefix(cc), cc_prefix(cc));
   ip_printf(ip, "  stack->error_recovery_ = 0;\n"
@@ -7063,7 +9041,8 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
 
     ip_printf(ip, "  stack->input_ = NULL;\n"
                   "  stack->input_size_ = 0;\n"
-                  "  stack->is_final_input_ = 0;\n");
+                  "  stack->is_final_input_ = 0;\n"
+                  "  stack->input_in_place_ = 0;\n");
   }
   ip_printf(ip, "  stack->slot_1_has_sym_data_ = stack->slot_1_has_common_data_ = 0;\n"
                 "  stack->slot_1_sym_ = 0;\n");
@@ -7096,10 +9075,24 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
       ip_printf(ip, "  stack->sym_grp_ = 0;\n");
       ip_printf(ip, "  stack->cp_ = stack->codepoint_;\n");
     }
+    if (cc->lazy_dfa_max_states_) {
+      ip_printf(ip, "  stack->scan_lazy_ = NULL;\n");
+    }
+    if (cc->linear_scan_) {
+      ip_printf(ip, "  stack->scan_memo_ = NULL;\n"
+                    "  stack->scan_memo_skip_ = 0;\n"
+                    "  stack->scan_memo_num_rows_ = 0;\n"
+                    "  stack->scan_memo_num_rows_allocated_ = 0;\n"
+                    "  stack->scan_trail_ = NULL;\n"
+                    "  stack->scan_trail_size_ = 0;\n"
+                    "  stack->scan_trail_size_allocated_ = 0;\n");
+    }
     ip_printf(ip, "  stack->match_index_ = 0;\n"
                   "  stack->match_buffer_ = NULL;\n"
+                  "  stack->token_text_ = NULL;\n"
                   "  stack->match_buffer_size_ = 0;\n"
                   "  stack->match_buffer_size_allocated_ = 0;\n"
+                  "  stack->match_buffer_skip_ = 0;\n"
                   "  stack->terminator_repair_ = '\\0';\n"
                   "  stack->token_size_ = 0;\n"
                   "  stack->match_offset_ = 0;\n"
@@ -7119,14 +9112,27 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
   cc->continuation_enabled_ = 0;
   ip_printf(ip, "void %sstack_cleanup(struct %sstack *stack) {\n", cc_prefix(cc), cc_prefix(cc));
 
-  if (emit_stack_deconstruction(ip, cc, prdg, lalr, state_syms)) {
+  if (emit_stack_deconstruction(ip, cc, prdg, lalr, &state_syms)) {
     ip->had_error_ = 1;
     goto cleanup_exit;
   }
 
-  ip_printf(ip, "  if (stack->stack_) free(stack->stack_);\n");
+  if (cc->segmented_stack_) {
+    ip_printf(ip, "  %sfree_segmented_stack(stack);\n", cc_prefix(cc));
+  }
+  else {
+    ip_printf(ip, "  if (stack->stack_) free(stack->stack_);\n");
+  }
   if (prdg->num_patterns_) {
-    ip_printf(ip, "  if (stack->match_buffer_) free(stack->match_buffer_);\n");
+    emit_terminator_repair_in_place(ip, cc);
+    ip_printf(ip, "  if (stack->match_buffer_) free(stack->match_buffer_ - stack->match_buffer_skip_);\n");
+    if (cc->lazy_dfa_max_states_) {
+      ip_printf(ip, "  if (stack->scan_lazy_) %sscan_lazy_free(stack->scan_lazy_);\n", cc_prefix(cc));
+    }
+    if (cc->linear_scan_) {
+      ip_printf(ip, "  if (stack->scan_memo_) free(stack->scan_memo_);\n"
+                    "  if (stack->scan_trail_) free(stack->scan_trail_);\n");
+    }
   }
   ip_printf(ip, "}\n"
                 "\n");
@@ -7135,7 +9141,7 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
   ip_printf(ip, "  stack->pending_reset_ = 0;\n"
                 "  stack->discard_remaining_actions_ = 0;\n");
 
-  if (emit_stack_deconstruction(ip, cc, prdg, lalr, state_syms)) {
+  if (emit_stack_deconstruction(ip, cc, prdg, lalr, &state_syms)) {
     ip->had_error_ = 1;
     goto cleanup_exit;
   }
@@ -7171,12 +9177,18 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
   emit_stack_static_slots_init(ip, cc);
 
   if (prdg->num_patterns_) {
+    emit_terminator_repair_in_place(ip, cc);
     ip_printf(ip, "  stack->scan_state_ = stack->current_mode_start_state_;\n");
     ip_printf(ip, "  stack->input_offset_ = 0;\n"
                   "  stack->input_line_ = 1;\n"
                   "  stack->input_col_ = 1;\n"
                   "  stack->match_index_ = 0;\n"
+                  "  if (stack->match_buffer_skip_) {\n"
+                  "    stack->match_buffer_ -= stack->match_buffer_skip_;\n"
+                  "    stack->match_buffer_skip_ = 0;\n"
+                  "  }\n"
                   "  stack->match_buffer_size_ = 0;\n"
+                  "  stack->token_text_ = stack->match_buffer_;\n"
                   "  stack->terminator_repair_ = '\\0';\n"
                   "  stack->token_size_ = 0;\n"
                   "  stack->match_offset_ = 0;\n"
@@ -7191,6 +9203,10 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
       ip_printf(ip, "  stack->sym_grp_ = 0;\n"
                     "  stack->cp_ = stack->codepoint_;\n");
     }
+    if (cc->linear_scan_) {
+      ip_printf(ip, "  %sscan_memo_clear(stack);\n", cc_prefix(cc));
+      ip_printf(ip, "  stack->scan_trail_size_ = 0;\n");
+    }
   }
 
   ip_printf(ip, "  return 0;\n"
@@ -7209,7 +9225,7 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
     else {
       ip_printf(ip, "int %sstack_visit(struct %sstack *stack) {\n", cc_prefix(cc), cc_prefix(cc));
     }
-    if (emit_stack_visit(ip, cc, prdg, lalr, state_syms)) {
+    if (emit_stack_visit(ip, cc, prdg, lalr, &state_syms)) {
       ip->had_error_ = 1;
       goto cleanup_exit;
     }
@@ -7226,7 +9242,8 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
   ip_printf(ip, "\n");
   ip_printf(ip, "int %sstack_accepts(struct %sstack *stack, int sym) {\n", cc_prefix(cc), cc_prefix(cc));
   ip_printf(ip, "  if (!stack->pos_) return 0;\n");
-  ip_printf(ip, "  return 0 != %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1].state_ + (sym - %sminimum_sym)];", cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
+  ip_printf(ip, cc->segmented_stack_ ? "  return 0 != %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1]->state_ + (sym - %sminimum_sym)];"
+                                     : "  return 0 != %sparse_table[%snum_columns * stack->stack_[stack->pos_ - 1].state_ + (sym - %sminimum_sym)];", cc_prefix(cc), cc_prefix(cc), cc_prefix(cc));
   ip_printf(ip, "}\n");
   ip_printf(ip, "\n");
 
@@ -7246,11 +9263,11 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
     ip_printf(ip, "\n");
     emit_lex_function(ip, cc, prdg);
     ip_printf(ip, "\n");
-    emit_scan_function(ip, cc, prdg, lalr, state_syms);
+    emit_scan_function(ip, cc, prdg, lalr, &state_syms);
     ip_printf(ip, "\n");
   }
 
-  emit_parse_function(ip, cc, prdg, lalr, state_syms);
+  emit_parse_function(ip, cc, prdg, lalr, &state_syms);
 
   ip_printf(ip, "/* --------- END OF GENERATED CODE ------------ */\n");
 
@@ -7261,7 +9278,8 @@ void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, str
   ip_write_no_indent(ip, cc->epilogue_.original_, cc->epilogue_.num_original_);
 
 cleanup_exit:
-  if (state_syms) free(state_syms);
+  if (state_sym_ordinals) free(state_sym_ordinals);
+  state_syms_cleanup(&state_syms);
 }
 
 
@@ -7357,7 +9375,7 @@ void emit_h_file(struct indented_printer *ip, struct carburetta_context *cc, str
         }
         *s++ = '\0';
 
-        ip_printf(ip, "#define M_%s%s %d\n", cc_PREFIX(cc), ident, m->rex_mode_->dfa_node_->ordinal_);
+        ip_printf(ip, "#define M_%s%s %d\n", cc_PREFIX(cc), ident, mode_start_state(cc, m->rex_mode_));
         free(ident);
       } while (m != cc->modetab_.modes_);
     }
@@ -7393,10 +9411,14 @@ void emit_h_file(struct indented_printer *ip, struct carburetta_context *cc, str
 
   ip_printf(ip, "int %sstack_can_recover(struct %sstack *stack);\n", cc_prefix(cc), cc_prefix(cc));
   ip_printf(ip, "int %sstack_accepts(struct %sstack *stack, int sym);\n", cc_prefix(cc), cc_prefix(cc));
+  if (cc->instrument_) {
+    ip_printf(ip, "int %sprofile_write(const char *filename);\n", cc_prefix(cc));
+  }
   if (prdg->num_patterns_) {
     ip_printf(ip, "void %sset_mode(struct %sstack *stack, int mode);\n", cc_prefix(cc), cc_prefix(cc));
     ip_printf(ip, "int %smode(struct %sstack *stack);\n", cc_prefix(cc), cc_prefix(cc));
     ip_printf(ip, "void %sset_input(struct %sstack *stack, const char *input, size_t input_size, int is_final_input);\n", cc_prefix(cc), cc_prefix(cc));
+    ip_printf(ip, "void %sset_input_in_place(struct %sstack *stack, char *input, size_t input_size, int is_final_input);\n", cc_prefix(cc), cc_prefix(cc));
 
     if (cc->params_snippet_.num_tokens_) {
       ip_printf(ip, "int %sscan(struct %sstack *stack, ", cc_prefix(cc), cc_prefix(cc));
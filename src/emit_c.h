@@ -58,6 +58,23 @@ extern "C" {
 const char *cc_prefix(struct carburetta_context *cc);
 const char *cc_PREFIX(struct carburetta_context *cc);
 
+/* Builds the UTF-8 decoder table for the symbol groups of dfa, as used by the scanner in --x-utf8
+ * mode; the table has 256 columns, one for each byte value, and is returned in *ptable, to be
+ * freed by the caller. emit_c_file() builds this table itself unless it is already available
+ * in cc->utf8_decoder_table_. Returns 0 upon success, non-zero upon failure, in which case an
+ * error has been reported. */
+int emit_utf8_decoder_table(struct rex_dfa *dfa, size_t *pnum_rows, int **ptable);
+
+/* Builds the scanner transition table for dfa as used in --x-utf8 mode, a row for each DFA node
+ * (row 0 being the unused dead state) of a column for each symbol group, followed by the 4 anchor
+ * columns (start-of-input, start-of-line, end-of-line, end-of-input.) Returns 0 upon success,
+ * non-zero upon failure, in which case an error has been reported. */
+int emit_scan_table_grouped(struct rex_dfa *dfa, size_t *pnum_rows, size_t *pnum_columns, int **ptable);
+
+/* As emit_scan_table_grouped(), for --x-raw mode, with a column for each byte value instead of
+ * each symbol group, for 256 + 4 columns. */
+int emit_scan_table_raw(struct rex_dfa *dfa, size_t *pnum_rows, int **ptable);
+
 void emit_c_file(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg, struct rex_scanner *rex, struct lr_generator *lalr);
 void emit_h_file(struct indented_printer *ip, struct carburetta_context *cc, struct prd_grammar *prdg);
 
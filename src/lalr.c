@@ -1067,17 +1067,17 @@ int lr_add_conflict_resolution(struct lr_generator *gen,
   return 0;
 }
 
-lr_error_t lr_gen_parser(struct lr_generator *gen, int *productions,
-                         int end_of_production_sym, int end_of_grammar_sym,
-                         int end_of_file_sym, int synthetic_s_sym) {
+/* Sets up the productions and symbol ranges of gen from the productions passed in, this is the
+ * part of lr_gen_parser() that lr_load_parser() shares. */
+static lr_error_t lr_init_productions(struct lr_generator *gen, int *productions,
+                                      int end_of_production_sym, int end_of_grammar_sym,
+                                      int end_of_file_sym, int synthetic_s_sym) {
   int *pval = productions;
   int *plen;
   int **p1st;
   int min_nonterm, max_nonterm;
   int min_term, max_term;
   size_t prodix;
-  int found_nullable;
-  struct lr_state *initial_state;
 
   gen->eof_sym_ = end_of_file_sym;
   gen->eog_sym_ = end_of_grammar_sym;
@@ -1194,6 +1194,22 @@ lr_error_t lr_gen_parser(struct lr_generator *gen, int *productions,
     gen->max_sym_ = gen->highest_term_;
   }
 
+  return LR_OK;
+}
+
+lr_error_t lr_gen_parser(struct lr_generator *gen, int *productions,
+                         int end_of_production_sym, int end_of_grammar_sym,
+                         int end_of_file_sym, int synthetic_s_sym) {
+  size_t prodix;
+  int found_nullable;
+  struct lr_state *initial_state;
+  lr_error_t err;
+
+  err = lr_init_productions(gen, productions, end_of_production_sym, end_of_grammar_sym, end_of_file_sym, synthetic_s_sym);
+  if (err != LR_OK) {
+    return err;
+  }
+
   /* Determine which non-terminals are nullable */
   do {
     /* keep looking for nullable non-terminals as long as we find em. */
@@ -1285,3 +1301,117 @@ lr_error_t lr_gen_parser(struct lr_generator *gen, int *productions,
   return gen->conflicts_ ? LR_CONFLICTS : LR_OK;
 }
 
+
+lr_error_t lr_load_parser(struct lr_generator *gen, int *productions,
+                          int end_of_production_sym, int end_of_grammar_sym,
+                          int end_of_file_sym, int synthetic_s_sym,
+                          int nr_states, const int *parse_table, size_t num_parse_table_cells) {
+  lr_error_t err;
+  err = lr_init_productions(gen, productions, end_of_production_sym, end_of_grammar_sym, end_of_file_sym, synthetic_s_sym);
+  if (err != LR_OK) {
+    return err;
+  }
+
+  size_t num_columns = (size_t)(gen->max_sym_ - gen->min_sym_ + 1);
+  if ((nr_states <= 0) || ((num_parse_table_cells / num_columns) != (size_t)nr_states) || (num_parse_table_cells % num_columns)) {
+    /* Table does not fit the productions */
+    return LR_INTERNAL_ERROR;
+  }
+
+  int *table = (int *)malloc(sizeof(int) * num_parse_table_cells);
+  if (!table) {
+    return LR_INTERNAL_ERROR;
+  }
+  memcpy(table, parse_table, sizeof(int) * num_parse_table_cells);
+
+  free(gen->parse_table_);
+  gen->parse_table_ = table;
+  gen->nr_states_ = nr_states;
+
+  return LR_OK;
+}
+
+lr_error_t lr_renumber(struct lr_generator *gen, const int *rows, const int *terms) {
+  size_t num_columns = (size_t)(gen->max_sym_ - gen->min_sym_ + 1);
+  size_t num_rows = (size_t)gen->nr_states_;
+  size_t row, col;
+  lr_error_t err = LR_OK;
+  char *seen = NULL;
+  int *table = NULL;
+
+  /* Both maps must be permutations, with the initial state and the non-terminals kept in place */
+  seen = (char *)calloc((num_rows > num_columns) ? num_rows : num_columns, 1);
+  if (!seen) {
+    err = LR_INTERNAL_ERROR;
+    goto cleanup;
+  }
+  if (rows) {
+    for (row = 0; row < num_rows; ++row) {
+      int r = rows[row];
+      if ((r < 0) || ((size_t)r >= num_rows) || seen[r] || (!row && r)) {
+        err = LR_INTERNAL_ERROR;
+        goto cleanup;
+      }
+      seen[r] = 1;
+    }
+    memset(seen, 0, num_rows);
+  }
+  if (terms) {
+    for (col = 0; col < num_columns; ++col) {
+      int sym = gen->min_sym_ + (int)col;
+      int t = terms[col];
+      int is_term = (sym >= gen->lowest_term_) && (sym <= gen->highest_term_);
+      if (is_term ? ((t < gen->lowest_term_) || (t > gen->highest_term_) || seen[t - gen->min_sym_]) : (t != sym)) {
+        err = LR_INTERNAL_ERROR;
+        goto cleanup;
+      }
+      seen[t - gen->min_sym_] = 1;
+    }
+  }
+
+  table = (int *)malloc(sizeof(int) * num_rows * num_columns);
+  if (!table) {
+    err = LR_INTERNAL_ERROR;
+    goto cleanup;
+  }
+  for (row = 0; row < num_rows; ++row) {
+    size_t new_row = rows ? (size_t)rows[row] : row;
+    for (col = 0; col < num_columns; ++col) {
+      size_t new_col = terms ? (size_t)(terms[col] - gen->min_sym_) : col;
+      int action = gen->parse_table_[row * num_columns + col];
+      if (rows && (action > 0)) {
+        /* Shift or goto, to the state at its new row */
+        action = rows[action];
+      }
+      table[new_row * num_columns + new_col] = action;
+    }
+  }
+  free(gen->parse_table_);
+  gen->parse_table_ = table;
+  table = NULL;
+
+  if (terms) {
+    size_t prodix;
+    for (prodix = 0; prodix < gen->nr_productions_; ++prodix) {
+      int idx;
+      for (idx = 1; gen->productions_[prodix][idx] != gen->eop_sym_; ++idx) {
+        int sym = gen->productions_[prodix][idx];
+        if ((sym >= gen->min_sym_) && (sym <= gen->max_sym_)) {
+          gen->productions_[prodix][idx] = terms[sym - gen->min_sym_];
+        }
+      }
+    }
+    gen->eof_sym_ = terms[gen->eof_sym_ - gen->min_sym_];
+  }
+  if (rows) {
+    struct lr_state *s;
+    for (s = gen->states_; s; s = s->gen_chain_) {
+      s->row_ = rows[s->row_];
+    }
+  }
+
+cleanup:
+  if (seen) free(seen);
+  if (table) free(table);
+  return err;
+}
@@ -320,6 +320,42 @@ lr_error_t lr_gen_parser(struct lr_generator *gen, int *productions,
                          int end_of_production_sym, int end_of_grammar_sym,
                          int end_of_file_sym, int synthetic_s_sym);
 
+/* lr_load_parser
+ *
+ * Sets up gen as if lr_gen_parser() had generated the parse table passed in, for instance
+ * because it was generated earlier for the same productions and conflict resolutions and
+ * cached. The productions and symbols are as for lr_gen_parser(), nr_states and parse_table
+ * are the gen->nr_states_ and gen->parse_table_ from the earlier lr_gen_parser() run; the
+ * parse_table is copied. The LR(0) states and conflicts are not available after loading.
+ *
+ * Return values:
+ * LR_OK : The parser was succesfully loaded.
+ * LR_INTERNAL_ERROR : Failure to allocate memory, or num_parse_table_cells does not match
+ *                     nr_states rows for the range of symbols of the productions.
+ */
+lr_error_t lr_load_parser(struct lr_generator *gen, int *productions,
+                          int end_of_production_sym, int end_of_grammar_sym,
+                          int end_of_file_sym, int synthetic_s_sym,
+                          int nr_states, const int *parse_table, size_t num_parse_table_cells);
+
+/* lr_renumber
+ *
+ * Renumbers the states and terminals of a parser that was generated or loaded, for instance
+ * to place the rows and columns of the parse table that are used most often together.
+ * rows[r] is the new row of the state at row r, row 0 (the initial state) must remain 0.
+ * terms[s - gen->min_sym_] is the new ordinal of terminal s; terminals may only be exchanged
+ * for other terminals in the range gen->lowest_term_ to gen->highest_term_, all other
+ * symbols must map onto themselves. Either may be NULL to keep the current numbering. The
+ * parse table, the productions (and so the productions array passed in when generating) and
+ * the rows of the LR(0) states are updated, the remaining generator data is not.
+ *
+ * Return values:
+ * LR_OK : The parser was renumbered.
+ * LR_INTERNAL_ERROR : Failure to allocate memory, or a map that is not a permutation as
+ *                     described; the parser is unchanged.
+ */
+lr_error_t lr_renumber(struct lr_generator *gen, const int *rows, const int *terms);
+
 void lr_cleanup(struct lr_generator *gen);
 
 #ifdef __cplusplus
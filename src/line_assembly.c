@@ -80,6 +80,7 @@ typedef enum las_mlc_token {
 static struct sc_scanner g_las_lc_scanner_;
 static struct sc_scanner g_las_mlc_scanner_;
 
+#if defined(GENERATE_AND_DUMP_SCANNER_TABLES) || defined(VERIFY_GENERATED_SCANNER_TABLES)
 #if __GNUC__
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wmissing-braces"
@@ -104,6 +105,11 @@ ENUM_MLC_TOKENS
 #if __GNUC__
 #pragma GCC diagnostic pop
 #endif
+#endif
+
+#ifndef GENERATE_AND_DUMP_SCANNER_TABLES
+#include "line_assembly_generated_scanners.c"
+#endif
 
 
 int las_init(void) {
@@ -111,10 +117,29 @@ int las_init(void) {
   sc_scanner_init(&g_las_lc_scanner_);
   sc_scanner_init(&g_las_mlc_scanner_);
 
+#ifdef GENERATE_AND_DUMP_SCANNER_TABLES
   r = sc_scanner_compile(&g_las_lc_scanner_, LAS_LC_UNKNOWN, sizeof(g_las_lc_scanner_rules_) / sizeof(*g_las_lc_scanner_rules_), g_las_lc_scanner_rules_);
   if (r) return r;
 
   r = sc_scanner_compile(&g_las_mlc_scanner_, LAS_MLC_UNKNOWN, sizeof(g_las_mlc_scanner_rules_) / sizeof(*g_las_mlc_scanner_rules_), g_las_mlc_scanner_rules_);
+  if (r) return r;
+
+  struct sc_scanner *const scanners[] = { &g_las_lc_scanner_, &g_las_mlc_scanner_ };
+  const char *const scanner_ids[] = { "g_las_lc_compact_scanner_", "g_las_mlc_compact_scanner_" };
+  r = sc_scanners_write_c_file("src/line_assembly_generated_scanners.c", "las_init() in line_assembly.c", sizeof(scanners) / sizeof(*scanners), scanners, scanner_ids);
+#else
+#ifdef VERIFY_GENERATED_SCANNER_TABLES
+  r = sc_scanner_verify(&g_las_lc_compact_scanner_, "src/line_assembly_generated_scanners.c", LAS_LC_UNKNOWN, sizeof(g_las_lc_scanner_rules_) / sizeof(*g_las_lc_scanner_rules_), g_las_lc_scanner_rules_);
+  if (r) return r;
+
+  r = sc_scanner_verify(&g_las_mlc_compact_scanner_, "src/line_assembly_generated_scanners.c", LAS_MLC_UNKNOWN, sizeof(g_las_mlc_scanner_rules_) / sizeof(*g_las_mlc_scanner_rules_), g_las_mlc_scanner_rules_);
+  if (r) return r;
+#endif
+  r = sc_scanner_expand(&g_las_lc_scanner_, &g_las_lc_compact_scanner_);
+  if (r) return r;
+
+  r = sc_scanner_expand(&g_las_mlc_scanner_, &g_las_mlc_compact_scanner_);
+#endif
   return r;
 }
 
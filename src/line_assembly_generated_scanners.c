@@ -0,0 +1,95 @@
+/* Copyright 2020-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+ /** NOTE: This file is generated at las_init() in line_assembly.c by defining GENERATE_AND_DUMP_SCANNER_TABLES (see "make scanner-tables") **/
+static const uint8_t g_las_lc_compact_scanner_byte_classes_[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+static const uint16_t g_las_lc_compact_scanner_transitions_[] = {
+  0, 0, 0, 0,
+  0, 2, 3, 4,
+  0, 0, 0, 0,
+  0, 7, 0, 0,
+  0, 5, 6, 0,
+  0, 0, 0, 0,
+  0, 8, 0, 0,
+  0, 0, 0, 0,
+  0, 0, 0, 0
+};
+static const struct sc_action g_las_lc_compact_scanner_actions_[] = {
+  {0,0},
+  {0,0},
+  {1,1},
+  {0,0},
+  {0,0},
+  {2,2},
+  {0,0},
+  {1,1},
+  {2,2}
+};
+static const struct sc_compact_scanner g_las_lc_compact_scanner_ = { 9, 1, 0, 4, g_las_lc_compact_scanner_byte_classes_, g_las_lc_compact_scanner_transitions_, g_las_lc_compact_scanner_actions_ };
+static const uint8_t g_las_mlc_compact_scanner_byte_classes_[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+static const uint16_t g_las_mlc_compact_scanner_transitions_[] = {
+  0, 0, 0, 0, 0,
+  0, 2, 3, 0, 4,
+  0, 0, 0, 0, 0,
+  0, 7, 0, 0, 0,
+  0, 0, 0, 5, 6,
+  9, 10, 10, 11, 9,
+  8, 0, 8, 8, 8,
+  0, 0, 0, 0, 0,
+  8, 0, 8, 8, 8,
+  9, 10, 10, 11, 9,
+  9, 10, 10, 11, 9,
+  12, 13, 13, 14, 15,
+  9, 10, 10, 11, 9,
+  9, 10, 10, 11, 9,
+  12, 13, 13, 14, 0,
+  0, 0, 0, 0, 0
+};
+static const struct sc_action g_las_mlc_compact_scanner_actions_[] = {
+  {0,0},
+  {0,0},
+  {3,3},
+  {0,0},
+  {0,0},
+  {0,0},
+  {2,2},
+  {3,3},
+  {2,2},
+  {0,0},
+  {0,0},
+  {0,0},
+  {0,0},
+  {0,0},
+  {0,0},
+  {1,1}
+};
+static const struct sc_compact_scanner g_las_mlc_compact_scanner_ = { 16, 1, 0, 5, g_las_mlc_compact_scanner_byte_classes_, g_las_mlc_compact_scanner_transitions_, g_las_mlc_compact_scanner_actions_ };
@@ -43,6 +43,7 @@
 #include "line_defs.h"
 #endif
 
+#if defined(GENERATE_AND_DUMP_SCANNER_TABLES) || defined(VERIFY_GENERATED_SCANNER_TABLES)
 #if __GNUC__
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wmissing-braces"
@@ -59,9 +60,14 @@ ENUM_LINE_DEFS
 #if __GNUC__
 #pragma GCC diagnostic pop
 #endif
+#endif
 
 static struct sc_scanner g_ldl_scanner_;
 
+#ifndef GENERATE_AND_DUMP_SCANNER_TABLES
+#include "line_defs_generated_scanners.c"
+#endif
+
 const char *ld_line_type_to_str(ld_line_type_t ldlt) {
 #define xx(regex, type_of_line) case type_of_line: return #type_of_line;
 #define xz(type_of_line) case type_of_line: return #type_of_line;
@@ -77,7 +83,20 @@ const char *ld_line_type_to_str(ld_line_type_t ldlt) {
 int ldl_init(void) {
   sc_scanner_init(&g_ldl_scanner_);
   int r;
+#ifdef GENERATE_AND_DUMP_SCANNER_TABLES
   r = sc_scanner_compile(&g_ldl_scanner_, LD_UNKNOWN, sizeof(g_scanner_rules_) / sizeof(*g_scanner_rules_), g_scanner_rules_);
+  if (r) return r;
+
+  struct sc_scanner *const scanners[] = { &g_ldl_scanner_ };
+  const char *const scanner_ids[] = { "g_ldl_compact_scanner_" };
+  r = sc_scanners_write_c_file("src/line_defs_generated_scanners.c", "ldl_init() in line_defs.c", sizeof(scanners) / sizeof(*scanners), scanners, scanner_ids);
+#else
+#ifdef VERIFY_GENERATED_SCANNER_TABLES
+  r = sc_scanner_verify(&g_ldl_compact_scanner_, "src/line_defs_generated_scanners.c", LD_UNKNOWN, sizeof(g_scanner_rules_) / sizeof(*g_scanner_rules_), g_scanner_rules_);
+  if (r) return r;
+#endif
+  r = sc_scanner_expand(&g_ldl_scanner_, &g_ldl_compact_scanner_);
+#endif
   return r;
 }
 
@@ -0,0 +1,116 @@
+/* Copyright 2020-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+ /** NOTE: This file is generated at ldl_init() in line_defs.c by defining GENERATE_AND_DUMP_SCANNER_TABLES (see "make scanner-tables") **/
+static const uint8_t g_ldl_compact_scanner_byte_classes_[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  1, 0, 0, 3, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 5, 0, 6, 7, 8, 0, 9, 10, 0, 0, 0, 0, 11, 12, 0, 0, 0, 13, 14, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+static const uint16_t g_ldl_compact_scanner_transitions_[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  2, 3, 4, 5, 6, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+  2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+  2, 3, 4, 5, 6, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  13, 13, 14, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+  7, 7, 8, 7, 9, 7, 7, 7, 7, 10, 11, 7, 7, 7, 12,
+  7, 7, 8, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  7, 18, 19, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 8, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 17, 7,
+  7, 7, 8, 7, 7, 7, 7, 7, 16, 7, 7, 7, 7, 7, 7,
+  7, 7, 8, 7, 7, 7, 15, 7, 7, 7, 7, 7, 7, 7, 7,
+  13, 13, 14, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  7, 7, 8, 7, 7, 22, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 8, 7, 7, 21, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 8, 7, 7, 20, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 18, 19, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  7, 7, 8, 7, 7, 7, 7, 7, 7, 7, 7, 25, 7, 7, 7,
+  7, 7, 8, 7, 7, 7, 7, 24, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 8, 7, 7, 7, 7, 7, 7, 7, 7, 7, 23, 7, 7,
+  7, 7, 8, 7, 7, 7, 7, 7, 7, 7, 7, 7, 28, 7, 7,
+  7, 7, 8, 7, 7, 7, 7, 7, 27, 7, 7, 7, 7, 7, 7,
+  7, 7, 8, 7, 7, 7, 7, 7, 7, 7, 7, 26, 7, 7, 7,
+  7, 7, 8, 7, 7, 31, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 8, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 30, 7,
+  7, 7, 8, 7, 7, 7, 7, 7, 29, 7, 7, 7, 7, 7, 7,
+  7, 7, 8, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 34, 7,
+  7, 7, 8, 7, 33, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 8, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 32, 7,
+  7, 7, 8, 7, 38, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 36, 37, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 8, 7, 35, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 41, 42, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 36, 37, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  7, 39, 40, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 39, 40, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  7, 41, 42, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+static const struct sc_action g_ldl_compact_scanner_actions_[] = {
+  {0,0},
+  {7,7},
+  {7,7},
+  {7,7},
+  {7,7},
+  {1,1},
+  {6,6},
+  {6,6},
+  {6,6},
+  {5,5},
+  {6,6},
+  {6,6},
+  {6,6},
+  {1,1},
+  {1,1},
+  {6,6},
+  {6,6},
+  {6,6},
+  {5,5},
+  {5,5},
+  {6,6},
+  {6,6},
+  {6,6},
+  {6,6},
+  {6,6},
+  {6,6},
+  {6,6},
+  {6,6},
+  {6,6},
+  {6,6},
+  {6,6},
+  {6,6},
+  {6,6},
+  {4,4},
+  {6,6},
+  {2,2},
+  {4,4},
+  {4,4},
+  {3,3},
+  {3,3},
+  {3,3},
+  {2,2},
+  {2,2}
+};
+static const struct sc_compact_scanner g_ldl_compact_scanner_ = { 43, 1, 0, 15, g_ldl_compact_scanner_byte_classes_, g_ldl_compact_scanner_transitions_, g_ldl_compact_scanner_actions_ };
@@ -46,7 +46,9 @@
 
 
 void mode_table_init(struct mode_table *mt) {
-  memset(mt->mode_table_, 0, sizeof(mt->mode_table_));
+  mt->num_buckets_ = 0;
+  mt->num_modes_ = 0;
+  mt->mode_table_ = NULL;
   mt->modes_ = NULL;
 }
 
@@ -65,6 +67,9 @@ void mode_table_cleanup(struct mode_table *mt) {
     } while (m != mt->modes_);
     mt->modes_ = NULL;
   }
+  if (mt->mode_table_) free(mt->mode_table_);
+  mt->mode_table_ = NULL;
+  mt->num_buckets_ = mt->num_modes_ = 0;
 }
 
 
@@ -86,7 +91,7 @@ static uint8_t mode_standardize_char(uint8_t c) {
   return c;
 }
 
-static int mode_hash(const char *id) {
+static uint64_t mode_hash(const char *id) {
   uint64_t hash_value = 0;
   while (*id) {
     uint8_t c = mode_standardize_char(*(uint8_t *)id);
@@ -95,7 +100,38 @@ static int mode_hash(const char *id) {
     hash_value += c;
     id++;
   }
-  return (int)(hash_value % MODE_TABLE_SIZE);
+  return hash_value;
+}
+
+static void mode_hash_insert(struct mode **mode_table, size_t num_buckets, struct mode *m) {
+  size_t idx = (size_t)(mode_hash(m->def_.translated_) % num_buckets);
+  struct mode *last = mode_table[idx];
+  if (last) {
+    m->hash_chain_ = last->hash_chain_;
+    last->hash_chain_ = m;
+  }
+  else {
+    m->hash_chain_ = m;
+  }
+  mode_table[idx] = m;
+}
+
+/* Rehashes all modes into a table of num_buckets buckets, returns 0 upon success, non-zero upon
+ * memory failure, in which case the existing table is left as-is. */
+static int mode_rehash(struct mode_table *mt, size_t num_buckets) {
+  struct mode **mode_table = (struct mode **)calloc(num_buckets, sizeof(struct mode *));
+  if (!mode_table) return -1;
+  struct mode *m = mt->modes_;
+  if (m) {
+    do {
+      m = m->next_;
+      mode_hash_insert(mode_table, num_buckets, m);
+    } while (m != mt->modes_);
+  }
+  if (mt->mode_table_) free(mt->mode_table_);
+  mt->mode_table_ = mode_table;
+  mt->num_buckets_ = num_buckets;
+  return 0;
 }
 
 static int mode_cmp(const char *left, const char *right) {
@@ -118,19 +154,17 @@ static int mode_cmp(const char *left, const char *right) {
 
 
 struct mode *mode_find_or_add(struct mode_table *mt, struct xlts *id, int *is_new) {
-  int idx = mode_hash(id->translated_);
-  struct mode *m, *last;
-  m = last = mt->mode_table_[idx];
+  struct mode *m;
+  m = mode_find(mt, id->translated_);
   if (m) {
-    do {
-      m = m->hash_chain_;
-
-      if (!mode_cmp(m->def_.translated_, id->translated_)) {
-        *is_new = 0;
-        return m;
-      }
+    *is_new = 0;
+    return m;
+  }
 
-    } while (m != last);
+  if (mt->num_modes_ >= mt->num_buckets_) {
+    if (mode_rehash(mt, mt->num_buckets_ ? mt->num_buckets_ * 2 + 1 : MODE_TABLE_SIZE)) {
+      return NULL;
+    }
   }
 
   m = (struct mode *)malloc(sizeof(struct mode));
@@ -138,14 +172,6 @@ struct mode *mode_find_or_add(struct mode_table *mt, struct xlts *id, int *is_ne
     return NULL;
   }
   mode_init(m);
-  if (last) {
-    m->hash_chain_ = last->hash_chain_;
-    last->hash_chain_ = m;
-  }
-  else {
-    m->hash_chain_ = m;
-  }
-  mt->mode_table_[idx] = m;
 
   if (mt->modes_) {
     m->next_ = mt->modes_->next_;
@@ -157,13 +183,16 @@ struct mode *mode_find_or_add(struct mode_table *mt, struct xlts *id, int *is_ne
   mt->modes_ = m;
 
   xlts_append(&m->def_, id);
+  mode_hash_insert(mt->mode_table_, mt->num_buckets_, m);
+  mt->num_modes_++;
 
   *is_new = 1;
   return m;
 }
 
 struct mode *mode_find(struct mode_table *mt, const char *id) {
-  int idx = mode_hash(id);
+  if (!mt->num_buckets_) return NULL;
+  size_t idx = (size_t)(mode_hash(id) % mt->num_buckets_);
   struct mode *m, *last;
   m = last = mt->mode_table_[idx];
   if (m) {
@@ -25,6 +25,7 @@
 extern "C" {
 #endif
 
+/* Initial number of hash buckets, the table grows as modes are added */
 #define MODE_TABLE_SIZE 31
 
 struct rex_mode;
@@ -45,7 +46,11 @@ struct mode {
 };
 
 struct mode_table {
-  struct mode *mode_table_[MODE_TABLE_SIZE];
+  /* Each bucket points to the last mode in its circular hash_chain_, the table is allocated upon
+   * the first mode added, and grows to keep the number of modes below the number of buckets. */
+  size_t num_buckets_;
+  size_t num_modes_;
+  struct mode **mode_table_;
   struct mode *modes_;
 };
 
@@ -1309,7 +1309,8 @@ static int pi_process_scanner_tokens(struct tkr_tokenizer *tkr_tokens, struct xl
 }
 
 
-int pi_parse_input(FILE *fp, const char *input_filename, struct carburetta_context *cc, struct prd_grammar *prdg) {
+/* Reads the input from fp if fp is non-NULL, otherwise from the input_size bytes at input */
+static int pi_parse(FILE *fp, const char *input, size_t input_size, const char *input_filename, struct carburetta_context *cc, struct prd_grammar *prdg) {
   int r;
 
   struct las_line_assembly line_assembly;
@@ -1361,15 +1362,26 @@ int pi_parse_input(FILE *fp, const char *input_filename, struct carburetta_conte
   default_mode = UNDEFINED;
 
   size_t num_bytes_read;
-  static char buf[2400];
+  char buf[2400];
+  const char *chunk;
 
   int have_error;
   have_error = 0;
 
   do {
-    num_bytes_read = fread(buf, sizeof(*buf), sizeof(buf) / sizeof(*buf), fp);
+    if (fp) {
+      num_bytes_read = fread(buf, sizeof(*buf), sizeof(buf) / sizeof(*buf), fp);
+      chunk = buf;
+    }
+    else {
+      /* Feed the buffer in the same size chunks as a file would be */
+      num_bytes_read = (input_size < sizeof(buf)) ? input_size : sizeof(buf);
+      chunk = input;
+      input += num_bytes_read;
+      input_size -= num_bytes_read;
+    }
 
-    r = las_input(&line_assembly, buf, num_bytes_read, !num_bytes_read);
+    r = las_input(&line_assembly, chunk, num_bytes_read, !num_bytes_read);
     while ((r != LAS_END_OF_INPUT) && (r != LAS_FEED_ME)) {
       /* Cannot modify (shift) the line_assembly's mlc_buf line buffer, so copy it over to a work area (token_buf) */
       xlts_reset(&token_buf);
@@ -1648,7 +1660,7 @@ int pi_parse_input(FILE *fp, const char *input_filename, struct carburetta_conte
         goto cleanup_exit;
       }
 
-      r = las_input(&line_assembly, buf, num_bytes_read, !num_bytes_read);
+      r = las_input(&line_assembly, chunk, num_bytes_read, !num_bytes_read);
     }
 
   } while (num_bytes_read);
@@ -1685,3 +1697,11 @@ cleanup_exit:
 
   return r;
 }
+
+int pi_parse_input(FILE *fp, const char *input_filename, struct carburetta_context *cc, struct prd_grammar *prdg) {
+  return pi_parse(fp, NULL, 0, input_filename, cc, prdg);
+}
+
+int pi_parse_input_buffer(const char *input, size_t input_size, const char *input_filename, struct carburetta_context *cc, struct prd_grammar *prdg) {
+  return pi_parse(NULL, input, input_size, input_filename, cc, prdg);
+}
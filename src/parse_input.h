@@ -27,6 +27,9 @@ extern "C" {
 
 int pi_parse_input(FILE *fp, const char *input_filename, struct carburetta_context *cc, struct prd_grammar *prdg);
 
+/* As pi_parse_input(), with the input_size bytes at input as the input */
+int pi_parse_input_buffer(const char *input, size_t input_size, const char *input_filename, struct carburetta_context *cc, struct prd_grammar *prdg);
+
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -0,0 +1,355 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STDLIB_H_INCLUDED
+#define STDLIB_H_INCLUDED
+#include <stdlib.h>
+#endif
+
+#ifndef STDIO_H_INCLUDED
+#define STDIO_H_INCLUDED
+#include <stdio.h>
+#endif
+
+#ifndef STRING_H_INCLUDED
+#define STRING_H_INCLUDED
+#include <string.h>
+#endif
+
+#ifndef ERRNO_H_INCLUDED
+#define ERRNO_H_INCLUDED
+#include <errno.h>
+#endif
+
+#ifndef REPORT_ERROR_H_INCLUDED
+#define REPORT_ERROR_H_INCLUDED
+#include "report_error.h"
+#endif
+
+#ifndef REX_H_INCLUDED
+#define REX_H_INCLUDED
+#include "rex.h"
+#endif
+
+#ifndef LALR_H_INCLUDED
+#define LALR_H_INCLUDED
+#include "lalr.h"
+#endif
+
+#ifndef SYMBOL_H_INCLUDED
+#define SYMBOL_H_INCLUDED
+#include "symbol.h"
+#endif
+
+#ifndef CARBURETTA_CONTEXT_H_INCLUDED
+#define CARBURETTA_CONTEXT_H_INCLUDED
+#include "carburetta_context.h"
+#endif
+
+#ifndef PROFILE_H_INCLUDED
+#define PROFILE_H_INCLUDED
+#include "profile.h"
+#endif
+
+static void prof_counts_init(struct prof_counts *pc) {
+  pc->have_size_ = 0;
+  pc->num_counts_ = 0;
+  pc->counts_ = NULL;
+}
+
+static void prof_counts_cleanup(struct prof_counts *pc) {
+  if (pc->counts_) free(pc->counts_);
+}
+
+void prof_init(struct prof_profile *prof) {
+  prof_counts_init(&prof->scan_states_);
+  prof_counts_init(&prof->scan_columns_);
+  prof_counts_init(&prof->parse_states_);
+  prof_counts_init(&prof->parse_columns_);
+}
+
+void prof_cleanup(struct prof_profile *prof) {
+  prof_counts_cleanup(&prof->scan_states_);
+  prof_counts_cleanup(&prof->scan_columns_);
+  prof_counts_cleanup(&prof->parse_states_);
+  prof_counts_cleanup(&prof->parse_columns_);
+}
+
+/* Parses the unsigned decimal number at *pp, skipping the spaces before it. Returns 0 upon success. */
+static int prof_parse_number(const char **pp, uint64_t *value) {
+  const char *p = *pp;
+  uint64_t v = 0;
+  while ((*p == ' ') || (*p == '\t')) p++;
+  if ((*p < '0') || (*p > '9')) return -1;
+  while ((*p >= '0') && (*p <= '9')) {
+    if (v > ((UINT64_MAX - (uint64_t)(*p - '0')) / 10)) return -1;
+    v = v * 10 + (uint64_t)(*p - '0');
+    p++;
+  }
+  *pp = p;
+  *value = v;
+  return 0;
+}
+
+int prof_load(struct prof_profile *prof, const char *filename) {
+  static const char *size_keywords[] = { "scan-states", "scan-columns", "parse-states", "parse-columns" };
+  static const char *count_keywords[] = { "scan-state", "scan-column", "parse-state", "parse-column" };
+  struct prof_counts *sections[] = { &prof->scan_states_, &prof->scan_columns_, &prof->parse_states_, &prof->parse_columns_ };
+  char line[256];
+  int line_num = 0;
+  int have_version = 0;
+  int r = -1;
+  FILE *fp;
+
+  fp = fopen(filename, "r");
+  if (!fp) {
+    int err = errno;
+    re_error_nowhere("Error: failed to open profile \"%s\": %s", filename, strerror(err));
+    return -1;
+  }
+  while (fgets(line, sizeof(line), fp)) {
+    size_t len = strlen(line);
+    line_num++;
+    if (len && (line[len - 1] == '\n')) line[--len] = '\0';
+    else if (!feof(fp)) {
+      re_error_flc(filename, line_num, 1, "Error: line too long");
+      goto cleanup_exit;
+    }
+    if (len && (line[len - 1] == '\r')) line[--len] = '\0';
+    if (!len || (line[0] == '#')) continue;
+
+    const char *p = line;
+    size_t keyword_len = strcspn(line, " \t");
+    uint64_t index, value;
+    int malformed = 0;
+    size_t n;
+    p += keyword_len;
+
+    if ((keyword_len == strlen("carburetta-profile")) && !memcmp(line, "carburetta-profile", keyword_len)) {
+      if (prof_parse_number(&p, &value) || (value != PROF_VERSION)) {
+        re_error_flc(filename, line_num, 1, "Error: not a version %d profile", PROF_VERSION);
+        goto cleanup_exit;
+      }
+      have_version = 1;
+      continue;
+    }
+    if (!have_version) {
+      re_error_flc(filename, line_num, 1, "Error: not a profile, expected \"carburetta-profile %d\"", PROF_VERSION);
+      goto cleanup_exit;
+    }
+
+    for (n = 0; n < sizeof(sections) / sizeof(*sections); ++n) {
+      struct prof_counts *pc = sections[n];
+      if ((keyword_len == strlen(size_keywords[n])) && !memcmp(line, size_keywords[n], keyword_len)) {
+        if (prof_parse_number(&p, &value) || (value > (SIZE_MAX / sizeof(uint64_t)))) {
+          malformed = 1;
+          break;
+        }
+        if (pc->have_size_) {
+          /* Concatenated profiles must agree */
+          if (pc->num_counts_ != (size_t)value) {
+            re_error_flc(filename, line_num, 1, "Error: %s does not match its earlier value %zu", size_keywords[n], pc->num_counts_);
+            goto cleanup_exit;
+          }
+        }
+        else {
+          pc->counts_ = (uint64_t *)calloc(value ? (size_t)value : 1, sizeof(uint64_t));
+          if (!pc->counts_) {
+            re_error_nowhere("Error: no memory");
+            goto cleanup_exit;
+          }
+          pc->num_counts_ = (size_t)value;
+          pc->have_size_ = 1;
+        }
+        break;
+      }
+      if ((keyword_len == strlen(count_keywords[n])) && !memcmp(line, count_keywords[n], keyword_len)) {
+        if (prof_parse_number(&p, &index) || prof_parse_number(&p, &value)) {
+          malformed = 1;
+          break;
+        }
+        if (!pc->have_size_ || (index >= pc->num_counts_)) {
+          re_error_flc(filename, line_num, 1, "Error: %s %llu is out of range, or not preceded by %s", count_keywords[n], (unsigned long long)index, size_keywords[n]);
+          goto cleanup_exit;
+        }
+        pc->counts_[index] = (value > (UINT64_MAX - pc->counts_[index])) ? UINT64_MAX : pc->counts_[index] + value;
+        break;
+      }
+    }
+    if (n == sizeof(sections) / sizeof(*sections)) {
+      re_error_flc(filename, line_num, 1, "Error: unknown keyword");
+      goto cleanup_exit;
+    }
+    if (malformed || *p) {
+      re_error_flc(filename, line_num, 1, "Error: malformed line");
+      goto cleanup_exit;
+    }
+  }
+  if (ferror(fp)) {
+    int err = errno;
+    re_error_nowhere("Error: failed to read profile \"%s\": %s", filename, strerror(err));
+    goto cleanup_exit;
+  }
+  if (!have_version) {
+    re_error_nowhere("Error: profile \"%s\" is empty", filename);
+    goto cleanup_exit;
+  }
+
+  r = 0;
+cleanup_exit:
+  fclose(fp);
+  return r;
+}
+
+struct prof_rank {
+  uint64_t count_;
+  size_t index_;
+};
+
+static int prof_rank_cmp(const void *left, const void *right) {
+  const struct prof_rank *a = (const struct prof_rank *)left;
+  const struct prof_rank *b = (const struct prof_rank *)right;
+  /* Most visited first, ties stay in the order they were constructed */
+  if (a->count_ != b->count_) return (a->count_ > b->count_) ? -1 : 1;
+  return (a->index_ < b->index_) ? -1 : ((a->index_ > b->index_) ? 1 : 0);
+}
+
+/* Fills in map[n] with the new number of n, for all n less than num; those from begin up to end are
+ * ordered by their counts, the others keep their number. Returns 0 upon success. */
+static int prof_order(const uint64_t *counts, size_t begin, size_t end, size_t num, int *map) {
+  size_t n;
+  struct prof_rank *ranks = (struct prof_rank *)malloc(sizeof(struct prof_rank) * ((end > begin) ? end - begin : 1));
+  if (!ranks) {
+    re_error_nowhere("Error: no memory");
+    return -1;
+  }
+  for (n = 0; n < num; ++n) {
+    map[n] = (int)n;
+  }
+  for (n = begin; n < end; ++n) {
+    ranks[n - begin].count_ = counts[n];
+    ranks[n - begin].index_ = n;
+  }
+  qsort(ranks, end - begin, sizeof(struct prof_rank), prof_rank_cmp);
+  for (n = begin; n < end; ++n) {
+    map[ranks[n - begin].index_] = (int)n;
+  }
+  free(ranks);
+  return 0;
+}
+
+/* Returns non-zero if the counts fit a table dimension of num, warns if not */
+static int prof_fits(const struct carburetta_context *cc, const struct prof_counts *pc, size_t num, const char *what) {
+  if (!pc->have_size_) return 0;
+  if (pc->num_counts_ == num) return 1;
+  re_error_nowhere("Warning: profile \"%s\" has %zu %s where the grammar has %zu, not reordering them (the grammar changed since the profile was collected?)",
+                   cc->profile_filename_, pc->num_counts_, what, num);
+  return 0;
+}
+
+int prof_apply(struct prof_profile *prof, struct carburetta_context *cc, struct rex_scanner *rex, struct lr_generator *lalr) {
+  int *symbol_group_ordinals = NULL;
+  int *rows = NULL;
+  int *columns = NULL;
+  int *terms = NULL;
+  int r = -1;
+  size_t n;
+
+  size_t num_scan_states = rex->dfa_.nodes_ ? (size_t)rex->dfa_.nodes_->ordinal_ + 1 : 0;
+  size_t num_scan_columns = (cc->utf8_experimental_ && rex->dfa_.symbol_groups_) ? (size_t)rex->dfa_.symbol_groups_->ordinal_ + 1 : 0;
+  size_t num_parse_states = (size_t)lalr->nr_states_;
+  size_t num_parse_columns = (size_t)(lalr->max_sym_ - lalr->min_sym_ + 1);
+
+  if (num_scan_states && prof_fits(cc, &prof->scan_states_, num_scan_states, "scan states")) {
+    /* Ordered by their counts within the states of each mode, so the modes stay partitioned */
+    if (rex_dfa_partition_modes(rex, prof->scan_states_.counts_)) {
+      re_error_nowhere("Internal error, failed to renumber the scanner");
+      goto cleanup_exit;
+    }
+  }
+  if (num_scan_columns && prof_fits(cc, &prof->scan_columns_, num_scan_columns, "scan columns")) {
+    symbol_group_ordinals = (int *)malloc(sizeof(int) * num_scan_columns);
+    if (!symbol_group_ordinals) {
+      re_error_nowhere("Error: no memory");
+      goto cleanup_exit;
+    }
+    if (prof_order(prof->scan_columns_.counts_, 1, num_scan_columns, num_scan_columns, symbol_group_ordinals)) goto cleanup_exit;
+  }
+  if (symbol_group_ordinals) {
+    if (rex_dfa_renumber(&rex->dfa_, NULL, symbol_group_ordinals)) {
+      re_error_nowhere("Internal error, failed to renumber the scanner");
+      goto cleanup_exit;
+    }
+    if (cc->utf8_decoder_table_) {
+      /* Decodes to the symbol groups as they were numbered, the emitter builds it anew */
+      free(cc->utf8_decoder_table_);
+      cc->utf8_decoder_table_ = NULL;
+      cc->utf8_decoder_num_rows_ = 0;
+    }
+  }
+
+  if (prof_fits(cc, &prof->parse_states_, num_parse_states, "parse states")) {
+    rows = (int *)malloc(sizeof(int) * num_parse_states);
+    if (!rows) {
+      re_error_nowhere("Error: no memory");
+      goto cleanup_exit;
+    }
+    if (prof_order(prof->parse_states_.counts_, 1, num_parse_states, num_parse_states, rows)) goto cleanup_exit;
+  }
+  if (prof_fits(cc, &prof->parse_columns_, num_parse_columns, "parse columns")) {
+    /* Only the terminals are reordered, the non-terminals and the range of each stay as they are */
+    columns = (int *)malloc(sizeof(int) * num_parse_columns);
+    terms = (int *)malloc(sizeof(int) * num_parse_columns);
+    if (!columns || !terms) {
+      re_error_nowhere("Error: no memory");
+      goto cleanup_exit;
+    }
+    if (prof_order(prof->parse_columns_.counts_, (size_t)(lalr->lowest_term_ - lalr->min_sym_), (size_t)(lalr->highest_term_ - lalr->min_sym_ + 1), num_parse_columns, columns)) goto cleanup_exit;
+    for (n = 0; n < num_parse_columns; ++n) {
+      terms[n] = lalr->min_sym_ + columns[n];
+    }
+  }
+  if (rows || terms) {
+    if (lr_renumber(lalr, rows, terms)) {
+      re_error_nowhere("Internal error, failed to renumber the parser");
+      goto cleanup_exit;
+    }
+  }
+  if (terms) {
+    struct symbol *sym = cc->symtab_.terminals_;
+    if (sym) {
+      do {
+        sym = sym->next_;
+
+        if ((sym->ordinal_ >= lalr->lowest_term_) && (sym->ordinal_ <= lalr->highest_term_)) {
+          sym->ordinal_ = terms[sym->ordinal_ - lalr->min_sym_];
+        }
+
+      } while (sym != cc->symtab_.terminals_);
+    }
+    if (symbol_table_index_ordinals(&cc->symtab_)) {
+      re_error_nowhere("Error: no memory");
+      goto cleanup_exit;
+    }
+  }
+
+  r = 0;
+cleanup_exit:
+  if (symbol_group_ordinals) free(symbol_group_ordinals);
+  if (rows) free(rows);
+  if (columns) free(columns);
+  if (terms) free(terms);
+  return r;
+}
@@ -0,0 +1,88 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#ifndef STDDEF_H_INCLUDED
+#define STDDEF_H_INCLUDED
+#include <stddef.h>
+#endif
+
+#ifndef STDINT_H_INCLUDED
+#define STDINT_H_INCLUDED
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct carburetta_context;
+struct rex_scanner;
+struct lr_generator;
+
+/* Profiles are written by parsers generated with --instrument and read back with --profile, to
+ * renumber the scanner and parse tables so the rows and columns used most are placed together.
+ *
+ * A profile is a text file, each line holds a keyword followed by numbers:
+ *   carburetta-profile 1       version of the format
+ *   scan-states <n>            number of rows of the scan table, including the dead state 0
+ *   scan-columns <n>           number of symbol group columns (UTF-8 scanners only)
+ *   parse-states <n>           number of rows of the parse table
+ *   parse-columns <n>          number of columns of the parse table
+ *   scan-state <i> <count>     number of transitions taken from scan state i
+ *   scan-column <i> <count>    number of transitions taken on symbol group i
+ *   parse-state <i> <count>    number of lookups in row i of the parse table
+ *   parse-column <i> <count>   number of lookups in column i of the parse table
+ * States and columns are numbered as constructed, so profiles must be collected from a parser that
+ * was itself generated without --profile. Counts appearing more than once are added, so profiles of
+ * several runs can be concatenated. Empty lines and lines starting with # are ignored. */
+
+#define PROF_VERSION 1
+
+struct prof_counts {
+  int have_size_:1;
+  size_t num_counts_;
+  uint64_t *counts_;
+};
+
+struct prof_profile {
+  struct prof_counts scan_states_;
+  struct prof_counts scan_columns_;
+  struct prof_counts parse_states_;
+  struct prof_counts parse_columns_;
+};
+
+void prof_init(struct prof_profile *prof);
+void prof_cleanup(struct prof_profile *prof);
+
+/* Reads the profile in filename. Returns 0 upon success, non-zero if the file cannot be read or
+ * is malformed, in which case an error has been reported. */
+int prof_load(struct prof_profile *prof, const char *filename);
+
+/* Renumbers the scan states, symbol groups, parse states and terminals of the tables built for
+ * the grammar, the most visited first (scan states within those of their mode), after which the
+ * tables can be emitted as usual. The dead scan state, symbol group 0 and the initial parse state
+ * keep their number. Parts of the profile that do not fit the tables (because the grammar changed
+ * since it was collected) are skipped with a warning. Returns 0 upon success, non-zero upon
+ * failure, in which case an error has been reported. */
+int prof_apply(struct prof_profile *prof, struct carburetta_context *cc, struct rex_scanner *rex, struct lr_generator *lalr);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* PROFILE_H */
@@ -43,12 +43,74 @@
 #include "report_error.h"
 #endif
 
+/* Grammars of a batch may be generated concurrently (see --jobs), lock stderr so their errors
+ * do not interleave midway through a line. The locks are recursive. */
+static void re_lock_stderr(void) {
+#ifdef _WIN32
+  _lock_file(stderr);
+#else
+  flockfile(stderr);
+#endif
+}
+
+static void re_unlock_stderr(void) {
+#ifdef _WIN32
+  _unlock_file(stderr);
+#else
+  funlockfile(stderr);
+#endif
+}
+
+#ifdef _MSC_VER
+#define RE_THREAD_LOCAL __declspec(thread)
+#else
+#define RE_THREAD_LOCAL __thread
+#endif
+
+/* Sink of the calling thread, NULL to report to stderr */
+static RE_THREAD_LOCAL re_sink_fn g_re_sink_ = NULL;
+static RE_THREAD_LOCAL void *g_re_sink_arg_ = NULL;
+
+void re_set_thread_sink(re_sink_fn sink, void *arg) {
+  g_re_sink_ = sink;
+  g_re_sink_arg_ = sink ? arg : NULL;
+}
+
+static void re_sink_impl(const char *filename, int line_nr, int col_nr, const char *fmt, va_list args) {
+  char buf[256];
+  char *msg = buf;
+  va_list args_copy;
+  va_copy(args_copy, args);
+  int len = vsnprintf(buf, sizeof(buf), fmt, args_copy);
+  va_end(args_copy);
+  if (len < 0) {
+    msg = NULL;
+  }
+  else if ((size_t)len >= sizeof(buf)) {
+    msg = (char *)malloc((size_t)len + 1);
+    if (msg) vsnprintf(msg, (size_t)len + 1, fmt, args);
+  }
+  g_re_sink_(g_re_sink_arg_, filename, line_nr, col_nr, msg ? msg : fmt);
+  if (msg && (msg != buf)) free(msg);
+}
+
 static void re_error_nowhere_impl(const char *fmt, va_list args) {
+  if (g_re_sink_) {
+    re_sink_impl(NULL, 0, 0, fmt, args);
+    return;
+  }
+  re_lock_stderr();
   vfprintf(stderr, fmt, args);
   fprintf(stderr, "\n");
+  re_unlock_stderr();
 }
 
 static void re_error_impl(const char *filename, int line_nr, int col_nr, const char *fmt, va_list args) {
+  if (g_re_sink_) {
+    re_sink_impl(filename ? filename : "", line_nr, col_nr, fmt, args);
+    return;
+  }
+  re_lock_stderr();
   if (line_nr) {
     fprintf(stderr, "%s(%d): ", filename ? filename : "", line_nr);
   }
@@ -56,6 +118,7 @@ static void re_error_impl(const char *filename, int line_nr, int col_nr, const c
     fprintf(stderr, "%s(?): ", filename ? filename : "");
   }
   re_error_nowhere_impl(fmt, args);
+  re_unlock_stderr();
 }
 
 static int re_error_x_marks_the_spot(struct xlts *x) {
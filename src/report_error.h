@@ -42,6 +42,14 @@ void re_error_flc(const char *filename, int line, int col, const char *fmt, ...)
 /* Report error without any specific location associated */
 void re_error_nowhere(const char *fmt, ...);
 
+/* Receives reports in place of stderr. filename is NULL for a report without any location, and
+ * "" for a location without a file; line is 0 if unknown. message has no trailing newline. */
+typedef void (*re_sink_fn)(void *arg, const char *filename, int line, int col, const char *message);
+
+/* Sends the reports made on the calling thread to sink, or back to stderr if sink is NULL. Lets a
+ * caller that generates grammars in-process collect the errors of each grammar separately. */
+void re_set_thread_sink(re_sink_fn sink, void *arg);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
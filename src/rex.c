@@ -88,6 +88,7 @@ void rex_nfa_cleanup(struct rex_nfa *nfa) {
       } while (trans != node->outbound_);        
     }
   }
+  if (nfa->nfa_nodes_) free(nfa->nfa_nodes_);
 }
 
 static int rex_nfa_trans_cmp_from(struct rex_nfa_trans *left, struct rex_nfa_trans *right) {
@@ -444,9 +445,11 @@ int rex_add_mode(struct rex_scanner *rex, struct rex_mode **pmode) {
   if (rex->modes_) {
     mode->chain_ = rex->modes_->chain_;
     rex->modes_->chain_ = mode;
+    mode->ordinal_ = rex->modes_->ordinal_ + 1;
   }
   else {
     mode->chain_ = mode;
+    mode->ordinal_ = 0;
   }
   rex->modes_ = mode;
   mode->patterns_ = NULL;
@@ -576,7 +579,7 @@ void rex_dfa_cleanup(struct rex_dfa *dfa) {
   struct rex_dfa_trans_group *tg = dfa->trans_groups_;
   if (tg) {
     do {
-      tg = tg->sibling_;
+      struct rex_dfa_trans_group *next = tg->sibling_;
 
       while (tg->selectors_) {
         struct rex_selector *selector = tg->selectors_;
@@ -584,6 +587,9 @@ void rex_dfa_cleanup(struct rex_dfa *dfa) {
         free(selector);
       }
 
+      free(tg);
+
+      tg = next;
     } while (tg != dfa->trans_groups_);
   }
 }
@@ -998,8 +1004,188 @@ cleanup:
   return r;
 }
 
-int rex_realize_modes(struct rex_scanner *rex) {
+static int rex_uint32_cmp(const void *left, const void *right) {
+  uint32_t l = *(const uint32_t *)left;
+  uint32_t r = *(const uint32_t *)right;
+  return (l < r) ? -1 : ((l > r) ? 1 : 0);
+}
+
+int rex_nfa_make_symbol_groups(struct rex_scanner *rex) {
   int r;
+  size_t n;
+  size_t num_bounds = 0;
+  uint32_t *bounds = NULL;
+  size_t *group_of = NULL;
+  size_t *group_size = NULL;
+  size_t *split_to = NULL;
+  size_t *num_touched = NULL;
+  size_t *touched = NULL;
+  unsigned char *covered = NULL;
+  struct rex_symbol_group **groups = NULL;
+
+  /* The edges of all symbol transitions cut the symbols into intervals, each transition covers a
+   * run of consecutive intervals. */
+  for (n = 0; n < rex->nfa_.num_nfa_nodes_; ++n) {
+    struct rex_nfa_trans *t = rex->nfa_.nfa_nodes_[n].outbound_;
+    if (t) {
+      do {
+        t = t->from_peer_;
+        if (!t->is_empty_ && !t->is_anchor_) num_bounds += 2;
+      } while (t != rex->nfa_.nfa_nodes_[n].outbound_);
+    }
+  }
+  if (!num_bounds) {
+    /* No symbol transitions, no symbol groups */
+    return 0;
+  }
+  bounds = (uint32_t *)malloc(sizeof(uint32_t) * num_bounds);
+  if (!bounds) {
+    r = _REX_NO_MEMORY;
+    goto cleanup;
+  }
+  num_bounds = 0;
+  for (n = 0; n < rex->nfa_.num_nfa_nodes_; ++n) {
+    struct rex_nfa_trans *t = rex->nfa_.nfa_nodes_[n].outbound_;
+    if (t) {
+      do {
+        t = t->from_peer_;
+        if (!t->is_empty_ && !t->is_anchor_) {
+          bounds[num_bounds++] = t->symbol_start_;
+          bounds[num_bounds++] = t->symbol_end_;
+        }
+      } while (t != rex->nfa_.nfa_nodes_[n].outbound_);
+    }
+  }
+  qsort(bounds, num_bounds, sizeof(uint32_t), rex_uint32_cmp);
+  size_t num_unique = 1;
+  for (n = 1; n < num_bounds; ++n) {
+    if (bounds[n] != bounds[num_unique - 1]) bounds[num_unique++] = bounds[n];
+  }
+  num_bounds = num_unique;
+
+  /* Interval i runs from bounds[i] to bounds[i + 1]. All intervals start out in group 0, each
+   * transition then splits every group it covers only part of in two (partition refinement), so
+   * that in the end two intervals share a group only if every transition covers either both or
+   * neither. */
+  size_t num_intervals = num_bounds - 1;
+  size_t num_groups = 1;
+  group_of = (size_t *)calloc(num_intervals + 1, sizeof(size_t));
+  group_size = (size_t *)calloc(num_intervals + 1, sizeof(size_t));
+  split_to = (size_t *)calloc(num_intervals + 1, sizeof(size_t));
+  num_touched = (size_t *)calloc(num_intervals + 1, sizeof(size_t));
+  touched = (size_t *)malloc(sizeof(size_t) * 2 * (num_intervals + 1));
+  covered = (unsigned char *)calloc(num_intervals + 1, 1);
+  if (!group_of || !group_size || !split_to || !num_touched || !touched || !covered) {
+    r = _REX_NO_MEMORY;
+    goto cleanup;
+  }
+  group_size[0] = num_intervals;
+
+  for (n = 0; n < rex->nfa_.num_nfa_nodes_; ++n) {
+    struct rex_nfa_trans *t = rex->nfa_.nfa_nodes_[n].outbound_;
+    if (!t) continue;
+    do {
+      t = t->from_peer_;
+      if (t->is_empty_ || t->is_anchor_) continue;
+
+      /* touched[] holds pairs of interval and the group it was in */
+      size_t num_touched_intervals = 0;
+      size_t i = (size_t)((uint32_t *)bsearch(&t->symbol_start_, bounds, num_bounds, sizeof(uint32_t), rex_uint32_cmp) - bounds);
+      for (; (i < num_intervals) && (bounds[i] < t->symbol_end_); ++i) {
+        covered[i] = 1;
+        touched[2 * num_touched_intervals] = i;
+        touched[2 * num_touched_intervals + 1] = group_of[i];
+        num_touched_intervals++;
+        num_touched[group_of[i]]++;
+      }
+      for (i = 0; i < num_touched_intervals; ++i) {
+        size_t interval = touched[2 * i];
+        size_t g = touched[2 * i + 1];
+        if (split_to[g] || (num_touched[g] != group_size[g])) {
+          /* Only part of the group is covered, move the covered part to a group of its own */
+          if (!split_to[g]) split_to[g] = num_groups++;
+          group_of[interval] = split_to[g];
+          group_size[g]--;
+          group_size[split_to[g]]++;
+        }
+      }
+      for (i = 0; i < num_touched_intervals; ++i) {
+        size_t g = touched[2 * i + 1];
+        num_touched[g] = 0;
+        split_to[g] = 0;
+      }
+    } while (t != rex->nfa_.nfa_nodes_[n].outbound_);
+  }
+
+  /* Number the groups in the order of their lowest symbol, intervals no transition covers are left
+   * out (and so decode to symbol group 0.) */
+  groups = (struct rex_symbol_group **)calloc(num_groups, sizeof(struct rex_symbol_group *));
+  if (!groups) {
+    r = _REX_NO_MEMORY;
+    goto cleanup;
+  }
+  for (n = 0; n < num_intervals; ++n) {
+    if (!covered[n]) continue;
+    struct rex_symbol_group *sg = groups[group_of[n]];
+    if (!sg) {
+      sg = (struct rex_symbol_group *)malloc(sizeof(struct rex_symbol_group));
+      if (!sg) {
+        r = _REX_NO_MEMORY;
+        goto cleanup;
+      }
+      groups[group_of[n]] = sg;
+      sg->hash_chain_ = NULL;
+      sg->ranges_ = NULL;
+      sg->selectors_ = NULL;
+      sg->dfa_trans_group_membership_[0] = 0;
+      if (rex->dfa_.symbol_groups_) {
+        sg->chain_ = rex->dfa_.symbol_groups_->chain_;
+        rex->dfa_.symbol_groups_->chain_ = sg;
+        sg->ordinal_ = rex->dfa_.symbol_groups_->ordinal_ + 1;
+      }
+      else {
+        sg->chain_ = sg;
+        sg->ordinal_ = 1;
+      }
+      rex->dfa_.symbol_groups_ = sg;
+    }
+    if (!sg->ranges_ || (sg->ranges_->symbol_end_ != bounds[n])) {
+      struct rex_symbol_range *sr = (struct rex_symbol_range *)malloc(sizeof(struct rex_symbol_range));
+      if (!sr) {
+        r = _REX_NO_MEMORY;
+        goto cleanup;
+      }
+      if (sg->ranges_) {
+        sr->chain_ = sg->ranges_->chain_;
+        sg->ranges_->chain_ = sr;
+      }
+      else {
+        sr->chain_ = sr;
+      }
+      sg->ranges_ = sr;
+      sr->symbol_start_ = bounds[n];
+      sr->symbol_end_ = bounds[n + 1];
+    }
+    else {
+      /* Extend last range to include this interval */
+      sg->ranges_->symbol_end_ = bounds[n + 1];
+    }
+  }
+
+  r = 0;
+cleanup:
+  if (bounds) free(bounds);
+  if (group_of) free(group_of);
+  if (group_size) free(group_size);
+  if (split_to) free(split_to);
+  if (num_touched) free(num_touched);
+  if (touched) free(touched);
+  if (covered) free(covered);
+  if (groups) free(groups);
+  return r;
+}
+
+int rex_link_modes(struct rex_scanner *rex) {
   struct rex_mode *mode;
   mode = rex->modes_;
   if (mode) {
@@ -1021,6 +1207,14 @@ int rex_realize_modes(struct rex_scanner *rex) {
       }
     } while (mode != rex->modes_);
   }
+  return 0;
+}
+
+int rex_realize_modes(struct rex_scanner *rex) {
+  int r;
+  struct rex_mode *mode;
+  r = rex_link_modes(rex);
+  if (r) return r;
 
   size_t map_size = sizeof(uint64_t) * ((rex->nfa_.num_nfa_nodes_ + 63) / 64);
   uint64_t *closure = (uint64_t *)malloc(map_size);
@@ -1640,3 +1834,747 @@ cleanup:
   free(closure);
   return r;
 }
+
+struct rex_dfa_writer {
+  size_t num_values_;
+  size_t num_values_allocated_;
+  uint32_t *values_;
+  int failed_;
+};
+
+static void rex_dfa_write(struct rex_dfa_writer *w, uint32_t value) {
+  if (w->failed_) return;
+  if (w->num_values_ == w->num_values_allocated_) {
+    size_t new_num_allocated = w->num_values_allocated_ * 2 + 256;
+    uint32_t *p = (uint32_t *)realloc(w->values_, sizeof(uint32_t) * new_num_allocated);
+    if (!p) {
+      w->failed_ = _REX_NO_MEMORY;
+      return;
+    }
+    w->values_ = p;
+    w->num_values_allocated_ = new_num_allocated;
+  }
+  w->values_[w->num_values_++] = value;
+}
+
+int rex_dfa_save(struct rex_scanner *rex, size_t *pnum_values, uint32_t **pvalues) {
+  struct rex_dfa *dfa = &rex->dfa_;
+  struct rex_dfa_writer w;
+  size_t num_nodes = 0, num_symbol_groups = 0, num_trans_groups = 0, num_modes = 0;
+  int max_symbol_group_ordinal = 0;
+  size_t *node_index_by_ordinal = NULL;
+  size_t *symbol_group_index_by_ordinal = NULL;
+  struct rex_dfa_node *dn;
+  struct rex_symbol_group *sg;
+  struct rex_dfa_trans_group *tg;
+  struct rex_mode *mode;
+
+  w.num_values_ = w.num_values_allocated_ = 0;
+  w.values_ = NULL;
+  w.failed_ = 0;
+
+  if ((dfa->next_dfa_node_ordinal_ < 1) || dfa->failed_) {
+    return _REX_INTERNAL_ERROR;
+  }
+
+  node_index_by_ordinal = (size_t *)malloc(sizeof(size_t) * (size_t)dfa->next_dfa_node_ordinal_);
+  if (!node_index_by_ordinal) {
+    return _REX_NO_MEMORY;
+  }
+  dn = dfa->nodes_;
+  if (dn) {
+    do {
+      dn = dn->chain_;
+      if ((dn->ordinal_ < 1) || (dn->ordinal_ >= dfa->next_dfa_node_ordinal_)) {
+        w.failed_ = _REX_INTERNAL_ERROR;
+        goto cleanup;
+      }
+      node_index_by_ordinal[dn->ordinal_] = num_nodes++;
+    } while (dn != dfa->nodes_);
+  }
+
+  sg = dfa->symbol_groups_;
+  if (sg) {
+    do {
+      sg = sg->chain_;
+      if (sg->ordinal_ > max_symbol_group_ordinal) max_symbol_group_ordinal = sg->ordinal_;
+    } while (sg != dfa->symbol_groups_);
+  }
+  symbol_group_index_by_ordinal = (size_t *)malloc(sizeof(size_t) * (1 + (size_t)max_symbol_group_ordinal));
+  if (!symbol_group_index_by_ordinal) {
+    w.failed_ = _REX_NO_MEMORY;
+    goto cleanup;
+  }
+  sg = dfa->symbol_groups_;
+  if (sg) {
+    do {
+      sg = sg->chain_;
+      if (sg->ordinal_ < 1) {
+        w.failed_ = _REX_INTERNAL_ERROR;
+        goto cleanup;
+      }
+      symbol_group_index_by_ordinal[sg->ordinal_] = num_symbol_groups++;
+    } while (sg != dfa->symbol_groups_);
+  }
+
+  tg = dfa->trans_groups_;
+  if (tg) {
+    do {
+      tg = tg->sibling_;
+      num_trans_groups++;
+    } while (tg != dfa->trans_groups_);
+  }
+
+  mode = rex->modes_;
+  if (mode) {
+    do {
+      mode = mode->chain_;
+      num_modes++;
+    } while (mode != rex->modes_);
+  }
+
+  rex_dfa_write(&w, (uint32_t)dfa->next_dfa_node_ordinal_);
+  rex_dfa_write(&w, (uint32_t)num_nodes);
+  rex_dfa_write(&w, (uint32_t)num_symbol_groups);
+  rex_dfa_write(&w, (uint32_t)num_trans_groups);
+  rex_dfa_write(&w, (uint32_t)num_modes);
+
+  dn = dfa->nodes_;
+  if (dn) {
+    do {
+      dn = dn->chain_;
+      size_t num_outbound = 0;
+      struct rex_dfa_trans *dt = dn->outbound_;
+      if (dt) {
+        do {
+          dt = dt->from_peer_;
+          num_outbound++;
+        } while (dt != dn->outbound_);
+      }
+      rex_dfa_write(&w, (uint32_t)dn->ordinal_);
+      rex_dfa_write(&w, dn->pattern_matched_ ? (uint32_t)dn->pattern_matched_->ordinal_ + 1 : 0);
+      rex_dfa_write(&w, (uint32_t)num_outbound);
+      dt = dn->outbound_;
+      if (dt) {
+        do {
+          dt = dt->from_peer_;
+          rex_dfa_write(&w, dt->symbol_start_);
+          rex_dfa_write(&w, dt->symbol_end_);
+          rex_dfa_write(&w, dt->is_anchor_ ? 1 : 0);
+          rex_dfa_write(&w, (uint32_t)node_index_by_ordinal[dt->to_->ordinal_]);
+        } while (dt != dn->outbound_);
+      }
+    } while (dn != dfa->nodes_);
+  }
+
+  mode = rex->modes_;
+  if (mode) {
+    do {
+      mode = mode->chain_;
+      rex_dfa_write(&w, mode->dfa_node_ ? (uint32_t)node_index_by_ordinal[mode->dfa_node_->ordinal_] + 1 : 0);
+    } while (mode != rex->modes_);
+  }
+
+  sg = dfa->symbol_groups_;
+  if (sg) {
+    do {
+      sg = sg->chain_;
+      size_t num_ranges = 0;
+      struct rex_symbol_range *sr = sg->ranges_;
+      if (sr) {
+        do {
+          sr = sr->chain_;
+          num_ranges++;
+        } while (sr != sg->ranges_);
+      }
+      rex_dfa_write(&w, (uint32_t)sg->ordinal_);
+      rex_dfa_write(&w, (uint32_t)num_ranges);
+      sr = sg->ranges_;
+      if (sr) {
+        do {
+          sr = sr->chain_;
+          rex_dfa_write(&w, sr->symbol_start_);
+          rex_dfa_write(&w, sr->symbol_end_);
+        } while (sr != sg->ranges_);
+      }
+    } while (sg != dfa->symbol_groups_);
+  }
+
+  tg = dfa->trans_groups_;
+  if (tg) {
+    do {
+      tg = tg->sibling_;
+      size_t num_transitions = 0, num_selectors = 0;
+      struct rex_dfa_trans *dt = tg->transitions_;
+      if (dt) {
+        do {
+          dt = dt->trans_group_sibling_;
+          num_transitions++;
+        } while (dt != tg->transitions_);
+      }
+      struct rex_selector *selector = tg->selectors_;
+      if (selector) {
+        do {
+          num_selectors++;
+          selector = selector->next_in_dfa_transition_group_;
+        } while (selector != tg->selectors_);
+      }
+      rex_dfa_write(&w, (uint32_t)tg->ordinal_);
+      rex_dfa_write(&w, tg->heap_is_at_backside_ ? 1 : 0);
+      rex_dfa_write(&w, (uint32_t)num_transitions);
+      dt = tg->transitions_;
+      if (dt) {
+        do {
+          dt = dt->trans_group_sibling_;
+          /* Transitions are identified by their position in the outbound transitions of their from_ node */
+          size_t outbound_index = 0;
+          struct rex_dfa_trans *ob = dt->from_->outbound_->from_peer_;
+          while (ob != dt) {
+            ob = ob->from_peer_;
+            outbound_index++;
+          }
+          rex_dfa_write(&w, (uint32_t)node_index_by_ordinal[dt->from_->ordinal_]);
+          rex_dfa_write(&w, (uint32_t)outbound_index);
+        } while (dt != tg->transitions_);
+      }
+      rex_dfa_write(&w, (uint32_t)num_selectors);
+      selector = tg->selectors_;
+      if (selector) {
+        do {
+          rex_dfa_write(&w, (uint32_t)symbol_group_index_by_ordinal[selector->symbol_group_->ordinal_]);
+          selector = selector->next_in_dfa_transition_group_;
+        } while (selector != tg->selectors_);
+      }
+    } while (tg != dfa->trans_groups_);
+  }
+
+cleanup:
+  if (node_index_by_ordinal) free(node_index_by_ordinal);
+  if (symbol_group_index_by_ordinal) free(symbol_group_index_by_ordinal);
+  if (w.failed_) {
+    if (w.values_) free(w.values_);
+    return w.failed_;
+  }
+  *pnum_values = w.num_values_;
+  *pvalues = w.values_;
+  return 0;
+}
+
+struct rex_dfa_reader {
+  const uint32_t *pos_;
+  const uint32_t *end_;
+  int failed_;
+};
+
+static uint32_t rex_dfa_read(struct rex_dfa_reader *r) {
+  if (r->pos_ == r->end_) {
+    r->failed_ = _REX_INTERNAL_ERROR;
+    return 0;
+  }
+  return *r->pos_++;
+}
+
+/* Reads a count of items that each take at least min_values_per_item values, failing if there are not
+ * enough values left, so a malformed count cannot cause an oversized allocation. */
+static size_t rex_dfa_read_count(struct rex_dfa_reader *r, size_t min_values_per_item) {
+  size_t count = (size_t)rex_dfa_read(r);
+  if (min_values_per_item && (count > ((size_t)(r->end_ - r->pos_) / min_values_per_item))) {
+    r->failed_ = _REX_INTERNAL_ERROR;
+    return 0;
+  }
+  return count;
+}
+
+int rex_dfa_load(struct rex_scanner *rex, size_t num_values, const uint32_t *values) {
+  struct rex_dfa *dfa = &rex->dfa_;
+  struct rex_dfa_reader r;
+  struct rex_dfa_node **nodes = NULL;
+  struct rex_symbol_group **symbol_groups = NULL;
+  struct rex_pattern **patterns_by_ordinal = NULL;
+  size_t num_nodes, num_symbol_groups, num_trans_groups, num_modes;
+  struct rex_mode *mode;
+  size_t n;
+
+  r.pos_ = values;
+  r.end_ = values + num_values;
+  r.failed_ = 0;
+
+  if (dfa->nodes_ || dfa->symbol_groups_ || dfa->trans_groups_) {
+    /* Only an empty DFA can be loaded */
+    return _REX_INTERNAL_ERROR;
+  }
+
+  if (rex->next_pattern_ordinal_) {
+    patterns_by_ordinal = (struct rex_pattern **)calloc((size_t)rex->next_pattern_ordinal_, sizeof(struct rex_pattern *));
+    if (!patterns_by_ordinal) {
+      return _REX_NO_MEMORY;
+    }
+    struct rex_pattern *pat = rex->patterns_;
+    if (pat) {
+      do {
+        pat = pat->chain_;
+        if ((pat->ordinal_ >= 0) && (pat->ordinal_ < rex->next_pattern_ordinal_)) {
+          patterns_by_ordinal[pat->ordinal_] = pat;
+        }
+      } while (pat != rex->patterns_);
+    }
+  }
+
+  int next_dfa_node_ordinal = (int)rex_dfa_read(&r);
+  num_nodes = rex_dfa_read_count(&r, 3);
+  num_symbol_groups = rex_dfa_read_count(&r, 2);
+  num_trans_groups = rex_dfa_read_count(&r, 4);
+  num_modes = rex_dfa_read_count(&r, 1);
+  if (r.failed_ || (next_dfa_node_ordinal < 1) || ((size_t)next_dfa_node_ordinal <= num_nodes)) {
+    r.failed_ = _REX_INTERNAL_ERROR;
+    goto cleanup;
+  }
+
+  /* Allocate all nodes upfront, transitions can go to nodes that follow */
+  nodes = (struct rex_dfa_node **)malloc(sizeof(struct rex_dfa_node *) * (num_nodes ? num_nodes : 1));
+  symbol_groups = (struct rex_symbol_group **)malloc(sizeof(struct rex_symbol_group *) * (num_symbol_groups ? num_symbol_groups : 1));
+  if (!nodes || !symbol_groups) {
+    r.failed_ = _REX_NO_MEMORY;
+    goto cleanup;
+  }
+  for (n = 0; n < num_nodes; ++n) {
+    struct rex_dfa_node *dn = (struct rex_dfa_node *)malloc(sizeof(struct rex_dfa_node));
+    if (!dn) {
+      r.failed_ = _REX_NO_MEMORY;
+      goto cleanup;
+    }
+    memset(dn, 0, sizeof(struct rex_dfa_node));
+    if (dfa->nodes_) {
+      dn->chain_ = dfa->nodes_->chain_;
+      dfa->nodes_->chain_ = dn;
+    }
+    else {
+      dn->chain_ = dn;
+    }
+    dfa->nodes_ = dn;
+    nodes[n] = dn;
+  }
+  dfa->next_dfa_node_ordinal_ = next_dfa_node_ordinal;
+
+  for (n = 0; n < num_nodes; ++n) {
+    struct rex_dfa_node *dn = nodes[n];
+    size_t num_outbound;
+    uint32_t pattern_ordinal_plus_one;
+    dn->ordinal_ = (int)rex_dfa_read(&r);
+    pattern_ordinal_plus_one = rex_dfa_read(&r);
+    num_outbound = rex_dfa_read_count(&r, 4);
+    if (r.failed_ || (dn->ordinal_ < 1) || (dn->ordinal_ >= next_dfa_node_ordinal)) {
+      r.failed_ = _REX_INTERNAL_ERROR;
+      goto cleanup;
+    }
+    if (pattern_ordinal_plus_one) {
+      if ((pattern_ordinal_plus_one > (uint32_t)rex->next_pattern_ordinal_) || !patterns_by_ordinal[pattern_ordinal_plus_one - 1]) {
+        r.failed_ = _REX_INTERNAL_ERROR;
+        goto cleanup;
+      }
+      dn->pattern_matched_ = patterns_by_ordinal[pattern_ordinal_plus_one - 1];
+    }
+    while (num_outbound--) {
+      struct rex_dfa_trans *dt = (struct rex_dfa_trans *)malloc(sizeof(struct rex_dfa_trans));
+      if (!dt) {
+        r.failed_ = _REX_NO_MEMORY;
+        goto cleanup;
+      }
+      dt->from_ = dn;
+      if (dn->outbound_) {
+        dt->from_peer_ = dn->outbound_->from_peer_;
+        dn->outbound_->from_peer_ = dt;
+      }
+      else {
+        dt->from_peer_ = dt;
+      }
+      dn->outbound_ = dt;
+      dt->to_peer_ = dt;
+      dt->trans_group_sibling_ = NULL;
+
+      dt->symbol_start_ = rex_dfa_read(&r);
+      dt->symbol_end_ = rex_dfa_read(&r);
+      dt->is_anchor_ = rex_dfa_read(&r) ? 1 : 0;
+      uint32_t to_index = rex_dfa_read(&r);
+      if (r.failed_ || (to_index >= num_nodes)) {
+        r.failed_ = _REX_INTERNAL_ERROR;
+        goto cleanup;
+      }
+      dt->to_ = nodes[to_index];
+    }
+  }
+
+  /* The modes must already exist, as they were when the DFA was saved */
+  mode = rex->modes_;
+  if (mode) {
+    do {
+      mode = mode->chain_;
+      uint32_t node_index_plus_one = rex_dfa_read(&r);
+      if (r.failed_ || !num_modes-- || (node_index_plus_one > num_nodes)) {
+        r.failed_ = _REX_INTERNAL_ERROR;
+        goto cleanup;
+      }
+      mode->dfa_node_ = node_index_plus_one ? nodes[node_index_plus_one - 1] : NULL;
+    } while (mode != rex->modes_);
+  }
+  if (num_modes) {
+    r.failed_ = _REX_INTERNAL_ERROR;
+    goto cleanup;
+  }
+
+  size_t membership_size = sizeof(uint64_t) * ((num_trans_groups + 63) / 64);
+  size_t symbol_group_size = sizeof(struct rex_symbol_group) + (membership_size ? membership_size - sizeof(uint64_t) : 0);
+  for (n = 0; n < num_symbol_groups; ++n) {
+    struct rex_symbol_group *sg = (struct rex_symbol_group *)malloc(symbol_group_size);
+    if (!sg) {
+      r.failed_ = _REX_NO_MEMORY;
+      goto cleanup;
+    }
+    memset(sg, 0, symbol_group_size);
+    if (dfa->symbol_groups_) {
+      sg->chain_ = dfa->symbol_groups_->chain_;
+      dfa->symbol_groups_->chain_ = sg;
+    }
+    else {
+      sg->chain_ = sg;
+    }
+    dfa->symbol_groups_ = sg;
+    symbol_groups[n] = sg;
+
+    sg->ordinal_ = (int)rex_dfa_read(&r);
+    size_t num_ranges = rex_dfa_read_count(&r, 2);
+    if (r.failed_ || (sg->ordinal_ < 1)) {
+      r.failed_ = _REX_INTERNAL_ERROR;
+      goto cleanup;
+    }
+    while (num_ranges--) {
+      struct rex_symbol_range *sr = (struct rex_symbol_range *)malloc(sizeof(struct rex_symbol_range));
+      if (!sr) {
+        r.failed_ = _REX_NO_MEMORY;
+        goto cleanup;
+      }
+      if (sg->ranges_) {
+        sr->chain_ = sg->ranges_->chain_;
+        sg->ranges_->chain_ = sr;
+      }
+      else {
+        sr->chain_ = sr;
+      }
+      sg->ranges_ = sr;
+      sr->symbol_start_ = rex_dfa_read(&r);
+      sr->symbol_end_ = rex_dfa_read(&r);
+    }
+  }
+
+  for (n = 0; n < num_trans_groups; ++n) {
+    struct rex_dfa_trans_group *tg = (struct rex_dfa_trans_group *)malloc(sizeof(struct rex_dfa_trans_group));
+    if (!tg) {
+      r.failed_ = _REX_NO_MEMORY;
+      goto cleanup;
+    }
+    if (dfa->trans_groups_) {
+      tg->sibling_ = dfa->trans_groups_->sibling_;
+      dfa->trans_groups_->sibling_ = tg;
+    }
+    else {
+      tg->sibling_ = tg;
+    }
+    dfa->trans_groups_ = tg;
+    tg->transitions_ = NULL;
+    tg->selectors_ = NULL;
+
+    tg->ordinal_ = (int)rex_dfa_read(&r);
+    tg->heap_is_at_backside_ = rex_dfa_read(&r) ? 1 : 0;
+    size_t num_transitions = rex_dfa_read_count(&r, 2);
+    if (r.failed_ || (tg->ordinal_ < 0) || ((size_t)tg->ordinal_ >= num_trans_groups)) {
+      r.failed_ = _REX_INTERNAL_ERROR;
+      goto cleanup;
+    }
+    while (num_transitions--) {
+      uint32_t from_index = rex_dfa_read(&r);
+      uint32_t outbound_index = rex_dfa_read(&r);
+      if (r.failed_ || (from_index >= num_nodes) || !nodes[from_index]->outbound_) {
+        r.failed_ = _REX_INTERNAL_ERROR;
+        goto cleanup;
+      }
+      struct rex_dfa_trans *dt = nodes[from_index]->outbound_->from_peer_;
+      while (outbound_index--) {
+        if (dt == nodes[from_index]->outbound_) {
+          /* Past the last outbound transition */
+          r.failed_ = _REX_INTERNAL_ERROR;
+          goto cleanup;
+        }
+        dt = dt->from_peer_;
+      }
+      if (dt->trans_group_sibling_) {
+        /* Transition cannot be in more than one group */
+        r.failed_ = _REX_INTERNAL_ERROR;
+        goto cleanup;
+      }
+      if (tg->transitions_) {
+        dt->trans_group_sibling_ = tg->transitions_->trans_group_sibling_;
+        tg->transitions_->trans_group_sibling_ = dt;
+      }
+      else {
+        dt->trans_group_sibling_ = dt;
+      }
+      tg->transitions_ = dt;
+    }
+    if (!tg->transitions_) {
+      r.failed_ = _REX_INTERNAL_ERROR;
+      goto cleanup;
+    }
+
+    size_t num_selectors = rex_dfa_read_count(&r, 1);
+    while (num_selectors--) {
+      uint32_t symbol_group_index = rex_dfa_read(&r);
+      if (r.failed_ || (symbol_group_index >= num_symbol_groups)) {
+        r.failed_ = _REX_INTERNAL_ERROR;
+        goto cleanup;
+      }
+      struct rex_symbol_group *sg = symbol_groups[symbol_group_index];
+      struct rex_selector *selector = (struct rex_selector *)malloc(sizeof(struct rex_selector));
+      if (!selector) {
+        r.failed_ = _REX_NO_MEMORY;
+        goto cleanup;
+      }
+      /* Append, keeping the order of the selectors in the transition group */
+      selector->dfa_transition_group_ = tg;
+      if (tg->selectors_) {
+        selector->next_in_dfa_transition_group_ = tg->selectors_;
+        selector->prev_in_dfa_transition_group_ = tg->selectors_->prev_in_dfa_transition_group_;
+        selector->next_in_dfa_transition_group_->prev_in_dfa_transition_group_ = selector->prev_in_dfa_transition_group_->next_in_dfa_transition_group_ = selector;
+      }
+      else {
+        selector->next_in_dfa_transition_group_ = selector->prev_in_dfa_transition_group_ = selector;
+        tg->selectors_ = selector;
+      }
+      selector->symbol_group_ = sg;
+      if (sg->selectors_) {
+        selector->next_in_symbol_group_ = sg->selectors_;
+        selector->prev_in_symbol_group_ = sg->selectors_->prev_in_symbol_group_;
+        selector->prev_in_symbol_group_->next_in_symbol_group_ = selector->next_in_symbol_group_->prev_in_symbol_group_ = selector;
+      }
+      else {
+        selector->next_in_symbol_group_ = selector->prev_in_symbol_group_ = selector;
+        sg->selectors_ = selector;
+      }
+      sg->dfa_trans_group_membership_[tg->ordinal_ / 64] |= ((uint64_t)1) << (tg->ordinal_ & 63);
+    }
+  }
+
+  if (r.pos_ != r.end_) {
+    r.failed_ = _REX_INTERNAL_ERROR;
+    goto cleanup;
+  }
+
+  /* The last node and symbol group hold the highest ordinals, the emitters size their tables by them */
+  for (n = 0; n < num_nodes; ++n) {
+    if (nodes[n]->ordinal_ > dfa->nodes_->ordinal_) {
+      r.failed_ = _REX_INTERNAL_ERROR;
+      goto cleanup;
+    }
+  }
+  for (n = 0; n < num_symbol_groups; ++n) {
+    if (symbol_groups[n]->ordinal_ > dfa->symbol_groups_->ordinal_) {
+      r.failed_ = _REX_INTERNAL_ERROR;
+      goto cleanup;
+    }
+  }
+
+cleanup:
+  if (r.failed_) {
+    rex_dfa_cleanup(dfa);
+    rex_dfa_init(dfa);
+    mode = rex->modes_;
+    if (mode) {
+      do {
+        mode = mode->chain_;
+        mode->dfa_node_ = NULL;
+      } while (mode != rex->modes_);
+    }
+  }
+  if (nodes) free(nodes);
+  if (symbol_groups) free(symbol_groups);
+  if (patterns_by_ordinal) free(patterns_by_ordinal);
+  return r.failed_;
+}
+
+int rex_dfa_renumber(struct rex_dfa *dfa, const int *node_ordinals, const int *symbol_group_ordinals) {
+  struct rex_dfa_node **nodes = NULL;
+  struct rex_symbol_group **symbol_groups = NULL;
+  size_t num_nodes = dfa->nodes_ ? (size_t)dfa->nodes_->ordinal_ : 0;
+  size_t num_symbol_groups = dfa->symbol_groups_ ? (size_t)dfa->symbol_groups_->ordinal_ : 0;
+  size_t n;
+  int r = 0;
+
+  /* Check both maps are permutations before changing anything, then relink each chain in the
+   * order of the new ordinals, so the last node and symbol group again hold the highest. */
+  nodes = (struct rex_dfa_node **)calloc(num_nodes + 1, sizeof(struct rex_dfa_node *));
+  symbol_groups = (struct rex_symbol_group **)calloc(num_symbol_groups + 1, sizeof(struct rex_symbol_group *));
+  if (!nodes || !symbol_groups) {
+    r = _REX_NO_MEMORY;
+    goto cleanup;
+  }
+
+  struct rex_dfa_node *dn = dfa->nodes_;
+  if (dn && node_ordinals) {
+    do {
+      dn = dn->chain_;
+
+      int ordinal = node_ordinals[dn->ordinal_];
+      if ((ordinal < 1) || ((size_t)ordinal > num_nodes) || nodes[ordinal]) {
+        r = _REX_INTERNAL_ERROR;
+        goto cleanup;
+      }
+      nodes[ordinal] = dn;
+
+    } while (dn != dfa->nodes_);
+  }
+
+  struct rex_symbol_group *sg = dfa->symbol_groups_;
+  if (sg && symbol_group_ordinals) {
+    do {
+      sg = sg->chain_;
+
+      int ordinal = symbol_group_ordinals[sg->ordinal_];
+      if ((ordinal < 1) || ((size_t)ordinal > num_symbol_groups) || symbol_groups[ordinal]) {
+        r = _REX_INTERNAL_ERROR;
+        goto cleanup;
+      }
+      symbol_groups[ordinal] = sg;
+
+    } while (sg != dfa->symbol_groups_);
+  }
+
+  for (n = 1; n <= num_nodes; ++n) {
+    if (node_ordinals && !nodes[n]) {
+      r = _REX_INTERNAL_ERROR;
+      goto cleanup;
+    }
+  }
+  for (n = 1; n <= num_symbol_groups; ++n) {
+    if (symbol_group_ordinals && !symbol_groups[n]) {
+      r = _REX_INTERNAL_ERROR;
+      goto cleanup;
+    }
+  }
+
+  if (num_nodes && node_ordinals) {
+    for (n = 1; n <= num_nodes; ++n) {
+      nodes[n]->ordinal_ = (int)n;
+      nodes[n]->chain_ = nodes[(n == num_nodes) ? 1 : n + 1];
+    }
+    dfa->nodes_ = nodes[num_nodes];
+  }
+
+  if (num_symbol_groups && symbol_group_ordinals) {
+    for (n = 1; n <= num_symbol_groups; ++n) {
+      symbol_groups[n]->ordinal_ = (int)n;
+      symbol_groups[n]->chain_ = symbol_groups[(n == num_symbol_groups) ? 1 : n + 1];
+    }
+    dfa->symbol_groups_ = symbol_groups[num_symbol_groups];
+  }
+
+cleanup:
+  if (nodes) free(nodes);
+  if (symbol_groups) free(symbol_groups);
+  return r;
+}
+
+struct rex_partition_rank {
+  uint64_t weight_;
+  size_t position_;
+  struct rex_dfa_node *node_;
+};
+
+static int rex_partition_rank_cmp(const void *left, const void *right) {
+  const struct rex_partition_rank *a = (const struct rex_partition_rank *)left;
+  const struct rex_partition_rank *b = (const struct rex_partition_rank *)right;
+  /* Heaviest first, ties stay in breadth-first order */
+  if (a->weight_ != b->weight_) return (a->weight_ > b->weight_) ? -1 : 1;
+  return (a->position_ < b->position_) ? -1 : ((a->position_ > b->position_) ? 1 : 0);
+}
+
+int rex_dfa_partition_modes(struct rex_scanner *rex, const uint64_t *node_weights) {
+  struct rex_dfa *dfa = &rex->dfa_;
+  size_t num_nodes = dfa->nodes_ ? (size_t)dfa->nodes_->ordinal_ : 0;
+  struct rex_dfa_node **queue = NULL;
+  struct rex_partition_rank *ranks = NULL;
+  int *node_ordinals = NULL;
+  size_t next = 1;
+  size_t begin, head, n;
+  int r = 0;
+
+  if (!num_nodes) return 0;
+
+  /* queue[o] is the node that gets ordinal o, node_ordinals[o] the new ordinal of the node with
+   * ordinal o (0 while not yet reached.) */
+  queue = (struct rex_dfa_node **)calloc(num_nodes + 1, sizeof(struct rex_dfa_node *));
+  node_ordinals = (int *)calloc(num_nodes + 1, sizeof(int));
+  if (node_weights) ranks = (struct rex_partition_rank *)malloc(sizeof(struct rex_partition_rank) * num_nodes);
+  if (!queue || !node_ordinals || (node_weights && !ranks)) {
+    r = _REX_NO_MEMORY;
+    goto cleanup;
+  }
+
+  struct rex_mode *mode = rex->modes_;
+  if (mode) {
+    do {
+      mode = mode->chain_;
+
+      begin = next;
+      if (mode->dfa_node_ && !node_ordinals[mode->dfa_node_->ordinal_]) {
+        queue[next] = mode->dfa_node_;
+        node_ordinals[mode->dfa_node_->ordinal_] = (int)next++;
+      }
+      for (head = begin; head < next; ++head) {
+        struct rex_dfa_trans *dt = queue[head]->outbound_;
+        if (dt) {
+          do {
+            dt = dt->from_peer_;
+
+            if (!node_ordinals[dt->to_->ordinal_]) {
+              queue[next] = dt->to_;
+              node_ordinals[dt->to_->ordinal_] = (int)next++;
+            }
+
+          } while (dt != queue[head]->outbound_);
+        }
+      }
+
+      if (node_weights && (next - begin > 1)) {
+        for (n = begin; n < next; ++n) {
+          ranks[n - begin].weight_ = node_weights[queue[n]->ordinal_];
+          ranks[n - begin].position_ = n;
+          ranks[n - begin].node_ = queue[n];
+        }
+        qsort(ranks, next - begin, sizeof(struct rex_partition_rank), rex_partition_rank_cmp);
+        for (n = begin; n < next; ++n) {
+          queue[n] = ranks[n - begin].node_;
+          node_ordinals[queue[n]->ordinal_] = (int)n;
+        }
+      }
+
+    } while (mode != rex->modes_);
+  }
+
+  /* Nodes no mode reaches (there should be none) go last, as they were */
+  struct rex_dfa_node *dn = dfa->nodes_;
+  do {
+    dn = dn->chain_;
+
+    if (!node_ordinals[dn->ordinal_]) {
+      node_ordinals[dn->ordinal_] = (int)next++;
+    }
+
+  } while (dn != dfa->nodes_);
+
+  r = rex_dfa_renumber(dfa, node_ordinals, NULL);
+
+cleanup:
+  if (queue) free(queue);
+  if (ranks) free(ranks);
+  if (node_ordinals) free(node_ordinals);
+  return r;
+}
@@ -207,6 +207,9 @@ struct rex_mode {
   struct rex_pattern_mode *patterns_;
   size_t nfa_begin_state_;
   struct rex_dfa_node *dfa_node_;
+
+  /* 0-based ordinal of the mode, in the order the modes were added */
+  int ordinal_;
 };
 
 struct rex_pattern_mode {
@@ -251,6 +254,44 @@ int rex_add_pattern(struct rex_scanner *rex, const char *regex, uintptr_t action
 int rex_add_mode(struct rex_scanner *rex, struct rex_mode **pmode);
 int rex_add_pattern_to_mode(struct rex_mode *mode, struct rex_pattern *pat);
 
+/* Adds the empty transitions from each mode's NFA begin state to its patterns; done once, either
+ * by rex_realize_modes() or by the caller when only the NFA is to be used. */
+int rex_link_modes(struct rex_scanner *rex);
+
 int rex_realize_modes(struct rex_scanner *rex);
 
+/* Partitions the symbols into symbol groups from the transitions of the NFA rather than those of the
+ * DFA, for when rex_realize_modes() is not called; the groups are stored in rex->dfa_.symbol_groups_
+ * as rex_dfa_make_symbol_groups() would. No NFA transition distinguishes between two symbols of the
+ * same group. */
+int rex_nfa_make_symbol_groups(struct rex_scanner *rex);
+
+/* Flattens the DFA of rex, as produced by rex_realize_modes() and rex_dfa_make_symbol_groups(),
+ * into an array of values, so it can be stored and later loaded by rex_dfa_load(). The array is
+ * allocated and should be freed by the caller. Returns 0 upon success. */
+int rex_dfa_save(struct rex_scanner *rex, size_t *pnum_values, uint32_t **pvalues);
+
+/* Loads the DFA saved by rex_dfa_save(), in place of calling rex_realize_modes() and
+ * rex_dfa_make_symbol_groups(). The patterns (their ordinals and actions) and modes of rex should
+ * be set up as they were when the DFA was saved, the NFA of the patterns is not needed. Returns 0
+ * upon success, _REX_INTERNAL_ERROR if the values are malformed or do not match the patterns and
+ * modes, in which case the DFA is left empty. */
+int rex_dfa_load(struct rex_scanner *rex, size_t num_values, const uint32_t *values);
+
+/* Assigns new ordinals to the nodes and symbol groups of the DFA, for instance to place those most
+ * often visited together. node_ordinals[o] is the new ordinal of the node with ordinal o, and
+ * symbol_group_ordinals[o] that of the symbol group with ordinal o; either may be NULL to leave
+ * those as they are. Ordinal 0 of either is not assigned and so not renumbered. Mode start states
+ * and transitions refer to the nodes by pointer and follow along; tables derived from the ordinals,
+ * such as the UTF-8 decoder table, must be built afterwards. Returns 0 upon success,
+ * _REX_INTERNAL_ERROR if a map is not a permutation, in which case the DFA is unchanged. */
+int rex_dfa_renumber(struct rex_dfa *dfa, const int *node_ordinals, const int *symbol_group_ordinals);
+
+/* Renumbers the nodes of the DFA so those of each mode are contiguous, in the order of the modes, so
+ * a scanner that stays mostly in one mode visits a dense range of its tables. The nodes of a mode are
+ * those reachable from its start state that no earlier mode reaches, numbered breadth-first from the
+ * start state, or, if node_weights is not NULL, by descending node_weights[o] for the node with
+ * ordinal o (such as profiled visits.) Returns 0 upon success, or as rex_dfa_renumber(). */
+int rex_dfa_partition_modes(struct rex_scanner *rex, const uint64_t *node_weights);
+
 #endif /* REX_H */
@@ -253,22 +253,144 @@ void sc_scanner_dump(struct sc_scanner *sc) {
   }
 }
 
-void sc_scanner_write_to_c_file(struct sc_scanner *sc, FILE *fp, const char *transition_table_id, const char *state_actions_id, const char *scanner_id) {
+int sc_scanner_expand(struct sc_scanner *sc, const struct sc_compact_scanner *csc) {
+  size_t state;
+  int c;
+  sc_scanner_cleanup(sc);
+  sc_scanner_init(sc);
+  sc->actions = (struct sc_action *)arealloc(NULL, csc->num_states, sizeof(struct sc_action));
+  if (!sc->actions) {
+    return -1;
+  }
+  sc->transition_table = (size_t *)arealloc(NULL, csc->num_states, 256 * sizeof(size_t));
+  if (!sc->transition_table) {
+    return -1;
+  }
+  for (state = 0; state < csc->num_states; ++state) {
+    const uint16_t *compact_row = csc->transitions + csc->num_classes * state;
+    size_t *row = sc->transition_table + 256 * state;
+    for (c = 0; c < 256; ++c) {
+      row[c] = compact_row[csc->byte_classes[c]];
+    }
+  }
+  memcpy(sc->actions, csc->actions, csc->num_states * sizeof(struct sc_action));
+  sc->num_states = csc->num_states;
+  sc->start_state = csc->start_state;
+  sc->default_action = csc->default_action;
+  return 0;
+}
+
+int sc_scanner_cmp(const struct sc_scanner *left, const struct sc_scanner *right) {
   size_t n;
-  fprintf(fp, "static size_t %s[] = {\n", transition_table_id);
+  if ((left->num_states != right->num_states) ||
+      (left->start_state != right->start_state) ||
+      (left->default_action != right->default_action)) {
+    return 1;
+  }
+  if (memcmp(left->transition_table, right->transition_table, 256 * sizeof(size_t) * left->num_states)) {
+    return 1;
+  }
+  for (n = 0; n < left->num_states; ++n) {
+    if ((left->actions[n].action != right->actions[n].action) ||
+        (left->actions[n].variant != right->actions[n].variant)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int sc_scanner_verify(const struct sc_compact_scanner *csc, const char *generated_file, uintptr_t default_action, size_t num_rules, const struct sc_scan_rule *rules) {
+  int r;
+  struct sc_scanner compiled, pregenerated;
+  sc_scanner_init(&compiled);
+  sc_scanner_init(&pregenerated);
+  r = sc_scanner_compile(&compiled, default_action, num_rules, rules);
+  if (!r) r = sc_scanner_expand(&pregenerated, csc);
+  if (!r && sc_scanner_cmp(&compiled, &pregenerated)) {
+    fprintf(stderr, "Error, %s differs from its scanner rules, regenerate it with \"make scanner-tables\"\n", generated_file);
+    r = -1;
+  }
+  sc_scanner_cleanup(&compiled);
+  sc_scanner_cleanup(&pregenerated);
+  return r;
+}
+
+int sc_scanner_write_to_c_file(struct sc_scanner *sc, FILE *fp, const char *scanner_id) {
+  size_t n;
+  int c, k;
+  uint8_t byte_classes[256];
+  int class_columns[256]; /* first column of each class */
+  size_t num_classes = 0;
+  if (sc->num_states > UINT16_MAX) {
+    return -1;
+  }
+  /* Columns that are identical for every state share a class */
+  for (c = 0; c < 256; ++c) {
+    for (k = 0; k < (int)num_classes; ++k) {
+      int col = class_columns[k];
+      for (n = 0; n < sc->num_states; ++n) {
+        if (sc->transition_table[256 * n + (size_t)c] != sc->transition_table[256 * n + (size_t)col]) break;
+      }
+      if (n == sc->num_states) break;
+    }
+    if (k == (int)num_classes) {
+      class_columns[num_classes++] = c;
+    }
+    byte_classes[c] = (uint8_t)k;
+  }
+  fprintf(fp, "static const uint8_t %sbyte_classes_[] = {\n", scanner_id);
+  for (c = 0; c < 256; ++c) {
+    fprintf(fp, "%s%d%s", (c & 31) ? " " : "  ", (int)byte_classes[c], (c == 255) ? "\n" : (((c & 31) == 31) ? ",\n" : ","));
+  }
+  fprintf(fp, "};\n");
+  fprintf(fp, "static const uint16_t %stransitions_[] = {\n", scanner_id);
   for (n = 0; n < sc->num_states; ++n) {
-    int c;
-    for (c = 0; c < 256; ++c) {
-      fprintf(fp, "%s%zu", c ? ", " : "  ", sc->transition_table[256 * n + (size_t)c]);
+    for (k = 0; k < (int)num_classes; ++k) {
+      fprintf(fp, "%s%zu", k ? ", " : "  ", sc->transition_table[256 * n + (size_t)class_columns[k]]);
     }
     fprintf(fp, "%s\n", (n != (sc->num_states - 1)) ? "," : "");
   }
   fprintf(fp, "};\n");
-  fprintf(fp, "static struct sc_action %s[] = {\n", state_actions_id);
+  fprintf(fp, "static const struct sc_action %sactions_[] = {\n", scanner_id);
   for (n = 0; n < sc->num_states; ++n) {
     fprintf(fp, "  {%" PRIuPTR ",%" PRIuPTR "}%s", sc->actions[n].action, sc->actions[n].variant, n == (sc->num_states - 1) ? "\n" : ",\n");
   }
   fprintf(fp, "};\n");
-  fprintf(fp, "static struct sc_scanner %s = { %u, %u, %s, %s, %u };\n", scanner_id,
-          (unsigned int)sc->num_states, (unsigned int)sc->start_state, transition_table_id, state_actions_id, (unsigned int)sc->default_action);
+  fprintf(fp, "static const struct sc_compact_scanner %s = { %u, %u, %u, %u, %sbyte_classes_, %stransitions_, %sactions_ };\n", scanner_id,
+          (unsigned int)sc->num_states, (unsigned int)sc->start_state, (unsigned int)sc->default_action, (unsigned int)num_classes,
+          scanner_id, scanner_id, scanner_id);
+  return 0;
+}
+
+int sc_scanners_write_c_file(const char *filename, const char *generated_by, size_t num_scanners, struct sc_scanner *const *scanners, const char *const *scanner_ids) {
+  size_t n;
+  int r = 0;
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) {
+    fprintf(stderr, "Error, failed to open \"%s\" for writing\n", filename);
+    return -1;
+  }
+  fprintf(fp, "/* Copyright 2020-2026 Kinglet B.V.\n"
+              " *\n"
+              " * Licensed under the Apache License, Version 2.0 (the \"License\");\n"
+              " * you may not use this file except in compliance with the License.\n"
+              " * You may obtain a copy of the License at\n"
+              " *\n"
+              " * http://www.apache.org/licenses/LICENSE-2.0\n"
+              " *\n"
+              " * Unless required by applicable law or agreed to in writing, software\n"
+              " * distributed under the License is distributed on an \"AS IS\" BASIS,\n"
+              " * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.\n"
+              " * See the License for the specific language governing permissions and\n"
+              " * limitations under the License.\n"
+              " */\n"
+              " /** NOTE: This file is generated at %s by defining GENERATE_AND_DUMP_SCANNER_TABLES (see \"make scanner-tables\") **/\n", generated_by);
+  for (n = 0; n < num_scanners; ++n) {
+    if (sc_scanner_write_to_c_file(scanners[n], fp, scanner_ids[n])) {
+      fprintf(stderr, "Error, scanner %s has too many states\n", scanner_ids[n]);
+      r = -1;
+    }
+  }
+  if (fclose(fp)) r = -1;
+  return r;
 }
@@ -79,6 +79,25 @@ struct sc_action {
   uintptr_t variant;
 };
 
+/* Scanner in the compact form in which the *_generated_scanners.c files hold their scanners as
+ * static const tables; sc_scanner_expand() turns it into an sc_scanner. Columns of the transition
+ * table that are identical for all states share a single byte class, the transition table holds
+ * num_classes cells for each state. */
+struct sc_compact_scanner {
+  size_t num_states;
+  size_t start_state;
+  size_t default_action;
+
+  /* Number of distinct byte classes, and the class of each input byte */
+  size_t num_classes;
+  const uint8_t *byte_classes;
+
+  /* num_states rows of num_classes cells each */
+  const uint16_t *transitions;
+
+  const struct sc_action *actions;
+};
+
 struct sc_scan_rule {
   const char *regexp;
 
@@ -93,7 +112,25 @@ void sc_scanner_cleanup(struct sc_scanner *sc);
 int sc_scanner_compile(struct sc_scanner *sc, uintptr_t default_action, size_t num_rules, const struct sc_scan_rule *rules);
 void sc_scanner_dump(struct sc_scanner *sc);
 
-void sc_scanner_write_to_c_file(struct sc_scanner *sc, FILE *fp, const char *transition_table_id, const char *state_actions_id, const char *scanner_id);
+/* Initializes sc from the compact scanner csc, sc should be initialized through sc_scanner_init()
+ * and cleaned up through sc_scanner_cleanup(). Returns 0 upon success, non-zero upon memory failure. */
+int sc_scanner_expand(struct sc_scanner *sc, const struct sc_compact_scanner *csc);
+
+/* Returns 0 if both scanners have identical states, transitions and actions, non-zero otherwise. */
+int sc_scanner_cmp(const struct sc_scanner *left, const struct sc_scanner *right);
+
+/* Compiles the rules and checks that the result is identical to the pregenerated csc, reporting
+ * an error about generated_file if it is not. Returns 0 if identical, non-zero otherwise. */
+int sc_scanner_verify(const struct sc_compact_scanner *csc, const char *generated_file, uintptr_t default_action, size_t num_rules, const struct sc_scan_rule *rules);
+
+/* Writes the scanner as a struct sc_compact_scanner named scanner_id, along with its tables, whose
+ * identifiers are prefixed with scanner_id. Returns 0 upon success, non-zero if the scanner has too
+ * many states for the compact form. */
+int sc_scanner_write_to_c_file(struct sc_scanner *sc, FILE *fp, const char *scanner_id);
+
+/* Writes a *_generated_scanners.c file holding the num_scanners scanners, generated_by names the
+ * function that generates the file. Returns 0 upon success, non-zero upon failure. */
+int sc_scanners_write_c_file(const char *filename, const char *generated_by, size_t num_scanners, struct sc_scanner *const *scanners, const char *const *scanner_ids);
 
 #ifdef __cplusplus
 } /* extern "C" */
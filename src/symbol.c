@@ -45,7 +45,11 @@
 
 
 void symbol_table_init(struct symbol_table *st) {
-  memset(st->hash_table_, 0, sizeof(st->hash_table_));
+  st->num_buckets_ = 0;
+  st->num_symbols_ = 0;
+  st->hash_table_ = NULL;
+  st->num_ordinals_ = 0;
+  st->by_ordinal_ = NULL;
   st->non_terminals_ = NULL;
   st->terminals_ = NULL;
 }
@@ -78,6 +82,12 @@ void symbol_table_cleanup(struct symbol_table *st) {
     } while (sym != st->terminals_);
     st->terminals_ = NULL;
   }
+  if (st->hash_table_) free(st->hash_table_);
+  st->hash_table_ = NULL;
+  st->num_buckets_ = st->num_symbols_ = 0;
+  if (st->by_ordinal_) free(st->by_ordinal_);
+  st->by_ordinal_ = NULL;
+  st->num_ordinals_ = 0;
 }
 
 
@@ -103,7 +113,7 @@ static uint8_t sym_standardize_char(uint8_t c) {
   return c;
 }
 
-static int sym_hash(const char *id) {
+static uint64_t sym_hash(const char *id) {
   uint64_t hash_value = 0;
   while (*id) {
     uint8_t c = sym_standardize_char(*(uint8_t *)id);
@@ -112,7 +122,42 @@ static int sym_hash(const char *id) {
     hash_value += c;
     id++;
   }
-  return (int)(hash_value % SYMBOL_TABLE_SIZE);
+  return hash_value;
+}
+
+static void sym_hash_insert(struct symbol **hash_table, size_t num_buckets, struct symbol *sym) {
+  size_t idx = (size_t)(sym_hash(sym->def_.translated_) % num_buckets);
+  struct symbol *last = hash_table[idx];
+  if (last) {
+    sym->hash_chain_ = last->hash_chain_;
+    last->hash_chain_ = sym;
+  }
+  else {
+    sym->hash_chain_ = sym;
+  }
+  hash_table[idx] = sym;
+}
+
+/* Rehashes all symbols into a table of num_buckets buckets, returns 0 upon success, non-zero
+ * upon memory failure, in which case the existing table is left as-is. */
+static int sym_rehash(struct symbol_table *st, size_t num_buckets) {
+  struct symbol **hash_table = (struct symbol **)calloc(num_buckets, sizeof(struct symbol *));
+  if (!hash_table) return -1;
+  struct symbol *lists[] = { st->terminals_, st->non_terminals_ };
+  size_t n;
+  for (n = 0; n < sizeof(lists) / sizeof(*lists); ++n) {
+    struct symbol *sym = lists[n];
+    if (sym) {
+      do {
+        sym = sym->next_;
+        sym_hash_insert(hash_table, num_buckets, sym);
+      } while (sym != lists[n]);
+    }
+  }
+  if (st->hash_table_) free(st->hash_table_);
+  st->hash_table_ = hash_table;
+  st->num_buckets_ = num_buckets;
+  return 0;
 }
 
 static int sym_cmp(const char *left, const char *right) {
@@ -134,19 +179,17 @@ static int sym_cmp(const char *left, const char *right) {
 }
 
 struct symbol *symbol_find_or_add(struct symbol_table *st, sym_type_t symtype, struct xlts *id, int *is_new) {
-  int idx = sym_hash(id->translated_);
-  struct symbol *sym, *last;
-  sym = last = st->hash_table_[idx];
+  struct symbol *sym;
+  sym = symbol_find(st, id->translated_);
   if (sym) {
-    do {
-      sym = sym->hash_chain_;
-
-      if (!sym_cmp(sym->def_.translated_, id->translated_)) {
-        *is_new = 0;
-        return sym;
-      }
+    *is_new = 0;
+    return sym;
+  }
 
-    } while (sym != last);
+  if (st->num_symbols_ >= st->num_buckets_) {
+    if (sym_rehash(st, st->num_buckets_ ? st->num_buckets_ * 2 + 1 : SYMBOL_TABLE_SIZE)) {
+      return NULL;
+    }
   }
 
   sym = (struct symbol *)malloc(sizeof(struct symbol));
@@ -155,13 +198,10 @@ struct symbol *symbol_find_or_add(struct symbol_table *st, sym_type_t symtype, s
   }
   symbol_init(sym);
   sym->st_ = symtype;
-  sym->hash_chain_ = last ? last->hash_chain_ : sym;
-  if (last) {
-    last->hash_chain_ = sym;
-  }
-  st->hash_table_[idx] = sym;
   sym->ordinal_ = 0;
   xlts_append(&sym->def_, id);
+  sym_hash_insert(st->hash_table_, st->num_buckets_, sym);
+  st->num_symbols_++;
   if (symtype == SYM_NONTERMINAL) {
     if (st->non_terminals_) {
       sym->next_ = st->non_terminals_->next_;
@@ -190,7 +230,8 @@ struct symbol *symbol_find_or_add(struct symbol_table *st, sym_type_t symtype, s
 
 
 struct symbol *symbol_find(struct symbol_table *st, const char *id) {
-  int idx = sym_hash(id);
+  if (!st->num_buckets_) return NULL;
+  size_t idx = (size_t)(sym_hash(id) % st->num_buckets_);
   struct symbol *sym, *last;
   sym = last = st->hash_table_[idx];
   if (sym) {
@@ -208,8 +249,51 @@ struct symbol *symbol_find(struct symbol_table *st, const char *id) {
   return NULL; /* not found */
 }
 
+int symbol_table_index_ordinals(struct symbol_table *st) {
+  struct symbol *lists[] = { st->terminals_, st->non_terminals_ };
+  size_t num_ordinals = 0;
+  size_t n;
+  for (n = 0; n < sizeof(lists) / sizeof(*lists); ++n) {
+    struct symbol *sym = lists[n];
+    if (sym) {
+      do {
+        sym = sym->next_;
+        if ((sym->ordinal_ >= 0) && ((size_t)sym->ordinal_ >= num_ordinals)) {
+          num_ordinals = (size_t)sym->ordinal_ + 1;
+        }
+      } while (sym != lists[n]);
+    }
+  }
+  struct symbol **by_ordinal = NULL;
+  if (num_ordinals) {
+    by_ordinal = (struct symbol **)calloc(num_ordinals, sizeof(struct symbol *));
+    if (!by_ordinal) return -1;
+  }
+  for (n = 0; n < sizeof(lists) / sizeof(*lists); ++n) {
+    struct symbol *sym = lists[n];
+    if (sym) {
+      do {
+        sym = sym->next_;
+        if (sym->ordinal_ >= 0) {
+          by_ordinal[sym->ordinal_] = sym;
+        }
+      } while (sym != lists[n]);
+    }
+  }
+  if (st->by_ordinal_) free(st->by_ordinal_);
+  st->by_ordinal_ = by_ordinal;
+  st->num_ordinals_ = num_ordinals;
+  return 0;
+}
+
 struct symbol *symbol_find_by_ordinal(struct symbol_table *st, int n) {
   struct symbol *sym;
+  if (st->by_ordinal_) {
+    if ((n < 0) || ((size_t)n >= st->num_ordinals_)) return NULL;
+    sym = st->by_ordinal_[n];
+    assert(!sym || (sym->ordinal_ == n));
+    return sym;
+  }
   sym = st->terminals_;
   if (sym) {
     do {
@@ -30,6 +30,7 @@
 extern "C" {
 #endif
 
+/* Initial number of hash buckets, the table grows as symbols are added */
 #define SYMBOL_TABLE_SIZE 127
 
 typedef enum sym_type_enum {
@@ -66,7 +67,17 @@ struct symbol {
 };
 
 struct symbol_table {
-  struct symbol *hash_table_[SYMBOL_TABLE_SIZE];
+  /* Each bucket points to the last symbol in its circular hash_chain_, the table is allocated
+   * upon the first symbol added, and grows to keep the number of symbols below the number of
+   * buckets. */
+  size_t num_buckets_;
+  size_t num_symbols_;
+  struct symbol **hash_table_;
+
+  /* Symbols indexed by ordinal, as built by symbol_table_index_ordinals(); NULL for ordinals
+   * that have no symbol. */
+  size_t num_ordinals_;
+  struct symbol **by_ordinal_;
 
   /* Terminals and non-terminals in order of declaration */
   struct symbol *terminals_;
@@ -87,7 +98,12 @@ struct symbol *symbol_find_or_add(struct symbol_table *st, sym_type_t symtype, s
 /* Finds a symbol, returns NULL if the symbol could not be found. */
 struct symbol *symbol_find(struct symbol_table *st, const char *id);
 
-/* Finds a symbol by its ordinal value (note: inefficient O(n) implementation!) */
+/* Indexes all symbols by their ordinal, call after assigning ordinals to the symbols, and again
+ * after any change to them. Returns 0 upon success, non-zero upon memory failure. */
+int symbol_table_index_ordinals(struct symbol_table *st);
+
+/* Finds a symbol by its ordinal value, returns NULL if no symbol has that ordinal. Constant time
+ * once symbol_table_index_ordinals() has been called, a linear search otherwise. */
 struct symbol *symbol_find_by_ordinal(struct symbol_table *st, int n);
 
 #ifdef __cplusplus
@@ -0,0 +1,376 @@
+/* Copyright 2020-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STDLIB_H_INCLUDED
+#define STDLIB_H_INCLUDED
+#include <stdlib.h>
+#endif
+
+#ifndef STDIO_H_INCLUDED
+#define STDIO_H_INCLUDED
+#include <stdio.h>
+#endif
+
+#ifndef STRING_H_INCLUDED
+#define STRING_H_INCLUDED
+#include <string.h>
+#endif
+
+#ifndef ERRNO_H_INCLUDED
+#define ERRNO_H_INCLUDED
+#include <errno.h>
+#endif
+
+#ifndef VERSION_H_INCLUDED
+#define VERSION_H_INCLUDED
+#include "version.h"
+#endif
+
+#ifndef REPORT_ERROR_H_INCLUDED
+#define REPORT_ERROR_H_INCLUDED
+#include "report_error.h"
+#endif
+
+#ifndef TEMP_OUTPUT_H_INCLUDED
+#define TEMP_OUTPUT_H_INCLUDED
+#include "temp_output.h"
+#endif
+
+#ifndef GRAMMAR_TABLE_H_INCLUDED
+#define GRAMMAR_TABLE_H_INCLUDED
+#include "grammar_table.h"
+#endif
+
+#ifndef CARBURETTA_CONTEXT_H_INCLUDED
+#define CARBURETTA_CONTEXT_H_INCLUDED
+#include "carburetta_context.h"
+#endif
+
+#ifndef TABLE_CACHE_H_INCLUDED
+#define TABLE_CACHE_H_INCLUDED
+#include "table_cache.h"
+#endif
+
+void tc_key_init(struct tc_key *key) {
+  key->num_bytes_ = key->num_bytes_allocated_ = 0;
+  key->bytes_ = NULL;
+  key->failed_ = 0;
+}
+
+void tc_key_cleanup(struct tc_key *key) {
+  if (key->bytes_) free(key->bytes_);
+}
+
+static void tc_key_append(struct tc_key *key, const void *bytes, size_t num_bytes) {
+  if (key->failed_ || !num_bytes) return;
+  if ((key->num_bytes_allocated_ - key->num_bytes_) < num_bytes) {
+    size_t new_size = key->num_bytes_allocated_ * 2 + 256;
+    if (new_size < (key->num_bytes_ + num_bytes)) new_size = key->num_bytes_ + num_bytes;
+    unsigned char *p = (unsigned char *)realloc(key->bytes_, new_size);
+    if (!p) {
+      key->failed_ = 1;
+      return;
+    }
+    key->bytes_ = p;
+    key->num_bytes_allocated_ = new_size;
+  }
+  memcpy(key->bytes_ + key->num_bytes_, bytes, num_bytes);
+  key->num_bytes_ += num_bytes;
+}
+
+static void tc_key_append_int(struct tc_key *key, int value) {
+  tc_key_append(key, &value, sizeof(value));
+}
+
+static void tc_key_append_size(struct tc_key *key, size_t value) {
+  uint64_t v = (uint64_t)value;
+  tc_key_append(key, &v, sizeof(v));
+}
+
+static void tc_key_append_str(struct tc_key *key, const char *s) {
+  /* Length first so adjacent strings cannot run into one another */
+  size_t len = s ? strlen(s) : 0;
+  tc_key_append_size(key, len);
+  tc_key_append(key, s, len);
+}
+
+int tc_make_key(struct tc_key *key, struct carburetta_context *cc, struct prd_grammar *prdg, struct grammar_table *gt, struct lr_generator *lalr,
+                int end_of_production_sym, int end_of_grammar_sym, int end_of_file_sym, int synthetic_s_sym) {
+  size_t n;
+  key->num_bytes_ = 0;
+  key->failed_ = 0;
+
+  tc_key_append(key, TC_MAGIC, 8);
+  tc_key_append_int(key, TC_VERSION);
+  tc_key_append_str(key, CARBURETTA_VERSION_STR);
+  tc_key_append_int(key, cc->utf8_experimental_ ? 1 : 0);
+
+  /* LALR input */
+  tc_key_append_int(key, end_of_production_sym);
+  tc_key_append_int(key, end_of_grammar_sym);
+  tc_key_append_int(key, end_of_file_sym);
+  tc_key_append_int(key, synthetic_s_sym);
+  tc_key_append_size(key, gt->num_ordinals_);
+  tc_key_append(key, gt->ordinals_, sizeof(int) * gt->num_ordinals_);
+  struct lr_conflict_pair *cp;
+  for (cp = lalr->conflict_resolutions_; cp; cp = cp->chain_) {
+    tc_key_append_int(key, cp->production_a_);
+    tc_key_append_int(key, cp->position_a_);
+    tc_key_append_int(key, cp->production_b_);
+    tc_key_append_int(key, cp->position_b_);
+  }
+  /* Terminates the conflict resolutions, production numbers are never negative */
+  tc_key_append_int(key, -1);
+
+  /* Scanner input; the modes in the order they are added to the scanner, the patterns in order, and
+   * the patterns each mode group applies to. */
+  size_t num_modes = 0;
+  struct mode *m = cc->modetab_.modes_;
+  if (m) {
+    do {
+      m = m->next_;
+      num_modes++;
+    } while (m != cc->modetab_.modes_);
+  }
+  tc_key_append_size(key, num_modes);
+  m = cc->modetab_.modes_;
+  if (m) {
+    do {
+      m = m->next_;
+      tc_key_append_str(key, m->def_.translated_);
+    } while (m != cc->modetab_.modes_);
+  }
+  tc_key_append_size(key, prdg->num_patterns_);
+  for (n = 0; n < prdg->num_patterns_; ++n) {
+    tc_key_append_str(key, prdg->patterns_[n].regex_);
+  }
+  tc_key_append_size(key, prdg->num_mode_groups_);
+  for (n = 0; n < prdg->num_mode_groups_; ++n) {
+    struct prd_mode_group *mg = prdg->mode_groups_ + n;
+    size_t mode_idx;
+    tc_key_append_size(key, mg->pattern_start_index_);
+    tc_key_append_size(key, mg->pattern_end_index_);
+    tc_key_append_size(key, mg->num_modes_);
+    for (mode_idx = 0; mode_idx < mg->num_modes_; ++mode_idx) {
+      tc_key_append_str(key, mg->modes_[mode_idx].id_.translated_);
+    }
+  }
+
+  return key->failed_ ? -1 : 0;
+}
+
+void tc_tables_init(struct tc_tables *tables) {
+  tables->nr_states_ = 0;
+  tables->num_parse_table_cells_ = 0;
+  tables->parse_table_ = NULL;
+  tables->num_dfa_values_ = 0;
+  tables->dfa_values_ = NULL;
+  tables->num_utf8_decoder_rows_ = 0;
+  tables->utf8_decoder_ = NULL;
+}
+
+void tc_tables_cleanup(struct tc_tables *tables) {
+  if (tables->parse_table_) free(tables->parse_table_);
+  if (tables->dfa_values_) free(tables->dfa_values_);
+  if (tables->utf8_decoder_) free(tables->utf8_decoder_);
+}
+
+#define TC_FNV1A_BASIS 0xcbf29ce484222325ULL
+
+/* 64 bit FNV-1a, continuing from hash */
+static uint64_t tc_fnv1a(uint64_t hash, const void *data, size_t num_bytes) {
+  const unsigned char *p = (const unsigned char *)data;
+  size_t n;
+  for (n = 0; n < num_bytes; ++n) {
+    hash ^= p[n];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/* Checksum over everything following the header */
+static uint64_t tc_checksum(const struct tc_key *key, const struct tc_tables *tables, uint64_t num_utf8_decoder_rows) {
+  uint64_t hash = TC_FNV1A_BASIS;
+  hash = tc_fnv1a(hash, key->bytes_, key->num_bytes_);
+  hash = tc_fnv1a(hash, tables->parse_table_, sizeof(int) * tables->num_parse_table_cells_);
+  hash = tc_fnv1a(hash, tables->dfa_values_, sizeof(uint32_t) * tables->num_dfa_values_);
+  hash = tc_fnv1a(hash, tables->utf8_decoder_, sizeof(int) * 256 * (size_t)num_utf8_decoder_rows);
+  return hash;
+}
+
+/* Returns the malloc'ed path of the cache file for key in cache_dir, or NULL upon memory failure */
+static char *tc_path(const char *cache_dir, const struct tc_key *key) {
+  static const char hex[] = "0123456789abcdef";
+  /* Collisions are caught by comparing the key stored in the file */
+  uint64_t hash = tc_fnv1a(TC_FNV1A_BASIS, key->bytes_, key->num_bytes_);
+  size_t n;
+
+  size_t dir_len = strlen(cache_dir);
+  const char *ext = ".cbtables";
+  char *path = (char *)malloc(dir_len + 1 + 16 + strlen(ext) + 1);
+  if (!path) return NULL;
+  char *p = path;
+  memcpy(p, cache_dir, dir_len);
+  p += dir_len;
+  if (!dir_len || ((p[-1] != '/') && (p[-1] != '\\'))) {
+    *p++ = '/';
+  }
+  for (n = 0; n < 16; ++n) {
+    *p++ = hex[(hash >> (60 - 4 * n)) & 0xF];
+  }
+  strcpy(p, ext);
+  return path;
+}
+
+/* Allocates and reads num_elements elements of element_size from fp, returns NULL upon failure */
+static void *tc_read_array(FILE *fp, uint64_t num_elements, size_t element_size, uint64_t *pbytes_left) {
+  if (num_elements > (*pbytes_left / element_size)) {
+    /* More than the file holds */
+    return NULL;
+  }
+  size_t num_bytes = (size_t)num_elements * element_size;
+  void *p = malloc(num_bytes ? num_bytes : 1);
+  if (!p) return NULL;
+  if (num_bytes && (fread(p, 1, num_bytes, fp) != num_bytes)) {
+    free(p);
+    return NULL;
+  }
+  *pbytes_left -= num_bytes;
+  return p;
+}
+
+int tc_load(const char *cache_dir, const struct tc_key *key, struct tc_tables *tables) {
+  FILE *fp = NULL;
+  unsigned char *key_bytes = NULL;
+  struct tc_header hdr;
+  struct tc_tables loaded;
+  tc_tables_init(&loaded);
+
+  char *path = tc_path(cache_dir, key);
+  if (!path) return -1;
+  fp = fopen(path, "rb");
+  free(path);
+  if (!fp) return -1;
+
+  if (fseek(fp, 0, SEEK_END)) goto fail;
+  long file_size = ftell(fp);
+  if ((file_size < (long)sizeof(hdr)) || fseek(fp, 0, SEEK_SET)) goto fail;
+  uint64_t bytes_left = (uint64_t)file_size - sizeof(hdr);
+
+  if (fread(&hdr, sizeof(hdr), 1, fp) != 1) goto fail;
+  if (memcmp(hdr.magic_, TC_MAGIC, sizeof(hdr.magic_)) ||
+      (hdr.version_ != TC_VERSION) ||
+      (hdr.byte_order_ != TC_BYTE_ORDER) ||
+      (hdr.int_size_ != sizeof(int)) ||
+      (hdr.key_size_ != key->num_bytes_)) {
+    goto fail;
+  }
+
+  key_bytes = (unsigned char *)tc_read_array(fp, hdr.key_size_, 1, &bytes_left);
+  if (!key_bytes || memcmp(key_bytes, key->bytes_, key->num_bytes_)) goto fail;
+
+  loaded.nr_states_ = (int)hdr.nr_states_;
+  loaded.num_parse_table_cells_ = (size_t)hdr.num_parse_table_cells_;
+  loaded.parse_table_ = (int *)tc_read_array(fp, hdr.num_parse_table_cells_, sizeof(int), &bytes_left);
+  if (!loaded.parse_table_) goto fail;
+
+  loaded.num_dfa_values_ = (size_t)hdr.num_dfa_values_;
+  loaded.dfa_values_ = (uint32_t *)tc_read_array(fp, hdr.num_dfa_values_, sizeof(uint32_t), &bytes_left);
+  if (!loaded.dfa_values_) goto fail;
+
+  if (hdr.num_utf8_decoder_rows_) {
+    loaded.num_utf8_decoder_rows_ = (size_t)hdr.num_utf8_decoder_rows_;
+    if (hdr.num_utf8_decoder_rows_ > (UINT64_MAX / 256)) goto fail;
+    loaded.utf8_decoder_ = (int *)tc_read_array(fp, hdr.num_utf8_decoder_rows_ * 256, sizeof(int), &bytes_left);
+    if (!loaded.utf8_decoder_) goto fail;
+  }
+
+  if (bytes_left) goto fail;
+
+  /* The key matching does not mean the tables are intact */
+  if (tc_checksum(key, &loaded, hdr.num_utf8_decoder_rows_) != hdr.checksum_) goto fail;
+
+  fclose(fp);
+  free(key_bytes);
+  tc_tables_cleanup(tables);
+  *tables = loaded;
+  return 0;
+
+fail:
+  if (fp) fclose(fp);
+  if (key_bytes) free(key_bytes);
+  tc_tables_cleanup(&loaded);
+  return -1;
+}
+
+int tc_store(const char *cache_dir, const struct tc_key *key, const struct tc_tables *tables) {
+  char *temp_path = NULL;
+  FILE *fp = NULL;
+  char *path = tc_path(cache_dir, key);
+  if (!path) {
+    re_error_nowhere("Warning: no memory to write table cache");
+    return -1;
+  }
+
+  struct tc_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic_, TC_MAGIC, sizeof(hdr.magic_));
+  hdr.version_ = TC_VERSION;
+  hdr.byte_order_ = TC_BYTE_ORDER;
+  hdr.int_size_ = (uint32_t)sizeof(int);
+  hdr.nr_states_ = (uint32_t)tables->nr_states_;
+  hdr.key_size_ = key->num_bytes_;
+  hdr.num_parse_table_cells_ = tables->num_parse_table_cells_;
+  hdr.num_dfa_values_ = tables->num_dfa_values_;
+  hdr.num_utf8_decoder_rows_ = tables->utf8_decoder_ ? tables->num_utf8_decoder_rows_ : 0;
+  hdr.checksum_ = tc_checksum(key, tables, hdr.num_utf8_decoder_rows_);
+
+  fp = to_make_temp(path, &temp_path);
+  if (!fp) goto fail;
+
+  if ((fwrite(&hdr, sizeof(hdr), 1, fp) != 1) ||
+      (fwrite(key->bytes_, 1, key->num_bytes_, fp) != key->num_bytes_) ||
+      (fwrite(tables->parse_table_, sizeof(int), tables->num_parse_table_cells_, fp) != tables->num_parse_table_cells_) ||
+      (tables->num_dfa_values_ && (fwrite(tables->dfa_values_, sizeof(uint32_t), tables->num_dfa_values_, fp) != tables->num_dfa_values_)) ||
+      (hdr.num_utf8_decoder_rows_ && (fwrite(tables->utf8_decoder_, sizeof(int) * 256, tables->num_utf8_decoder_rows_, fp) != tables->num_utf8_decoder_rows_))) {
+    goto fail;
+  }
+  int close_failed = fclose(fp);
+  fp = NULL;
+  if (close_failed) goto fail;
+
+#ifdef _WIN32
+  /* rename() does not replace an existing file on Windows; another process may have written the same entry */
+  remove(path);
+#endif
+  if (rename(temp_path, path)) goto fail;
+
+  free(temp_path);
+  free(path);
+  return 0;
+
+fail:
+  {
+    int err = errno;
+    re_error_nowhere("Warning: failed to write table cache file \"%s\": %s", path, strerror(err));
+  }
+  if (fp) fclose(fp);
+  if (temp_path) {
+    remove(temp_path);
+    free(temp_path);
+  }
+  free(path);
+  return -1;
+}
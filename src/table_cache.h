@@ -0,0 +1,119 @@
+/* Copyright 2020-2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TABLE_CACHE_H
+#define TABLE_CACHE_H
+
+#ifndef STDDEF_H_INCLUDED
+#define STDDEF_H_INCLUDED
+#include <stddef.h>
+#endif
+
+#ifndef STDINT_H_INCLUDED
+#define STDINT_H_INCLUDED
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct carburetta_context;
+struct prd_grammar;
+struct grammar_table;
+struct lr_generator;
+
+/* On-disk cache of the tables that are expensive to construct: the LALR parse table, the scanner
+ * DFA (as flattened by rex_dfa_save()) and the UTF-8 decoder table. The tables only depend on the
+ * structure of the grammar; the symbols and productions as numbered for the LALR generator, the
+ * %prefer/%over conflict resolutions, and the patterns and their modes. Action code, types and
+ * other directives do not affect them, so editing those reuses the cached tables.
+ *
+ * Each cache file holds the tables for one key, the filename is a hash of the key. The file is a
+ * tc_header, followed by key_size_ bytes of key, the parse table, the DFA values and the UTF-8
+ * decoder table. All is in the byte order of the machine that wrote the file, byte_order_ rejects
+ * files from machines of another byte order. The key stored in the file is compared against the
+ * key looked for in its entirety, so a hash collision is a cache miss, not a wrong table, and a
+ * checksum rejects files that were damaged. */
+
+#define TC_MAGIC "CBRTTBL\x1A"
+
+/* Increment when table construction changes in a way that changes the tables for the same key */
+#define TC_VERSION 1
+
+#define TC_BYTE_ORDER 0x01020304
+
+struct tc_header {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t byte_order_;
+  uint32_t int_size_;
+  uint32_t nr_states_;
+  uint64_t key_size_;
+  uint64_t num_parse_table_cells_;
+  uint64_t num_dfa_values_;
+  uint64_t num_utf8_decoder_rows_;
+  uint64_t checksum_; /* 64 bit FNV-1a of the key and tables that follow the header */
+};
+
+/* Bytes that uniquely identify the structure of a grammar */
+struct tc_key {
+  size_t num_bytes_;
+  size_t num_bytes_allocated_;
+  unsigned char *bytes_;
+  int failed_:1;
+};
+
+/* Tables as loaded from, or to be stored to, the cache. Arrays loaded by tc_load() are owned by
+ * the tc_tables and freed by tc_tables_cleanup(), unless ownership is taken by setting them to NULL. */
+struct tc_tables {
+  int nr_states_;
+  size_t num_parse_table_cells_;
+  int *parse_table_;
+
+  size_t num_dfa_values_;
+  uint32_t *dfa_values_;
+
+  /* 256 columns for each row, NULL if the grammar has no UTF-8 decoder (--x-raw or no patterns) */
+  size_t num_utf8_decoder_rows_;
+  int *utf8_decoder_;
+};
+
+void tc_key_init(struct tc_key *key);
+void tc_key_cleanup(struct tc_key *key);
+
+/* Fills in the key for the grammar, after it has been transcribed to gt and the conflict
+ * resolutions have been added to lalr, but before the parse table is generated.
+ * Returns 0 upon success, non-zero upon memory failure. */
+int tc_make_key(struct tc_key *key, struct carburetta_context *cc, struct prd_grammar *prdg, struct grammar_table *gt, struct lr_generator *lalr,
+                int end_of_production_sym, int end_of_grammar_sym, int end_of_file_sym, int synthetic_s_sym);
+
+void tc_tables_init(struct tc_tables *tables);
+void tc_tables_cleanup(struct tc_tables *tables);
+
+/* Loads the tables for key from the cache in cache_dir. Returns 0 if the tables were found,
+ * non-zero if they were not (or could not be read); a miss is not reported as an error. */
+int tc_load(const char *cache_dir, const struct tc_key *key, struct tc_tables *tables);
+
+/* Stores the tables for key in the cache in cache_dir. The file is written under a temporary name
+ * first and then renamed, so concurrent runs never see a partial file.
+ * Returns 0 upon success, non-zero upon failure, in which case a warning has been reported. */
+int tc_store(const char *cache_dir, const struct tc_key *key, const struct tc_tables *tables);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* TABLE_CACHE_H */
@@ -0,0 +1,313 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STDLIB_H_INCLUDED
+#define STDLIB_H_INCLUDED
+#include <stdlib.h>
+#endif
+
+#ifndef STDIO_H_INCLUDED
+#define STDIO_H_INCLUDED
+#include <stdio.h>
+#endif
+
+#ifndef STRING_H_INCLUDED
+#define STRING_H_INCLUDED
+#include <string.h>
+#endif
+
+#ifndef STDINT_H_INCLUDED
+#define STDINT_H_INCLUDED
+#include <stdint.h>
+#endif
+
+#ifndef REPORT_ERROR_H_INCLUDED
+#define REPORT_ERROR_H_INCLUDED
+#include "report_error.h"
+#endif
+
+#ifndef CARBURETTA_CONTEXT_H_INCLUDED
+#define CARBURETTA_CONTEXT_H_INCLUDED
+#include "carburetta_context.h"
+#endif
+
+#ifndef EMIT_C_H_INCLUDED
+#define EMIT_C_H_INCLUDED
+#include "emit_c.h"
+#endif
+
+#ifndef TABLE_IMAGE_H_INCLUDED
+#define TABLE_IMAGE_H_INCLUDED
+#include "table_image.h"
+#endif
+
+#ifndef CBRT_TABLES_H_INCLUDED
+#define CBRT_TABLES_H_INCLUDED
+#include "../runtime/cbrt_tables.h"
+#endif
+
+/* Image under construction; sections are appended at offsets aligned to 8 bytes */
+struct ti_image {
+  size_t num_bytes_;
+  size_t num_bytes_allocated_;
+  unsigned char *bytes_;
+  int failed_:1;
+};
+
+static void ti_image_init(struct ti_image *img) {
+  img->num_bytes_ = img->num_bytes_allocated_ = 0;
+  img->bytes_ = NULL;
+  img->failed_ = 0;
+}
+
+static void ti_image_cleanup(struct ti_image *img) {
+  if (img->bytes_) free(img->bytes_);
+}
+
+/* Appends num_bytes of bytes (or zeroes if bytes is NULL), returns the offset at which they start */
+static uint32_t ti_append(struct ti_image *img, const void *bytes, size_t num_bytes) {
+  size_t offset = (img->num_bytes_ + 7) & ~(size_t)7;
+  if (img->failed_) return 0;
+  if ((offset > UINT32_MAX) || (num_bytes > (UINT32_MAX - offset))) {
+    img->failed_ = 1;
+    return 0;
+  }
+  if ((offset + num_bytes) > img->num_bytes_allocated_) {
+    size_t new_size = img->num_bytes_allocated_ * 2 + 4096;
+    if (new_size < (offset + num_bytes)) new_size = offset + num_bytes;
+    unsigned char *p = (unsigned char *)realloc(img->bytes_, new_size);
+    if (!p) {
+      img->failed_ = 1;
+      return 0;
+    }
+    img->bytes_ = p;
+    img->num_bytes_allocated_ = new_size;
+  }
+  memset(img->bytes_ + img->num_bytes_, 0, offset - img->num_bytes_);
+  if (bytes) {
+    memcpy(img->bytes_ + offset, bytes, num_bytes);
+  }
+  else {
+    memset(img->bytes_ + offset, 0, num_bytes);
+  }
+  img->num_bytes_ = offset + num_bytes;
+  return (uint32_t)offset;
+}
+
+/* Appends the ints as int32_t values */
+static uint32_t ti_append_ints(struct ti_image *img, const int *values, size_t num_values) {
+  size_t n;
+  if (num_values > (SIZE_MAX / sizeof(int32_t))) {
+    img->failed_ = 1;
+    return 0;
+  }
+  uint32_t offset = ti_append(img, NULL, num_values * sizeof(int32_t));
+  if (img->failed_) return 0;
+  int32_t *dst = (int32_t *)(img->bytes_ + offset);
+  for (n = 0; n < num_values; ++n) {
+    dst[n] = (int32_t)values[n];
+  }
+  return offset;
+}
+
+/* Appends a NUL terminated string to the strings under construction, returns its offset */
+static uint32_t ti_append_string(struct ti_image *strings, const char *s) {
+  size_t len = strlen(s) + 1;
+  size_t offset = strings->num_bytes_;
+  if (strings->failed_) return 0;
+  if ((offset > UINT32_MAX) || (len > (UINT32_MAX - offset))) {
+    strings->failed_ = 1;
+    return 0;
+  }
+  if ((offset + len) > strings->num_bytes_allocated_) {
+    size_t new_size = strings->num_bytes_allocated_ * 2 + 1024;
+    if (new_size < (offset + len)) new_size = offset + len;
+    unsigned char *p = (unsigned char *)realloc(strings->bytes_, new_size);
+    if (!p) {
+      strings->failed_ = 1;
+      return 0;
+    }
+    strings->bytes_ = p;
+    strings->num_bytes_allocated_ = new_size;
+  }
+  memcpy(strings->bytes_ + offset, s, len);
+  strings->num_bytes_ += len;
+  return (uint32_t)offset;
+}
+
+int ti_make_tables(struct carburetta_context *cc, struct prd_grammar *prdg, struct rex_scanner *rex, struct lr_generator *lalr, void **pimage, size_t *pimage_size) {
+  int r = -1;
+  struct ti_image img, strings;
+  ti_image_init(&img);
+  ti_image_init(&strings);
+  struct cbrt_tables_header header;
+  memset(&header, 0, sizeof(header));
+  int *scan_table = NULL;
+  uint32_t *scan_actions = NULL;
+  int *pattern_syms = NULL;
+  uint32_t *mode_start_states = NULL, *mode_names = NULL;
+  uint32_t *production_lengths = NULL;
+  int *production_syms = NULL;
+  uint32_t *sym_names = NULL;
+  size_t n;
+
+  memcpy(header.magic_, CBRT_TABLES_MAGIC, sizeof(header.magic_));
+  header.version_ = CBRT_TABLES_VERSION;
+  header.byte_order_ = CBRT_TABLES_BYTE_ORDER;
+
+  /* The header goes first, it is filled in once all offsets are known */
+  ti_append(&img, NULL, sizeof(header));
+
+  /* The first string is the empty string, for symbols without a name */
+  ti_append_string(&strings, "");
+
+  if (prdg->num_patterns_) {
+    size_t num_rows, num_columns;
+    if (cc->utf8_experimental_) {
+      header.flags_ |= CBRT_TABLES_UTF8;
+      if (emit_scan_table_grouped(&rex->dfa_, &num_rows, &num_columns, &scan_table)) goto cleanup_exit;
+    }
+    else {
+      num_columns = 256 + 4;
+      if (emit_scan_table_raw(&rex->dfa_, &num_rows, &scan_table)) goto cleanup_exit;
+    }
+    header.num_scan_states_ = (uint32_t)num_rows;
+    header.num_scan_columns_ = (uint32_t)num_columns;
+    header.scan_table_ = ti_append_ints(&img, scan_table, num_rows * num_columns);
+
+    scan_actions = (uint32_t *)calloc(num_rows, sizeof(uint32_t));
+    if (!scan_actions) goto no_memory;
+    struct rex_dfa_node *dn = rex->dfa_.nodes_;
+    if (dn) {
+      do {
+        dn = dn->chain_;
+        scan_actions[dn->ordinal_] = dn->pattern_matched_ ? (uint32_t)dn->pattern_matched_->action_ : 0;
+      } while (dn != rex->dfa_.nodes_);
+    }
+    header.scan_actions_ = ti_append(&img, scan_actions, num_rows * sizeof(uint32_t));
+
+    if (cc->utf8_experimental_) {
+      header.num_utf8_decoder_rows_ = (uint32_t)cc->utf8_decoder_num_rows_;
+      header.utf8_decoder_ = ti_append_ints(&img, cc->utf8_decoder_table_, cc->utf8_decoder_num_rows_ * 256);
+    }
+
+    pattern_syms = (int *)malloc(prdg->num_patterns_ * sizeof(int));
+    if (!pattern_syms) goto no_memory;
+    for (n = 0; n < prdg->num_patterns_; ++n) {
+      struct symbol *sym = prdg->patterns_[n].term_.sym_;
+      pattern_syms[n] = sym ? sym->ordinal_ : -1;
+    }
+    header.num_patterns_ = (uint32_t)prdg->num_patterns_;
+    header.pattern_syms_ = ti_append_ints(&img, pattern_syms, prdg->num_patterns_);
+
+    size_t num_modes = cc->modetab_.num_modes_;
+    mode_start_states = (uint32_t *)malloc(num_modes * sizeof(uint32_t));
+    mode_names = (uint32_t *)malloc(num_modes * sizeof(uint32_t));
+    if (!mode_start_states || !mode_names) goto no_memory;
+    struct mode *default_mode = mode_find(&cc->modetab_, "default");
+    struct mode *m = cc->modetab_.modes_;
+    n = 0;
+    if (m) {
+      do {
+        m = m->next_;
+        if (m == default_mode) header.default_mode_ = (uint32_t)n;
+        mode_start_states[n] = (uint32_t)m->rex_mode_->dfa_node_->ordinal_;
+        mode_names[n] = ti_append_string(&strings, m->def_.translated_);
+        n++;
+      } while (m != cc->modetab_.modes_);
+    }
+    header.num_modes_ = (uint32_t)n;
+    header.mode_start_states_ = ti_append(&img, mode_start_states, n * sizeof(uint32_t));
+    header.mode_names_ = ti_append(&img, mode_names, n * sizeof(uint32_t));
+  }
+
+  size_t num_columns = (size_t)(1 + lalr->max_sym_ - lalr->min_sym_);
+  header.num_parse_states_ = (uint32_t)lalr->nr_states_;
+  header.num_parse_columns_ = (uint32_t)num_columns;
+  header.min_sym_ = lalr->min_sym_;
+  header.input_end_sym_ = cc->input_end_sym_->ordinal_;
+  header.error_sym_ = cc->error_sym_->ordinal_;
+  header.parse_table_ = ti_append_ints(&img, lalr->parse_table_, (size_t)lalr->nr_states_ * num_columns);
+
+  production_lengths = (uint32_t *)malloc(lalr->nr_productions_ * sizeof(uint32_t));
+  production_syms = (int *)malloc(lalr->nr_productions_ * sizeof(int));
+  if (!production_lengths || !production_syms) goto no_memory;
+  for (n = 0; n < lalr->nr_productions_; ++n) {
+    production_lengths[n] = (uint32_t)lalr->production_lengths_[n];
+    production_syms[n] = lalr->productions_[n][0];
+  }
+  header.num_productions_ = (uint32_t)lalr->nr_productions_;
+  header.production_lengths_ = ti_append(&img, production_lengths, lalr->nr_productions_ * sizeof(uint32_t));
+  header.production_syms_ = ti_append_ints(&img, production_syms, lalr->nr_productions_);
+
+  size_t num_syms = (size_t)lalr->max_sym_ + 1;
+  sym_names = (uint32_t *)calloc(num_syms, sizeof(uint32_t));
+  if (!sym_names) goto no_memory;
+  for (n = 0; n < num_syms; ++n) {
+    struct symbol *sym = symbol_find_by_ordinal(&cc->symtab_, (int)n);
+    if (sym) sym_names[n] = ti_append_string(&strings, sym->def_.translated_);
+  }
+  header.num_syms_ = (uint32_t)num_syms;
+  header.sym_names_ = ti_append(&img, sym_names, num_syms * sizeof(uint32_t));
+
+  if (strings.failed_) goto no_memory;
+  header.strings_size_ = (uint32_t)strings.num_bytes_;
+  header.strings_ = ti_append(&img, strings.bytes_, strings.num_bytes_);
+
+  /* Pad the image to a multiple of 8 so images can be concatenated or embedded back to back */
+  ti_append(&img, NULL, 0);
+
+  if (img.failed_) {
+    re_error_nowhere("Error, tables image too large or no memory");
+    goto cleanup_exit;
+  }
+  header.image_size_ = (uint32_t)img.num_bytes_;
+  memcpy(img.bytes_, &header, sizeof(header));
+
+  *pimage = img.bytes_;
+  *pimage_size = img.num_bytes_;
+  img.bytes_ = NULL;
+
+  r = 0;
+  goto cleanup_exit;
+
+no_memory:
+  re_error_nowhere("Error, no memory");
+cleanup_exit:
+  if (scan_table) free(scan_table);
+  if (scan_actions) free(scan_actions);
+  if (pattern_syms) free(pattern_syms);
+  if (mode_start_states) free(mode_start_states);
+  if (mode_names) free(mode_names);
+  if (production_lengths) free(production_lengths);
+  if (production_syms) free(production_syms);
+  if (sym_names) free(sym_names);
+  ti_image_cleanup(&strings);
+  ti_image_cleanup(&img);
+  return r;
+}
+
+int ti_write_tables(FILE *fp, struct carburetta_context *cc, struct prd_grammar *prdg, struct rex_scanner *rex, struct lr_generator *lalr) {
+  void *image = NULL;
+  size_t image_size = 0;
+  int r = ti_make_tables(cc, prdg, rex, lalr, &image, &image_size);
+  if (r) return r;
+  if (image_size != fwrite(image, 1, image_size, fp)) {
+    re_error_nowhere("Error, failed to write tables");
+    r = -1;
+  }
+  free(image);
+  return r;
+}
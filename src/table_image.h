@@ -0,0 +1,53 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TABLE_IMAGE_H
+#define TABLE_IMAGE_H
+
+#ifndef STDIO_H_INCLUDED
+#define STDIO_H_INCLUDED
+#include <stdio.h>
+#endif
+
+#ifndef STDDEF_H_INCLUDED
+#define STDDEF_H_INCLUDED
+#include <stddef.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct carburetta_context;
+struct prd_grammar;
+struct rex_scanner;
+struct lr_generator;
+
+/* Builds the scanner and parse tables of the grammar as a tables image, in the format described
+ * in runtime/cbrt_tables.h, for the generic driver in runtime/cbrt_tables.c to load at runtime.
+ * In --x-utf8 mode cc->utf8_decoder_table_ must already hold the UTF-8 decoder table if the
+ * grammar has patterns. Upon success returns 0 and the image in *pimage, allocated with malloc()
+ * and owned by the caller, and its size in *pimage_size. Returns non-zero upon failure, in which
+ * case an error has been reported. */
+int ti_make_tables(struct carburetta_context *cc, struct prd_grammar *prdg, struct rex_scanner *rex, struct lr_generator *lalr, void **pimage, size_t *pimage_size);
+
+/* As ti_make_tables(), writes the image to fp (--tables) */
+int ti_write_tables(FILE *fp, struct carburetta_context *cc, struct prd_grammar *prdg, struct rex_scanner *rex, struct lr_generator *lalr);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* TABLE_IMAGE_H */
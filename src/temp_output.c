@@ -207,3 +207,22 @@ FILE *to_make_temp(const char *final_destination_file, char **temp_filenamep) {
   /* Failed */
   return NULL;
 }
+
+int to_same_content(const char *filename_a, const char *filename_b) {
+  int same = 0;
+  FILE *fpa = fopen(filename_a, "rb");
+  FILE *fpb = fopen(filename_b, "rb");
+  if (fpa && fpb) {
+    char bufa[4096], bufb[4096];
+    size_t numa, numb;
+    do {
+      numa = fread(bufa, 1, sizeof(bufa), fpa);
+      numb = fread(bufb, 1, sizeof(bufb), fpb);
+      if ((numa != numb) || memcmp(bufa, bufb, numa)) break;
+    } while (numa == sizeof(bufa));
+    same = (numa == numb) && (numa < sizeof(bufa)) && !ferror(fpa) && !ferror(fpb) && !memcmp(bufa, bufb, numa);
+  }
+  if (fpa) fclose(fpa);
+  if (fpb) fclose(fpb);
+  return same;
+}
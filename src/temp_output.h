@@ -29,6 +29,9 @@ FILE *to_make_temp(const char *final_destination_file, char **temp_filenamep);
 
 char *to_derive_temp_name(const char *final_destination_name);
 
+/* Returns non-zero if both files could be read and their content is identical, zero otherwise. */
+int to_same_content(const char *filename_a, const char *filename_b);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -33,10 +33,16 @@
 #include "tokens.h"
 #endif
 
-/* Uncommenting this will dynamically generate the scan tables and write these into files (see tok_init()). */
-/* #define GENERATE_AND_DUMP_SCANNER_TABLES */
+/* Defining GENERATE_AND_DUMP_SCANNER_TABLES will dynamically generate the scan tables and write these into
+ * src/tokens_generated_scanners.c (see tok_init() and "make scanner-tables"); defining VERIFY_GENERATED_SCANNER_TABLES
+ * checks the pregenerated tables against the dynamically generated ones. */
+
+#if defined(GENERATE_AND_DUMP_SCANNER_TABLES) || defined(VERIFY_GENERATED_SCANNER_TABLES)
+#if __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-braces"
+#endif
 
-#ifdef GENERATE_AND_DUMP_SCANNER_TABLES 
 static const struct sc_scan_rule g_scanner_rules_[] = {
 #define xx(regex, minor) { regex, minor, minor },
 #define xy(regex, minor, major) { regex, minor, major},
@@ -67,23 +73,26 @@ static const struct sc_scan_rule g_scanner_regex_rules_[] = {
 #undef xz
 };
 
+#if __GNUC__
+#pragma GCC diagnostic pop
+#endif
 #endif
 
-#ifdef GENERATE_AND_DUMP_SCANNER_TABLES
 static struct sc_scanner g_tok_c_ident_scanner_;
 static struct sc_scanner g_tok_nonterminal_ident_scanner_;
 static struct sc_scanner g_tok_regex_scanner_;
-#else
+
+#ifndef GENERATE_AND_DUMP_SCANNER_TABLES
 #include "tokens_generated_scanners.c"
 #endif
 
 int tok_init(void) {
-#ifdef GENERATE_AND_DUMP_SCANNER_TABLES
   int r;
   sc_scanner_init(&g_tok_c_ident_scanner_);
   sc_scanner_init(&g_tok_nonterminal_ident_scanner_);
   sc_scanner_init(&g_tok_regex_scanner_);
 
+#ifdef GENERATE_AND_DUMP_SCANNER_TABLES
   r = sc_scanner_compile(&g_tok_c_ident_scanner_, TOK_NO_MATCH, sizeof(g_scanner_rules_) / sizeof(*g_scanner_rules_), g_scanner_rules_);
   if (r) return r;
 
@@ -93,36 +102,38 @@ int tok_init(void) {
   r = sc_scanner_compile(&g_tok_regex_scanner_, TOK_NO_MATCH, sizeof(g_scanner_regex_rules_) / sizeof(*g_scanner_regex_rules_), g_scanner_regex_rules_);
   if (r) return r;
 
-  FILE *fp = fopen("src/tokens_generated_scanners.c", "wb");
-  fprintf(fp, "/* Copyright 2020-2023 Kinglet B.V.\n"
-              " *\n"
-              " * Licensed under the Apache License, Version 2.0 (the \"License\");\n"
-              " * you may not use this file except in compliance with the License.\n"
-              " * You may obtain a copy of the License at\n"
-              " *\n"
-              " * http://www.apache.org/licenses/LICENSE-2.0\n"
-              " *\n"
-              " * Unless required by applicable law or agreed to in writing, software\n"
-              " * distributed under the License is distributed on an \"AS IS\" BASIS,\n"
-              " * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.\n"
-              " * See the License for the specific language governing permissions and\n"
-              " * limitations under the License.\n"
-              " */\n"
-              " /** NOTE: This file is generated at tok_init() in tokens.c by defining GENERATE_AND_DUMP_SCANNER_TABLES **/\n");
-  sc_scanner_write_to_c_file(&g_tok_c_ident_scanner_, fp, "g_tok_c_ident_scanner_transition_table_", "g_tok_c_ident_scanner_state_actions_", "g_tok_c_ident_scanner_");
-  sc_scanner_write_to_c_file(&g_tok_nonterminal_ident_scanner_, fp, "g_tok_nonterminal_ident_scanner_transition_table_", "g_tok_nonterminal_ident_scanner_state_actions_", "g_tok_nonterminal_ident_scanner_");
-  sc_scanner_write_to_c_file(&g_tok_regex_scanner_, fp, "g_tok_regex_scanner_transition_table_", "g_tok_regex_scanner_state_actions_", "g_tok_regex_scanner_");
-  fclose(fp);
+  struct sc_scanner *const scanners[] = { &g_tok_c_ident_scanner_, &g_tok_nonterminal_ident_scanner_, &g_tok_regex_scanner_ };
+  const char *const scanner_ids[] = { "g_tok_c_ident_compact_scanner_", "g_tok_nonterminal_ident_compact_scanner_", "g_tok_regex_compact_scanner_" };
+  r = sc_scanners_write_c_file("src/tokens_generated_scanners.c", "tok_init() in tokens.c", sizeof(scanners) / sizeof(*scanners), scanners, scanner_ids);
+  if (r) return r;
+#else
+#ifdef VERIFY_GENERATED_SCANNER_TABLES
+  r = sc_scanner_verify(&g_tok_c_ident_compact_scanner_, "src/tokens_generated_scanners.c", TOK_NO_MATCH, sizeof(g_scanner_rules_) / sizeof(*g_scanner_rules_), g_scanner_rules_);
+  if (r) return r;
+
+  r = sc_scanner_verify(&g_tok_nonterminal_ident_compact_scanner_, "src/tokens_generated_scanners.c", TOK_NO_MATCH, sizeof(g_scanner_production_rules_) / sizeof(*g_scanner_production_rules_), g_scanner_production_rules_);
+  if (r) return r;
+
+  r = sc_scanner_verify(&g_tok_regex_compact_scanner_, "src/tokens_generated_scanners.c", TOK_NO_MATCH, sizeof(g_scanner_regex_rules_) / sizeof(*g_scanner_regex_rules_), g_scanner_regex_rules_);
+  if (r) return r;
+#endif
+
+  r = sc_scanner_expand(&g_tok_c_ident_scanner_, &g_tok_c_ident_compact_scanner_);
+  if (r) return r;
+
+  r = sc_scanner_expand(&g_tok_nonterminal_ident_scanner_, &g_tok_nonterminal_ident_compact_scanner_);
+  if (r) return r;
+
+  r = sc_scanner_expand(&g_tok_regex_scanner_, &g_tok_regex_compact_scanner_);
+  if (r) return r;
 #endif
   return 0;
 }
 
 void tok_cleanup(void) {
-#ifdef GENERATE_AND_DUMP_SCANNER_TABLES
   sc_scanner_cleanup(&g_tok_c_ident_scanner_);
   sc_scanner_cleanup(&g_tok_nonterminal_ident_scanner_);
   sc_scanner_cleanup(&g_tok_regex_scanner_);
-#endif
 }
 
 void tok_init_tkr_tokenizer(struct tkr_tokenizer *tkr) {
@@ -0,0 +1,73 @@
+/* Copyright 2026 Kinglet B.V.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCAN_LOG_H
+#define SCAN_LOG_H
+
+/* Driver shared by the scanner tests: the patterns of a test grammar log their tokens, the test
+ * feeds its inputs to the scanner in chunks of several sizes and compares the tokens logged with
+ * those expected. A test grammar takes a "struct scan_log *log" in its %params, logs each token
+ * with scan_log(log, "<kind>", $text), and defines its <prefix>scan_all() with
+ * SCAN_LOG_SCAN_ALL(). The functions are defined in tester.c. */
+
+#ifndef STDDEF_H_INCLUDED
+#define STDDEF_H_INCLUDED
+#include <stddef.h>
+#endif
+
+struct scan_log {
+  /* "<kind>:<text> " for each token, for as far as it fits */
+  char text_[512];
+  size_t size_;
+  size_t num_tokens_;
+};
+
+/* Feeds input_size bytes of input to a scanner in chunks of chunk_size bytes, logging to log;
+ * returns 0 if the scanner finished, non-zero if it failed. */
+typedef int (*scan_log_scan_all_fn)(const char *input, size_t input_size, size_t chunk_size, struct scan_log *log);
+
+void scan_log(struct scan_log *log, const char *kind, const char *text);
+
+/* Scans input in chunks of 1, 2, 3 and 64 bytes, returns 0 if each time the tokens logged are
+ * expected, otherwise reports the difference as that of test and returns non-zero. */
+int scan_log_check(const char *test, scan_log_scan_all_fn scan_all, const char *input, const char *expected);
+
+/* Scans size bytes of c, which is to be the worst case of the grammar: each c a token of its own,
+ * and each the prefix of a longer pattern that the input never completes. Returns 0 if in each
+ * chunk size the tokens are as expected and the scanner takes at most a few transitions per byte.
+ * The transitions are counted by a scanner generated with --instrument, in num_states counters
+ * at transitions, which are reset before each scan. */
+int scan_log_check_linear(const char *test, scan_log_scan_all_fn scan_all, char c, size_t size, unsigned long long *transitions, size_t num_states);
+
+/* Defines static int <prefix>scan_all(), of type scan_log_scan_all_fn, for the scanner of the
+ * grammar with the given prefix and upper case PREFIX, such as SCAN_LOG_SCAN_ALL(t20_, T20_). */
+#define SCAN_LOG_SCAN_ALL(prefix, PREFIX) \
+static int prefix##scan_all(const char *input, size_t input_size, size_t chunk_size, struct scan_log *log) { \
+  int r; \
+  size_t offset = 0; \
+  struct prefix##stack stack; \
+  prefix##stack_init(&stack); \
+  do { \
+    size_t size = input_size - offset; \
+    if (size > chunk_size) size = chunk_size; \
+    prefix##set_input(&stack, input + offset, size, (offset + size) == input_size); \
+    offset += size; \
+    r = prefix##scan(&stack, log); \
+  } while (r == _##PREFIX##FEED_ME); \
+  prefix##stack_cleanup(&stack); \
+  return (r == _##PREFIX##FINISH) ? 0 : -1; \
+}
+
+#endif /* SCAN_LOG_H */
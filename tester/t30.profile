@@ -0,0 +1,56 @@
+# Written by t29, with its parser generated from the same grammar as t30.cbrt
+carburetta-profile 1
+scan-states 15
+scan-state 1 54
+scan-state 2 2
+scan-state 3 23
+scan-state 4 2
+scan-state 5 2
+scan-state 6 5
+scan-state 7 5
+scan-state 8 3
+scan-state 9 1
+scan-state 10 12
+scan-state 11 9
+scan-state 12 1
+scan-state 13 1
+scan-columns 10
+scan-column 1 7
+scan-column 2 50
+scan-column 3 4
+scan-column 4 4
+scan-column 5 13
+scan-column 6 10
+scan-column 7 6
+scan-column 8 3
+scan-column 9 23
+parse-states 17
+parse-state 0 18
+parse-state 1 2
+parse-state 2 6
+parse-state 3 7
+parse-state 4 16
+parse-state 5 2
+parse-state 6 6
+parse-state 7 2
+parse-state 8 5
+parse-state 9 4
+parse-state 10 8
+parse-state 11 6
+parse-state 12 11
+parse-state 13 1
+parse-state 14 13
+parse-state 15 2
+parse-state 16 11
+parse-columns 13
+parse-column 0 20
+parse-column 1 9
+parse-column 2 13
+parse-column 3 2
+parse-column 4 8
+parse-column 5 13
+parse-column 7 11
+parse-column 8 2
+parse-column 9 11
+parse-column 10 15
+parse-column 11 16
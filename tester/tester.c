@@ -16,6 +16,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+
+#include "scan_log.h"
 
 #define enum_tests \
 xx(t1, "Calculator test") \
@@ -36,7 +39,21 @@ xx(t15, "C++ tracing failing constructor carrying data over common data") \
 xx(t16, "C++ skip destructor for implicit C-style %move") \
 xx(t17, "C++ call destructor for explicit C-style %move") \
 xx(t18, "C++ check visit function visits all open common data") \
-xx(t19, "C++ check visit function visits all open symbol data")
+xx(t19, "C++ check visit function visits all open symbol data") \
+xx(t20, "Linear time tokenization UTF-8") \
+xx(t21, "Linear time tokenization Latin-1") \
+xx(t22, "Tokens scanned in place") \
+xx(t23, "Computed goto dispatch of reductions and continuations") \
+xx(t24, "Segmented stack keeps symbol data in place") \
+xx(t25, "Runtime-loaded tables through the generic driver") \
+xx(t26, "Grammar built in-process by libcarburetta") \
+xx(t27, "DFA determinized on demand, UTF-8") \
+xx(t28, "DFA determinized on demand, Latin-1") \
+xx(t29, "Instrumented parser writes a profile") \
+xx(t30, "Tables renumbered by a profile") \
+xx(t31, "Scanner fed by the background reader") \
+xx(t32, "Scanner table with shared rows and exceptions, UTF-8") \
+xx(t33, "Scanner table with shared rows and exceptions, Latin-1")
 
 #define xx(id, desc) int id(void);
 enum_tests
@@ -74,6 +91,71 @@ int main(int argc, char **argv) {
   return EXIT_SUCCESS;
 }
 
+static const size_t scan_log_chunk_sizes[] = { 1, 2, 3, 64 };
+
+/* Worst-case transitions per byte allowed by scan_log_check_linear(); a scanner that backtracks
+ * takes in the order of half the size of the input per byte */
+#define SCAN_LOG_MAX_TRANSITIONS_PER_BYTE 8
+
+static void scan_log_init(struct scan_log *log) {
+  log->text_[0] = '\0';
+  log->size_ = 0;
+  log->num_tokens_ = 0;
+}
+
+void scan_log(struct scan_log *log, const char *kind, const char *text) {
+  int n = snprintf(log->text_ + log->size_, sizeof(log->text_) - log->size_, "%s:%s ", kind, text);
+  if ((n > 0) && ((size_t)n < (sizeof(log->text_) - log->size_))) log->size_ += (size_t)n;
+  else log->text_[log->size_] = '\0';
+  log->num_tokens_++;
+}
+
+int scan_log_check(const char *test, scan_log_scan_all_fn scan_all, const char *input, const char *expected) {
+  struct scan_log log;
+  size_t n;
+  for (n = 0; n < sizeof(scan_log_chunk_sizes) / sizeof(*scan_log_chunk_sizes); ++n) {
+    scan_log_init(&log);
+    if (scan_all(input, strlen(input), scan_log_chunk_sizes[n], &log)) {
+      fprintf(stderr, "%s: failed to scan \"%s\" (chunk size %zu)\n", test, input, scan_log_chunk_sizes[n]);
+      return -1;
+    }
+    if (strcmp(log.text_, expected)) {
+      fprintf(stderr, "%s: unexpected tokens \"%s\" (chunk size %zu)\n", test, log.text_, scan_log_chunk_sizes[n]);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int scan_log_check_linear(const char *test, scan_log_scan_all_fn scan_all, char c, size_t size, unsigned long long *transitions, size_t num_states) {
+  struct scan_log log;
+  size_t n, state;
+  int r = 0;
+  char *input = (char *)malloc(size);
+  if (!input) return -1;
+  memset(input, c, size);
+  for (n = 0; !r && (n < sizeof(scan_log_chunk_sizes) / sizeof(*scan_log_chunk_sizes)); ++n) {
+    unsigned long long num_transitions = 0;
+    memset(transitions, 0, sizeof(*transitions) * num_states);
+    scan_log_init(&log);
+    if (scan_all(input, size, scan_log_chunk_sizes[n], &log) || (log.num_tokens_ != size)) {
+      fprintf(stderr, "%s: failed to scan %zu bytes of worst case (chunk size %zu)\n", test, size, scan_log_chunk_sizes[n]);
+      r = -1;
+      break;
+    }
+    for (state = 0; state < num_states; ++state) {
+      num_transitions += transitions[state];
+    }
+    if (num_transitions > (unsigned long long)size * SCAN_LOG_MAX_TRANSITIONS_PER_BYTE) {
+      fprintf(stderr, "%s: scanning %zu bytes of worst case takes %llu transitions (chunk size %zu), is it still linear?\n",
+              test, size, num_transitions, scan_log_chunk_sizes[n]);
+      r = -1;
+    }
+  }
+  free(input);
+  return r;
+}
+
 int codepoint_as_utf8(char *dst, uint32_t codepoint) {
   uint8_t *dst_utf8 = (uint8_t *)dst;
   if (codepoint <= 0x7F) {